@@ -28,25 +28,55 @@
 #include <unistd.h>
 #include "util-strings.h"
 
+struct data_paths {
+	const char *builddir;	/* NULL unless we run from the builddir */
+	const char *quirks_dir;
+	const char *quirks_override_file; /* NULL in the builddir */
+};
+
 /**
- * Try to figure out the directory we're executing from and if it matches
- * the builddir, return that directory. Otherwise, return NULL.
+ * The data paths depending on whether we're executing from the builddir,
+ * resolved at most once per process - the detection needs a readlink on
+ * /proc/self/exe and sits on context-init paths.
+ *
+ * Set LIBINPUT_BUILDDIR to override the detection: a directory is used
+ * as the builddir as-is, the empty string forces the installed paths.
  */
-static inline char *
-builddir_lookup(void)
+static inline const struct data_paths *
+data_paths_get(void)
 {
-	char execdir[PATH_MAX];
+	static struct data_paths paths;
+	static char execdir[PATH_MAX];
+	static bool resolved;
+	const char *override;
 	char *pathsep;
 	ssize_t nread;
 
+	if (resolved)
+		return &paths;
+
+	resolved = true;
+	paths.builddir = NULL;
+	paths.quirks_dir = LIBINPUT_QUIRKS_DIR;
+	paths.quirks_override_file = LIBINPUT_QUIRKS_OVERRIDE_FILE;
+
+	override = getenv("LIBINPUT_BUILDDIR");
+	if (override) {
+		if (*override != '\0') {
+			snprintf(execdir, sizeof(execdir), "%s", override);
+			goto is_builddir;
+		}
+		return &paths;
+	}
+
 	/* In the case of release builds, the builddir is
 	   the empty string */
 	if (streq(MESON_BUILD_ROOT, ""))
-		return NULL;
+		return &paths;
 
 	nread = readlink("/proc/self/exe", execdir, sizeof(execdir) - 1);
 	if (nread <= 0 || nread == sizeof(execdir) - 1)
-		return NULL;
+		return &paths;
 
 	/* readlink doesn't terminate the string and readlink says
 	   anything past sz is undefined */
@@ -54,11 +84,26 @@ builddir_lookup(void)
 
 	pathsep = strrchr(execdir, '/');
 	if (!pathsep)
-		return NULL;
+		return &paths;
 
 	*pathsep = '\0';
 	if (!streq(execdir, MESON_BUILD_ROOT))
-		return NULL;
+		return &paths;
+
+is_builddir:
+	paths.builddir = execdir;
+	paths.quirks_dir = LIBINPUT_QUIRKS_SRCDIR;
+	paths.quirks_override_file = NULL;
 
-	return safe_strdup(execdir);
+	return &paths;
+}
+
+/**
+ * Try to figure out the directory we're executing from and if it matches
+ * the builddir, return that directory. Otherwise, return NULL.
+ */
+static inline char *
+builddir_lookup(void)
+{
+	return safe_strdup(data_paths_get()->builddir);
 }
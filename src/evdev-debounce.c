@@ -60,8 +60,18 @@
    the second event). These cases are handled by restarting the timer on every
    event that could be part of a bouncing sequence, which makes these cases
    indistinguishable from 5 and 6.
+
+   Until the first bounce (or delayed event candidate) is observed on a
+   device, the state machine stays disengaged and events pass straight
+   through without arming any timer; most buttons never bounce and the
+   two timerfd rearms per click would be wasted on them. Devices known
+   to bounce can pre-engage the machine via the ModelBouncingButtons
+   quirk so not even the first bounce leaks through.
 */
 
+#define DEBOUNCE_TIMEOUT_BOUNCE ms2us(25)
+#define DEBOUNCE_TIMEOUT_SPURIOUS ms2us(12)
+
 enum debounce_event {
 	DEBOUNCE_EVENT_PRESS = 50,
 	DEBOUNCE_EVENT_RELEASE,
@@ -126,8 +136,6 @@ static inline void
 debounce_set_timer(struct fallback_dispatch *fallback,
 		   uint64_t time)
 {
-	const int DEBOUNCE_TIMEOUT_BOUNCE = ms2us(25);
-
 	libinput_timer_set(&fallback->debounce.timer,
 			   time + DEBOUNCE_TIMEOUT_BOUNCE);
 }
@@ -136,8 +144,6 @@ static inline void
 debounce_set_timer_short(struct fallback_dispatch *fallback,
 			 uint64_t time)
 {
-	const int DEBOUNCE_TIMEOUT_SPURIOUS = ms2us(12);
-
 	libinput_timer_set(&fallback->debounce.timer_short,
 			   time + DEBOUNCE_TIMEOUT_SPURIOUS);
 }
@@ -168,6 +174,16 @@ debounce_enable_spurious(struct fallback_dispatch *fallback)
 		       HTTP_DOC_LINK);
 }
 
+static inline void
+debounce_engage(struct fallback_dispatch *fallback)
+{
+	fallback->debounce.engaged = true;
+	evdev_log_info(fallback->device,
+		       "Enabling button debouncing after observed bounce, "
+		       "see %s/button-debouncing.html for details\n",
+		       HTTP_DOC_LINK);
+}
+
 static void
 debounce_notify_button(struct fallback_dispatch *fallback,
 		       enum libinput_button_state state)
@@ -480,6 +496,50 @@ debounce_handle_event(struct fallback_dispatch *fallback,
 			debounce_state_to_str(fallback->debounce.state));
 }
 
+static void
+debounce_passthrough_handle_state(struct fallback_dispatch *dispatch,
+				  uint64_t time)
+{
+	for (int code = hw_key_next_changed(dispatch, 0);
+	     code != -1;
+	     code = hw_key_next_changed(dispatch, code + 1)) {
+		bool is_down;
+
+		if (get_key_type(code) != KEY_TYPE_BUTTON)
+			continue;
+
+		is_down = hw_is_key_down(dispatch, code);
+
+		/* A press right after the release of the same button is
+		 * what the timers exist to catch (cases 3-8 above), so
+		 * hand over to the state machine. This first bounce
+		 * passes through unfiltered. */
+		if (is_down &&
+		    code == dispatch->debounce.button_code &&
+		    time - dispatch->debounce.button_up_time <
+			    DEBOUNCE_TIMEOUT_BOUNCE)
+			debounce_engage(dispatch);
+		else if (!is_down)
+			dispatch->debounce.button_up_time = time;
+
+		dispatch->debounce.button_code = code;
+		dispatch->debounce.button_time = time;
+		debounce_notify_button(dispatch,
+				       is_down ?
+					       LIBINPUT_BUTTON_STATE_PRESSED :
+					       LIBINPUT_BUTTON_STATE_RELEASED);
+	}
+
+	/* The machine takes over from the next frame in one of its
+	 * neutral entry states */
+	if (dispatch->debounce.engaged)
+		debounce_set_state(dispatch,
+				   hw_is_key_down(dispatch,
+						  dispatch->debounce.button_code) ?
+					   DEBOUNCE_STATE_IS_DOWN :
+					   DEBOUNCE_STATE_IS_UP);
+}
+
 void
 fallback_debounce_handle_state(struct fallback_dispatch *dispatch,
 			       uint64_t time)
@@ -488,12 +548,19 @@ fallback_debounce_handle_state(struct fallback_dispatch *dispatch,
 	size_t nchanged = 0;
 	bool flushed = false;
 
-	for (unsigned int code = 0; code <= KEY_MAX; code++) {
+	if (!dispatch->debounce.engaged &&
+	    dispatch->debounce.state != DEBOUNCE_STATE_DISABLED) {
+		debounce_passthrough_handle_state(dispatch, time);
+		return;
+	}
+
+	for (int code = hw_key_next_changed(dispatch, 0);
+	     code != -1;
+	     code = hw_key_next_changed(dispatch, code + 1)) {
 		if (get_key_type(code) != KEY_TYPE_BUTTON)
 			continue;
 
-		if (hw_key_has_changed(dispatch, code))
-			changed[nchanged++] = code;
+		changed[nchanged++] = code;
 
 		/* If you manage to press more than 16 buttons in the same
 		 * frame, we just quietly ignore the rest of them */
@@ -580,6 +647,12 @@ fallback_init_debounce(struct fallback_dispatch *dispatch)
 		return;
 	}
 
+	/* Start in passthrough mode and engage the timer machinery on
+	 * the first observed bounce, unless the device is known bouncy */
+	dispatch->debounce.engaged =
+		evdev_device_has_model_quirk(device,
+					     QUIRK_MODEL_BOUNCING_BUTTONS);
+
 	dispatch->debounce.state = DEBOUNCE_STATE_IS_UP;
 
 	snprintf(timer_name,
@@ -164,9 +164,28 @@ fallback_rotate_relative(struct fallback_dispatch *dispatch,
 	if (!device->base.config.rotation)
 		return;
 
-	/* loss of precision for non-90 degrees, but we only support 90 deg
-	 * right now anyway */
-	matrix_mult_vec(&dispatch->rotation.matrix, &rel.x, &rel.y);
+	/* The config layer validates the angle to quarter turns, so the
+	 * rotation is exact integer swaps and negations - no float math
+	 * and no precision loss per event */
+	switch (dispatch->rotation.angle) {
+	case 0:
+		return;
+	case 90:
+		rel.x = -dispatch->rel.y;
+		rel.y = dispatch->rel.x;
+		break;
+	case 180:
+		rel.x = -dispatch->rel.x;
+		rel.y = -dispatch->rel.y;
+		break;
+	case 270:
+		rel.x = dispatch->rel.y;
+		rel.y = -dispatch->rel.x;
+		break;
+	default:
+		matrix_mult_vec(&dispatch->rotation.matrix, &rel.x, &rel.y);
+		break;
+	}
 
 	dispatch->rel = rel;
 }
@@ -196,11 +215,19 @@ fallback_flush_relative_motion(struct fallback_dispatch *dispatch,
 		return;
 
 	if (device->pointer.filter) {
+		/* Feed the velocity trackers with the hardware frame time
+		 * where available: on bursty transports (USB) several
+		 * frames may be delivered and timestamped at once, making
+		 * software intervals useless for velocity estimation */
+		uint64_t filter_time = device->hw_time.frame_time ?
+					       device->hw_time.frame_time :
+					       time;
+
 		/* Apply pointer acceleration. */
 		accel = filter_dispatch(device->pointer.filter,
 					&raw,
 					device,
-					time);
+					filter_time);
 	} else {
 		evdev_log_bug_libinput(device,
 				       "accel filter missing\n");
@@ -226,6 +253,7 @@ fallback_flush_absolute_motion(struct fallback_dispatch *dispatch,
 
 	point = dispatch->abs.point;
 	evdev_transform_absolute(device, &point);
+	evdev_export_position(device, time, &point);
 
 	pointer_notify_motion_absolute(base, time, &point);
 }
@@ -252,16 +280,22 @@ fallback_flush_mt_down(struct fallback_dispatch *dispatch,
 		return false;
 	}
 
-	seat_slot = ffs(~seat->slot_map) - 1;
+	/* A region-filtered touch never gets a seat slot, so the slot's
+	 * later motion/up events short-circuit on seat_slot == -1 */
+	if (!evdev_device_point_in_active_region(device, &slot->point))
+		return false;
+
+	seat_slot = ffsll(~seat->slot_map) - 1;
 	slot->seat_slot = seat_slot;
 
 	if (seat_slot == -1)
 		return false;
 
-	seat->slot_map |= bit(seat_slot);
+	seat->slot_map |= bit64(seat_slot);
 	point = slot->point;
 	slot->hysteresis_center = point;
 	evdev_transform_absolute(device, &point);
+	evdev_export_position(device, time, &point);
 
 	touch_notify_touch_down(base, time, slot_idx, seat_slot,
 				&point);
@@ -294,6 +328,7 @@ fallback_flush_mt_motion(struct fallback_dispatch *dispatch,
 		return false;
 
 	evdev_transform_absolute(device, &point);
+	evdev_export_position(device, time, &point);
 	touch_notify_touch_motion(base, time, slot_idx, seat_slot,
 				  &point);
 
@@ -321,7 +356,7 @@ fallback_flush_mt_up(struct fallback_dispatch *dispatch,
 	if (seat_slot == -1)
 		return false;
 
-	seat->slot_map &= ~bit(seat_slot);
+	seat->slot_map &= ~bit64(seat_slot);
 
 	touch_notify_touch_up(base, time, slot_idx, seat_slot);
 
@@ -349,7 +384,7 @@ fallback_flush_mt_cancel(struct fallback_dispatch *dispatch,
 	if (seat_slot == -1)
 		return false;
 
-	seat->slot_map &= ~bit(seat_slot);
+	seat->slot_map &= ~bit64(seat_slot);
 
 	touch_notify_touch_cancel(base, time, slot_idx, seat_slot);
 
@@ -375,16 +410,20 @@ fallback_flush_st_down(struct fallback_dispatch *dispatch,
 		return false;
 	}
 
-	seat_slot = ffs(~seat->slot_map) - 1;
+	if (!evdev_device_point_in_active_region(device, &dispatch->abs.point))
+		return false;
+
+	seat_slot = ffsll(~seat->slot_map) - 1;
 	dispatch->abs.seat_slot = seat_slot;
 
 	if (seat_slot == -1)
 		return false;
 
-	seat->slot_map |= bit(seat_slot);
+	seat->slot_map |= bit64(seat_slot);
 
 	point = dispatch->abs.point;
 	evdev_transform_absolute(device, &point);
+	evdev_export_position(device, time, &point);
 
 	touch_notify_touch_down(base, time, -1, seat_slot, &point);
 
@@ -408,6 +447,7 @@ fallback_flush_st_motion(struct fallback_dispatch *dispatch,
 	if (seat_slot == -1)
 		return false;
 
+	evdev_export_position(device, time, &point);
 	touch_notify_touch_motion(base, time, -1, seat_slot, &point);
 
 	return true;
@@ -431,7 +471,7 @@ fallback_flush_st_up(struct fallback_dispatch *dispatch,
 	if (seat_slot == -1)
 		return false;
 
-	seat->slot_map &= ~bit(seat_slot);
+	seat->slot_map &= ~bit64(seat_slot);
 
 	touch_notify_touch_up(base, time, -1, seat_slot);
 
@@ -456,7 +496,7 @@ fallback_flush_st_cancel(struct fallback_dispatch *dispatch,
 	if (seat_slot == -1)
 		return false;
 
-	seat->slot_map &= ~bit(seat_slot);
+	seat->slot_map &= ~bit64(seat_slot);
 
 	touch_notify_touch_cancel(base, time, -1, seat_slot);
 
@@ -556,11 +596,7 @@ fallback_process_touch(struct fallback_dispatch *dispatch,
 			dispatch->pending_event |= EVDEV_ABSOLUTE_MT;
 			slot->state = SLOT_STATE_BEGIN;
 			if (dispatch->mt.has_palm) {
-				int v;
-				v = libevdev_get_slot_value(device->evdev,
-							    dispatch->mt.slot,
-							    ABS_MT_TOOL_TYPE);
-				switch (v) {
+				switch (slot->tool_type) {
 				case MT_TOOL_PALM:
 					/* new touch, no cancel needed */
 					slot->palm_state = PALM_WAS_PALM;
@@ -607,6 +643,7 @@ fallback_process_touch(struct fallback_dispatch *dispatch,
 				slot->palm_state = PALM_WAS_PALM;
 			break;
 		}
+		slot->tool_type = e->value;
 		dispatch->pending_event |= EVDEV_ABSOLUTE_MT;
 		slot->dirty = true;
 		break;
@@ -708,42 +745,102 @@ fallback_lid_toggle_keyboard_listeners(struct fallback_dispatch *dispatch,
 	}
 }
 
+static void
+fallback_switch_apply_lid(struct fallback_dispatch *dispatch,
+			  struct evdev_device *device,
+			  bool is_closed,
+			  uint64_t time)
+{
+	fallback_lid_toggle_keyboard_listeners(dispatch, is_closed);
+
+	if (dispatch->lid.is_closed == is_closed)
+		return;
+
+	dispatch->lid.is_closed = is_closed;
+	fallback_lid_notify_toggle(dispatch, device, time);
+}
+
+static void
+fallback_switch_apply_tablet_mode(struct fallback_dispatch *dispatch,
+				  struct evdev_device *device,
+				  int value,
+				  uint64_t time)
+{
+	enum libinput_switch_state state;
+
+	if (dispatch->tablet_mode.sw.state == value)
+		return;
+
+	dispatch->tablet_mode.sw.state = value;
+	if (value)
+		state = LIBINPUT_SWITCH_STATE_ON;
+	else
+		state = LIBINPUT_SWITCH_STATE_OFF;
+	switch_notify_toggle(&device->base,
+			     time,
+			     LIBINPUT_SWITCH_TABLET_MODE,
+			     state);
+}
+
+static void
+fallback_switch_debounce_timeout(uint64_t now, void *data)
+{
+	struct fallback_dispatch *dispatch = data;
+	struct evdev_device *device = dispatch->device;
+
+	if (dispatch->sw_debounce.lid_pending) {
+		dispatch->sw_debounce.lid_pending = false;
+		fallback_switch_apply_lid(dispatch,
+					  device,
+					  dispatch->sw_debounce.lid_value,
+					  now);
+	}
+
+	if (dispatch->sw_debounce.tablet_mode_pending) {
+		dispatch->sw_debounce.tablet_mode_pending = false;
+		fallback_switch_apply_tablet_mode(
+				dispatch,
+				device,
+				dispatch->sw_debounce.tablet_mode_value,
+				now);
+	}
+}
+
 static inline void
 fallback_process_switch(struct fallback_dispatch *dispatch,
 			struct evdev_device *device,
 			struct input_event *e,
 			uint64_t time)
 {
-	enum libinput_switch_state state;
-	bool is_closed;
-
 	/* TODO: this should to move to handle_state */
 
+	/* With a debounce window, a chattering switch just keeps
+	 * re-arming the timer; the state is applied once the line has
+	 * been quiet for a full window and the suspend/resume machinery
+	 * behind the notify runs once per settled transition. */
+
 	switch (e->code) {
 	case SW_LID:
-		is_closed = !!e->value;
-
-		fallback_lid_toggle_keyboard_listeners(dispatch, is_closed);
-
-		if (dispatch->lid.is_closed == is_closed)
+		if (dispatch->sw_debounce.window) {
+			dispatch->sw_debounce.lid_value = !!e->value;
+			dispatch->sw_debounce.lid_pending = true;
+			libinput_timer_set(&dispatch->sw_debounce.timer,
+					   time + dispatch->sw_debounce.window);
 			return;
+		}
 
-		dispatch->lid.is_closed = is_closed;
-		fallback_lid_notify_toggle(dispatch, device, time);
+		fallback_switch_apply_lid(dispatch, device, !!e->value, time);
 		break;
 	case SW_TABLET_MODE:
-		if (dispatch->tablet_mode.sw.state == e->value)
+		if (dispatch->sw_debounce.window) {
+			dispatch->sw_debounce.tablet_mode_value = e->value;
+			dispatch->sw_debounce.tablet_mode_pending = true;
+			libinput_timer_set(&dispatch->sw_debounce.timer,
+					   time + dispatch->sw_debounce.window);
 			return;
+		}
 
-		dispatch->tablet_mode.sw.state = e->value;
-		if (e->value)
-			state = LIBINPUT_SWITCH_STATE_ON;
-		else
-			state = LIBINPUT_SWITCH_STATE_OFF;
-		switch_notify_toggle(&device->base,
-				     time,
-				     LIBINPUT_SWITCH_TABLET_MODE,
-				     state);
+		fallback_switch_apply_tablet_mode(dispatch, device, e->value, time);
 		break;
 	}
 }
@@ -769,7 +866,7 @@ fallback_process_relative(struct fallback_dispatch *dispatch,
 			  struct evdev_device *device,
 			  struct input_event *e, uint64_t time)
 {
-	if (fallback_reject_relative(device, e, time))
+	if (unlikely(fallback_reject_relative(device, e, time)))
 		return;
 
 	switch (e->code) {
@@ -950,10 +1047,9 @@ fallback_handle_state(struct fallback_dispatch *dispatch,
 	/* Buttons and keys */
 	if (dispatch->pending_event & EVDEV_KEY) {
 		bool want_debounce = false;
-		for (unsigned int code = 0; code <= KEY_MAX; code++) {
-			if (!hw_key_has_changed(dispatch, code))
-				continue;
-
+		for (int code = hw_key_next_changed(dispatch, 0);
+		     code != -1;
+		     code = hw_key_next_changed(dispatch, code + 1)) {
 			if (get_key_type(code) == KEY_TYPE_BUTTON) {
 				want_debounce = true;
 				break;
@@ -977,7 +1073,7 @@ fallback_interface_process(struct evdev_dispatch *evdev_dispatch,
 {
 	struct fallback_dispatch *dispatch = fallback_dispatch(evdev_dispatch);
 
-	if (dispatch->arbitration.in_arbitration)
+	if (unlikely(dispatch->arbitration.in_arbitration))
 		return;
 
 	switch (event->type) {
@@ -999,6 +1095,58 @@ fallback_interface_process(struct evdev_dispatch *evdev_dispatch,
 	}
 }
 
+/* SYN_REPORT handler for the keyboard-only process path: of the full
+ * fallback_handle_state() only the key/button block can ever have
+ * pending state */
+static void
+fallback_keyboard_handle_state(struct fallback_dispatch *dispatch,
+			       struct evdev_device *device,
+			       uint64_t time)
+{
+	if (dispatch->pending_event & EVDEV_KEY) {
+		bool want_debounce = false;
+		for (int code = hw_key_next_changed(dispatch, 0);
+		     code != -1;
+		     code = hw_key_next_changed(dispatch, code + 1)) {
+			if (get_key_type(code) == KEY_TYPE_BUTTON) {
+				want_debounce = true;
+				break;
+			}
+		}
+
+		if (want_debounce)
+			fallback_debounce_handle_state(dispatch, time);
+
+		hw_key_update_last_state(dispatch);
+	}
+
+	dispatch->pending_event = EVDEV_NONE;
+}
+
+/* Process path for devices that cannot send EV_REL/EV_ABS/EV_SW, see
+ * fallback_dispatch_create(): a keystroke never pays for the motion,
+ * touch and switch branches of fallback_interface_process() */
+static void
+fallback_interface_process_keyboard(struct evdev_dispatch *evdev_dispatch,
+				    struct evdev_device *device,
+				    struct input_event *event,
+				    uint64_t time)
+{
+	struct fallback_dispatch *dispatch = fallback_dispatch(evdev_dispatch);
+
+	if (unlikely(dispatch->arbitration.in_arbitration))
+		return;
+
+	switch (event->type) {
+	case EV_KEY:
+		fallback_process_key(dispatch, device, event, time);
+		break;
+	case EV_SYN:
+		fallback_keyboard_handle_state(dispatch, device, time);
+		break;
+	}
+}
+
 static void
 cancel_touches(struct fallback_dispatch *dispatch,
 	       struct evdev_device *device,
@@ -1028,52 +1176,71 @@ cancel_touches(struct fallback_dispatch *dispatch,
 		touch_notify_frame(&device->base, time);
 }
 
+static bool
+release_pressed_key(struct fallback_dispatch *dispatch,
+		    struct evdev_device *device,
+		    int code,
+		    uint64_t time)
+{
+	int count = get_key_down_count(device, code);
+
+	if (count == 0)
+		return true;
+
+	if (count > 1) {
+		evdev_log_bug_libinput(device,
+				       "key %d is down %d times.\n",
+				       code,
+				       count);
+	}
+
+	switch (get_key_type(code)) {
+	case KEY_TYPE_NONE:
+		break;
+	case KEY_TYPE_KEY:
+		fallback_keyboard_notify_key(
+			dispatch,
+			device,
+			time,
+			code,
+			LIBINPUT_KEY_STATE_RELEASED);
+		break;
+	case KEY_TYPE_BUTTON:
+		evdev_pointer_notify_button(
+			device,
+			time,
+			evdev_to_left_handed(device, code),
+			LIBINPUT_BUTTON_STATE_RELEASED);
+		break;
+	}
+
+	count = get_key_down_count(device, code);
+	if (count != 0) {
+		evdev_log_bug_libinput(device,
+				       "releasing key %d failed.\n",
+				       code);
+		return false;
+	}
+
+	return true;
+}
+
 static void
 release_pressed_keys(struct fallback_dispatch *dispatch,
 		     struct evdev_device *device,
 		     uint64_t time)
 {
-	int code;
-
-	for (code = 0; code < KEY_CNT; code++) {
-		int count = get_key_down_count(device, code);
-
-		if (count == 0)
-			continue;
-
-		if (count > 1) {
-			evdev_log_bug_libinput(device,
-					       "key %d is down %d times.\n",
-					       code,
-					       count);
-		}
+	/* Sweep the words with a key down instead of scanning all of
+	 * key_count; on a VT switch that's typically one or two words */
+	for (size_t w = 0; w < NLONGS(KEY_CNT); w++) {
+		unsigned long bits = device->key_down_mask[w];
 
-		switch (get_key_type(code)) {
-		case KEY_TYPE_NONE:
-			break;
-		case KEY_TYPE_KEY:
-			fallback_keyboard_notify_key(
-				dispatch,
-				device,
-				time,
-				code,
-				LIBINPUT_KEY_STATE_RELEASED);
-			break;
-		case KEY_TYPE_BUTTON:
-			evdev_pointer_notify_button(
-				device,
-				time,
-				evdev_to_left_handed(device, code),
-				LIBINPUT_BUTTON_STATE_RELEASED);
-			break;
-		}
+		while (bits) {
+			int code = w * LONG_BITS + __builtin_ctzl(bits);
 
-		count = get_key_down_count(device, code);
-		if (count != 0) {
-			evdev_log_bug_libinput(device,
-					       "releasing key %d failed.\n",
-					       code);
-			break;
+			bits &= bits - 1;
+			if (!release_pressed_key(dispatch, device, code, time))
+				return;
 		}
 	}
 }
@@ -1091,7 +1258,7 @@ fallback_return_to_neutral_state(struct fallback_dispatch *dispatch,
 	cancel_touches(dispatch, device, NULL, time);
 	release_pressed_keys(dispatch, device, time);
 	memset(dispatch->hw_key_mask, 0, sizeof(dispatch->hw_key_mask));
-	memset(dispatch->hw_key_mask, 0, sizeof(dispatch->last_hw_key_mask));
+	memset(dispatch->last_hw_key_mask, 0, sizeof(dispatch->last_hw_key_mask));
 }
 
 static void
@@ -1110,9 +1277,12 @@ fallback_interface_remove(struct evdev_dispatch *evdev_dispatch)
 	struct evdev_paired_keyboard *kbd;
 
 	libinput_timer_cancel(&dispatch->wheel.scroll_timer);
+	libinput_timer_cancel(&dispatch->wheel.coalesce_timer);
 	libinput_timer_cancel(&dispatch->debounce.timer);
 	libinput_timer_cancel(&dispatch->debounce.timer_short);
+	libinput_timer_cancel(&dispatch->sw_debounce.timer);
 	libinput_timer_cancel(&dispatch->arbitration.arbitration_timer);
+	dispatch->arbitration.arbitration_timer_expiry = 0;
 
 	libinput_device_remove_event_listener(&dispatch->tablet_mode.other.listener);
 
@@ -1199,8 +1369,11 @@ fallback_interface_toggle_touch(struct evdev_dispatch *evdev_dispatch,
 		 * get what looks like a tap. Fix this by delaying
 		 * arbitration by just a little bit so that any touch in
 		 * event is caught as palm touch. */
-		libinput_timer_set(&dispatch->arbitration.arbitration_timer,
-				   time + ms2us(90));
+		if (dispatch->arbitration.arbitration_timer_expiry == 0)
+			libinput_timer_set(&dispatch->arbitration.arbitration_timer,
+					   time + ms2us(90));
+		dispatch->arbitration.arbitration_timer_expiry =
+			time + ms2us(90);
 		break;
 	case ARBITRATION_IGNORE_RECT:
 		assert(phys_rect);
@@ -1209,7 +1382,10 @@ fallback_interface_toggle_touch(struct evdev_dispatch *evdev_dispatch,
 		dispatch->arbitration.rect = rect;
 		break;
 	case ARBITRATION_IGNORE_ALL:
-		libinput_timer_cancel(&dispatch->arbitration.arbitration_timer);
+		/* invalidate a pending release instead of cancelling the
+		 * timer, handwriting toggles proximity constantly and the
+		 * no-op firing is cheaper than the heap churn */
+		dispatch->arbitration.arbitration_timer_expiry = 0;
 		fallback_return_to_neutral_state(dispatch, device);
 		dispatch->arbitration.in_arbitration = true;
 		break;
@@ -1224,9 +1400,11 @@ fallback_interface_destroy(struct evdev_dispatch *evdev_dispatch)
 	struct fallback_dispatch *dispatch = fallback_dispatch(evdev_dispatch);
 
 	libinput_timer_destroy(&dispatch->wheel.scroll_timer);
+	libinput_timer_destroy(&dispatch->wheel.coalesce_timer);
 	libinput_timer_destroy(&dispatch->arbitration.arbitration_timer);
 	libinput_timer_destroy(&dispatch->debounce.timer);
 	libinput_timer_destroy(&dispatch->debounce.timer_short);
+	libinput_timer_destroy(&dispatch->sw_debounce.timer);
 
 	free(dispatch->mt.slots);
 	free(dispatch);
@@ -1421,6 +1599,22 @@ struct evdev_dispatch_interface fallback_interface = {
 	.get_switch_state = fallback_interface_get_switch_state,
 };
 
+/* The same dispatch with the keyboard-only process path swapped in */
+struct evdev_dispatch_interface fallback_interface_keyboard = {
+	.process = fallback_interface_process_keyboard,
+	.suspend = fallback_interface_suspend,
+	.remove = fallback_interface_remove,
+	.destroy = fallback_interface_destroy,
+	.device_added = fallback_interface_device_added,
+	.device_removed = fallback_interface_device_removed,
+	.device_suspended = fallback_interface_device_removed, /* treat as remove */
+	.device_resumed = fallback_interface_device_added,   /* treat as add */
+	.post_added = fallback_interface_sync_initial_state,
+	.touch_arbitration_toggle = fallback_interface_toggle_touch,
+	.touch_arbitration_update_rect = fallback_interface_update_rect,
+	.get_switch_state = fallback_interface_get_switch_state,
+};
+
 static void
 fallback_change_to_left_handed(struct evdev_device *device)
 {
@@ -1551,6 +1745,9 @@ fallback_dispatch_init_slots(struct fallback_dispatch *dispatch,
 		slots[slot].point.y = libevdev_get_slot_value(evdev,
 							      slot,
 							      ABS_MT_POSITION_Y);
+		slots[slot].tool_type = libevdev_get_slot_value(evdev,
+								slot,
+								ABS_MT_TOOL_TYPE);
 	}
 	dispatch->mt.slots = slots;
 	dispatch->mt.slots_len = num_slots;
@@ -1594,10 +1791,28 @@ static inline void
 fallback_dispatch_init_switch(struct fallback_dispatch *dispatch,
 			      struct evdev_device *device)
 {
+	char timer_name[64];
+	const char *window;
+	int window_ms;
 	int val;
 
 	list_init(&dispatch->lid.paired_keyboard_list);
 
+	snprintf(timer_name,
+		 sizeof(timer_name),
+		 "%s switch debounce",
+		 evdev_device_get_sysname(device));
+	libinput_timer_init(&dispatch->sw_debounce.timer,
+			    evdev_libinput_context(device),
+			    timer_name,
+			    fallback_switch_debounce_timeout,
+			    dispatch);
+
+	window = getenv("LIBINPUT_SWITCH_DEBOUNCE_MS");
+	if (window && safe_atoi(window, &window_ms) &&
+	    window_ms > 0 && window_ms <= 2000)
+		dispatch->sw_debounce.window = ms2us(window_ms);
+
 	if (device->tags & EVDEV_TAG_LID_SWITCH) {
 		dispatch->lid.reliability = evdev_read_switch_reliability_prop(device);
 		dispatch->lid.is_closed = false;
@@ -1617,6 +1832,20 @@ static void
 fallback_arbitration_timeout(uint64_t now, void *data)
 {
 	struct fallback_dispatch *dispatch = data;
+	uint64_t expiry = dispatch->arbitration.arbitration_timer_expiry;
+
+	/* arbitration re-engaged before the release deadline */
+	if (expiry == 0)
+		return;
+
+	/* a later proximity-out moved the deadline, fire then */
+	if (expiry > now) {
+		libinput_timer_set(&dispatch->arbitration.arbitration_timer,
+				   expiry);
+		return;
+	}
+
+	dispatch->arbitration.arbitration_timer_expiry = 0;
 
 	if (dispatch->arbitration.in_arbitration)
 		dispatch->arbitration.in_arbitration = false;
@@ -1651,6 +1880,15 @@ fallback_dispatch_create(struct libinput_device *libinput_device)
 	dispatch->base.dispatch_type = DISPATCH_FALLBACK;
 	dispatch->base.interface = &fallback_interface;
 	dispatch->pending_event = EVDEV_NONE;
+
+	/* Keyboards only ever queue key state; give them a process path
+	 * without the motion/touch/switch branches. EV_MSC, EV_LED and
+	 * EV_REP are fine, neither path looks at those */
+	if (!libevdev_has_event_type(device->evdev, EV_REL) &&
+	    !libevdev_has_event_type(device->evdev, EV_ABS) &&
+	    !libevdev_has_event_type(device->evdev, EV_SW))
+		dispatch->base.interface = &fallback_interface_keyboard;
+
 	list_init(&dispatch->lid.paired_keyboard_list);
 
 	fallback_dispatch_init_rel(dispatch, device);
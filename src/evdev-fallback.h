@@ -81,6 +81,9 @@ struct mt_slot {
 	struct device_coords point;
 	struct device_coords hysteresis_center;
 	enum palm_state palm_state;
+	/* mirror of the slot's ABS_MT_TOOL_TYPE, kept current from the
+	 * event stream so touch down doesn't need a libevdev lookup */
+	int tool_type;
 };
 
 struct fallback_dispatch {
@@ -120,6 +123,12 @@ struct fallback_dispatch {
 		bool hi_res_event_received;
 		struct libinput_timer scroll_timer;
 		enum wheel_direction dir;
+		/* Coalescing window in µs, see LIBINPUT_WHEEL_COALESCE_MS.
+		 * 0 means flush on every frame. */
+		uint64_t coalesce_window;
+		uint64_t last_flush_time;
+		bool coalesce_pending;
+		struct libinput_timer coalesce_timer;
 	} wheel;
 
 	struct {
@@ -149,6 +158,11 @@ struct fallback_dispatch {
 		struct libinput_timer timer_short;
 		enum debounce_state state;
 		bool spurious_enabled;
+		/* false until the first bounce is observed; while false
+		 * events pass through without arming the timers */
+		bool engaged;
+		/* release time of button_code while in passthrough */
+		uint64_t button_up_time;
 	} debounce;
 
 	struct {
@@ -165,6 +179,20 @@ struct fallback_dispatch {
 		struct list paired_keyboard_list;
 	} lid;
 
+	/* Chattering lid/tablet-mode switches settle here before the
+	 * suspend/resume machinery runs, see
+	 * LIBINPUT_SWITCH_DEBOUNCE_MS */
+	struct {
+		/* debounce window in µs, 0 applies switch events
+		 * immediately */
+		uint64_t window;
+		struct libinput_timer timer;
+		bool lid_pending;
+		bool lid_value;
+		bool tablet_mode_pending;
+		int tablet_mode_value;
+	} sw_debounce;
+
 	/* pen/touch arbitration has a delayed state,
 	 * in_arbitration is what decides when to filter.
 	 */
@@ -173,6 +201,10 @@ struct fallback_dispatch {
 		bool in_arbitration;
 		struct device_coord_rect rect;
 		struct libinput_timer arbitration_timer;
+		/* pending release deadline; proximity transitions bump
+		 * this instead of re-arming or cancelling the timer, 0
+		 * while no release is pending */
+		uint64_t arbitration_timer_expiry;
 	} arbitration;
 };
 
@@ -238,6 +270,31 @@ hw_key_has_changed(struct fallback_dispatch *dispatch, int code)
 		long_bit_is_set(dispatch->last_hw_key_mask, code);
 }
 
+/**
+ * Returns the first code >= code for which the hardware key state
+ * changed this frame, or -1 if there is none. Skips over unchanged
+ * words, so walking all changes in a frame costs NLONGS(KEY_CNT)
+ * compares plus one iteration per changed key rather than a KEY_CNT-wide
+ * scan.
+ */
+static inline int
+hw_key_next_changed(struct fallback_dispatch *dispatch, unsigned int code)
+{
+	while (code < KEY_CNT) {
+		size_t w = code / LONG_BITS;
+		unsigned long diff = (dispatch->hw_key_mask[w] ^
+				      dispatch->last_hw_key_mask[w]) >>
+				     (code % LONG_BITS);
+
+		if (diff)
+			return code + __builtin_ctzl(diff);
+
+		code = (w + 1) * LONG_BITS;
+	}
+
+	return -1;
+}
+
 static inline void
 hw_key_update_last_state(struct fallback_dispatch *dispatch)
 {
@@ -259,7 +316,9 @@ hw_is_key_down(struct fallback_dispatch *dispatch, int code)
 static inline int
 get_key_down_count(struct evdev_device *device, int code)
 {
-	return device->key_count[code];
+	int slot = evdev_device_key_slot(device, code);
+
+	return slot < 0 ? 0 : device->key_count[slot];
 }
 
 void fallback_init_debounce(struct fallback_dispatch *dispatch);
@@ -571,7 +571,7 @@ evdev_middlebutton_apply_config(struct evdev_device *device)
 	if (device->middlebutton.button_mask != 0)
 		return;
 
-	device->middlebutton.enabled = device->middlebutton.want_enabled;
+	evdev_middlebutton_splice(device, device->middlebutton.want_enabled);
 }
 
 bool
@@ -586,8 +586,8 @@ evdev_middlebutton_filter_button(struct evdev_device *device,
 	unsigned int bit = (button - BTN_LEFT);
 	uint32_t old_mask = 0;
 
-	if (!device->middlebutton.enabled)
-		return false;
+	/* only reachable through middlebutton.filter, i.e. while
+	 * emulation is enabled, see evdev_middlebutton_splice() */
 
 	switch (button) {
 	case BTN_LEFT:
@@ -713,7 +713,7 @@ evdev_init_middlebutton(struct evdev_device *device,
 			    device);
 	device->middlebutton.enabled_default = enable;
 	device->middlebutton.want_enabled = enable;
-	device->middlebutton.enabled = enable;
+	evdev_middlebutton_splice(device, enable);
 
 	if (!want_config)
 		return;
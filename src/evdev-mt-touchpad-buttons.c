@@ -34,6 +34,15 @@
 #define DEFAULT_BUTTON_ENTER_TIMEOUT ms2us(100)
 #define DEFAULT_BUTTON_LEAVE_TIMEOUT ms2us(300)
 
+/* Which button area(s) the current touches are in, ORed into the index
+ * of buttons.area_map, see tp_post_clickpadbutton_buttons() */
+enum clickpad_area {
+	CLICKPAD_AREA_MAIN = 0x01,
+	CLICKPAD_AREA_LEFT = 0x02,
+	CLICKPAD_AREA_MIDDLE = 0x04,
+	CLICKPAD_AREA_RIGHT = 0x08,
+};
+
 /*****************************************
  * BEFORE YOU EDIT THIS FILE, look at the state diagram in
  * doc/touchpad-softbutton-state-machine.svg (generated with
@@ -81,48 +90,55 @@ static inline bool
 is_inside_bottom_button_area(const struct tp_dispatch *tp,
 			     const struct tp_touch *t)
 {
-	return t->point.y >= tp->buttons.bottom_area.top_edge;
+	return tp_zones_classify(tp, t->point) & TP_ZONE_BOTTOM_BUTTON;
 }
 
 static inline bool
 is_inside_bottom_right_area(const struct tp_dispatch *tp,
 			    const struct tp_touch *t)
 {
-	return is_inside_bottom_button_area(tp, t) &&
-	       t->point.x > tp->buttons.bottom_area.rightbutton_left_edge;
+	uint16_t zones = tp_zones_classify(tp, t->point);
+
+	return (zones & (TP_ZONE_BOTTOM_BUTTON|TP_ZONE_BOTTOM_RIGHT)) ==
+	       (TP_ZONE_BOTTOM_BUTTON|TP_ZONE_BOTTOM_RIGHT);
 }
 
 static inline bool
 is_inside_bottom_middle_area(const struct tp_dispatch *tp,
 			   const struct tp_touch *t)
 {
-	return is_inside_bottom_button_area(tp, t) &&
-	       !is_inside_bottom_right_area(tp, t) &&
-	       t->point.x > tp->buttons.bottom_area.middlebutton_left_edge;
+	uint16_t zones = tp_zones_classify(tp, t->point);
+
+	return (zones & TP_ZONE_BOTTOM_BUTTON) &&
+	       !(zones & TP_ZONE_BOTTOM_RIGHT) &&
+	       (zones & TP_ZONE_BOTTOM_MIDDLE);
 }
 
 static inline bool
 is_inside_top_button_area(const struct tp_dispatch *tp,
 			  const struct tp_touch *t)
 {
-	return t->point.y <= tp->buttons.top_area.bottom_edge;
+	return tp_zones_classify(tp, t->point) & TP_ZONE_TOP_BUTTON;
 }
 
 static inline bool
 is_inside_top_right_area(const struct tp_dispatch *tp,
 			 const struct tp_touch *t)
 {
-	return is_inside_top_button_area(tp, t) &&
-	       t->point.x > tp->buttons.top_area.rightbutton_left_edge;
+	uint16_t zones = tp_zones_classify(tp, t->point);
+
+	return (zones & (TP_ZONE_TOP_BUTTON|TP_ZONE_TOP_RIGHT)) ==
+	       (TP_ZONE_TOP_BUTTON|TP_ZONE_TOP_RIGHT);
 }
 
 static inline bool
 is_inside_top_middle_area(const struct tp_dispatch *tp,
 			  const struct tp_touch *t)
 {
-	return is_inside_top_button_area(tp, t) &&
-	       t->point.x >= tp->buttons.top_area.leftbutton_right_edge &&
-	       t->point.x <= tp->buttons.top_area.rightbutton_left_edge;
+	uint16_t zones = tp_zones_classify(tp, t->point);
+
+	return (zones & (TP_ZONE_TOP_BUTTON|TP_ZONE_TOP_MIDDLE)) ==
+	       (TP_ZONE_TOP_BUTTON|TP_ZONE_TOP_MIDDLE);
 }
 
 static void
@@ -647,8 +663,10 @@ tp_init_softbuttons(struct tp_dispatch *tp,
 	tp->buttons.bottom_area.middlebutton_left_edge = INT_MAX;
 
 	/* if middlebutton emulation is enabled, don't init a software area */
-	if (device->middlebutton.want_enabled)
+	if (device->middlebutton.want_enabled) {
+		tp_zones_rebuild(tp);
 		return;
+	}
 
 	/* The middle button is 25% of the touchpad and centered. Many
 	 * touchpads don't have markings for the middle button at all so we
@@ -679,6 +697,8 @@ tp_init_softbuttons(struct tp_dispatch *tp,
 
 	tp->buttons.bottom_area.middlebutton_left_edge = mb_le;
 	tp->buttons.bottom_area.rightbutton_left_edge = mb_re;
+
+	tp_zones_rebuild(tp);
 }
 
 void
@@ -711,6 +731,8 @@ tp_init_top_softbuttons(struct tp_dispatch *tp,
 	} else {
 		tp->buttons.top_area.bottom_edge = INT_MIN;
 	}
+
+	tp_zones_rebuild(tp);
 }
 
 static inline uint32_t
@@ -753,6 +775,7 @@ tp_switch_click_method(struct tp_dispatch *tp)
 	case LIBINPUT_CONFIG_CLICK_METHOD_CLICKFINGER:
 	case LIBINPUT_CONFIG_CLICK_METHOD_NONE:
 		tp->buttons.bottom_area.top_edge = INT_MAX;
+		tp_zones_rebuild(tp);
 		break;
 	}
 }
@@ -823,7 +846,7 @@ tp_clickpad_middlebutton_apply_config(struct evdev_device *device)
 	    device->middlebutton.enabled)
 		return;
 
-	device->middlebutton.enabled = device->middlebutton.want_enabled;
+	evdev_middlebutton_splice(device, device->middlebutton.want_enabled);
 	if (tp->buttons.click_method ==
 	    LIBINPUT_CONFIG_CLICK_METHOD_BUTTON_AREAS)
 		tp_init_softbuttons(tp, device);
@@ -875,7 +898,7 @@ tp_init_clickpad_middlebutton_emulation(struct tp_dispatch *tp,
 {
 	device->middlebutton.enabled_default = false;
 	device->middlebutton.want_enabled = false;
-	device->middlebutton.enabled = false;
+	evdev_middlebutton_splice(device, false);
 
 	device->middlebutton.config.available = tp_clickpad_middlebutton_is_available;
 	device->middlebutton.config.set = tp_clickpad_middlebutton_set;
@@ -950,6 +973,44 @@ tp_guess_clickpad(const struct tp_dispatch *tp, struct evdev_device *device)
 	return is_clickpad;
 }
 
+/* Precompute the area-bits-to-button choice, collapsing the per-click
+ * conditional chain in tp_post_clickpadbutton_buttons() into one table
+ * lookup. The first index combines a simultaneous left+right press
+ * into a middle click (middle button emulation or a topbutton pad) */
+static void
+tp_init_clickpad_area_map(struct tp_dispatch *tp)
+{
+	for (unsigned int combine = 0; combine < 2; combine++) {
+		for (unsigned int area = 0;
+		     area < ARRAY_LENGTH(tp->buttons.area_map[0]);
+		     area++) {
+			uint32_t button;
+			bool want_left_handed = true;
+
+			if (combine &&
+			    (area & CLICKPAD_AREA_LEFT) &&
+			    (area & CLICKPAD_AREA_RIGHT)) {
+				button = BTN_MIDDLE;
+			} else if (area & CLICKPAD_AREA_MIDDLE) {
+				button = BTN_MIDDLE;
+			} else if (area & CLICKPAD_AREA_RIGHT) {
+				button = BTN_RIGHT;
+			} else if (area & CLICKPAD_AREA_LEFT) {
+				button = BTN_LEFT;
+			} else {
+				/* main or no area (for clickfinger) is
+				 * always BTN_LEFT */
+				button = BTN_LEFT;
+				want_left_handed = false;
+			}
+
+			tp->buttons.area_map[combine][area].button = button;
+			tp->buttons.area_map[combine][area].want_left_handed =
+				want_left_handed;
+		}
+	}
+}
+
 void
 tp_init_buttons(struct tp_dispatch *tp,
 		struct evdev_device *device)
@@ -979,6 +1040,8 @@ tp_init_buttons(struct tp_dispatch *tp,
 	tp->buttons.click_method = tp_click_get_default_method(tp);
 	tp_switch_click_method(tp);
 
+	tp_init_clickpad_area_map(tp);
+
 	tp_init_top_softbuttons(tp, device, 1.0);
 
 	tp_init_middlebutton_emulation(tp, device);
@@ -1105,6 +1168,10 @@ out:
 static uint32_t
 tp_clickfinger_set_button(struct tp_dispatch *tp)
 {
+	/* finger count to button, anything past the table is no button */
+	static const uint32_t clickfinger_map[] = {
+		BTN_LEFT, BTN_LEFT, BTN_RIGHT, BTN_MIDDLE,
+	};
 	uint32_t button;
 	unsigned int nfingers = 0;
 	struct tp_touch *t;
@@ -1140,15 +1207,8 @@ tp_clickfinger_set_button(struct tp_dispatch *tp)
 		nfingers = 1;
 
 out:
-	switch (nfingers) {
-	case 0:
-	case 1: button = BTN_LEFT; break;
-	case 2: button = BTN_RIGHT; break;
-	case 3: button = BTN_MIDDLE; break;
-	default:
-		button = 0;
-		break;
-	}
+	button = nfingers < ARRAY_LENGTH(clickfinger_map) ?
+			clickfinger_map[nfingers] : 0;
 
 	return button;
 }
@@ -1163,7 +1223,7 @@ tp_notify_clickpadbutton(struct tp_dispatch *tp,
 	/* If we've a trackpoint, send top buttons through the trackpoint */
 	if (tp->buttons.trackpoint) {
 		if (is_topbutton) {
-			struct evdev_dispatch *dispatch = tp->buttons.trackpoint->dispatch;
+			struct evdev_dispatch *dispatch = tp->buttons.trackpoint_dispatch;
 			struct input_event event, syn_report;
 			int value;
 
@@ -1211,8 +1271,7 @@ tp_post_clickpadbutton_buttons(struct tp_dispatch *tp, uint64_t time)
 {
 	uint32_t current, old, button, is_top;
 	enum libinput_button_state state;
-	enum { AREA = 0x01, LEFT = 0x02, MIDDLE = 0x04, RIGHT = 0x08 };
-	bool want_left_handed = true;
+	bool want_left_handed;
 
 	current = tp->buttons.state;
 	old = tp->buttons.old_state;
@@ -1224,29 +1283,30 @@ tp_post_clickpadbutton_buttons(struct tp_dispatch *tp, uint64_t time)
 	if (current) {
 		struct tp_touch *t;
 		uint32_t area = 0;
+		bool combine;
 
 		tp_for_each_touch(tp, t) {
 			switch (t->button.current) {
 			case BUTTON_EVENT_IN_AREA:
-				area |= AREA;
+				area |= CLICKPAD_AREA_MAIN;
 				break;
 			case BUTTON_EVENT_IN_TOP_L:
 				is_top = 1;
 				_fallthrough_;
 			case BUTTON_EVENT_IN_BOTTOM_L:
-				area |= LEFT;
+				area |= CLICKPAD_AREA_LEFT;
 				break;
 			case BUTTON_EVENT_IN_TOP_M:
 				is_top = 1;
 				_fallthrough_;
 			case BUTTON_EVENT_IN_BOTTOM_M:
-				area |= MIDDLE;
+				area |= CLICKPAD_AREA_MIDDLE;
 				break;
 			case BUTTON_EVENT_IN_TOP_R:
 				is_top = 1;
 				_fallthrough_;
 			case BUTTON_EVENT_IN_BOTTOM_R:
-				area |= RIGHT;
+				area |= CLICKPAD_AREA_RIGHT;
 				break;
 			default:
 				break;
@@ -1260,19 +1320,10 @@ tp_post_clickpadbutton_buttons(struct tp_dispatch *tp, uint64_t time)
 			return 0;
 		}
 
-		if ((tp->device->middlebutton.enabled || is_top) &&
-		    (area & LEFT) && (area & RIGHT)) {
-			button = BTN_MIDDLE;
-		} else if (area & MIDDLE) {
-			button = BTN_MIDDLE;
-		} else if (area & RIGHT) {
-			button = BTN_RIGHT;
-		} else if (area & LEFT) {
-			button = BTN_LEFT;
-		} else { /* main or no area (for clickfinger) is always BTN_LEFT */
-			button = BTN_LEFT;
-			want_left_handed = false;
-		}
+		combine = tp->device->middlebutton.enabled || is_top;
+		button = tp->buttons.area_map[combine][area].button;
+		want_left_handed =
+			tp->buttons.area_map[combine][area].want_left_handed;
 
 		if (is_top)
 			want_left_handed = false;
@@ -73,14 +73,17 @@ uint32_t
 tp_touch_get_edge(const struct tp_dispatch *tp, const struct tp_touch *t)
 {
 	uint32_t edge = EDGE_NONE;
+	uint16_t zones;
 
 	if (tp->scroll.method != LIBINPUT_CONFIG_SCROLL_EDGE)
 		return EDGE_NONE;
 
-	if (t->point.x > tp->scroll.right_edge)
+	zones = tp_zones_classify(tp, t->point);
+
+	if (zones & TP_ZONE_SCROLL_RIGHT)
 		edge |= EDGE_RIGHT;
 
-	if (t->point.y > tp->scroll.bottom_edge)
+	if (zones & TP_ZONE_SCROLL_BOTTOM)
 		edge |= EDGE_BOTTOM;
 
 	return edge;
@@ -119,7 +122,7 @@ tp_edge_scroll_set_state(struct tp_dispatch *tp,
 		t->scroll.edge = EDGE_NONE;
 		break;
 	case EDGE_SCROLL_TOUCH_STATE_EDGE_NEW:
-		t->scroll.edge = tp_touch_get_edge(tp, t);
+		t->scroll.edge = t->features.edge;
 		t->scroll.initial = t->point;
 		tp_edge_scroll_set_timer(tp, t, time);
 		break;
@@ -139,7 +142,7 @@ tp_edge_scroll_handle_none(struct tp_dispatch *tp,
 {
 	switch (event) {
 	case SCROLL_EVENT_TOUCH:
-		if (tp_touch_get_edge(tp, t)) {
+		if (t->features.edge) {
 			tp_edge_scroll_set_state(tp,
 						 t,
 						 EDGE_SCROLL_TOUCH_STATE_EDGE_NEW,
@@ -177,7 +180,7 @@ tp_edge_scroll_handle_edge_new(struct tp_dispatch *tp,
 			       event);
 		break;
 	case SCROLL_EVENT_MOTION:
-		t->scroll.edge &= tp_touch_get_edge(tp, t);
+		t->scroll.edge &= t->features.edge;
 		if (!t->scroll.edge)
 			tp_edge_scroll_set_state(tp,
 						 t,
@@ -217,7 +220,7 @@ tp_edge_scroll_handle_edge(struct tp_dispatch *tp,
 	case SCROLL_EVENT_MOTION:
 		/* If started at the bottom right, decide in which dir to scroll */
 		if (t->scroll.edge == (EDGE_RIGHT | EDGE_BOTTOM)) {
-			t->scroll.edge &= tp_touch_get_edge(tp, t);
+			t->scroll.edge &= t->features.edge;
 			if (!t->scroll.edge)
 				tp_edge_scroll_set_state(tp,
 							 t,
@@ -332,6 +335,8 @@ tp_edge_scroll_init(struct tp_dispatch *tp, struct evdev_device *device)
 	else
 		tp->scroll.bottom_edge = INT_MAX;
 
+	tp_zones_rebuild(tp);
+
 	i = 0;
 	tp_for_each_touch(tp, t) {
 		char timer_name[64];
@@ -377,10 +382,7 @@ tp_edge_scroll_handle_state(struct tp_dispatch *tp, uint64_t time)
 		return;
 	}
 
-	tp_for_each_touch(tp, t) {
-		if (!t->dirty)
-			continue;
-
+	tp_for_each_dirty_touch(tp, t) {
 		switch (t->state) {
 		case TOUCH_NONE:
 		case TOUCH_HOVERING:
@@ -427,16 +429,13 @@ tp_edge_scroll_post_events(struct tp_dispatch *tp, uint64_t time)
 	struct normalized_coords normalized, tmp;
 	const struct normalized_coords zero = { 0.0, 0.0 };
 
-	tp_for_each_touch(tp, t) {
-		if (!t->dirty)
-			continue;
-
+	tp_for_each_dirty_touch(tp, t) {
 		if (t->palm.state != PALM_NONE || tp_thumb_ignored(tp, t))
 			continue;
 
 		/* only scroll with the finger in the previous edge */
 		if (t->scroll.edge &&
-		    (tp_touch_get_edge(tp, t) & t->scroll.edge) == 0)
+		    (t->features.edge & t->scroll.edge) == 0)
 			continue;
 
 		switch (t->scroll.edge) {
@@ -510,6 +509,12 @@ tp_edge_scroll_stop_events(struct tp_dispatch *tp, uint64_t time)
 	struct tp_touch *t;
 	const struct normalized_coords zero = { 0.0, 0.0 };
 
+	/* No touch can be in an edge scroll state unless edge scrolling
+	 * is the selected method, skip the slot sweep. The config path
+	 * switching methods calls us before the method changes. */
+	if (tp->scroll.method != LIBINPUT_CONFIG_SCROLL_EDGE)
+		return;
+
 	tp_for_each_touch(tp, t) {
 		if (t->scroll.direction != -1) {
 			evdev_notify_axis_finger(device,
@@ -147,6 +147,19 @@ tp_get_average_touches_delta(struct tp_dispatch *tp)
 	return tp_get_touches_delta(tp, true);
 }
 
+/* Valid before tp_gesture_start() latches drag_3fg_active; afterwards
+ * the latch decides, so toggling the config mid-gesture cannot leave
+ * the button stuck */
+static bool
+tp_gesture_is_3fg_drag(struct tp_dispatch *tp)
+{
+	if (tp->gesture.started)
+		return tp->gesture.drag_3fg_active;
+
+	return tp->gesture.drag_3fg_enabled &&
+	       tp->gesture.finger_count == 3;
+}
+
 static void
 tp_gesture_start(struct tp_dispatch *tp, uint64_t time)
 {
@@ -177,10 +190,18 @@ tp_gesture_start(struct tp_dispatch *tp, uint64_t time)
 				    &zero, &zero, 1.0, 0.0);
 		break;
 	case GESTURE_STATE_SWIPE:
-		gesture_notify_swipe(&tp->device->base, time,
-				     LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN,
-				     tp->gesture.finger_count,
-				     &zero, &zero);
+		if (tp_gesture_is_3fg_drag(tp)) {
+			tp->gesture.drag_3fg_active = true;
+			evdev_pointer_notify_button(tp->device,
+						    time,
+						    BTN_LEFT,
+						    LIBINPUT_BUTTON_STATE_PRESSED);
+		} else {
+			gesture_notify_swipe(&tp->device->base, time,
+					     LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN,
+					     tp->gesture.finger_count,
+					     &zero, &zero);
+		}
 		break;
 	case GESTURE_STATE_POINTER_MOTION:
 		break;
@@ -287,27 +308,58 @@ tp_gesture_same_directions(int dir1, int dir2)
 		((dir2 & 0x80) && (dir1 & 0x01));
 }
 
-static struct phys_coords
-tp_gesture_mm_moved(struct tp_dispatch *tp, struct tp_touch *t)
+/* Reset the cached geometry when the gesture (re)starts from the touch's
+ * current position.
+ */
+static inline void
+tp_gesture_init_geometry(struct tp_touch *t)
+{
+	t->gesture.cached_point = t->point;
+	t->gesture.moved_mm.x = 0.0;
+	t->gesture.moved_mm.y = 0.0;
+	t->gesture.direction = UNDEFINED_DIRECTION;
+}
+
+/* The detector re-reads the movement-from-initial and direction of its
+ * tracked touches on every frame while a gesture is pending. Both only
+ * change when the touch position does, so recompute them lazily and keep
+ * the result until the touch moves again.
+ */
+static void
+tp_gesture_update_geometry(struct tp_dispatch *tp, struct tp_touch *t)
 {
 	struct device_coords delta;
+	struct device_float_coords fdelta;
+
+	if (t->point.x == t->gesture.cached_point.x &&
+	    t->point.y == t->gesture.cached_point.y)
+		return;
 
 	delta.x = abs(t->point.x - t->gesture.initial.x);
 	delta.y = abs(t->point.y - t->gesture.initial.y);
+	t->gesture.moved_mm = evdev_device_unit_delta_to_mm(tp->device,
+							    &delta);
+
+	fdelta = device_delta(t->point, t->gesture.initial);
+	t->gesture.direction = phys_get_direction(tp_phys_delta(tp, fdelta));
 
-	return evdev_device_unit_delta_to_mm(tp->device, &delta);
+	t->gesture.cached_point = t->point;
+}
+
+static struct phys_coords
+tp_gesture_mm_moved(struct tp_dispatch *tp, struct tp_touch *t)
+{
+	tp_gesture_update_geometry(tp, t);
+
+	return t->gesture.moved_mm;
 }
 
 static uint32_t
 tp_gesture_get_direction(struct tp_dispatch *tp, struct tp_touch *touch)
 {
-	struct phys_coords mm;
-	struct device_float_coords delta;
-
-	delta = device_delta(touch->point, touch->gesture.initial);
-	mm = tp_phys_delta(tp, delta);
+	tp_gesture_update_geometry(tp, touch);
 
-	return phys_get_direction(mm);
+	return touch->gesture.direction;
 }
 
 static void
@@ -790,6 +842,29 @@ tp_gesture_handle_event_on_state_swipe(struct tp_dispatch *tp,
 	}
 }
 
+static enum libinput_gesture_hint
+gesture_state_to_hint(enum tp_gesture_state state)
+{
+	switch (state) {
+	case GESTURE_STATE_UNKNOWN:
+		return LIBINPUT_GESTURE_HINT_UNKNOWN;
+	case GESTURE_STATE_HOLD:
+	case GESTURE_STATE_HOLD_AND_MOTION:
+		return LIBINPUT_GESTURE_HINT_HOLD;
+	case GESTURE_STATE_SCROLL:
+		return LIBINPUT_GESTURE_HINT_SCROLL;
+	case GESTURE_STATE_SWIPE:
+		return LIBINPUT_GESTURE_HINT_SWIPE;
+	case GESTURE_STATE_PINCH:
+		return LIBINPUT_GESTURE_HINT_PINCH;
+	case GESTURE_STATE_NONE:
+	case GESTURE_STATE_POINTER_MOTION:
+		break;
+	}
+
+	return LIBINPUT_GESTURE_HINT_NONE;
+}
+
 static void
 tp_gesture_handle_event(struct tp_dispatch *tp,
 			enum gesture_event event,
@@ -827,6 +902,8 @@ tp_gesture_handle_event(struct tp_dispatch *tp,
 	}
 
 	if (oldstate != tp->gesture.state) {
+		tp->device->base.gesture_hint =
+			gesture_state_to_hint(tp->gesture.state);
 		evdev_log_debug(tp->device,
 				"gesture state %s → %s → %s\n",
 				gesture_state_to_str(oldstate),
@@ -1062,6 +1139,7 @@ tp_gesture_handle_state_none(struct tp_dispatch *tp, uint64_t time)
 
 	if (ntouches == 1) {
 		first->gesture.initial = first->point;
+		tp_gesture_init_geometry(first);
 		tp->gesture.touches[0] = first;
 
 		tp_gesture_handle_event(tp,
@@ -1112,6 +1190,8 @@ tp_gesture_handle_state_none(struct tp_dispatch *tp, uint64_t time)
 	tp->gesture.initial_time = time;
 	first->gesture.initial = first->point;
 	second->gesture.initial = second->point;
+	tp_gesture_init_geometry(first);
+	tp_gesture_init_geometry(second);
 	tp->gesture.touches[0] = first;
 	tp->gesture.touches[1] = second;
 
@@ -1152,11 +1232,48 @@ tp_gesture_handle_state_pointer_motion(struct tp_dispatch *tp, uint64_t time)
 		tp_gesture_post_pointer_motion(tp, time);
 }
 
+static void
+tp_gesture_flush_scroll_batch(struct tp_dispatch *tp, uint64_t time)
+{
+	struct device_float_coords raw = tp->gesture.scroll_batch;
+	struct normalized_coords delta;
+
+	tp->gesture.scroll_batch.x = 0.0;
+	tp->gesture.scroll_batch.y = 0.0;
+
+	/* scroll is not accelerated; the unaccelerated filter is linear,
+	 * so filtering the aggregate is equivalent to filtering each
+	 * frame separately */
+	delta = tp_filter_motion_unaccelerated(tp, &raw, time);
+
+	if (normalized_is_zero(delta))
+		return;
+
+	tp_gesture_start(tp, time);
+	tp_gesture_apply_scroll_constraints(tp, &raw, &delta, time);
+	evdev_post_scroll(tp->device,
+			  time,
+			  LIBINPUT_POINTER_AXIS_SOURCE_FINGER,
+			  &delta);
+}
+
+static void
+tp_gesture_scroll_batch_timeout(uint64_t now, void *data)
+{
+	struct tp_dispatch *tp = data;
+
+	if (!tp->gesture.scroll_batch_pending)
+		return;
+
+	tp->gesture.scroll_batch_pending = false;
+	tp->gesture.scroll_last_flush_time = now;
+	tp_gesture_flush_scroll_batch(tp, now);
+}
+
 static void
 tp_gesture_handle_state_scroll(struct tp_dispatch *tp, uint64_t time)
 {
 	struct device_float_coords raw;
-	struct normalized_coords delta;
 
 	if (tp->scroll.method != LIBINPUT_CONFIG_SCROLL_2FG)
 		return;
@@ -1172,19 +1289,28 @@ tp_gesture_handle_state_scroll(struct tp_dispatch *tp, uint64_t time)
 	}
 
 	raw = tp_get_average_touches_delta(tp);
+	tp->gesture.scroll_batch.x += raw.x;
+	tp->gesture.scroll_batch.y += raw.y;
 
-	/* scroll is not accelerated */
-	delta = tp_filter_motion_unaccelerated(tp, &raw, time);
-
-	if (normalized_is_zero(delta))
+	if (tp->gesture.scroll_batch_window == 0) {
+		tp_gesture_flush_scroll_batch(tp, time);
 		return;
+	}
 
-	tp_gesture_start(tp, time);
-	tp_gesture_apply_scroll_constraints(tp, &raw, &delta, time);
-	evdev_post_scroll(tp->device,
-			  time,
-			  LIBINPUT_POINTER_AXIS_SOURCE_FINGER,
-			  &delta);
+	/* Batching: the first frame after an idle period flushes
+	 * immediately so slow scrolls keep their latency; during a
+	 * burst (high-rate touchpads) the deltas accumulate and the
+	 * timer posts one aggregated event per window. */
+	if (time - tp->gesture.scroll_last_flush_time >=
+	    tp->gesture.scroll_batch_window) {
+		tp_gesture_flush_scroll_batch(tp, time);
+		tp->gesture.scroll_last_flush_time = time;
+	} else if (!tp->gesture.scroll_batch_pending) {
+		libinput_timer_set(&tp->gesture.scroll_batch_timer,
+				   tp->gesture.scroll_last_flush_time +
+					tp->gesture.scroll_batch_window);
+		tp->gesture.scroll_batch_pending = true;
+	}
 }
 
 static void
@@ -1197,12 +1323,25 @@ tp_gesture_handle_state_swipe(struct tp_dispatch *tp, uint64_t time)
 	delta = tp_filter_motion(tp, &raw, time);
 
 	if (!normalized_is_zero(delta) || !device_float_is_zero(raw)) {
-		unaccel = tp_filter_motion_unaccelerated(tp, &raw, time);
 		tp_gesture_start(tp, time);
-		gesture_notify_swipe(&tp->device->base, time,
-				     LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE,
-				     tp->gesture.finger_count,
-				     &delta, &unaccel);
+
+		if (tp->gesture.drag_3fg_active) {
+			struct device_float_coords xunaccel =
+				tp_scale_to_xaxis(tp, raw);
+
+			pointer_notify_motion(&tp->device->base,
+					      time,
+					      &delta,
+					      &xunaccel);
+		} else {
+			unaccel = tp_filter_motion_unaccelerated(tp,
+								 &raw,
+								 time);
+			gesture_notify_swipe(&tp->device->base, time,
+					     LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE,
+					     tp->gesture.finger_count,
+					     &delta, &unaccel);
+		}
 	}
 }
 
@@ -1288,6 +1427,40 @@ tp_gesture_thumb_moved(struct tp_dispatch *tp)
 	return thumb_mm >= PINCH_DISAMBIGUATION_MOVE_THRESHOLD;
 }
 
+static bool
+tp_gesture_run_matchers(struct tp_dispatch *tp, uint64_t time)
+{
+	struct libinput *libinput = tp_libinput_context(tp);
+	struct libinput_gesture_frame frame = {0};
+	struct tp_touch *touches[4];
+	struct device_float_coords raw;
+	struct phys_coords mm;
+	unsigned int i;
+
+	if (list_empty(&libinput->gesture_matchers))
+		return false;
+
+	frame.time = time;
+	frame.finger_count = tp->gesture.finger_count;
+	frame.ntouches = tp_gesture_get_active_touches(tp,
+						       touches,
+						       ARRAY_LENGTH(touches));
+	for (i = 0; i < frame.ntouches; i++) {
+		mm = evdev_device_units_to_mm(tp->device, &touches[i]->point);
+		frame.touches[i].x = mm.x;
+		frame.touches[i].y = mm.y;
+	}
+
+	raw = tp_get_average_touches_delta(tp);
+	mm = tp_phys_delta(tp, raw);
+	frame.dx = mm.x;
+	frame.dy = mm.y;
+
+	return libinput_run_gesture_matchers(libinput,
+					     &tp->device->base,
+					     &frame);
+}
+
 void
 tp_gesture_post_events(struct tp_dispatch *tp, uint64_t time,
 		       bool ignore_motion)
@@ -1323,6 +1496,11 @@ tp_gesture_post_events(struct tp_dispatch *tp, uint64_t time,
 	    tp_gesture_thumb_moved(tp))
 		tp_thumb_reset(tp);
 
+	/* Registered matchers see the frame first; a claimed frame skips
+	 * the built-in gesture detection entirely. */
+	if (tp_gesture_run_matchers(tp, time))
+		return;
+
 	if (tp->gesture.finger_count <= 4)
 		tp_gesture_post_gesture(tp, time, ignore_motion);
 }
@@ -1361,6 +1539,11 @@ tp_gesture_end(struct tp_dispatch *tp, uint64_t time, bool cancelled)
 					tp->gesture.finger_count, cancelled);
 		break;
 	case GESTURE_STATE_SCROLL:
+		if (tp->gesture.scroll_batch_pending) {
+			libinput_timer_cancel(&tp->gesture.scroll_batch_timer);
+			tp->gesture.scroll_batch_pending = false;
+			tp_gesture_flush_scroll_batch(tp, time);
+		}
 		tp_gesture_stop_twofinger_scroll(tp, time);
 		break;
 	case GESTURE_STATE_PINCH:
@@ -1370,10 +1553,18 @@ tp_gesture_end(struct tp_dispatch *tp, uint64_t time, bool cancelled)
 					 cancelled);
 		break;
 	case GESTURE_STATE_SWIPE:
-		gesture_notify_swipe_end(&tp->device->base,
-					 time,
-					 tp->gesture.finger_count,
-					 cancelled);
+		if (tp->gesture.drag_3fg_active) {
+			tp->gesture.drag_3fg_active = false;
+			evdev_pointer_notify_button(tp->device,
+						    time,
+						    BTN_LEFT,
+						    LIBINPUT_BUTTON_STATE_RELEASED);
+		} else {
+			gesture_notify_swipe_end(&tp->device->base,
+						 time,
+						 tp->gesture.finger_count,
+						 cancelled);
+		}
 		break;
 	case GESTURE_STATE_POINTER_MOTION:
 		break;
@@ -1498,6 +1689,63 @@ tp_gesture_get_hold_default(struct libinput_device *device)
 	       LIBINPUT_CONFIG_HOLD_DISABLED;
 }
 
+static enum libinput_config_status
+tp_gesture_set_3fg_drag_enabled(struct libinput_device *device,
+				enum libinput_config_3fg_drag_state enabled)
+{
+	struct evdev_dispatch *dispatch = evdev_device(device)->dispatch;
+	struct tp_dispatch *tp = tp_dispatch(dispatch);
+
+	tp->gesture.drag_3fg_enabled =
+		(enabled == LIBINPUT_CONFIG_3FG_DRAG_ENABLED);
+
+	return LIBINPUT_CONFIG_STATUS_SUCCESS;
+}
+
+static enum libinput_config_3fg_drag_state
+tp_gesture_get_3fg_drag_enabled(struct libinput_device *device)
+{
+	struct evdev_dispatch *dispatch = evdev_device(device)->dispatch;
+	struct tp_dispatch *tp = tp_dispatch(dispatch);
+
+	return tp->gesture.drag_3fg_enabled ?
+	       LIBINPUT_CONFIG_3FG_DRAG_ENABLED :
+	       LIBINPUT_CONFIG_3FG_DRAG_DISABLED;
+}
+
+static enum libinput_config_3fg_drag_state
+tp_gesture_get_3fg_drag_default(struct libinput_device *device)
+{
+	return LIBINPUT_CONFIG_3FG_DRAG_DISABLED;
+}
+
+static enum libinput_config_status
+tp_gesture_set_scroll_batch_window(struct libinput_device *device,
+				   uint32_t window_ms)
+{
+	struct evdev_dispatch *dispatch = evdev_device(device)->dispatch;
+	struct tp_dispatch *tp = tp_dispatch(dispatch);
+
+	tp->gesture.scroll_batch_window = ms2us(window_ms);
+
+	return LIBINPUT_CONFIG_STATUS_SUCCESS;
+}
+
+static uint32_t
+tp_gesture_get_scroll_batch_window(struct libinput_device *device)
+{
+	struct evdev_dispatch *dispatch = evdev_device(device)->dispatch;
+	struct tp_dispatch *tp = tp_dispatch(dispatch);
+
+	return us2ms(tp->gesture.scroll_batch_window);
+}
+
+static uint32_t
+tp_gesture_get_scroll_batch_window_default(struct libinput_device *device)
+{
+	return 0;
+}
+
 void
 tp_init_gesture(struct tp_dispatch *tp)
 {
@@ -1506,6 +1754,18 @@ tp_init_gesture(struct tp_dispatch *tp)
 	tp->gesture.config.set_hold_enabled = tp_gesture_set_hold_enabled;
 	tp->gesture.config.get_hold_enabled = tp_gesture_is_hold_enabled;
 	tp->gesture.config.get_hold_default = tp_gesture_get_hold_default;
+	tp->gesture.config.set_scroll_batch_window =
+		tp_gesture_set_scroll_batch_window;
+	tp->gesture.config.get_scroll_batch_window =
+		tp_gesture_get_scroll_batch_window;
+	tp->gesture.config.get_scroll_batch_window_default =
+		tp_gesture_get_scroll_batch_window_default;
+	tp->gesture.config.set_3fg_drag_enabled =
+		tp_gesture_set_3fg_drag_enabled;
+	tp->gesture.config.get_3fg_drag_enabled =
+		tp_gesture_get_3fg_drag_enabled;
+	tp->gesture.config.get_3fg_drag_default =
+		tp_gesture_get_3fg_drag_default;
 	tp->device->base.config.gesture = &tp->gesture.config;
 
 	/* two-finger scrolling is always enabled, this flag just
@@ -1533,6 +1793,15 @@ tp_init_gesture(struct tp_dispatch *tp)
 			    tp_libinput_context(tp),
 			    timer_name,
 			    tp_gesture_hold_timeout, tp);
+
+	snprintf(timer_name,
+		 sizeof(timer_name),
+		 "%s scroll batch",
+		 evdev_device_get_sysname(tp->device));
+	libinput_timer_init(&tp->gesture.scroll_batch_timer,
+			    tp_libinput_context(tp),
+			    timer_name,
+			    tp_gesture_scroll_batch_timeout, tp);
 }
 
 void
@@ -1540,4 +1809,5 @@ tp_remove_gesture(struct tp_dispatch *tp)
 {
 	libinput_timer_cancel(&tp->gesture.finger_count_switch_timer);
 	libinput_timer_cancel(&tp->gesture.hold_timer);
+	libinput_timer_cancel(&tp->gesture.scroll_batch_timer);
 }
@@ -119,24 +119,35 @@ log_tap_bug(struct tp_dispatch *tp, struct tp_touch *t, enum tap_event event)
 
 }
 
+/* Rebuild the finger-count-to-button table, called when a new map is
+ * committed so tp_tap_notify() is a plain lookup */
 static void
-tp_tap_notify(struct tp_dispatch *tp,
-	      uint64_t time,
-	      int nfingers,
-	      enum libinput_button_state state)
+tp_tap_rebuild_button_map(struct tp_dispatch *tp)
 {
-	int32_t button;
-	int32_t button_map[2][3] = {
+	static const int32_t button_map[2][3] = {
 		{ BTN_LEFT, BTN_RIGHT, BTN_MIDDLE },
 		{ BTN_LEFT, BTN_MIDDLE, BTN_RIGHT },
 	};
 
 	assert(tp->tap.map < ARRAY_LENGTH(button_map));
 
+	memcpy(tp->tap.button_map,
+	       button_map[tp->tap.map],
+	       sizeof(tp->tap.button_map));
+}
+
+static void
+tp_tap_notify(struct tp_dispatch *tp,
+	      uint64_t time,
+	      int nfingers,
+	      enum libinput_button_state state)
+{
+	int32_t button;
+
 	if (nfingers < 1 || nfingers > 3)
 		return;
 
-	button = button_map[tp->tap.map][nfingers - 1];
+	button = tp->tap.button_map[nfingers - 1];
 
 	if (state == LIBINPUT_BUTTON_STATE_PRESSED)
 		tp->tap.buttons_pressed |= (1 << nfingers);
@@ -189,7 +200,8 @@ tp_tap_move_to_dead(struct tp_dispatch *tp, struct tp_touch *t)
 static void
 tp_tap_idle_handle_event(struct tp_dispatch *tp,
 			 struct tp_touch *t,
-			 enum tap_event event, uint64_t time)
+			 enum tap_event event, uint64_t time,
+			 int nfingers)
 {
 	switch (event) {
 	case TAP_EVENT_TOUCH:
@@ -221,7 +233,8 @@ tp_tap_idle_handle_event(struct tp_dispatch *tp,
 static void
 tp_tap_touch_handle_event(struct tp_dispatch *tp,
 			  struct tp_touch *t,
-			  enum tap_event event, uint64_t time)
+			  enum tap_event event, uint64_t time,
+			  int nfingers)
 {
 
 	switch (event) {
@@ -277,7 +290,8 @@ tp_tap_touch_handle_event(struct tp_dispatch *tp,
 static void
 tp_tap_hold_handle_event(struct tp_dispatch *tp,
 			 struct tp_touch *t,
-			 enum tap_event event, uint64_t time)
+			 enum tap_event event, uint64_t time,
+			 int nfingers)
 {
 
 	switch (event) {
@@ -362,7 +376,8 @@ tp_tap_tapped_handle_event(struct tp_dispatch *tp,
 static void
 tp_tap_touch2_handle_event(struct tp_dispatch *tp,
 			   struct tp_touch *t,
-			   enum tap_event event, uint64_t time)
+			   enum tap_event event, uint64_t time,
+			   int nfingers)
 {
 
 	switch (event) {
@@ -399,7 +414,8 @@ tp_tap_touch2_handle_event(struct tp_dispatch *tp,
 static void
 tp_tap_touch2_hold_handle_event(struct tp_dispatch *tp,
 				struct tp_touch *t,
-				enum tap_event event, uint64_t time)
+				enum tap_event event, uint64_t time,
+				int nfingers)
 {
 
 	switch (event) {
@@ -433,7 +449,8 @@ tp_tap_touch2_hold_handle_event(struct tp_dispatch *tp,
 static void
 tp_tap_touch2_release_handle_event(struct tp_dispatch *tp,
 				   struct tp_touch *t,
-				   enum tap_event event, uint64_t time)
+				   enum tap_event event, uint64_t time,
+				   int nfingers)
 {
 
 	switch (event) {
@@ -501,7 +518,8 @@ tp_tap_touch2_release_handle_event(struct tp_dispatch *tp,
 static void
 tp_tap_touch3_handle_event(struct tp_dispatch *tp,
 			   struct tp_touch *t,
-			   enum tap_event event, uint64_t time)
+			   enum tap_event event, uint64_t time,
+			   int nfingers)
 {
 
 	switch (event) {
@@ -538,7 +556,8 @@ tp_tap_touch3_handle_event(struct tp_dispatch *tp,
 static void
 tp_tap_touch3_hold_handle_event(struct tp_dispatch *tp,
 				struct tp_touch *t,
-				enum tap_event event, uint64_t time)
+				enum tap_event event, uint64_t time,
+				int nfingers)
 {
 
 	switch (event) {
@@ -570,7 +589,8 @@ tp_tap_touch3_hold_handle_event(struct tp_dispatch *tp,
 static void
 tp_tap_touch3_release_handle_event(struct tp_dispatch *tp,
 				   struct tp_touch *t,
-				   enum tap_event event, uint64_t time)
+				   enum tap_event event, uint64_t time,
+				   int nfingers)
 {
 
 	switch (event) {
@@ -637,7 +657,8 @@ tp_tap_touch3_release_handle_event(struct tp_dispatch *tp,
 static void
 tp_tap_touch3_release2_handle_event(struct tp_dispatch *tp,
 				    struct tp_touch *t,
-				    enum tap_event event, uint64_t time)
+				    enum tap_event event, uint64_t time,
+				    int nfingers)
 {
 
 	switch (event) {
@@ -1019,7 +1040,8 @@ static void
 tp_tap_dead_handle_event(struct tp_dispatch *tp,
 			 struct tp_touch *t,
 			 enum tap_event event,
-			 uint64_t time)
+			 uint64_t time,
+			 int nfingers)
 {
 
 	switch (event) {
@@ -1042,108 +1064,104 @@ tp_tap_dead_handle_event(struct tp_dispatch *tp,
 	}
 }
 
+/* Dense dispatch table for the tap state machine, indexed by state. The
+ * event-specific actions stay inside the per-state handlers; this table
+ * replaces the 29-case dispatch switch with one load and an indirect
+ * call, and folds the 1/2/3-finger state triplets onto their shared
+ * handler via the nfingers argument.
+ *
+ * Every state must have an entry here, tp_tap_handle_event() asserts
+ * that when adding new states.
+ */
+#define TAP_STATE_INDEX(state_) ((state_) - TAP_STATE_IDLE)
+
+static const struct tap_state_entry {
+	void (*handle)(struct tp_dispatch *tp,
+		       struct tp_touch *t,
+		       enum tap_event event,
+		       uint64_t time,
+		       int nfingers);
+	int nfingers;
+} tap_state_table[] = {
+	[TAP_STATE_INDEX(TAP_STATE_IDLE)] = {
+		tp_tap_idle_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_TOUCH)] = {
+		tp_tap_touch_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_HOLD)] = {
+		tp_tap_hold_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_1FGTAP_TAPPED)] = {
+		tp_tap_tapped_handle_event, 1 },
+	[TAP_STATE_INDEX(TAP_STATE_2FGTAP_TAPPED)] = {
+		tp_tap_tapped_handle_event, 2 },
+	[TAP_STATE_INDEX(TAP_STATE_3FGTAP_TAPPED)] = {
+		tp_tap_tapped_handle_event, 3 },
+	[TAP_STATE_INDEX(TAP_STATE_TOUCH_2)] = {
+		tp_tap_touch2_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_TOUCH_2_HOLD)] = {
+		tp_tap_touch2_hold_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_TOUCH_2_RELEASE)] = {
+		tp_tap_touch2_release_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_TOUCH_3)] = {
+		tp_tap_touch3_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_TOUCH_3_HOLD)] = {
+		tp_tap_touch3_hold_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_TOUCH_3_RELEASE)] = {
+		tp_tap_touch3_release_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_TOUCH_3_RELEASE_2)] = {
+		tp_tap_touch3_release2_handle_event, 0 },
+	[TAP_STATE_INDEX(TAP_STATE_1FGTAP_DRAGGING_OR_DOUBLETAP)] = {
+		tp_tap_dragging_or_doubletap_handle_event, 1 },
+	[TAP_STATE_INDEX(TAP_STATE_2FGTAP_DRAGGING_OR_DOUBLETAP)] = {
+		tp_tap_dragging_or_doubletap_handle_event, 2 },
+	[TAP_STATE_INDEX(TAP_STATE_3FGTAP_DRAGGING_OR_DOUBLETAP)] = {
+		tp_tap_dragging_or_doubletap_handle_event, 3 },
+	[TAP_STATE_INDEX(TAP_STATE_1FGTAP_DRAGGING_OR_TAP)] = {
+		tp_tap_dragging_tap_handle_event, 1 },
+	[TAP_STATE_INDEX(TAP_STATE_2FGTAP_DRAGGING_OR_TAP)] = {
+		tp_tap_dragging_tap_handle_event, 2 },
+	[TAP_STATE_INDEX(TAP_STATE_3FGTAP_DRAGGING_OR_TAP)] = {
+		tp_tap_dragging_tap_handle_event, 3 },
+	[TAP_STATE_INDEX(TAP_STATE_1FGTAP_DRAGGING)] = {
+		tp_tap_dragging_handle_event, 1 },
+	[TAP_STATE_INDEX(TAP_STATE_2FGTAP_DRAGGING)] = {
+		tp_tap_dragging_handle_event, 2 },
+	[TAP_STATE_INDEX(TAP_STATE_3FGTAP_DRAGGING)] = {
+		tp_tap_dragging_handle_event, 3 },
+	[TAP_STATE_INDEX(TAP_STATE_1FGTAP_DRAGGING_WAIT)] = {
+		tp_tap_dragging_wait_handle_event, 1 },
+	[TAP_STATE_INDEX(TAP_STATE_2FGTAP_DRAGGING_WAIT)] = {
+		tp_tap_dragging_wait_handle_event, 2 },
+	[TAP_STATE_INDEX(TAP_STATE_3FGTAP_DRAGGING_WAIT)] = {
+		tp_tap_dragging_wait_handle_event, 3 },
+	[TAP_STATE_INDEX(TAP_STATE_1FGTAP_DRAGGING_2)] = {
+		tp_tap_dragging2_handle_event, 1 },
+	[TAP_STATE_INDEX(TAP_STATE_2FGTAP_DRAGGING_2)] = {
+		tp_tap_dragging2_handle_event, 2 },
+	[TAP_STATE_INDEX(TAP_STATE_3FGTAP_DRAGGING_2)] = {
+		tp_tap_dragging2_handle_event, 3 },
+	[TAP_STATE_INDEX(TAP_STATE_DEAD)] = {
+		tp_tap_dead_handle_event, 0 },
+};
+
 static void
 tp_tap_handle_event(struct tp_dispatch *tp,
 		    struct tp_touch *t,
 		    enum tap_event event,
 		    uint64_t time)
 {
+	const struct tap_state_entry *entry;
 	enum tp_tap_state current;
 
 	current = tp->tap.state;
 
-	switch(tp->tap.state) {
-	case TAP_STATE_IDLE:
-		tp_tap_idle_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_TOUCH:
-		tp_tap_touch_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_HOLD:
-		tp_tap_hold_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_1FGTAP_TAPPED:
-		tp_tap_tapped_handle_event(tp, t, event, time, 1);
-		break;
-	case TAP_STATE_2FGTAP_TAPPED:
-		tp_tap_tapped_handle_event(tp, t, event, time, 2);
-		break;
-	case TAP_STATE_3FGTAP_TAPPED:
-		tp_tap_tapped_handle_event(tp, t, event, time, 3);
-		break;
-	case TAP_STATE_TOUCH_2:
-		tp_tap_touch2_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_TOUCH_2_HOLD:
-		tp_tap_touch2_hold_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_TOUCH_2_RELEASE:
-		tp_tap_touch2_release_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_TOUCH_3:
-		tp_tap_touch3_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_TOUCH_3_HOLD:
-		tp_tap_touch3_hold_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_TOUCH_3_RELEASE:
-		tp_tap_touch3_release_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_TOUCH_3_RELEASE_2:
-		tp_tap_touch3_release2_handle_event(tp, t, event, time);
-		break;
-	case TAP_STATE_1FGTAP_DRAGGING_OR_DOUBLETAP:
-		tp_tap_dragging_or_doubletap_handle_event(tp, t, event, time,
-							  1);
-		break;
-	case TAP_STATE_2FGTAP_DRAGGING_OR_DOUBLETAP:
-		tp_tap_dragging_or_doubletap_handle_event(tp, t, event, time,
-							  2);
-		break;
-	case TAP_STATE_3FGTAP_DRAGGING_OR_DOUBLETAP:
-		tp_tap_dragging_or_doubletap_handle_event(tp, t, event, time,
-							  3);
-		break;
-	case TAP_STATE_1FGTAP_DRAGGING:
-		tp_tap_dragging_handle_event(tp, t, event, time, 1);
-		break;
-	case TAP_STATE_2FGTAP_DRAGGING:
-		tp_tap_dragging_handle_event(tp, t, event, time, 2);
-		break;
-	case TAP_STATE_3FGTAP_DRAGGING:
-		tp_tap_dragging_handle_event(tp, t, event, time, 3);
-		break;
-	case TAP_STATE_1FGTAP_DRAGGING_WAIT:
-		tp_tap_dragging_wait_handle_event(tp, t, event, time, 1);
-		break;
-	case TAP_STATE_2FGTAP_DRAGGING_WAIT:
-		tp_tap_dragging_wait_handle_event(tp, t, event, time, 2);
-		break;
-	case TAP_STATE_3FGTAP_DRAGGING_WAIT:
-		tp_tap_dragging_wait_handle_event(tp, t, event, time, 3);
-		break;
-	case TAP_STATE_1FGTAP_DRAGGING_OR_TAP:
-		tp_tap_dragging_tap_handle_event(tp, t, event, time, 1);
-		break;
-	case TAP_STATE_2FGTAP_DRAGGING_OR_TAP:
-		tp_tap_dragging_tap_handle_event(tp, t, event, time, 2);
-		break;
-	case TAP_STATE_3FGTAP_DRAGGING_OR_TAP:
-		tp_tap_dragging_tap_handle_event(tp, t, event, time, 3);
-		break;
-	case TAP_STATE_1FGTAP_DRAGGING_2:
-		tp_tap_dragging2_handle_event(tp, t, event, time, 1);
-		break;
-	case TAP_STATE_2FGTAP_DRAGGING_2:
-		tp_tap_dragging2_handle_event(tp, t, event, time, 2);
-		break;
-	case TAP_STATE_3FGTAP_DRAGGING_2:
-		tp_tap_dragging2_handle_event(tp, t, event, time, 3);
-		break;
-	case TAP_STATE_DEAD:
-		tp_tap_dead_handle_event(tp, t, event, time);
-		break;
-	}
+	static_assert(ARRAY_LENGTH(tap_state_table) ==
+		      TAP_STATE_INDEX(TAP_STATE_DEAD) + 1,
+		      "tap state table out of sync with enum tp_tap_state");
+	assert(current >= TAP_STATE_IDLE && current <= TAP_STATE_DEAD);
+
+	entry = &tap_state_table[TAP_STATE_INDEX(current)];
+	assert(entry->handle); /* catches gaps in the table */
+	entry->handle(tp, t, event, time, entry->nfingers);
 
 	if (tp->tap.state == TAP_STATE_IDLE || tp->tap.state == TAP_STATE_DEAD)
 		tp_tap_clear_timer(tp);
@@ -1210,8 +1228,8 @@ tp_tap_handle_state(struct tp_dispatch *tp, uint64_t time)
 	if (tp->buttons.is_clickpad && tp->queued & TOUCHPAD_EVENT_BUTTON_PRESS)
 		tp_tap_handle_event(tp, NULL, TAP_EVENT_BUTTON, time);
 
-	tp_for_each_touch(tp, t) {
-		if (!t->dirty || t->state == TOUCH_NONE)
+	tp_for_each_dirty_touch(tp, t) {
+		if (t->state == TOUCH_NONE)
 			continue;
 
 		if (tp->buttons.is_clickpad &&
@@ -1334,8 +1352,10 @@ tp_tap_update_map(struct tp_dispatch *tp)
 	if (tp->tap.state != TAP_STATE_IDLE)
 		return;
 
-	if (tp->tap.map != tp->tap.want_map)
+	if (tp->tap.map != tp->tap.want_map) {
 		tp->tap.map = tp->tap.want_map;
+		tp_tap_rebuild_button_map(tp);
+	}
 }
 
 void
@@ -1375,13 +1395,17 @@ tp_tap_enabled_update(struct tp_dispatch *tp, bool suspended, bool enabled, uint
 	if (tp_tap_enabled(tp)) {
 		struct tp_touch *t;
 
-		/* On resume, all touches are considered palms */
-		tp_for_each_touch(tp, t) {
-			if (t->state == TOUCH_NONE)
-				continue;
+		/* On resume, all touches are considered palms. Skip the
+		 * slot sweep on the common dwt-resume path where no
+		 * touch is down. */
+		if (tp->nfingers_down || tp->nactive_slots) {
+			tp_for_each_touch(tp, t) {
+				if (t->state == TOUCH_NONE)
+					continue;
 
-			t->tap.is_palm = true;
-			t->tap.state = TAP_TOUCH_STATE_DEAD;
+				t->tap.is_palm = true;
+				t->tap.state = TAP_TOUCH_STATE_DEAD;
+			}
 		}
 
 		tp->tap.state = TAP_STATE_IDLE;
@@ -1407,6 +1431,9 @@ tp_tap_config_set_enabled(struct libinput_device *device,
 	struct evdev_dispatch *dispatch = evdev_device(device)->dispatch;
 	struct tp_dispatch *tp = tp_dispatch(dispatch);
 
+	if (libinput_config_txn_defer_tap_enabled(device, enabled))
+		return LIBINPUT_CONFIG_STATUS_SUCCESS;
+
 	tp_tap_enabled_update(tp, tp->tap.suspended,
 			      (enabled == LIBINPUT_CONFIG_TAP_ENABLED),
 			      libinput_now(device->seat->libinput));
@@ -1577,6 +1604,7 @@ tp_init_tap(struct tp_dispatch *tp)
 	tp->tap.enabled = tp_tap_default(tp->device);
 	tp->tap.map = LIBINPUT_CONFIG_TAP_MAP_LRM;
 	tp->tap.want_map = tp->tap.map;
+	tp_tap_rebuild_button_map(tp);
 	tp->tap.drag_enabled = tp_drag_default(tp->device);
 	tp->tap.drag_lock_enabled = tp_drag_lock_default(tp->device);
 
@@ -1607,16 +1635,20 @@ tp_release_all_taps(struct tp_dispatch *tp, uint64_t now)
 			tp_tap_notify(tp, now, i, LIBINPUT_BUTTON_STATE_RELEASED);
 	}
 
-	/* To neutralize all current touches, we make them all palms */
-	tp_for_each_touch(tp, t) {
-		if (t->state == TOUCH_NONE)
-			continue;
+	/* To neutralize all current touches, we make them all palms.
+	 * When no touch is down (the typical dwt suspend) there is
+	 * nothing to neutralize. */
+	if (tp->nfingers_down || tp->nactive_slots) {
+		tp_for_each_touch(tp, t) {
+			if (t->state == TOUCH_NONE)
+				continue;
 
-		if (t->tap.is_palm)
-			continue;
+			if (t->tap.is_palm)
+				continue;
 
-		t->tap.is_palm = true;
-		t->tap.state = TAP_TOUCH_STATE_DEAD;
+			t->tap.is_palm = true;
+			t->tap.state = TAP_TOUCH_STATE_DEAD;
+		}
 	}
 
 	tp->tap.state = TAP_STATE_IDLE;
@@ -81,52 +81,48 @@ tp_thumb_lift(struct tp_dispatch *tp)
 	tp->thumb.index = UINT_MAX;
 }
 
-static bool
-tp_thumb_in_exclusion_area(const struct tp_dispatch *tp,
-			   const struct tp_touch *t)
-{
-	return (t->point.y > tp->thumb.lower_thumb_line &&
-		tp->scroll.method != LIBINPUT_CONFIG_SCROLL_EDGE);
-
-}
-
-static bool
-tp_thumb_detect_pressure_size(const struct tp_dispatch *tp,
-			      const struct tp_touch *t)
+/* The geometry/pressure/size features are extracted once per frame in
+ * tp_touch_extract_features() and packed into t->features.thumb_bits,
+ * the jail decision below is compiled into a table indexed by those
+ * bits. Rebuilt whenever one of the baked-in device-level inputs (the
+ * scroll method) changes. */
+void
+tp_thumb_compile_jail_table(struct tp_dispatch *tp)
 {
-	bool is_thumb = false;
-
-	if (tp->thumb.use_pressure &&
-	    t->pressure > tp->thumb.pressure_threshold &&
-	    tp_thumb_in_exclusion_area(tp, t)) {
-		is_thumb = true;
-	}
-
-	if (tp->thumb.use_size &&
-	    (t->major > tp->thumb.size_threshold) &&
-	    (t->minor < (tp->thumb.size_threshold * 0.6))) {
-		is_thumb = true;
+	bool edge = tp->scroll.method == LIBINPUT_CONFIG_SCROLL_EDGE;
+	bool have_hw = tp->thumb.use_size || tp->thumb.use_pressure;
+	uint8_t table = 0;
+	unsigned int bits;
+
+	for (bits = 0; bits < 8; bits++) {
+		bool below_upper = bits & 0x1;
+		bool below_lower = bits & 0x2;
+		bool pressure_size = bits & 0x4;
+		/* the exclusion area, verified by geometry alone */
+		bool excluded = below_lower && !edge;
+		bool jail;
+
+		/* A touch is jailed if it is in the thumb area and the
+		 * hardware, where capable, agrees it looks like a
+		 * thumb - unless it is so low that geometry alone
+		 * condemns it */
+		jail = below_upper && !edge &&
+		       (excluded || !have_hw || pressure_size);
+		if (jail)
+			table |= 1 << bits;
 	}
 
-	return is_thumb;
+	tp->thumb.jail_table = table;
 }
 
 static bool
 tp_thumb_needs_jail(const struct tp_dispatch *tp, const struct tp_touch *t)
 {
-	if (t->point.y < tp->thumb.upper_thumb_line ||
-	    tp->scroll.method == LIBINPUT_CONFIG_SCROLL_EDGE)
-		return false;
-
-	if (!tp_thumb_in_exclusion_area(tp, t) &&
-           (tp->thumb.use_size || tp->thumb.use_pressure) &&
-	    !tp_thumb_detect_pressure_size(tp, t))
-		return false;
-
+	/* A fast touch has proven itself to be a finger */
 	if (t->speed.exceeded_count >= 10)
 		return false;
 
-	return true;
+	return (tp->thumb.jail_table >> t->features.thumb_bits) & 0x1;
 }
 
 bool
@@ -435,9 +431,11 @@ tp_init_thumb(struct tp_dispatch *tp)
 				      &threshold)) {
 			tp->thumb.use_size = true;
 			tp->thumb.size_threshold = threshold;
+			tp->thumb.size_threshold_minor = 0.6 * threshold;
 		}
 	}
 
+	tp_thumb_compile_jail_table(tp);
 	tp_thumb_reset(tp);
 
 	quirks_unref(q);
@@ -33,6 +33,7 @@
 #endif
 
 #include "quirks.h"
+#include "event-export.h"
 #include "evdev-mt-touchpad.h"
 
 #define DEFAULT_TRACKPOINT_ACTIVITY_TIMEOUT ms2us(300)
@@ -47,12 +48,21 @@ enum notify {
 	DO_NOTIFY,
 };
 
+/* The per-frame loops read the leading tp_touch fields for every slot;
+ * keep them within the first cache line (the history ring is aligned to
+ * the next one anyway) */
+static_assert(offsetof(struct tp_touch, quirks) < 64,
+	      "hot tp_touch fields must fit in the first cache line");
+
 static inline struct tp_history_point*
 tp_motion_history_offset(struct tp_touch *t, int offset)
 {
-	int offset_index =
-		(t->history.index - offset + TOUCHPAD_HISTORY_LENGTH) %
-		TOUCHPAD_HISTORY_LENGTH;
+	static_assert((TOUCHPAD_HISTORY_LENGTH &
+		       (TOUCHPAD_HISTORY_LENGTH - 1)) == 0,
+		      "history ring length must be a power of two");
+	/* unsigned wraparound, the mask brings us back into range */
+	unsigned int offset_index =
+		(t->history.index - offset) & (t->history.size - 1);
 
 	return &t->history.samples[offset_index];
 }
@@ -93,6 +103,30 @@ tp_filter_motion_unaccelerated(struct tp_dispatch *tp,
 					&raw, tp, time);
 }
 
+/* Integer square root via the classic shift-and-subtract loop, for the
+ * Q16.16 speed path below. An isqrt of a Q32.32 value yields Q16.16. */
+static inline uint64_t
+u64_isqrt(uint64_t v)
+{
+	uint64_t result = 0;
+	uint64_t bit = UINT64_C(1) << 62;
+
+	while (bit > v)
+		bit >>= 2;
+
+	while (bit) {
+		if (v >= result + bit) {
+			v -= result + bit;
+			result = (result >> 1) + bit;
+		} else {
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return result;
+}
+
 static inline void
 tp_calculate_motion_speed(struct tp_dispatch *tp,
 			  struct tp_touch *t,
@@ -128,11 +162,29 @@ tp_calculate_motion_speed(struct tp_dispatch *tp,
 	last = tp_motion_history_offset(t, 1);
 	delta.x = abs(t->point.x - last->point.x);
 	delta.y = abs(t->point.y - last->point.y);
-	mm = evdev_device_unit_delta_to_mm(tp->device, &delta);
 
-	distance = length_in_mm(mm);
-	speed = distance/(time - last->time); /* mm/us */
-	speed *= 1000000; /* mm/s */
+	if (tp->accel.use_fixed_mm_coeff) {
+		/* Q16.16 path: integer multiplies and an integer sqrt,
+		 * one soft-fp conversion and division at the end. The
+		 * double path below costs two multiplies, hypot() and a
+		 * division per touch per frame, which adds up on boards
+		 * that emulate double in software. */
+		uint64_t dx = (uint64_t)delta.x * tp->accel.x_mm_coeff_fp;
+		uint64_t dy = (uint64_t)delta.y * tp->accel.y_mm_coeff_fp;
+		uint64_t dist_fp = u64_isqrt(dx * dx + dy * dy); /* mm, Q16.16 */
+
+		speed = dist_fp * (1000000.0 / 65536.0) / (time - last->time);
+	} else {
+		/* Use the cached coefficients instead of
+		 * evdev_device_unit_delta_to_mm(), this runs for every
+		 * touch on every frame */
+		mm.x = delta.x * tp->accel.x_mm_coeff;
+		mm.y = delta.y * tp->accel.y_mm_coeff;
+
+		distance = length_in_mm(mm);
+		speed = distance/(time - last->time); /* mm/us */
+		speed *= 1000000; /* mm/s */
+	}
 
 	t->speed.last_speed = speed;
 }
@@ -140,9 +192,10 @@ tp_calculate_motion_speed(struct tp_dispatch *tp,
 static inline void
 tp_motion_history_push(struct tp_touch *t, uint64_t time)
 {
-	int motion_index = (t->history.index + 1) % TOUCHPAD_HISTORY_LENGTH;
+	unsigned int motion_index =
+		(t->history.index + 1) & (t->history.size - 1);
 
-	if (t->history.count < TOUCHPAD_HISTORY_LENGTH)
+	if (t->history.count < t->history.size)
 		t->history.count++;
 
 	t->history.samples[motion_index].point = t->point;
@@ -161,6 +214,9 @@ tp_motion_history_push(struct tp_touch *t, uint64_t time)
  *
  * This only looks at x changes, y changes are ignored.
  */
+static void
+tp_hysteresis_select_filter(struct tp_dispatch *tp);
+
 static inline void
 tp_detect_wobbling(struct tp_dispatch *tp,
 		   struct tp_touch *t,
@@ -201,6 +257,7 @@ tp_detect_wobbling(struct tp_dispatch *tp,
 		t->hysteresis.x_motion_history |= (1 << 2);
 		if (t->hysteresis.x_motion_history == r_l_r) {
 			tp->hysteresis.enabled = true;
+			tp_hysteresis_select_filter(tp);
 			evdev_log_debug(tp->device,
 					"hysteresis enabled. "
 					"See %s/touchpad-jitter.html for details\n",
@@ -224,10 +281,41 @@ tp_motion_hysteresis(struct tp_dispatch *tp,
 	t->hysteresis.center = t->point;
 }
 
+/* Variants for the per-touch filter stage in tp_process_state() */
+static void
+tp_touch_filter_wobble_detect(struct tp_dispatch *tp,
+			      struct tp_touch *t,
+			      uint64_t time)
+{
+	tp_detect_wobbling(tp, t, time);
+}
+
+static void
+tp_touch_filter_hysteresis(struct tp_dispatch *tp,
+			   struct tp_touch *t,
+			   uint64_t time)
+{
+	tp_motion_hysteresis(tp, t);
+}
+
+/* Precise devices (zero fuzz) only run the wobble detector per touch,
+ * jittery ones get the full smoothing. Called at init and again when
+ * tp_detect_wobbling() flips tp->hysteresis.enabled at runtime. */
+static void
+tp_hysteresis_select_filter(struct tp_dispatch *tp)
+{
+	if (tp->hysteresis.enabled)
+		tp->hysteresis.filter = tp_touch_filter_hysteresis;
+	else
+		tp->hysteresis.filter = tp_touch_filter_wobble_detect;
+}
+
 static inline void
-tp_motion_history_reset(struct tp_touch *t)
+tp_motion_history_reset(struct tp_dispatch *tp, struct tp_touch *t)
 {
 	t->history.count = 0;
+	/* the ring mask may only change while the ring is empty */
+	t->history.size = tp->cadence.history_size;
 }
 
 static inline struct tp_touch *
@@ -333,8 +421,8 @@ tp_new_touch(struct tp_dispatch *tp, struct tp_touch *t, uint64_t time)
 	/* we begin the touch as hovering because until BTN_TOUCH happens we
 	 * don't know if it's a touch down or not. And BTN_TOUCH may happen
 	 * after ABS_MT_TRACKING_ID */
-	tp_motion_history_reset(t);
-	t->dirty = true;
+	tp_motion_history_reset(tp, t);
+	tp_touch_set_dirty(tp, t);
 	t->has_ended = false;
 	t->was_down = false;
 	t->palm.state = PALM_NONE;
@@ -349,7 +437,7 @@ tp_new_touch(struct tp_dispatch *tp, struct tp_touch *t, uint64_t time)
 static inline void
 tp_begin_touch(struct tp_dispatch *tp, struct tp_touch *t, uint64_t time)
 {
-	t->dirty = true;
+	tp_touch_set_dirty(tp, t);
 	t->state = TOUCH_BEGIN;
 	t->initial_time = time;
 	t->was_down = true;
@@ -398,7 +486,7 @@ tp_maybe_end_touch(struct tp_dispatch *tp,
 		t->state = TOUCH_NONE;
 	}
 
-	t->dirty = true;
+	tp_touch_set_dirty(tp, t);
 }
 
 /**
@@ -409,7 +497,7 @@ static inline void
 tp_recover_ended_touch(struct tp_dispatch *tp,
 		       struct tp_touch *t)
 {
-	t->dirty = true;
+	tp_touch_set_dirty(tp, t);
 	t->state = TOUCH_UPDATE;
 	tp->nfingers_down++;
 }
@@ -429,7 +517,7 @@ tp_end_touch(struct tp_dispatch *tp, struct tp_touch *t, uint64_t time)
 		return;
 	}
 
-	t->dirty = true;
+	tp_touch_set_dirty(tp, t);
 	t->palm.state = PALM_NONE;
 	t->state = TOUCH_END;
 	t->pinned.is_pinned = false;
@@ -509,7 +597,7 @@ tp_process_absolute(struct tp_dispatch *tp,
 						  e->code,
 						  e->value);
 		t->point.x = rotated(tp, e->code, e->value);
-		t->dirty = true;
+		tp_touch_set_dirty(tp, t);
 		tp->queued |= TOUCHPAD_EVENT_MOTION;
 		break;
 	case ABS_MT_POSITION_Y:
@@ -517,7 +605,7 @@ tp_process_absolute(struct tp_dispatch *tp,
 						  e->code,
 						  e->value);
 		t->point.y = rotated(tp, e->code, e->value);
-		t->dirty = true;
+		tp_touch_set_dirty(tp, t);
 		tp->queued |= TOUCHPAD_EVENT_MOTION;
 		break;
 	case ABS_MT_SLOT:
@@ -535,22 +623,22 @@ tp_process_absolute(struct tp_dispatch *tp,
 		break;
 	case ABS_MT_PRESSURE:
 		t->pressure = e->value;
-		t->dirty = true;
+		tp_touch_set_dirty(tp, t);
 		tp->queued |= TOUCHPAD_EVENT_OTHERAXIS;
 		break;
 	case ABS_MT_TOOL_TYPE:
 		t->is_tool_palm = e->value == MT_TOOL_PALM;
-		t->dirty = true;
+		tp_touch_set_dirty(tp, t);
 		tp->queued |= TOUCHPAD_EVENT_OTHERAXIS;
 		break;
 	case ABS_MT_TOUCH_MAJOR:
 		t->major = e->value;
-		t->dirty = true;
+		tp_touch_set_dirty(tp, t);
 		tp->queued |= TOUCHPAD_EVENT_OTHERAXIS;
 		break;
 	case ABS_MT_TOUCH_MINOR:
 		t->minor = e->value;
-		t->dirty = true;
+		tp_touch_set_dirty(tp, t);
 		tp->queued |= TOUCHPAD_EVENT_OTHERAXIS;
 		break;
 	}
@@ -569,7 +657,7 @@ tp_process_absolute_st(struct tp_dispatch *tp,
 						  e->code,
 						  e->value);
 		t->point.x = rotated(tp, e->code, e->value);
-		t->dirty = true;
+		tp_touch_set_dirty(tp, t);
 		tp->queued |= TOUCHPAD_EVENT_MOTION;
 		break;
 	case ABS_Y:
@@ -577,12 +665,12 @@ tp_process_absolute_st(struct tp_dispatch *tp,
 						  e->code,
 						  e->value);
 		t->point.y = rotated(tp, e->code, e->value);
-		t->dirty = true;
+		tp_touch_set_dirty(tp, t);
 		tp->queued |= TOUCHPAD_EVENT_MOTION;
 		break;
 	case ABS_PRESSURE:
 		t->pressure = e->value;
-		t->dirty = true;
+		tp_touch_set_dirty(tp, t);
 		tp->queued |= TOUCHPAD_EVENT_OTHERAXIS;
 		break;
 	}
@@ -708,7 +796,7 @@ tp_process_trackpoint_button(struct tp_dispatch *tp,
 	if (!tp->buttons.trackpoint)
 		return;
 
-	dispatch = tp->buttons.trackpoint->dispatch;
+	dispatch = tp->buttons.trackpoint_dispatch;
 
 	event = *e;
 	syn_report.input_event_sec = e->input_event_sec;
@@ -791,10 +879,13 @@ tp_unpin_finger(const struct tp_dispatch *tp, struct tp_touch *t)
 	delta.x = abs(t->point.x - t->pinned.center.x);
 	delta.y = abs(t->point.y - t->pinned.center.y);
 
-	mm = evdev_device_unit_delta_to_mm(tp->device, &delta);
+	/* Use the cached coefficients, this runs for every pinned touch
+	 * on every frame */
+	mm.x = delta.x * tp->accel.x_mm_coeff;
+	mm.y = delta.y * tp->accel.y_mm_coeff;
 
-	/* 1.5mm movement -> unpin */
-	if (hypot(mm.x, mm.y) >= 1.5) {
+	/* 1.5mm movement -> unpin, compare squared to skip the sqrt */
+	if (mm.x * mm.x + mm.y * mm.y >= 1.5 * 1.5) {
 		t->pinned.is_pinned = false;
 		return;
 	}
@@ -836,33 +927,32 @@ tp_touch_active_for_gesture(const struct tp_dispatch *tp, const struct tp_touch
 static inline bool
 tp_palm_was_in_side_edge(const struct tp_dispatch *tp, const struct tp_touch *t)
 {
-	return t->palm.first.x < tp->palm.left_edge ||
-	       t->palm.first.x > tp->palm.right_edge;
+	return tp_zones_classify(tp, t->palm.first) & TP_ZONE_PALM_SIDE;
 }
 
 static inline bool
 tp_palm_was_in_top_edge(const struct tp_dispatch *tp, const struct tp_touch *t)
 {
-	return t->palm.first.y < tp->palm.upper_edge;
+	return tp_zones_classify(tp, t->palm.first) & TP_ZONE_PALM_TOP;
 }
 
 static inline bool
 tp_palm_in_side_edge(const struct tp_dispatch *tp, const struct tp_touch *t)
 {
-	return t->point.x < tp->palm.left_edge ||
-	       t->point.x > tp->palm.right_edge;
+	return tp_zones_classify(tp, t->point) & TP_ZONE_PALM_SIDE;
 }
 
 static inline bool
 tp_palm_in_top_edge(const struct tp_dispatch *tp, const struct tp_touch *t)
 {
-	return t->point.y < tp->palm.upper_edge;
+	return tp_zones_classify(tp, t->point) & TP_ZONE_PALM_TOP;
 }
 
 static inline bool
 tp_palm_in_edge(const struct tp_dispatch *tp, const struct tp_touch *t)
 {
-	return tp_palm_in_side_edge(tp, t) || tp_palm_in_top_edge(tp, t);
+	return tp_zones_classify(tp, t->point) &
+	       (TP_ZONE_PALM_SIDE | TP_ZONE_PALM_TOP);
 }
 
 bool
@@ -871,7 +961,7 @@ tp_palm_tap_is_palm(const struct tp_dispatch *tp, const struct tp_touch *t)
 	if (t->state != TOUCH_BEGIN)
 		return false;
 
-	if (!tp_palm_in_edge(tp, t))
+	if (!t->features.palm_edge)
 		return false;
 
 	evdev_log_debug(tp->device,
@@ -976,7 +1066,7 @@ tp_palm_detect_move_out_of_edge(struct tp_dispatch *tp,
 	struct device_float_coords delta;
 	int dirs;
 
-	if (time < t->palm.time + PALM_TIMEOUT && !tp_palm_in_edge(tp, t)) {
+	if (time < t->palm.time + PALM_TIMEOUT && !t->features.palm_edge) {
 		if (tp_palm_was_in_side_edge(tp, t))
 			directions = NE|E|SE|SW|W|NW;
 		else if (tp_palm_was_in_top_edge(tp, t))
@@ -1035,8 +1125,7 @@ tp_palm_detect_touch_size_triggered(struct tp_dispatch *tp,
 	if (t->palm.state != PALM_NONE && t->palm.state != PALM_TOUCH_SIZE)
 		return false;
 
-	if (t->major > tp->palm.size_threshold ||
-	    t->minor > tp->palm.size_threshold) {
+	if (t->features.palm_size) {
 		if (t->palm.state != PALM_TOUCH_SIZE)
 			evdev_log_debug(tp->device,
 					"palm: touch %d size exceeded\n",
@@ -1079,7 +1168,7 @@ tp_palm_detect_edge(struct tp_dispatch *tp,
 
 	/* palm must start in exclusion zone, it's ok to move into
 	   the zone without being a palm */
-	if (t->state != TOUCH_BEGIN || !tp_palm_in_edge(tp, t))
+	if (t->state != TOUCH_BEGIN || !t->features.palm_edge)
 		return false;
 
 	/* don't detect palm in software button areas, it's
@@ -1089,7 +1178,7 @@ tp_palm_detect_edge(struct tp_dispatch *tp,
 	    tp_button_is_inside_softbutton_area(tp, t))
 		return false;
 
-	if (tp_touch_get_edge(tp, t) & EDGE_RIGHT)
+	if (t->features.edge & EDGE_RIGHT)
 		return false;
 
 	t->palm.state = PALM_EDGE;
@@ -1111,7 +1200,7 @@ tp_palm_detect_pressure_triggered(struct tp_dispatch *tp,
 	    t->palm.state != PALM_PRESSURE)
 		return false;
 
-	if (t->pressure > tp->palm.pressure_threshold)
+	if (t->features.palm_pressure)
 		t->palm.state = PALM_PRESSURE;
 
 	return t->palm.state == PALM_PRESSURE;
@@ -1226,12 +1315,12 @@ tp_unhover_pressure(struct tp_dispatch *tp, uint64_t time)
 
 		if (t->dirty) {
 			if (t->state == TOUCH_HOVERING) {
-				if (t->pressure >= tp->pressure.high) {
+				if (t->features.pressure_high) {
 					evdev_log_debug(tp->device,
 							"pressure: begin touch %d\n",
 							t->index);
 					/* avoid jumps when landing a finger */
-					tp_motion_history_reset(t);
+					tp_motion_history_reset(tp, t);
 					tp_begin_touch(tp, t, time);
 				}
 			/* don't unhover for pressure if we have too many
@@ -1241,7 +1330,7 @@ tp_unhover_pressure(struct tp_dispatch *tp, uint64_t time)
 			 */
 			} else if (nfake_touches <= tp->num_slots ||
 				   tp->num_slots == 1) {
-				if (t->pressure < tp->pressure.low) {
+				if (t->features.pressure_low) {
 					evdev_log_debug(tp->device,
 							"pressure: end touch %d\n",
 							t->index);
@@ -1267,7 +1356,7 @@ tp_unhover_pressure(struct tp_dispatch *tp, uint64_t time)
 		tp_for_each_touch(tp, t) {
 			if (t->state == TOUCH_HOVERING) {
 				/* avoid jumps when landing a finger */
-				tp_motion_history_reset(t);
+				tp_motion_history_reset(tp, t);
 				tp_begin_touch(tp, t, time);
 
 				if (tp->nfingers_down >= nfake_touches)
@@ -1299,8 +1388,6 @@ static void
 tp_unhover_size(struct tp_dispatch *tp, uint64_t time)
 {
 	struct tp_touch *t;
-	int low = tp->touch_size.low,
-	    high = tp->touch_size.high;
 	int i;
 
 	/* We require 5 slots for size handling, so we don't need to care
@@ -1316,17 +1403,16 @@ tp_unhover_size(struct tp_dispatch *tp, uint64_t time)
 			continue;
 
 		if (t->state == TOUCH_HOVERING) {
-			if ((t->major > high && t->minor > low) ||
-			    (t->major > low && t->minor > high)) {
+			if (t->features.size_high) {
 				evdev_log_debug(tp->device,
 						"touch-size: begin touch %d\n",
 						t->index);
 				/* avoid jumps when landing a finger */
-				tp_motion_history_reset(t);
+				tp_motion_history_reset(tp, t);
 				tp_begin_touch(tp, t, time);
 			}
 		} else {
-			if (t->major < low || t->minor < low) {
+			if (t->features.size_low) {
 				evdev_log_debug(tp->device,
 						"touch-size: end touch %d\n",
 						t->index);
@@ -1396,13 +1482,7 @@ tp_unhover_fake_touches(struct tp_dispatch *tp, uint64_t time)
 static void
 tp_unhover_touches(struct tp_dispatch *tp, uint64_t time)
 {
-	if (tp->pressure.use_pressure)
-		tp_unhover_pressure(tp, time);
-	else if (tp->touch_size.use_touch_size)
-		tp_unhover_size(tp, time);
-	else
-		tp_unhover_fake_touches(tp, time);
-
+	tp->unhover(tp, time);
 }
 
 static inline void
@@ -1444,8 +1524,8 @@ tp_position_fake_touches(struct tp_dispatch *tp)
 
 		t->point = topmost->point;
 		t->pressure = topmost->pressure;
-		if (!t->dirty)
-			t->dirty = topmost->dirty;
+		if (!t->dirty && topmost->dirty)
+			tp_touch_set_dirty(tp, t);
 	}
 }
 
@@ -1483,75 +1563,110 @@ tp_need_motion_history_reset(struct tp_dispatch *tp)
 	return rc;
 }
 
-static bool
-tp_detect_jumps(const struct tp_dispatch *tp,
-		struct tp_touch *t,
-		uint64_t time)
+/* Jump detection as one sweep per frame instead of a call per touch:
+ * the delta math runs over all dirty slots first, filling flat arrays,
+ * and the threshold compare then runs over those arrays in a tight
+ * loop with no branches or pointer chasing, so the compiler is free to
+ * vectorize it. The result is a bitmask by t->index (slots >= 64 are
+ * not scanned, matching tp->dirty_slots).
+ *
+ * Must run before tp_motion_history_push() and before the motion
+ * history resets in tp_process_state(): offset 0 is the previous
+ * frame's coordinate, and a touch about to be reset must not be
+ * scanned against history that is about to be discarded.
+ */
+static uint64_t
+tp_detect_jumps_frame(struct tp_dispatch *tp, uint64_t time)
 {
-	struct device_coords delta;
-	struct phys_coords mm;
-	struct tp_history_point *last;
-	double abs_distance, rel_distance;
-	bool is_jump = false;
-	uint64_t tdelta;
-	/* Reference interval from the touchpad the various thresholds
-	 * were measured from */
-	unsigned int reference_interval = ms2us(12);
+	struct tp_touch *t;
+	double abs_mm[64], rel_mm[64];
+	unsigned int slot[64];
+	size_t n = 0;
+	uint64_t outliers = 0;
 
 	/* On some touchpads the firmware does funky stuff and we cannot
 	 * have our own jump detection, e.g. Lenovo Carbon X1 Gen 6 (see
 	 * issue #506)
 	 */
 	if (tp->jump.detection_disabled)
-		return false;
+		return 0;
 
 	/* We haven't seen pointer jumps on Wacom tablets yet, so exclude
 	 * those.
 	 */
 	if (tp->device->model_flags & EVDEV_MODEL_WACOM_TOUCHPAD)
-		return false;
+		return 0;
 
-	if (t->history.count == 0) {
-		t->jumps.last_delta_mm = 0.0;
-		return false;
-	}
+	tp_for_each_touch(tp, t) {
+		struct device_coords delta;
+		struct phys_coords mm;
+		struct tp_history_point *last;
+		double abs_distance;
+		uint64_t tdelta;
+		/* Reference interval from the touchpad the various
+		 * thresholds were measured from */
+		unsigned int reference_interval = ms2us(12);
+
+		if (t->state == TOUCH_NONE || !t->dirty || t->index >= 64)
+			continue;
 
-	/* called before tp_motion_history_push, so offset 0 is the most
-	 * recent coordinate */
-	last = tp_motion_history_offset(t, 0);
-	tdelta = time - last->time;
+		/* Reset pending from a previous frame, handled after
+		 * this sweep in tp_process_state() */
+		if (t->quirks.reset_motion_history)
+			continue;
 
-	/* For test devices we always force the time delta to 12, at least
-	   until the test suite actually does proper intervals. */
-	if (tp->device->model_flags & EVDEV_MODEL_TEST_DEVICE)
-		reference_interval = tdelta;
+		if (t->history.count == 0) {
+			t->jumps.last_delta_mm = 0.0;
+			continue;
+		}
 
-	/* If the last frame is more than 30ms ago, we have irregular
-	 * frames, who knows what's a pointer jump here and what's
-	 * legitimate movement.... */
-	if (tdelta > 2.5 * reference_interval || tdelta == 0)
-		return false;
+		/* called before tp_motion_history_push, so offset 0 is the
+		 * most recent coordinate */
+		last = tp_motion_history_offset(t, 0);
+		tdelta = time - last->time;
+
+		/* For test devices we always force the time delta to 12, at
+		   least until the test suite actually does proper
+		   intervals. */
+		if (tp->device->model_flags & EVDEV_MODEL_TEST_DEVICE)
+			reference_interval = tdelta;
+
+		/* If the last frame is more than 30ms ago, we have irregular
+		 * frames, who knows what's a pointer jump here and what's
+		 * legitimate movement.... */
+		if (tdelta > 2.5 * reference_interval || tdelta == 0)
+			continue;
 
-	/* We historically expected ~12ms frame intervals, so the numbers
-	   below are normalized to that (and that's also where the
-	   measured data came from) */
-	delta.x = abs(t->point.x - last->point.x);
-	delta.y = abs(t->point.y - last->point.y);
-	mm = evdev_device_unit_delta_to_mm(tp->device, &delta);
-	abs_distance = hypot(mm.x, mm.y) * reference_interval/tdelta;
-	rel_distance = abs_distance - t->jumps.last_delta_mm;
-
-	/* Special case for the ALPS devices in the Lenovo ThinkPad E465,
-	 * E550. These devices send occasional 4095/0 events on two fingers
-	 * before snapping back to the correct position.
-	 * https://gitlab.freedesktop.org/libinput/libinput/-/issues/492
-	 * The specific values are hardcoded here, if this ever happens on
-	 * any other device we can make it absmax/absmin instead.
-	 */
-	if (tp->device->model_flags & EVDEV_MODEL_ALPS_SERIAL_TOUCHPAD &&
-	    t->point.x == 4095 && t->point.y == 0) {
-		t->point = last->point;
-		return true;
+		/* Special case for the ALPS devices in the Lenovo ThinkPad
+		 * E465, E550. These devices send occasional 4095/0 events on
+		 * two fingers before snapping back to the correct position.
+		 * https://gitlab.freedesktop.org/libinput/libinput/-/issues/492
+		 * The specific values are hardcoded here, if this ever
+		 * happens on any other device we can make it absmax/absmin
+		 * instead.
+		 */
+		if (tp->device->model_flags & EVDEV_MODEL_ALPS_SERIAL_TOUCHPAD &&
+		    t->point.x == 4095 && t->point.y == 0) {
+			t->point = last->point;
+			outliers |= 1ULL << t->index;
+			continue;
+		}
+
+		/* We historically expected ~12ms frame intervals, so the
+		   numbers below are normalized to that (and that's also
+		   where the measured data came from) */
+		delta.x = abs(t->point.x - last->point.x);
+		delta.y = abs(t->point.y - last->point.y);
+		mm.x = delta.x * tp->accel.x_mm_coeff;
+		mm.y = delta.y * tp->accel.y_mm_coeff;
+		abs_distance = hypot(mm.x, mm.y) * reference_interval/tdelta;
+
+		abs_mm[n] = abs_distance;
+		rel_mm[n] = abs_distance - t->jumps.last_delta_mm;
+		slot[n] = t->index;
+		n++;
+
+		t->jumps.last_delta_mm = abs_distance;
 	}
 
 	/* Cursor jump if:
@@ -1559,10 +1674,13 @@ tp_detect_jumps(const struct tp_dispatch *tp,
 	 * - we increased the delta by over 7mm within a 12ms frame.
 	 *   (12ms simply because that's what I measured)
 	 */
-	is_jump = abs_distance > 20.0 || rel_distance > 7;
-	t->jumps.last_delta_mm = abs_distance;
+	for (size_t i = 0; i < n; i++) {
+		uint64_t is_jump = abs_mm[i] > 20.0 || rel_mm[i] > 7.0;
 
-	return is_jump;
+		outliers |= is_jump << slot[i];
+	}
+
+	return outliers;
 }
 
 /**
@@ -1683,6 +1801,38 @@ tp_process_msc_timestamp(struct tp_dispatch *tp, uint64_t time)
 	}
 }
 
+/* Classify all slots against the pressure and size thresholds in one
+ * sweep. The unhover and palm code each need a subset of these
+ * comparisons; doing them together keeps the thresholds hot and leaves
+ * the consumers with plain flag tests instead of scattered per-touch
+ * range conditionals */
+static void
+tp_classify_touches(struct tp_dispatch *tp)
+{
+	struct tp_touch *t;
+	int phigh = tp->pressure.high,
+	    plow = tp->pressure.low,
+	    shigh = tp->touch_size.high,
+	    slow = tp->touch_size.low,
+	    palm_pressure = tp->palm.pressure_threshold,
+	    palm_size = tp->palm.size_threshold;
+
+	tp_for_each_touch(tp, t) {
+		if (t->state == TOUCH_NONE)
+			continue;
+
+		t->features.pressure_high = t->pressure >= phigh;
+		t->features.pressure_low = t->pressure < plow;
+		t->features.size_high =
+			(t->major > shigh && t->minor > slow) ||
+			(t->major > slow && t->minor > shigh);
+		t->features.size_low = t->major < slow || t->minor < slow;
+		t->features.palm_pressure = t->pressure > palm_pressure;
+		t->features.palm_size = t->major > palm_size ||
+					t->minor > palm_size;
+	}
+}
+
 static void
 tp_pre_process_state(struct tp_dispatch *tp, uint64_t time)
 {
@@ -1692,6 +1842,7 @@ tp_pre_process_state(struct tp_dispatch *tp, uint64_t time)
 		tp_process_msc_timestamp(tp, time);
 
 	tp_process_fake_touches(tp, time);
+	tp_classify_touches(tp);
 	tp_unhover_touches(tp, time);
 
 	tp_for_each_touch(tp, t) {
@@ -1706,6 +1857,29 @@ tp_pre_process_state(struct tp_dispatch *tp, uint64_t time)
 
 }
 
+static void
+tp_touch_extract_features(struct tp_dispatch *tp, struct tp_touch *t)
+{
+	t->features.edge = tp_touch_get_edge(tp, t);
+	t->features.palm_edge = tp_palm_in_edge(tp, t);
+	t->features.below_upper_thumb_line =
+		t->point.y >= tp->thumb.upper_thumb_line;
+	t->features.below_lower_thumb_line =
+		t->point.y > tp->thumb.lower_thumb_line;
+	t->features.thumb_pressure_size =
+		(tp->thumb.use_pressure &&
+		 t->pressure > tp->thumb.pressure_threshold &&
+		 t->features.below_lower_thumb_line &&
+		 tp->scroll.method != LIBINPUT_CONFIG_SCROLL_EDGE) ||
+		(tp->thumb.use_size &&
+		 t->major > tp->thumb.size_threshold &&
+		 t->minor < tp->thumb.size_threshold_minor);
+	t->features.thumb_bits =
+		(t->features.below_upper_thumb_line << 0) |
+		(t->features.below_lower_thumb_line << 1) |
+		(t->features.thumb_pressure_size << 2);
+}
+
 static void
 tp_process_state(struct tp_dispatch *tp, uint64_t time)
 {
@@ -1714,21 +1888,34 @@ tp_process_state(struct tp_dispatch *tp, uint64_t time)
 	bool want_motion_reset;
 	bool have_new_touch = false;
 	unsigned int speed_exceeded_count = 0;
+	uint64_t jump_outliers;
 
 	tp_position_fake_touches(tp);
 
 	want_motion_reset = tp_need_motion_history_reset(tp);
 
+	/* Sweep while the history still holds the previous frame; a
+	 * frame that resets all histories anyway has nothing to scan */
+	jump_outliers = want_motion_reset ?
+			0 : tp_detect_jumps_frame(tp, time);
+
 	tp_for_each_touch(tp, t) {
 		if (t->state == TOUCH_NONE)
 			continue;
 
+		/* Cheap enough to refresh even for unmoved touches, so
+		 * a config change (e.g. scroll method) never leaves
+		 * stale features behind */
+		tp_touch_extract_features(tp, t);
+
 		if (want_motion_reset) {
-			tp_motion_history_reset(t);
+			tp_motion_history_reset(tp, t);
 			t->quirks.reset_motion_history = true;
+			t->jumps.last_delta_mm = 0.0;
 		} else if (t->quirks.reset_motion_history) {
-			tp_motion_history_reset(t);
+			tp_motion_history_reset(tp, t);
 			t->quirks.reset_motion_history = false;
+			t->jumps.last_delta_mm = 0.0;
 		}
 
 		if (!t->dirty) {
@@ -1747,20 +1934,21 @@ tp_process_state(struct tp_dispatch *tp, uint64_t time)
 			continue;
 		}
 
-		if (tp_detect_jumps(tp, t, time)) {
+		if (t->index < 64 && (jump_outliers & (1ULL << t->index))) {
 			if (!tp->semi_mt)
 				evdev_log_bug_kernel_ratelimit(tp->device,
 						&tp->jump.warning,
 					        "Touch jump detected and discarded.\n"
 					        "See %s/touchpad-jumping-cursors.html for details\n",
 					        HTTP_DOC_LINK);
-			tp_motion_history_reset(t);
+			tp_motion_history_reset(tp, t);
 		}
 
 		tp_thumb_update_touch(tp, t, time);
 		tp_palm_detect(tp, t, time);
-		tp_detect_wobbling(tp, t, time);
-		tp_motion_hysteresis(tp, t);
+		tp->hysteresis.filter(tp, t, time);
+		/* hysteresis may have nudged the point */
+		tp_touch_extract_features(tp, t);
 		tp_motion_history_push(t, time);
 
 		/* Touch speed handling: if we'are above the threshold,
@@ -1824,11 +2012,7 @@ tp_post_process_state(struct tp_dispatch *tp, uint64_t time)
 {
 	struct tp_touch *t;
 
-	tp_for_each_touch(tp, t) {
-
-		if (!t->dirty)
-			continue;
-
+	tp_for_each_dirty_touch(tp, t) {
 		if (t->state == TOUCH_END) {
 			if (t->has_ended)
 				t->state = TOUCH_NONE;
@@ -1840,6 +2024,7 @@ tp_post_process_state(struct tp_dispatch *tp, uint64_t time)
 
 		t->dirty = false;
 	}
+	tp->dirty_slots = 0;
 
 	tp->old_nfingers_down = tp->nfingers_down;
 	tp->buttons.old_state = tp->buttons.state;
@@ -1903,10 +2088,85 @@ tp_apply_rotation(struct evdev_device *device)
 			tp->left_handed.rotate ? "on" : "off");
 }
 
+static void
+tp_journal_post(struct tp_dispatch *tp, uint64_t time)
+{
+	struct libinput_touch_journal *journal =
+		tp_libinput_context(tp)->touch_journal;
+	struct touch_journal_touch touches[TOUCH_JOURNAL_MAX_TOUCHES];
+	struct tp_touch *t;
+	size_t ntouches = 0;
+
+	if (!journal)
+		return;
+
+	tp_for_each_touch(tp, t) {
+		if (t->state == TOUCH_NONE)
+			continue;
+		if (ntouches >= ARRAY_LENGTH(touches))
+			break;
+		touches[ntouches].state = t->state;
+		touches[ntouches].palm = t->palm.state != PALM_NONE;
+		touches[ntouches].x = t->point.x;
+		touches[ntouches].y = t->point.y;
+		ntouches++;
+	}
+
+	libinput_touch_journal_post(journal,
+				    &tp->device->base,
+				    time,
+				    tp->gesture.state,
+				    tp->gesture.finger_count,
+				    touches,
+				    ntouches);
+}
+
+/* High-Hz touchpads benefit from a deeper ring for the speed and
+ * pointer-jump checks, at no extra latency - the smoothing window stays
+ * roughly constant in time. The frame rate cannot be read at init time,
+ * so measure it: an EWMA over the report intervals picks the depth, new
+ * touches pick it up as their ring empties. */
+static inline void
+tp_motion_history_adapt(struct tp_dispatch *tp, uint64_t time)
+{
+	uint64_t delta;
+	unsigned int size;
+
+	if (tp->device->stats.slot)
+		tp->device->stats.slot->history_depth =
+			tp->cadence.history_size;
+
+	if (tp->cadence.pinned)
+		return;
+
+	delta = time - tp->cadence.last_frame_time;
+	tp->cadence.last_frame_time = time;
+
+	/* a gap between interactions, not a report interval */
+	if (delta == 0 || delta > ms2us(100))
+		return;
+
+	if (tp->cadence.interval)
+		tp->cadence.interval =
+			(tp->cadence.interval * 7 + delta) / 8;
+	else
+		tp->cadence.interval = delta;
+
+	/* 8 samples at 143Hz+ still cover a shorter window than the
+	 * historical 4 at 80Hz, slower pads keep the historical depth */
+	if (tp->cadence.interval < ms2us(7))
+		size = TOUCHPAD_HISTORY_LENGTH;
+	else
+		size = TOUCHPAD_HISTORY_DEFAULT;
+
+	tp->cadence.history_size = size;
+}
+
 static void
 tp_handle_state(struct tp_dispatch *tp,
 		uint64_t time)
 {
+	tp_motion_history_adapt(tp, time);
 	tp_pre_process_state(tp, time);
 	tp_process_state(tp, time);
 	tp_post_events(tp, time);
@@ -1914,6 +2174,8 @@ tp_handle_state(struct tp_dispatch *tp,
 
 	tp_clickpad_middlebutton_apply_config(tp->device);
 	tp_apply_rotation(tp->device);
+
+	tp_journal_post(tp, time);
 }
 
 static inline void
@@ -1949,7 +2211,7 @@ tp_interface_process(struct evdev_dispatch *dispatch,
 
 	switch (e->type) {
 	case EV_ABS:
-		if (tp->has_mt)
+		if (likely(tp->has_mt))
 			tp_process_absolute(tp, e, time);
 		else
 			tp_process_absolute_st(tp, e, time);
@@ -1975,7 +2237,9 @@ tp_remove_sendevents(struct tp_dispatch *tp)
 	struct evdev_paired_keyboard *kbd;
 
 	libinput_timer_cancel(&tp->palm.trackpoint_timer);
+	tp->palm.trackpoint_timer_expiry = 0;
 	libinput_timer_cancel(&tp->dwt.keyboard_timer);
+	tp->dwt.keyboard_timer_expiry = 0;
 
 	if (tp->buttons.trackpoint &&
 	    tp->palm.monitor_trackpoint)
@@ -2002,6 +2266,7 @@ tp_interface_remove(struct evdev_dispatch *dispatch)
 	struct evdev_paired_keyboard *kbd;
 
 	libinput_timer_cancel(&tp->arbitration.arbitration_timer);
+	tp->arbitration.arbitration_timer_expiry = 0;
 
 	list_for_each_safe(kbd, &tp->dwt.paired_keyboard_list, link) {
 		evdev_paired_keyboard_destroy(kbd);
@@ -2026,7 +2291,19 @@ tp_interface_destroy(struct evdev_dispatch *dispatch)
 	libinput_timer_destroy(&tp->tap.timer);
 	libinput_timer_destroy(&tp->gesture.finger_count_switch_timer);
 	libinput_timer_destroy(&tp->gesture.hold_timer);
-	free(tp->touches);
+	libinput_timer_destroy(&tp->gesture.scroll_batch_timer);
+	free(tp->zones.xflags);
+	free(tp->zones.yflags);
+	if (tp->touches_hooked) {
+		struct libinput *libinput = tp_libinput_context(tp);
+
+		libinput->alloc_hooks.free(
+				tp->touches,
+				tp->ntouches * sizeof(struct tp_touch),
+				libinput->alloc_hooks.user_data);
+	} else {
+		free(tp->touches);
+	}
 	free(tp);
 }
 
@@ -2189,6 +2466,17 @@ tp_trackpoint_timeout(uint64_t now, void *data)
 {
 	struct tp_dispatch *tp = data;
 
+	/* Trackpoint events only bump trackpoint_timer_expiry instead
+	 * of re-arming the timer, so we may be here too early. Catch
+	 * up; the deactivation time is the same as if every event had
+	 * re-armed the timer. */
+	if (now < tp->palm.trackpoint_timer_expiry) {
+		libinput_timer_set(&tp->palm.trackpoint_timer,
+				   tp->palm.trackpoint_timer_expiry);
+		return;
+	}
+	tp->palm.trackpoint_timer_expiry = 0;
+
 	if (tp->palm.trackpoint_active) {
 		tp_tap_resume(tp, now);
 		tp->palm.trackpoint_active = false;
@@ -2200,6 +2488,7 @@ static void
 tp_trackpoint_event(uint64_t time, struct libinput_event *event, void *data)
 {
 	struct tp_dispatch *tp = data;
+	uint64_t expiry;
 
 	/* Buttons do not count as trackpad activity, as people may use
 	   the trackpoint buttons in combination with the touchpad. */
@@ -2212,18 +2501,22 @@ tp_trackpoint_event(uint64_t time, struct libinput_event *event, void *data)
 
 	/* Require at least three events before enabling palm detection */
 	if (tp->palm.trackpoint_event_count < 3) {
-		libinput_timer_set(&tp->palm.trackpoint_timer,
-				   time + DEFAULT_TRACKPOINT_EVENT_TIMEOUT);
-		return;
-	}
+		expiry = time + DEFAULT_TRACKPOINT_EVENT_TIMEOUT;
+	} else {
+		if (!tp->palm.trackpoint_active) {
+			tp_stop_actions(tp, time);
+			tp->palm.trackpoint_active = true;
+		}
 
-	if (!tp->palm.trackpoint_active) {
-		tp_stop_actions(tp, time);
-		tp->palm.trackpoint_active = true;
+		expiry = time + DEFAULT_TRACKPOINT_ACTIVITY_TIMEOUT;
 	}
 
-	libinput_timer_set(&tp->palm.trackpoint_timer,
-			   time + DEFAULT_TRACKPOINT_ACTIVITY_TIMEOUT);
+	/* Only arm the timer when it isn't running yet, each event of a
+	 * motion burst merely bumps the intended expiry and the timeout
+	 * handler re-arms. Same batching as tp_keyboard_event(). */
+	if (tp->palm.trackpoint_timer_expiry == 0)
+		libinput_timer_set(&tp->palm.trackpoint_timer, expiry);
+	tp->palm.trackpoint_timer_expiry = expiry;
 }
 
 static void
@@ -2234,16 +2527,31 @@ tp_keyboard_timeout(uint64_t now, void *data)
 	if (tp->dwt.dwt_enabled &&
 	    long_any_bit_set(tp->dwt.key_mask,
 			     ARRAY_LENGTH(tp->dwt.key_mask))) {
+		tp->dwt.keyboard_timer_expiry =
+			now + DEFAULT_KEYBOARD_ACTIVITY_TIMEOUT_2;
 		libinput_timer_set(&tp->dwt.keyboard_timer,
-				   now + DEFAULT_KEYBOARD_ACTIVITY_TIMEOUT_2);
+				   tp->dwt.keyboard_timer_expiry);
 		tp->dwt.keyboard_last_press_time = now;
 		evdev_log_debug(tp->device, "palm: keyboard timeout refresh\n");
 		return;
 	}
 
+	/* Key presses while active only bump keyboard_timer_expiry
+	 * instead of re-arming the timer, so we may be here too early.
+	 * Catch up; the deactivation time is the same as if every press
+	 * had re-armed the timer. */
+	if (tp->dwt.dwt_enabled &&
+	    tp->dwt.keyboard_active &&
+	    now < tp->dwt.keyboard_timer_expiry) {
+		libinput_timer_set(&tp->dwt.keyboard_timer,
+				   tp->dwt.keyboard_timer_expiry);
+		return;
+	}
+
 	tp_tap_resume(tp, now);
 
 	tp->dwt.keyboard_active = false;
+	tp->dwt.keyboard_timer_expiry = 0;
 
 	evdev_log_debug(tp->device, "palm: keyboard timeout\n");
 }
@@ -2284,6 +2592,32 @@ tp_key_ignore_for_dwt(unsigned int keycode)
 	return keycode >= KEY_F1;
 }
 
+/* The classification of the low keycodes is precomputed into bitmaps so
+ * that the hot path below is a single load and test per key press. All
+ * keycodes above the table are ignored for dwt anyway (they're >= KEY_F1
+ * and none of them are modifiers), so 256 bits per class are enough. */
+#define DWT_KEY_CLASS_NKEYS 256
+
+static unsigned long dwt_modifier_mask[NLONGS(DWT_KEY_CLASS_NKEYS)];
+static unsigned long dwt_typewriter_mask[NLONGS(DWT_KEY_CLASS_NKEYS)];
+
+static void
+tp_init_dwt_key_masks(void)
+{
+	unsigned int key;
+
+	if (long_any_bit_set(dwt_typewriter_mask,
+			     ARRAY_LENGTH(dwt_typewriter_mask)))
+		return;
+
+	for (key = 0; key < DWT_KEY_CLASS_NKEYS; key++) {
+		if (tp_key_is_modifier(key))
+			long_set_bit(dwt_modifier_mask, key);
+		else if (!tp_key_ignore_for_dwt(key))
+			long_set_bit(dwt_typewriter_mask, key);
+	}
+}
+
 static void
 tp_keyboard_event(uint64_t time, struct libinput_event *event, void *data)
 {
@@ -2310,17 +2644,21 @@ tp_keyboard_event(uint64_t time, struct libinput_event *event, void *data)
 	if (!tp->dwt.dwt_enabled)
 		return;
 
-	if (tp_key_ignore_for_dwt(key))
-		return;
-
 	/* modifier keys don't trigger disable-while-typing so things like
 	 * ctrl+zoom or ctrl+click are possible */
-	is_modifier = tp_key_is_modifier(key);
+	is_modifier = key < DWT_KEY_CLASS_NKEYS &&
+		      long_bit_is_set(dwt_modifier_mask, key);
 	if (is_modifier) {
 		long_set_bit(tp->dwt.mod_mask, key);
 		return;
 	}
 
+	/* Keys not part of the "typewriter set", i.e. F-keys, multimedia
+	 * keys, numpad, etc. don't trigger dwt either */
+	if (key >= DWT_KEY_CLASS_NKEYS ||
+	    !long_bit_is_set(dwt_typewriter_mask, key))
+		return;
+
 	if (!tp->dwt.keyboard_active) {
 		/* This is the first non-modifier key press. Check if the
 		 * modifier mask is set. If any modifier is down we don't
@@ -2340,8 +2678,15 @@ tp_keyboard_event(uint64_t time, struct libinput_event *event, void *data)
 
 	tp->dwt.keyboard_last_press_time = time;
 	long_set_bit(tp->dwt.key_mask, key);
-	libinput_timer_set(&tp->dwt.keyboard_timer,
-			   time + timeout);
+
+	/* Only arm the timer when it isn't running yet, later presses
+	 * merely bump the intended expiry and the timeout handler
+	 * re-arms. This batches the timer updates during continuous
+	 * typing to one per timeout instead of one per key. */
+	if (tp->dwt.keyboard_timer_expiry == 0)
+		libinput_timer_set(&tp->dwt.keyboard_timer,
+				   time + timeout);
+	tp->dwt.keyboard_timer_expiry = time + timeout;
 }
 
 static bool
@@ -2420,6 +2765,7 @@ tp_pair_trackpoint(struct evdev_device *touchpad,
 		/* Don't send any pending releases to the new trackpoint */
 		tp->buttons.active_is_topbutton = false;
 		tp->buttons.trackpoint = trackpoint;
+		tp->buttons.trackpoint_dispatch = trackpoint->dispatch;
 		if (tp->palm.monitor_trackpoint)
 			libinput_device_add_event_listener(&trackpoint->base,
 						&tp->palm.trackpoint_listener,
@@ -2635,6 +2981,7 @@ tp_interface_device_removed(struct evdev_device *device,
 			libinput_device_remove_event_listener(
 						&tp->palm.trackpoint_listener);
 		tp->buttons.trackpoint = NULL;
+		tp->buttons.trackpoint_dispatch = NULL;
 	}
 
 	list_for_each_safe(kbd, &tp->dwt.paired_keyboard_list, link) {
@@ -2660,11 +3007,16 @@ tp_interface_device_removed(struct evdev_device *device,
 
 	if (tp->sendevents.current_mode ==
 		    LIBINPUT_CONFIG_SEND_EVENTS_DISABLED_ON_EXTERNAL_MOUSE) {
-		struct libinput_device *dev;
+		struct libinput_seat *seat = device->base.seat;
 		bool found = false;
 
-		list_for_each(dev, &device->base.seat->devices_list, link) {
-			struct evdev_device *d = evdev_device(dev);
+		for (size_t i = 0; i < seat->devices_len; i++) {
+			struct libinput_device *dev = seat->devices[i];
+			struct evdev_device *d;
+
+			if (!dev)
+				continue;
+			d = evdev_device(dev);
 			if (d != removed_device &&
 			    (d->tags & EVDEV_TAG_EXTERNAL_MOUSE)) {
 				found = true;
@@ -2769,6 +3121,20 @@ static void
 tp_arbitration_timeout(uint64_t now, void *data)
 {
 	struct tp_dispatch *tp = data;
+	uint64_t expiry = tp->arbitration.arbitration_timer_expiry;
+
+	/* arbitration re-engaged before the release deadline */
+	if (expiry == 0)
+		return;
+
+	/* a later proximity-out moved the deadline, fire then */
+	if (expiry > now) {
+		libinput_timer_set(&tp->arbitration.arbitration_timer,
+				   expiry);
+		return;
+	}
+
+	tp->arbitration.arbitration_timer_expiry = 0;
 
 	if (tp->arbitration.state != ARBITRATION_NOT_ACTIVE)
 		tp->arbitration.state = ARBITRATION_NOT_ACTIVE;
@@ -2789,7 +3155,10 @@ tp_interface_toggle_touch(struct evdev_dispatch *dispatch,
 	switch (which) {
 	case ARBITRATION_IGNORE_ALL:
 	case ARBITRATION_IGNORE_RECT:
-		libinput_timer_cancel(&tp->arbitration.arbitration_timer);
+		/* invalidate a pending release instead of cancelling the
+		 * timer, handwriting toggles proximity constantly and the
+		 * no-op firing is cheaper than the heap churn */
+		tp->arbitration.arbitration_timer_expiry = 0;
 		tp_clear_state(tp);
 		tp->arbitration.state = which;
 		break;
@@ -2801,8 +3170,10 @@ tp_interface_toggle_touch(struct evdev_dispatch *dispatch,
 		 * get what looks like a tap. Fix this by delaying
 		 * arbitration by just a little bit so that any touch in
 		 * event is caught as palm touch. */
-		libinput_timer_set(&tp->arbitration.arbitration_timer,
-				   time + ms2us(90));
+		if (tp->arbitration.arbitration_timer_expiry == 0)
+			libinput_timer_set(&tp->arbitration.arbitration_timer,
+					   time + ms2us(90));
+		tp->arbitration.arbitration_timer_expiry = time + ms2us(90);
 		break;
 	}
 }
@@ -2867,6 +3238,32 @@ tp_disable_abs_mt(struct evdev_device *device)
 		libevdev_disable_event_code(evdev, EV_ABS, code);
 }
 
+static unsigned int
+tp_motion_history_size(struct tp_dispatch *tp)
+{
+	const char *env = getenv("LIBINPUT_TOUCHPAD_HISTORY_SIZE");
+	unsigned int size;
+
+	/* The env var pins the ring size, disabling the runtime
+	 * adaptation below. Must be a power of two. */
+	if (env && safe_atou(env, &size) &&
+	    size >= 2 && size <= TOUCHPAD_HISTORY_LENGTH &&
+	    (size & (size - 1)) == 0) {
+		tp->cadence.pinned = true;
+		return size;
+	}
+
+	/* A cadence persisted from a previous run skips the warmup, see
+	 * evdev_device_cache_load(). Adaptation continues from the seed */
+	if (tp->device->cadence.interval) {
+		tp->cadence.interval = tp->device->cadence.interval;
+		if (tp->cadence.interval < ms2us(7))
+			return TOUCHPAD_HISTORY_LENGTH;
+	}
+
+	return TOUCHPAD_HISTORY_DEFAULT;
+}
+
 static bool
 tp_init_slots(struct tp_dispatch *tp,
 	      struct evdev_device *device)
@@ -2883,6 +3280,7 @@ tp_init_slots(struct tp_dispatch *tp,
 	};
 	struct map *m;
 	unsigned int i, n_btn_tool_touches = 1;
+	unsigned int history_size;
 
 	absinfo = libevdev_get_abs_info(device->evdev, ABS_MT_SLOT);
 	if (absinfo) {
@@ -2936,10 +3334,43 @@ tp_init_slots(struct tp_dispatch *tp,
 	}
 
 	tp->ntouches = max(tp->num_slots, n_btn_tool_touches);
-	tp->touches = zalloc(tp->ntouches * sizeof(struct tp_touch));
 
-	for (i = 0; i < tp->ntouches; i++)
+	/* The touches array is the big per-device allocation; callers
+	 * with NUMA placement or hugepage-backed pools can provide the
+	 * backing memory via libinput_set_allocation_hooks(). Otherwise
+	 * the motion history ring wants cache-line alignment, plain
+	 * zalloc only guarantees malloc alignment */
+	struct libinput *libinput = tp_libinput_context(tp);
+	size_t touches_size = tp->ntouches * sizeof(struct tp_touch);
+
+	if (libinput->alloc_hooks.alloc) {
+		tp->touches = libinput->alloc_hooks.alloc(
+					touches_size,
+					libinput->alloc_hooks.user_data);
+		/* The history ring needs cache-line alignment; a hook
+		 * that only guarantees malloc alignment gets its memory
+		 * back */
+		if (tp->touches && ((uintptr_t)tp->touches & 63) != 0) {
+			libinput->alloc_hooks.free(
+					tp->touches,
+					touches_size,
+					libinput->alloc_hooks.user_data);
+			tp->touches = NULL;
+		}
+		tp->touches_hooked = tp->touches != NULL;
+	}
+	if (!tp->touches)
+		tp->touches = aligned_alloc(64, touches_size);
+	if (!tp->touches)
+		abort();
+	memset(tp->touches, 0, touches_size);
+
+	history_size = tp_motion_history_size(tp);
+	tp->cadence.history_size = history_size;
+	for (i = 0; i < tp->ntouches; i++) {
 		tp_init_touch(tp, &tp->touches[i], i);
+		tp->touches[i].history.size = history_size;
+	}
 
 	tp_sync_slots(tp, device);
 
@@ -2980,6 +3411,16 @@ tp_init_accel(struct tp_dispatch *tp, enum libinput_config_accel_profile which)
 	tp->accel.x_scale_coeff = (DEFAULT_MOUSE_DPI/25.4) / res_x;
 	tp->accel.y_scale_coeff = (DEFAULT_MOUSE_DPI/25.4) / res_y;
 	tp->accel.xy_scale_coeff = 1.0 * res_x/res_y;
+	tp->accel.x_mm_coeff = 1.0 / res_x;
+	tp->accel.y_mm_coeff = 1.0 / res_y;
+	/* The Q16.16 reciprocal is off by less than 1/65536 per unit,
+	 * plenty for the speed estimate. Only a (hypothetical) resolution
+	 * above 2^16 units/mm truncates to zero and keeps the double
+	 * path. */
+	tp->accel.x_mm_coeff_fp = (UINT32_C(1) << 16) / res_x;
+	tp->accel.y_mm_coeff_fp = (UINT32_C(1) << 16) / res_y;
+	tp->accel.use_fixed_mm_coeff = tp->accel.x_mm_coeff_fp > 0 &&
+				       tp->accel.y_mm_coeff_fp > 0;
 
 	if (which == LIBINPUT_CONFIG_ACCEL_PROFILE_FLAT)
 		filter = create_pointer_accelerator_filter_touchpad_flat(dpi);
@@ -3024,6 +3465,9 @@ tp_accel_config_set_profile(struct libinput_device *libinput_device,
 	struct motion_filter *filter;
 	double speed;
 
+	if (libinput_config_txn_defer_accel_profile(libinput_device, profile))
+		return LIBINPUT_CONFIG_STATUS_SUCCESS;
+
 	filter = device->pointer.filter;
 	if (filter_get_type(filter) == profile)
 		return LIBINPUT_CONFIG_STATUS_SUCCESS;
@@ -3084,6 +3528,7 @@ tp_scroll_config_scroll_method_set_method(struct libinput_device *device,
 	tp_gesture_stop_twofinger_scroll(tp, time);
 
 	tp->scroll.method = method;
+	tp_thumb_compile_jail_table(tp);
 
 	return LIBINPUT_CONFIG_STATUS_SUCCESS;
 }
@@ -3414,6 +3859,8 @@ tp_init_sendevents(struct tp_dispatch *tp,
 			    tp_libinput_context(tp),
 			    timer_name,
 			    tp_keyboard_timeout, tp);
+
+	tp_init_dwt_key_masks();
 }
 
 static bool
@@ -3493,6 +3940,7 @@ tp_init_hysteresis(struct tp_dispatch *tp)
 	tp->hysteresis.margin.x = xmargin;
 	tp->hysteresis.margin.y = ymargin;
 	tp->hysteresis.enabled = (ax->fuzz || ay->fuzz);
+	tp_hysteresis_select_filter(tp);
 	if (tp->hysteresis.enabled)
 		evdev_log_debug(tp->device,
 				"hysteresis enabled. "
@@ -3632,6 +4080,66 @@ tp_init_pressurepad(struct tp_dispatch *tp,
 	}
 }
 
+void
+tp_zones_rebuild(struct tp_dispatch *tp)
+{
+	int32_t x, y;
+
+	/* Config changes can retrigger the zone inits before the tables
+	 * are allocated; tp_init() rebuilds once at the end anyway */
+	if (!tp->zones.xflags)
+		return;
+
+	for (x = tp->zones.xmin; x <= tp->zones.xmax; x++) {
+		uint16_t flags = 0;
+
+		if (x > tp->scroll.right_edge)
+			flags |= TP_ZONE_SCROLL_RIGHT;
+		if (x < tp->palm.left_edge || x > tp->palm.right_edge)
+			flags |= TP_ZONE_PALM_SIDE;
+		if (x > tp->buttons.bottom_area.rightbutton_left_edge)
+			flags |= TP_ZONE_BOTTOM_RIGHT;
+		if (x > tp->buttons.bottom_area.middlebutton_left_edge)
+			flags |= TP_ZONE_BOTTOM_MIDDLE;
+		if (x > tp->buttons.top_area.rightbutton_left_edge)
+			flags |= TP_ZONE_TOP_RIGHT;
+		if (x >= tp->buttons.top_area.leftbutton_right_edge &&
+		    x <= tp->buttons.top_area.rightbutton_left_edge)
+			flags |= TP_ZONE_TOP_MIDDLE;
+
+		tp->zones.xflags[x - tp->zones.xmin] = flags;
+	}
+
+	for (y = tp->zones.ymin; y <= tp->zones.ymax; y++) {
+		uint16_t flags = 0;
+
+		if (y > tp->scroll.bottom_edge)
+			flags |= TP_ZONE_SCROLL_BOTTOM;
+		if (y < tp->palm.upper_edge)
+			flags |= TP_ZONE_PALM_TOP;
+		if (y >= tp->buttons.bottom_area.top_edge)
+			flags |= TP_ZONE_BOTTOM_BUTTON;
+		if (y <= tp->buttons.top_area.bottom_edge)
+			flags |= TP_ZONE_TOP_BUTTON;
+
+		tp->zones.yflags[y - tp->zones.ymin] = flags;
+	}
+}
+
+static void
+tp_init_zones(struct tp_dispatch *tp, struct evdev_device *device)
+{
+	tp->zones.xmin = device->abs.absinfo_x->minimum;
+	tp->zones.xmax = device->abs.absinfo_x->maximum;
+	tp->zones.ymin = device->abs.absinfo_y->minimum;
+	tp->zones.ymax = device->abs.absinfo_y->maximum;
+
+	tp->zones.xflags = zalloc((tp->zones.xmax - tp->zones.xmin + 1) *
+				  sizeof(*tp->zones.xflags));
+	tp->zones.yflags = zalloc((tp->zones.ymax - tp->zones.ymin + 1) *
+				  sizeof(*tp->zones.yflags));
+}
+
 static int
 tp_init(struct tp_dispatch *tp,
 	struct evdev_device *device)
@@ -3652,6 +4160,8 @@ tp_init(struct tp_dispatch *tp,
 	if (!tp_init_slots(tp, device))
 		return false;
 
+	tp_init_zones(tp, device);
+
 
 	evdev_device_init_abs_range_warnings(device);
 	use_touch_size = tp_init_touch_size(tp, device);
@@ -3659,6 +4169,13 @@ tp_init(struct tp_dispatch *tp,
 	if (!use_touch_size)
 		tp_init_pressure(tp, device);
 
+	if (tp->pressure.use_pressure)
+		tp->unhover = tp_unhover_pressure;
+	else if (tp->touch_size.use_touch_size)
+		tp->unhover = tp_unhover_size;
+	else
+		tp->unhover = tp_unhover_fake_touches;
+
 	/* 5 warnings per 24 hours should be enough */
 	ratelimit_init(&tp->jump.warning, h2us(24), 5);
 
@@ -3688,6 +4205,9 @@ tp_init(struct tp_dispatch *tp,
 					 QUIRK_MODEL_LENOVO_X1GEN6_TOUCHPAD))
 		tp->jump.detection_disabled = true;
 
+	/* all the edge-defining inits have run by now */
+	tp_zones_rebuild(tp);
+
 	device->seat_caps |= EVDEV_DEVICE_POINTER;
 	if (tp->gesture.enabled)
 		device->seat_caps |= EVDEV_DEVICE_GESTURE;
@@ -3711,10 +4231,15 @@ static void
 tp_suspend_conditional(struct tp_dispatch *tp,
 		       struct evdev_device *device)
 {
-	struct libinput_device *dev;
+	struct libinput_seat *seat = device->base.seat;
+
+	for (size_t i = 0; i < seat->devices_len; i++) {
+		struct libinput_device *dev = seat->devices[i];
+		struct evdev_device *d;
 
-	list_for_each(dev, &device->base.seat->devices_list, link) {
-		struct evdev_device *d = evdev_device(dev);
+		if (!dev)
+			continue;
+		d = evdev_device(dev);
 		if (d->tags & EVDEV_TAG_EXTERNAL_MOUSE) {
 			tp_suspend(tp, device, SUSPEND_EXTERNAL_MOUSE);
 			break;
@@ -29,7 +29,11 @@
 #include "evdev.h"
 #include "timer.h"
 
-#define TOUCHPAD_HISTORY_LENGTH 4
+/* Capacity of the motion history ring. Must be a power of two so ring
+ * indexing is a single mask, see tp_motion_history_offset() */
+#define TOUCHPAD_HISTORY_LENGTH 8
+/* Ring size actually used unless overridden, see tp_motion_history_size() */
+#define TOUCHPAD_HISTORY_DEFAULT 4
 #define TOUCHPAD_MIN_SAMPLES 4
 
 /* Convert mm to a distance normalized to DEFAULT_MOUSE_DPI */
@@ -147,6 +151,25 @@ enum tp_edge {
 	EDGE_BOTTOM	= bit(1),
 };
 
+/* Per-axis zone classification bits, precomputed into the lookup tables
+ * rebuilt by tp_zones_rebuild(). All the touchpad's zones (edge-scroll
+ * edges, software button areas, palm edges) are axis-aligned threshold
+ * comparisons, so a coordinate's full classification is the OR of its
+ * x-table and y-table entries. Zones spanning both axes (e.g. the bottom
+ * right button) are a combination of one x bit and one y bit. */
+enum tp_zone {
+	TP_ZONE_SCROLL_RIGHT	= bit(0),	/* x */
+	TP_ZONE_SCROLL_BOTTOM	= bit(1),	/* y */
+	TP_ZONE_PALM_SIDE	= bit(2),	/* x */
+	TP_ZONE_PALM_TOP	= bit(3),	/* y */
+	TP_ZONE_BOTTOM_BUTTON	= bit(4),	/* y */
+	TP_ZONE_BOTTOM_RIGHT	= bit(5),	/* x */
+	TP_ZONE_BOTTOM_MIDDLE	= bit(6),	/* x */
+	TP_ZONE_TOP_BUTTON	= bit(7),	/* y */
+	TP_ZONE_TOP_RIGHT	= bit(8),	/* x */
+	TP_ZONE_TOP_MIDDLE	= bit(9),	/* x */
+};
+
 enum tp_edge_scroll_touch_state {
 	EDGE_SCROLL_TOUCH_STATE_NONE,
 	EDGE_SCROLL_TOUCH_STATE_EDGE_NEW,
@@ -182,19 +205,44 @@ enum tp_jump_state {
 };
 
 struct tp_touch {
+	/* Everything the per-event and per-frame loops touch for every
+	 * slot lives in the first cache line; the per-feature state
+	 * below is only pulled in once its feature engages */
 	struct tp_dispatch *tp;
+	struct device_coords point;
 	unsigned int index;
 	enum touch_state state;
 	bool has_ended;				/* TRACKING_ID == -1 */
 	bool dirty;
-	struct device_coords point;
-	uint64_t initial_time;
-	int pressure;
+	bool was_down; /* if distance == 0, false for pure hovering
+			  touches */
 	bool is_tool_palm; /* MT_TOOL_PALM */
+	int pressure;
 	int major, minor;
 
-	bool was_down; /* if distance == 0, false for pure hovering
-			  touches */
+	/* Shared per-touch geometry, extracted once per frame by
+	 * tp_touch_extract_features() instead of each consumer (palm,
+	 * thumb, edge scroll, tap) re-deriving it from the raw point */
+	struct {
+		uint32_t edge;			/* tp_touch_get_edge() */
+		bool palm_edge;			/* in a palm exclusion edge */
+		bool below_upper_thumb_line;
+		bool below_lower_thumb_line;
+		bool thumb_pressure_size;	/* pressure/size says thumb */
+		/* The three bits above packed as an index into
+		   tp->thumb.jail_table */
+		uint8_t thumb_bits;
+
+		/* Range classification against the device thresholds,
+		 * one sweep over all slots per frame in
+		 * tp_classify_touches() */
+		bool pressure_high;	/* >= pressure.high */
+		bool pressure_low;	/* < pressure.low */
+		bool size_high;		/* major/minor over touch-size begin */
+		bool size_low;		/* major or minor below touch-size end */
+		bool palm_pressure;	/* > palm.pressure_threshold */
+		bool palm_size;		/* major or minor > palm.size_threshold */
+	} features;
 
 	struct {
 		/* A quirk mostly used on Synaptics touchpads. In a
@@ -205,14 +253,7 @@ struct tp_touch {
 		bool reset_motion_history;
 	} quirks;
 
-	struct {
-		struct tp_history_point {
-			uint64_t time;
-			struct device_coords point;
-		} samples[TOUCHPAD_HISTORY_LENGTH];
-		unsigned int index;
-		unsigned int count;
-	} history;
+	uint64_t initial_time;
 
 	struct {
 		double last_delta_mm;
@@ -266,12 +307,32 @@ struct tp_touch {
 
 	struct {
 		struct device_coords initial;
+
+		/* Movement since gesture start, cached so a pending
+		 * detector frame only recomputes it for touches that
+		 * actually moved. cached_point is the position the
+		 * cached values were computed for. */
+		struct device_coords cached_point;
+		struct phys_coords moved_mm;
+		uint32_t direction;
 	} gesture;
 
 	struct {
 		double last_speed; /* speed in mm/s at last sample */
 		unsigned int exceeded_count;
 	} speed;
+
+	struct {
+		/* Align the ring to a cache line; the 16-byte entries
+		 * then never straddle one */
+		struct tp_history_point {
+			uint64_t time;
+			struct device_coords point;
+		} samples[TOUCHPAD_HISTORY_LENGTH] __attribute__((aligned(64)));
+		unsigned int index;
+		unsigned int count;
+		unsigned int size; /* in-use ring size, power of two */
+	} history;
 };
 
 enum suspend_trigger {
@@ -291,18 +352,36 @@ struct tp_dispatch {
 	bool has_mt;
 	bool semi_mt;
 
+	/* measured report cadence; the motion history depth follows it,
+	 * applied as each touch's ring empties, see
+	 * tp_motion_history_adapt() */
+	struct {
+		uint64_t last_frame_time;
+		uint64_t interval; /* EWMA of the frame interval in µs */
+		unsigned int history_size;
+		bool pinned; /* env override in place, don't adapt */
+	} cadence;
+
 	uint32_t suspend_reason;
 
 	/* pen/touch arbitration */
 	struct {
 		enum evdev_arbitration_state state;
 		struct libinput_timer arbitration_timer;
+		/* pending release deadline; proximity transitions bump
+		 * this instead of re-arming or cancelling the timer, 0
+		 * while no release is pending */
+		uint64_t arbitration_timer_expiry;
 	} arbitration;
 
 	unsigned int nactive_slots;		/* number of active slots */
 	unsigned int num_slots;			/* number of slots */
 	unsigned int ntouches;			/* no slots inc. fakes */
 	struct tp_touch *touches;		/* len == ntouches */
+	bool touches_hooked;			/* touches came from
+						   alloc_hooks */
+	uint64_t dirty_slots;			/* bitmask of dirty touches,
+						   covers indices < 64 */
 	/* bit 0: BTN_TOUCH
 	 * bit 1: BTN_TOOL_FINGER
 	 * bit 2: BTN_TOOL_DOUBLETAP
@@ -315,6 +394,10 @@ struct tp_dispatch {
 		struct ratelimit warning;
 	} jump;
 
+	/* Selected at init from the pressure/size/fake-touch variants so
+	 * tp_unhover_touches() doesn't re-branch every frame */
+	void (*unhover)(struct tp_dispatch *tp, uint64_t time);
+
 	/* if pressure goes above high -> touch down,
 	   if pressure then goes below low -> touch up */
 	struct {
@@ -339,12 +422,31 @@ struct tp_dispatch {
 		struct device_coords margin;
 		unsigned int other_event_count;
 		uint64_t last_motion_time;
+		/* The per-touch filter stage, selected at init and
+		 * swapped when wobbling shows up at runtime, see
+		 * tp_hysteresis_select_filter(). Precise devices only
+		 * run the wobble detector. */
+		void (*filter)(struct tp_dispatch *tp,
+			       struct tp_touch *t,
+			       uint64_t time);
 	} hysteresis;
 
 	struct {
 		double x_scale_coeff;
 		double y_scale_coeff;
 		double xy_scale_coeff;
+		/* unit-to-mm conversion, cached so the per-touch speed
+		 * pass doesn't have to divide by the resolution on every
+		 * event */
+		double x_mm_coeff;
+		double y_mm_coeff;
+		/* the same coefficients in Q16.16; when set, the per-touch
+		 * speed pass runs integer-only which matters on boards
+		 * without double hardware, see
+		 * tp_calculate_motion_speed() */
+		bool use_fixed_mm_coeff;
+		uint32_t x_mm_coeff_fp;
+		uint32_t y_mm_coeff_fp;
 	} accel;
 
 	struct {
@@ -363,6 +465,22 @@ struct tp_dispatch {
 		struct device_float_coords center;
 		struct libinput_timer hold_timer;
 		bool hold_enabled;
+
+		/* Three-finger drag, see
+		 * libinput_device_config_gesture_set_3fg_drag_enabled().
+		 * While active, the three-finger swipe posts as a held
+		 * button plus pointer motion instead of gesture events */
+		bool drag_3fg_enabled;
+		bool drag_3fg_active;
+
+		/* Batching window for two-finger scroll in µs, see
+		 * libinput_device_config_gesture_set_scroll_batch_window().
+		 * 0 means post on every frame. */
+		uint64_t scroll_batch_window;
+		struct device_float_coords scroll_batch; /* unaccelerated */
+		uint64_t scroll_last_flush_time;
+		bool scroll_batch_pending;
+		struct libinput_timer scroll_batch_timer;
 	} gesture;
 
 	struct {
@@ -396,11 +514,31 @@ struct tp_dispatch {
 		} top_area;
 
 		struct evdev_device *trackpoint;
+		/* cached at pairing time so the button forwarding paths
+		 * don't chase the device pointer per event */
+		struct evdev_dispatch *trackpoint_dispatch;
 
 		enum libinput_config_click_method click_method;
 		struct libinput_device_config_click_method config_method;
+
+		/* area bits to button choice, precomputed at init; the
+		 * first index combines a simultaneous left+right press
+		 * into a middle click, see tp_init_clickpad_area_map() */
+		struct {
+			uint32_t button;
+			bool want_left_handed;
+		} area_map[2][16];
 	} buttons;
 
+	/* per-axis zone lookup tables, one entry per device coordinate
+	 * within the axis range, each an OR of enum tp_zone bits */
+	struct {
+		uint16_t *xflags;
+		uint16_t *yflags;
+		int32_t xmin, xmax;
+		int32_t ymin, ymax;
+	} zones;
+
 	struct {
 		struct libinput_device_config_scroll_method config_method;
 		enum libinput_config_scroll_method method;
@@ -430,6 +568,9 @@ struct tp_dispatch {
 
 		enum libinput_config_tap_button_map map;
 		enum libinput_config_tap_button_map want_map;
+		/* finger count less one to button, rebuilt when a new
+		 * map is committed, see tp_tap_rebuild_button_map() */
+		int32_t button_map[3];
 
 		bool drag_enabled;
 		bool drag_lock_enabled;
@@ -445,6 +586,10 @@ struct tp_dispatch {
 		bool trackpoint_active;
 		struct libinput_event_listener trackpoint_listener;
 		struct libinput_timer trackpoint_timer;
+		/* intended expiry of trackpoint_timer; events during a
+		 * motion burst bump this instead of re-arming the timer,
+		 * see tp_trackpoint_event() */
+		uint64_t trackpoint_timer_expiry;
 		uint64_t trackpoint_last_event_time;
 		uint32_t trackpoint_event_count;
 		bool monitor_trackpoint;
@@ -479,6 +624,11 @@ struct tp_dispatch {
 		bool keyboard_active;
 		struct libinput_timer keyboard_timer;
 		uint64_t keyboard_last_press_time;
+		/* When we want the timer to expire. The timer itself may be
+		 * armed for an earlier time, the handler re-arms it as
+		 * needed. This avoids a timer update on every key press
+		 * while the user is typing. */
+		uint64_t keyboard_timer_expiry;
 	} dwt;
 
 	struct {
@@ -491,10 +641,20 @@ struct tp_dispatch {
 
 		bool use_size;
 		int size_threshold;
+		/* 0.6 * size_threshold, precomputed so the per-touch
+		 * check stays a plain integer comparison */
+		int size_threshold_minor;
 
 		enum tp_thumb_state state;
 		unsigned int index;
 		bool pinch_eligible;
+
+		/* The jail decision compiled into a lookup table by
+		   tp_thumb_compile_jail_table(), indexed by
+		   t->features.thumb_bits. The scroll method and the
+		   hw pressure/size capability are baked in, so the
+		   per-touch evaluation is a single bit test */
+		uint8_t jail_table;
 	} thumb;
 
 	struct {
@@ -545,12 +705,67 @@ tp_dispatch(struct evdev_dispatch *dispatch)
 #define tp_for_each_touch(_tp, _t) \
 	for (unsigned int _i = 0; _i < (_tp)->ntouches && (_t = &(_tp)->touches[_i]); _i++)
 
+static inline void
+tp_touch_set_dirty(struct tp_dispatch *tp, struct tp_touch *t)
+{
+	t->dirty = true;
+	if (t->index < 64)
+		tp->dirty_slots |= 1ULL << t->index;
+}
+
+/* Return the next dirty touch at or after *index, NULL if there is none.
+ * Most devices have 1-2 live slots out of 10+, the bitmask skips the
+ * rest without touching their memory. Indices beyond the mask (no known
+ * device has >64 slots) fall back to checking the dirty flag.
+ */
+static inline struct tp_touch *
+tp_next_dirty_touch(struct tp_dispatch *tp, unsigned int *index)
+{
+	while (*index < tp->ntouches) {
+		unsigned int i = *index;
+
+		if (i < 64) {
+			uint64_t mask = tp->dirty_slots >> i;
+
+			if (mask == 0) {
+				*index = 64;
+				continue;
+			}
+			i += __builtin_ctzll(mask);
+			*index = i + 1;
+			return &tp->touches[i];
+		}
+
+		(*index)++;
+		if (tp->touches[i].dirty)
+			return &tp->touches[i];
+	}
+
+	return NULL;
+}
+
+#define tp_for_each_dirty_touch(_tp, _t) \
+	for (unsigned int _i = 0; (_t = tp_next_dirty_touch(_tp, &_i)); )
+
 static inline struct libinput*
 tp_libinput_context(const struct tp_dispatch *tp)
 {
 	return evdev_libinput_context(tp->device);
 }
 
+static inline uint16_t
+tp_zones_classify(const struct tp_dispatch *tp, struct device_coords point)
+{
+	/* Out-of-range coordinates clamp to the table edges. All real
+	 * thresholds lie within the axis range, the INT_MIN/INT_MAX
+	 * sentinels are unreachable either way */
+	int32_t x = min(max(point.x, tp->zones.xmin), tp->zones.xmax),
+		y = min(max(point.y, tp->zones.ymin), tp->zones.ymax);
+
+	return tp->zones.xflags[x - tp->zones.xmin] |
+	       tp->zones.yflags[y - tp->zones.ymin];
+}
+
 static inline struct normalized_coords
 tp_normalize_delta(const struct tp_dispatch *tp,
 		   struct device_float_coords delta)
@@ -611,6 +826,9 @@ bool
 tp_touch_active_for_gesture(const struct tp_dispatch *tp,
 			    const struct tp_touch *t);
 
+void
+tp_zones_rebuild(struct tp_dispatch *tp);
+
 int
 tp_tap_handle_state(struct tp_dispatch *tp, uint64_t time);
 
@@ -735,6 +953,9 @@ tp_thumb_ignored(const struct tp_dispatch *tp, const struct tp_touch *t);
 void
 tp_thumb_reset(struct tp_dispatch *tp);
 
+void
+tp_thumb_compile_jail_table(struct tp_dispatch *tp);
+
 bool
 tp_thumb_ignored_for_gesture(const struct tp_dispatch *tp, const struct tp_touch *t);
 
@@ -25,8 +25,10 @@
 
 #include <limits.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 #include "evdev-tablet-pad.h"
+#include "util-lock.h"
 
 #if HAVE_LIBWACOM
 #include <libwacom/libwacom.h>
@@ -36,6 +38,18 @@ struct pad_led_group {
 	struct libinput_tablet_pad_mode_group base;
 	struct list led_list;
 	struct list toggle_button_list;
+
+	/* The kernel flips the LEDs on a mode toggle press, we only read
+	 * the result back from sysfs. That read blocks on hardware for
+	 * some pads, so it runs on this thread instead of in dispatch.
+	 * Presses arriving while a read-back is in flight are merged
+	 * into the next one. */
+	pthread_t thread;
+	struct lock lock;
+	pthread_cond_t cond;
+	bool thread_running;
+	bool stop;
+	unsigned int refresh_pending; /* toggle presses since last read-back */
 };
 
 struct pad_mode_toggle_button {
@@ -147,6 +161,53 @@ error:
 	return NULL;
 }
 
+static void *
+pad_led_group_thread(void *data)
+{
+	struct pad_led_group *group = data;
+
+	lock_acquire(&group->lock);
+	while (true) {
+		int mode;
+
+		while (group->refresh_pending == 0 && !group->stop)
+			lock_cond_wait(&group->lock, &group->cond);
+
+		if (group->stop)
+			break;
+
+		/* Merge toggles that arrived faster than the hardware
+		 * shows them, one read-back covers all of them */
+		group->refresh_pending = 0;
+
+		lock_release(&group->lock);
+		mode = pad_led_group_get_mode(group);
+		lock_acquire(&group->lock);
+
+		/* Plain aligned-word read on the dispatch side, see
+		 * pad_button_update_mode() */
+		if (mode >= 0)
+			__atomic_store_n(&group->base.current_mode,
+					 (unsigned int)mode,
+					 __ATOMIC_RELAXED);
+	}
+	lock_release(&group->lock);
+
+	return NULL;
+}
+
+static void
+pad_led_group_start_thread(struct pad_led_group *group)
+{
+	if (pthread_create(&group->thread,
+			   NULL,
+			   pad_led_group_thread,
+			   group) != 0)
+		return; /* fall back to synchronous read-back */
+
+	group->thread_running = true;
+}
+
 static void
 pad_led_group_destroy(struct libinput_tablet_pad_mode_group *g)
 {
@@ -154,6 +215,16 @@ pad_led_group_destroy(struct libinput_tablet_pad_mode_group *g)
 	struct pad_mode_toggle_button *button;
 	struct pad_mode_led *led;
 
+	if (group->thread_running) {
+		lock_acquire(&group->lock);
+		group->stop = true;
+		pthread_cond_broadcast(&group->cond);
+		lock_release(&group->lock);
+		pthread_join(group->thread, NULL);
+	}
+	lock_destroy(&group->lock);
+	pthread_cond_destroy(&group->cond);
+
 	list_for_each_safe(button, &group->toggle_button_list, link)
 		pad_mode_toggle_button_destroy(button);
 
@@ -179,6 +250,8 @@ pad_group_new_basic(struct pad_dispatch *pad,
 	group->base.destroy = pad_led_group_destroy;
 	list_init(&group->toggle_button_list);
 	list_init(&group->led_list);
+	lock_init(&group->lock);
+	pthread_cond_init(&group->cond, NULL);
 
 	return group;
 }
@@ -222,6 +295,8 @@ pad_group_new(struct pad_dispatch *pad,
 
 	group->base.current_mode = rc;
 
+	pad_led_group_start_thread(group);
+
 	return group;
 
 error:
@@ -597,9 +672,19 @@ pad_button_update_mode(struct libinput_tablet_pad_mode_group *g,
 	if (!libinput_tablet_pad_mode_group_button_is_toggle(g, button_index))
 		return;
 
-	rc = pad_led_group_get_mode(group);
-	if (rc >= 0)
-		group->base.current_mode = rc;
+	if (!group->thread_running) {
+		rc = pad_led_group_get_mode(group);
+		if (rc >= 0)
+			group->base.current_mode = rc;
+		return;
+	}
+
+	/* Kick the read-back thread, current_mode updates as soon as the
+	 * hardware reports the new state */
+	lock_acquire(&group->lock);
+	group->refresh_pending++;
+	pthread_cond_broadcast(&group->cond);
+	lock_release(&group->lock);
 }
 
 int
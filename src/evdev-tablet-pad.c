@@ -215,36 +215,62 @@ pad_handle_strip(struct pad_dispatch *pad,
 	return pos;
 }
 
-static inline struct libinput_tablet_pad_mode_group *
-pad_ring_get_mode_group(struct pad_dispatch *pad,
-			unsigned int ring)
+static void
+pad_rebuild_mode_routing(struct pad_dispatch *pad)
 {
 	struct libinput_tablet_pad_mode_group *group;
+	unsigned int i;
+
+	/* Group membership is fixed at init time, so event dispatch can
+	   resolve the owning group with an array index instead of
+	   walking the group list per button press */
+	memset(pad->modes.button_group, 0, sizeof(pad->modes.button_group));
+	memset(pad->modes.ring_group, 0, sizeof(pad->modes.ring_group));
+	memset(pad->modes.strip_group, 0, sizeof(pad->modes.strip_group));
 
 	list_for_each(group, &pad->modes.mode_group_list, link) {
-		if (libinput_tablet_pad_mode_group_has_ring(group, ring))
-			return group;
+		for (i = 0; i < ARRAY_LENGTH(pad->modes.button_group); i++) {
+			if (libinput_tablet_pad_mode_group_has_button(group,
+								      i))
+				pad->modes.button_group[i] = group;
+		}
+		for (i = 0; i < ARRAY_LENGTH(pad->modes.ring_group); i++) {
+			if (libinput_tablet_pad_mode_group_has_ring(group, i))
+				pad->modes.ring_group[i] = group;
+		}
+		for (i = 0; i < ARRAY_LENGTH(pad->modes.strip_group); i++) {
+			if (libinput_tablet_pad_mode_group_has_strip(group, i))
+				pad->modes.strip_group[i] = group;
+		}
 	}
+}
 
-	assert(!"Unable to find ring mode group");
+static inline struct libinput_tablet_pad_mode_group *
+pad_ring_get_mode_group(struct pad_dispatch *pad,
+			unsigned int ring)
+{
+	struct libinput_tablet_pad_mode_group *group = NULL;
+
+	if (ring < ARRAY_LENGTH(pad->modes.ring_group))
+		group = pad->modes.ring_group[ring];
 
-	return NULL;
+	assert(group && "Unable to find ring mode group");
+
+	return group;
 }
 
 static inline struct libinput_tablet_pad_mode_group *
 pad_strip_get_mode_group(struct pad_dispatch *pad,
 			unsigned int strip)
 {
-	struct libinput_tablet_pad_mode_group *group;
+	struct libinput_tablet_pad_mode_group *group = NULL;
 
-	list_for_each(group, &pad->modes.mode_group_list, link) {
-		if (libinput_tablet_pad_mode_group_has_strip(group, strip))
-			return group;
-	}
+	if (strip < ARRAY_LENGTH(pad->modes.strip_group))
+		group = pad->modes.strip_group[strip];
 
-	assert(!"Unable to find strip mode group");
+	assert(group && "Unable to find strip mode group");
 
-	return NULL;
+	return group;
 }
 
 static void
@@ -343,16 +369,14 @@ static inline struct libinput_tablet_pad_mode_group *
 pad_button_get_mode_group(struct pad_dispatch *pad,
 			  unsigned int button)
 {
-	struct libinput_tablet_pad_mode_group *group;
+	struct libinput_tablet_pad_mode_group *group = NULL;
 
-	list_for_each(group, &pad->modes.mode_group_list, link) {
-		if (libinput_tablet_pad_mode_group_has_button(group, button))
-			return group;
-	}
+	if (button < ARRAY_LENGTH(pad->modes.button_group))
+		group = pad->modes.button_group[button];
 
-	assert(!"Unable to find button mode group\n");
+	assert(group && "Unable to find button mode group");
 
-	return NULL;
+	return group;
 }
 
 static void
@@ -679,6 +703,8 @@ pad_init(struct pad_dispatch *pad, struct evdev_device *device)
 	if (pad_init_leds(pad, device) != 0)
 		return 1;
 
+	pad_rebuild_mode_routing(pad);
+
 	return 0;
 }
 
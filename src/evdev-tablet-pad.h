@@ -80,6 +80,13 @@ struct pad_dispatch {
 
 	struct {
 		struct list mode_group_list;
+		/* Routing tables precomputed from the group list by
+		   pad_rebuild_mode_routing() so the per-event group
+		   lookup is a plain array index. Sizes match the
+		   mode group's button/ring/strip masks */
+		struct libinput_tablet_pad_mode_group *button_group[32];
+		struct libinput_tablet_pad_mode_group *ring_group[2];
+		struct libinput_tablet_pad_mode_group *strip_group[2];
 	} modes;
 };
 
@@ -96,6 +96,10 @@ static inline void
 tablet_history_reset(struct tablet_dispatch *tablet)
 {
 	tablet->history.count = 0;
+	tablet->history.point_sum.x = 0;
+	tablet->history.point_sum.y = 0;
+	tablet->history.tilt_sum.x = 0;
+	tablet->history.tilt_sum.y = 0;
 }
 
 static inline void
@@ -105,6 +109,23 @@ tablet_history_push(struct tablet_dispatch *tablet,
 	unsigned int index = (tablet->history.index + 1) %
 				tablet_history_size(tablet);
 
+	/* Once the ring is full the new sample evicts the oldest one,
+	 * swap it out of the running sums */
+	if (tablet->history.count == tablet_history_size(tablet)) {
+		const struct tablet_axes *evicted =
+				&tablet->history.samples[index];
+
+		tablet->history.point_sum.x -= evicted->point.x;
+		tablet->history.point_sum.y -= evicted->point.y;
+		tablet->history.tilt_sum.x -= evicted->tilt.x;
+		tablet->history.tilt_sum.y -= evicted->tilt.y;
+	}
+
+	tablet->history.point_sum.x += axes->point.x;
+	tablet->history.point_sum.y += axes->point.y;
+	tablet->history.tilt_sum.x += axes->tilt.x;
+	tablet->history.tilt_sum.y += axes->tilt.y;
+
 	tablet->history.samples[index] = *axes;
 	tablet->history.index = index;
 	tablet->history.count = min(tablet->history.count + 1,
@@ -114,28 +135,26 @@ tablet_history_push(struct tablet_dispatch *tablet,
 		tablet_history_push(tablet, axes);
 }
 
-/**
- * Return a previous axis state, where index of 0 means "most recent", 1 is
- * "one before most recent", etc.
- */
-static inline const struct tablet_axes*
-tablet_history_get(const struct tablet_dispatch *tablet, unsigned int index)
-{
-	size_t sz = tablet_history_size(tablet);
-
-	assert(index < sz);
-	assert(index < tablet->history.count);
-
-	index = (tablet->history.index + sz - index) % sz;
-	return &tablet->history.samples[index];
-}
-
 static inline void
 tablet_reset_changed_axes(struct tablet_dispatch *tablet)
 {
 	memset(tablet->changed_axes, 0, sizeof(tablet->changed_axes));
 }
 
+static inline uint32_t
+tablet_changed_axes_mask(const struct tablet_dispatch *tablet)
+{
+	uint32_t mask = 0;
+
+	static_assert(LIBINPUT_TABLET_TOOL_AXIS_MAX < 32,
+		      "axis mask must fit into 32 bits");
+
+	for (size_t i = 0; i < sizeof(tablet->changed_axes); i++)
+		mask |= (uint32_t)tablet->changed_axes[i] << (i * 8);
+
+	return mask;
+}
+
 static bool
 tablet_device_has_axis(struct tablet_dispatch *tablet,
 		       enum libinput_tablet_tool_axis axis)
@@ -672,25 +691,15 @@ static void
 tablet_smoothen_axes(const struct tablet_dispatch *tablet,
 		     struct tablet_axes *axes)
 {
-	size_t i;
 	size_t count = tablet_history_size(tablet);
-	struct tablet_axes smooth = { 0 };
 
-	for (i = 0; i < count; i++) {
-		const struct tablet_axes *a = tablet_history_get(tablet, i);
+	/* tablet_history_push() pre-fills the ring with the first
+	 * sample, so the sums always cover a full window */
+	axes->point.x = tablet->history.point_sum.x/(int64_t)count;
+	axes->point.y = tablet->history.point_sum.y/(int64_t)count;
 
-		smooth.point.x += a->point.x;
-		smooth.point.y += a->point.y;
-
-		smooth.tilt.x += a->tilt.x;
-		smooth.tilt.y += a->tilt.y;
-	}
-
-	axes->point.x = smooth.point.x/count;
-	axes->point.y = smooth.point.y/count;
-
-	axes->tilt.x = smooth.tilt.x/count;
-	axes->tilt.y = smooth.tilt.y/count;
+	axes->tilt.x = tablet->history.tilt_sum.x/count;
+	axes->tilt.y = tablet->history.tilt_sum.y/count;
 }
 
 static bool
@@ -701,32 +710,38 @@ tablet_check_notify_axes(struct tablet_dispatch *tablet,
 			 uint64_t time)
 {
 	struct tablet_axes axes = {0};
-	const char tmp[sizeof(tablet->changed_axes)] = {0};
+	uint32_t changed = tablet_changed_axes_mask(tablet);
 	bool rc = false;
 
-	if (memcmp(tmp, tablet->changed_axes, sizeof(tmp)) == 0) {
+	if (changed == 0) {
 		axes = tablet->axes;
 		goto out;
 	}
 
-	tablet_update_xy(tablet, device);
-	tablet_update_pressure(tablet, device, tool);
-	tablet_update_distance(tablet, device);
-	tablet_update_slider(tablet, device);
-	tablet_update_tilt(tablet, device);
+	/* Only refresh the axes that actually moved this frame, the
+	 * usual pen frame is x/y/pressure out of a dozen axes. Unchanged
+	 * values are carried over from the previous snapshot below. */
+	if (changed & (bit(LIBINPUT_TABLET_TOOL_AXIS_X) |
+		       bit(LIBINPUT_TABLET_TOOL_AXIS_Y)))
+		tablet_update_xy(tablet, device);
+	if (changed & bit(LIBINPUT_TABLET_TOOL_AXIS_PRESSURE))
+		tablet_update_pressure(tablet, device, tool);
+	if (changed & bit(LIBINPUT_TABLET_TOOL_AXIS_DISTANCE))
+		tablet_update_distance(tablet, device);
+	if (changed & bit(LIBINPUT_TABLET_TOOL_AXIS_SLIDER))
+		tablet_update_slider(tablet, device);
+	if (changed & (bit(LIBINPUT_TABLET_TOOL_AXIS_TILT_X) |
+		       bit(LIBINPUT_TABLET_TOOL_AXIS_TILT_Y)))
+		tablet_update_tilt(tablet, device);
+	/* resets the wheel state on frames without wheel movement, must
+	 * always run */
 	tablet_update_wheel(tablet, device);
 	/* We must check ROTATION_Z after TILT_X/Y so that the tilt axes are
-	 * already normalized and set if we have the mouse/lens tool */
+	 * already normalized and set if we have the mouse/lens tool; also
+	 * zeroes the tilt axes for those tools, must always run */
 	tablet_update_rotation(tablet, device);
 
-	axes.point = tablet->axes.point;
-	axes.pressure = tablet->axes.pressure;
-	axes.distance = tablet->axes.distance;
-	axes.slider = tablet->axes.slider;
-	axes.tilt = tablet->axes.tilt;
-	axes.wheel = tablet->axes.wheel;
-	axes.wheel_discrete = tablet->axes.wheel_discrete;
-	axes.rotation = tablet->axes.rotation;
+	axes = tablet->axes;
 
 	rc = true;
 
@@ -1124,9 +1139,11 @@ tablet_get_tool(struct tablet_dispatch *tablet,
 	struct list *tool_list;
 
 	if (serial) {
-		tool_list = &libinput->tool_list;
+		struct list *bucket =
+			libinput_tool_hash_bucket(libinput, type, serial);
+
 		/* Check if we already have the tool in our list of tools */
-		list_for_each(t, tool_list, link) {
+		list_for_each(t, bucket, hash_link) {
 			if (type == t->type && serial == t->serial) {
 				tool = t;
 				break;
@@ -1163,9 +1180,10 @@ tablet_get_tool(struct tablet_dispatch *tablet,
 	/* If we didn't already have the new_tool in our list of tools,
 	 * add it */
 	if (!tool) {
-		tool = zalloc(sizeof *tool);
+		tool = libinput_tool_alloc(libinput);
 
 		*tool = (struct libinput_tablet_tool) {
+			.libinput = libinput,
 			.type = type,
 			.serial = serial,
 			.tool_id = tool_id,
@@ -1176,6 +1194,12 @@ tablet_get_tool(struct tablet_dispatch *tablet,
 		tool_set_bits(tablet, tool);
 
 		list_insert(tool_list, &tool->link);
+		list_init(&tool->hash_link);
+		if (tool_list == &libinput->tool_list)
+			list_insert(libinput_tool_hash_bucket(libinput,
+							      type,
+							      serial),
+				    &tool->hash_link);
 	}
 
 	return tool;
@@ -1476,13 +1500,10 @@ tablet_update_proximity_state(struct tablet_dispatch *tablet,
 }
 
 static struct phys_rect
-tablet_calculate_arbitration_rect(struct tablet_dispatch *tablet)
+tablet_calculate_arbitration_rect(struct tablet_dispatch *tablet,
+				  struct phys_coords mm)
 {
-	struct evdev_device *device = tablet->device;
 	struct phys_rect r = {0};
-	struct phys_coords mm;
-
-	mm = evdev_device_units_to_mm(device, &tablet->axes.point);
 
 	/* The rect we disable is 20mm left of the tip, 50mm north of the
 	 * tip, and 200x200mm large.
@@ -1523,12 +1544,19 @@ tablet_update_touch_device_rect(struct tablet_dispatch *tablet,
 {
 	struct evdev_dispatch *dispatch;
 	struct phys_rect rect = {0};
+	struct phys_coords mm;
 
 	if (tablet->touch_device == NULL ||
 	    tablet->arbitration != ARBITRATION_IGNORE_RECT)
 		return;
 
-	rect = tablet_calculate_arbitration_rect(tablet);
+	/* The rect has generous margins, don't bother the touch device
+	 * until the tool has moved far enough for them to shrink */
+	mm = evdev_device_units_to_mm(tablet->device, &tablet->axes.point);
+	if (!tool_exclusion_region_update(&tablet->exclusion, mm))
+		return;
+
+	rect = tablet_calculate_arbitration_rect(tablet, mm);
 
 	dispatch = tablet->touch_device->dispatch;
 	if (dispatch->interface->touch_arbitration_update_rect)
@@ -1950,6 +1978,7 @@ tablet_toggle_touch_device(struct tablet_dispatch *tablet,
 	enum evdev_arbitration_state which;
 	struct phys_rect r = {0};
 	struct phys_rect *rect = NULL;
+	struct phys_coords mm;
 
 	if (tablet_has_status(tablet,
 			      TABLET_TOOL_OUT_OF_RANGE) ||
@@ -1959,12 +1988,17 @@ tablet_toggle_touch_device(struct tablet_dispatch *tablet,
 	    tablet_has_status(tablet,
 			      TABLET_TOOL_OUT_OF_PROXIMITY)) {
 		which = ARBITRATION_NOT_ACTIVE;
+		tool_exclusion_region_reset(&tablet->exclusion);
 	} else if (tablet->axes.tilt.x == 0) {
 		which = ARBITRATION_IGNORE_ALL;
+		tool_exclusion_region_reset(&tablet->exclusion);
 	} else if (tablet->arbitration != ARBITRATION_IGNORE_RECT) {
 		/* This enables rect-based arbitration, updates are sent
 		 * elsewhere */
-		r = tablet_calculate_arbitration_rect(tablet);
+		mm = evdev_device_units_to_mm(tablet->device,
+					      &tablet->axes.point);
+		tool_exclusion_region_update(&tablet->exclusion, mm);
+		r = tablet_calculate_arbitration_rect(tablet, mm);
 		rect = &r;
 		which = ARBITRATION_IGNORE_RECT;
 	} else {
@@ -2394,10 +2428,11 @@ static void
 tablet_init_smoothing(struct evdev_device *device,
 		      struct tablet_dispatch *tablet)
 {
-	size_t history_size = ARRAY_LENGTH(tablet->history.samples);
+	size_t history_size = TABLET_HISTORY_DEFAULT;
 	struct quirks_context *quirks = NULL;
 	struct quirks *q = NULL;
 	bool use_smoothing = true;
+	uint32_t depth;
 
 	quirks = evdev_libinput_context(device)->quirks;
 	q = quirks_fetch_for_device(quirks, device->udev_device);
@@ -2409,8 +2444,20 @@ tablet_init_smoothing(struct evdev_device *device,
 		use_smoothing = !tablet_is_aes(device, tablet);
 
 	/* Setting the history size to 1 means we never do any actual smoothing. */
-	if (!use_smoothing)
+	if (!use_smoothing) {
 		history_size = 1;
+	} else if (q && quirks_get_uint32(q,
+					  QUIRK_ATTR_TABLET_SMOOTHING_SIZE,
+					  &depth)) {
+		if (depth >= 1 &&
+		    depth <= ARRAY_LENGTH(tablet->history.samples))
+			history_size = depth;
+		else
+			evdev_log_info(device,
+				       "Invalid smoothing size %u, using %zd\n",
+				       depth,
+				       history_size);
+	}
 
 	quirks_unref(q);
 	tablet->history.size = history_size;
@@ -31,7 +31,10 @@
 #define LIBINPUT_TOOL_NONE 0
 #define LIBINPUT_TABLET_TOOL_TYPE_MAX LIBINPUT_TABLET_TOOL_TYPE_LENS
 
-#define TABLET_HISTORY_LENGTH 4
+/* The default smoothing window; AttrTabletSmoothingSize can raise it up
+ * to TABLET_HISTORY_LENGTH */
+#define TABLET_HISTORY_DEFAULT 4
+#define TABLET_HISTORY_LENGTH 16
 
 enum tablet_status {
 	TABLET_NONE			= 0,
@@ -65,6 +68,12 @@ struct tablet_dispatch {
 		unsigned int count;
 		struct tablet_axes samples[TABLET_HISTORY_LENGTH];
 		size_t size;
+		/* running sums over the window so smoothing stays O(1)
+		 * regardless of the depth */
+		struct {
+			int64_t x, y;
+		} point_sum;
+		struct tilt_degrees tilt_sum;
 	} history;
 
 	unsigned char axis_caps[NCHARS(LIBINPUT_TABLET_TOOL_AXIS_MAX + 1)];
@@ -93,6 +102,7 @@ struct tablet_dispatch {
 	/* The paired touch device on devices with both pen & touch */
 	struct evdev_device *touch_device;
 	enum evdev_arbitration_state arbitration;
+	struct tool_exclusion_region exclusion;
 
 	struct {
 		/* The device locked for rotation */
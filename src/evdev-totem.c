@@ -39,6 +39,15 @@ struct totem_slot {
 	struct tablet_axes axes;
 	unsigned char changed_axes[NCHARS(LIBINPUT_TABLET_TOOL_AXIS_MAX + 1)];
 
+	/* raw axis values mirrored from the event stream so that
+	 * totem_slot_fetch_axes() doesn't round-trip through libevdev */
+	struct {
+		struct device_coords point;
+		int orientation;
+		int major;
+		int minor;
+	} raw;
+
 	struct device_coords last_point;
 };
 
@@ -57,6 +66,14 @@ struct totem_dispatch {
 	bool button_state_previous;
 
 	enum evdev_arbitration_state arbitration_state;
+	struct tool_exclusion_region exclusion;
+
+	/* axis resolutions are constant, cache them at init so the
+	 * per-frame axis updates don't round-trip through libevdev */
+	struct {
+		unsigned int major;
+		unsigned int minor;
+	} size_resolution;
 };
 
 static inline struct totem_dispatch*
@@ -113,6 +130,7 @@ totem_set_touch_device_enabled(struct totem_dispatch *totem,
 	struct evdev_device *touch_device = totem->touch_device;
 	struct evdev_dispatch *dispatch;
 	struct phys_rect r, *rect = NULL;
+	struct phys_coords mm = {0};
 	enum evdev_arbitration_state state = ARBITRATION_NOT_ACTIVE;
 
 	if (touch_device == NULL)
@@ -123,7 +141,6 @@ totem_set_touch_device_enabled(struct totem_dispatch *totem,
 	 * device, so let's not go too hard on ourselves*/
 	for (size_t i = 0; !enable_touch_device && i < totem->nslots; i++) {
 		struct totem_slot *slot = &totem->slots[i];
-		struct phys_coords mm;
 
 		if (slot->state == SLOT_STATE_NONE)
 			continue;
@@ -145,6 +162,7 @@ totem_set_touch_device_enabled(struct totem_dispatch *totem,
 	dispatch = touch_device->dispatch;
 
 	if (enable_touch_device) {
+	    tool_exclusion_region_reset(&totem->exclusion);
 	    if (dispatch->interface->touch_arbitration_toggle)
 		dispatch->interface->touch_arbitration_toggle(dispatch,
 							      touch_device,
@@ -156,6 +174,9 @@ totem_set_touch_device_enabled(struct totem_dispatch *totem,
 		case ARBITRATION_IGNORE_ALL:
 			abort();
 		case ARBITRATION_NOT_ACTIVE:
+			if (rect)
+				tool_exclusion_region_update(&totem->exclusion,
+							     mm);
 			if (dispatch->interface->touch_arbitration_toggle)
 				dispatch->interface->touch_arbitration_toggle(dispatch,
 									      touch_device,
@@ -164,6 +185,13 @@ totem_set_touch_device_enabled(struct totem_dispatch *totem,
 									      time);
 			break;
 		case ARBITRATION_IGNORE_RECT:
+			/* The rect has 30mm of margin around the totem,
+			 * skip the update until it has moved far enough
+			 * for the stale rect to matter */
+			if (rect &&
+			    !tool_exclusion_region_update(&totem->exclusion,
+							  mm))
+				break;
 			if (dispatch->interface->touch_arbitration_update_rect)
 				dispatch->interface->touch_arbitration_update_rect(dispatch,
 										   touch_device,
@@ -225,20 +253,25 @@ totem_process_abs(struct totem_dispatch *totem,
 			slot->state = SLOT_STATE_END;
 		break;
 	case ABS_MT_POSITION_X:
+		slot->raw.point.x = e->value;
 		set_bit(slot->changed_axes, LIBINPUT_TABLET_TOOL_AXIS_X);
 		break;
 	case ABS_MT_POSITION_Y:
+		slot->raw.point.y = e->value;
 		set_bit(slot->changed_axes, LIBINPUT_TABLET_TOOL_AXIS_Y);
 		break;
 	case ABS_MT_TOUCH_MAJOR:
+		slot->raw.major = e->value;
 		set_bit(slot->changed_axes,
 			LIBINPUT_TABLET_TOOL_AXIS_SIZE_MAJOR);
 		break;
 	case ABS_MT_TOUCH_MINOR:
+		slot->raw.minor = e->value;
 		set_bit(slot->changed_axes,
 			LIBINPUT_TABLET_TOOL_AXIS_SIZE_MINOR);
 		break;
 	case ABS_MT_ORIENTATION:
+		slot->raw.orientation = e->value;
 		set_bit(slot->changed_axes,
 			LIBINPUT_TABLET_TOOL_AXIS_ROTATION_Z);
 		break;
@@ -277,40 +310,23 @@ totem_slot_fetch_axes(struct totem_dispatch *totem,
 
 	if (bit_is_set(slot->changed_axes, LIBINPUT_TABLET_TOOL_AXIS_X) ||
 	    bit_is_set(slot->changed_axes, LIBINPUT_TABLET_TOOL_AXIS_Y)) {
-		slot->axes.point.x = libevdev_get_slot_value(device->evdev,
-							     slot->index,
-							     ABS_MT_POSITION_X);
-		slot->axes.point.y = libevdev_get_slot_value(device->evdev,
-							     slot->index,
-							     ABS_MT_POSITION_Y);
+		slot->axes.point = slot->raw.point;
 	}
 
 	if (bit_is_set(slot->changed_axes,
 		       LIBINPUT_TABLET_TOOL_AXIS_ROTATION_Z)) {
-		int angle = libevdev_get_slot_value(device->evdev,
-						    slot->index,
-						    ABS_MT_ORIENTATION);
 		/* The kernel gives us ±90 degrees off neutral */
-		slot->axes.rotation = (360 - angle) % 360;
+		slot->axes.rotation = (360 - slot->raw.orientation) % 360;
 	}
 
 	if (bit_is_set(slot->changed_axes,
 		       LIBINPUT_TABLET_TOOL_AXIS_SIZE_MAJOR) ||
 	    bit_is_set(slot->changed_axes,
 		       LIBINPUT_TABLET_TOOL_AXIS_SIZE_MINOR)) {
-		int major, minor;
-		unsigned int rmajor, rminor;
-
-		major = libevdev_get_slot_value(device->evdev,
-						slot->index,
-						ABS_MT_TOUCH_MAJOR);
-		minor = libevdev_get_slot_value(device->evdev,
-						slot->index,
-						ABS_MT_TOUCH_MINOR);
-		rmajor = libevdev_get_abs_resolution(device->evdev, ABS_MT_TOUCH_MAJOR);
-		rminor = libevdev_get_abs_resolution(device->evdev, ABS_MT_TOUCH_MINOR);
-		slot->axes.size.major = (double)major/rmajor;
-		slot->axes.size.minor = (double)minor/rminor;
+		slot->axes.size.major =
+			(double)slot->raw.major/totem->size_resolution.major;
+		slot->axes.size.minor =
+			(double)slot->raw.minor/totem->size_resolution.minor;
 	}
 
 	axes.point = slot->axes.point;
@@ -355,14 +371,24 @@ slot_axes_initialize(struct totem_dispatch *totem,
 {
 	struct evdev_device *device = totem->device;
 
-	slot->axes.point.x = libevdev_get_slot_value(device->evdev,
-						     slot->index,
-						     ABS_MT_POSITION_X);
-	slot->axes.point.y = libevdev_get_slot_value(device->evdev,
-						     slot->index,
-						     ABS_MT_POSITION_Y);
-	slot->last_point.x = slot->axes.point.x;
-	slot->last_point.y = slot->axes.point.y;
+	slot->raw.point.x = libevdev_get_slot_value(device->evdev,
+						    slot->index,
+						    ABS_MT_POSITION_X);
+	slot->raw.point.y = libevdev_get_slot_value(device->evdev,
+						    slot->index,
+						    ABS_MT_POSITION_Y);
+	slot->raw.orientation = libevdev_get_slot_value(device->evdev,
+							slot->index,
+							ABS_MT_ORIENTATION);
+	slot->raw.major = libevdev_get_slot_value(device->evdev,
+						  slot->index,
+						  ABS_MT_TOUCH_MAJOR);
+	slot->raw.minor = libevdev_get_slot_value(device->evdev,
+						  slot->index,
+						  ABS_MT_TOUCH_MINOR);
+
+	slot->axes.point = slot->raw.point;
+	slot->last_point = slot->raw.point;
 }
 
 static enum totem_slot_state
@@ -825,6 +851,11 @@ evdev_totem_create(struct evdev_device *device)
 	totem->slots = slots;
 	totem->nslots = num_slots;
 
+	totem->size_resolution.major =
+		libevdev_get_abs_resolution(device->evdev, ABS_MT_TOUCH_MAJOR);
+	totem->size_resolution.minor =
+		libevdev_get_abs_resolution(device->evdev, ABS_MT_TOUCH_MINOR);
+
 	evdev_init_sendevents(device, &totem->base);
 	totem_init_accel(totem, device);
 
@@ -248,7 +248,7 @@ wheel_flush_scroll(struct fallback_dispatch *dispatch,
 		int value = dispatch->wheel.hi_res.y;
 
 		v120.y = -1 * value;
-		wheel_degrees.y = -1 * value/120.0 * device->scroll.wheel_click_angle.y;
+		wheel_degrees.y = -1 * value * device->scroll.wheel_degrees_per_v120.y;
 		evdev_notify_axis_wheel(
 			device,
 			time,
@@ -276,7 +276,7 @@ wheel_flush_scroll(struct fallback_dispatch *dispatch,
 		int value = dispatch->wheel.hi_res.x;
 
 		v120.x = value;
-		wheel_degrees.x = value/120.0 * device->scroll.wheel_click_angle.x;
+		wheel_degrees.x = value * device->scroll.wheel_degrees_per_v120.x;
 		evdev_notify_axis_wheel(
 			device,
 			time,
@@ -339,7 +339,25 @@ wheel_handle_state_scrolling(struct fallback_dispatch *dispatch,
 			     struct evdev_device *device,
 			     uint64_t time)
 {
-	wheel_flush_scroll(dispatch, device, time);
+	if (dispatch->wheel.coalesce_window == 0) {
+		wheel_flush_scroll(dispatch, device, time);
+		return;
+	}
+
+	/* Coalescing: the first frame after an idle period flushes
+	 * immediately so slow scrolling keeps its latency; during a
+	 * burst (free-spinning ratchet wheels) the deltas accumulate
+	 * and the timer posts one aggregated event per window. */
+	if (time - dispatch->wheel.last_flush_time >=
+	    dispatch->wheel.coalesce_window) {
+		wheel_flush_scroll(dispatch, device, time);
+		dispatch->wheel.last_flush_time = time;
+	} else if (!dispatch->wheel.coalesce_pending) {
+		libinput_timer_set(&dispatch->wheel.coalesce_timer,
+				   dispatch->wheel.last_flush_time +
+					dispatch->wheel.coalesce_window);
+		dispatch->wheel.coalesce_pending = true;
+	}
 }
 
 static void
@@ -473,11 +491,27 @@ wheel_init_scroll_timer(uint64_t now, void *data)
 	wheel_handle_event(dispatch, WHEEL_EVENT_SCROLL_TIMEOUT, now);
 }
 
+static void
+wheel_coalesce_timer_func(uint64_t now, void *data)
+{
+	struct evdev_device *device = data;
+	struct fallback_dispatch *dispatch =
+		fallback_dispatch(device->dispatch);
+
+	dispatch->wheel.coalesce_pending = false;
+	/* No-op if the deltas were consumed meanwhile, e.g. by a wheel
+	 * press zeroing them */
+	wheel_flush_scroll(dispatch, device, now);
+	dispatch->wheel.last_flush_time = now;
+}
+
 void
 fallback_init_wheel(struct fallback_dispatch *dispatch,
 		    struct evdev_device *device)
 {
 	char timer_name[64];
+	const char *window;
+	int window_ms;
 
 	dispatch->wheel.state = WHEEL_STATE_NONE;
 	dispatch->wheel.dir = WHEEL_DIR_UNKNOW;
@@ -507,4 +541,19 @@ fallback_init_wheel(struct fallback_dispatch *dispatch,
 			    timer_name,
 			    wheel_init_scroll_timer,
 			    device);
+
+	window = getenv("LIBINPUT_WHEEL_COALESCE_MS");
+	if (window && safe_atoi(window, &window_ms) &&
+	    window_ms > 0 && window_ms <= 100)
+		dispatch->wheel.coalesce_window = ms2us(window_ms);
+
+	snprintf(timer_name,
+		 sizeof(timer_name),
+		 "%s wheel coalesce",
+		 evdev_device_get_sysname(device));
+	libinput_timer_init(&dispatch->wheel.coalesce_timer,
+			    evdev_libinput_context(device),
+			    timer_name,
+			    wheel_coalesce_timer_func,
+			    device);
 }
@@ -27,6 +27,8 @@
 #include "config.h"
 
 #include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -40,8 +42,11 @@
 
 #include "libinput.h"
 #include "evdev.h"
+#include "event-export.h"
 #include "filter.h"
+#include "filter-private.h"
 #include "libinput-private.h"
+#include "libinput-trace.h"
 #include "quirks.h"
 #include "util-input-event.h"
 
@@ -89,7 +94,7 @@ static const struct evdev_udev_tag_match evdev_udev_tag_matches[] = {
 };
 
 static inline bool
-parse_udev_flag(struct evdev_device *device,
+parse_udev_flag(struct libinput *libinput,
 		struct udev_device *udev_device,
 		const char *property)
 {
@@ -101,10 +106,11 @@ parse_udev_flag(struct evdev_device *device,
 		return false;
 
 	if (!parse_boolean_property(val, &b)) {
-		evdev_log_error(device,
-				"property %s has invalid value '%s'\n",
-				property,
-				val);
+		log_error(libinput,
+			  "%s: property %s has invalid value '%s'\n",
+			  udev_device_get_sysname(udev_device),
+			  property,
+			  val);
 		return false;
 	}
 
@@ -117,15 +123,27 @@ evdev_update_key_down_count(struct evdev_device *device,
 			    int pressed)
 {
 	int key_count;
+	int slot;
 	assert(code >= 0 && code < KEY_CNT);
 
+	slot = evdev_device_key_slot(device, code);
+	if (slot < 0) {
+		evdev_log_bug_libinput(device,
+				       "key %s missing from the key map\n",
+				       libevdev_event_code_get_name(EV_KEY,
+								    code));
+		return 0;
+	}
+
 	if (pressed) {
-		key_count = ++device->key_count[code];
+		key_count = ++device->key_count[slot];
 	} else {
-		assert(device->key_count[code] > 0);
-		key_count = --device->key_count[code];
+		assert(device->key_count[slot] > 0);
+		key_count = --device->key_count[slot];
 	}
 
+	long_set_bit_state(device->key_down_mask, code, key_count > 0);
+
 	if (key_count > 32) {
 		evdev_log_bug_libinput(device,
 				       "key count for %s reached abnormal values\n",
@@ -152,10 +170,11 @@ evdev_pointer_notify_physical_button(struct evdev_device *device,
 				     int button,
 				     enum libinput_button_state state)
 {
-	if (evdev_middlebutton_filter_button(device,
-					     time,
-					     button,
-					     state))
+	if (device->middlebutton.filter &&
+	    device->middlebutton.filter(device,
+					time,
+					button,
+					state))
 			return;
 
 	evdev_pointer_notify_button(device,
@@ -343,23 +362,32 @@ void
 evdev_transform_absolute(struct evdev_device *device,
 			 struct device_coords *point)
 {
-	if (!device->abs.apply_calibration)
-		return;
-
-	matrix_mult_vec(&device->abs.calibration, &point->x, &point->y);
+	/* Classified at set time in evdev_device_calibrate(); the
+	 * overwhelmingly common identity case costs just the switch and
+	 * no path touches float per event */
+	switch (device->abs.calibration_kind) {
+	case EVDEV_CALIBRATION_IDENTITY:
+		break;
+	case EVDEV_CALIBRATION_TRANSLATE:
+		point->x += device->abs.calibration_translate.x;
+		point->y += device->abs.calibration_translate.y;
+		break;
+	case EVDEV_CALIBRATION_AFFINE:
+		matrix_fixed_mult_vec(&device->abs.calibration_fixed,
+				      &point->x,
+				      &point->y);
+		break;
+	}
 }
 
 void
 evdev_transform_relative(struct evdev_device *device,
 			 struct device_coords *point)
 {
-	struct matrix rel_matrix;
-
 	if (!device->abs.apply_calibration)
 		return;
 
-	matrix_to_relative(&rel_matrix, &device->abs.calibration);
-	matrix_mult_vec(&rel_matrix, &point->x, &point->y);
+	matrix_mult_vec(&device->abs.calibration_rel, &point->x, &point->y);
 }
 
 static inline double
@@ -385,6 +413,25 @@ evdev_device_transform_y(struct evdev_device *device,
 	return scale_axis(device->abs.absinfo_y, y, height);
 }
 
+void
+evdev_export_position(struct evdev_device *device,
+		      uint64_t time,
+		      const struct device_coords *point)
+{
+	struct libinput *libinput = evdev_libinput_context(device);
+
+	if (!libinput->position_page)
+		return;
+
+	libinput_position_export_post(libinput->position_page,
+				      &device->base,
+				      time,
+				      scale_axis(device->abs.absinfo_x,
+						 point->x, 1.0),
+				      scale_axis(device->abs.absinfo_y,
+						 point->y, 1.0));
+}
+
 void
 evdev_notify_axis_legacy_wheel(struct evdev_device *device,
 			       uint64_t time,
@@ -436,6 +483,11 @@ evdev_notify_axis_wheel(struct evdev_device *device,
 		v120.y *= -1;
 	}
 
+	/* the legacy wheel companion covers the same motion, only
+	 * accumulate it once */
+	device->scroll.sampled.x += delta.x;
+	device->scroll.sampled.y += delta.y;
+
 	pointer_notify_axis_wheel(&device->base,
 				  time,
 				  axes,
@@ -456,6 +508,9 @@ evdev_notify_axis_finger(struct evdev_device *device,
 		delta.y *= -1;
 	}
 
+	device->scroll.sampled.x += delta.x;
+	device->scroll.sampled.y += delta.y;
+
 	pointer_notify_axis_finger(&device->base,
 				  time,
 				  axes,
@@ -475,6 +530,9 @@ evdev_notify_axis_continous(struct evdev_device *device,
 		delta.y *= -1;
 	}
 
+	device->scroll.sampled.x += delta.x;
+	device->scroll.sampled.y += delta.y;
+
 	pointer_notify_axis_continuous(&device->base,
 				       time,
 				       axes,
@@ -502,7 +560,9 @@ evdev_tag_trackpoint(struct evdev_device *device,
 
 	if (!libevdev_has_property(device->evdev,
 				  INPUT_PROP_POINTING_STICK) &&
-	    !parse_udev_flag(device, udev_device, "ID_INPUT_POINTINGSTICK"))
+	    !parse_udev_flag(evdev_libinput_context(device),
+			     udev_device,
+			     "ID_INPUT_POINTINGSTICK"))
 		return;
 
 	device->tags |= EVDEV_TAG_TRACKPOINT;
@@ -1044,6 +1104,42 @@ evdev_print_event(struct evdev_device *device,
 	}
 }
 
+/* Devices with hardware timestamps (MSC_TIMESTAMP) tell us when a frame
+ * was sampled rather than when the kernel got around to timestamping it.
+ * The counter is in microseconds but starts at an arbitrary point and
+ * resets after 1s of inactivity, so we anchor it against the kernel
+ * timestamp whenever it (re)starts and re-anchor when the clocks drift
+ * apart.
+ */
+static inline void
+evdev_note_hw_timestamp(struct evdev_device *device,
+			const struct input_event *e,
+			uint64_t time)
+{
+	uint32_t msc = (uint32_t)e->value;
+	uint64_t hw_time;
+
+	if (!device->hw_time.anchored || msc < device->hw_time.anchor_msc) {
+		device->hw_time.anchor = time;
+		device->hw_time.anchor_msc = msc;
+		device->hw_time.anchored = true;
+	}
+
+	hw_time = device->hw_time.anchor + (msc - device->hw_time.anchor_msc);
+
+	/* The device clock drifts against CLOCK_MONOTONIC; re-anchor
+	 * when the hw time runs ahead of the kernel time or lags behind
+	 * by more than any plausible delivery delay */
+	if (hw_time > time + ms2us(10) || hw_time + s2us(1) < time) {
+		device->hw_time.anchor = time;
+		device->hw_time.anchor_msc = msc;
+		hw_time = time;
+	}
+
+	device->hw_time.frame_time = hw_time;
+	device->base.last_hw_time = hw_time;
+}
+
 static inline void
 evdev_process_event(struct evdev_device *device, struct input_event *e)
 {
@@ -1054,16 +1150,17 @@ evdev_process_event(struct evdev_device *device, struct input_event *e)
 	evdev_print_event(device, e);
 #endif
 
-	libinput_timer_flush(evdev_libinput_context(device), time);
+	if (e->type == EV_MSC && e->code == MSC_TIMESTAMP)
+		evdev_note_hw_timestamp(device, e, time);
 
-	dispatch->interface->process(dispatch, device, e, time);
+	device->process(dispatch, device, e, time);
 }
 
 static inline void
-evdev_device_dispatch_one(struct evdev_device *device,
-			  struct input_event *ev)
+evdev_process_one(struct evdev_device *device,
+		  struct input_event *ev)
 {
-	if (!device->mtdev) {
+	if (likely(!device->mtdev)) {
 		evdev_process_event(device, ev);
 	} else {
 		mtdev_put_event(device->mtdev, ev);
@@ -1077,20 +1174,128 @@ evdev_device_dispatch_one(struct evdev_device *device,
 	}
 }
 
+/* Size of the contiguous frame buffer in evdev_device_dispatch(). Frames
+ * larger than this (rare, e.g. a tablet with many axes plus SYN_DROPPED
+ * recovery) are simply split into multiple batches.
+ */
+#define EVDEV_FRAME_NEVENTS 64
+
+/* Maximum number of frames one device may process per dispatch before
+ * yielding to other devices. A 1000Hz device at 60Hz repaints queues
+ * ~17 frames between dispatches, so normal operation never hits this;
+ * only a flooding device gets chunked. */
+#define EVDEV_MAX_FRAMES_PER_DISPATCH 64
+
+static void
+evdev_device_dispatch_frame(struct evdev_device *device,
+			    struct input_event *frame,
+			    size_t nevents)
+{
+	struct libinput *libinput = evdev_libinput_context(device);
+	uint64_t time;
+	size_t i;
+
+	if (nevents == 0)
+		return;
+
+	time = input_event_time(&frame[0]);
+	device->base.last_hw_time = time;
+	/* updated from MSC_TIMESTAMP while the frame is processed */
+	device->hw_time.frame_time = 0;
+	trace_kernel_read(&device->base, time, nevents);
+
+	device->stats.nevents += nevents;
+	device->stats.nframes++;
+	if (device->stats.slot) {
+		struct stats_page_slot *slot = device->stats.slot;
+
+		slot->nevents = device->stats.nevents;
+		slot->nframes = device->stats.nframes;
+		slot->ndropped = device->syn_dropped_count;
+	}
+	if (device->base.crash_shadow_slot >= 0) {
+		struct libinput_crash_shadow_device *shadow =
+			&libinput->crash_shadow.devices[device->base.crash_shadow_slot];
+
+		shadow->nframes = device->stats.nframes;
+		shadow->nevents = device->stats.nevents;
+	}
+
+	{
+		uint64_t delta = time - device->cadence.last_frame_time;
+
+		device->cadence.last_frame_time = time;
+
+		/* deltas spanning a pause are gaps between interactions,
+		 * not report intervals */
+		if (delta > 0 && delta <= ms2us(100)) {
+			uint64_t interval = device->cadence.interval;
+
+			if (interval)
+				interval = (interval * 7 + delta) / 8;
+			else
+				interval = delta;
+			device->cadence.interval = interval;
+
+			/* hand the cadence to the accel filter once it has
+			 * drifted noticeably from what the filter has */
+			if (interval > device->cadence.published +
+				       device->cadence.published / 8 ||
+			    interval + device->cadence.published / 8 <
+				       device->cadence.published) {
+				filter_set_frame_interval(device->pointer.filter,
+							  interval);
+				device->cadence.published = interval;
+			}
+		}
+	}
+
+	/* The kernel already timestamped this frame; use that as the
+	 * cycle's clock so timer checks and event times downstream don't
+	 * need a clock_gettime() of their own */
+	if (libinput->in_dispatch && !libinput->cached_now)
+		libinput->cached_now = time;
+
+	/* One timer flush per frame instead of per event; events within a
+	 * frame carry the same timestamp anyway */
+	libinput_timer_flush(libinput, time);
+
+	trace_dispatch_enter(&device->base, time);
+
+	for (i = 0; i < nevents; i++)
+		evdev_process_one(device, &frame[i]);
+}
+
 static int
 evdev_sync_device(struct evdev_device *device)
 {
-	struct input_event ev;
+	struct input_event frame[EVDEV_FRAME_NEVENTS];
+	size_t nframe = 0;
 	int rc;
 
+	/* libevdev's sync stream is already a state diff: it compares the
+	 * kernel state against its own cached state and emits one event
+	 * per net change, not the dropped backlog. What made recovery
+	 * expensive was dispatching those events one-by-one, each paying
+	 * the full timer flush. Batch them into frames like the normal
+	 * read path instead. */
 	do {
 		rc = libevdev_next_event(device->evdev,
-					 LIBEVDEV_READ_FLAG_SYNC, &ev);
+					 LIBEVDEV_READ_FLAG_SYNC,
+					 &frame[nframe]);
 		if (rc < 0)
 			break;
-		evdev_device_dispatch_one(device, &ev);
+		nframe++;
+		if (nframe == ARRAY_LENGTH(frame) ||
+		    libevdev_event_is_code(&frame[nframe - 1],
+					   EV_SYN, SYN_REPORT)) {
+			evdev_device_dispatch_frame(device, frame, nframe);
+			nframe = 0;
+		}
 	} while (rc == LIBEVDEV_READ_STATUS_SYNC);
 
+	evdev_device_dispatch_frame(device, frame, nframe);
+
 	return rc == -EAGAIN ? 0 : rc;
 }
 
@@ -1099,7 +1304,6 @@ evdev_note_time_delay(struct evdev_device *device,
 		      const struct input_event *ev)
 {
 	struct libinput *libinput = evdev_libinput_context(device);
-	uint32_t tdelta;
 	uint64_t eventtime = input_event_time(ev);
 
 	/* if we have a current libinput_dispatch() snapshot, compare our
@@ -1112,12 +1316,12 @@ evdev_note_time_delay(struct evdev_device *device,
 	    eventtime > libinput->dispatch_time)
 		return;
 
-	tdelta = us2ms(libinput->dispatch_time - eventtime);
-	if (tdelta > 10) {
+	/* compare in µs, only convert when we actually warn */
+	if (libinput->dispatch_time - eventtime > ms2us(10)) {
 		evdev_log_bug_client_ratelimit(device,
 					       &device->delay_warning_limit,
 					       "event processing lagging behind by %dms, your system is too slow\n",
-					       tdelta);
+					       us2ms(libinput->dispatch_time - eventtime));
 	}
 }
 
@@ -1126,17 +1330,26 @@ evdev_device_dispatch(void *data)
 {
 	struct evdev_device *device = data;
 	struct libinput *libinput = evdev_libinput_context(device);
-	struct input_event ev;
+	struct input_event frame[EVDEV_FRAME_NEVENTS];
+	size_t nframe = 0;
+	size_t frames_handled = 0;
 	int rc;
 	bool once = false;
 
 	/* If the compositor is repainting, this function is called only once
 	 * per frame and we have to process all the events available on the
-	 * fd, otherwise there will be input lag. */
+	 * fd, otherwise there will be input lag.
+
+	   Events are collected into a contiguous per-frame buffer and
+	   processed in one batch per SYN_REPORT, so high-rate devices pay
+	   the per-frame overhead (timer flush etc.) once per frame rather
+	   than once per event. */
 	do {
 		rc = libevdev_next_event(device->evdev,
-					 LIBEVDEV_READ_FLAG_NORMAL, &ev);
+					 LIBEVDEV_READ_FLAG_NORMAL,
+					 &frame[nframe]);
 		if (rc == LIBEVDEV_READ_STATUS_SYNC) {
+			device->syn_dropped_count++;
 			evdev_log_info_ratelimit(device,
 						 &device->syn_drop_limit,
 						 "SYN_DROPPED event - some input events have been lost.\n");
@@ -1144,30 +1357,97 @@ evdev_device_dispatch(void *data)
 			/* send one more sync event so we handle all
 			   currently pending events before we sync up
 			   to the current state */
-			ev.code = SYN_REPORT;
-			evdev_device_dispatch_one(device, &ev);
+			frame[nframe].code = SYN_REPORT;
+			nframe++;
+			evdev_device_dispatch_frame(device, frame, nframe);
+			nframe = 0;
 
 			rc = evdev_sync_device(device);
 			if (rc == 0)
 				rc = LIBEVDEV_READ_STATUS_SUCCESS;
 		} else if (rc == LIBEVDEV_READ_STATUS_SUCCESS) {
 			if (!once) {
-				evdev_note_time_delay(device, &ev);
+				evdev_note_time_delay(device, &frame[nframe]);
 				once = true;
 			}
-			evdev_device_dispatch_one(device, &ev);
+			nframe++;
+			if (nframe == ARRAY_LENGTH(frame) ||
+			    libevdev_event_is_code(&frame[nframe - 1],
+						   EV_SYN, SYN_REPORT)) {
+				evdev_device_dispatch_frame(device,
+							    frame, nframe);
+				nframe = 0;
+				if (++frames_handled >=
+				    device->max_frames_per_dispatch)
+					break;
+			}
 		} else if (rc == -ENODEV) {
 			evdev_device_remove(device);
 			return;
 		}
 	} while (rc == LIBEVDEV_READ_STATUS_SUCCESS);
 
+	/* Partial frame (no SYN_REPORT seen yet): process what we have,
+	 * matching the previous one-event-at-a-time behavior */
+	evdev_device_dispatch_frame(device, frame, nframe);
+
+	if (frames_handled >= device->max_frames_per_dispatch) {
+		/* Yield so a flooding device cannot starve the other
+		 * devices (and seats) on this context. The fd stays
+		 * readable for the next epoll_wait(); events already
+		 * buffered inside libevdev need an explicit kick. */
+		if (libevdev_has_event_pending(device->evdev) > 0)
+			libinput_timer_set(&device->dispatch_pending_timer,
+					   libinput_now(libinput) + ms2us(1));
+		return;
+	}
+
 	if (rc != -EAGAIN && rc != -EINTR) {
 		libinput_remove_source(libinput, device->source);
 		device->source = NULL;
 	}
 }
 
+static void
+evdev_dispatch_pending_timer(uint64_t now, void *data)
+{
+	struct evdev_device *device = data;
+
+	if (device->source)
+		evdev_device_dispatch(device);
+}
+
+int
+evdev_device_inject_events(struct evdev_device *device,
+			   const struct input_event *events,
+			   size_t nevents)
+{
+	struct input_event frame[EVDEV_FRAME_NEVENTS];
+	size_t nframe = 0;
+	size_t i;
+
+	if (device->was_removed)
+		return -ENODEV;
+
+	/* Same frame batching as the fd read path: collect until
+	 * SYN_REPORT (or a full buffer) and dispatch per frame */
+	for (i = 0; i < nevents; i++) {
+		frame[nframe++] = events[i];
+		if (nframe == ARRAY_LENGTH(frame) ||
+		    libevdev_event_is_code(&frame[nframe - 1],
+					   EV_SYN, SYN_REPORT)) {
+			evdev_device_dispatch_frame(device, frame, nframe);
+			nframe = 0;
+		}
+	}
+
+	/* Partial trailing frame: process what we have, matching the
+	 * read path */
+	evdev_device_dispatch_frame(device, frame, nframe);
+
+	return 0;
+}
+
 static inline bool
 evdev_init_accel(struct evdev_device *device,
 		 enum libinput_config_accel_profile which)
@@ -1247,16 +1527,35 @@ evdev_accel_config_set_profile(struct libinput_device *libinput_device,
 	struct motion_filter *filter;
 	double speed;
 
+	if (libinput_config_txn_defer_accel_profile(libinput_device, profile))
+		return LIBINPUT_CONFIG_STATUS_SUCCESS;
+
 	filter = device->pointer.filter;
 	if (filter_get_type(filter) == profile)
 		return LIBINPUT_CONFIG_STATUS_SUCCESS;
 
 	speed = filter_get_speed(filter);
+
+	/* Profiles get toggled back and forth (e.g. a settings panel
+	 * preview); swap the previously displaced filter back in with a
+	 * cheap restart instead of rebuilding it and its trackers */
+	if (device->pointer.cached_filter &&
+	    filter_get_type(device->pointer.cached_filter) == profile) {
+		device->pointer.filter = device->pointer.cached_filter;
+		device->pointer.cached_filter = filter;
+		filter_restart(device->pointer.filter,
+			       NULL,
+			       libinput_now(evdev_libinput_context(device)));
+		evdev_accel_config_set_speed(libinput_device, speed);
+		return LIBINPUT_CONFIG_STATUS_SUCCESS;
+	}
+
 	device->pointer.filter = NULL;
 
 	if (evdev_init_accel(device, profile)) {
 		evdev_accel_config_set_speed(libinput_device, speed);
-		filter_destroy(filter);
+		filter_destroy(device->pointer.cached_filter);
+		device->pointer.cached_filter = filter;
 	} else {
 		device->pointer.filter = filter;
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
@@ -1523,7 +1822,7 @@ evdev_read_model_flags(struct evdev_device *device)
 
 	quirks_unref(q);
 
-	if (parse_udev_flag(device,
+	if (parse_udev_flag(evdev_libinput_context(device),
 			    device->udev_device,
 			    "ID_INPUT_TRACKBALL")) {
 		evdev_log_debug(device, "tagged as trackball\n");
@@ -1535,14 +1834,15 @@ evdev_read_model_flags(struct evdev_device *device)
 	 * one of the few udev properties that wasn't reserved for private
 	 * usage, so we need to keep this for backwards compat.
 	 */
-	if (parse_udev_flag(device,
+	if (parse_udev_flag(evdev_libinput_context(device),
 			    device->udev_device,
 			    "LIBINPUT_MODEL_LENOVO_X220_TOUCHPAD_FW81")) {
 		evdev_log_debug(device, "tagged as trackball\n");
 		model_flags |= EVDEV_MODEL_LENOVO_X220_TOUCHPAD_FW81;
 	}
 
-	if (parse_udev_flag(device, device->udev_device,
+	if (parse_udev_flag(evdev_libinput_context(device),
+			    device->udev_device,
 			    "LIBINPUT_TEST_DEVICE")) {
 		evdev_log_debug(device, "is a test device\n");
 		model_flags |= EVDEV_MODEL_TEST_DEVICE;
@@ -1650,7 +1950,7 @@ evdev_fix_abs_resolution(struct evdev_device *device,
 }
 
 static enum evdev_device_udev_tags
-evdev_device_get_udev_tags(struct evdev_device *device,
+evdev_device_get_udev_tags(struct libinput *libinput,
 			   struct udev_device *udev_device)
 {
 	enum evdev_device_udev_tags tags = 0;
@@ -1660,7 +1960,7 @@ evdev_device_get_udev_tags(struct evdev_device *device,
 		unsigned j;
 		for (j = 0; j < ARRAY_LENGTH(evdev_udev_tag_matches); j++) {
 			const struct evdev_udev_tag_match match = evdev_udev_tag_matches[j];
-			if (parse_udev_flag(device,
+			if (parse_udev_flag(libinput,
 					    udev_device,
 					    match.name))
 				tags |= match.tag;
@@ -1671,6 +1971,58 @@ evdev_device_get_udev_tags(struct evdev_device *device,
 	return tags;
 }
 
+/*
+ * Stack snapshot of a device's EV_ABS/EV_REL/EV_SW capability bitmaps.
+ * Each of these event types has fewer than 64 codes, so the full bitmap
+ * fits one word and device classification can run as mask tests against
+ * the signature masks below instead of one libevdev_has_event_code()
+ * call (with its internal range checks) per code of interest.
+ *
+ * Deliberately stack-local, not cached on the device: the configure
+ * fixups and the quirk system enable and disable codes along the way, a
+ * long-lived snapshot would go stale.
+ */
+struct evdev_bits {
+	uint64_t abs;
+	uint64_t rel;
+	uint64_t sw;
+};
+
+static uint64_t
+evdev_snapshot_type_bits(struct libevdev *evdev,
+			 unsigned int type,
+			 unsigned int max)
+{
+	uint64_t bits = 0;
+
+	if (!libevdev_has_event_type(evdev, type))
+		return 0;
+
+	for (unsigned int code = 0; code <= max; code++) {
+		if (libevdev_has_event_code(evdev, type, code))
+			bits |= bit64(code);
+	}
+
+	return bits;
+}
+
+static void
+evdev_snapshot_bits(struct libevdev *evdev, struct evdev_bits *bits)
+{
+	bits->abs = evdev_snapshot_type_bits(evdev, EV_ABS, ABS_MAX);
+	bits->rel = evdev_snapshot_type_bits(evdev, EV_REL, REL_MAX);
+	bits->sw = evdev_snapshot_type_bits(evdev, EV_SW, SW_MAX);
+}
+
+#define EVDEV_MASK_ABS_XY (bit64(ABS_X)|bit64(ABS_Y))
+#define EVDEV_MASK_MT_POS (bit64(ABS_MT_POSITION_X)|bit64(ABS_MT_POSITION_Y))
+#define EVDEV_MASK_REL_XY (bit64(REL_X)|bit64(REL_Y))
+#define EVDEV_MASK_WHEEL (bit64(REL_WHEEL)|bit64(REL_HWHEEL))
+
+/* true if some but not all bits of mask_ are set */
+#define evdev_bits_partial(word_, mask_) \
+	(((word_) & (mask_)) != 0 && ((word_) & (mask_)) != (mask_))
+
 static inline void
 evdev_fix_android_mt(struct evdev_device *device)
 {
@@ -1691,15 +2043,13 @@ evdev_fix_android_mt(struct evdev_device *device)
 		      libevdev_get_abs_info(evdev, ABS_MT_POSITION_Y));
 }
 
+/* The caller has verified the device has this code */
 static inline bool
 evdev_check_min_max(struct evdev_device *device, unsigned int code)
 {
 	struct libevdev *evdev = device->evdev;
 	const struct input_absinfo *absinfo;
 
-	if (!libevdev_has_event_code(evdev, EV_ABS, code))
-		return true;
-
 	absinfo = libevdev_get_abs_info(evdev, code);
 	if (absinfo->minimum == absinfo->maximum) {
 		/* Some devices have a sort-of legitimate min/max of 0 for
@@ -1730,23 +2080,23 @@ static bool
 evdev_reject_device(struct evdev_device *device)
 {
 	struct libevdev *evdev = device->evdev;
+	struct evdev_bits bits;
 	unsigned int code;
 	const struct input_absinfo *absx, *absy;
 
-	if (libevdev_has_event_code(evdev, EV_ABS, ABS_X) ^
-	    libevdev_has_event_code(evdev, EV_ABS, ABS_Y))
+	evdev_snapshot_bits(evdev, &bits);
+
+	if (evdev_bits_partial(bits.abs, EVDEV_MASK_ABS_XY))
 		return true;
 
-	if (libevdev_has_event_code(evdev, EV_REL, REL_X) ^
-	    libevdev_has_event_code(evdev, EV_REL, REL_Y))
+	if (evdev_bits_partial(bits.rel, EVDEV_MASK_REL_XY))
 		return true;
 
 	if (!evdev_is_fake_mt_device(device) &&
-	    libevdev_has_event_code(evdev, EV_ABS, ABS_MT_POSITION_X) ^
-	    libevdev_has_event_code(evdev, EV_ABS, ABS_MT_POSITION_Y))
+	    evdev_bits_partial(bits.abs, EVDEV_MASK_MT_POS))
 		return true;
 
-	if (libevdev_has_event_code(evdev, EV_ABS, ABS_X)) {
+	if (bits.abs & bit64(ABS_X)) {
 		absx = libevdev_get_abs_info(evdev, ABS_X);
 		absy = libevdev_get_abs_info(evdev, ABS_Y);
 		if ((absx->resolution == 0 && absy->resolution != 0) ||
@@ -1758,7 +2108,7 @@ evdev_reject_device(struct evdev_device *device)
 	}
 
 	if (!evdev_is_fake_mt_device(device) &&
-	    libevdev_has_event_code(evdev, EV_ABS, ABS_MT_POSITION_X)) {
+	    bits.abs & bit64(ABS_MT_POSITION_X)) {
 		absx = libevdev_get_abs_info(evdev, ABS_MT_POSITION_X);
 		absy = libevdev_get_abs_info(evdev, ABS_MT_POSITION_Y);
 		if ((absx->resolution == 0 && absy->resolution != 0) ||
@@ -1770,6 +2120,9 @@ evdev_reject_device(struct evdev_device *device)
 	}
 
 	for (code = 0; code < ABS_CNT; code++) {
+		if (!(bits.abs & bit64(code)))
+			continue;
+
 		switch (code) {
 		case ABS_MISC:
 		case ABS_MT_SLOT:
@@ -1851,22 +2204,14 @@ evdev_disable_accelerometer_axes(struct evdev_device *device)
 }
 
 static struct evdev_dispatch *
-evdev_configure_device(struct evdev_device *device)
+evdev_configure_device(struct evdev_device *device,
+		       enum evdev_device_udev_tags udev_tags)
 {
 	struct libevdev *evdev = device->evdev;
-	enum evdev_device_udev_tags udev_tags;
+	struct evdev_bits bits;
 	unsigned int tablet_tags;
 	struct evdev_dispatch *dispatch;
 
-	udev_tags = evdev_device_get_udev_tags(device, device->udev_device);
-
-	if ((udev_tags & EVDEV_UDEV_TAG_INPUT) == 0 ||
-	    (udev_tags & ~EVDEV_UDEV_TAG_INPUT) == 0) {
-		evdev_log_info(device,
-			       "not tagged as supported input device\n");
-		return NULL;
-	}
-
 	evdev_log_info(device,
 		 "is tagged by udev as:%s%s%s%s%s%s%s%s%s%s%s\n",
 		 udev_tags & EVDEV_UDEV_TAG_KEYBOARD ? " Keyboard" : "",
@@ -1907,7 +2252,11 @@ evdev_configure_device(struct evdev_device *device)
 	if (!evdev_is_fake_mt_device(device))
 		evdev_fix_android_mt(device);
 
-	if (libevdev_has_event_code(evdev, EV_ABS, ABS_X)) {
+	/* after the fixups above, no code changes below until the
+	 * SW_TABLET_MODE check, which tests its bit before disabling it */
+	evdev_snapshot_bits(evdev, &bits);
+
+	if (bits.abs & bit64(ABS_X)) {
 		evdev_extract_abs_axes(device, udev_tags);
 
 		if (evdev_is_fake_mt_device(device))
@@ -1916,10 +2265,16 @@ evdev_configure_device(struct evdev_device *device)
 
 	if (evdev_device_has_model_quirk(device,
 					 QUIRK_MODEL_DELL_CANVAS_TOTEM)) {
+#if HAVE_TABLET
 		dispatch = evdev_totem_create(device);
 		device->seat_caps |= EVDEV_DEVICE_TABLET;
 		evdev_log_info(device, "device is a totem\n");
 		return dispatch;
+#else
+		evdev_log_info(device,
+			       "device is a totem, but tablet support is not compiled in\n");
+		return NULL;
+#endif
 	}
 
 	/* libwacom assigns touchpad (or touchscreen) _and_ tablet to the
@@ -1931,21 +2286,33 @@ evdev_configure_device(struct evdev_device *device)
 
 	/* libwacom assigns tablet _and_ tablet_pad to the pad devices */
 	if (udev_tags & EVDEV_UDEV_TAG_TABLET_PAD) {
+#if HAVE_TABLET
 		dispatch = evdev_tablet_pad_create(device);
 		device->seat_caps |= EVDEV_DEVICE_TABLET_PAD;
 		evdev_log_info(device, "device is a tablet pad\n");
 		return dispatch;
-
+#else
+		evdev_log_info(device,
+			       "device is a tablet pad, but tablet support is not compiled in\n");
+		return NULL;
+#endif
 	}
 
 	if ((udev_tags & tablet_tags) == EVDEV_UDEV_TAG_TABLET) {
+#if HAVE_TABLET
 		dispatch = evdev_tablet_create(device);
 		device->seat_caps |= EVDEV_DEVICE_TABLET;
 		evdev_log_info(device, "device is a tablet\n");
 		return dispatch;
+#else
+		evdev_log_info(device,
+			       "device is a tablet, but tablet support is not compiled in\n");
+		return NULL;
+#endif
 	}
 
 	if (udev_tags & EVDEV_UDEV_TAG_TOUCHPAD) {
+#if HAVE_TOUCHPAD
 		if (udev_tags & EVDEV_UDEV_TAG_TABLET)
 			evdev_tag_tablet_touchpad(device);
 		/* whether velocity should be averaged, false by default */
@@ -1953,6 +2320,11 @@ evdev_configure_device(struct evdev_device *device)
 		dispatch = evdev_mt_touchpad_create(device);
 		evdev_log_info(device, "device is a touchpad\n");
 		return dispatch;
+#else
+		evdev_log_info(device,
+			       "device is a touchpad, but touchpad support is not compiled in\n");
+		return NULL;
+#endif
 	}
 
 	if (udev_tags & EVDEV_UDEV_TAG_MOUSE ||
@@ -1973,8 +2345,7 @@ evdev_configure_device(struct evdev_device *device)
 		/* want natural-scroll config option */
 		device->scroll.natural_scrolling_enabled = true;
 		/* want button scrolling config option */
-		if (libevdev_has_event_code(evdev, EV_REL, REL_X) ||
-		    libevdev_has_event_code(evdev, EV_REL, REL_Y))
+		if (bits.rel & EVDEV_MASK_REL_XY)
 			device->scroll.want_button = 1;
 	}
 
@@ -1983,8 +2354,7 @@ evdev_configure_device(struct evdev_device *device)
 		evdev_log_info(device, "device is a keyboard\n");
 
 		/* want natural-scroll config option */
-		if (libevdev_has_event_code(evdev, EV_REL, REL_WHEEL) ||
-		    libevdev_has_event_code(evdev, EV_REL, REL_HWHEEL)) {
+		if (bits.rel & EVDEV_MASK_WHEEL) {
 			device->scroll.natural_scrolling_enabled = true;
 			device->seat_caps |= EVDEV_DEVICE_POINTER;
 		}
@@ -1998,13 +2368,13 @@ evdev_configure_device(struct evdev_device *device)
 	}
 
 	if (udev_tags & EVDEV_UDEV_TAG_SWITCH) {
-		if (libevdev_has_event_code(evdev, EV_SW, SW_LID)) {
+		if (bits.sw & bit64(SW_LID)) {
 			device->seat_caps |= EVDEV_DEVICE_SWITCH;
 			device->tags |= EVDEV_TAG_LID_SWITCH;
 			evdev_log_info(device, "device is a switch device\n");
 		}
 
-		if (libevdev_has_event_code(evdev, EV_SW, SW_TABLET_MODE)) {
+		if (bits.sw & bit64(SW_TABLET_MODE)) {
 		    if (evdev_device_has_model_quirk(device,
 				 QUIRK_MODEL_TABLET_MODE_SWITCH_UNRELIABLE)) {
 			    evdev_log_info(device,
@@ -2023,8 +2393,7 @@ evdev_configure_device(struct evdev_device *device)
 	}
 
 	if (device->seat_caps & EVDEV_DEVICE_POINTER &&
-	    libevdev_has_event_code(evdev, EV_REL, REL_X) &&
-	    libevdev_has_event_code(evdev, EV_REL, REL_Y) &&
+	    (bits.rel & EVDEV_MASK_REL_XY) == EVDEV_MASK_REL_XY &&
 	    !evdev_init_accel(device, LIBINPUT_CONFIG_ACCEL_PROFILE_ADAPTIVE)) {
 		evdev_log_error(device,
 				"failed to initialize pointer acceleration\n");
@@ -2041,12 +2410,15 @@ evdev_configure_device(struct evdev_device *device)
 static void
 evdev_notify_added_device(struct evdev_device *device)
 {
-	struct libinput_device *dev;
+	struct libinput_seat *seat = device->base.seat;
+
+	for (size_t i = 0; i < seat->devices_len; i++) {
+		struct libinput_device *dev = seat->devices[i];
+		struct evdev_device *d;
 
-	list_for_each(dev, &device->base.seat->devices_list, link) {
-		struct evdev_device *d = evdev_device(dev);
-		if (dev == &device->base)
+		if (!dev || dev == &device->base)
 			continue;
+		d = evdev_device(dev);
 
 		/* Notify existing device d about addition of device */
 		if (d->dispatch->interface->device_added)
@@ -2069,7 +2441,7 @@ evdev_notify_added_device(struct evdev_device *device)
 							device->dispatch);
 }
 
-static bool
+bool
 evdev_device_have_same_syspath(struct udev_device *udev_device, int fd)
 {
 	struct udev *udev = udev_device_get_udev(udev_device);
@@ -2118,7 +2490,7 @@ evdev_set_device_group(struct evdev_device *device,
 	return true;
 }
 
-static inline void
+void
 evdev_drain_fd(int fd)
 {
 	struct input_event ev[24];
@@ -2135,27 +2507,65 @@ evdev_pre_configure_model_quirks(struct evdev_device *device)
 	struct quirks_context *quirks;
 	struct quirks *q;
 	const struct quirk_tuples *t;
-	const uint32_t *props = NULL;
-	size_t nprops = 0;
-	char *prop;
+	enum req_idx {
+		REQ_MSC_TIMESTAMP = 0,
+		REQ_FRAMES_PER_DISPATCH,
+		REQ_EVENT_CODE_ENABLE,
+		REQ_EVENT_CODE_DISABLE,
+		REQ_INPUT_PROP_ENABLE,
+		REQ_INPUT_PROP_DISABLE,
+	};
+	struct quirks_request reqs[] = {
+		[REQ_MSC_TIMESTAMP] =
+			{ .which = QUIRK_ATTR_MSC_TIMESTAMP },
+		[REQ_FRAMES_PER_DISPATCH] =
+			{ .which = QUIRK_ATTR_FRAMES_PER_DISPATCH },
+		[REQ_EVENT_CODE_ENABLE] =
+			{ .which = QUIRK_ATTR_EVENT_CODE_ENABLE },
+		[REQ_EVENT_CODE_DISABLE] =
+			{ .which = QUIRK_ATTR_EVENT_CODE_DISABLE },
+		[REQ_INPUT_PROP_ENABLE] =
+			{ .which = QUIRK_ATTR_INPUT_PROP_ENABLE },
+		[REQ_INPUT_PROP_DISABLE] =
+			{ .which = QUIRK_ATTR_INPUT_PROP_DISABLE },
+	};
 
 	/* Touchpad claims to have 4 slots but only ever sends 2
 	 * https://bugs.freedesktop.org/show_bug.cgi?id=98100 */
 	if (evdev_device_has_model_quirk(device, QUIRK_MODEL_HP_ZBOOK_STUDIO_G3))
 		libevdev_set_abs_maximum(device->evdev, ABS_MT_SLOT, 1);
 
-	/* Generally we don't care about MSC_TIMESTAMP and it can cause
-	 * unnecessary wakeups but on some devices we need to watch it for
-	 * pointer jumps */
 	quirks = evdev_libinput_context(device)->quirks;
 	q = quirks_fetch_for_device(quirks, device->udev_device);
-	if (!q ||
-	    !quirks_get_string(q, QUIRK_ATTR_MSC_TIMESTAMP, &prop) ||
-	    !streq(prop, "watch")) {
+	quirks_get_many(q, reqs, ARRAY_LENGTH(reqs));
+
+	/* Generally we don't care about MSC_TIMESTAMP and it can cause
+	 * unnecessary wakeups but on some devices we need to watch it for
+	 * pointer jumps, and on relative pointer devices we use it as the
+	 * frame's hardware time, see evdev_note_hw_timestamp() */
+	bool watch_timestamps =
+		reqs[REQ_MSC_TIMESTAMP].set &&
+		streq(reqs[REQ_MSC_TIMESTAMP].value.s, "watch");
+	bool hw_timestamps =
+		libevdev_has_event_code(device->evdev, EV_REL, REL_X) &&
+		!libevdev_has_event_code(device->evdev, EV_ABS, ABS_MT_SLOT);
+	if (!watch_timestamps && !hw_timestamps) {
 		libevdev_disable_event_code(device->evdev, EV_MSC, MSC_TIMESTAMP);
 	}
 
-	if (quirks_get_tuples(q, QUIRK_ATTR_EVENT_CODE_ENABLE, &t)) {
+	/* High-rate devices (8kHz gaming mice) fill the kernel buffer
+	 * quickly when the compositor stalls; let them drain more frames
+	 * per dispatch before we yield to reduce SYN_DROPPED */
+	if (reqs[REQ_FRAMES_PER_DISPATCH].set) {
+		device->max_frames_per_dispatch =
+			reqs[REQ_FRAMES_PER_DISPATCH].value.u;
+		evdev_log_debug(device,
+				"quirks: dispatching up to %u frames per cycle\n",
+				reqs[REQ_FRAMES_PER_DISPATCH].value.u);
+	}
+
+	if (reqs[REQ_EVENT_CODE_ENABLE].set) {
+		t = reqs[REQ_EVENT_CODE_ENABLE].value.tuples;
 		for (size_t i = 0; i < t->ntuples; i++) {
 			const struct input_absinfo absinfo = {
 				.minimum = 0,
@@ -2181,7 +2591,8 @@ evdev_pre_configure_model_quirks(struct evdev_device *device)
 		}
 	}
 
-	if (quirks_get_tuples(q, QUIRK_ATTR_EVENT_CODE_DISABLE, &t)) {
+	if (reqs[REQ_EVENT_CODE_DISABLE].set) {
+		t = reqs[REQ_EVENT_CODE_DISABLE].value.tuples;
 		for (size_t i = 0; i < t->ntuples; i++) {
 			int type = t->tuples[i].first;
 			int code = t->tuples[i].second;
@@ -2202,10 +2613,12 @@ evdev_pre_configure_model_quirks(struct evdev_device *device)
 		}
 	}
 
-	if (quirks_get_uint32_array(q,
-				    QUIRK_ATTR_INPUT_PROP_ENABLE,
-				    &props,
-				    &nprops)) {
+	if (reqs[REQ_INPUT_PROP_ENABLE].set) {
+		const uint32_t *props =
+			reqs[REQ_INPUT_PROP_ENABLE].value.uint_array.data;
+		size_t nprops =
+			reqs[REQ_INPUT_PROP_ENABLE].value.uint_array.nelements;
+
 		for (size_t idx = 0; idx < nprops; idx++) {
 			unsigned int p = props[idx];
 			libevdev_enable_property(device->evdev, p);
@@ -2216,11 +2629,13 @@ evdev_pre_configure_model_quirks(struct evdev_device *device)
 		}
 	}
 
-	if (quirks_get_uint32_array(q,
-					 QUIRK_ATTR_INPUT_PROP_DISABLE,
-					 &props,
-					 &nprops)) {
+	if (reqs[REQ_INPUT_PROP_DISABLE].set) {
 #if HAVE_LIBEVDEV_DISABLE_PROPERTY
+		const uint32_t *props =
+			reqs[REQ_INPUT_PROP_DISABLE].value.uint_array.data;
+		size_t nprops =
+			reqs[REQ_INPUT_PROP_DISABLE].value.uint_array.nelements;
+
 		for (size_t idx = 0; idx < nprops; idx++) {
 			unsigned int p = props[idx];
 			libevdev_disable_property(device->evdev, p);
@@ -2273,7 +2688,7 @@ libevdev_log_func(const struct libevdev *evdev,
 #pragma GCC diagnostic pop
 }
 
-static bool
+bool
 udev_device_should_be_ignored(struct udev_device *udev_device)
 {
 	const char *value;
@@ -2284,17 +2699,130 @@ udev_device_should_be_ignored(struct udev_device *udev_device)
 	return value && !streq(value, "0");
 }
 
+static void
+evdev_device_init_key_map(struct evdev_device *device)
+{
+	size_t nkeys = 0;
+
+	for (int code = 0; code < KEY_CNT; code++) {
+		/* Internal synthesis (tap, middle button emulation,
+		 * three-finger drag) presses mouse buttons regardless of
+		 * the hardware's keybits, keep that range mapped on
+		 * every device */
+		if (libevdev_has_event_code(device->evdev, EV_KEY, code) ||
+		    (code >= BTN_MOUSE && code < BTN_JOYSTICK))
+			long_set_bit(device->key_cap_mask, code);
+	}
+
+	for (size_t w = 0; w < NLONGS(KEY_CNT); w++) {
+		device->key_rank_base[w] = nkeys;
+		nkeys += __builtin_popcountl(device->key_cap_mask[w]);
+	}
+
+	device->key_count = zalloc(nkeys);
+}
+
+/*
+ * Opt-in persistent per-device learning cache. With
+ * LIBINPUT_DEVICE_CACHE=<dir> set, what a device taught us during a run -
+ * currently its measured report cadence - is written out on removal and
+ * read back on the next create, keyed by bustype/vendor/product. The
+ * consumers of the cadence (the report-rate API, the accel filter
+ * interval, the touchpad's motion history sizing) then start from the
+ * measured value instead of re-converging over the first few dozen
+ * frames of every boot.
+ *
+ * The files are plain key=value text and a pure warm-start hint: stale
+ * or deleted entries only cost the usual warmup, never correctness.
+ */
+static void
+evdev_device_cache_path(struct evdev_device *device, char *path, size_t sz)
+{
+	const char *dir = getenv("LIBINPUT_DEVICE_CACHE");
+
+	if (!dir || !*dir) {
+		path[0] = '\0';
+		return;
+	}
+
+	snprintf(path, sz, "%s/%04x-%04x-%04x.device",
+		 dir,
+		 libevdev_get_id_bustype(device->evdev),
+		 libevdev_get_id_vendor(device->evdev),
+		 libevdev_get_id_product(device->evdev));
+}
+
+static void
+evdev_device_cache_load(struct evdev_device *device)
+{
+	char path[PATH_MAX];
+	char line[256];
+	FILE *fp;
+
+	evdev_device_cache_path(device, path, sizeof(path));
+	if (path[0] == '\0')
+		return;
+
+	fp = fopen(path, "re");
+	if (!fp)
+		return; /* first boot with this device, nothing learned */
+
+	while (fgets(line, sizeof(line), fp)) {
+		uint64_t interval;
+
+		/* values are hints, reject anything implausible */
+		if (sscanf(line, "report-interval=%" SCNu64, &interval) == 1 &&
+		    interval > 0 && interval <= ms2us(100))
+			device->cadence.interval = interval;
+	}
+	fclose(fp);
+
+	if (device->cadence.interval)
+		evdev_log_debug(device,
+				"cache: seeded report interval %" PRIu64 "µs\n",
+				device->cadence.interval);
+}
+
+static void
+evdev_device_cache_save(struct evdev_device *device)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+
+	evdev_device_cache_path(device, path, sizeof(path));
+	if (path[0] == '\0')
+		return;
+
+	if (device->cadence.interval == 0)
+		return; /* nothing learned, keep whatever is on disk */
+
+	fp = fopen(path, "we");
+	if (!fp)
+		return;
+
+	fprintf(fp, "# libinput device cache, safe to delete\n");
+	fprintf(fp, "report-interval=%" PRIu64 "\n",
+		device->cadence.interval);
+	fclose(fp);
+}
+
 struct evdev_device *
 evdev_device_create(struct libinput_seat *seat,
 		    struct udev_device *udev_device)
 {
 	struct libinput *libinput = seat->libinput;
 	struct evdev_device *device = NULL;
+	struct libevdev *preopened_evdev = NULL;
+	enum evdev_device_udev_tags udev_tags;
 	int rc;
 	int fd;
 	int unhandled_device = 0;
 	const char *devnode = udev_device_get_devnode(udev_device);
 	const char *sysname = udev_device_get_sysname(udev_device);
+	char timer_name[64];
+	struct libinput_phase_timing timing;
+
+	libinput_timing_start(libinput, &timing);
 
 	if (!devnode) {
 		log_info(libinput, "%s: no device node associated\n", sysname);
@@ -2306,33 +2834,59 @@ evdev_device_create(struct libinput_seat *seat,
 		return NULL;
 	}
 
-	/* Use non-blocking mode so that we can loop on read on
-	 * evdev_device_data() until all events on the fd are
-	 * read.  mtdev_get() also expects this. */
-	fd = open_restricted(libinput, devnode,
-			     O_RDWR | O_NONBLOCK | O_CLOEXEC);
-	if (fd < 0) {
+	/* The udev tags decide up front whether we handle this device at
+	 * all, so check them before paying for open_restricted(), the
+	 * libevdev probe ioctls and the quirks lookups. Machines tend to
+	 * have plenty of event nodes we don't handle (accelerometers,
+	 * joysticks, untagged nodes). */
+	udev_tags = evdev_device_get_udev_tags(libinput, udev_device);
+	if ((udev_tags & EVDEV_UDEV_TAG_INPUT) == 0 ||
+	    (udev_tags & ~EVDEV_UDEV_TAG_INPUT) == 0) {
 		log_info(libinput,
-			 "%s: opening input device '%s' failed (%s).\n",
-			 sysname,
-			 devnode,
-			 strerror(-fd));
-		return NULL;
+			 "%-7s - not tagged as supported input device\n",
+			 sysname);
+		return EVDEV_UNHANDLED_DEVICE;
 	}
 
-	if (!evdev_device_have_same_syspath(udev_device, fd))
-		goto err;
+	/* Parallel enumeration may have opened and probed this device
+	 * already, in which case we take over its fd and libevdev
+	 * context. */
+	fd = libinput_fetch_preopened_device(libinput,
+					     devnode,
+					     &preopened_evdev);
+	if (fd < 0) {
+		/* Use non-blocking mode so that we can loop on read on
+		 * evdev_device_data() until all events on the fd are
+		 * read.  mtdev_get() also expects this. */
+		fd = open_restricted(libinput, devnode,
+				     O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0) {
+			log_info(libinput,
+				 "%s: opening input device '%s' failed (%s).\n",
+				 sysname,
+				 devnode,
+				 strerror(-fd));
+			return NULL;
+		}
+
+		if (!evdev_device_have_same_syspath(udev_device, fd))
+			goto err;
+	}
 
 	device = zalloc(sizeof *device);
 
 	libinput_device_init(&device->base, seat);
 	libinput_seat_ref(seat);
 
-	evdev_drain_fd(fd);
+	if (preopened_evdev) {
+		device->evdev = preopened_evdev;
+	} else {
+		evdev_drain_fd(fd);
 
-	rc = libevdev_new_from_fd(fd, &device->evdev);
-	if (rc != 0)
-		goto err;
+		rc = libevdev_new_from_fd(fd, &device->evdev);
+		if (rc != 0)
+			goto err;
+	}
 
 	libevdev_set_clock_id(device->evdev, CLOCK_MONOTONIC);
 	libevdev_set_device_log_function(device->evdev,
@@ -2345,15 +2899,41 @@ evdev_device_create(struct libinput_seat *seat,
 	device->udev_device = udev_device_ref(udev_device);
 	device->dispatch = NULL;
 	device->fd = fd;
+	device->path_fd = -1;
+	/* Opt-in keepalive: retain an O_PATH fd so a later resume can
+	 * reopen the device without going back to open_restricted().
+	 * Callers that broker their opens (sandboxes, logind) otherwise
+	 * pay the broker round trip per device on every VT switch */
+	if (getenv("LIBINPUT_FD_KEEPALIVE")) {
+		char procfd[64];
+
+		snprintf(procfd, sizeof(procfd), "/proc/self/fd/%d", fd);
+		device->path_fd = open(procfd, O_PATH | O_CLOEXEC);
+	}
 	device->devname = libevdev_get_name(device->evdev);
+	snprintf(device->log_prefix.debug,
+		 sizeof(device->log_prefix.debug),
+		 "%-7s - ",
+		 evdev_device_get_sysname(device));
+	snprintf(device->log_prefix.info,
+		 sizeof(device->log_prefix.info),
+		 "%-7s - %s: ",
+		 evdev_device_get_sysname(device),
+		 device->devname);
 	device->scroll.threshold = 5.0; /* Default may be overridden */
 	device->scroll.direction_lock_threshold = 5.0; /* Default may be overridden */
 	device->scroll.direction = 0;
 	device->scroll.wheel_click_angle =
 		evdev_read_wheel_click_props(device);
+	device->scroll.wheel_degrees_per_v120.x =
+		device->scroll.wheel_click_angle.x / 120.0;
+	device->scroll.wheel_degrees_per_v120.y =
+		device->scroll.wheel_click_angle.y / 120.0;
 	device->model_flags = evdev_read_model_flags(device);
 	device->dpi = DEFAULT_MOUSE_DPI;
 
+	device->max_frames_per_dispatch = EVDEV_MAX_FRAMES_PER_DISPATCH;
+
 	/* at most 5 SYN_DROPPED log-messages per 30s */
 	ratelimit_init(&device->syn_drop_limit, s2us(30), 5);
 	/* at most 5 "delayed processing" log messages per hour */
@@ -2362,15 +2942,41 @@ evdev_device_create(struct libinput_seat *seat,
 	ratelimit_init(&device->nonpointer_rel_limit, s2us(5), 5);
 
 	matrix_init_identity(&device->abs.calibration);
+	matrix_init_identity(&device->abs.calibration_rel);
 	matrix_init_identity(&device->abs.usermatrix);
 	matrix_init_identity(&device->abs.default_calibration);
 
+	evdev_device_init_key_map(device);
+
 	evdev_pre_configure_model_quirks(device);
 
-	device->dispatch = evdev_configure_device(device);
+	/* Before the dispatch is configured: the touchpad sizes its
+	 * motion history off a seeded cadence */
+	evdev_device_cache_load(device);
+
+	device->dispatch = evdev_configure_device(device, udev_tags);
 	if (device->dispatch == NULL || device->seat_caps == 0)
 		goto err;
 
+	device->process = device->dispatch->interface->process;
+
+	evdev_device_update_capability_mask(device);
+
+	if (libinput->stats_page)
+		device->stats.slot =
+			libinput_stats_export_acquire_slot(libinput->stats_page,
+							   sysname);
+
+	snprintf(timer_name,
+		 sizeof(timer_name),
+		 "%s dispatch",
+		 sysname);
+	libinput_timer_init(&device->dispatch_pending_timer,
+			    libinput,
+			    timer_name,
+			    evdev_dispatch_pending_timer,
+			    device);
+
 	device->source =
 		libinput_add_fd(libinput, fd, evdev_device_dispatch, device);
 	if (!device->source)
@@ -2380,9 +2986,12 @@ evdev_device_create(struct libinput_seat *seat,
 		goto err;
 
 	list_insert(seat->devices_list.prev, &device->base.link);
+	libinput_seat_attach_device_slot(seat, &device->base);
 
 	evdev_notify_added_device(device);
 
+	libinput_timing_log(libinput, &timing, "device-probe", sysname);
+
 	return device;
 
 err:
@@ -2425,6 +3034,17 @@ evdev_device_get_id_vendor(struct evdev_device *device)
 	return libevdev_get_id_vendor(device->evdev);
 }
 
+unsigned int
+evdev_device_get_report_rate(struct evdev_device *device)
+{
+	uint64_t interval = device->cadence.interval;
+
+	if (interval == 0)
+		return 0;
+
+	return (unsigned int)((s2us(1) + interval / 2) / interval);
+}
+
 struct udev_device *
 evdev_device_get_udev_device(struct evdev_device *device)
 {
@@ -2456,6 +3076,8 @@ evdev_device_calibrate(struct evdev_device *device,
 
 	if (!device->abs.apply_calibration) {
 		matrix_init_identity(&device->abs.calibration);
+		matrix_init_identity(&device->abs.calibration_rel);
+		device->abs.calibration_kind = EVDEV_CALIBRATION_IDENTITY;
 		return;
 	}
 
@@ -2501,6 +3123,25 @@ evdev_device_calibrate(struct evdev_device *device,
 
 	/* store final matrix in device */
 	matrix_mult(&device->abs.calibration, &transform, &scale);
+	matrix_to_relative(&device->abs.calibration_rel,
+			   &device->abs.calibration);
+
+	/* Classify the combined matrix so evdev_transform_absolute()
+	 * can take a specialized path: a translation is two integer
+	 * adds, the general affine case runs in 16.16 fixed point. */
+	if (matrix_is_identity(&device->abs.calibration)) {
+		device->abs.calibration_kind = EVDEV_CALIBRATION_IDENTITY;
+	} else if (matrix_is_translate_only(&device->abs.calibration)) {
+		device->abs.calibration_kind = EVDEV_CALIBRATION_TRANSLATE;
+		device->abs.calibration_translate.x =
+			(int)lroundf(device->abs.calibration.val[0][2]);
+		device->abs.calibration_translate.y =
+			(int)lroundf(device->abs.calibration.val[1][2]);
+	} else {
+		device->abs.calibration_kind = EVDEV_CALIBRATION_AFFINE;
+		matrix_to_fixed(&device->abs.calibration_fixed,
+				&device->abs.calibration);
+	}
 }
 
 void
@@ -2579,6 +3220,83 @@ evdev_read_fuzz_prop(struct evdev_device *device, unsigned int code)
 	return 0;
 }
 
+void
+evdev_device_update_capability_mask(struct evdev_device *device)
+{
+	uint32_t mask = 0;
+	enum libinput_device_capability cap;
+
+	for (cap = LIBINPUT_DEVICE_CAP_KEYBOARD;
+	     cap <= LIBINPUT_DEVICE_CAP_SWITCH;
+	     cap++) {
+		if (evdev_device_has_capability(device, cap))
+			mask |= bit(cap);
+	}
+
+	device->base.capability_mask = mask;
+}
+
+enum libinput_config_status
+evdev_device_set_active_region(struct evdev_device *device,
+			       const struct libinput_region *regions,
+			       size_t nregions)
+{
+	const struct input_absinfo *ax = device->abs.absinfo_x,
+				   *ay = device->abs.absinfo_y;
+	struct device_coord_rect rects[ARRAY_LENGTH(device->active_region.rects)];
+
+	if (!(device->seat_caps & EVDEV_DEVICE_TOUCH) ||
+	    ax == NULL || ay == NULL)
+		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
+
+	if (nregions > ARRAY_LENGTH(rects))
+		return LIBINPUT_CONFIG_STATUS_INVALID;
+
+	for (size_t i = 0; i < nregions; i++) {
+		const struct libinput_region *r = &regions[i];
+
+		if (r->x < 0.0 || r->y < 0.0 ||
+		    r->width <= 0.0 || r->height <= 0.0 ||
+		    r->x + r->width > 1.0 || r->y + r->height > 1.0)
+			return LIBINPUT_CONFIG_STATUS_INVALID;
+
+		/* convert to device coordinates once so the per-touch
+		 * test in the dispatch path is integer compares */
+		rects[i].x = ax->minimum +
+			     (int)(r->x * (ax->maximum - ax->minimum));
+		rects[i].y = ay->minimum +
+			     (int)(r->y * (ay->maximum - ay->minimum));
+		rects[i].w = (int)(r->width * (ax->maximum - ax->minimum));
+		rects[i].h = (int)(r->height * (ay->maximum - ay->minimum));
+	}
+
+	memcpy(device->active_region.rects,
+	       rects,
+	       nregions * sizeof(rects[0]));
+	device->active_region.nrects = nregions;
+
+	return LIBINPUT_CONFIG_STATUS_SUCCESS;
+}
+
+bool
+evdev_device_point_in_active_region(const struct evdev_device *device,
+				    const struct device_coords *point)
+{
+	if (device->active_region.nrects == 0)
+		return true;
+
+	for (size_t i = 0; i < device->active_region.nrects; i++) {
+		const struct device_coord_rect *r =
+			&device->active_region.rects[i];
+
+		if (point->x >= r->x && point->x <= r->x + r->w &&
+		    point->y >= r->y && point->y <= r->y + r->h)
+			return true;
+	}
+
+	return false;
+}
+
 bool
 evdev_device_has_capability(struct evdev_device *device,
 			    enum libinput_device_capability capability)
@@ -2706,30 +3424,181 @@ evdev_start_scrolling(struct evdev_device *device,
 	device->scroll.direction |= bit(axis);
 }
 
+/* Fling integrator: fixed timestep, exponential decay per step */
+#define FLING_TIMESTEP ms2us(16)
+#define FLING_DECAY_PER_STEP 0.95
+/* below this much scroll per step the fling stops, normalized units */
+#define FLING_STOP_THRESHOLD 0.1
+#define FLING_NTRACKERS 16
+
+static void
+evdev_fling_stop(struct evdev_device *device, uint64_t time)
+{
+	const struct normalized_coords zero = { 0.0, 0.0 };
+
+	if (!device->scroll.fling.active)
+		return;
+
+	libinput_timer_cancel(&device->scroll.fling.timer);
+	device->scroll.fling.active = false;
+
+	/* the terminating zero event withheld when the fling started */
+	pointer_notify_axis_finger(&device->base,
+				   time,
+				   device->scroll.fling.axes,
+				   &zero);
+}
+
+static void
+evdev_fling_timer_func(uint64_t now, void *data)
+{
+	struct evdev_device *device = data;
+	struct normalized_coords delta;
+
+	delta.x = device->scroll.fling.velocity.x * FLING_TIMESTEP;
+	delta.y = device->scroll.fling.velocity.y * FLING_TIMESTEP;
+
+	if (hypot(delta.x, delta.y) < FLING_STOP_THRESHOLD) {
+		evdev_fling_stop(device, now);
+		return;
+	}
+
+	evdev_notify_axis_finger(device,
+				 now,
+				 device->scroll.fling.axes,
+				 &delta);
+
+	device->scroll.fling.velocity.x *= FLING_DECAY_PER_STEP;
+	device->scroll.fling.velocity.y *= FLING_DECAY_PER_STEP;
+
+	/* schedule off the previous deadline, not off now, so timer
+	 * jitter doesn't stretch the decay */
+	device->scroll.fling.next_time += FLING_TIMESTEP;
+	libinput_timer_set(&device->scroll.fling.timer,
+			   device->scroll.fling.next_time);
+}
+
+static bool
+evdev_fling_start(struct evdev_device *device, uint64_t time)
+{
+	struct pointer_trackers *trackers = device->scroll.fling.trackers;
+	struct normalized_coords velocity;
+	unsigned int index;
+	double speed, norm;
+
+	if (!device->scroll.fling.enabled)
+		return false;
+
+	/* the trackers give us the release speed, the most recent
+	 * tracker's accumulated delta gives us the direction */
+	speed = trackers_velocity(trackers, time); /* units/us */
+	index = trackers_index_by_offset(trackers, 1);
+	norm = hypot(trackers->deltas_x[index], trackers->deltas_y[index]);
+	if (speed == 0.0 || norm == 0.0)
+		return false;
+
+	velocity.x = speed * trackers->deltas_x[index] / norm;
+	velocity.y = speed * trackers->deltas_y[index] / norm;
+
+	/* only fling along the axes that were engaged */
+	if (!evdev_is_scrolling(device,
+				LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL))
+		velocity.y = 0.0;
+	if (!evdev_is_scrolling(device,
+				LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL))
+		velocity.x = 0.0;
+
+	/* too slow to produce even one step worth of scroll */
+	if (hypot(velocity.x, velocity.y) * FLING_TIMESTEP <
+	    FLING_STOP_THRESHOLD)
+		return false;
+
+	device->scroll.fling.velocity = velocity;
+	device->scroll.fling.axes = device->scroll.direction;
+	device->scroll.fling.active = true;
+	device->scroll.fling.next_time = time + FLING_TIMESTEP;
+	libinput_timer_set(&device->scroll.fling.timer,
+			   device->scroll.fling.next_time);
+
+	return true;
+}
+
+void
+evdev_device_scroll_set_fling_enabled(struct evdev_device *device,
+				      bool enabled)
+{
+	if (enabled && device->scroll.fling.trackers == NULL) {
+		char timer_name[64];
+
+		snprintf(timer_name,
+			 sizeof(timer_name),
+			 "%s fling",
+			 evdev_device_get_sysname(device));
+		libinput_timer_init(&device->scroll.fling.timer,
+				    evdev_libinput_context(device),
+				    timer_name,
+				    evdev_fling_timer_func, device);
+		device->scroll.fling.trackers =
+			zalloc(sizeof(*device->scroll.fling.trackers));
+		trackers_init(device->scroll.fling.trackers,
+			      FLING_NTRACKERS);
+	}
+
+	if (!enabled && device->scroll.fling.active)
+		evdev_fling_stop(device,
+				 libinput_now(evdev_libinput_context(device)));
+
+	device->scroll.fling.enabled = enabled;
+}
+
 void
 evdev_post_scroll(struct evdev_device *device,
 		  uint64_t time,
 		  enum libinput_pointer_axis_source source,
 		  const struct normalized_coords *delta)
 {
+	struct libinput *libinput = evdev_libinput_context(device);
 	const struct normalized_coords *trigger;
 	struct normalized_coords event;
+	bool scrolling_v, scrolling_h;
 
-	if (!evdev_is_scrolling(device,
-				LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL))
+	if (source == LIBINPUT_POINTER_AXIS_SOURCE_FINGER &&
+	    device->scroll.fling.enabled) {
+		struct device_float_coords raw = { delta->x, delta->y };
+
+		/* the finger is back on, the fling loses */
+		evdev_fling_stop(device, time);
+		trackers_feed(device->scroll.fling.trackers, &raw, time);
+	}
+
+	scrolling_v = evdev_is_scrolling(device,
+					 LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL);
+	scrolling_h = evdev_is_scrolling(device,
+					 LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL);
+
+	if (!scrolling_v)
 		device->scroll.buildup.y += delta->y;
-	if (!evdev_is_scrolling(device,
-				LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL))
+	if (!scrolling_h)
 		device->scroll.buildup.x += delta->x;
 
+	/* Both axes engaged: nothing left to trigger, go post */
+	if (scrolling_v && scrolling_h)
+		goto post;
+
+	/* Accumulate per event, but check the thresholds only once per
+	 * dispatch cycle - for trackpoint button-scrolling this runs for
+	 * every motion frame, and a caller lagging behind batches many
+	 * frames into one cycle. At worst scrolling engages one cycle
+	 * later than before, with the full buildup still accounted. */
+	if (libinput->dispatch_seq == device->scroll.threshold_eval_seq)
+		goto post;
+	device->scroll.threshold_eval_seq = libinput->dispatch_seq;
+
 	trigger = &device->scroll.buildup;
 
 	/* If we're not scrolling yet, use a distance trigger: moving
 	   past a certain distance starts scrolling */
-	if (!evdev_is_scrolling(device,
-				LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL) &&
-	    !evdev_is_scrolling(device,
-				LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL)) {
+	if (!scrolling_h && !scrolling_v) {
 		if (fabs(trigger->y) >= device->scroll.threshold)
 			evdev_start_scrolling(device,
 					      LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL);
@@ -2738,18 +3607,17 @@ evdev_post_scroll(struct evdev_device *device,
 					      LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL);
 	/* We're already scrolling in one direction. Require some
 	   trigger speed to start scrolling in the other direction */
-	} else if (!evdev_is_scrolling(device,
-			       LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL)) {
+	} else if (!scrolling_v) {
 		if (fabs(delta->y) >= device->scroll.direction_lock_threshold)
 			evdev_start_scrolling(device,
 				      LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL);
-	} else if (!evdev_is_scrolling(device,
-				LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL)) {
+	} else if (!scrolling_h) {
 		if (fabs(delta->x) >= device->scroll.direction_lock_threshold)
 			evdev_start_scrolling(device,
 				      LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL);
 	}
 
+post:
 	event = *delta;
 
 	/* We use the trigger to enable, but the delta from this event for
@@ -2794,6 +3662,13 @@ evdev_stop_scroll(struct evdev_device *device,
 {
 	const struct normalized_coords zero = { 0.0, 0.0 };
 
+	/* on finger release the fling takes over and posts the
+	 * terminating event once it has decayed */
+	if (source == LIBINPUT_POINTER_AXIS_SOURCE_FINGER &&
+	    device->scroll.direction != 0 &&
+	    evdev_fling_start(device, time))
+		goto reset;
+
 	/* terminate scrolling with a zero scroll event */
 	if (device->scroll.direction != 0) {
 		switch (source) {
@@ -2817,23 +3692,31 @@ evdev_stop_scroll(struct evdev_device *device,
 		}
 	}
 
+reset:
+	if (device->scroll.fling.trackers)
+		trackers_reset(device->scroll.fling.trackers, time);
+
 	device->scroll.buildup.x = 0;
 	device->scroll.buildup.y = 0;
 	device->scroll.direction = 0;
+	device->scroll.threshold_eval_seq = 0;
 }
 
 void
 evdev_notify_suspended_device(struct evdev_device *device)
 {
-	struct libinput_device *it;
+	struct libinput_seat *seat = device->base.seat;
 
 	if (device->is_suspended)
 		return;
 
-	list_for_each(it, &device->base.seat->devices_list, link) {
-		struct evdev_device *d = evdev_device(it);
-		if (it == &device->base)
+	for (size_t i = 0; i < seat->devices_len; i++) {
+		struct libinput_device *it = seat->devices[i];
+		struct evdev_device *d;
+
+		if (!it || it == &device->base)
 			continue;
+		d = evdev_device(it);
 
 		if (d->dispatch->interface->device_suspended)
 			d->dispatch->interface->device_suspended(d, device);
@@ -2845,15 +3728,18 @@ evdev_notify_suspended_device(struct evdev_device *device)
 void
 evdev_notify_resumed_device(struct evdev_device *device)
 {
-	struct libinput_device *it;
+	struct libinput_seat *seat = device->base.seat;
 
 	if (!device->is_suspended)
 		return;
 
-	list_for_each(it, &device->base.seat->devices_list, link) {
-		struct evdev_device *d = evdev_device(it);
-		if (it == &device->base)
+	for (size_t i = 0; i < seat->devices_len; i++) {
+		struct libinput_device *it = seat->devices[i];
+		struct evdev_device *d;
+
+		if (!it || it == &device->base)
 			continue;
+		d = evdev_device(it);
 
 		if (d->dispatch->interface->device_resumed)
 			d->dispatch->interface->device_resumed(d, device);
@@ -2862,6 +3748,36 @@ evdev_notify_resumed_device(struct evdev_device *device)
 	device->is_suspended = false;
 }
 
+int
+evdev_device_detach_fd(struct evdev_device *device)
+{
+	int fd = device->fd;
+
+	if (fd == -1 || device->pending_open)
+		return -1;
+
+	/* Clearing the fd first makes the suspend below skip
+	 * close_restricted(); the caller takes over the fd. The device
+	 * stays valid and can be resumed, which reopens it. */
+	device->fd = -1;
+	evdev_device_suspend(device);
+
+	return fd;
+}
+
+static void
+evdev_device_close_fd(struct evdev_device *device, int fd)
+{
+	struct libinput *libinput = evdev_libinput_context(device);
+
+	/* A keepalive fd was opened by us, not by the caller, so it
+	 * must not go through close_restricted() */
+	if (device->fd_is_keepalive)
+		close(fd);
+	else
+		close_restricted(libinput, fd);
+}
+
 void
 evdev_device_suspend(struct evdev_device *device)
 {
@@ -2878,44 +3794,34 @@ evdev_device_suspend(struct evdev_device *device)
 		device->source = NULL;
 	}
 
+	libinput_timer_cancel(&device->dispatch_pending_timer);
+
 	if (device->mtdev) {
 		mtdev_close_delete(device->mtdev);
 		device->mtdev = NULL;
 	}
 
 	if (device->fd != -1) {
-		close_restricted(libinput, device->fd);
+		evdev_device_close_fd(device, device->fd);
 		device->fd = -1;
+		device->fd_is_keepalive = false;
 	}
+
+	/* An async open still in flight is cancelled, the completion
+	 * will close the fd */
+	device->pending_open = false;
 }
 
-int
-evdev_device_resume(struct evdev_device *device)
+static int
+evdev_device_resume_with_fd(struct evdev_device *device, int fd)
 {
 	struct libinput *libinput = evdev_libinput_context(device);
-	int fd;
-	const char *devnode;
 	struct input_event ev;
 	enum libevdev_read_status status;
 
-	if (device->fd != -1)
-		return 0;
-
-	if (device->was_removed)
-		return -ENODEV;
-
-	devnode = udev_device_get_devnode(device->udev_device);
-	if (!devnode)
-		return -ENODEV;
-
-	fd = open_restricted(libinput, devnode,
-			     O_RDWR | O_NONBLOCK | O_CLOEXEC);
-
-	if (fd < 0)
-		return -errno;
-
 	if (!evdev_device_have_same_syspath(device->udev_device, fd)) {
-		close_restricted(libinput, fd);
+		evdev_device_close_fd(device, fd);
+		device->fd_is_keepalive = false;
 		return -ENODEV;
 	}
 
@@ -2950,25 +3856,124 @@ evdev_device_resume(struct evdev_device *device)
 		return -ENOMEM;
 	}
 
+	/* The accel filter survives the suspend; reset its velocity
+	 * history so the first motions after the resume are not averaged
+	 * against pre-suspend samples */
+	if (device->pointer.filter)
+		filter_restart(device->pointer.filter,
+			       NULL,
+			       libinput_now(libinput));
+
 	evdev_notify_resumed_device(device);
 
 	return 0;
 }
 
+int
+evdev_device_resume(struct evdev_device *device)
+{
+	struct libinput *libinput = evdev_libinput_context(device);
+	const char *devnode;
+	int fd;
+
+	if (device->fd != -1)
+		return 0;
+
+	if (device->was_removed)
+		return -ENODEV;
+
+	devnode = udev_device_get_devnode(device->udev_device);
+	if (!devnode)
+		return -ENODEV;
+
+	if (device->path_fd != -1) {
+		char procfd[64];
+
+		/* Reopening through the O_PATH fd skips the
+		 * open_restricted() round trip, see the keepalive setup
+		 * in evdev_device_create() */
+		snprintf(procfd, sizeof(procfd),
+			 "/proc/self/fd/%d", device->path_fd);
+		fd = open(procfd, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (fd >= 0) {
+			device->fd_is_keepalive = true;
+			return evdev_device_resume_with_fd(device, fd);
+		}
+		/* Device gone or revoked, fall back to the caller */
+	}
+
+	device->fd_is_keepalive = false;
+	fd = open_restricted(libinput, devnode,
+			     O_RDWR | O_NONBLOCK | O_CLOEXEC);
+
+	if (fd == -EINPROGRESS) {
+		/* The caller opens the device asynchronously and hands
+		 * the fd back via libinput_device_open_complete() */
+		device->pending_open = true;
+		return 0;
+	}
+
+	if (fd < 0)
+		return -errno;
+
+	return evdev_device_resume_with_fd(device, fd);
+}
+
+int
+evdev_device_open_complete(struct evdev_device *device, int fd)
+{
+	struct libinput *libinput = evdev_libinput_context(device);
+
+	if (!device->pending_open) {
+		/* The open was cancelled in the meantime, e.g. by a
+		 * suspend or the device being removed */
+		if (fd >= 0)
+			close_restricted(libinput, fd);
+		return -ENODEV;
+	}
+
+	device->pending_open = false;
+
+	if (device->was_removed || device->fd != -1) {
+		if (fd >= 0)
+			close_restricted(libinput, fd);
+		return -ENODEV;
+	}
+
+	if (fd < 0)
+		return fd;
+
+	return evdev_device_resume_with_fd(device, fd);
+}
+
 void
 evdev_device_remove(struct evdev_device *device)
 {
-	struct libinput_device *dev;
+	struct libinput_seat *seat = device->base.seat;
 
 	evdev_log_info(device, "device removed\n");
 
 	libinput_timer_cancel(&device->scroll.timer);
 	libinput_timer_cancel(&device->middlebutton.timer);
+	libinput_timer_cancel(&device->dispatch_pending_timer);
+	if (device->scroll.fling.trackers)
+		libinput_timer_cancel(&device->scroll.fling.timer);
 
-	list_for_each(dev, &device->base.seat->devices_list, link) {
-		struct evdev_device *d = evdev_device(dev);
-		if (dev == &device->base)
+	if (device->stats.slot) {
+		struct libinput *libinput = evdev_libinput_context(device);
+
+		libinput_stats_export_release_slot(libinput->stats_page,
+						   device->stats.slot);
+		device->stats.slot = NULL;
+	}
+
+	for (size_t i = 0; i < seat->devices_len; i++) {
+		struct libinput_device *dev = seat->devices[i];
+		struct evdev_device *d;
+
+		if (!dev || dev == &device->base)
 			continue;
+		d = evdev_device(dev);
 
 		if (d->dispatch->interface->device_removed)
 			d->dispatch->interface->device_removed(d, device);
@@ -2983,6 +3988,7 @@ evdev_device_remove(struct evdev_device *device)
 	 * skip re-opening a different device with the same node */
 	device->was_removed = true;
 
+	libinput_seat_detach_device_slot(device->base.seat, &device->base);
 	list_remove(&device->base.link);
 
 	notify_removed_device(&device->base);
@@ -2994,6 +4000,8 @@ evdev_device_destroy(struct evdev_device *device)
 {
 	struct evdev_dispatch *dispatch;
 
+	evdev_device_cache_save(device);
+
 	dispatch = device->dispatch;
 	if (dispatch)
 		dispatch->interface->destroy(dispatch);
@@ -3001,13 +4009,22 @@ evdev_device_destroy(struct evdev_device *device)
 	if (device->base.group)
 		libinput_device_group_unref(device->base.group);
 
-	free(device->output_name);
 	filter_destroy(device->pointer.filter);
+	filter_destroy(device->pointer.cached_filter);
 	libinput_timer_destroy(&device->scroll.timer);
 	libinput_timer_destroy(&device->middlebutton.timer);
+	libinput_timer_destroy(&device->dispatch_pending_timer);
+	if (device->scroll.fling.trackers) {
+		libinput_timer_destroy(&device->scroll.fling.timer);
+		trackers_free(device->scroll.fling.trackers);
+		free(device->scroll.fling.trackers);
+	}
 	libinput_seat_unref(device->base.seat);
+	if (device->path_fd != -1)
+		close(device->path_fd);
 	libevdev_free(device->evdev);
 	udev_device_unref(device->udev_device);
+	free(device->key_count);
 	free(device);
 }
 
@@ -38,6 +38,9 @@
 #include "filter.h"
 #include "quirks.h"
 
+struct pointer_trackers;
+struct stats_page_slot;
+
 /* The fake resolution value for abs devices without resolution */
 #define EVDEV_FAKE_RESOLUTION 1
 
@@ -153,24 +156,99 @@ enum evdev_debounce_state {
 	DEBOUNCE_ACTIVE,
 };
 
+/* set-time classification of the combined calibration matrix so the
+   per-event transform takes the cheapest applicable path */
+enum evdev_calibration_kind {
+	EVDEV_CALIBRATION_IDENTITY,
+	EVDEV_CALIBRATION_TRANSLATE,
+	EVDEV_CALIBRATION_AFFINE,
+};
+
 enum evdev_arbitration_state {
 	ARBITRATION_NOT_ACTIVE,
 	ARBITRATION_IGNORE_ALL,
 	ARBITRATION_IGNORE_RECT,
 };
 
+/* Shared between the tablet and totem dispatches: both carve an exclusion
+ * rect around the tool out of the paired touch device. The rects have
+ * tens of mm of margin around the tool, so rather than recomputing and
+ * pushing a rect on every tool motion event we track the tool position
+ * the current rect was computed for and only update once the tool has
+ * moved far enough for the stale rect to matter.
+ */
+struct tool_exclusion_region {
+	bool valid;
+	struct phys_coords tool_pos; /* position the rect was pushed for */
+};
+
+#define TOOL_EXCLUSION_UPDATE_THRESHOLD 5.0 /* mm */
+
+static inline void
+tool_exclusion_region_reset(struct tool_exclusion_region *region)
+{
+	region->valid = false;
+}
+
+/**
+ * Returns true if the tool has moved far enough from the last pushed
+ * rect (or no rect was pushed yet) and the caller must recompute the
+ * rect and push it to the touch device. The new position is recorded as
+ * pushed in that case.
+ */
+static inline bool
+tool_exclusion_region_update(struct tool_exclusion_region *region,
+			     struct phys_coords tool_mm)
+{
+	if (region->valid &&
+	    fabs(tool_mm.x - region->tool_pos.x) < TOOL_EXCLUSION_UPDATE_THRESHOLD &&
+	    fabs(tool_mm.y - region->tool_pos.y) < TOOL_EXCLUSION_UPDATE_THRESHOLD)
+		return false;
+
+	region->tool_pos = tool_mm;
+	region->valid = true;
+	return true;
+}
+
 struct evdev_device {
 	struct libinput_device base;
 
 	struct libinput_source *source;
+	/* re-kicks dispatch when a read burst was cut off by
+	 * EVDEV_MAX_FRAMES_PER_DISPATCH */
+	struct libinput_timer dispatch_pending_timer;
 
 	struct evdev_dispatch *dispatch;
+	/* dispatch->interface->process, cached once the dispatch is
+	 * configured so the per-event hot path loads one pointer instead
+	 * of chasing the vtable */
+	void (*process)(struct evdev_dispatch *dispatch,
+			struct evdev_device *device,
+			struct input_event *event,
+			uint64_t time);
 	struct libevdev *evdev;
 	struct udev_device *udev_device;
-	char *output_name;
+	const char *output_name; /* interned, owned by the context */
 	const char *devname;
+	/* "event5  - " and "event5  - <devname>: " formatted once at
+	 * creation; prepending them to a message is a plain copy, with
+	 * no per-message sysname lookup, see evdev_log_msg() */
+	struct {
+		char debug[32];
+		char info[256];
+	} log_prefix;
 	bool was_removed;
 	int fd;
+	/* open_restricted() returned -EINPROGRESS, we're waiting for
+	 * libinput_device_open_complete() */
+	bool pending_open;
+	/* O_PATH fd retained across suspend so a resume can reopen the
+	 * device via /proc/self/fd instead of another open_restricted()
+	 * round trip, see LIBINPUT_FD_KEEPALIVE. -1 unless enabled */
+	int path_fd;
+	/* fd was opened through path_fd, close it with close(2) rather
+	 * than close_restricted() */
+	bool fd_is_keepalive;
 	enum evdev_device_seat_capability seat_caps;
 	enum evdev_device_tags tags;
 	bool is_mt;
@@ -179,17 +257,66 @@ struct evdev_device {
 	double trackpoint_multiplier; /* trackpoint constant multiplier */
 	bool use_velocity_averaging; /* whether averaging should be applied on velocity calculation */
 	struct ratelimit syn_drop_limit; /* ratelimit for SYN_DROPPED logging */
+	uint64_t syn_dropped_count; /* total SYN_DROPPED since device creation */
+	/* active-region touch filter in device coordinates; no rects
+	 * means all touches pass, see
+	 * libinput_device_config_set_active_region() */
+	struct {
+		struct device_coord_rect rects[8];
+		size_t nrects;
+	} active_region;
+
+	/* always-on dispatch counters, see
+	 * libinput_device_get_event_stats(); when the context exports a
+	 * stats page the counters are mirrored into the device's slot */
+	struct {
+		uint64_t nevents;
+		uint64_t nframes;
+		struct stats_page_slot *slot; /* or NULL */
+	} stats;
+	/* Measured report cadence: EWMA over the SYN_REPORT spacing,
+	 * see libinput_device_get_report_rate(). interval stays 0 until
+	 * two frames close enough together have arrived; published is
+	 * the interval last handed to the accel filter */
+	struct {
+		uint64_t last_frame_time;
+		uint64_t interval;
+		uint64_t published;
+	} cadence;
+	/* frames to process per dispatch before yielding, default
+	 * EVDEV_MAX_FRAMES_PER_DISPATCH, raised by AttrFramesPerDispatch
+	 * for high-rate devices */
+	size_t max_frames_per_dispatch;
 	struct ratelimit delay_warning_limit; /* ratelimit for delayd processing logging */
 	struct ratelimit nonpointer_rel_limit; /* ratelimit for REL_* events from non-pointer devices */
 	uint32_t model_flags;
 	struct mtdev *mtdev;
 
+	/* Hardware frame timestamps (MSC_TIMESTAMP), anchored against
+	 * the kernel clock, see evdev_note_hw_timestamp(). frame_time is
+	 * the hw time of the frame currently being processed, 0 if the
+	 * frame carried no hardware timestamp */
+	struct {
+		bool anchored;
+		uint32_t anchor_msc;
+		uint64_t anchor;
+		uint64_t frame_time;
+	} hw_time;
+
 	struct {
 		const struct input_absinfo *absinfo_x, *absinfo_y;
 		bool is_fake_resolution;
 
 		int apply_calibration;
 		struct matrix calibration;
+		enum evdev_calibration_kind calibration_kind;
+		/* offsets for the translate-only path */
+		struct device_coords calibration_translate;
+		/* 16.16 mirror of calibration for the full-affine path */
+		struct matrix_fixed calibration_fixed;
+		/* rotation/scale rows of calibration with the translation
+		 * dropped, precomposed for evdev_transform_relative() */
+		struct matrix calibration_rel;
 		struct matrix default_calibration; /* from LIBINPUT_CALIBRATION_MATRIX */
 		struct matrix usermatrix; /* as supplied by the caller */
 
@@ -220,6 +347,13 @@ struct evdev_device {
 		double direction_lock_threshold;
 		uint32_t direction;
 		struct normalized_coords buildup;
+		/* dispatch cycle the scroll thresholds were last checked
+		 * in, see evdev_post_scroll() */
+		uint64_t threshold_eval_seq;
+
+		/* scroll posted to the client since the last
+		 * libinput_device_sample_scroll(), all sources */
+		struct normalized_coords sampled;
 
 		struct libinput_device_config_natural_scroll config_natural;
 		/* set during device init if we want natural scrolling,
@@ -232,20 +366,57 @@ struct evdev_device {
 
 		/* angle per REL_WHEEL click in degrees */
 		struct wheel_angle wheel_click_angle;
+		/* wheel_click_angle / 120, precomputed so the hi-res
+		 * degree conversion is one multiply per event */
+		struct wheel_angle wheel_degrees_per_v120;
 
 		enum evdev_button_scroll_lock_state lock_state;
 		bool want_lock_enabled;
 		bool lock_enabled;
+
+		/* Kinetic scrolling past finger release, opt-in via
+		 * libinput_device_scroll_set_fling_enabled(). The
+		 * trackers feed off the finger scroll deltas, i.e. the
+		 * same velocity estimator the pointer accel filters
+		 * use; the fling timer then posts decaying axis events
+		 * from a fixed-timestep integrator */
+		struct {
+			bool enabled;
+			bool active;
+			struct pointer_trackers *trackers;
+			struct libinput_timer timer;
+			/* decayed at each timestep, normalized units/us */
+			struct normalized_coords velocity;
+			/* axes engaged when the fling started */
+			uint32_t axes;
+			/* absolute deadline of the next timestep */
+			uint64_t next_time;
+		} fling;
 	} scroll;
 
 	struct {
 		struct libinput_device_config_accel config;
 		struct motion_filter *filter;
+		/* the filter displaced by the last profile switch, kept
+		 * with its tracker allocations for the switch back */
+		struct motion_filter *cached_filter;
 	} pointer;
 
 	/* Key counter used for multiplexing button events internally in
-	 * libinput. */
-	uint8_t key_count[KEY_CNT];
+	 * libinput. Sized from the device's actual keybits rather than
+	 * KEY_CNT - most event nodes expose a handful of keys. A code
+	 * maps to its slot by ranking it within key_cap_mask, see
+	 * evdev_device_key_slot(). */
+	uint8_t *key_count;
+	/* the codes this device may press: its keybits plus the mouse
+	 * button range libinput synthesizes into */
+	unsigned long key_cap_mask[NLONGS(KEY_CNT)];
+	/* number of capability bits in all words before this one */
+	uint16_t key_rank_base[NLONGS(KEY_CNT)];
+	/* One bit per code with a nonzero key count, so "which keys are
+	 * down" is answered by sweeping the set words instead of all of
+	 * key_count */
+	unsigned long key_down_mask[NLONGS(KEY_CNT)];
 
 	struct {
 		struct libinput_device_config_left_handed config;
@@ -262,6 +433,13 @@ struct evdev_device {
 		struct libinput_device_config_middle_emulation config;
 		/* middle-button emulation enabled */
 		bool enabled;
+		/* set iff enabled; the emulation stage is only linked
+		 * into the physical button path while emulation is on,
+		 * see evdev_middlebutton_splice() */
+		bool (*filter)(struct evdev_device *device,
+			       uint64_t time,
+			       int button,
+			       enum libinput_button_state state);
 		bool enabled_default;
 		bool want_enabled;
 		enum evdev_middlebutton_state state;
@@ -377,6 +555,15 @@ struct evdev_device *
 evdev_device_create(struct libinput_seat *seat,
 		    struct udev_device *device);
 
+bool
+evdev_device_have_same_syspath(struct udev_device *udev_device, int fd);
+
+bool
+udev_device_should_be_ignored(struct udev_device *udev_device);
+
+void
+evdev_drain_fd(int fd);
+
 static inline struct libinput *
 evdev_libinput_context(const struct evdev_device *device)
 {
@@ -433,14 +620,18 @@ evdev_device_init_pointer_acceleration(struct evdev_device *device,
 struct evdev_dispatch *
 evdev_touchpad_create(struct evdev_device *device);
 
+#if HAVE_TOUCHPAD
 struct evdev_dispatch *
 evdev_mt_touchpad_create(struct evdev_device *device);
+#endif
 
+#if HAVE_TABLET
 struct evdev_dispatch *
 evdev_tablet_create(struct evdev_device *device);
 
 struct evdev_dispatch *
 evdev_tablet_pad_create(struct evdev_device *device);
+#endif
 
 struct evdev_dispatch *
 evdev_lid_switch_dispatch_create(struct evdev_device *device);
@@ -448,8 +639,10 @@ evdev_lid_switch_dispatch_create(struct evdev_device *device);
 struct evdev_dispatch *
 fallback_dispatch_create(struct libinput_device *libinput_device);
 
+#if HAVE_TABLET
 struct evdev_dispatch *
 evdev_totem_create(struct evdev_device *device);
+#endif
 
 bool
 evdev_is_fake_mt_device(struct evdev_device *device);
@@ -478,6 +671,9 @@ evdev_device_get_id_product(struct evdev_device *device);
 unsigned int
 evdev_device_get_id_vendor(struct evdev_device *device);
 
+unsigned int
+evdev_device_get_report_rate(struct evdev_device *device);
+
 struct udev_device *
 evdev_device_get_udev_device(struct evdev_device *device);
 
@@ -488,6 +684,9 @@ void
 evdev_device_calibrate(struct evdev_device *device,
 		       const float calibration[6]);
 
+void
+evdev_device_update_capability_mask(struct evdev_device *device);
+
 bool
 evdev_device_has_capability(struct evdev_device *device,
 			    enum libinput_device_capability capability);
@@ -510,6 +709,7 @@ int
 evdev_device_has_switch(struct evdev_device *device,
 			enum libinput_switch sw);
 
+#if HAVE_TABLET
 int
 evdev_device_tablet_pad_has_key(struct evdev_device *device,
 				uint32_t code);
@@ -529,6 +729,46 @@ evdev_device_tablet_pad_get_num_mode_groups(struct evdev_device *device);
 struct libinput_tablet_pad_mode_group *
 evdev_device_tablet_pad_get_mode_group(struct evdev_device *device,
 				       unsigned int index);
+#else
+/* Without tablet support no device ever gains the TABLET_PAD
+ * capability, these stubs answer like any other device without it */
+static inline int
+evdev_device_tablet_pad_has_key(struct evdev_device *device, uint32_t code)
+{
+	return -1;
+}
+
+static inline int
+evdev_device_tablet_pad_get_num_buttons(struct evdev_device *device)
+{
+	return -1;
+}
+
+static inline int
+evdev_device_tablet_pad_get_num_rings(struct evdev_device *device)
+{
+	return -1;
+}
+
+static inline int
+evdev_device_tablet_pad_get_num_strips(struct evdev_device *device)
+{
+	return -1;
+}
+
+static inline int
+evdev_device_tablet_pad_get_num_mode_groups(struct evdev_device *device)
+{
+	return -1;
+}
+
+static inline struct libinput_tablet_pad_mode_group *
+evdev_device_tablet_pad_get_mode_group(struct evdev_device *device,
+				       unsigned int index)
+{
+	return NULL;
+}
+#endif /* HAVE_TABLET */
 
 enum libinput_switch_state
 evdev_device_switch_get_state(struct evdev_device *device,
@@ -543,12 +783,33 @@ double
 evdev_device_transform_y(struct evdev_device *device,
 			 double y,
 			 uint32_t height);
+
+/* Mirror a transformed absolute position into the context's
+ * shared-memory position page, if enabled. No-op otherwise. */
+void
+evdev_export_position(struct evdev_device *device,
+		      uint64_t time,
+		      const struct device_coords *point);
+
 void
 evdev_device_suspend(struct evdev_device *device);
 
+/* Suspend the device but hand its open fd to the caller instead of
+ * closing it, see libinput_clone_context(). Returns the fd or -1 */
+int
+evdev_device_detach_fd(struct evdev_device *device);
+
 int
 evdev_device_resume(struct evdev_device *device);
 
+int
+evdev_device_open_complete(struct evdev_device *device, int fd);
+
+int
+evdev_device_inject_events(struct evdev_device *device,
+			   const struct input_event *events,
+			   size_t nevents);
+
 void
 evdev_notify_suspended_device(struct evdev_device *device);
 
@@ -577,6 +838,23 @@ void
 evdev_set_button_scroll_lock_enabled(struct evdev_device *device,
 				     bool enabled);
 
+/**
+ * Return the slot for this code in the device's compact key_count
+ * array, or -1 if the device cannot press this code.
+ */
+static inline int
+evdev_device_key_slot(const struct evdev_device *device, int code)
+{
+	size_t w = (size_t)code / LONG_BITS;
+	unsigned long below = device->key_cap_mask[w] &
+				(bit(code % LONG_BITS) - 1);
+
+	if (!long_bit_is_set(device->key_cap_mask, code))
+		return -1;
+
+	return device->key_rank_base[w] + __builtin_popcountl(below);
+}
+
 int
 evdev_update_key_down_count(struct evdev_device *device,
 			    int code,
@@ -616,6 +894,19 @@ evdev_stop_scroll(struct evdev_device *device,
 		  uint64_t time,
 		  enum libinput_pointer_axis_source source);
 
+void
+evdev_device_scroll_set_fling_enabled(struct evdev_device *device,
+				      bool enabled);
+
+enum libinput_config_status
+evdev_device_set_active_region(struct evdev_device *device,
+			       const struct libinput_region *regions,
+			       size_t nregions);
+
+bool
+evdev_device_point_in_active_region(const struct evdev_device *device,
+				    const struct device_coords *point);
+
 void
 evdev_device_remove(struct evdev_device *device);
 
@@ -628,6 +919,17 @@ evdev_middlebutton_filter_button(struct evdev_device *device,
 				 int button,
 				 enum libinput_button_state state);
 
+/* The only way to flip middlebutton.enabled: it keeps the filter
+ * callback in sync so disabled devices don't run the state machine on
+ * every button event */
+static inline void
+evdev_middlebutton_splice(struct evdev_device *device, bool enable)
+{
+	device->middlebutton.enabled = enable;
+	device->middlebutton.filter =
+		enable ? evdev_middlebutton_filter_button : NULL;
+}
+
 void
 evdev_init_middlebutton(struct evdev_device *device,
 			bool enabled,
@@ -725,6 +1027,21 @@ evdev_hysteresis(const struct device_coords *in,
 	if (!a || !b)
 		return *in;
 
+	if (dx == 0 && dy == 0)
+		return *center;
+
+	/*
+	 * The common case on a jittery device is the point staying within
+	 * the margin. Test that in integers before paying for any of the
+	 * sqrt calls below:
+	 *   dx²/a² + dy²/b² < 1  <=>  dx²b² + dy²a² < a²b²
+	 * This runs for every changed slot of every frame on both the
+	 * fallback and the touchpad dispatch paths.
+	 */
+	if ((int64_t)dx2 * b * b + (int64_t)dy2 * a * a <
+	    (int64_t)a * a * b * b)
+		return *center;
+
 	/*
 	 * Basic equation for an ellipse of radii a,b:
 	 *   x²/a² + y²/b² = 1
@@ -736,10 +1053,6 @@ evdev_hysteresis(const struct device_coords *in,
 	normalized_finger_distance = sqrt((double)dx2 / (a * a) +
 					  (double)dy2 / (b * b));
 
-	/* Which means anything less than 1 is within the elliptical margin */
-	if (normalized_finger_distance < 1.0)
-		return *center;
-
 	finger_distance = sqrt(dx2 + dy2);
 	margin_distance = finger_distance / normalized_finger_distance;
 
@@ -784,10 +1097,9 @@ evdev_log_msg(struct evdev_device *device,
 	/* Anything info and above is user-visible, use the device name */
 	snprintf(buf,
 		 sizeof(buf),
-		 "%-7s - %s%s%s",
-		 evdev_device_get_sysname(device),
-		 (priority > LIBINPUT_LOG_PRIORITY_DEBUG) ?  device->devname : "",
-		 (priority > LIBINPUT_LOG_PRIORITY_DEBUG) ?  ": " : "",
+		 "%s%s",
+		 (priority > LIBINPUT_LOG_PRIORITY_DEBUG) ?
+			 device->log_prefix.info : device->log_prefix.debug,
 		 format);
 
 	va_start(args, format);
@@ -807,25 +1119,39 @@ evdev_log_msg_ratelimit(struct evdev_device *device,
 			const char *format,
 			...)
 {
+	struct libinput *libinput = evdev_libinput_context(device);
 	va_list args;
 	char buf[1024];
 
 	enum ratelimit_state state;
 
-	if (!is_logged(evdev_libinput_context(device), priority))
+	if (!is_logged(libinput, priority))
 		return;
 
-	state = ratelimit_test(ratelimit);
+	/* Re-use the dispatch timestamp where we have one, the ratelimit
+	 * intervals are coarse enough that we don't need to re-read the
+	 * clock for every message. */
+	if (libinput->dispatch_time)
+		state = ratelimit_test_time(ratelimit, libinput->dispatch_time);
+	else
+		state = ratelimit_test(ratelimit);
 	if (state == RATELIMIT_EXCEEDED)
 		return;
 
+	if (ratelimit->last_suppressed) {
+		evdev_log_msg(device,
+			      priority,
+			      "%" PRIu64 " similar messages were suppressed by the rate limit\n",
+			      ratelimit->last_suppressed);
+		ratelimit->last_suppressed = 0;
+	}
+
 	/* Anything info and above is user-visible, use the device name */
 	snprintf(buf,
 		 sizeof(buf),
-		 "%-7s - %s%s%s",
-		 evdev_device_get_sysname(device),
-		 (priority > LIBINPUT_LOG_PRIORITY_DEBUG) ?  device->devname : "",
-		 (priority > LIBINPUT_LOG_PRIORITY_DEBUG) ?  ": " : "",
+		 "%s%s",
+		 (priority > LIBINPUT_LOG_PRIORITY_DEBUG) ?
+			 device->log_prefix.info : device->log_prefix.debug,
 		 format);
 
 	va_start(args, format);
@@ -1021,7 +1347,7 @@ evdev_device_check_abs_axis_range(struct evdev_device *device,
 		return;
 	}
 
-	if (value < min || value > max) {
+	if (unlikely(value < min || value > max)) {
 		log_info_ratelimit(evdev_libinput_context(device),
 				   &device->abs.warning_range.range_warn_limit,
 				   "Axis %#x value %d is outside expected range [%d, %d]\n"
@@ -0,0 +1,702 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "event-export.h"
+#include "libinput-util.h"
+
+struct libinput_export_ring {
+	struct libinput *libinput;
+	struct export_ring_header *header; /* start of the mapping */
+	struct export_record *records;
+	size_t mapsize;
+};
+
+bool
+libinput_export_requested(void)
+{
+	const char *path = getenv("LIBINPUT_EXPORT_RING");
+
+	return path && *path;
+}
+
+struct libinput_export_ring *
+libinput_export_create(struct libinput *libinput)
+{
+	const char *path = getenv("LIBINPUT_EXPORT_RING");
+	struct libinput_export_ring *ring;
+	struct export_ring_header header = {
+		.magic = EXPORT_RING_MAGIC,
+		.version = EXPORT_RING_VERSION,
+		.record_size = sizeof(struct export_record),
+		.nrecords = EXPORT_RING_NRECORDS,
+		.head = 0,
+	};
+	size_t mapsize;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC|O_NOFOLLOW, 0644);
+	if (fd == -1) {
+		log_error(libinput,
+			  "export: failed to open ring file %s\n", path);
+		return NULL;
+	}
+
+	mapsize = sizeof(header) +
+		  EXPORT_RING_NRECORDS * sizeof(struct export_record);
+	if (ftruncate(fd, mapsize) == -1) {
+		log_error(libinput,
+			  "export: failed to size ring file %s\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, mapsize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	/* Readers keep the file open, we only need the mapping */
+	close(fd);
+	if (map == MAP_FAILED) {
+		log_error(libinput,
+			  "export: failed to map ring file %s\n", path);
+		return NULL;
+	}
+
+	ring = zalloc(sizeof *ring);
+	ring->libinput = libinput;
+	ring->header = map;
+	ring->records = (struct export_record *)((char *)map +
+						 sizeof(header));
+	ring->mapsize = mapsize;
+
+	/* Publish the header last so a reader that maps the file early
+	 * doesn't see a valid magic with a half-written header */
+	memset(ring->records, 0,
+	       EXPORT_RING_NRECORDS * sizeof(struct export_record));
+	header.magic = 0;
+	memcpy(ring->header, &header, sizeof(header));
+	__atomic_store_n(&ring->header->magic,
+			 EXPORT_RING_MAGIC,
+			 __ATOMIC_RELEASE);
+
+	log_debug(libinput, "export: event ring enabled at %s\n", path);
+
+	return ring;
+}
+
+void
+libinput_export_destroy(struct libinput_export_ring *ring)
+{
+	if (!ring)
+		return;
+
+	/* Invalidate the magic so lingering readers stop consuming */
+	__atomic_store_n(&ring->header->magic, 0, __ATOMIC_RELEASE);
+	munmap(ring->header, ring->mapsize);
+	free(ring);
+}
+
+void
+libinput_export_post(struct libinput_export_ring *ring,
+		     struct libinput_event *event,
+		     uint64_t time)
+{
+	uint64_t head = ring->header->head;
+	struct export_record *r = &ring->records[head %
+						 EXPORT_RING_NRECORDS];
+
+	r->time = time;
+	r->type = event->type;
+	if (event->device)
+		snprintf(r->sysname, sizeof(r->sysname), "%s",
+			 libinput_device_get_sysname(event->device));
+	else
+		r->sysname[0] = '\0';
+
+	/* Release: the record content must be visible before the new
+	 * head. A reader that sees head > its own position copies the
+	 * record, then re-reads head to detect having been lapped. */
+	__atomic_store_n(&ring->header->head, head + 1, __ATOMIC_RELEASE);
+}
+
+struct libinput_position_page {
+	struct libinput *libinput;
+	struct position_record *record; /* the whole mapping */
+};
+
+bool
+libinput_position_export_requested(void)
+{
+	const char *path = getenv("LIBINPUT_POSITION_PAGE");
+
+	return path && *path;
+}
+
+struct libinput_position_page *
+libinput_position_export_create(struct libinput *libinput)
+{
+	const char *path = getenv("LIBINPUT_POSITION_PAGE");
+	struct libinput_position_page *page;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC|O_NOFOLLOW, 0644);
+	if (fd == -1) {
+		log_error(libinput,
+			  "export: failed to open position page %s\n", path);
+		return NULL;
+	}
+
+	if (ftruncate(fd, sizeof(struct position_record)) == -1) {
+		log_error(libinput,
+			  "export: failed to size position page %s\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, sizeof(struct position_record),
+		   PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	/* Readers keep the file open, we only need the mapping */
+	close(fd);
+	if (map == MAP_FAILED) {
+		log_error(libinput,
+			  "export: failed to map position page %s\n", path);
+		return NULL;
+	}
+
+	page = zalloc(sizeof *page);
+	page->libinput = libinput;
+	page->record = map;
+
+	/* Publish the magic last, same reasoning as the ring header */
+	memset(page->record, 0, sizeof(*page->record));
+	page->record->version = POSITION_PAGE_VERSION;
+	__atomic_store_n(&page->record->magic,
+			 POSITION_PAGE_MAGIC,
+			 __ATOMIC_RELEASE);
+
+	log_debug(libinput, "export: position page enabled at %s\n", path);
+
+	return page;
+}
+
+void
+libinput_position_export_destroy(struct libinput_position_page *page)
+{
+	if (!page)
+		return;
+
+	/* Invalidate the magic so lingering readers stop sampling */
+	__atomic_store_n(&page->record->magic, 0, __ATOMIC_RELEASE);
+	munmap(page->record, sizeof(*page->record));
+	free(page);
+}
+
+void
+libinput_position_export_post(struct libinput_position_page *page,
+			      struct libinput_device *device,
+			      uint64_t time,
+			      double x,
+			      double y)
+{
+	struct position_record *r = page->record;
+	uint32_t seq = r->seq;
+
+	/* Seqlock write side: seq is odd for the duration of the update,
+	 * with store barriers on either side of the payload so a reader
+	 * sampling at scanout time can detect a torn copy and retry */
+	__atomic_store_n(&r->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	r->time = time;
+	r->x = x;
+	r->y = y;
+	snprintf(r->sysname, sizeof(r->sysname), "%s",
+		 libinput_device_get_sysname(device));
+
+	__atomic_store_n(&r->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+struct libinput_touch_journal {
+	struct libinput *libinput;
+	struct touch_journal_record *record; /* the whole mapping */
+};
+
+bool
+libinput_touch_journal_requested(void)
+{
+	const char *path = getenv("LIBINPUT_TOUCH_JOURNAL");
+
+	return path && *path;
+}
+
+struct libinput_touch_journal *
+libinput_touch_journal_create(struct libinput *libinput)
+{
+	const char *path = getenv("LIBINPUT_TOUCH_JOURNAL");
+	struct libinput_touch_journal *journal;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC|O_NOFOLLOW, 0644);
+	if (fd == -1) {
+		log_error(libinput,
+			  "export: failed to open touch journal %s\n", path);
+		return NULL;
+	}
+
+	if (ftruncate(fd, sizeof(struct touch_journal_record)) == -1) {
+		log_error(libinput,
+			  "export: failed to size touch journal %s\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, sizeof(struct touch_journal_record),
+		   PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	/* Readers keep the file open, we only need the mapping */
+	close(fd);
+	if (map == MAP_FAILED) {
+		log_error(libinput,
+			  "export: failed to map touch journal %s\n", path);
+		return NULL;
+	}
+
+	journal = zalloc(sizeof *journal);
+	journal->libinput = libinput;
+	journal->record = map;
+
+	/* Publish the magic last, same reasoning as the ring header */
+	memset(journal->record, 0, sizeof(*journal->record));
+	journal->record->version = TOUCH_JOURNAL_VERSION;
+	__atomic_store_n(&journal->record->magic,
+			 TOUCH_JOURNAL_MAGIC,
+			 __ATOMIC_RELEASE);
+
+	log_debug(libinput, "export: touch journal enabled at %s\n", path);
+
+	return journal;
+}
+
+void
+libinput_touch_journal_destroy(struct libinput_touch_journal *journal)
+{
+	if (!journal)
+		return;
+
+	/* Invalidate the magic so lingering readers stop sampling */
+	__atomic_store_n(&journal->record->magic, 0, __ATOMIC_RELEASE);
+	munmap(journal->record, sizeof(*journal->record));
+	free(journal);
+}
+
+void
+libinput_touch_journal_post(struct libinput_touch_journal *journal,
+			    struct libinput_device *device,
+			    uint64_t time,
+			    uint32_t gesture_state,
+			    uint32_t finger_count,
+			    const struct touch_journal_touch *touches,
+			    size_t ntouches)
+{
+	struct touch_journal_record *r = journal->record;
+	uint32_t seq = r->seq;
+
+	if (ntouches > TOUCH_JOURNAL_MAX_TOUCHES)
+		ntouches = TOUCH_JOURNAL_MAX_TOUCHES;
+
+	/* Seqlock write side, see libinput_position_export_post() */
+	__atomic_store_n(&r->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	r->time = time;
+	r->gesture_state = gesture_state;
+	r->finger_count = finger_count;
+	r->ntouches = ntouches;
+	memcpy(r->touches, touches, ntouches * sizeof(*touches));
+	snprintf(r->sysname, sizeof(r->sysname), "%s",
+		 libinput_device_get_sysname(device));
+
+	__atomic_store_n(&r->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+struct libinput_stats_page {
+	struct libinput *libinput;
+	struct stats_page_header *header; /* start of the mapping */
+	struct stats_page_slot *slots;
+	size_t mapsize;
+};
+
+bool
+libinput_stats_export_requested(void)
+{
+	const char *path = getenv("LIBINPUT_STATS_PAGE");
+
+	return path && *path;
+}
+
+struct libinput_stats_page *
+libinput_stats_export_create(struct libinput *libinput)
+{
+	const char *path = getenv("LIBINPUT_STATS_PAGE");
+	struct libinput_stats_page *page;
+	size_t mapsize;
+	void *map;
+	int fd;
+
+	mapsize = sizeof(struct stats_page_header) +
+		  STATS_PAGE_NSLOTS * sizeof(struct stats_page_slot);
+
+	fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC|O_NOFOLLOW, 0644);
+	if (fd == -1) {
+		log_error(libinput,
+			  "export: failed to open stats page %s\n", path);
+		return NULL;
+	}
+
+	if (ftruncate(fd, mapsize) == -1) {
+		log_error(libinput,
+			  "export: failed to size stats page %s\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, mapsize,
+		   PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	/* Readers keep the file open, we only need the mapping */
+	close(fd);
+	if (map == MAP_FAILED) {
+		log_error(libinput,
+			  "export: failed to map stats page %s\n", path);
+		return NULL;
+	}
+
+	page = zalloc(sizeof *page);
+	page->libinput = libinput;
+	page->header = map;
+	page->slots = (struct stats_page_slot *)(page->header + 1);
+	page->mapsize = mapsize;
+
+	/* Publish the magic last, same reasoning as the ring header */
+	memset(map, 0, mapsize);
+	page->header->version = STATS_PAGE_VERSION;
+	page->header->slot_size = sizeof(struct stats_page_slot);
+	page->header->nslots = STATS_PAGE_NSLOTS;
+	__atomic_store_n(&page->header->magic,
+			 STATS_PAGE_MAGIC,
+			 __ATOMIC_RELEASE);
+
+	log_debug(libinput, "export: stats page enabled at %s\n", path);
+
+	return page;
+}
+
+void
+libinput_stats_export_destroy(struct libinput_stats_page *page)
+{
+	if (!page)
+		return;
+
+	/* Invalidate the magic so lingering readers stop sampling */
+	__atomic_store_n(&page->header->magic, 0, __ATOMIC_RELEASE);
+	munmap(page->header, page->mapsize);
+	free(page);
+}
+
+struct stats_page_slot *
+libinput_stats_export_acquire_slot(struct libinput_stats_page *page,
+				   const char *sysname)
+{
+	if (!page)
+		return NULL;
+
+	for (size_t i = 0; i < STATS_PAGE_NSLOTS; i++) {
+		struct stats_page_slot *slot = &page->slots[i];
+
+		if (slot->sysname[0] != '\0')
+			continue;
+
+		slot->nevents = 0;
+		slot->nframes = 0;
+		slot->ndropped = 0;
+		/* The sysname marks the slot as taken, publish it after
+		 * the counter reset */
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		snprintf(slot->sysname, sizeof(slot->sysname), "%s", sysname);
+
+		return slot;
+	}
+
+	log_info(page->libinput,
+		 "export: out of stats page slots for %s\n", sysname);
+
+	return NULL;
+}
+
+void
+libinput_stats_export_release_slot(struct libinput_stats_page *page,
+				   struct stats_page_slot *slot)
+{
+	if (!page || !slot)
+		return;
+
+	memset(slot->sysname, 0, sizeof(slot->sysname));
+}
+
+struct libinput_audit_log {
+	struct libinput *libinput;
+	int fd;
+
+	/* Single producer (the dispatch thread), single consumer (the
+	 * writer thread). head/seq belong to the producer, tail to the
+	 * writer; a full ring drops rather than overwrites, so the writer
+	 * may copy records below head without the producer's help */
+	struct audit_record ring[AUDIT_RING_NRECORDS];
+	uint64_t head; /* records accepted into the ring */
+	uint64_t tail; /* records flushed to the file */
+	uint64_t seq; /* next sequence number, counts drops too */
+	uint64_t ndropped; /* drops since the last flushed block */
+
+	uint64_t prev_hash; /* chain state, writer thread only */
+
+	pthread_t writer;
+	pthread_mutex_t lock; /* serializes stop and the cond */
+	pthread_cond_t cond;
+	bool stop;
+};
+
+static uint64_t
+audit_hash(uint64_t hash, const void *data, size_t len)
+{
+	const uint8_t *byte = data;
+
+	/* FNV-1a, 64 bit */
+	while (len--)
+		hash = (hash ^ *byte++) * 0x100000001b3;
+
+	return hash;
+}
+
+static void
+audit_write(struct libinput_audit_log *audit, const void *data, size_t len)
+{
+	const char *buf = data;
+
+	while (len > 0) {
+		ssize_t n = write(audit->fd, buf, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			/* Nowhere to put the data; the chain in the file
+			 * stays valid up to the last complete block */
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+/* Writer thread context. Drains complete blocks, plus the final partial
+ * block when draining for shutdown */
+static void
+audit_flush(struct libinput_audit_log *audit, bool final)
+{
+	while (true) {
+		uint64_t head = __atomic_load_n(&audit->head,
+						__ATOMIC_ACQUIRE);
+		uint64_t tail = audit->tail;
+		uint32_t n = min(head - tail, AUDIT_BLOCK_NRECORDS);
+		struct audit_record block[AUDIT_BLOCK_NRECORDS];
+		struct audit_block_header header = {
+			.magic = AUDIT_LOG_MAGIC,
+			.version = AUDIT_LOG_VERSION,
+		};
+		uint64_t hash;
+
+		if (n == 0 || (n < AUDIT_BLOCK_NRECORDS && !final))
+			break;
+
+		for (uint32_t i = 0; i < n; i++)
+			block[i] = audit->ring[(tail + i) %
+					       AUDIT_RING_NRECORDS];
+
+		header.nrecords = n;
+		header.first_seq = block[0].seq;
+		header.ndropped = __atomic_exchange_n(&audit->ndropped, 0,
+						      __ATOMIC_RELAXED);
+		header.prev_hash = audit->prev_hash;
+
+		hash = audit_hash(0xcbf29ce484222325,
+				  &header.prev_hash,
+				  sizeof(header.prev_hash));
+		hash = audit_hash(hash, block, n * sizeof(block[0]));
+		header.hash = hash;
+
+		audit_write(audit, &header, sizeof(header));
+		audit_write(audit, block, n * sizeof(block[0]));
+
+		audit->prev_hash = hash;
+		/* Release: the producer checks tail to decide whether the
+		 * ring has room */
+		__atomic_store_n(&audit->tail, tail + n, __ATOMIC_RELEASE);
+	}
+}
+
+static void *
+audit_writer(void *data)
+{
+	struct libinput_audit_log *audit = data;
+
+	pthread_mutex_lock(&audit->lock);
+	while (!audit->stop) {
+		struct timespec ts;
+
+		/* Wake on a full block's worth of records or once a
+		 * second, whichever comes first, so a quiet seat still
+		 * hits the disk promptly */
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += 1;
+		pthread_cond_timedwait(&audit->cond, &audit->lock, &ts);
+
+		pthread_mutex_unlock(&audit->lock);
+		audit_flush(audit, false);
+		pthread_mutex_lock(&audit->lock);
+	}
+	pthread_mutex_unlock(&audit->lock);
+
+	/* final drain, including the trailing partial block */
+	audit_flush(audit, true);
+
+	return NULL;
+}
+
+bool
+libinput_audit_requested(void)
+{
+	const char *path = getenv("LIBINPUT_AUDIT_LOG");
+
+	return path && *path;
+}
+
+struct libinput_audit_log *
+libinput_audit_create(struct libinput *libinput)
+{
+	const char *path = getenv("LIBINPUT_AUDIT_LOG");
+	struct libinput_audit_log *audit;
+	int fd;
+
+	/* Append, not truncate: restarts continue the file, each run
+	 * starting a fresh hash chain. Restrictive mode, this is an
+	 * audit trail */
+	fd = open(path, O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC|O_NOFOLLOW, 0600);
+	if (fd == -1) {
+		log_error(libinput,
+			  "export: failed to open audit log %s\n", path);
+		return NULL;
+	}
+
+	audit = zalloc(sizeof *audit);
+	audit->libinput = libinput;
+	audit->fd = fd;
+	pthread_mutex_init(&audit->lock, NULL);
+	pthread_cond_init(&audit->cond, NULL);
+
+	if (pthread_create(&audit->writer, NULL, audit_writer, audit) != 0) {
+		log_error(libinput,
+			  "export: failed to start audit writer for %s\n",
+			  path);
+		pthread_cond_destroy(&audit->cond);
+		pthread_mutex_destroy(&audit->lock);
+		close(fd);
+		free(audit);
+		return NULL;
+	}
+
+	log_debug(libinput, "export: audit log enabled at %s\n", path);
+
+	return audit;
+}
+
+void
+libinput_audit_destroy(struct libinput_audit_log *audit)
+{
+	if (!audit)
+		return;
+
+	pthread_mutex_lock(&audit->lock);
+	audit->stop = true;
+	pthread_cond_signal(&audit->cond);
+	pthread_mutex_unlock(&audit->lock);
+	pthread_join(audit->writer, NULL);
+
+	close(audit->fd);
+	pthread_cond_destroy(&audit->cond);
+	pthread_mutex_destroy(&audit->lock);
+	free(audit);
+}
+
+void
+libinput_audit_post(struct libinput_audit_log *audit,
+		    struct libinput_event *event,
+		    uint64_t time)
+{
+	uint64_t head = audit->head;
+	uint64_t tail = __atomic_load_n(&audit->tail, __ATOMIC_ACQUIRE);
+	struct audit_record *r;
+
+	/* Writer can't keep up; drop, count, and let the sequence gap
+	 * plus the block header's ndropped tell the auditor */
+	if (head - tail == AUDIT_RING_NRECORDS) {
+		__atomic_fetch_add(&audit->ndropped, 1, __ATOMIC_RELAXED);
+		audit->seq++;
+		return;
+	}
+
+	r = &audit->ring[head % AUDIT_RING_NRECORDS];
+	r->seq = audit->seq++;
+	r->time = time;
+	r->type = event->type;
+	if (event->device)
+		snprintf(r->sysname, sizeof(r->sysname), "%s",
+			 libinput_device_get_sysname(event->device));
+	else
+		r->sysname[0] = '\0';
+
+	/* Release: the record must be visible before the writer sees the
+	 * new head */
+	__atomic_store_n(&audit->head, head + 1, __ATOMIC_RELEASE);
+
+	/* Wake the writer once per block's worth of records; it also
+	 * wakes on its own timeout */
+	if ((head + 1) % AUDIT_BLOCK_NRECORDS == 0)
+		pthread_cond_signal(&audit->cond);
+}
@@ -0,0 +1,388 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EVENT_EXPORT_H
+#define EVENT_EXPORT_H
+
+#include "config.h"
+
+#include <stdint.h>
+
+#include "libinput-private.h"
+
+/*
+ * Shared-memory event export for out-of-process consumers.
+ *
+ * When enabled (LIBINPUT_EXPORT_RING=<path>), the context mirrors a
+ * compact summary of every posted event into a memory-mapped ring that a
+ * sidecar process can map read-only. Single writer (this context), any
+ * number of readers, seqcount-style: the writer bumps the head counter
+ * with release semantics after filling a slot, readers consume with
+ * acquire loads and detect overruns by re-checking the head after
+ * copying a record out.
+ *
+ * The wire format below is a process-lifetime contract only, there are
+ * no cross-version stability guarantees.
+ */
+
+#define EXPORT_RING_MAGIC 0x4c494552 /* "LIER" */
+#define EXPORT_RING_VERSION 1
+#define EXPORT_RING_NRECORDS 1024 /* power of two */
+
+struct export_record {
+	uint64_t time; /* CLOCK_MONOTONIC in µs, time of posting */
+	uint32_t type; /* enum libinput_event_type */
+	char sysname[32]; /* originating device, empty for context events */
+};
+
+struct export_ring_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t nrecords;
+	/* Monotonically increasing count of records ever written; slot
+	   is head % nrecords */
+	uint64_t head;
+};
+
+struct libinput_export_ring;
+
+bool
+libinput_export_requested(void);
+
+struct libinput_export_ring *
+libinput_export_create(struct libinput *libinput);
+
+void
+libinput_export_destroy(struct libinput_export_ring *ring);
+
+void
+libinput_export_post(struct libinput_export_ring *ring,
+		     struct libinput_event *event,
+		     uint64_t time);
+
+/*
+ * Reader-side cursor over the export ring, for consumers that map the
+ * ring file. Each consumer owns one cursor - its private analog of the
+ * context's events_out index - while the producer only ever advances
+ * head, so any number of readers (compositor, gesture daemon,
+ * analytics) share one ring at zero additional per-event cost in the
+ * producer.
+ *
+ * A record at sequence number s lives in slot s % nrecords and is
+ * overwritten when the writer reaches s + nrecords; a reader that falls
+ * further behind has been lapped. Lapped records are skipped, counted
+ * in noverruns, and the cursor resumes at the oldest record still
+ * intact. A copy is re-validated against head afterwards so a record
+ * torn by the writer mid-copy is never returned.
+ *
+ * Header-only on purpose: sidecar processes use this against their own
+ * read-only mapping without linking against libinput.
+ */
+struct export_ring_reader {
+	const struct export_ring_header *header;
+	const struct export_record *records;
+	uint64_t tail; /* sequence number of the next record to read */
+	uint64_t noverruns; /* records lost to being lapped */
+};
+
+/* The cursor starts at the live edge: a new consumer sees events posted
+ * after it attached, not the ring's backlog */
+static inline void
+export_ring_reader_init(struct export_ring_reader *reader, const void *map)
+{
+	const struct export_ring_header *header = map;
+
+	reader->header = header;
+	reader->records = (const struct export_record *)
+		((const char *)map + sizeof(*header));
+	reader->tail = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+	reader->noverruns = 0;
+}
+
+/* Copy the next record into record_out. Returns false when the ring is
+ * drained, invalid or the producer has shut down. */
+static inline bool
+export_ring_reader_read(struct export_ring_reader *reader,
+			struct export_record *record_out)
+{
+	const struct export_ring_header *header = reader->header;
+	uint32_t nrecords = header->nrecords;
+	uint64_t head;
+
+	if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) !=
+	    EXPORT_RING_MAGIC)
+		return false;
+
+	head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		if (reader->tail == head)
+			return false;
+
+		/* lapped while idle, resume at the oldest intact record */
+		if (head - reader->tail > nrecords) {
+			reader->noverruns += head - nrecords - reader->tail;
+			reader->tail = head - nrecords;
+		}
+
+		*record_out = reader->records[reader->tail % nrecords];
+
+		/* pairs with the writer's release on head: if the writer
+		 * has not reached this slot again, the copy is whole */
+		head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+		if (head - reader->tail <= nrecords)
+			break;
+		/* lapped mid-copy, the record may be torn - retry */
+	}
+
+	reader->tail++;
+	return true;
+}
+
+/*
+ * Shared-memory position page for absolute devices.
+ *
+ * When enabled (LIBINPUT_POSITION_PAGE=<path>), the context writes the
+ * latest transformed absolute position into a single memory-mapped page
+ * so a compositor's cursor plane can sample it at scanout time instead
+ * of waiting for the event to travel through the queue. Events still
+ * flow normally, the page is a low-latency mirror, not a replacement.
+ *
+ * Single writer (this context), seqlock semantics: the writer bumps seq
+ * to an odd value before updating the payload and to the next even
+ * value after. Readers copy the payload between two acquire loads of
+ * seq and retry if the values differ or are odd.
+ *
+ * Like the export ring, the layout is a process-lifetime contract only.
+ */
+
+#define POSITION_PAGE_MAGIC 0x4c495050 /* "LIPP" */
+#define POSITION_PAGE_VERSION 1
+
+struct position_record {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seq; /* odd while the writer is mid-update */
+	uint32_t _pad;
+	uint64_t time; /* CLOCK_MONOTONIC in µs, time of the update */
+	/* Calibrated position, normalized to [0, 1] of the device's
+	   axis ranges */
+	double x, y;
+	char sysname[32]; /* device that last reported a position */
+};
+
+struct libinput_position_page;
+
+bool
+libinput_position_export_requested(void);
+
+struct libinput_position_page *
+libinput_position_export_create(struct libinput *libinput);
+
+void
+libinput_position_export_destroy(struct libinput_position_page *page);
+
+void
+libinput_position_export_post(struct libinput_position_page *page,
+			      struct libinput_device *device,
+			      uint64_t time,
+			      double x,
+			      double y);
+
+/*
+ * Shared-memory touch journal for crash-consistent gesture state.
+ *
+ * When enabled (LIBINPUT_TOUCH_JOURNAL=<path>), the touchpad dispatch
+ * mirrors its active touches and gesture state into a memory-mapped
+ * page once per event frame. After a compositor crash mid-gesture, the
+ * restarting instance (or its session manager) can read the journal to
+ * learn what was in progress - which fingers were down, where, and what
+ * the gesture engine had recognized - instead of forcing the user to
+ * lift all fingers and start over.
+ *
+ * Same single-writer seqlock semantics as the position page, and like
+ * the other exports the layout is a process-lifetime contract only.
+ */
+
+#define TOUCH_JOURNAL_MAGIC 0x4c49544a /* "LITJ" */
+#define TOUCH_JOURNAL_VERSION 1
+#define TOUCH_JOURNAL_MAX_TOUCHES 16
+
+struct touch_journal_touch {
+	uint32_t state; /* enum touch_state */
+	uint32_t palm; /* nonzero if dismissed as a palm */
+	int32_t x, y; /* device coordinates */
+};
+
+struct touch_journal_record {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seq; /* odd while the writer is mid-update */
+	uint32_t gesture_state; /* enum tp_gesture_state */
+	uint64_t time; /* CLOCK_MONOTONIC in µs, time of the frame */
+	uint32_t finger_count;
+	uint32_t ntouches;
+	struct touch_journal_touch touches[TOUCH_JOURNAL_MAX_TOUCHES];
+	char sysname[32]; /* device that wrote the last frame */
+};
+
+struct libinput_touch_journal;
+
+bool
+libinput_touch_journal_requested(void);
+
+struct libinput_touch_journal *
+libinput_touch_journal_create(struct libinput *libinput);
+
+void
+libinput_touch_journal_destroy(struct libinput_touch_journal *journal);
+
+void
+libinput_touch_journal_post(struct libinput_touch_journal *journal,
+			    struct libinput_device *device,
+			    uint64_t time,
+			    uint32_t gesture_state,
+			    uint32_t finger_count,
+			    const struct touch_journal_touch *touches,
+			    size_t ntouches);
+
+/*
+ * Shared-memory per-device event statistics.
+ *
+ * When enabled (LIBINPUT_STATS_PAGE=<path>), every device claims a slot
+ * in a memory-mapped table and the dispatch path keeps the slot's
+ * counters current, so a metrics scraper can sample input health
+ * without consuming the event stream or attaching to the context.
+ *
+ * Counters are monotonically increasing and written without locking: a
+ * reader may see a slot mid-update, but since each counter only ever
+ * grows the sampled rates stay meaningful. A slot with an empty sysname
+ * is unused; slots are recycled when devices come and go, so readers
+ * should key their series on the sysname, not the slot index.
+ *
+ * Like the other exports the layout is a process-lifetime contract only.
+ */
+
+#define STATS_PAGE_MAGIC 0x4c495354 /* "LIST" */
+#define STATS_PAGE_VERSION 2
+#define STATS_PAGE_NSLOTS 64
+
+struct stats_page_slot {
+	char sysname[32]; /* empty while the slot is unused */
+	uint64_t nevents; /* input events dispatched */
+	uint64_t nframes; /* SYN_REPORT frames dispatched */
+	uint64_t ndropped; /* SYN_DROPPED episodes */
+	/* a gauge, not a counter: touchpads report the motion history
+	 * depth currently in use, 0 for other devices */
+	uint64_t history_depth;
+};
+
+struct stats_page_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slot_size;
+	uint32_t nslots;
+};
+
+struct libinput_stats_page;
+
+bool
+libinput_stats_export_requested(void);
+
+struct libinput_stats_page *
+libinput_stats_export_create(struct libinput *libinput);
+
+void
+libinput_stats_export_destroy(struct libinput_stats_page *page);
+
+struct stats_page_slot *
+libinput_stats_export_acquire_slot(struct libinput_stats_page *page,
+				   const char *sysname);
+
+void
+libinput_stats_export_release_slot(struct libinput_stats_page *page,
+				   struct stats_page_slot *slot);
+
+/*
+ * Append-only audit trail of the event stream.
+ *
+ * When enabled (LIBINPUT_AUDIT_LOG=<path>), every event handed to
+ * libinput_post_event() is sequence-numbered and copied into a bounded
+ * in-memory ring; a background writer thread drains the ring to the log
+ * file in fixed-size blocks so the dispatch path pays one copy, never a
+ * write(). Each block header carries a hash chained over the previous
+ * block's hash and the block's records, so editing, reordering or
+ * truncating the log breaks the chain from that point on -
+ * tamper-evident, not tamper-proof.
+ *
+ * Sequence numbers are assigned to every posted event, including those
+ * the ring had no room for: a gap in the record sequence is always
+ * matched by the ndropped count in the next block header, anything else
+ * means the log was doctored. The file is opened for append and each
+ * process run starts a fresh chain (first block has prev_hash 0).
+ *
+ * Unlike the memory-mapped exports above, this is an on-disk format
+ * meant to be read after the fact, hence the version field per block.
+ */
+
+#define AUDIT_LOG_MAGIC 0x4c494154 /* "LIAT" */
+#define AUDIT_LOG_VERSION 1
+#define AUDIT_BLOCK_NRECORDS 64
+#define AUDIT_RING_NRECORDS 1024 /* power of two */
+
+struct audit_record {
+	uint64_t seq;
+	uint64_t time; /* CLOCK_MONOTONIC in µs, time of posting */
+	uint32_t type; /* enum libinput_event_type */
+	char sysname[32]; /* originating device, empty for context events */
+};
+
+struct audit_block_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nrecords; /* records following this header */
+	uint32_t _pad;
+	uint64_t first_seq;
+	uint64_t ndropped; /* records lost to ring overflow before this block */
+	uint64_t prev_hash; /* 0 in the first block of a run */
+	uint64_t hash; /* FNV-1a over prev_hash, then the records */
+};
+
+struct libinput_audit_log;
+
+bool
+libinput_audit_requested(void);
+
+struct libinput_audit_log *
+libinput_audit_create(struct libinput *libinput);
+
+void
+libinput_audit_destroy(struct libinput_audit_log *audit);
+
+void
+libinput_audit_post(struct libinput_audit_log *audit,
+		    struct libinput_event *event,
+		    uint64_t time);
+
+#endif /* EVENT_EXPORT_H */
@@ -41,7 +41,7 @@ struct pointer_accelerator_flat {
 	int dpi;
 };
 
-static struct normalized_coords
+struct normalized_coords
 accelerator_filter_flat(struct motion_filter *filter,
 			const struct device_float_coords *unaccelerated,
 			void *data, uint64_t time)
@@ -125,7 +125,7 @@ accelerator_filter_generic(struct motion_filter *filter,
 	return accelerated;
 }
 
-static struct normalized_coords
+struct normalized_coords
 accelerator_filter_pre_normalized(struct motion_filter *filter,
 				  const struct device_float_coords *unaccelerated,
 				  void *data, uint64_t time)
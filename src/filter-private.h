@@ -44,6 +44,10 @@ struct motion_filter_interface {
 	void (*destroy)(struct motion_filter *filter);
 	bool (*set_speed)(struct motion_filter *filter,
 			  double speed_adjustment);
+	/* optional: the device's measured report interval in µs, for
+	 * filters that otherwise assume a fixed rate */
+	void (*set_frame_interval)(struct motion_filter *filter,
+				   uint64_t interval);
 };
 
 struct motion_filter {
@@ -51,12 +55,6 @@ struct motion_filter {
 	struct motion_filter_interface *interface;
 };
 
-struct pointer_tracker {
-	struct device_float_coords delta; /* delta to most recent event */
-	uint64_t time;  /* us */
-	uint32_t dir;
-};
-
 /* For smoothing timestamps from devices with unreliable timing */
 struct pointer_delta_smoothener {
 	uint64_t threshold;
@@ -64,13 +62,38 @@ struct pointer_delta_smoothener {
 };
 
 struct pointer_trackers {
-	struct pointer_tracker *trackers;
+	/* Tracker history as parallel arrays, so the per-event delta
+	 * accumulation in trackers_feed() runs over contiguous doubles
+	 * and vectorizes */
+	double *deltas_x; /* accumulated delta to most recent event */
+	double *deltas_y;
+	uint64_t *times;  /* us */
+	uint32_t *dirs;
 	size_t ntrackers;
 	unsigned int cur_tracker;
 
 	struct pointer_delta_smoothener *smoothener;
 };
 
+/* The interfaces and per-event filter funcs of the common filters,
+ * exposed for the devirtualized fast path in filter_dispatch() */
+extern struct motion_filter_interface accelerator_interface;
+extern struct motion_filter_interface accelerator_interface_touchpad;
+extern struct motion_filter_interface accelerator_interface_flat;
+
+struct normalized_coords
+accelerator_filter_pre_normalized(struct motion_filter *filter,
+				  const struct device_float_coords *unaccelerated,
+				  void *data, uint64_t time);
+struct normalized_coords
+accelerator_filter_post_normalized(struct motion_filter *filter,
+				   const struct device_float_coords *unaccelerated,
+				   void *data, uint64_t time);
+struct normalized_coords
+accelerator_filter_flat(struct motion_filter *filter,
+			const struct device_float_coords *unaccelerated,
+			void *data, uint64_t time);
+
 void trackers_init(struct pointer_trackers *trackers, int ntrackers);
 void trackers_free(struct pointer_trackers *trackers);
 
@@ -82,8 +105,9 @@ trackers_feed(struct pointer_trackers *trackers,
 	      const struct device_float_coords *delta,
 	      uint64_t time);
 
-struct pointer_tracker *
-trackers_by_offset(struct pointer_trackers *trackers, unsigned int offset);
+unsigned int
+trackers_index_by_offset(struct pointer_trackers *trackers,
+			 unsigned int offset);
 
 double
 trackers_velocity(struct pointer_trackers *trackers, uint64_t time);
@@ -40,6 +40,12 @@
  */
 #define TP_MAGIC_SLOWDOWN 0.2968 /* unitless factor */
 
+/* Number of entries in the precomputed speed-to-factor curve. The curve is
+ * piecewise linear-ish, 256 points over the covered speed range keep the
+ * interpolation error well below anything a user could perceive.
+ */
+#define TP_ACCEL_NCURVE_POINTS 256
+
 struct touchpad_accelerator {
 	struct motion_filter base;
 
@@ -56,8 +62,19 @@ struct touchpad_accelerator {
 	int dpi;
 
 	double speed_factor;    /* factor based on speed setting */
+
+	/* Precomputed profile curve, rebuilt on speed changes. Covers
+	 * [0, curve.max_speed) in mm/s; the profile is constant above
+	 * that (upper plateau). */
+	struct {
+		double factors[TP_ACCEL_NCURVE_POINTS];
+		double max_speed; /* mm/s */
+	} curve;
 };
 
+static void
+touchpad_accelerator_rebuild_curve(struct touchpad_accelerator *accel_filter);
+
 /**
  * Calculate the acceleration factor for the given delta with the timestamp.
  *
@@ -123,7 +140,7 @@ accelerator_filter_generic(struct motion_filter *filter,
 	return accelerated;
 }
 
-static struct normalized_coords
+struct normalized_coords
 accelerator_filter_post_normalized(struct motion_filter *filter,
 				   const struct device_float_coords *unaccelerated,
 				   void *data, uint64_t time)
@@ -175,6 +192,7 @@ touchpad_accelerator_set_speed(struct motion_filter *filter,
 
 	filter->speed_adjustment = speed_adjustment;
 	accel_filter->speed_factor = speed_factor(speed_adjustment);
+	touchpad_accelerator_rebuild_curve(accel_filter);
 
 	return true;
 }
@@ -225,21 +243,14 @@ touchpad_accelerator_destroy(struct motion_filter *filter)
 	free(accel);
 }
 
-double
-touchpad_accel_profile_linear(struct motion_filter *filter,
-			      void *data,
-			      double speed_in, /* in device units/µs */
-			      uint64_t time)
+static double
+touchpad_accel_factor(struct touchpad_accelerator *accel_filter,
+		      double speed_in) /* in mm/s */
 {
-	struct touchpad_accelerator *accel_filter =
-		(struct touchpad_accelerator *)filter;
 	const double threshold = accel_filter->threshold; /* mm/s */
 	const double baseline = 0.9;
 	double factor; /* unitless */
 
-	/* Convert to mm/s because that's something one can understand */
-	speed_in = v_us2s(speed_in) * 25.4/accel_filter->dpi;
-
 	/*
 	   Our acceleration function calculates a factor to accelerate input
 	   deltas with. The function is a double incline with a plateau,
@@ -313,6 +324,55 @@ touchpad_accel_profile_linear(struct motion_filter *filter,
 	return factor * TP_MAGIC_SLOWDOWN;
 }
 
+/* Sample the profile curve into the lookup table. Called whenever an input
+ * to the curve (the speed setting) changes, not per event.
+ */
+static void
+touchpad_accelerator_rebuild_curve(struct touchpad_accelerator *accel_filter)
+{
+	/* The profile is on its upper plateau above four times the
+	 * threshold, no point sampling beyond that */
+	const double max_speed = accel_filter->threshold * 4.0; /* mm/s */
+	int i;
+
+	accel_filter->curve.max_speed = max_speed;
+	for (i = 0; i < TP_ACCEL_NCURVE_POINTS; i++) {
+		double speed = max_speed * i / (TP_ACCEL_NCURVE_POINTS - 1);
+
+		accel_filter->curve.factors[i] =
+			touchpad_accel_factor(accel_filter, speed);
+	}
+}
+
+double
+touchpad_accel_profile_linear(struct motion_filter *filter,
+			      void *data,
+			      double speed_in, /* in device units/µs */
+			      uint64_t time)
+{
+	struct touchpad_accelerator *accel_filter =
+		(struct touchpad_accelerator *)filter;
+	double pos;
+	int idx;
+
+	/* Convert to mm/s because that's something one can understand */
+	speed_in = v_us2s(speed_in) * 25.4/accel_filter->dpi;
+
+	/* Table lookup with linear interpolation; this runs multiple
+	 * times per delta (Simpson's rule), the full curve math only
+	 * runs when the table is rebuilt */
+	if (speed_in >= accel_filter->curve.max_speed)
+		return accel_filter->curve.factors[TP_ACCEL_NCURVE_POINTS - 1];
+
+	pos = speed_in/accel_filter->curve.max_speed *
+		(TP_ACCEL_NCURVE_POINTS - 1);
+	idx = (int)pos;
+	pos -= idx;
+
+	return accel_filter->curve.factors[idx] * (1.0 - pos) +
+	       accel_filter->curve.factors[idx + 1] * pos;
+}
+
 struct motion_filter_interface accelerator_interface_touchpad = {
 	.type = LIBINPUT_CONFIG_ACCEL_PROFILE_ADAPTIVE,
 	.filter = accelerator_filter_post_normalized,
@@ -341,6 +401,7 @@ create_pointer_accelerator_filter_touchpad(int dpi,
 
 	filter->base.interface = &accelerator_interface_touchpad;
 	filter->profile = touchpad_accel_profile_linear;
+	touchpad_accelerator_rebuild_curve(filter);
 
 	smoothener = zalloc(sizeof(*smoothener));
 	smoothener->threshold = event_delta_smooth_threshold,
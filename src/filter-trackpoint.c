@@ -35,6 +35,13 @@
 #include "libinput-util.h"
 #include "filter-private.h"
 
+/* Curve constants, see trackpoint_accel_profile() */
+#define TP_PROFILE_MAX 10.06254
+#define TP_PROFILE_MIN 0.3
+#define TP_PROFILE_EXPONENT 1.15363
+/* 1/0.9205459 with the units/µs → units/ms conversion folded in */
+#define TP_PROFILE_INV_VHALF (1000.0/0.9205459)
+
 struct trackpoint_accelerator {
 	struct motion_filter base;
 
@@ -42,6 +49,11 @@ struct trackpoint_accelerator {
 	double speed_factor;
 
 	double multiplier;
+
+	/* profile curve constants with speed_factor folded in,
+	 * recomputed in set_speed() */
+	double profile_offset;
+	double profile_scale;
 };
 
 double
@@ -52,22 +64,23 @@ trackpoint_accel_profile(struct motion_filter *filter,
 {
 	struct trackpoint_accelerator *accel_filter =
 		(struct trackpoint_accelerator *)filter;
-	double factor;
-
-	velocity = v_us2ms(velocity); /* make it units/ms */
 
 	/* Just a nice-enough curve that provides fluid factor conversion
 	 * from the minimum speed up to the real maximum. Generated by
-	 * https://www.mycurvefit.com/ with input data
+	 * https://www.mycurvefit.com/ with input data (in units/ms)
 	 * 0    0.3
 	 * 0.1  1
 	 * 0.4  3
 	 * 0.6  4
+	 * i.e. 10.06254 + (0.3 - 10.06254)/(1 + pow(v/0.9205459, 1.15363)),
+	 * all times the speed factor. The divisors, the ms conversion and
+	 * the speed factor are folded into constants at set_speed() time;
+	 * per delta only the pow() and one division remain.
 	 */
-	factor = 10.06254 + (0.3 - 10.06254)/(1 + pow(velocity/0.9205459, 1.15363));
-
-	factor *= accel_filter->speed_factor;
-	return factor;
+	return accel_filter->profile_offset +
+	       accel_filter->profile_scale /
+	       (1 + pow(velocity * TP_PROFILE_INV_VHALF,
+			TP_PROFILE_EXPONENT));
 }
 
 static struct normalized_coords
@@ -145,11 +158,29 @@ trackpoint_accelerator_set_speed(struct motion_filter *filter,
 
 	filter->speed_adjustment = speed_adjustment;
 	accel_filter->speed_factor = speed_factor(speed_adjustment);
-
+	accel_filter->profile_offset =
+		TP_PROFILE_MAX * accel_filter->speed_factor;
+	accel_filter->profile_scale =
+		(TP_PROFILE_MIN - TP_PROFILE_MAX) * accel_filter->speed_factor;
 
 	return true;
 }
 
+static void
+trackpoint_accelerator_set_frame_interval(struct motion_filter *filter,
+					  uint64_t interval)
+{
+	struct trackpoint_accelerator *accel_filter =
+		(struct trackpoint_accelerator*)filter;
+	struct pointer_delta_smoothener *smoothener =
+		accel_filter->trackers.smoothener;
+
+	/* The smoothener defaults assume a 100Hz trackpoint; once the
+	 * actual report cadence is measured, smooth to that instead */
+	smoothener->threshold = interval;
+	smoothener->value = interval;
+}
+
 static void
 trackpoint_accelerator_restart(struct motion_filter *filter,
 			       void *data,
@@ -178,6 +209,7 @@ struct motion_filter_interface accelerator_interface_trackpoint = {
 	.restart = trackpoint_accelerator_restart,
 	.destroy = trackpoint_accelerator_destroy,
 	.set_speed = trackpoint_accelerator_set_speed,
+	.set_frame_interval = trackpoint_accelerator_set_frame_interval,
 };
 
 struct motion_filter *
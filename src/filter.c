@@ -32,6 +32,7 @@
 #include <math.h>
 
 #include "filter.h"
+#include "libinput-trace.h"
 #include "libinput-util.h"
 #include "filter-private.h"
 
@@ -42,6 +43,24 @@ filter_dispatch(struct motion_filter *filter,
 		const struct device_float_coords *unaccelerated,
 		void *data, uint64_t time)
 {
+	trace_filter_applied(filter, time);
+
+	/* The interface never changes after creation, so devirtualize
+	 * the common filters into direct calls. Only the indirect branch
+	 * below mispredicts on hosts mixing device types. */
+	if (filter->interface == &accelerator_interface)
+		return accelerator_filter_pre_normalized(filter,
+							 unaccelerated,
+							 data, time);
+	if (filter->interface == &accelerator_interface_touchpad)
+		return accelerator_filter_post_normalized(filter,
+							  unaccelerated,
+							  data, time);
+	if (filter->interface == &accelerator_interface_flat)
+		return accelerator_filter_flat(filter,
+					       unaccelerated,
+					       data, time);
+
 	return filter->interface->filter(filter, unaccelerated, data, time);
 }
 
@@ -61,6 +80,14 @@ filter_restart(struct motion_filter *filter,
 		filter->interface->restart(filter, data, time);
 }
 
+void
+filter_set_frame_interval(struct motion_filter *filter,
+			  uint64_t interval)
+{
+	if (filter && filter->interface->set_frame_interval)
+		filter->interface->set_frame_interval(filter, interval);
+}
+
 void
 filter_destroy(struct motion_filter *filter)
 {
@@ -92,8 +119,14 @@ filter_get_type(struct motion_filter *filter)
 void
 trackers_init(struct pointer_trackers *trackers, int ntrackers)
 {
-	trackers->trackers = zalloc(ntrackers *
-				    sizeof(*trackers->trackers));
+	trackers->deltas_x = zalloc(ntrackers *
+				    sizeof(*trackers->deltas_x));
+	trackers->deltas_y = zalloc(ntrackers *
+				    sizeof(*trackers->deltas_y));
+	trackers->times = zalloc(ntrackers *
+				 sizeof(*trackers->times));
+	trackers->dirs = zalloc(ntrackers *
+				sizeof(*trackers->dirs));
 	trackers->ntrackers = ntrackers;
 	trackers->cur_tracker = 0;
 	trackers->smoothener = NULL;
@@ -102,7 +135,10 @@ trackers_init(struct pointer_trackers *trackers, int ntrackers)
 void
 trackers_free(struct pointer_trackers *trackers)
 {
-	free(trackers->trackers);
+	free(trackers->deltas_x);
+	free(trackers->deltas_y);
+	free(trackers->times);
+	free(trackers->dirs);
 	free(trackers->smoothener);
 }
 
@@ -111,19 +147,19 @@ trackers_reset(struct pointer_trackers *trackers,
 	       uint64_t time)
 {
 	unsigned int offset;
-	struct pointer_tracker *tracker;
+	unsigned int index;
 
 	for (offset = 1; offset < trackers->ntrackers; offset++) {
-		tracker = trackers_by_offset(trackers, offset);
-		tracker->time = 0;
-		tracker->dir = 0;
-		tracker->delta.x = 0;
-		tracker->delta.y = 0;
+		index = trackers_index_by_offset(trackers, offset);
+		trackers->times[index] = 0;
+		trackers->dirs[index] = 0;
+		trackers->deltas_x[index] = 0;
+		trackers->deltas_y[index] = 0;
 	}
 
-	tracker = trackers_by_offset(trackers, 0);
-	tracker->time = time;
-	tracker->dir = UNDEFINED_DIRECTION;
+	index = trackers_index_by_offset(trackers, 0);
+	trackers->times[index] = time;
+	trackers->dirs[index] = UNDEFINED_DIRECTION;
 }
 
 void
@@ -132,50 +168,51 @@ trackers_feed(struct pointer_trackers *trackers,
 	      uint64_t time)
 {
 	unsigned int i, current;
-	struct pointer_tracker *ts = trackers->trackers;
+	double *dx = trackers->deltas_x;
+	double *dy = trackers->deltas_y;
 
 	assert(trackers->ntrackers);
 
 	for (i = 0; i < trackers->ntrackers; i++) {
-		ts[i].delta.x += delta->x;
-		ts[i].delta.y += delta->y;
+		dx[i] += delta->x;
+		dy[i] += delta->y;
 	}
 
 	current = (trackers->cur_tracker + 1) % trackers->ntrackers;
 	trackers->cur_tracker = current;
 
-	ts[current].delta.x = 0.0;
-	ts[current].delta.y = 0.0;
-	ts[current].time = time;
-	ts[current].dir = device_float_get_direction(*delta);
+	dx[current] = 0.0;
+	dy[current] = 0.0;
+	trackers->times[current] = time;
+	trackers->dirs[current] = device_float_get_direction(*delta);
 }
 
-struct pointer_tracker *
-trackers_by_offset(struct pointer_trackers *trackers, unsigned int offset)
+unsigned int
+trackers_index_by_offset(struct pointer_trackers *trackers,
+			 unsigned int offset)
 {
-	unsigned int index =
-		(trackers->cur_tracker + trackers->ntrackers - offset)
+	return (trackers->cur_tracker + trackers->ntrackers - offset)
 		% trackers->ntrackers;
-	return &trackers->trackers[index];
 }
 
 static double
-calculate_trackers_velocity(struct pointer_tracker *tracker,
-			   uint64_t time,
-			   struct pointer_delta_smoothener *smoothener)
+calculate_trackers_velocity(struct pointer_trackers *trackers,
+			   unsigned int index,
+			   uint64_t time)
 {
-	uint64_t tdelta = time - tracker->time + 1;
+	struct pointer_delta_smoothener *smoothener = trackers->smoothener;
+	uint64_t tdelta = time - trackers->times[index] + 1;
 
 	if (smoothener && tdelta < smoothener->threshold)
 		tdelta = smoothener->value;
 
-	return hypot(tracker->delta.x, tracker->delta.y) /
+	return hypot(trackers->deltas_x[index], trackers->deltas_y[index]) /
 	       (double)tdelta; /* units/us */
 }
 
 static double
-trackers_velocity_after_timeout(struct pointer_tracker *tracker,
-				 struct pointer_delta_smoothener *smoothener)
+trackers_velocity_after_timeout(struct pointer_trackers *trackers,
+				unsigned int index)
 {
 	/* First movement after timeout needs special handling.
 	 *
@@ -188,9 +225,10 @@ trackers_velocity_after_timeout(struct pointer_tracker *tracker,
 	 * for really slow movements but provides much more useful initial
 	 * movement in normal use-cases (pause, move, pause, move)
 	 */
-	return calculate_trackers_velocity(tracker,
-					  tracker->time + MOTION_TIMEOUT,
-					  smoothener);
+	return calculate_trackers_velocity(trackers,
+					   index,
+					   trackers->times[index] +
+						MOTION_TIMEOUT);
 }
 
 /**
@@ -204,39 +242,40 @@ double
 trackers_velocity(struct pointer_trackers *trackers, uint64_t time)
 {
 	const double MAX_VELOCITY_DIFF = v_ms2us(1); /* units/us */
-	struct pointer_tracker *tracker;
+	unsigned int index;
 	double velocity;
 	double result = 0.0;
 	double initial_velocity = 0.0;
 	double velocity_diff;
 	unsigned int offset;
 
-	unsigned int dir = trackers_by_offset(trackers, 0)->dir;
+	unsigned int dir =
+		trackers->dirs[trackers_index_by_offset(trackers, 0)];
 
 	/* Find least recent vector within a timelimit, maximum velocity diff
 	 * and direction threshold. */
 	for (offset = 1; offset < trackers->ntrackers; offset++) {
-		tracker = trackers_by_offset(trackers, offset);
+		index = trackers_index_by_offset(trackers, offset);
 
 		/* Bug: time running backwards */
-		if (tracker->time > time)
+		if (trackers->times[index] > time)
 			break;
 
 		/* Stop if too far away in time */
-		if (time - tracker->time > MOTION_TIMEOUT) {
+		if (time - trackers->times[index] > MOTION_TIMEOUT) {
 			if (offset == 1)
 				result = trackers_velocity_after_timeout(
-							  tracker,
-							  trackers->smoothener);
+							  trackers,
+							  index);
 			break;
 		}
 
-		velocity = calculate_trackers_velocity(tracker,
-						      time,
-						      trackers->smoothener);
+		velocity = calculate_trackers_velocity(trackers,
+						      index,
+						      time);
 
 		/* Stop if direction changed */
-		dir &= tracker->dir;
+		dir &= trackers->dirs[index];
 		if (dir == 0) {
 			/* First movement after dirchange - velocity is that
 			 * of the last movement */
@@ -86,6 +86,15 @@ void
 filter_restart(struct motion_filter *filter,
 	       void *data, uint64_t time);
 
+/**
+ * Tell the filter the device's measured report interval in µs, replacing
+ * whatever rate the filter assumed at creation time. A no-op for filters
+ * without rate assumptions. Safe to call on a NULL filter.
+ */
+void
+filter_set_frame_interval(struct motion_filter *filter,
+			  uint64_t interval);
+
 void
 filter_destroy(struct motion_filter *filter);
 
@@ -73,3 +73,91 @@ libinput_device_config_gesture_get_hold_default_enabled(struct libinput_device *
 
 	return device->config.gesture->get_hold_default(device);
 }
+
+int
+libinput_device_config_gesture_scroll_batching_is_available(struct libinput_device *device)
+{
+	if (!libinput_device_has_capability(device,
+					    LIBINPUT_DEVICE_CAP_GESTURE))
+		return 0;
+
+	return device->config.gesture->set_scroll_batch_window != NULL;
+}
+
+enum libinput_config_status
+libinput_device_config_gesture_set_scroll_batch_window(struct libinput_device *device,
+						       uint32_t window_ms)
+{
+	if (window_ms > LIBINPUT_GESTURE_SCROLL_BATCH_WINDOW_MAX)
+		return LIBINPUT_CONFIG_STATUS_INVALID;
+
+	if (!libinput_device_config_gesture_scroll_batching_is_available(device)) {
+		return window_ms ? LIBINPUT_CONFIG_STATUS_UNSUPPORTED :
+				   LIBINPUT_CONFIG_STATUS_SUCCESS;
+	}
+
+	return device->config.gesture->set_scroll_batch_window(device,
+							       window_ms);
+}
+
+uint32_t
+libinput_device_config_gesture_get_scroll_batch_window(struct libinput_device *device)
+{
+	if (!libinput_device_config_gesture_scroll_batching_is_available(device))
+		return 0;
+
+	return device->config.gesture->get_scroll_batch_window(device);
+}
+
+uint32_t
+libinput_device_config_gesture_get_scroll_batch_window_default(struct libinput_device *device)
+{
+	if (!libinput_device_config_gesture_scroll_batching_is_available(device))
+		return 0;
+
+	return device->config.gesture->get_scroll_batch_window_default(device);
+}
+
+int
+libinput_device_config_gesture_3fg_drag_is_available(struct libinput_device *device)
+{
+	if (!libinput_device_has_capability(device,
+					    LIBINPUT_DEVICE_CAP_GESTURE))
+		return 0;
+
+	return device->config.gesture->set_3fg_drag_enabled != NULL;
+}
+
+enum libinput_config_status
+libinput_device_config_gesture_set_3fg_drag_enabled(struct libinput_device *device,
+						    enum libinput_config_3fg_drag_state enabled)
+{
+	if (enabled != LIBINPUT_CONFIG_3FG_DRAG_ENABLED &&
+	    enabled != LIBINPUT_CONFIG_3FG_DRAG_DISABLED)
+		return LIBINPUT_CONFIG_STATUS_INVALID;
+
+	if (!libinput_device_config_gesture_3fg_drag_is_available(device)) {
+		return enabled ? LIBINPUT_CONFIG_STATUS_UNSUPPORTED :
+				 LIBINPUT_CONFIG_STATUS_SUCCESS;
+	}
+
+	return device->config.gesture->set_3fg_drag_enabled(device, enabled);
+}
+
+enum libinput_config_3fg_drag_state
+libinput_device_config_gesture_get_3fg_drag_enabled(struct libinput_device *device)
+{
+	if (!libinput_device_config_gesture_3fg_drag_is_available(device))
+		return LIBINPUT_CONFIG_3FG_DRAG_DISABLED;
+
+	return device->config.gesture->get_3fg_drag_enabled(device);
+}
+
+enum libinput_config_3fg_drag_state
+libinput_device_config_gesture_get_3fg_drag_default_enabled(struct libinput_device *device)
+{
+	if (!libinput_device_config_gesture_3fg_drag_is_available(device))
+		return LIBINPUT_CONFIG_3FG_DRAG_DISABLED;
+
+	return device->config.gesture->get_3fg_drag_default(device);
+}
@@ -108,4 +108,162 @@ libinput_device_config_gesture_get_hold_enabled(struct libinput_device *device);
 enum libinput_config_hold_state
 libinput_device_config_gesture_get_hold_default_enabled(struct libinput_device *device);
 
+/**
+ * The largest permitted scroll batch window, in milliseconds. Anything
+ * beyond this turns interactive scrolling noticeably chunky.
+ */
+#define LIBINPUT_GESTURE_SCROLL_BATCH_WINDOW_MAX 100
+
+/**
+ * @ingroup config
+ *
+ * Check whether a device supports batching of two-finger scroll events.
+ *
+ * @param device The device to configure
+ * @return Non-zero if a device supports scroll batching, zero otherwise.
+ *
+ * @see libinput_device_config_gesture_set_scroll_batch_window
+ * @see libinput_device_config_gesture_get_scroll_batch_window
+ * @see libinput_device_config_gesture_get_scroll_batch_window_default
+ */
+int
+libinput_device_config_gesture_scroll_batching_is_available(struct libinput_device *device);
+
+/**
+ * @ingroup config
+ *
+ * Set the batching window for two-finger scroll events on this device.
+ * Within the window, per-frame scroll deltas are accumulated and posted
+ * as one coalesced event; the first event after an idle period is always
+ * posted immediately. A window of 0 (the default) disables batching and
+ * posts one event per frame.
+ *
+ * @param device The device to configure
+ * @param window_ms The batching window in milliseconds, at most @ref
+ * LIBINPUT_GESTURE_SCROLL_BATCH_WINDOW_MAX. 0 disables batching.
+ *
+ * @return A config status code. Disabling scroll batching on a device
+ * that does not support it always succeeds.
+ *
+ * @see libinput_device_config_gesture_scroll_batching_is_available
+ * @see libinput_device_config_gesture_get_scroll_batch_window
+ * @see libinput_device_config_gesture_get_scroll_batch_window_default
+ */
+enum libinput_config_status
+libinput_device_config_gesture_set_scroll_batch_window(struct libinput_device *device,
+						       uint32_t window_ms);
+
+/**
+ * @ingroup config
+ *
+ * Return the current batching window for two-finger scroll events on this
+ * device. If the device does not support scroll batching, this function
+ * always returns 0.
+ *
+ * @param device The device to configure
+ * @return The batching window in milliseconds, 0 if batching is disabled
+ *
+ * @see libinput_device_config_gesture_scroll_batching_is_available
+ * @see libinput_device_config_gesture_set_scroll_batch_window
+ * @see libinput_device_config_gesture_get_scroll_batch_window_default
+ */
+uint32_t
+libinput_device_config_gesture_get_scroll_batch_window(struct libinput_device *device);
+
+/**
+ * @ingroup config
+ *
+ * Return the default batching window for two-finger scroll events on this
+ * device.
+ *
+ * @param device The device to configure
+ * @return The default batching window in milliseconds, 0 if batching is
+ * disabled by default
+ *
+ * @see libinput_device_config_gesture_scroll_batching_is_available
+ * @see libinput_device_config_gesture_set_scroll_batch_window
+ * @see libinput_device_config_gesture_get_scroll_batch_window
+ */
+uint32_t
+libinput_device_config_gesture_get_scroll_batch_window_default(struct libinput_device *device);
+
+enum libinput_config_3fg_drag_state {
+	/** Three-finger drag is to be disabled, or is currently disabled */
+	LIBINPUT_CONFIG_3FG_DRAG_DISABLED,
+	/** Three-finger drag is to be enabled, or is currently enabled */
+	LIBINPUT_CONFIG_3FG_DRAG_ENABLED,
+};
+
+/**
+ * @ingroup config
+ *
+ * Check whether a device can perform a three-finger drag.
+ *
+ * @param device The device to configure
+ * @return Non-zero if a device can perform a three-finger drag, zero
+ * otherwise.
+ *
+ * @see libinput_device_config_gesture_set_3fg_drag_enabled
+ * @see libinput_device_config_gesture_get_3fg_drag_enabled
+ * @see libinput_device_config_gesture_get_3fg_drag_default_enabled
+ */
+int
+libinput_device_config_gesture_3fg_drag_is_available(struct libinput_device *device);
+
+/**
+ * @ingroup config
+ *
+ * Enable or disable three-finger drag on this device. While enabled, a
+ * three-finger movement posts a left button press followed by pointer
+ * motion instead of the swipe gesture events; lifting the fingers
+ * releases the button.
+ *
+ * @param device The device to configure
+ * @param enabled @ref LIBINPUT_CONFIG_3FG_DRAG_ENABLED to enable
+ * three-finger drag or @ref LIBINPUT_CONFIG_3FG_DRAG_DISABLED to
+ * disable it
+ *
+ * @return A config status code. Disabling three-finger drag on a device
+ * that does not support it always succeeds.
+ *
+ * @see libinput_device_config_gesture_3fg_drag_is_available
+ * @see libinput_device_config_gesture_get_3fg_drag_enabled
+ * @see libinput_device_config_gesture_get_3fg_drag_default_enabled
+ */
+enum libinput_config_status
+libinput_device_config_gesture_set_3fg_drag_enabled(struct libinput_device *device,
+						    enum libinput_config_3fg_drag_state enabled);
+
+/**
+ * @ingroup config
+ *
+ * Check if three-finger drag is enabled on this device. If the device
+ * does not support three-finger drag, this function always returns @ref
+ * LIBINPUT_CONFIG_3FG_DRAG_DISABLED.
+ *
+ * @param device The device to configure
+ * @return Whether three-finger drag is enabled
+ *
+ * @see libinput_device_config_gesture_3fg_drag_is_available
+ * @see libinput_device_config_gesture_set_3fg_drag_enabled
+ * @see libinput_device_config_gesture_get_3fg_drag_default_enabled
+ */
+enum libinput_config_3fg_drag_state
+libinput_device_config_gesture_get_3fg_drag_enabled(struct libinput_device *device);
+
+/**
+ * @ingroup config
+ *
+ * Return the default three-finger drag setting for this device.
+ *
+ * @param device The device to configure
+ * @return Whether three-finger drag is enabled by default
+ *
+ * @see libinput_device_config_gesture_3fg_drag_is_available
+ * @see libinput_device_config_gesture_set_3fg_drag_enabled
+ * @see libinput_device_config_gesture_get_3fg_drag_enabled
+ */
+enum libinput_config_3fg_drag_state
+libinput_device_config_gesture_get_3fg_drag_default_enabled(struct libinput_device *device);
+
 #endif /* LIBINPUT_PRIVATE_CONFIG_H */
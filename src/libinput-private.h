@@ -28,6 +28,7 @@
 #include "config.h"
 
 #include <errno.h>
+#include <inttypes.h>
 #include <math.h>
 #include <stdarg.h>
 
@@ -41,8 +42,20 @@
 #include "libinput-private-config.h"
 #include "libinput-util.h"
 #include "libinput-version.h"
+#include "util-mpsc-ring.h"
+#include "timer.h"
 
 struct libinput_source;
+struct libinput_event_pool;
+struct libinput_uring;
+struct libinput_export_ring;
+struct libinput_position_page;
+struct libinput_touch_journal;
+struct libinput_stats_page;
+struct libinput_audit_log;
+struct libinput_timer;
+struct log_ring_record;
+struct libevdev;
 
 /* A coordinate pair in device coordinates */
 struct device_coords {
@@ -125,32 +138,182 @@ struct libinput_interface_backend {
 				  const char *seat_name);
 };
 
+/* Flat mirror of the pipeline state for libinput_crash_dump(), updated
+ * in-band whenever the mirrored state changes so a crash handler only
+ * ever write(2)s this one struct - no allocation, no locking, no heap
+ * walking. Any layout change must bump CRASH_SHADOW_VERSION. */
+#define CRASH_SHADOW_MAGIC 0x70646c69 /* "ildp" */
+#define CRASH_SHADOW_VERSION 1
+#define CRASH_SHADOW_MAX_DEVICES 32
+
+struct libinput_crash_shadow_device {
+	uint32_t seat_index;
+	uint32_t dispatch_type; /* enum evdev_dispatch_type */
+	uint64_t nframes;
+	uint64_t nevents;
+};
+
+struct libinput_crash_shadow {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t events_in;
+	uint64_t events_out;
+	uint64_t events_count;
+	uint64_t events_len;
+	uint64_t events_max_depth;
+	uint64_t events_ndropped;
+	uint32_t ndevices; /* live devices, may exceed the slot array */
+	uint32_t slots_used; /* occupancy bitmask for devices[] */
+	struct libinput_crash_shadow_device
+		devices[CRASH_SHADOW_MAX_DEVICES];
+};
+
 struct libinput {
 	int epoll_fd;
+	/* NULL unless the io_uring dispatch backend is enabled */
+	struct libinput_uring *uring;
 	struct list source_destroy_list;
+	/* devices whose last ref dropped during dispatch, their teardown
+	 * runs after the event loop, see libinput_drop_destroyed_devices() */
+	struct list device_destroy_list;
 
 	struct list seat_list;
 
 	struct {
-		struct list list;
+		/* armed timers as a min-heap on expire, heap[0] is the
+		 * next timer due */
+		struct libinput_timer **heap;
+		size_t heap_count;
+		size_t heap_len;
 		struct libinput_source *source;
 		int fd;
 		uint64_t next_expiry;
+		/* a set/cancel during dispatch changed the heap root; the
+		 * timerfd rearm is deferred to dispatch exit */
+		bool rearm_pending;
 	} timer;
 
+	/* idle governor, see libinput_set_idle_timeout() */
+	struct {
+		struct libinput_timer timer;
+		uint64_t timeout; /* us, 0 disables the governor */
+		uint64_t last_activity;
+		/* quiet period elapsed, caches dropped, timer unarmed */
+		bool parked;
+	} idle;
+
 	struct libinput_event **events;
 	size_t events_count;
 	size_t events_len;
 	size_t events_in;
 	size_t events_out;
+	/* queue accounting, see libinput_get_event_queue_stats() */
+	size_t events_max_depth;
+	uint64_t events_ngrows;
+	uint64_t events_ndropped;
+	size_t events_limit; /* 0 for unbounded */
+	/* events array came from alloc_hooks rather than malloc */
+	bool events_hooked;
+	/* 0 for no budget, see libinput_set_memory_budget() */
+	size_t memory_budget;
+	/* per-dispatch-cycle allocation watchdog, see
+	 * libinput_alloc_watch_init() */
+	struct {
+		bool enabled;
+		/* cycles left before the zero-allocation invariant is
+		 * enforced */
+		unsigned int warmup;
+		uint64_t last_count;
+		uint64_t watermark; /* worst cycle seen during warmup */
+	} alloc_watch;
+	/* merge queued motion events in place during client stalls, see
+	 * libinput_set_motion_compression() */
+	bool motion_compression;
+	/* re-sort each dispatch cycle's events by hardware timestamp,
+	 * see libinput_set_event_ordering() */
+	bool event_ordering;
+	/* post the deprecated POINTER_AXIS companion to each scroll
+	 * event, see libinput_set_legacy_scroll_events_enabled() */
+	bool legacy_scroll_events;
+
+	/* latency-priority lane, drained ahead of the bulk ring above,
+	 * see libinput_device_set_priority() */
+	struct libinput_event **prio_events;
+	size_t prio_count;
+	size_t prio_len;
+	size_t prio_in;
+	size_t prio_out;
+
+	struct libinput_event_pool *event_pool;
+
+	/* caller-provided allocators for the event pool and queue, unset
+	 * unless libinput_set_allocation_hooks() was called */
+	struct {
+		libinput_alloc_func alloc;
+		libinput_free_func free;
+		void *user_data;
+	} alloc_hooks;
+
+	/* lock-free staging ring for events posted off the dispatching
+	 * thread, drained into events by libinput_dispatch() */
+	struct mpsc_ring post_ring;
+	struct mpsc_ring_slot *post_ring_slots;
+
+	/* NULL unless the shared-memory event export is enabled */
+	struct libinput_export_ring *export_ring;
+
+	/* NULL unless the shared-memory position page is enabled */
+	struct libinput_position_page *position_page;
+
+	/* NULL unless the shared-memory touch journal is enabled */
+	struct libinput_touch_journal *touch_journal;
+
+	/* NULL unless the shared-memory stats page is enabled */
+	struct libinput_stats_page *stats_page;
+
+	/* NULL unless the audit trail is enabled */
+	struct libinput_audit_log *audit_log;
+
+	/* signal-safe snapshot source for libinput_crash_dump() */
+	struct libinput_crash_shadow crash_shadow;
 
 	struct list tool_list;
 
+	/* Serial-numbered tools bucketed by (type, serial) so
+	 * proximity-in lookup is O(1), see libinput_tool_hash_bucket() */
+	struct list tool_hash[16];
+
+	/* recycled tool allocations, see libinput_tool_alloc() */
+	struct list tool_pool;
+
+	/* struct evdev_preopen entries from parallel enumeration,
+	 * consumed by evdev_device_create() */
+	struct list preopened_devices;
+
+	/* context-lifetime deduplicated strings, see
+	 * libinput_intern_string() */
+	struct list interned_strings;
+
+	/* struct libinput_gesture_matcher_entry, in registration order,
+	 * see libinput_register_gesture_matcher() */
+	struct list gesture_matchers;
+
 	const struct libinput_interface *interface;
 	const struct libinput_interface_backend *interface_backend;
 
 	libinput_log_handler log_handler;
 	enum libinput_log_priority log_priority;
+
+	/* in-memory log sink, bypasses the log handler while enabled,
+	 * see libinput_log_set_ring_size() */
+	struct {
+		struct log_ring_record *records;
+		size_t nrecords;
+		size_t head; /* oldest record */
+		size_t count;
+		uint64_t ndropped;
+	} log_ring;
+
 	void *user_data;
 	int refcount;
 
@@ -158,10 +321,25 @@ struct libinput {
 
 	uint64_t last_event_time;
 	uint64_t dispatch_time;
+	/* increments on every libinput_dispatch() call, lets per-device
+	 * state tell "same cycle" from "new cycle" without a clock read */
+	uint64_t dispatch_seq;
+
+	/* Clock cache for the current dispatch cycle, see libinput_now().
+	 * Seeded from the first kernel event timestamp or the first
+	 * clock_gettime() of the cycle, cleared at the cycle boundary. */
+	uint64_t cached_now;
+	bool in_dispatch;
 
 	bool quirks_initialized;
 	struct quirks_context *quirks;
 
+	/* see LIBINPUT_STARTUP_TIMINGS */
+	bool startup_timings;
+
+	/* see LIBINPUT_LATENCY_STATS */
+	bool latency_stats;
+
 #if HAVE_LIBWACOM
 	struct {
 		WacomDeviceDatabase *db;
@@ -176,14 +354,26 @@ struct libinput_seat {
 	struct libinput *libinput;
 	struct list link;
 	struct list devices_list;
+	/* Flat mirror of devices_list: cache-linear iteration for the
+	 * per-seat broadcast scans and O(1) lookup via the index stored
+	 * in each device. Removal leaves a NULL hole so indices stay
+	 * stable; the generation bumps on every change, see
+	 * libinput_seat_attach_device_slot() */
+	struct libinput_device **devices;
+	size_t devices_len;
+	uint32_t devices_generation;
 	void *user_data;
 	int refcount;
 	libinput_seat_destroy_func destroy;
 
-	char *physical_name;
-	char *logical_name;
+	/* interned, owned by the libinput context */
+	const char *physical_name;
+	const char *logical_name;
 
-	uint32_t slot_map;
+	/* one bit per seat-wide touch slot in use, allocated with
+	 * find-first-zero. 64 bits to cope with multiple large touch
+	 * screens on the same seat */
+	uint64_t slot_map;
 
 	uint32_t button_count[KEY_CNT];
 };
@@ -318,6 +508,14 @@ struct libinput_device_config_gesture {
 			 enum libinput_config_hold_state enabled);
 	enum libinput_config_hold_state (*get_hold_enabled)(struct libinput_device *device);
 	enum libinput_config_hold_state (*get_hold_default)(struct libinput_device *device);
+	enum libinput_config_status (*set_scroll_batch_window)(struct libinput_device *device,
+			 uint32_t window_ms);
+	uint32_t (*get_scroll_batch_window)(struct libinput_device *device);
+	uint32_t (*get_scroll_batch_window_default)(struct libinput_device *device);
+	enum libinput_config_status (*set_3fg_drag_enabled)(struct libinput_device *device,
+			 enum libinput_config_3fg_drag_state enabled);
+	enum libinput_config_3fg_drag_state (*get_3fg_drag_enabled)(struct libinput_device *device);
+	enum libinput_config_3fg_drag_state (*get_3fg_drag_default)(struct libinput_device *device);
 };
 
 struct libinput_device_config {
@@ -338,19 +536,86 @@ struct libinput_device_config {
 struct libinput_device_group {
 	int refcount;
 	void *user_data;
-	char *identifier; /* unique identifier or NULL for singletons */
+	/* unique identifier or NULL for singletons; interned, owned by
+	 * the libinput context */
+	const char *identifier;
 
 	struct list link;
 };
 
+/* One slot's change within a touch frame, see
+ * libinput_device_touch_enable_frame_aggregation() */
+struct touch_frame_change {
+	enum libinput_event_type type; /* TOUCH_DOWN/MOTION/UP/CANCEL */
+	int32_t slot;
+	int32_t seat_slot;
+	struct device_coords point; /* valid for TOUCH_DOWN/MOTION only */
+};
+
 struct libinput_device {
 	struct libinput_seat *seat;
+	/* slot in seat->devices, stable for the device's lifetime */
+	size_t seat_index;
+	/* index into libinput->crash_shadow.devices, -1 when the shadow
+	 * device table was full at add time */
+	int crash_shadow_slot;
 	struct libinput_device_group *group;
 	struct list link;
 	struct list event_listeners;
+	/* struct libinput_device_share, the contexts that receive a
+	 * mirrored copy of this device's queued events, see
+	 * libinput_device_share_events() */
+	struct list shares;
 	void *user_data;
 	int refcount;
 	struct libinput_device_config config;
+
+	/* one bit per enum libinput_device_capability, fixed once the
+	 * device is configured, see
+	 * libinput_device_get_capability_mask() */
+	uint32_t capability_mask;
+
+	/* nesting depth of config transactions; while nonzero, setters
+	 * with expensive derived state record it in config_txn_pending
+	 * instead of rebuilding, see
+	 * libinput_device_config_transaction_commit() */
+	unsigned int config_txn;
+	uint32_t config_txn_pending; /* enum config_txn_pending */
+
+	/* bumped for each successfully applied setting, see
+	 * libinput_device_get_config_generation() */
+	uint32_t config_generation;
+	enum libinput_config_accel_profile config_txn_profile;
+	enum libinput_config_tap_state config_txn_tap;
+
+	/* one bit per enum libinput_event_type, set for types suppressed
+	 * via libinput_device_set_event_mask() */
+	unsigned long suppressed_events[NLONGS(LIBINPUT_EVENT_SWITCH_TOGGLE + 1)];
+
+	/* updated by the touchpad gesture state machine, see
+	 * libinput_device_get_active_gesture_hint() */
+	enum libinput_gesture_hint gesture_hint;
+
+	/* deliver this device's events through the priority lane, see
+	 * libinput_device_set_priority() */
+	bool priority;
+
+	/* per-slot changes staged for the next TOUCH_FRAME event while
+	 * frame aggregation is enabled */
+	struct {
+		bool enabled;
+		struct touch_frame_change *changes;
+		size_t nchanges;
+		size_t nallocated;
+	} touch_frame;
+
+	/* kernel timestamp of the hardware frame currently being
+	 * processed, see libinput_event_pointer_get_hw_time_usec() */
+	uint64_t last_hw_time;
+
+	/* only maintained when LIBINPUT_LATENCY_STATS is set, see
+	 * libinput_device_get_latency_stats() */
+	struct libinput_latency_stats latency;
 };
 
 enum libinput_tablet_tool_axis {
@@ -384,6 +649,10 @@ struct tablet_axes {
 
 struct libinput_tablet_tool {
 	struct list link;
+	/* bucket in the context's tool_hash, self-linked for tools
+	 * without a serial */
+	struct list hash_link;
+	struct libinput *libinput;
 	uint32_t serial;
 	uint32_t tool_id;
 	enum libinput_tablet_tool_type type;
@@ -423,6 +692,15 @@ struct libinput_tablet_pad_mode_group {
 struct libinput_event {
 	enum libinput_event_type type;
 	struct libinput_device *device;
+	/* NULL if the event was malloc'd rather than taken from the
+	 * context's event pool */
+	struct libinput_event_pool *pool;
+	/* time this event was queued, only set when latency stats are
+	 * enabled */
+	uint64_t post_time;
+	/* kernel timestamp of the hardware frame that triggered this
+	 * event, 0 if there was none (e.g. DEVICE_ADDED) */
+	uint64_t hw_time;
 };
 
 struct libinput_event_listener {
@@ -433,6 +711,13 @@ struct libinput_event_listener {
 
 typedef void (*libinput_source_dispatch_t)(void *data);
 
+struct libinput_source {
+	libinput_source_dispatch_t dispatch;
+	void *user_data;
+	int fd;
+	struct list link;
+};
+
 #define log_debug(li_, ...) log_msg((li_), LIBINPUT_LOG_PRIORITY_DEBUG, __VA_ARGS__)
 #define log_info(li_, ...) log_msg((li_), LIBINPUT_LOG_PRIORITY_INFO, __VA_ARGS__)
 #define log_error(li_, ...) log_msg((li_), LIBINPUT_LOG_PRIORITY_ERROR, __VA_ARGS__)
@@ -456,25 +741,27 @@ is_logged(const struct libinput *libinput,
 }
 
 
+/* The log functions are cold so their call sites end up out of line of
+ * the event hot paths */
 void
 log_msg_ratelimit(struct libinput *libinput,
 		  struct ratelimit *ratelimit,
 		  enum libinput_log_priority priority,
 		  const char *format, ...)
-	LIBINPUT_ATTRIBUTE_PRINTF(4, 5);
+	LIBINPUT_ATTRIBUTE_PRINTF(4, 5) _cold_;
 
 void
 log_msg(struct libinput *libinput,
 	enum libinput_log_priority priority,
 	const char *format, ...)
-	LIBINPUT_ATTRIBUTE_PRINTF(3, 4);
+	LIBINPUT_ATTRIBUTE_PRINTF(3, 4) _cold_;
 
 void
 log_msg_va(struct libinput *libinput,
 	   enum libinput_log_priority priority,
 	   const char *format,
 	   va_list args)
-	LIBINPUT_ATTRIBUTE_PRINTF(3, 0);
+	LIBINPUT_ATTRIBUTE_PRINTF(3, 0) _cold_;
 
 int
 libinput_init(struct libinput *libinput,
@@ -502,6 +789,63 @@ open_restricted(struct libinput *libinput,
 void
 close_restricted(struct libinput *libinput, int fd);
 
+/* Stash of devices opened and libevdev-initialized ahead of
+ * evdev_device_create(), see udev_input_add_devices() */
+void
+libinput_stash_preopened_device(struct libinput *libinput,
+				const char *devnode,
+				int fd,
+				struct libevdev *evdev);
+
+int
+libinput_fetch_preopened_device(struct libinput *libinput,
+				const char *devnode,
+				struct libevdev **evdev);
+
+void
+libinput_drop_preopened_devices(struct libinput *libinput);
+
+enum config_txn_pending {
+	CONFIG_TXN_ACCEL_PROFILE = bit(0),
+	CONFIG_TXN_TAP_ENABLED = bit(1),
+};
+
+/* For use by the config setters: true if a transaction is active and
+ * the rebuild was recorded for commit, in which case the setter must
+ * return success without rebuilding */
+bool
+libinput_config_txn_defer_accel_profile(struct libinput_device *device,
+					enum libinput_config_accel_profile profile);
+
+bool
+libinput_config_txn_defer_tap_enabled(struct libinput_device *device,
+				      enum libinput_config_tap_state enabled);
+
+/* Bucket of the context's tool hash for a (type, serial) key */
+struct list *
+libinput_tool_hash_bucket(struct libinput *libinput,
+			  enum libinput_tablet_tool_type type,
+			  uint32_t serial);
+
+/* A zeroed tool, recycled from the pool where possible */
+struct libinput_tablet_tool *
+libinput_tool_alloc(struct libinput *libinput);
+
+/* Return a context-lifetime copy of str, deduplicated across callers.
+ * Used for the seat/output/group names that recur on every hotplug
+ * cycle. Returns NULL for NULL. */
+const char *
+libinput_intern_string(struct libinput *libinput, const char *str);
+
+/* Run the registered gesture matchers over one touch frame, in
+ * registration order. Returns true if a matcher claimed the frame, i.e.
+ * the caller must skip its built-in gesture detection for this frame.
+ * Cheap no-op when no matchers are registered. */
+bool
+libinput_run_gesture_matchers(struct libinput *libinput,
+			      struct libinput_device *device,
+			      const struct libinput_gesture_frame *frame);
+
 bool
 ignore_litest_test_suite_device(struct udev_device *device);
 
@@ -512,6 +856,14 @@ libinput_seat_init(struct libinput_seat *seat,
 		   const char *logical_name,
 		   libinput_seat_destroy_func destroy);
 
+void
+libinput_seat_attach_device_slot(struct libinput_seat *seat,
+				 struct libinput_device *device);
+
+void
+libinput_seat_detach_device_slot(struct libinput_seat *seat,
+				 struct libinput_device *device);
+
 void
 libinput_device_init(struct libinput_device *device,
 		     struct libinput_seat *seat);
@@ -543,9 +895,20 @@ libinput_device_add_event_listener(struct libinput_device *device,
 void
 libinput_device_remove_event_listener(struct libinput_event_listener *listener);
 
+/* Thread-safe alternative to the notify_* helpers below: stages an
+ * already-initialized event in the lock-free post ring, from where the
+ * next libinput_dispatch() moves it into the client-facing queue. The
+ * notify_* helpers themselves must only run on the dispatching thread. */
+void
+libinput_post_event_from_thread(struct libinput *libinput,
+				struct libinput_event *event);
+
 void
 notify_added_device(struct libinput_device *device);
 
+void
+notify_config_changed(struct libinput_device *device);
+
 void
 notify_removed_device(struct libinput_device *device);
 
@@ -735,6 +1098,32 @@ switch_notify_toggle(struct libinput_device *device,
 
 static inline uint64_t
 libinput_now(struct libinput *libinput)
+{
+	struct timespec ts = { 0, 0 };
+	uint64_t now;
+
+	/* Within a dispatch cycle everything happens "at" the same time,
+	 * don't pay for a clock read per caller */
+	if (libinput->cached_now)
+		return libinput->cached_now;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		log_error(libinput, "clock_gettime failed: %s\n", strerror(errno));
+		return 0;
+	}
+
+	now = s2us(ts.tv_sec) + ns2us(ts.tv_nsec);
+
+	if (libinput->in_dispatch)
+		libinput->cached_now = now;
+
+	return now;
+}
+
+/* Uncached clock read for deadline checks inside a dispatch cycle,
+ * where libinput_now() deliberately stands still */
+static inline uint64_t
+libinput_clock_now(struct libinput *libinput)
 {
 	struct timespec ts = { 0, 0 };
 
@@ -746,6 +1135,53 @@ libinput_now(struct libinput *libinput)
 	return s2us(ts.tv_sec) + ns2us(ts.tv_nsec);
 }
 
+/* Startup phase timing, enabled with LIBINPUT_STARTUP_TIMINGS in the
+ * environment. Phases log a structured line at info priority:
+ *   timing: phase=<name> [<detail>] wall_us=<n> cpu_us=<n>
+ */
+struct libinput_phase_timing {
+	uint64_t wall; /* µs, CLOCK_MONOTONIC */
+	uint64_t cpu;  /* µs, CLOCK_PROCESS_CPUTIME_ID */
+};
+
+static inline void
+libinput_timing_start(struct libinput *libinput,
+		      struct libinput_phase_timing *timing)
+{
+	struct timespec ts = { 0, 0 };
+
+	if (!libinput->startup_timings)
+		return;
+
+	timing->wall = libinput_now(libinput);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	timing->cpu = s2us(ts.tv_sec) + ns2us(ts.tv_nsec);
+}
+
+static inline void
+libinput_timing_log(struct libinput *libinput,
+		    const struct libinput_phase_timing *timing,
+		    const char *phase,
+		    const char *detail)
+{
+	struct timespec ts = { 0, 0 };
+	uint64_t cpu_now;
+
+	if (!libinput->startup_timings)
+		return;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	cpu_now = s2us(ts.tv_sec) + ns2us(ts.tv_nsec);
+
+	log_info(libinput,
+		 "timing: phase=%s%s%s wall_us=%" PRIu64 " cpu_us=%" PRIu64 "\n",
+		 phase,
+		 detail ? " " : "",
+		 detail ? detail : "",
+		 libinput_now(libinput) - timing->wall,
+		 cpu_now - timing->cpu);
+}
+
 static inline struct device_float_coords
 device_delta(const struct device_coords a, const struct device_coords b)
 {
@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef LIBINPUT_TRACE_H
+#define LIBINPUT_TRACE_H
+
+#include "config.h"
+
+/* USDT probes for the event pipeline, provider "libinput". These mark the
+ * pipeline stages with stable names so external tracers (bpftrace, perf,
+ * systemtap) don't have to attach to function symbols that may be inlined
+ * away:
+ *
+ *   kernel_read    - a hardware frame was read off the evdev fd
+ *   dispatch_enter - that frame enters per-device processing
+ *   filter_applied - pointer acceleration ran on a motion delta
+ *   event_posted   - an event was queued for the caller
+ *   event_drained  - the caller picked the event up
+ *
+ * The device argument is the struct libinput_device pointer, stable for
+ * the lifetime of the device, so stages can be correlated per device.
+ * The filter probe passes the struct motion_filter pointer instead since
+ * the filter layer has no device notion. Timestamps are the kernel event
+ * time in µs where one exists.
+ *
+ * Each probe compiles to a single nop when sdt.h is available and to
+ * nothing at all otherwise; only pass arguments that are already at hand,
+ * probe arguments are evaluated even with no tracer attached.
+ */
+
+#if HAVE_SYSTEMTAP
+#include <sys/sdt.h>
+
+#define trace_kernel_read(device_, time_, nevents_) \
+	DTRACE_PROBE3(libinput, kernel_read, device_, time_, nevents_)
+#define trace_dispatch_enter(device_, time_) \
+	DTRACE_PROBE2(libinput, dispatch_enter, device_, time_)
+#define trace_filter_applied(filter_, time_) \
+	DTRACE_PROBE2(libinput, filter_applied, filter_, time_)
+#define trace_event_posted(device_, type_, time_) \
+	DTRACE_PROBE3(libinput, event_posted, device_, type_, time_)
+#define trace_event_drained(device_, type_, hw_time_) \
+	DTRACE_PROBE3(libinput, event_drained, device_, type_, hw_time_)
+
+#else /* HAVE_SYSTEMTAP */
+
+#define trace_kernel_read(...)
+#define trace_dispatch_enter(...)
+#define trace_filter_applied(...)
+#define trace_event_posted(...)
+#define trace_event_drained(...)
+
+#endif /* HAVE_SYSTEMTAP */
+
+#endif /* LIBINPUT_TRACE_H */
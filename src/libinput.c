@@ -36,15 +36,60 @@
 
 #include "libinput.h"
 #include "libinput-private.h"
+#include "libinput-trace.h"
 #include "evdev.h"
 #include "timer.h"
 #include "quirks.h"
+#include "uring.h"
+#include "event-export.h"
+#include "util-alloc.h"
+
+/* The event type values are sparse (groups of at most 8 types, 100
+ * apart), so we can map each type to a dense bit index: 3 bits for the
+ * offset within its group, 3 bits for the group. The permitted-type set
+ * of any accessor then fits into a single uint64_t and the OR-chain
+ * below constant-folds, making the check in the accessors one bit test.
+ */
+#define event_type_bit(t_) \
+	((uint64_t)1 << ((((t_) < 100 ? 0 : (t_)/100 - 2) << 3) | ((t_) % 100)))
+
+static_assert(LIBINPUT_EVENT_SWITCH_TOGGLE/100 - 2 < 8,
+	      "too many event type groups for a 64-bit mask");
+static_assert(LIBINPUT_EVENT_GESTURE_HOLD_END % 100 < 8,
+	      "too many event types in one group for a 64-bit mask");
+
+#define event_type_mask_1(t_) event_type_bit(t_)
+#define event_type_mask_2(t_, ...) \
+	(event_type_bit(t_) | event_type_mask_1(__VA_ARGS__))
+#define event_type_mask_3(t_, ...) \
+	(event_type_bit(t_) | event_type_mask_2(__VA_ARGS__))
+#define event_type_mask_4(t_, ...) \
+	(event_type_bit(t_) | event_type_mask_3(__VA_ARGS__))
+#define event_type_mask_5(t_, ...) \
+	(event_type_bit(t_) | event_type_mask_4(__VA_ARGS__))
+#define event_type_mask_6(t_, ...) \
+	(event_type_bit(t_) | event_type_mask_5(__VA_ARGS__))
+#define event_type_mask_7(t_, ...) \
+	(event_type_bit(t_) | event_type_mask_6(__VA_ARGS__))
+#define event_type_mask_8(t_, ...) \
+	(event_type_bit(t_) | event_type_mask_7(__VA_ARGS__))
+#define event_type_mask_n(_1, _2, _3, _4, _5, _6, _7, _8, n_, ...) n_
+#define event_type_mask(...) \
+	event_type_mask_n(__VA_ARGS__, \
+			  event_type_mask_8, event_type_mask_7, \
+			  event_type_mask_6, event_type_mask_5, \
+			  event_type_mask_4, event_type_mask_3, \
+			  event_type_mask_2, event_type_mask_1)(__VA_ARGS__)
 
 #define require_event_type(li_, type_, retval_, ...)	\
 	if (type_ == LIBINPUT_EVENT_NONE) abort(); \
-	if (!check_event_type(li_, __func__, type_, __VA_ARGS__, -1)) \
+	if (!check_event_type(li_, __func__, type_, event_type_mask(__VA_ARGS__))) \
 		return retval_; \
 
+/* Capacity of the lock-free staging ring for threaded event posting,
+ * must be a power of two */
+#define LIBINPUT_POST_RING_SIZE 1024
+
 #define ASSERT_INT_SIZE(type_) \
 	static_assert(sizeof(type_) == sizeof(unsigned int), \
 		      "sizeof("  #type_ ") must be sizeof(uint)")
@@ -76,12 +121,24 @@ ASSERT_INT_SIZE(enum libinput_config_middle_emulation_state);
 ASSERT_INT_SIZE(enum libinput_config_scroll_method);
 ASSERT_INT_SIZE(enum libinput_config_dwt_state);
 
+static void
+libinput_drop_interned_strings(struct libinput *libinput);
+
+static void
+libinput_drop_gesture_matchers(struct libinput *libinput);
+
+static void
+init_event_base(struct libinput_event *event,
+		struct libinput_device *device,
+		enum libinput_event_type type);
+
 static inline const char *
 event_type_to_str(enum libinput_event_type type)
 {
 	switch(type) {
 	CASE_RETURN_STRING(LIBINPUT_EVENT_DEVICE_ADDED);
 	CASE_RETURN_STRING(LIBINPUT_EVENT_DEVICE_REMOVED);
+	CASE_RETURN_STRING(LIBINPUT_EVENT_DEVICE_CONFIG_CHANGED);
 	CASE_RETURN_STRING(LIBINPUT_EVENT_KEYBOARD_KEY);
 	CASE_RETURN_STRING(LIBINPUT_EVENT_POINTER_MOTION);
 	CASE_RETURN_STRING(LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE);
@@ -123,42 +180,19 @@ static inline bool
 check_event_type(struct libinput *libinput,
 		 const char *function_name,
 		 unsigned int type_in,
-		 ...)
+		 uint64_t permitted_mask)
 {
-	bool rc = false;
-	va_list args;
-	unsigned int type_permitted;
-
-	va_start(args, type_in);
-	type_permitted = va_arg(args, unsigned int);
-
-	while (type_permitted != (unsigned int)-1) {
-		if (type_permitted == type_in) {
-			rc = true;
-			break;
-		}
-		type_permitted = va_arg(args, unsigned int);
-	}
-
-	va_end(args);
+	if (event_type_bit(type_in) & permitted_mask)
+		return true;
 
-	if (!rc) {
-		const char *name = event_type_to_str(type_in);
-		log_bug_client(libinput,
-			       "Invalid event type %s (%d) passed to %s()\n",
-			       name, type_in, function_name);
-	}
+	const char *name = event_type_to_str(type_in);
+	log_bug_client(libinput,
+		       "Invalid event type %s (%d) passed to %s()\n",
+		       name, type_in, function_name);
 
-	return rc;
+	return false;
 }
 
-struct libinput_source {
-	libinput_source_dispatch_t dispatch;
-	void *user_data;
-	int fd;
-	struct list link;
-};
-
 struct libinput_event_device_notify {
 	struct libinput_event base;
 };
@@ -192,6 +226,10 @@ struct libinput_event_touch {
 	int32_t slot;
 	int32_t seat_slot;
 	struct device_coords point;
+	/* TOUCH_FRAME with frame aggregation enabled: the per-slot
+	 * changes of this frame, owned by the event */
+	struct touch_frame_change *changes;
+	size_t nchanges;
 };
 
 struct libinput_event_gesture {
@@ -207,22 +245,24 @@ struct libinput_event_gesture {
 
 struct libinput_event_tablet_tool {
 	struct libinput_event base;
+	uint64_t time;
+	/* the 4-byte fields and the axis bitmask pack together so the
+	 * 8-byte-aligned members below don't leave holes */
 	uint32_t button;
 	enum libinput_button_state state;
 	uint32_t seat_button_count;
-	uint64_t time;
-	struct tablet_axes axes;
-	unsigned char changed_axes[NCHARS(LIBINPUT_TABLET_TOOL_AXIS_MAX + 1)];
-	struct libinput_tablet_tool *tool;
 	enum libinput_tablet_tool_proximity_state proximity_state;
 	enum libinput_tablet_tool_tip_state tip_state;
+	unsigned char changed_axes[NCHARS(LIBINPUT_TABLET_TOOL_AXIS_MAX + 1)];
+	struct libinput_tablet_tool *tool;
+	struct tablet_axes axes;
 };
 
 struct libinput_event_tablet_pad {
 	struct libinput_event base;
-	unsigned int mode;
-	struct libinput_tablet_pad_mode_group *mode_group;
 	uint64_t time;
+	struct libinput_tablet_pad_mode_group *mode_group;
+	unsigned int mode;
 	struct {
 		uint32_t number;
 		enum libinput_button_state state;
@@ -231,14 +271,15 @@ struct libinput_event_tablet_pad {
 		uint32_t code;
 		enum libinput_key_state state;
 	} key;
+	/* position first: the double dictates 8-byte alignment anyway */
 	struct {
-		enum libinput_tablet_pad_ring_axis_source source;
 		double position;
+		enum libinput_tablet_pad_ring_axis_source source;
 		int number;
 	} ring;
 	struct {
-		enum libinput_tablet_pad_strip_axis_source source;
 		double position;
+		enum libinput_tablet_pad_strip_axis_source source;
 		int number;
 	} strip;
 };
@@ -250,6 +291,259 @@ struct libinput_event_switch {
 	enum libinput_switch_state state;
 };
 
+/* one per context subscribed to a device's events via
+ * libinput_device_share_events() */
+struct libinput_device_share {
+	struct libinput *recipient;
+	struct list link;
+};
+
+/*
+ * Wire format for libinput_event_serialize()/deserialize(). These
+ * structs are the format contract: fixed-width fields, no pointers, no
+ * internal padding, native byte order (both hosts must agree on
+ * endianness). Any layout change must bump LIBINPUT_EVENT_WIRE_VERSION.
+ * Events whose payload references per-context objects (tablet tools,
+ * pad mode groups) have no wire representation.
+ */
+
+struct libinput_event_wire_header {
+	uint32_t version;	/* LIBINPUT_EVENT_WIRE_VERSION */
+	uint32_t type;		/* enum libinput_event_type */
+	uint32_t size;		/* total size of the blob in bytes */
+	uint32_t reserved;
+	uint64_t time;
+	uint64_t hw_time;
+};
+
+struct libinput_event_wire_keyboard {
+	struct libinput_event_wire_header header;
+	uint32_t key;
+	uint32_t state;
+	uint32_t seat_key_count;
+	uint32_t reserved;
+};
+
+struct libinput_event_wire_pointer {
+	struct libinput_event_wire_header header;
+	double delta_x, delta_y;
+	double delta_raw_x, delta_raw_y;
+	int32_t absolute_x, absolute_y;
+	int32_t discrete_x, discrete_y;
+	int32_t v120_x, v120_y;
+	uint32_t button;
+	uint32_t seat_button_count;
+	uint32_t state;
+	uint32_t source;
+	uint32_t axes;
+	uint32_t reserved;
+};
+
+struct libinput_event_wire_touch_change {
+	uint32_t type;
+	int32_t slot;
+	int32_t seat_slot;
+	int32_t point_x, point_y;
+	uint32_t reserved;
+};
+
+struct libinput_event_wire_touch {
+	struct libinput_event_wire_header header;
+	int32_t slot;
+	int32_t seat_slot;
+	int32_t point_x, point_y;
+	/* followed by nchanges struct libinput_event_wire_touch_change
+	 * for an aggregated TOUCH_FRAME */
+	uint32_t nchanges;
+	uint32_t reserved;
+};
+
+struct libinput_event_wire_gesture {
+	struct libinput_event_wire_header header;
+	int32_t finger_count;
+	int32_t cancelled;
+	double delta_x, delta_y;
+	double delta_unaccel_x, delta_unaccel_y;
+	double scale;
+	double angle;
+};
+
+struct libinput_event_wire_switch {
+	struct libinput_event_wire_header header;
+	uint32_t sw;
+	uint32_t state;
+};
+
+/* Sizing union for the event pool, never instantiated as such. Any new
+ * event type must be added here or it ends up heap-allocated. */
+union libinput_event_storage {
+	struct libinput_event base;
+	struct libinput_event_device_notify device_notify;
+	struct libinput_event_keyboard keyboard;
+	struct libinput_event_pointer pointer;
+	struct libinput_event_touch touch;
+	struct libinput_event_gesture gesture;
+	struct libinput_event_tablet_tool tablet_tool;
+	struct libinput_event_tablet_pad tablet_pad;
+	struct libinput_event_switch sw;
+};
+
+/* Layout contract: the pool hands out blocks of sizeof(union
+ * libinput_event_storage), so padding in any one event struct inflates
+ * every slab and the queue's cache footprint. Keep the structs ordered
+ * base, time, then 4-byte fields paired up so the 8-byte-aligned
+ * members leave no holes; the bounds below are the x86-64 sizes at the
+ * time of writing (32-bit layouts are smaller). The second assert pins
+ * the motion deltas of the most frequent event into the first cache
+ * line.
+ */
+static_assert(sizeof(union libinput_event_storage) <= 192,
+	      "event storage stride grew, check the structs for padding");
+static_assert(offsetof(struct libinput_event_pointer, delta) +
+		      sizeof(struct normalized_coords) <= 64,
+	      "pointer motion fields no longer fit the first cache line");
+static_assert(sizeof(struct libinput_event_keyboard) <= 64,
+	      "keyboard event grew beyond one cache line");
+static_assert(sizeof(struct libinput_event_pointer) <= 128,
+	      "pointer event grew beyond two cache lines");
+static_assert(sizeof(struct libinput_event_touch) <= 80,
+	      "touch event layout regressed");
+static_assert(sizeof(struct libinput_event_gesture) <= 104,
+	      "gesture event layout regressed");
+static_assert(sizeof(struct libinput_event_tablet_tool) <= 184,
+	      "tablet tool event layout regressed");
+static_assert(sizeof(struct libinput_event_tablet_pad) <= 112,
+	      "tablet pad event layout regressed");
+static_assert(sizeof(struct libinput_event_switch) <= 64,
+	      "switch event layout regressed");
+
+#define EVENT_QUEUE_INITIAL_LEN 32
+#define EVENT_POOL_SLAB_NEVENTS 64
+
+struct libinput_event_slab {
+	struct list link;
+	/* how to free this slab, NULL for plain free(). Recorded per slab
+	 * because slabs may be freed after the context and its hooks are
+	 * gone, see libinput_set_allocation_hooks() */
+	libinput_free_func free_func;
+	void *free_func_data;
+	union libinput_event_storage events[EVENT_POOL_SLAB_NEVENTS];
+};
+
+/* Fixed-size block recycler for posted events. Events handed out to the
+ * caller may outlive the context, so the pool refcounts outstanding
+ * events and destroys itself once the context is gone and the last
+ * event was returned.
+ */
+struct libinput_event_pool {
+	struct list slab_list;
+	void *free_list; /* chained through the first word of each block */
+	size_t outstanding;
+	bool closed;
+};
+
+static struct libinput_event_pool *
+libinput_event_pool_create(void)
+{
+	struct libinput_event_pool *pool;
+
+	pool = zalloc(sizeof *pool);
+	list_init(&pool->slab_list);
+
+	return pool;
+}
+
+static void
+libinput_event_pool_destroy(struct libinput_event_pool *pool)
+{
+	struct libinput_event_slab *slab;
+
+	list_for_each_safe(slab, &pool->slab_list, link) {
+		alloc_account_free(ALLOC_TAG_EVENT_POOL, sizeof *slab);
+		if (slab->free_func)
+			slab->free_func(slab,
+					sizeof(*slab),
+					slab->free_func_data);
+		else
+			free(slab);
+	}
+	free(pool);
+}
+
+static void *
+libinput_event_pool_get(struct libinput *libinput)
+{
+	struct libinput_event_pool *pool = libinput->event_pool;
+	struct libinput_event *event;
+	void *block;
+
+	if (!pool->free_list) {
+		struct libinput_event_slab *slab = NULL;
+
+		if (libinput->alloc_hooks.alloc) {
+			slab = libinput->alloc_hooks.alloc(
+					sizeof(*slab),
+					libinput->alloc_hooks.user_data);
+			if (slab) {
+				memset(slab, 0, sizeof(*slab));
+				slab->free_func = libinput->alloc_hooks.free;
+				slab->free_func_data =
+					libinput->alloc_hooks.user_data;
+			}
+		}
+		if (!slab)
+			slab = zalloc(sizeof *slab);
+		alloc_account(ALLOC_TAG_EVENT_POOL, sizeof *slab);
+
+		list_insert(&pool->slab_list, &slab->link);
+		for (size_t i = 0; i < EVENT_POOL_SLAB_NEVENTS; i++) {
+			block = &slab->events[i];
+			*(void **)block = pool->free_list;
+			pool->free_list = block;
+		}
+	}
+
+	block = pool->free_list;
+	pool->free_list = *(void **)block;
+	pool->outstanding++;
+
+	memset(block, 0, sizeof(union libinput_event_storage));
+	event = block;
+	event->pool = pool;
+
+	return event;
+}
+
+static void
+libinput_event_pool_put(struct libinput_event_pool *pool,
+			struct libinput_event *event)
+{
+	void *block = event;
+
+	*(void **)block = pool->free_list;
+	pool->free_list = block;
+
+	assert(pool->outstanding > 0);
+	pool->outstanding--;
+	if (pool->closed && pool->outstanding == 0)
+		libinput_event_pool_destroy(pool);
+}
+
+static void
+libinput_event_pool_close(struct libinput_event_pool *pool)
+{
+	pool->closed = true;
+	if (pool->outstanding == 0)
+		libinput_event_pool_destroy(pool);
+}
+
+/* Allocate a zeroed event-sized block from the device's context pool */
+static void *
+event_alloc(struct libinput_device *device)
+{
+	return libinput_event_pool_get(device->seat->libinput);
+}
+
 LIBINPUT_ATTRIBUTE_PRINTF(3, 0)
 static void
 libinput_default_log_func(struct libinput *libinput,
@@ -269,14 +563,105 @@ libinput_default_log_func(struct libinput *libinput,
 	vfprintf(stderr, format, args);
 }
 
+/* Each record holds the pre-formatted message. Formatting eagerly (rather
+ * than stashing the format pointer and args) is deliberate: %s arguments
+ * may point at memory that is long gone by the time the ring is drained.
+ * A bounded vsnprintf into preallocated storage is still far cheaper than
+ * a handler call that hits stderr or a logging daemon. */
+struct log_ring_record {
+	enum libinput_log_priority priority;
+	char text[256];
+};
+
+LIBINPUT_ATTRIBUTE_PRINTF(3, 0)
+static void
+log_ring_append(struct libinput *libinput,
+		enum libinput_log_priority priority,
+		const char *format,
+		va_list args)
+{
+	struct log_ring_record *rec;
+	size_t index;
+
+	index = (libinput->log_ring.head + libinput->log_ring.count) %
+		libinput->log_ring.nrecords;
+	rec = &libinput->log_ring.records[index];
+
+	if (libinput->log_ring.count == libinput->log_ring.nrecords) {
+		/* full, overwrite the oldest record */
+		libinput->log_ring.head = (libinput->log_ring.head + 1) %
+					  libinput->log_ring.nrecords;
+		libinput->log_ring.ndropped++;
+	} else {
+		libinput->log_ring.count++;
+	}
+
+	rec->priority = priority;
+	vsnprintf(rec->text, sizeof(rec->text), format, args);
+}
+
+LIBINPUT_EXPORT int
+libinput_log_set_ring_size(struct libinput *libinput, size_t nrecords)
+{
+	struct log_ring_record *records = NULL;
+
+	if (nrecords > 0)
+		records = zalloc(nrecords * sizeof(*records));
+
+	free(libinput->log_ring.records);
+	libinput->log_ring.records = records;
+	libinput->log_ring.nrecords = nrecords;
+	libinput->log_ring.head = 0;
+	libinput->log_ring.count = 0;
+	libinput->log_ring.ndropped = 0;
+
+	return 0;
+}
+
+LIBINPUT_EXPORT size_t
+libinput_log_ring_pop(struct libinput *libinput,
+		      enum libinput_log_priority *priority,
+		      char *buf,
+		      size_t len)
+{
+	struct log_ring_record *rec;
+	size_t copied;
+
+	if (libinput->log_ring.count == 0)
+		return 0;
+
+	rec = &libinput->log_ring.records[libinput->log_ring.head];
+	libinput->log_ring.head = (libinput->log_ring.head + 1) %
+				  libinput->log_ring.nrecords;
+	libinput->log_ring.count--;
+
+	if (priority)
+		*priority = rec->priority;
+
+	copied = min(len, strlen(rec->text) + 1);
+	if (copied > 0) {
+		memcpy(buf, rec->text, copied);
+		buf[copied - 1] = '\0';
+	}
+
+	return copied;
+}
+
 void
 log_msg_va(struct libinput *libinput,
 	   enum libinput_log_priority priority,
 	   const char *format,
 	   va_list args)
 {
-	if (is_logged(libinput, priority))
-		libinput->log_handler(libinput, priority, format, args);
+	if (!is_logged(libinput, priority))
+		return;
+
+	if (libinput->log_ring.nrecords > 0) {
+		log_ring_append(libinput, priority, format, args);
+		return;
+	}
+
+	libinput->log_handler(libinput, priority, format, args);
 }
 
 void
@@ -300,10 +685,24 @@ log_msg_ratelimit(struct libinput *libinput,
 	va_list args;
 	enum ratelimit_state state;
 
-	state = ratelimit_test(ratelimit);
+	/* Re-use the dispatch timestamp where we have one, the ratelimit
+	 * intervals are coarse enough that we don't need to re-read the
+	 * clock for every message. */
+	if (libinput->dispatch_time)
+		state = ratelimit_test_time(ratelimit, libinput->dispatch_time);
+	else
+		state = ratelimit_test(ratelimit);
 	if (state == RATELIMIT_EXCEEDED)
 		return;
 
+	if (ratelimit->last_suppressed) {
+		log_msg(libinput,
+			priority,
+			"%" PRIu64 " similar messages were suppressed by the rate limit\n",
+			ratelimit->last_suppressed);
+		ratelimit->last_suppressed = 0;
+	}
+
 	va_start(args, format);
 	log_msg_va(libinput, priority, format, args);
 	va_end(args);
@@ -343,6 +742,18 @@ static void
 libinput_post_event(struct libinput *libinput,
 		    struct libinput_event *event);
 
+static void
+libinput_drain_post_ring(struct libinput *libinput);
+
+static void
+libinput_memory_shrink(struct libinput *libinput);
+
+static void
+libinput_idle_timer_func(uint64_t now, void *data);
+
+static void
+libinput_idle_note_activity(struct libinput *libinput, uint64_t now);
+
 LIBINPUT_EXPORT enum libinput_event_type
 libinput_event_get_type(struct libinput_event *event)
 {
@@ -494,6 +905,17 @@ libinput_event_keyboard_get_time_usec(struct libinput_event_keyboard *event)
 	return event->time;
 }
 
+LIBINPUT_EXPORT uint64_t
+libinput_event_keyboard_get_hw_time_usec(struct libinput_event_keyboard *event)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_KEYBOARD_KEY);
+
+	return event->base.hw_time;
+}
+
 LIBINPUT_EXPORT uint32_t
 libinput_event_keyboard_get_key(struct libinput_event_keyboard *event)
 {
@@ -562,6 +984,23 @@ libinput_event_pointer_get_time_usec(struct libinput_event_pointer *event)
 	return event->time;
 }
 
+LIBINPUT_EXPORT uint64_t
+libinput_event_pointer_get_hw_time_usec(struct libinput_event_pointer *event)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_POINTER_MOTION,
+			   LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE,
+			   LIBINPUT_EVENT_POINTER_BUTTON,
+			   LIBINPUT_EVENT_POINTER_SCROLL_WHEEL,
+			   LIBINPUT_EVENT_POINTER_SCROLL_FINGER,
+			   LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS,
+			   LIBINPUT_EVENT_POINTER_AXIS);
+
+	return event->base.hw_time;
+}
+
 LIBINPUT_EXPORT double
 libinput_event_pointer_get_dx(struct libinput_event_pointer *event)
 {
@@ -664,6 +1103,78 @@ libinput_event_pointer_get_absolute_y_transformed(
 	return evdev_device_transform_y(device, event->absolute.y, height);
 }
 
+/* Screen transform with the scale factors precomputed at creation time,
+ * so the per-event cost is one multiply-add per axis instead of
+ * recomputing the axis ranges and dividing on every call */
+struct libinput_device_transform {
+	struct libinput_device *device;
+	double mult_x, off_x;
+	double mult_y, off_y;
+};
+
+LIBINPUT_EXPORT struct libinput_device_transform *
+libinput_device_transform_create(struct libinput_device *device,
+				 uint32_t width,
+				 uint32_t height)
+{
+	struct evdev_device *evdev = evdev_device(device);
+	const struct input_absinfo *x = evdev->abs.absinfo_x,
+				   *y = evdev->abs.absinfo_y;
+	struct libinput_device_transform *transform;
+
+	if (!x || !y)
+		return NULL;
+
+	transform = zalloc(sizeof *transform);
+	transform->device = libinput_device_ref(device);
+	/* Same math as scale_axis(), folded into a multiplier and an
+	 * offset per axis */
+	transform->mult_x = (double)width /
+			    (x->maximum - x->minimum + 1);
+	transform->off_x = -x->minimum * transform->mult_x;
+	transform->mult_y = (double)height /
+			    (y->maximum - y->minimum + 1);
+	transform->off_y = -y->minimum * transform->mult_y;
+
+	return transform;
+}
+
+LIBINPUT_EXPORT void
+libinput_device_transform_destroy(struct libinput_device_transform *transform)
+{
+	if (!transform)
+		return;
+
+	libinput_device_unref(transform->device);
+	free(transform);
+}
+
+LIBINPUT_EXPORT double
+libinput_event_pointer_get_absolute_x_transformed_by(
+	struct libinput_event_pointer *event,
+	const struct libinput_device_transform *transform)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE);
+
+	return event->absolute.x * transform->mult_x + transform->off_x;
+}
+
+LIBINPUT_EXPORT double
+libinput_event_pointer_get_absolute_y_transformed_by(
+	struct libinput_event_pointer *event,
+	const struct libinput_device_transform *transform)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE);
+
+	return event->absolute.y * transform->mult_y + transform->off_y;
+}
+
 LIBINPUT_EXPORT uint32_t
 libinput_event_pointer_get_button(struct libinput_event_pointer *event)
 {
@@ -871,6 +1382,21 @@ libinput_event_touch_get_time_usec(struct libinput_event_touch *event)
 	return event->time;
 }
 
+LIBINPUT_EXPORT uint64_t
+libinput_event_touch_get_hw_time_usec(struct libinput_event_touch *event)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TOUCH_DOWN,
+			   LIBINPUT_EVENT_TOUCH_UP,
+			   LIBINPUT_EVENT_TOUCH_MOTION,
+			   LIBINPUT_EVENT_TOUCH_CANCEL,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	return event->base.hw_time;
+}
+
 LIBINPUT_EXPORT int32_t
 libinput_event_touch_get_slot(struct libinput_event_touch *event)
 {
@@ -944,39 +1470,241 @@ libinput_event_touch_get_y_transformed(struct libinput_event_touch *event,
 }
 
 LIBINPUT_EXPORT double
-libinput_event_touch_get_y(struct libinput_event_touch *event)
+libinput_event_touch_get_x_transformed_by(
+	struct libinput_event_touch *event,
+	const struct libinput_device_transform *transform)
 {
-	struct evdev_device *device = evdev_device(event->base.device);
-
 	require_event_type(libinput_event_get_context(&event->base),
 			   event->base.type,
 			   0,
 			   LIBINPUT_EVENT_TOUCH_DOWN,
 			   LIBINPUT_EVENT_TOUCH_MOTION);
 
-	return evdev_convert_to_mm(device->abs.absinfo_y, event->point.y);
+	return event->point.x * transform->mult_x + transform->off_x;
 }
 
-LIBINPUT_EXPORT uint32_t
-libinput_event_gesture_get_time(struct libinput_event_gesture *event)
+LIBINPUT_EXPORT double
+libinput_event_touch_get_y_transformed_by(
+	struct libinput_event_touch *event,
+	const struct libinput_device_transform *transform)
 {
 	require_event_type(libinput_event_get_context(&event->base),
 			   event->base.type,
 			   0,
-			   LIBINPUT_EVENT_GESTURE_PINCH_BEGIN,
-			   LIBINPUT_EVENT_GESTURE_PINCH_UPDATE,
-			   LIBINPUT_EVENT_GESTURE_PINCH_END,
-			   LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN,
-			   LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE,
-			   LIBINPUT_EVENT_GESTURE_SWIPE_END,
-			   LIBINPUT_EVENT_GESTURE_HOLD_BEGIN,
-			   LIBINPUT_EVENT_GESTURE_HOLD_END);
+			   LIBINPUT_EVENT_TOUCH_DOWN,
+			   LIBINPUT_EVENT_TOUCH_MOTION);
 
-	return us2ms(event->time);
+	return event->point.y * transform->mult_y + transform->off_y;
 }
 
-LIBINPUT_EXPORT uint64_t
-libinput_event_gesture_get_time_usec(struct libinput_event_gesture *event)
+LIBINPUT_EXPORT double
+libinput_event_touch_get_y(struct libinput_event_touch *event)
+{
+	struct evdev_device *device = evdev_device(event->base.device);
+
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TOUCH_DOWN,
+			   LIBINPUT_EVENT_TOUCH_MOTION);
+
+	return evdev_convert_to_mm(device->abs.absinfo_y, event->point.y);
+}
+
+static inline bool
+touch_frame_change_index_is_valid(struct libinput_event_touch *event,
+				  size_t index)
+{
+	if (index >= event->nchanges) {
+		log_bug_client(libinput_event_get_context(&event->base),
+			       "Invalid touch frame change index %zu\n",
+			       index);
+		return false;
+	}
+
+	return true;
+}
+
+LIBINPUT_EXPORT size_t
+libinput_event_touch_frame_get_num_changes(struct libinput_event_touch *event)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	return event->nchanges;
+}
+
+LIBINPUT_EXPORT enum libinput_event_type
+libinput_event_touch_frame_get_change_type(struct libinput_event_touch *event,
+					   size_t index)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   LIBINPUT_EVENT_NONE,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	if (!touch_frame_change_index_is_valid(event, index))
+		return LIBINPUT_EVENT_NONE;
+
+	return event->changes[index].type;
+}
+
+LIBINPUT_EXPORT int32_t
+libinput_event_touch_frame_get_slot(struct libinput_event_touch *event,
+				    size_t index)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   -1,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	if (!touch_frame_change_index_is_valid(event, index))
+		return -1;
+
+	return event->changes[index].slot;
+}
+
+LIBINPUT_EXPORT int32_t
+libinput_event_touch_frame_get_seat_slot(struct libinput_event_touch *event,
+					 size_t index)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   -1,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	if (!touch_frame_change_index_is_valid(event, index))
+		return -1;
+
+	return event->changes[index].seat_slot;
+}
+
+LIBINPUT_EXPORT double
+libinput_event_touch_frame_get_x(struct libinput_event_touch *event,
+				 size_t index)
+{
+	struct evdev_device *device = evdev_device(event->base.device);
+
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	if (!touch_frame_change_index_is_valid(event, index))
+		return 0;
+
+	return evdev_convert_to_mm(device->abs.absinfo_x,
+				   event->changes[index].point.x);
+}
+
+LIBINPUT_EXPORT double
+libinput_event_touch_frame_get_y(struct libinput_event_touch *event,
+				 size_t index)
+{
+	struct evdev_device *device = evdev_device(event->base.device);
+
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	if (!touch_frame_change_index_is_valid(event, index))
+		return 0;
+
+	return evdev_convert_to_mm(device->abs.absinfo_y,
+				   event->changes[index].point.y);
+}
+
+LIBINPUT_EXPORT double
+libinput_event_touch_frame_get_x_transformed(struct libinput_event_touch *event,
+					     size_t index,
+					     uint32_t width)
+{
+	struct evdev_device *device = evdev_device(event->base.device);
+
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	if (!touch_frame_change_index_is_valid(event, index))
+		return 0;
+
+	return evdev_device_transform_x(device,
+					event->changes[index].point.x,
+					width);
+}
+
+LIBINPUT_EXPORT double
+libinput_event_touch_frame_get_y_transformed(struct libinput_event_touch *event,
+					     size_t index,
+					     uint32_t height)
+{
+	struct evdev_device *device = evdev_device(event->base.device);
+
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	if (!touch_frame_change_index_is_valid(event, index))
+		return 0;
+
+	return evdev_device_transform_y(device,
+					event->changes[index].point.y,
+					height);
+}
+
+LIBINPUT_EXPORT size_t
+libinput_event_touch_frame_get_points_transformed_by(
+	struct libinput_event_touch *event,
+	const struct libinput_device_transform *transform,
+	double *x,
+	double *y,
+	size_t npoints)
+{
+	size_t i, n;
+
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TOUCH_FRAME);
+
+	n = min(event->nchanges, npoints);
+	for (i = 0; i < n; i++) {
+		const struct touch_frame_change *change = &event->changes[i];
+
+		x[i] = change->point.x * transform->mult_x +
+		       transform->off_x;
+		y[i] = change->point.y * transform->mult_y +
+		       transform->off_y;
+	}
+
+	return n;
+}
+
+LIBINPUT_EXPORT uint32_t
+libinput_event_gesture_get_time(struct libinput_event_gesture *event)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_GESTURE_PINCH_BEGIN,
+			   LIBINPUT_EVENT_GESTURE_PINCH_UPDATE,
+			   LIBINPUT_EVENT_GESTURE_PINCH_END,
+			   LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN,
+			   LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE,
+			   LIBINPUT_EVENT_GESTURE_SWIPE_END,
+			   LIBINPUT_EVENT_GESTURE_HOLD_BEGIN,
+			   LIBINPUT_EVENT_GESTURE_HOLD_END);
+
+	return us2ms(event->time);
+}
+
+LIBINPUT_EXPORT uint64_t
+libinput_event_gesture_get_time_usec(struct libinput_event_gesture *event)
 {
 	require_event_type(libinput_event_get_context(&event->base),
 			   event->base.type,
@@ -993,6 +1721,24 @@ libinput_event_gesture_get_time_usec(struct libinput_event_gesture *event)
 	return event->time;
 }
 
+LIBINPUT_EXPORT uint64_t
+libinput_event_gesture_get_hw_time_usec(struct libinput_event_gesture *event)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_GESTURE_PINCH_BEGIN,
+			   LIBINPUT_EVENT_GESTURE_PINCH_UPDATE,
+			   LIBINPUT_EVENT_GESTURE_PINCH_END,
+			   LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN,
+			   LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE,
+			   LIBINPUT_EVENT_GESTURE_SWIPE_END,
+			   LIBINPUT_EVENT_GESTURE_HOLD_BEGIN,
+			   LIBINPUT_EVENT_GESTURE_HOLD_END);
+
+	return event->base.hw_time;
+}
+
 LIBINPUT_EXPORT int
 libinput_event_gesture_get_finger_count(struct libinput_event_gesture *event)
 {
@@ -1603,6 +2349,20 @@ libinput_event_tablet_tool_get_time_usec(struct libinput_event_tablet_tool *even
 	return event->time;
 }
 
+LIBINPUT_EXPORT uint64_t
+libinput_event_tablet_tool_get_hw_time_usec(struct libinput_event_tablet_tool *event)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TABLET_TOOL_AXIS,
+			   LIBINPUT_EVENT_TABLET_TOOL_TIP,
+			   LIBINPUT_EVENT_TABLET_TOOL_BUTTON,
+			   LIBINPUT_EVENT_TABLET_TOOL_PROXIMITY);
+
+	return event->base.hw_time;
+}
+
 LIBINPUT_EXPORT uint32_t
 libinput_event_tablet_tool_get_button(struct libinput_event_tablet_tool *event)
 {
@@ -1732,6 +2492,32 @@ libinput_tablet_tool_get_user_data(struct libinput_tablet_tool *tool)
 	return tool->user_data;
 }
 
+struct list *
+libinput_tool_hash_bucket(struct libinput *libinput,
+			  enum libinput_tablet_tool_type type,
+			  uint32_t serial)
+{
+	uint32_t hash = (serial ^ (uint32_t)type) * 2654435761U;
+
+	return &libinput->tool_hash[hash %
+				    ARRAY_LENGTH(libinput->tool_hash)];
+}
+
+struct libinput_tablet_tool *
+libinput_tool_alloc(struct libinput *libinput)
+{
+	struct libinput_tablet_tool *tool;
+
+	if (list_empty(&libinput->tool_pool))
+		return zalloc_tagged(sizeof *tool, ALLOC_TAG_TOOL);
+
+	tool = list_first_entry(&libinput->tool_pool, tool, link);
+	list_remove(&tool->link);
+	memset(tool, 0, sizeof *tool);
+
+	return tool;
+}
+
 LIBINPUT_EXPORT struct libinput_tablet_tool *
 libinput_tablet_tool_ref(struct libinput_tablet_tool *tool)
 {
@@ -1749,7 +2535,13 @@ libinput_tablet_tool_unref(struct libinput_tablet_tool *tool)
 		return tool;
 
 	list_remove(&tool->link);
-	free(tool);
+	list_remove(&tool->hash_link);
+	if (tool->libinput) {
+		list_insert(&tool->libinput->tool_pool, &tool->link);
+	} else {
+		alloc_account_free(ALLOC_TAG_TOOL, sizeof *tool);
+		free(tool);
+	}
 	return NULL;
 }
 
@@ -1808,6 +2600,17 @@ libinput_event_switch_get_time_usec(struct libinput_event_switch *event)
 	return event->time;
 }
 
+LIBINPUT_EXPORT uint64_t
+libinput_event_switch_get_hw_time_usec(struct libinput_event_switch *event)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_SWITCH_TOGGLE);
+
+	return event->base.hw_time;
+}
+
 struct libinput_source *
 libinput_add_fd(struct libinput *libinput,
 		int fd,
@@ -1831,6 +2634,13 @@ libinput_add_fd(struct libinput *libinput,
 		return NULL;
 	}
 
+	if (libinput->uring &&
+	    libinput_uring_add_source(libinput, source) < 0) {
+		epoll_ctl(libinput->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+		free(source);
+		return NULL;
+	}
+
 	return source;
 }
 
@@ -1838,11 +2648,44 @@ void
 libinput_remove_source(struct libinput *libinput,
 		       struct libinput_source *source)
 {
+	if (libinput->uring)
+		libinput_uring_remove_source(libinput, source);
 	epoll_ctl(libinput->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
 	source->fd = -1;
 	list_insert(&libinput->source_destroy_list, &source->link);
 }
 
+/* Opt-in allocation watchdog: LIBINPUT_DEBUG_ALLOCATIONS=<ncycles>
+ * samples the process-wide zalloc counter around every dispatch cycle.
+ * For the first ncycles cycles allocations are expected - event pool
+ * slabs fill, the queue ring grows to its high-water size, filters and
+ * state machines warm up - and only the worst cycle is recorded. After
+ * the warmup a cycle that allocates at all is a bug and aborts, turning
+ * "motion traffic is allocation-free in steady state" from an
+ * aspiration into an invariant a test run can enforce. Requires an
+ * -Dalloc-stats build, the counter reads zero otherwise. */
+static void
+libinput_alloc_watch_init(struct libinput *libinput)
+{
+	const char *env = getenv("LIBINPUT_DEBUG_ALLOCATIONS");
+	unsigned int warmup;
+
+	if (!env)
+		return;
+
+#if HAVE_ALLOC_STATS
+	if (!safe_atou(env, &warmup) || warmup == 0)
+		warmup = 1024;
+
+	libinput->alloc_watch.enabled = true;
+	libinput->alloc_watch.warmup = warmup;
+	libinput->alloc_watch.last_count = alloc_zalloc_count();
+#else
+	log_error(libinput,
+		  "LIBINPUT_DEBUG_ALLOCATIONS requires an alloc-stats build\n");
+#endif
+}
+
 int
 libinput_init(struct libinput *libinput,
 	      const struct libinput_interface *interface,
@@ -1856,41 +2699,97 @@ libinput_init(struct libinput *libinput,
 	if (libinput->epoll_fd < 0)
 		return -1;
 
-	libinput->events_len = 4;
-	libinput->events = zalloc(libinput->events_len * sizeof(*libinput->events));
+	/* Sized so a typical frame's worth of events queues without
+	 * growing the ring */
+	libinput->events_len = EVENT_QUEUE_INITIAL_LEN;
+	libinput->events = zalloc_tagged(libinput->events_len *
+					 sizeof(*libinput->events),
+					 ALLOC_TAG_QUEUE);
+	libinput->post_ring_slots = zalloc(LIBINPUT_POST_RING_SIZE *
+					   sizeof(*libinput->post_ring_slots));
+	mpsc_ring_init(&libinput->post_ring,
+		       libinput->post_ring_slots,
+		       LIBINPUT_POST_RING_SIZE);
+	libinput->event_pool = libinput_event_pool_create();
 	libinput->log_handler = libinput_default_log_func;
 	libinput->log_priority = LIBINPUT_LOG_PRIORITY_ERROR;
 	libinput->interface = interface;
 	libinput->interface_backend = interface_backend;
 	libinput->user_data = user_data;
 	libinput->refcount = 1;
+	libinput->legacy_scroll_events = true;
+	libinput->startup_timings =
+		getenv("LIBINPUT_STARTUP_TIMINGS") != NULL;
+	libinput->latency_stats =
+		getenv("LIBINPUT_LATENCY_STATS") != NULL;
+	libinput_alloc_watch_init(libinput);
+	libinput->crash_shadow.magic = CRASH_SHADOW_MAGIC;
+	libinput->crash_shadow.version = CRASH_SHADOW_VERSION;
 	list_init(&libinput->source_destroy_list);
+	list_init(&libinput->device_destroy_list);
 	list_init(&libinput->seat_list);
 	list_init(&libinput->device_group_list);
 	list_init(&libinput->tool_list);
+	for (size_t i = 0; i < ARRAY_LENGTH(libinput->tool_hash); i++)
+		list_init(&libinput->tool_hash[i]);
+	list_init(&libinput->tool_pool);
+	list_init(&libinput->preopened_devices);
+	list_init(&libinput->interned_strings);
+	list_init(&libinput->gesture_matchers);
+
+	/* Must be up before the timer subsystem so the timerfd is
+	 * registered with the ring, too */
+	if (libinput_uring_requested() &&
+	    libinput_uring_init(libinput) < 0)
+		log_info(libinput,
+			 "io_uring dispatch requested but unavailable, using epoll\n");
+
+	if (libinput_export_requested())
+		libinput->export_ring = libinput_export_create(libinput);
+
+	if (libinput_position_export_requested())
+		libinput->position_page =
+			libinput_position_export_create(libinput);
+
+	if (libinput_touch_journal_requested())
+		libinput->touch_journal =
+			libinput_touch_journal_create(libinput);
+
+	if (libinput_stats_export_requested())
+		libinput->stats_page = libinput_stats_export_create(libinput);
+
+	if (libinput_audit_requested())
+		libinput->audit_log = libinput_audit_create(libinput);
 
 	if (libinput_timer_subsys_init(libinput) != 0) {
+		libinput_uring_destroy(libinput);
+		libinput_event_pool_close(libinput->event_pool);
+		alloc_account_free(ALLOC_TAG_QUEUE,
+				   libinput->events_len *
+				   sizeof(*libinput->events));
 		free(libinput->events);
+		free(libinput->post_ring_slots);
 		close(libinput->epoll_fd);
 		return -1;
 	}
 
+	/* Armed on demand, see libinput_set_idle_timeout() */
+	libinput_timer_init(&libinput->idle.timer,
+			    libinput,
+			    "idle",
+			    libinput_idle_timer_func,
+			    libinput);
+
 	return 0;
 }
 
-void
-libinput_init_quirks(struct libinput *libinput)
+static struct quirks_context *
+libinput_quirks_parse(struct libinput *libinput)
 {
 	const char *data_path,
 	           *override_file = NULL;
 	struct quirks_context *quirks;
 
-	if (libinput->quirks_initialized)
-		return;
-
-	/* If we fail, we'll fail next time too */
-	libinput->quirks_initialized = true;
-
 	data_path = getenv("LIBINPUT_QUIRKS_DIR");
 	if (!data_path) {
 		data_path = LIBINPUT_QUIRKS_DIR;
@@ -1902,7 +2801,7 @@ libinput_init_quirks(struct libinput *libinput)
 				       log_msg_va,
 				       libinput,
 				       QLOG_LIBINPUT_LOGGING);
-	if (!quirks) {
+	if (!quirks)
 		log_error(libinput,
 			  "Failed to load the device quirks from %s%s%s. "
 			  "This will negatively affect device behavior. "
@@ -1912,33 +2811,127 @@ libinput_init_quirks(struct libinput *libinput)
 			  override_file ? override_file : "",
 			  HTTP_DOC_LINK
 			  );
-		return;
-	}
 
-	libinput->quirks = quirks;
+	return quirks;
 }
 
-static void
-libinput_device_destroy(struct libinput_device *device);
+void
+libinput_init_quirks(struct libinput *libinput)
+{
+	struct quirks_context *quirks;
+	struct libinput_phase_timing timing;
 
-static void
-libinput_seat_destroy(struct libinput_seat *seat);
+	if (libinput->quirks_initialized)
+		return;
 
-static void
-libinput_drop_destroyed_sources(struct libinput *libinput)
-{
-	struct libinput_source *source;
+	libinput_timing_start(libinput, &timing);
 
-	list_for_each_safe(source, &libinput->source_destroy_list, link)
-		free(source);
-	list_init(&libinput->source_destroy_list);
-}
+	/* If we fail, we'll fail next time too */
+	libinput->quirks_initialized = true;
 
-LIBINPUT_EXPORT struct libinput *
-libinput_ref(struct libinput *libinput)
-{
-	libinput->refcount++;
-	return libinput;
+	quirks = libinput_quirks_parse(libinput);
+	if (!quirks)
+		return;
+
+	libinput->quirks = quirks;
+	libinput_timing_log(libinput, &timing, "quirks-init", NULL);
+}
+
+LIBINPUT_EXPORT int
+libinput_quirks_reload(struct libinput *libinput)
+{
+	struct quirks_context *old_ctx, *new_ctx;
+	struct libinput_device **affected;
+	size_t naffected = 0,
+	       ndevices = 0;
+	struct libinput_seat *seat;
+	struct libinput_device *device;
+
+	/* Nothing loaded yet, this is a plain init */
+	if (!libinput->quirks) {
+		libinput->quirks_initialized = false;
+		libinput_init_quirks(libinput);
+		return libinput->quirks ? 0 : -1;
+	}
+
+	new_ctx = libinput_quirks_parse(libinput);
+	if (!new_ctx)
+		return -1; /* parse failure, keep the current quirks */
+
+	old_ctx = libinput->quirks;
+
+	list_for_each(seat, &libinput->seat_list, link) {
+		list_for_each(device, &seat->devices_list, link)
+			ndevices++;
+	}
+	affected = zalloc(max(ndevices, 1) * sizeof(*affected));
+
+	/* Diff each device's resolved quirk set between the old and the
+	 * new context; devices whose effective values are unchanged are
+	 * not touched at all */
+	list_for_each(seat, &libinput->seat_list, link) {
+		list_for_each(device, &seat->devices_list, link) {
+			struct udev_device *udev_device =
+				evdev_device(device)->udev_device;
+			struct quirks *old_q, *new_q;
+
+			old_q = quirks_fetch_for_device(old_ctx, udev_device);
+			new_q = quirks_fetch_for_device(new_ctx, udev_device);
+			if (!quirks_sets_equal(old_q, new_q))
+				affected[naffected++] =
+					libinput_device_ref(device);
+			quirks_unref(old_q);
+			quirks_unref(new_q);
+		}
+	}
+
+	libinput->quirks = new_ctx;
+	quirks_context_unref(old_ctx);
+
+	/* Re-probe through the backend's seat-change path: it removes
+	 * and recreates the device on its current seat, which re-reads
+	 * the quirks and rebuilds the derived configuration */
+	for (size_t i = 0; i < naffected; i++) {
+		char *seat_name;
+
+		device = affected[i];
+		seat_name = safe_strdup(device->seat->logical_name);
+		if (libinput->interface_backend->device_change_seat(device,
+								    seat_name) != 0)
+			log_error(libinput,
+				  "Failed to re-probe a device after a quirks reload\n");
+		free(seat_name);
+		libinput_device_unref(device);
+	}
+	free(affected);
+
+	return (int)naffected;
+}
+
+static void
+libinput_device_destroy(struct libinput_device *device);
+
+static void
+libinput_drop_destroyed_devices(struct libinput *libinput);
+
+static void
+libinput_seat_destroy(struct libinput_seat *seat);
+
+static void
+libinput_drop_destroyed_sources(struct libinput *libinput)
+{
+	struct libinput_source *source;
+
+	list_for_each_safe(source, &libinput->source_destroy_list, link)
+		free(source);
+	list_init(&libinput->source_destroy_list);
+}
+
+LIBINPUT_EXPORT struct libinput *
+libinput_ref(struct libinput *libinput)
+{
+	libinput->refcount++;
+	return libinput;
 }
 
 LIBINPUT_EXPORT struct libinput *
@@ -1962,10 +2955,29 @@ libinput_unref(struct libinput *libinput)
 
 	libinput->interface_backend->destroy(libinput);
 
+	libinput_drain_post_ring(libinput);
 	while ((event = libinput_get_event(libinput)))
 	       libinput_event_destroy(event);
 
-	free(libinput->events);
+	libinput_drop_destroyed_devices(libinput);
+
+	alloc_account_free(ALLOC_TAG_QUEUE,
+			   libinput->events_len * sizeof(*libinput->events));
+	if (libinput->events_hooked)
+		libinput->alloc_hooks.free(
+				libinput->events,
+				libinput->events_len * sizeof(*libinput->events),
+				libinput->alloc_hooks.user_data);
+	else
+		free(libinput->events);
+	if (libinput->prio_len > 0)
+		alloc_account_free(ALLOC_TAG_QUEUE,
+				   libinput->prio_len *
+				   sizeof(*libinput->prio_events));
+	free(libinput->prio_events);
+	free(libinput->post_ring_slots);
+	free(libinput->log_ring.records);
+	libinput_event_pool_close(libinput->event_pool);
 
 	list_for_each_safe(seat, &libinput->seat_list, link) {
 		list_for_each_safe(device,
@@ -1986,9 +2998,26 @@ libinput_unref(struct libinput *libinput)
 		libinput_tablet_tool_unref(tool);
 	}
 
+	/* including the ones the loop above just recycled */
+	list_for_each_safe(tool, &libinput->tool_pool, link) {
+		alloc_account_free(ALLOC_TAG_TOOL, sizeof *tool);
+		free(tool);
+	}
+
+	libinput_timer_cancel(&libinput->idle.timer);
+	libinput_timer_destroy(&libinput->idle.timer);
 	libinput_timer_subsys_destroy(libinput);
 	libinput_drop_destroyed_sources(libinput);
+	libinput_drop_preopened_devices(libinput);
+	libinput_drop_interned_strings(libinput);
+	libinput_drop_gesture_matchers(libinput);
 	quirks_context_unref(libinput->quirks);
+	libinput_uring_destroy(libinput);
+	libinput_export_destroy(libinput->export_ring);
+	libinput_position_export_destroy(libinput->position_page);
+	libinput_touch_journal_destroy(libinput->touch_journal);
+	libinput_stats_export_destroy(libinput->stats_page);
+	libinput_audit_destroy(libinput->audit_log);
 	close(libinput->epoll_fd);
 	free(libinput);
 
@@ -2008,6 +3037,12 @@ libinput_event_tablet_pad_destroy(struct libinput_event_tablet_pad *event)
 		libinput_tablet_pad_mode_group_unref(event->mode_group);
 }
 
+static void
+libinput_event_touch_frame_destroy(struct libinput_event_touch *event)
+{
+	free(event->changes);
+}
+
 LIBINPUT_EXPORT void
 libinput_event_destroy(struct libinput_event *event)
 {
@@ -2029,6 +3064,10 @@ libinput_event_destroy(struct libinput_event *event)
 		libinput_event_tablet_pad_destroy(
 		   libinput_event_get_tablet_pad_event(event));
 		break;
+	case LIBINPUT_EVENT_TOUCH_FRAME:
+		libinput_event_touch_frame_destroy(
+		   libinput_event_get_touch_event(event));
+		break;
 	default:
 		break;
 	}
@@ -2036,7 +3075,373 @@ libinput_event_destroy(struct libinput_event *event)
 	if (event->device)
 		libinput_device_unref(event->device);
 
-	free(event);
+	if (event->pool)
+		libinput_event_pool_put(event->pool, event);
+	else
+		free(event);
+}
+
+static size_t
+event_wire_size(struct libinput_event *event)
+{
+	struct libinput_event_touch *touch;
+
+	switch (event->type) {
+	case LIBINPUT_EVENT_KEYBOARD_KEY:
+		return sizeof(struct libinput_event_wire_keyboard);
+	case LIBINPUT_EVENT_POINTER_MOTION:
+	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+	case LIBINPUT_EVENT_POINTER_BUTTON:
+	case LIBINPUT_EVENT_POINTER_AXIS:
+	case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:
+	case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
+	case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS:
+		return sizeof(struct libinput_event_wire_pointer);
+	case LIBINPUT_EVENT_TOUCH_DOWN:
+	case LIBINPUT_EVENT_TOUCH_UP:
+	case LIBINPUT_EVENT_TOUCH_MOTION:
+	case LIBINPUT_EVENT_TOUCH_CANCEL:
+	case LIBINPUT_EVENT_TOUCH_FRAME:
+		touch = (struct libinput_event_touch *)event;
+		return sizeof(struct libinput_event_wire_touch) +
+		       touch->nchanges *
+		       sizeof(struct libinput_event_wire_touch_change);
+	case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+	case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_PINCH_END:
+	case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_HOLD_END:
+		return sizeof(struct libinput_event_wire_gesture);
+	case LIBINPUT_EVENT_SWITCH_TOGGLE:
+		return sizeof(struct libinput_event_wire_switch);
+	default:
+		return 0; /* no wire representation */
+	}
+}
+
+LIBINPUT_EXPORT int
+libinput_event_serialize(struct libinput_event *event,
+			 void *buffer,
+			 size_t size)
+{
+	size_t required = event_wire_size(event);
+	struct libinput_event_wire_header header;
+
+	if (required == 0)
+		return -1;
+
+	if (buffer == NULL)
+		return required;
+
+	if (size < required)
+		return -1;
+
+	memset(&header, 0, sizeof(header));
+	header.version = LIBINPUT_EVENT_WIRE_VERSION;
+	header.type = event->type;
+	header.size = required;
+	header.hw_time = event->hw_time;
+
+	switch (event->type) {
+	case LIBINPUT_EVENT_KEYBOARD_KEY: {
+		struct libinput_event_keyboard *keyboard =
+			(struct libinput_event_keyboard *)event;
+		struct libinput_event_wire_keyboard wire;
+
+		memset(&wire, 0, sizeof(wire));
+		header.time = keyboard->time;
+		wire.header = header;
+		wire.key = keyboard->key;
+		wire.state = keyboard->state;
+		wire.seat_key_count = keyboard->seat_key_count;
+		memcpy(buffer, &wire, sizeof(wire));
+		break;
+	}
+	case LIBINPUT_EVENT_POINTER_MOTION:
+	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+	case LIBINPUT_EVENT_POINTER_BUTTON:
+	case LIBINPUT_EVENT_POINTER_AXIS:
+	case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:
+	case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
+	case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS: {
+		struct libinput_event_pointer *pointer =
+			(struct libinput_event_pointer *)event;
+		struct libinput_event_wire_pointer wire;
+
+		memset(&wire, 0, sizeof(wire));
+		header.time = pointer->time;
+		wire.header = header;
+		wire.delta_x = pointer->delta.x;
+		wire.delta_y = pointer->delta.y;
+		wire.delta_raw_x = pointer->delta_raw.x;
+		wire.delta_raw_y = pointer->delta_raw.y;
+		wire.absolute_x = pointer->absolute.x;
+		wire.absolute_y = pointer->absolute.y;
+		wire.discrete_x = pointer->discrete.x;
+		wire.discrete_y = pointer->discrete.y;
+		wire.v120_x = pointer->v120.x;
+		wire.v120_y = pointer->v120.y;
+		wire.button = pointer->button;
+		wire.seat_button_count = pointer->seat_button_count;
+		wire.state = pointer->state;
+		wire.source = pointer->source;
+		wire.axes = pointer->axes;
+		memcpy(buffer, &wire, sizeof(wire));
+		break;
+	}
+	case LIBINPUT_EVENT_TOUCH_DOWN:
+	case LIBINPUT_EVENT_TOUCH_UP:
+	case LIBINPUT_EVENT_TOUCH_MOTION:
+	case LIBINPUT_EVENT_TOUCH_CANCEL:
+	case LIBINPUT_EVENT_TOUCH_FRAME: {
+		struct libinput_event_touch *touch =
+			(struct libinput_event_touch *)event;
+		struct libinput_event_wire_touch wire;
+		struct libinput_event_wire_touch_change change;
+		char *dest = buffer;
+		size_t i;
+
+		memset(&wire, 0, sizeof(wire));
+		header.time = touch->time;
+		wire.header = header;
+		wire.slot = touch->slot;
+		wire.seat_slot = touch->seat_slot;
+		wire.point_x = touch->point.x;
+		wire.point_y = touch->point.y;
+		wire.nchanges = touch->nchanges;
+		memcpy(dest, &wire, sizeof(wire));
+		dest += sizeof(wire);
+
+		for (i = 0; i < touch->nchanges; i++) {
+			memset(&change, 0, sizeof(change));
+			change.type = touch->changes[i].type;
+			change.slot = touch->changes[i].slot;
+			change.seat_slot = touch->changes[i].seat_slot;
+			change.point_x = touch->changes[i].point.x;
+			change.point_y = touch->changes[i].point.y;
+			memcpy(dest, &change, sizeof(change));
+			dest += sizeof(change);
+		}
+		break;
+	}
+	case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+	case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_PINCH_END:
+	case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_HOLD_END: {
+		struct libinput_event_gesture *gesture =
+			(struct libinput_event_gesture *)event;
+		struct libinput_event_wire_gesture wire;
+
+		memset(&wire, 0, sizeof(wire));
+		header.time = gesture->time;
+		wire.header = header;
+		wire.finger_count = gesture->finger_count;
+		wire.cancelled = gesture->cancelled;
+		wire.delta_x = gesture->delta.x;
+		wire.delta_y = gesture->delta.y;
+		wire.delta_unaccel_x = gesture->delta_unaccel.x;
+		wire.delta_unaccel_y = gesture->delta_unaccel.y;
+		wire.scale = gesture->scale;
+		wire.angle = gesture->angle;
+		memcpy(buffer, &wire, sizeof(wire));
+		break;
+	}
+	case LIBINPUT_EVENT_SWITCH_TOGGLE: {
+		struct libinput_event_switch *sw =
+			(struct libinput_event_switch *)event;
+		struct libinput_event_wire_switch wire;
+
+		memset(&wire, 0, sizeof(wire));
+		header.time = sw->time;
+		wire.header = header;
+		wire.sw = sw->sw;
+		wire.state = sw->state;
+		memcpy(buffer, &wire, sizeof(wire));
+		break;
+	}
+	default:
+		return -1;
+	}
+
+	return required;
+}
+
+LIBINPUT_EXPORT struct libinput_event *
+libinput_event_deserialize(struct libinput_device *device,
+			   const void *buffer,
+			   size_t size)
+{
+	struct libinput_event_wire_header header;
+	struct libinput_event *event = NULL;
+
+	if (size < sizeof(header))
+		return NULL;
+
+	memcpy(&header, buffer, sizeof(header));
+	if (header.version != LIBINPUT_EVENT_WIRE_VERSION ||
+	    header.size > size)
+		return NULL;
+
+	switch ((enum libinput_event_type)header.type) {
+	case LIBINPUT_EVENT_KEYBOARD_KEY: {
+		struct libinput_event_wire_keyboard wire;
+		struct libinput_event_keyboard *keyboard;
+
+		if (header.size < sizeof(wire))
+			return NULL;
+		memcpy(&wire, buffer, sizeof(wire));
+
+		keyboard = event_alloc(device);
+		*keyboard = (struct libinput_event_keyboard) {
+			.time = wire.header.time,
+			.key = wire.key,
+			.state = wire.state,
+			.seat_key_count = wire.seat_key_count,
+		};
+		event = &keyboard->base;
+		break;
+	}
+	case LIBINPUT_EVENT_POINTER_MOTION:
+	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+	case LIBINPUT_EVENT_POINTER_BUTTON:
+	case LIBINPUT_EVENT_POINTER_AXIS:
+	case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:
+	case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
+	case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS: {
+		struct libinput_event_wire_pointer wire;
+		struct libinput_event_pointer *pointer;
+
+		if (header.size < sizeof(wire))
+			return NULL;
+		memcpy(&wire, buffer, sizeof(wire));
+
+		pointer = event_alloc(device);
+		*pointer = (struct libinput_event_pointer) {
+			.time = wire.header.time,
+			.delta = { wire.delta_x, wire.delta_y },
+			.delta_raw = { wire.delta_raw_x, wire.delta_raw_y },
+			.absolute = { wire.absolute_x, wire.absolute_y },
+			.discrete = { wire.discrete_x, wire.discrete_y },
+			.v120 = { wire.v120_x, wire.v120_y },
+			.button = wire.button,
+			.seat_button_count = wire.seat_button_count,
+			.state = wire.state,
+			.source = wire.source,
+			.axes = wire.axes,
+		};
+		event = &pointer->base;
+		break;
+	}
+	case LIBINPUT_EVENT_TOUCH_DOWN:
+	case LIBINPUT_EVENT_TOUCH_UP:
+	case LIBINPUT_EVENT_TOUCH_MOTION:
+	case LIBINPUT_EVENT_TOUCH_CANCEL:
+	case LIBINPUT_EVENT_TOUCH_FRAME: {
+		struct libinput_event_wire_touch wire;
+		struct libinput_event_wire_touch_change change;
+		struct libinput_event_touch *touch;
+		struct touch_frame_change *changes = NULL;
+		const char *src = buffer;
+		size_t i;
+
+		if (header.size < sizeof(wire))
+			return NULL;
+		memcpy(&wire, buffer, sizeof(wire));
+
+		if (header.size < sizeof(wire) +
+				  wire.nchanges * sizeof(change))
+			return NULL;
+
+		if (wire.nchanges) {
+			changes = zalloc(wire.nchanges * sizeof(*changes));
+			src += sizeof(wire);
+			for (i = 0; i < wire.nchanges; i++) {
+				memcpy(&change, src, sizeof(change));
+				changes[i].type = change.type;
+				changes[i].slot = change.slot;
+				changes[i].seat_slot = change.seat_slot;
+				changes[i].point.x = change.point_x;
+				changes[i].point.y = change.point_y;
+				src += sizeof(change);
+			}
+		}
+
+		touch = event_alloc(device);
+		*touch = (struct libinput_event_touch) {
+			.time = wire.header.time,
+			.slot = wire.slot,
+			.seat_slot = wire.seat_slot,
+			.point = { wire.point_x, wire.point_y },
+			.changes = changes,
+			.nchanges = wire.nchanges,
+		};
+		event = &touch->base;
+		break;
+	}
+	case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+	case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_PINCH_END:
+	case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
+	case LIBINPUT_EVENT_GESTURE_HOLD_END: {
+		struct libinput_event_wire_gesture wire;
+		struct libinput_event_gesture *gesture;
+
+		if (header.size < sizeof(wire))
+			return NULL;
+		memcpy(&wire, buffer, sizeof(wire));
+
+		gesture = event_alloc(device);
+		*gesture = (struct libinput_event_gesture) {
+			.time = wire.header.time,
+			.finger_count = wire.finger_count,
+			.cancelled = wire.cancelled,
+			.delta = { wire.delta_x, wire.delta_y },
+			.delta_unaccel = { wire.delta_unaccel_x,
+					   wire.delta_unaccel_y },
+			.scale = wire.scale,
+			.angle = wire.angle,
+		};
+		event = &gesture->base;
+		break;
+	}
+	case LIBINPUT_EVENT_SWITCH_TOGGLE: {
+		struct libinput_event_wire_switch wire;
+		struct libinput_event_switch *sw;
+
+		if (header.size < sizeof(wire))
+			return NULL;
+		memcpy(&wire, buffer, sizeof(wire));
+
+		sw = event_alloc(device);
+		*sw = (struct libinput_event_switch) {
+			.time = wire.header.time,
+			.sw = wire.sw,
+			.state = wire.state,
+		};
+		event = &sw->base;
+		break;
+	}
+	default:
+		return NULL;
+	}
+
+	init_event_base(event, device, header.type);
+	event->hw_time = header.hw_time;
+	/* balanced by libinput_event_destroy(); queued events take this
+	 * ref in libinput_post_event() instead */
+	libinput_device_ref(device);
+
+	return event;
 }
 
 int
@@ -2054,6 +3459,175 @@ close_restricted(struct libinput *libinput, int fd)
 	libinput->interface->close_restricted(fd, libinput->user_data);
 }
 
+struct evdev_preopen {
+	struct list link;
+	char *devnode;
+	int fd;
+	struct libevdev *evdev;
+};
+
+void
+libinput_stash_preopened_device(struct libinput *libinput,
+				const char *devnode,
+				int fd,
+				struct libevdev *evdev)
+{
+	struct evdev_preopen *p = zalloc(sizeof *p);
+
+	p->devnode = safe_strdup(devnode);
+	p->fd = fd;
+	p->evdev = evdev;
+	list_insert(&libinput->preopened_devices, &p->link);
+}
+
+int
+libinput_fetch_preopened_device(struct libinput *libinput,
+				const char *devnode,
+				struct libevdev **evdev)
+{
+	struct evdev_preopen *p;
+
+	list_for_each(p, &libinput->preopened_devices, link) {
+		if (streq(p->devnode, devnode)) {
+			int fd = p->fd;
+
+			*evdev = p->evdev;
+			list_remove(&p->link);
+			free(p->devnode);
+			free(p);
+			return fd;
+		}
+	}
+
+	return -1;
+}
+
+void
+libinput_drop_preopened_devices(struct libinput *libinput)
+{
+	struct evdev_preopen *p;
+
+	list_for_each_safe(p, &libinput->preopened_devices, link) {
+		libevdev_free(p->evdev);
+		close_restricted(libinput, p->fd);
+		list_remove(&p->link);
+		free(p->devnode);
+		free(p);
+	}
+}
+
+struct interned_string {
+	struct list link;
+	char str[];
+};
+
+const char *
+libinput_intern_string(struct libinput *libinput, const char *str)
+{
+	struct interned_string *s;
+	size_t len;
+
+	if (!str)
+		return NULL;
+
+	list_for_each(s, &libinput->interned_strings, link) {
+		if (streq(s->str, str))
+			return s->str;
+	}
+
+	len = strlen(str) + 1;
+	s = zalloc(sizeof(*s) + len);
+	memcpy(s->str, str, len);
+	list_insert(&libinput->interned_strings, &s->link);
+
+	return s->str;
+}
+
+static void
+libinput_drop_interned_strings(struct libinput *libinput)
+{
+	struct interned_string *s;
+
+	list_for_each_safe(s, &libinput->interned_strings, link) {
+		list_remove(&s->link);
+		free(s);
+	}
+}
+
+struct libinput_gesture_matcher_entry {
+	struct list link;
+	libinput_gesture_matcher matcher;
+	void *user_data;
+};
+
+LIBINPUT_EXPORT int
+libinput_register_gesture_matcher(struct libinput *libinput,
+				  libinput_gesture_matcher matcher,
+				  void *user_data)
+{
+	struct libinput_gesture_matcher_entry *entry;
+
+	if (!matcher)
+		return -1;
+
+	entry = zalloc(sizeof(*entry));
+	entry->matcher = matcher;
+	entry->user_data = user_data;
+	/* append: matchers run in registration order */
+	list_append(&libinput->gesture_matchers, &entry->link);
+
+	return 0;
+}
+
+LIBINPUT_EXPORT int
+libinput_unregister_gesture_matcher(struct libinput *libinput,
+				    libinput_gesture_matcher matcher,
+				    void *user_data)
+{
+	struct libinput_gesture_matcher_entry *entry,
+					      *found = NULL;
+
+	list_for_each(entry, &libinput->gesture_matchers, link) {
+		if (entry->matcher == matcher &&
+		    entry->user_data == user_data)
+			found = entry;
+	}
+
+	if (!found)
+		return -1;
+
+	list_remove(&found->link);
+	free(found);
+
+	return 0;
+}
+
+static void
+libinput_drop_gesture_matchers(struct libinput *libinput)
+{
+	struct libinput_gesture_matcher_entry *entry;
+
+	list_for_each_safe(entry, &libinput->gesture_matchers, link) {
+		list_remove(&entry->link);
+		free(entry);
+	}
+}
+
+bool
+libinput_run_gesture_matchers(struct libinput *libinput,
+			      struct libinput_device *device,
+			      const struct libinput_gesture_frame *frame)
+{
+	struct libinput_gesture_matcher_entry *entry;
+
+	list_for_each(entry, &libinput->gesture_matchers, link) {
+		if (entry->matcher(device, frame, entry->user_data))
+			return true;
+	}
+
+	return false;
+}
+
 bool
 ignore_litest_test_suite_device(struct udev_device *device)
 {
@@ -2073,13 +3647,53 @@ libinput_seat_init(struct libinput_seat *seat,
 {
 	seat->refcount = 1;
 	seat->libinput = libinput;
-	seat->physical_name = safe_strdup(physical_name);
-	seat->logical_name = safe_strdup(logical_name);
+	seat->physical_name = libinput_intern_string(libinput, physical_name);
+	seat->logical_name = libinput_intern_string(libinput, logical_name);
 	seat->destroy = destroy;
 	list_init(&seat->devices_list);
 	list_insert(&libinput->seat_list, &seat->link);
 }
 
+void
+libinput_seat_attach_device_slot(struct libinput_seat *seat,
+				 struct libinput_device *device)
+{
+	size_t i;
+
+	for (i = 0; i < seat->devices_len; i++) {
+		if (!seat->devices[i])
+			break;
+	}
+
+	if (i == seat->devices_len) {
+		size_t len = seat->devices_len ? seat->devices_len * 2 : 8;
+		struct libinput_device **devices;
+
+		devices = zalloc(len * sizeof(*devices));
+		memcpy(devices,
+		       seat->devices,
+		       seat->devices_len * sizeof(*devices));
+		free(seat->devices);
+		seat->devices = devices;
+		seat->devices_len = len;
+	}
+
+	seat->devices[i] = device;
+	device->seat_index = i;
+	seat->devices_generation++;
+}
+
+void
+libinput_seat_detach_device_slot(struct libinput_seat *seat,
+				 struct libinput_device *device)
+{
+	assert(device->seat_index < seat->devices_len);
+	assert(seat->devices[device->seat_index] == device);
+
+	seat->devices[device->seat_index] = NULL;
+	seat->devices_generation++;
+}
+
 LIBINPUT_EXPORT struct libinput_seat *
 libinput_seat_ref(struct libinput_seat *seat)
 {
@@ -2091,8 +3705,7 @@ static void
 libinput_seat_destroy(struct libinput_seat *seat)
 {
 	list_remove(&seat->link);
-	free(seat->logical_name);
-	free(seat->physical_name);
+	free(seat->devices);
 	seat->destroy(seat);
 }
 
@@ -2145,7 +3758,9 @@ libinput_device_init(struct libinput_device *device,
 {
 	device->seat = seat;
 	device->refcount = 1;
+	device->crash_shadow_slot = -1;
 	list_init(&device->event_listeners);
+	list_init(&device->shares);
 }
 
 LIBINPUT_EXPORT struct libinput_device *
@@ -2156,12 +3771,46 @@ libinput_device_ref(struct libinput_device *device)
 }
 
 static void
-libinput_device_destroy(struct libinput_device *device)
+libinput_device_destroy_now(struct libinput_device *device)
 {
+	struct libinput_device_share *share;
+
 	assert(list_empty(&device->event_listeners));
+	list_for_each_safe(share, &device->shares, link)
+		free(share);
+	free(device->touch_frame.changes);
 	evdev_device_destroy(evdev_device(device));
 }
 
+static void
+libinput_device_destroy(struct libinput_device *device)
+{
+	struct libinput *libinput = device->seat->libinput;
+
+	/* Releasing the last ref during dispatch (e.g. a hub unplug
+	 * removing several devices in one cycle) defers the expensive
+	 * teardown - libevdev free, filters, dispatch state - until after
+	 * the event loop, in the style of
+	 * libinput_drop_destroyed_sources(). The device is already off
+	 * the seat list at this point, so its link is free to reuse. */
+	if (libinput->in_dispatch) {
+		list_insert(&libinput->device_destroy_list, &device->link);
+		return;
+	}
+
+	libinput_device_destroy_now(device);
+}
+
+static void
+libinput_drop_destroyed_devices(struct libinput *libinput)
+{
+	struct libinput_device *device;
+
+	list_for_each_safe(device, &libinput->device_destroy_list, link)
+		libinput_device_destroy_now(device);
+	list_init(&libinput->device_destroy_list);
+}
+
 LIBINPUT_EXPORT struct libinput_device *
 libinput_device_unref(struct libinput_device *device)
 {
@@ -2178,15 +3827,92 @@ libinput_device_unref(struct libinput_device *device)
 LIBINPUT_EXPORT int
 libinput_get_fd(struct libinput *libinput)
 {
+	if (libinput->uring)
+		return libinput_uring_get_fd(libinput);
+
 	return libinput->epoll_fd;
 }
 
-LIBINPUT_EXPORT int
-libinput_dispatch(struct libinput *libinput)
+/* Re-sort the events queued by this dispatch cycle by hardware
+ * timestamp, see libinput_set_event_ordering(). An insertion sort does:
+ * the batch is small and each device's stream arrives in order, so the
+ * only inversions sit at fd-iteration boundaries. Stable, per-device
+ * order is never touched; events without a hardware time (device
+ * added/removed and friends) stay put and nothing moves across them. */
+static void
+libinput_sort_queued_events(struct libinput *libinput, size_t nqueued)
+{
+	struct libinput_event **events = libinput->events;
+	size_t events_len = libinput->events_len;
+	size_t first;
+
+	if (nqueued < 2)
+		return;
+
+	first = (libinput->events_in + events_len - nqueued) % events_len;
+
+	for (size_t i = 1; i < nqueued; i++) {
+		struct libinput_event *cur = events[(first + i) % events_len];
+		size_t j = i;
+
+		if (cur->hw_time == 0)
+			continue;
+
+		while (j > 0) {
+			struct libinput_event *prev =
+				events[(first + j - 1) % events_len];
+
+			if (prev->hw_time == 0 ||
+			    prev->hw_time <= cur->hw_time)
+				break;
+
+			events[(first + j) % events_len] = prev;
+			j--;
+		}
+		events[(first + j) % events_len] = cur;
+	}
+}
+
+/* One sample of the allocation watchdog, see
+ * libinput_alloc_watch_init() for the contract */
+static void
+libinput_alloc_watch_cycle(struct libinput *libinput)
+{
+	uint64_t count = alloc_zalloc_count();
+	uint64_t ncycle = count - libinput->alloc_watch.last_count;
+
+	libinput->alloc_watch.last_count = count;
+
+	if (ncycle > libinput->alloc_watch.watermark)
+		libinput->alloc_watch.watermark = ncycle;
+
+	if (libinput->alloc_watch.warmup > 0) {
+		if (--libinput->alloc_watch.warmup == 0)
+			log_debug(libinput,
+				  "allocation watchdog armed, warmup watermark "
+				  "%" PRIu64 " allocation(s) per cycle\n",
+				  libinput->alloc_watch.watermark);
+		return;
+	}
+
+	if (ncycle == 0)
+		return;
+
+	log_bug_libinput(libinput,
+			 "%" PRIu64 " heap allocation(s) in a steady-state "
+			 "dispatch cycle\n",
+			 ncycle);
+	assert(!"bug: heap allocation in steady-state dispatch");
+}
+
+static int
+libinput_dispatch_until(struct libinput *libinput, uint64_t deadline)
 {
 	static uint8_t take_time_snapshot;
 	struct libinput_source *source;
 	struct epoll_event ep[32];
+	size_t events_count_before;
+	bool more = false;
 	int i, count;
 
 	/* Every 10 calls to libinput_dispatch() we take the current time so
@@ -2197,21 +3923,126 @@ libinput_dispatch(struct libinput *libinput)
 	else if (libinput->dispatch_time)
 		libinput->dispatch_time = 0;
 
-	count = epoll_wait(libinput->epoll_fd, ep, ARRAY_LENGTH(ep), 0);
-	if (count < 0)
-		return -errno;
+	libinput->dispatch_seq++;
 
-	for (i = 0; i < count; ++i) {
-		source = ep[i].data.ptr;
-		if (source->fd == -1)
-			continue;
+	/* One clock read per cycle: the first libinput_now() caller (or
+	 * the first kernel event timestamp) fills the cache, everything
+	 * after that reuses it until we return to the caller */
+	libinput->in_dispatch = true;
+	libinput->cached_now = libinput->dispatch_time;
+	events_count_before = libinput->events_count;
 
-		source->dispatch(source->user_data);
+	if (libinput->uring) {
+		count = libinput_uring_dispatch(libinput, deadline);
+		if (count > 0)
+			more = true;
+	} else {
+		int start = 0;
+
+		count = epoll_wait(libinput->epoll_fd, ep, ARRAY_LENGTH(ep), 0);
+		if (count < 0)
+			count = -errno;
+
+		/* With a deadline the start index rotates so the same
+		 * device cannot monopolize the budget call after call;
+		 * level-triggered epoll re-reports whatever is left
+		 * unread */
+		if (deadline && count > 0)
+			start = libinput->dispatch_seq % count;
+
+		/* Input before timers: a timeout-based decision (e.g.
+		 * tap vs motion, see tp_tap_handle_state()) must not
+		 * fire while frames preceding its deadline sit unread
+		 * in the same batch. Device sources go first; processing
+		 * their frames flushes and re-arms the timers against
+		 * the frame timestamps, so a timeout contradicted by
+		 * already-received data never fires. */
+		struct libinput_source *timer_source = NULL;
+
+		for (i = 0; i < count; ++i) {
+			source = ep[(start + i) % count].data.ptr;
+			if (source->fd == -1)
+				continue;
+
+			if (source == libinput->timer.source) {
+				timer_source = source;
+				continue;
+			}
+
+			source->dispatch(source->user_data);
+
+			/* The budget is checked between devices, one
+			 * device's pending queue is always drained in
+			 * full */
+			if (deadline && i + 1 < count &&
+			    libinput_clock_now(libinput) >= deadline) {
+				more = true;
+				break;
+			}
+		}
+
+		if (timer_source && timer_source->fd != -1 && !more)
+			timer_source->dispatch(timer_source->user_data);
+	}
+
+	/* Coalesce wakeups: a timer that expired while we processed this
+	 * batch would wake us again microseconds from now via the
+	 * timerfd. Run it against the batch time instead; the eventual
+	 * timerfd read finds nothing left to do. */
+	if (count > 0) {
+		uint64_t now = libinput_now(libinput);
+
+		if (now) {
+			libinput_timer_flush(libinput, now);
+			if (libinput->idle.timeout)
+				libinput_idle_note_activity(libinput, now);
+		}
 	}
 
+	libinput->in_dispatch = false;
+	libinput->cached_now = 0;
+
+	libinput_timer_flush_deferred(libinput);
+
+	if (count < 0)
+		return count;
+
+	libinput_drain_post_ring(libinput);
+
+	if (libinput->event_ordering)
+		libinput_sort_queued_events(libinput,
+					    libinput->events_count -
+						events_count_before);
+
 	libinput_drop_destroyed_sources(libinput);
+	libinput_drop_destroyed_devices(libinput);
 
-	return 0;
+	if (libinput->memory_budget)
+		libinput_memory_shrink(libinput);
+
+	if (libinput->alloc_watch.enabled)
+		libinput_alloc_watch_cycle(libinput);
+
+	return more ? 1 : 0;
+}
+
+LIBINPUT_EXPORT int
+libinput_dispatch(struct libinput *libinput)
+{
+	int rc = libinput_dispatch_until(libinput, 0);
+
+	return rc > 0 ? 0 : rc;
+}
+
+LIBINPUT_EXPORT int
+libinput_dispatch_budget(struct libinput *libinput, uint64_t budget)
+{
+	uint64_t deadline = 0;
+
+	if (budget)
+		deadline = libinput_clock_now(libinput) + budget;
+
+	return libinput_dispatch_until(libinput, deadline);
 }
 
 void
@@ -2289,6 +4120,7 @@ init_event_base(struct libinput_event *event,
 {
 	event->type = type;
 	event->device = device;
+	event->hw_time = device ? device->last_hw_time : 0;
 }
 
 static void
@@ -2301,6 +4133,78 @@ post_base_event(struct libinput_device *device,
 	libinput_post_event(libinput, event);
 }
 
+/* Latency histograms use power-of-two µs buckets, the last bucket takes
+ * the overflow. Cheap enough to run on every event when enabled. */
+static inline void
+latency_bucket_add(uint64_t *buckets, uint64_t dt)
+{
+	unsigned int bucket = 0;
+
+	if (dt > 0)
+		bucket = min((unsigned int)(64 - __builtin_clzll(dt)),
+			     (unsigned int)(LIBINPUT_LATENCY_NBUCKETS - 1));
+
+	buckets[bucket]++;
+}
+
+static inline void
+latency_record_drain(struct libinput *libinput, struct libinput_event *event)
+{
+	uint64_t now;
+
+	if (!libinput->latency_stats ||
+	    !event->device ||
+	    event->post_time == 0)
+		return;
+
+	now = libinput_now(libinput);
+	if (now > event->post_time)
+		latency_bucket_add(event->device->latency.post_to_drain,
+				   now - event->post_time);
+	else
+		latency_bucket_add(event->device->latency.post_to_drain, 0);
+}
+
+/**
+ * Queue a copy of the event on every context subscribed to this device.
+ * Copies go through the wire format, so only event types with a wire
+ * representation are mirrored; the deep-copy of variable-length payloads
+ * (touch frame changes) falls out of deserialization for free.
+ */
+static void
+libinput_mirror_event(struct libinput_device *device,
+		      struct libinput_event *event)
+{
+	struct libinput_device_share *share;
+	char stackbuf[256];
+	char *data = stackbuf;
+	int size;
+
+	size = libinput_event_serialize(event, NULL, 0);
+	if (size < 0)
+		return;
+
+	if ((size_t)size > sizeof(stackbuf))
+		data = zalloc(size);
+
+	libinput_event_serialize(event, data, size);
+
+	list_for_each(share, &device->shares, link) {
+		struct libinput_event *copy;
+
+		copy = libinput_event_deserialize(device, data, size);
+		if (!copy)
+			continue;
+		/* deserialize refs the device for unqueued use; queued
+		 * events take their ref in libinput_post_event() */
+		libinput_device_unref(device);
+		libinput_post_event_from_thread(share->recipient, copy);
+	}
+
+	if (data != stackbuf)
+		free(data);
+}
+
 static void
 post_device_event(struct libinput_device *device,
 		  uint64_t time,
@@ -2308,9 +4212,8 @@ post_device_event(struct libinput_device *device,
 		  struct libinput_event *event)
 {
 	struct libinput_event_listener *listener;
-#if 0
 	struct libinput *libinput = device->seat->libinput;
-
+#if 0
 	if (libinput->last_event_time > time) {
 		log_bug_libinput(device->seat->libinput,
 				 "out-of-order timestamps for %s time %" PRIu64 "\n",
@@ -2322,10 +4225,75 @@ post_device_event(struct libinput_device *device,
 
 	init_event_base(event, device, type);
 
+	if (libinput->latency_stats) {
+		uint64_t now = libinput_now(libinput);
+
+		latency_bucket_add(device->latency.kernel_to_post,
+				   now > time ? now - time : 0);
+		device->latency.nevents++;
+		event->post_time = now;
+	}
+
 	list_for_each_safe(listener, &device->event_listeners, link)
 		listener->notify_func(time, event, listener->notify_func_data);
 
-	libinput_post_event(device->seat->libinput, event);
+	if (long_bit_is_set(device->suppressed_events, type)) {
+		/* Not queued, so no device ref was taken */
+		event->device = NULL;
+		libinput_event_destroy(event);
+		return;
+	}
+
+	trace_event_posted(device, type, time);
+
+	if (!list_empty(&device->shares))
+		libinput_mirror_event(device, event);
+
+	libinput_post_event(libinput, event);
+}
+
+static void
+crash_shadow_device_added(struct libinput_device *device)
+{
+	struct libinput_crash_shadow *shadow =
+		&device->seat->libinput->crash_shadow;
+	struct evdev_device *evdev = evdev_device(device);
+	int slot = -1;
+
+	shadow->ndevices++;
+
+	for (int i = 0; i < CRASH_SHADOW_MAX_DEVICES; i++) {
+		if ((shadow->slots_used & bit(i)) == 0) {
+			slot = i;
+			break;
+		}
+	}
+
+	device->crash_shadow_slot = slot;
+	if (slot < 0)
+		return;
+
+	shadow->slots_used |= bit(slot);
+	shadow->devices[slot] = (struct libinput_crash_shadow_device) {
+		.seat_index = device->seat_index,
+		.dispatch_type = evdev->dispatch->dispatch_type,
+	};
+}
+
+static void
+crash_shadow_device_removed(struct libinput_device *device)
+{
+	struct libinput_crash_shadow *shadow =
+		&device->seat->libinput->crash_shadow;
+	int slot = device->crash_shadow_slot;
+
+	shadow->ndevices--;
+
+	if (slot < 0)
+		return;
+
+	shadow->slots_used &= ~bit(slot);
+	device->crash_shadow_slot = -1;
 }
 
 void
@@ -2333,7 +4301,9 @@ notify_added_device(struct libinput_device *device)
 {
 	struct libinput_event_device_notify *added_device_event;
 
-	added_device_event = zalloc(sizeof *added_device_event);
+	crash_shadow_device_added(device);
+
+	added_device_event = event_alloc(device);
 
 	post_base_event(device,
 			LIBINPUT_EVENT_DEVICE_ADDED,
@@ -2346,12 +4316,32 @@ notify_added_device(struct libinput_device *device)
 #endif
 }
 
+void
+notify_config_changed(struct libinput_device *device)
+{
+	struct libinput_event_device_notify *config_changed_event;
+
+	config_changed_event = event_alloc(device);
+
+	post_base_event(device,
+			LIBINPUT_EVENT_DEVICE_CONFIG_CHANGED,
+			&config_changed_event->base);
+
+#ifdef __clang_analyzer__
+	/* clang doesn't realize we're not leaking the event here, so
+	 * pretend to free it  */
+	free(config_changed_event);
+#endif
+}
+
 void
 notify_removed_device(struct libinput_device *device)
 {
 	struct libinput_event_device_notify *removed_device_event;
 
-	removed_device_event = zalloc(sizeof *removed_device_event);
+	crash_shadow_device_removed(device);
+
+	removed_device_event = event_alloc(device);
 
 	post_base_event(device,
 			LIBINPUT_EVENT_DEVICE_REMOVED,
@@ -2405,6 +4395,21 @@ device_has_cap(struct libinput_device *device,
 	return false;
 }
 
+static inline bool
+device_event_is_suppressed(struct libinput_device *device,
+			   enum libinput_event_type type)
+{
+	if (!long_bit_is_set(device->suppressed_events, type))
+		return false;
+
+	/* Internal listeners (DWT, touch arbitration, ...) must keep
+	 * seeing this device's events even when the caller has masked
+	 * the type out, so we only skip the allocation when none are
+	 * registered. post_device_event() drops the event after the
+	 * listeners have run otherwise. */
+	return list_empty(&device->event_listeners);
+}
+
 void
 keyboard_notify_key(struct libinput_device *device,
 		    uint64_t time,
@@ -2417,7 +4422,10 @@ keyboard_notify_key(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_KEYBOARD))
 		return;
 
-	key_event = zalloc(sizeof *key_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_KEYBOARD_KEY))
+		return;
+
+	key_event = event_alloc(device);
 
 	seat_key_count = update_seat_key_count(device->seat, key, state);
 
@@ -2444,7 +4452,10 @@ pointer_notify_motion(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	motion_event = zalloc(sizeof *motion_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_POINTER_MOTION))
+		return;
+
+	motion_event = event_alloc(device);
 
 	*motion_event = (struct libinput_event_pointer) {
 		.time = time,
@@ -2467,7 +4478,10 @@ pointer_notify_motion_absolute(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	motion_absolute_event = zalloc(sizeof *motion_absolute_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE))
+		return;
+
+	motion_absolute_event = event_alloc(device);
 
 	*motion_absolute_event = (struct libinput_event_pointer) {
 		.time = time,
@@ -2491,7 +4505,10 @@ pointer_notify_button(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	button_event = zalloc(sizeof *button_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_POINTER_BUTTON))
+		return;
+
+	button_event = event_alloc(device);
 
 	seat_button_count = update_seat_button_count(device->seat,
 						     button,
@@ -2522,8 +4539,10 @@ pointer_notify_axis_finger(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	axis_event = zalloc(sizeof *axis_event);
-	axis_event_legacy = zalloc(sizeof *axis_event_legacy);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_POINTER_SCROLL_FINGER))
+		return;
+
+	axis_event = event_alloc(device);
 
 	*axis_event = (struct libinput_event_pointer) {
 		.time = time,
@@ -2533,14 +4552,25 @@ pointer_notify_axis_finger(struct libinput_device *device,
 		.discrete = zero_discrete,
 		.v120 = zero_v120,
 	};
-	*axis_event_legacy = *axis_event;
+
+	/* Clients that disable legacy events or mask out the legacy axis
+	 * event don't pay for its copy. Copied before posting, the
+	 * original may be dropped by post_device_event() when it is
+	 * suppressed with listeners. */
+	axis_event_legacy = NULL;
+	if (device->seat->libinput->legacy_scroll_events &&
+	    !device_event_is_suppressed(device, LIBINPUT_EVENT_POINTER_AXIS)) {
+		axis_event_legacy = event_alloc(device);
+		*axis_event_legacy = *axis_event;
+	}
 
 	post_device_event(device, time,
 			  LIBINPUT_EVENT_POINTER_SCROLL_FINGER,
 			  &axis_event->base);
-	post_device_event(device, time,
-			  LIBINPUT_EVENT_POINTER_AXIS,
-			  &axis_event_legacy->base);
+	if (axis_event_legacy)
+		post_device_event(device, time,
+				  LIBINPUT_EVENT_POINTER_AXIS,
+				  &axis_event_legacy->base);
 }
 
 void
@@ -2556,8 +4586,10 @@ pointer_notify_axis_continuous(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	axis_event = zalloc(sizeof *axis_event);
-	axis_event_legacy = zalloc(sizeof *axis_event_legacy);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS))
+		return;
+
+	axis_event = event_alloc(device);
 
 	*axis_event = (struct libinput_event_pointer) {
 		.time = time,
@@ -2567,14 +4599,22 @@ pointer_notify_axis_continuous(struct libinput_device *device,
 		.discrete = zero_discrete,
 		.v120 = zero_v120,
 	};
-	*axis_event_legacy = *axis_event;
+
+	/* see pointer_notify_axis_finger() */
+	axis_event_legacy = NULL;
+	if (device->seat->libinput->legacy_scroll_events &&
+	    !device_event_is_suppressed(device, LIBINPUT_EVENT_POINTER_AXIS)) {
+		axis_event_legacy = event_alloc(device);
+		*axis_event_legacy = *axis_event;
+	}
 
 	post_device_event(device, time,
 			  LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS,
 			  &axis_event->base);
-	post_device_event(device, time,
-			  LIBINPUT_EVENT_POINTER_AXIS,
-			  &axis_event_legacy->base);
+	if (axis_event_legacy)
+		post_device_event(device, time,
+				  LIBINPUT_EVENT_POINTER_AXIS,
+				  &axis_event_legacy->base);
 }
 
 void
@@ -2590,7 +4630,13 @@ pointer_notify_axis_legacy_wheel(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	axis_event = zalloc(sizeof *axis_event);
+	if (!device->seat->libinput->legacy_scroll_events)
+		return;
+
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_POINTER_AXIS))
+		return;
+
+	axis_event = event_alloc(device);
 
 	*axis_event = (struct libinput_event_pointer) {
 		.time = time,
@@ -2618,7 +4664,10 @@ pointer_notify_axis_wheel(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_POINTER))
 		return;
 
-	axis_event = zalloc(sizeof *axis_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_POINTER_SCROLL_WHEEL))
+		return;
+
+	axis_event = event_alloc(device);
 
 	*axis_event = (struct libinput_event_pointer) {
 		.time = time,
@@ -2637,6 +4686,37 @@ pointer_notify_axis_wheel(struct libinput_device *device,
 	/* legacy wheel events are sent separately */
 }
 
+static void
+touch_frame_stage_change(struct libinput_device *device,
+			 enum libinput_event_type type,
+			 int32_t slot,
+			 int32_t seat_slot,
+			 const struct device_coords *point)
+{
+	struct touch_frame_change *c;
+
+	if (device->touch_frame.nchanges == device->touch_frame.nallocated) {
+		size_t sz = max(8U, device->touch_frame.nallocated * 2);
+		struct touch_frame_change *tmp;
+
+		tmp = realloc(device->touch_frame.changes,
+			      sz * sizeof(*tmp));
+		if (!tmp)
+			abort();
+		device->touch_frame.changes = tmp;
+		device->touch_frame.nallocated = sz;
+	}
+
+	c = &device->touch_frame.changes[device->touch_frame.nchanges++];
+	*c = (struct touch_frame_change) {
+		.type = type,
+		.slot = slot,
+		.seat_slot = seat_slot,
+	};
+	if (point)
+		c->point = *point;
+}
+
 void
 touch_notify_touch_down(struct libinput_device *device,
 			uint64_t time,
@@ -2649,7 +4729,17 @@ touch_notify_touch_down(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_TOUCH))
 		return;
 
-	touch_event = zalloc(sizeof *touch_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TOUCH_DOWN))
+		return;
+
+	if (device->touch_frame.enabled) {
+		touch_frame_stage_change(device,
+					 LIBINPUT_EVENT_TOUCH_DOWN,
+					 slot, seat_slot, point);
+		return;
+	}
+
+	touch_event = event_alloc(device);
 
 	*touch_event = (struct libinput_event_touch) {
 		.time = time,
@@ -2675,7 +4765,17 @@ touch_notify_touch_motion(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_TOUCH))
 		return;
 
-	touch_event = zalloc(sizeof *touch_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TOUCH_MOTION))
+		return;
+
+	if (device->touch_frame.enabled) {
+		touch_frame_stage_change(device,
+					 LIBINPUT_EVENT_TOUCH_MOTION,
+					 slot, seat_slot, point);
+		return;
+	}
+
+	touch_event = event_alloc(device);
 
 	*touch_event = (struct libinput_event_touch) {
 		.time = time,
@@ -2700,7 +4800,17 @@ touch_notify_touch_up(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_TOUCH))
 		return;
 
-	touch_event = zalloc(sizeof *touch_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TOUCH_UP))
+		return;
+
+	if (device->touch_frame.enabled) {
+		touch_frame_stage_change(device,
+					 LIBINPUT_EVENT_TOUCH_UP,
+					 slot, seat_slot, NULL);
+		return;
+	}
+
+	touch_event = event_alloc(device);
 
 	*touch_event = (struct libinput_event_touch) {
 		.time = time,
@@ -2724,7 +4834,17 @@ touch_notify_touch_cancel(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_TOUCH))
 		return;
 
-	touch_event = zalloc(sizeof *touch_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TOUCH_CANCEL))
+		return;
+
+	if (device->touch_frame.enabled) {
+		touch_frame_stage_change(device,
+					 LIBINPUT_EVENT_TOUCH_CANCEL,
+					 slot, seat_slot, NULL);
+		return;
+	}
+
+	touch_event = event_alloc(device);
 
 	*touch_event = (struct libinput_event_touch) {
 		.time = time,
@@ -2746,12 +4866,29 @@ touch_notify_frame(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_TOUCH))
 		return;
 
-	touch_event = zalloc(sizeof *touch_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TOUCH_FRAME)) {
+		/* don't let staged changes accumulate across suppressed
+		 * frames */
+		device->touch_frame.nchanges = 0;
+		return;
+	}
+
+	touch_event = event_alloc(device);
 
 	*touch_event = (struct libinput_event_touch) {
 		.time = time,
 	};
 
+	/* Hand the staged per-slot changes over to the frame event, the
+	 * staging buffer is reallocated on the next touch */
+	if (device->touch_frame.enabled) {
+		touch_event->changes = device->touch_frame.changes;
+		touch_event->nchanges = device->touch_frame.nchanges;
+		device->touch_frame.changes = NULL;
+		device->touch_frame.nchanges = 0;
+		device->touch_frame.nallocated = 0;
+	}
+
 	post_device_event(device, time,
 			  LIBINPUT_EVENT_TOUCH_FRAME,
 			  &touch_event->base);
@@ -2767,7 +4904,10 @@ tablet_notify_axis(struct libinput_device *device,
 {
 	struct libinput_event_tablet_tool *axis_event;
 
-	axis_event = zalloc(sizeof *axis_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TABLET_TOOL_AXIS))
+		return;
+
+	axis_event = event_alloc(device);
 
 	*axis_event = (struct libinput_event_tablet_tool) {
 		.time = time,
@@ -2797,7 +4937,10 @@ tablet_notify_proximity(struct libinput_device *device,
 {
 	struct libinput_event_tablet_tool *proximity_event;
 
-	proximity_event = zalloc(sizeof *proximity_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TABLET_TOOL_PROXIMITY))
+		return;
+
+	proximity_event = event_alloc(device);
 
 	*proximity_event = (struct libinput_event_tablet_tool) {
 		.time = time,
@@ -2826,7 +4969,10 @@ tablet_notify_tip(struct libinput_device *device,
 {
 	struct libinput_event_tablet_tool *tip_event;
 
-	tip_event = zalloc(sizeof *tip_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TABLET_TOOL_TIP))
+		return;
+
+	tip_event = event_alloc(device);
 
 	*tip_event = (struct libinput_event_tablet_tool) {
 		.time = time,
@@ -2857,7 +5003,10 @@ tablet_notify_button(struct libinput_device *device,
 	struct libinput_event_tablet_tool *button_event;
 	int32_t seat_button_count;
 
-	button_event = zalloc(sizeof *button_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TABLET_TOOL_BUTTON))
+		return;
+
+	button_event = event_alloc(device);
 
 	seat_button_count = update_seat_button_count(device->seat,
 						     button,
@@ -2890,7 +5039,10 @@ tablet_pad_notify_button(struct libinput_device *device,
 	struct libinput_event_tablet_pad *button_event;
 	unsigned int mode;
 
-	button_event = zalloc(sizeof *button_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TABLET_PAD_BUTTON))
+		return;
+
+	button_event = event_alloc(device);
 
 	mode = libinput_tablet_pad_mode_group_get_mode(group);
 
@@ -2919,7 +5071,10 @@ tablet_pad_notify_ring(struct libinput_device *device,
 	struct libinput_event_tablet_pad *ring_event;
 	unsigned int mode;
 
-	ring_event = zalloc(sizeof *ring_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TABLET_PAD_RING))
+		return;
+
+	ring_event = event_alloc(device);
 
 	mode = libinput_tablet_pad_mode_group_get_mode(group);
 
@@ -2949,7 +5104,10 @@ tablet_pad_notify_strip(struct libinput_device *device,
 	struct libinput_event_tablet_pad *strip_event;
 	unsigned int mode;
 
-	strip_event = zalloc(sizeof *strip_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TABLET_PAD_STRIP))
+		return;
+
+	strip_event = event_alloc(device);
 
 	mode = libinput_tablet_pad_mode_group_get_mode(group);
 
@@ -2976,7 +5134,10 @@ tablet_pad_notify_key(struct libinput_device *device,
 {
 	struct libinput_event_tablet_pad *key_event;
 
-	key_event = zalloc(sizeof *key_event);
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_TABLET_PAD_KEY))
+		return;
+
+	key_event = event_alloc(device);
 
 	*key_event = (struct libinput_event_tablet_pad) {
 		.time = time,
@@ -3006,7 +5167,10 @@ gesture_notify(struct libinput_device *device,
 	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_GESTURE))
 		return;
 
-	gesture_event = zalloc(sizeof *gesture_event);
+	if (device_event_is_suppressed(device, type))
+		return;
+
+	gesture_event = event_alloc(device);
 
 	*gesture_event = (struct libinput_event_gesture) {
 		.time = time,
@@ -3084,127 +5248,663 @@ gesture_notify_hold(struct libinput_device *device,
 		       finger_count, 0, &zero, &zero, 0.0, 0.0);
 }
 
-void
-gesture_notify_hold_end(struct libinput_device *device,
-			uint64_t time,
-			int finger_count,
-			bool cancelled)
+void
+gesture_notify_hold_end(struct libinput_device *device,
+			uint64_t time,
+			int finger_count,
+			bool cancelled)
+{
+	const struct normalized_coords zero = { 0.0, 0.0 };
+
+	gesture_notify(device, time, LIBINPUT_EVENT_GESTURE_HOLD_END,
+		       finger_count, cancelled, &zero, &zero, 0, 0.0);
+}
+
+void
+switch_notify_toggle(struct libinput_device *device,
+		     uint64_t time,
+		     enum libinput_switch sw,
+		     enum libinput_switch_state state)
+{
+	struct libinput_event_switch *switch_event;
+
+	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_SWITCH))
+		return;
+
+	if (device_event_is_suppressed(device, LIBINPUT_EVENT_SWITCH_TOGGLE))
+		return;
+
+	switch_event = event_alloc(device);
+
+	*switch_event = (struct libinput_event_switch) {
+		.time = time,
+		.sw = sw,
+		.state = state,
+	};
+
+	post_device_event(device, time,
+			  LIBINPUT_EVENT_SWITCH_TOGGLE,
+			  &switch_event->base);
+
+#ifdef __clang_analyzer__
+	/* clang doesn't realize we're not leaking the event here, so
+	 * pretend to free it  */
+	free(switch_event);
+#endif
+}
+
+/* Motion events coalesce naturally - the next one supersedes the dropped
+ * one - so these are the only types we may discard when the queue is
+ * bounded. Dropping anything else would lose state transitions. */
+static inline bool
+libinput_event_is_droppable(struct libinput_event *event)
+{
+	switch (event->type) {
+	case LIBINPUT_EVENT_POINTER_MOTION:
+	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+	case LIBINPUT_EVENT_TOUCH_MOTION:
+	case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+	case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* FIFO of events from latency-priority devices, drained ahead of the
+ * bulk ring, see libinput_device_set_priority(). A priority device's
+ * events live only here, never in the bulk ring, so each lane preserves
+ * posting order on its own */
+static void
+libinput_priority_lane_push(struct libinput *libinput,
+			    struct libinput_event *event)
+{
+	if (libinput->prio_count == libinput->prio_len) {
+		size_t prio_len = libinput->prio_len ?
+					libinput->prio_len * 2 :
+					EVENT_QUEUE_INITIAL_LEN;
+		struct libinput_event **lane;
+		size_t i;
+
+		lane = zalloc_tagged(prio_len * sizeof *lane,
+				     ALLOC_TAG_QUEUE);
+		for (i = 0; i < libinput->prio_count; i++)
+			lane[i] = libinput->prio_events[(libinput->prio_out + i) %
+							libinput->prio_len];
+		alloc_account_free(ALLOC_TAG_QUEUE,
+				   libinput->prio_len * sizeof *lane);
+		free(libinput->prio_events);
+		libinput->prio_events = lane;
+		libinput->prio_out = 0;
+		libinput->prio_in = libinput->prio_count;
+		libinput->prio_len = prio_len;
+	}
+
+	libinput->prio_events[libinput->prio_in] = event;
+	libinput->prio_in = (libinput->prio_in + 1) % libinput->prio_len;
+	libinput->prio_count++;
+}
+
+/* Keep the crash-dump mirror of the queue indices current; cheap enough
+ * to run on every queue transition */
+static inline void
+crash_shadow_sync_queue(struct libinput *libinput)
+{
+	struct libinput_crash_shadow *shadow = &libinput->crash_shadow;
+
+	shadow->events_in = libinput->events_in;
+	shadow->events_out = libinput->events_out;
+	shadow->events_count = libinput->events_count;
+	shadow->events_len = libinput->events_len;
+	shadow->events_max_depth = libinput->events_max_depth;
+	shadow->events_ndropped = libinput->events_ndropped;
+}
+
+static void
+libinput_post_event(struct libinput *libinput,
+		    struct libinput_event *event)
+{
+	struct libinput_event **events = libinput->events;
+	size_t events_len = libinput->events_len;
+	size_t events_count = libinput->events_count;
+
+#if 0
+	log_debug(libinput, "Queuing %s\n", event_type_to_str(event->type));
+#endif
+
+	/* The audit tap sits before the drop and compression paths: the
+	 * trail records what was generated, not what the client got */
+	if (libinput->audit_log)
+		libinput_audit_post(libinput->audit_log,
+				    event,
+				    libinput_now(libinput));
+
+	/* Latency-critical devices bypass the bulk ring, and with it the
+	 * drop and compression paths below */
+	if (event->device && event->device->priority) {
+		libinput_device_ref(event->device);
+		libinput_priority_lane_push(libinput, event);
+		if (libinput->export_ring)
+			libinput_export_post(libinput->export_ring,
+					     event,
+					     libinput_now(libinput));
+		return;
+	}
+
+	if (libinput->events_limit &&
+	    events_count >= libinput->events_limit &&
+	    libinput_event_is_droppable(event)) {
+		libinput->events_ndropped++;
+		crash_shadow_sync_queue(libinput);
+		/* the device is only ref'd once the event is queued, don't
+		 * unref it on this destroy */
+		event->device = NULL;
+		libinput_event_destroy(event);
+		return;
+	}
+
+	/* During a client stall, fold pointer motion into the undelivered
+	 * motion event at the tail of the queue instead of growing it;
+	 * the deltas sum exactly like the client would sum them at drain */
+	if (libinput->motion_compression &&
+	    events_count > 0 &&
+	    event->type == LIBINPUT_EVENT_POINTER_MOTION) {
+		struct libinput_event *tail =
+			events[(libinput->events_in + events_len - 1) %
+			       events_len];
+
+		if (tail->type == LIBINPUT_EVENT_POINTER_MOTION &&
+		    tail->device == event->device) {
+			struct libinput_event_pointer *src =
+				(struct libinput_event_pointer *)event;
+			struct libinput_event_pointer *dst =
+				(struct libinput_event_pointer *)tail;
+
+			dst->delta.x += src->delta.x;
+			dst->delta.y += src->delta.y;
+			dst->delta_raw.x += src->delta_raw.x;
+			dst->delta_raw.y += src->delta_raw.y;
+			dst->time = src->time;
+			tail->hw_time = event->hw_time;
+
+			/* not ref'd until queued, see above */
+			event->device = NULL;
+			libinput_event_destroy(event);
+			return;
+		}
+	}
+
+	events_count++;
+	if (events_count > events_len) {
+		struct libinput_event **new_events;
+		bool new_events_hooked;
+		size_t i;
+
+		events_len *= 2;
+		libinput->events_ngrows++;
+		new_events = NULL;
+		if (libinput->alloc_hooks.alloc)
+			new_events = libinput->alloc_hooks.alloc(
+					events_len * sizeof *new_events,
+					libinput->alloc_hooks.user_data);
+		new_events_hooked = new_events != NULL;
+		if (!new_events)
+			new_events = malloc(events_len * sizeof *new_events);
+		if (!new_events) {
+			log_error(libinput,
+				  "Failed to reallocate event ring buffer. "
+				  "Events may be discarded\n");
+			return;
+		}
+		alloc_account(ALLOC_TAG_QUEUE,
+			      events_len * sizeof *new_events);
+
+		/* Linearize the old ring into the new array, so after a
+		 * grow the queue always drains with a plain forward
+		 * stride from index 0 */
+		for (i = 0; i < libinput->events_count; i++)
+			new_events[i] = events[(libinput->events_out + i) %
+					       libinput->events_len];
+		alloc_account_free(ALLOC_TAG_QUEUE,
+				   libinput->events_len * sizeof *events);
+		if (libinput->events_hooked)
+			libinput->alloc_hooks.free(
+					events,
+					libinput->events_len * sizeof *events,
+					libinput->alloc_hooks.user_data);
+		else
+			free(events);
+		libinput->events_hooked = new_events_hooked;
+
+		events = new_events;
+		libinput->events = events;
+		libinput->events_out = 0;
+		libinput->events_in = libinput->events_count;
+		libinput->events_len = events_len;
+	}
+
+	if (event->device)
+		libinput_device_ref(event->device);
+
+	libinput->events_count = events_count;
+	libinput->events_max_depth = max(libinput->events_max_depth,
+					 events_count);
+	events[libinput->events_in] = event;
+	libinput->events_in = (libinput->events_in + 1) % libinput->events_len;
+	crash_shadow_sync_queue(libinput);
+
+	if (libinput->export_ring)
+		libinput_export_post(libinput->export_ring,
+				     event,
+				     libinput_now(libinput));
+}
+
+void
+libinput_post_event_from_thread(struct libinput *libinput,
+				struct libinput_event *event)
+{
+	/* Full ring means the dispatching thread hasn't drained in a
+	 * while; spin until it does rather than dropping input. The pop
+	 * side never blocks so this cannot deadlock while the consumer
+	 * keeps calling libinput_dispatch(). */
+	while (!mpsc_ring_push(&libinput->post_ring, event))
+		;
+}
+
+static void
+libinput_drain_post_ring(struct libinput *libinput)
+{
+	void *data;
+
+	/* Events staged by other threads go through the normal posting
+	 * path here so refcounting, latency stats and the export ring
+	 * only ever run on the dispatching thread */
+	while (mpsc_ring_pop(&libinput->post_ring, &data))
+		libinput_post_event(libinput, data);
+}
+
+/* The priority lane drains before the bulk ring; each lane is a FIFO of
+ * its own, so delivery order only ever changes across devices, never
+ * within one device's stream */
+static struct libinput_event *
+libinput_events_pop(struct libinput *libinput)
+{
+	struct libinput_event *event;
+
+	if (libinput->prio_count > 0) {
+		event = libinput->prio_events[libinput->prio_out];
+		libinput->prio_out =
+			(libinput->prio_out + 1) % libinput->prio_len;
+		libinput->prio_count--;
+		return event;
+	}
+
+	if (libinput->events_count == 0)
+		return NULL;
+
+	event = libinput->events[libinput->events_out];
+	libinput->events_out =
+		(libinput->events_out + 1) % libinput->events_len;
+	libinput->events_count--;
+	crash_shadow_sync_queue(libinput);
+
+	return event;
+}
+
+static struct libinput_event *
+libinput_events_peek(struct libinput *libinput)
+{
+	if (libinput->prio_count > 0)
+		return libinput->prio_events[libinput->prio_out];
+
+	if (libinput->events_count == 0)
+		return NULL;
+
+	return libinput->events[libinput->events_out];
+}
+
+LIBINPUT_EXPORT struct libinput_event *
+libinput_get_event(struct libinput *libinput)
+{
+	struct libinput_event *event;
+
+	event = libinput_events_pop(libinput);
+	if (!event)
+		return NULL;
+
+	latency_record_drain(libinput, event);
+	trace_event_drained(event->device, event->type, event->hw_time);
+
+	return event;
+}
+
+LIBINPUT_EXPORT size_t
+libinput_get_events(struct libinput *libinput,
+		    struct libinput_event **out,
+		    size_t max)
+{
+	size_t nevents = 0;
+
+	while (nevents < max) {
+		struct libinput_event *event = libinput_events_pop(libinput);
+
+		if (!event)
+			break;
+
+		latency_record_drain(libinput, event);
+		trace_event_drained(event->device, event->type, event->hw_time);
+		out[nevents++] = event;
+	}
+
+	return nevents;
+}
+
+LIBINPUT_EXPORT void
+libinput_get_event_queue_stats(struct libinput *libinput,
+			       struct libinput_event_queue_stats *stats)
+{
+	stats->current_depth = libinput->events_count + libinput->prio_count;
+	stats->max_depth = libinput->events_max_depth;
+	stats->num_grows = libinput->events_ngrows;
+	stats->num_dropped = libinput->events_ndropped;
+}
+
+LIBINPUT_EXPORT void
+libinput_set_event_queue_limit(struct libinput *libinput, size_t limit)
+{
+	libinput->events_limit = limit;
+}
+
+LIBINPUT_EXPORT int
+libinput_crash_dump(struct libinput *libinput, int fd)
+{
+	const char *data = (const char *)&libinput->crash_shadow;
+	size_t len = sizeof(libinput->crash_shadow);
+
+	/* Async-signal-safe: the shadow is kept current during normal
+	 * dispatch, all that's left to do here is write() it out */
+	while (len > 0) {
+		ssize_t nwritten = write(fd, data, len);
+
+		if (nwritten < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		data += nwritten;
+		len -= (size_t)nwritten;
+	}
+
+	return 0;
+}
+
+LIBINPUT_EXPORT void
+libinput_get_memory_stats(struct libinput *libinput,
+			  struct libinput_memory_stats *stats)
+{
+	struct libinput_event_slab *slab;
+	struct libinput_tablet_tool *tool;
+
+	stats->queue_bytes = libinput->events_len * sizeof(*libinput->events) +
+			     libinput->prio_len * sizeof(*libinput->prio_events) +
+			     LIBINPUT_POST_RING_SIZE *
+				     sizeof(*libinput->post_ring_slots);
+
+	stats->event_pool_bytes = 0;
+	list_for_each(slab, &libinput->event_pool->slab_list, link)
+		stats->event_pool_bytes += sizeof(*slab);
+
+	stats->tools_bytes = 0;
+	list_for_each(tool, &libinput->tool_list, link)
+		stats->tools_bytes += sizeof(*tool);
+	list_for_each(tool, &libinput->tool_pool, link)
+		stats->tools_bytes += sizeof(*tool);
+
+	stats->quirks_bytes = quirks_context_memory_size(libinput->quirks);
+
+	stats->total_bytes = stats->queue_bytes +
+			     stats->event_pool_bytes +
+			     stats->tools_bytes +
+			     stats->quirks_bytes;
+}
+
+LIBINPUT_EXPORT size_t
+libinput_get_allocation_stats(struct libinput *libinput,
+			      struct libinput_allocation_stats *stats,
+			      size_t nstats)
+{
+#if HAVE_ALLOC_STATS
+	size_t n = min((size_t)_ALLOC_TAG_COUNT, nstats);
+
+	for (size_t i = 0; i < n; i++) {
+		struct alloc_tag_stats s;
+
+		alloc_get_stats(i, &s);
+		stats[i].subsystem = alloc_tag_name(i);
+		stats[i].allocations = s.nallocs;
+		stats[i].frees = s.nfrees;
+		stats[i].bytes = s.bytes;
+		stats[i].bytes_total = s.bytes_total;
+	}
+
+	return n;
+#else
+	return 0;
+#endif
+}
+
+LIBINPUT_EXPORT void
+libinput_set_memory_budget(struct libinput *libinput, size_t budget)
+{
+	libinput->memory_budget = budget;
+}
+
+LIBINPUT_EXPORT void
+libinput_set_motion_compression(struct libinput *libinput, int enabled)
+{
+	libinput->motion_compression = !!enabled;
+}
+
+LIBINPUT_EXPORT void
+libinput_set_event_ordering(struct libinput *libinput, int enabled)
+{
+	libinput->event_ordering = !!enabled;
+}
+
+LIBINPUT_EXPORT void
+libinput_set_legacy_scroll_events_enabled(struct libinput *libinput,
+					  int enabled)
+{
+	libinput->legacy_scroll_events = !!enabled;
+}
+
+/* Release drained caches unconditionally. Only touches memory with
+ * nothing live in it, so this is safe at the end of every dispatch
+ * cycle. */
+static void
+libinput_memory_release(struct libinput *libinput)
+{
+	struct libinput_event_pool *pool = libinput->event_pool;
+	struct libinput_tablet_tool *tool;
+
+	/* Swap a grown-but-drained ring for a fresh one at the initial
+	 * size */
+	/* An empty priority lane is recreated on demand, drop it */
+	if (libinput->prio_count == 0 && libinput->prio_len > 0) {
+		alloc_account_free(ALLOC_TAG_QUEUE,
+				   libinput->prio_len *
+				   sizeof *libinput->prio_events);
+		free(libinput->prio_events);
+		libinput->prio_events = NULL;
+		libinput->prio_len = 0;
+		libinput->prio_in = 0;
+		libinput->prio_out = 0;
+	}
+
+	if (libinput->events_count == 0 &&
+	    libinput->events_len > EVENT_QUEUE_INITIAL_LEN) {
+		struct libinput_event **events = libinput->events;
+
+		libinput->events = zalloc_tagged(EVENT_QUEUE_INITIAL_LEN *
+						 sizeof(*libinput->events),
+						 ALLOC_TAG_QUEUE);
+		alloc_account_free(ALLOC_TAG_QUEUE,
+				   libinput->events_len * sizeof *events);
+		if (libinput->events_hooked)
+			libinput->alloc_hooks.free(
+					events,
+					libinput->events_len * sizeof *events,
+					libinput->alloc_hooks.user_data);
+		else
+			free(events);
+		libinput->events_hooked = false;
+		libinput->events_len = EVENT_QUEUE_INITIAL_LEN;
+		libinput->events_in = 0;
+		libinput->events_out = 0;
+	}
+
+	/* With no events outstanding every slab is free, recreate the
+	 * pool rather than untangling the free list */
+	if (pool->outstanding == 0 && !list_empty(&pool->slab_list)) {
+		libinput_event_pool_destroy(pool);
+		libinput->event_pool = libinput_event_pool_create();
+	}
+
+	list_for_each_safe(tool, &libinput->tool_pool, link) {
+		list_remove(&tool->link);
+		alloc_account_free(ALLOC_TAG_TOOL, sizeof *tool);
+		free(tool);
+	}
+}
+
+/* Release caches while over the budget, see
+ * libinput_set_memory_budget(). */
+static void
+libinput_memory_shrink(struct libinput *libinput)
 {
-	const struct normalized_coords zero = { 0.0, 0.0 };
+	struct libinput_memory_stats stats;
 
-	gesture_notify(device, time, LIBINPUT_EVENT_GESTURE_HOLD_END,
-		       finger_count, cancelled, &zero, &zero, 0, 0.0);
+	libinput_get_memory_stats(libinput, &stats);
+	if (stats.total_bytes <= libinput->memory_budget)
+		return;
+
+	libinput_memory_release(libinput);
 }
 
-void
-switch_notify_toggle(struct libinput_device *device,
-		     uint64_t time,
-		     enum libinput_switch sw,
-		     enum libinput_switch_state state)
+LIBINPUT_EXPORT void
+libinput_set_idle_timeout(struct libinput *libinput, uint32_t timeout_ms)
 {
-	struct libinput_event_switch *switch_event;
+	libinput->idle.timeout = ms2us(timeout_ms);
+	libinput->idle.parked = false;
 
-	if (!device_has_cap(device, LIBINPUT_DEVICE_CAP_SWITCH))
+	if (timeout_ms == 0) {
+		libinput_timer_cancel(&libinput->idle.timer);
 		return;
+	}
 
-	switch_event = zalloc(sizeof *switch_event);
-
-	*switch_event = (struct libinput_event_switch) {
-		.time = time,
-		.sw = sw,
-		.state = state,
-	};
+	libinput->idle.last_activity = libinput_now(libinput);
+	libinput_timer_set_flags(&libinput->idle.timer,
+				 libinput->idle.last_activity +
+					libinput->idle.timeout,
+				 TIMER_FLAG_ALLOW_LONG);
+}
 
-	post_device_event(device, time,
-			  LIBINPUT_EVENT_SWITCH_TOGGLE,
-			  &switch_event->base);
+static void
+libinput_idle_timer_func(uint64_t now, void *data)
+{
+	struct libinput *libinput = data;
+	uint64_t deadline = libinput->idle.last_activity +
+			    libinput->idle.timeout;
+
+	/* Events arrived since the governor was armed, check again one
+	 * timeout after the last of them */
+	if (now < deadline) {
+		libinput_timer_set_flags(&libinput->idle.timer,
+					 deadline,
+					 TIMER_FLAG_ALLOW_LONG);
+		return;
+	}
 
-#ifdef __clang_analyzer__
-	/* clang doesn't realize we're not leaking the event here, so
-	 * pretend to free it  */
-	free(switch_event);
-#endif
+	/* Quiet period over: drop the grown caches and park. The timer
+	 * stays unarmed until the next batch of events, so an idle
+	 * context causes no further wakeups at all. */
+	libinput->idle.parked = true;
+	libinput_memory_release(libinput);
 }
 
+/* Called with the batch time whenever a dispatch cycle had work. The
+ * caches regrow on demand, so leaving parked state is just a note of
+ * when to start the next countdown. */
 static void
-libinput_post_event(struct libinput *libinput,
-		    struct libinput_event *event)
+libinput_idle_note_activity(struct libinput *libinput, uint64_t now)
 {
-	struct libinput_event **events = libinput->events;
-	size_t events_len = libinput->events_len;
-	size_t events_count = libinput->events_count;
-	size_t move_len;
-	size_t new_out;
-
-#if 0
-	log_debug(libinput, "Queuing %s\n", event_type_to_str(event->type));
-#endif
+	libinput->idle.last_activity = now;
 
-	events_count++;
-	if (events_count > events_len) {
-		void *tmp;
+	if (!libinput->idle.parked)
+		return;
 
-		events_len *= 2;
-		tmp = realloc(events, events_len * sizeof *events);
-		if (!tmp) {
-			log_error(libinput,
-				  "Failed to reallocate event ring buffer. "
-				  "Events may be discarded\n");
-			return;
-		}
+	libinput->idle.parked = false;
+	libinput_timer_set_flags(&libinput->idle.timer,
+				 now + libinput->idle.timeout,
+				 TIMER_FLAG_ALLOW_LONG);
+}
 
-		events = tmp;
-
-		if (libinput->events_count > 0 && libinput->events_in == 0) {
-			libinput->events_in = libinput->events_len;
-		} else if (libinput->events_count > 0 &&
-			   libinput->events_out >= libinput->events_in) {
-			move_len = libinput->events_len - libinput->events_out;
-			new_out = events_len - move_len;
-			memmove(events + new_out,
-				events + libinput->events_out,
-				move_len * sizeof *events);
-			libinput->events_out = new_out;
-		}
+LIBINPUT_EXPORT int
+libinput_set_allocation_hooks(struct libinput *libinput,
+			      libinput_alloc_func alloc_func,
+			      libinput_free_func free_func,
+			      void *user_data)
+{
+	if (!alloc_func || !free_func)
+		return -1;
 
-		libinput->events = events;
-		libinput->events_len = events_len;
-	}
+	/* One-shot: swapping allocators mid-flight would require freeing
+	 * each existing block with the allocator it came from, and there
+	 * is no use-case to justify that bookkeeping */
+	if (libinput->alloc_hooks.alloc)
+		return -1;
 
-	if (event->device)
-		libinput_device_ref(event->device);
+	libinput->alloc_hooks.alloc = alloc_func;
+	libinput->alloc_hooks.free = free_func;
+	libinput->alloc_hooks.user_data = user_data;
 
-	libinput->events_count = events_count;
-	events[libinput->events_in] = event;
-	libinput->events_in = (libinput->events_in + 1) % libinput->events_len;
+	return 0;
 }
 
-LIBINPUT_EXPORT struct libinput_event *
-libinput_get_event(struct libinput *libinput)
+LIBINPUT_EXPORT enum libinput_event_type
+libinput_next_event_type(struct libinput *libinput)
 {
 	struct libinput_event *event;
 
-	if (libinput->events_count == 0)
-		return NULL;
+	event = libinput_events_peek(libinput);
+	if (!event)
+		return LIBINPUT_EVENT_NONE;
 
-	event = libinput->events[libinput->events_out];
-	libinput->events_out =
-		(libinput->events_out + 1) % libinput->events_len;
-	libinput->events_count--;
+	return event->type;
+}
 
-	return event;
+LIBINPUT_EXPORT struct libinput_event *
+libinput_peek_event(struct libinput *libinput)
+{
+	/* The event stays in the queue, it is neither drained nor
+	 * transferred to the caller */
+	return libinput_events_peek(libinput);
 }
 
-LIBINPUT_EXPORT enum libinput_event_type
-libinput_next_event_type(struct libinput *libinput)
+LIBINPUT_EXPORT void
+libinput_consume_event(struct libinput *libinput)
 {
 	struct libinput_event *event;
 
-	if (libinput->events_count == 0)
-		return LIBINPUT_EVENT_NONE;
+	event = libinput_events_pop(libinput);
+	if (!event)
+		return;
 
-	event = libinput->events[libinput->events_out];
-	return event->type;
+	latency_record_drain(libinput, event);
+	trace_event_drained(event->device, event->type, event->hw_time);
+
+	libinput_event_destroy(event);
 }
 
 LIBINPUT_EXPORT void
@@ -3232,6 +5932,186 @@ libinput_suspend(struct libinput *libinput)
 	libinput->interface_backend->suspend(libinput);
 }
 
+LIBINPUT_EXPORT int
+libinput_clone_context(struct libinput *libinput, struct libinput *source)
+{
+	struct libinput_seat *seat;
+	struct libinput_device *device;
+	int ndevices = 0;
+
+	if (libinput == source)
+		return -1;
+
+	/* Share the parsed quirks database, the new context skips the
+	 * data file parse and inherits the warm match cache */
+	if (!libinput->quirks && source->quirks) {
+		libinput->quirks = quirks_context_ref(source->quirks);
+		libinput->quirks_initialized = true;
+	}
+
+	/* Each source device is suspended with its fd handed over to
+	 * the new context's preopen stash; device creation then picks
+	 * the fd up instead of going through open_restricted() again,
+	 * see evdev_device_create() */
+	list_for_each(seat, &source->seat_list, link) {
+		list_for_each(device, &seat->devices_list, link) {
+			struct evdev_device *evdev = evdev_device(device);
+			const char *devnode =
+				udev_device_get_devnode(evdev->udev_device);
+			int fd;
+
+			if (!devnode)
+				continue;
+
+			fd = evdev_device_detach_fd(evdev);
+			if (fd < 0)
+				continue;
+
+			libinput_stash_preopened_device(libinput,
+							devnode,
+							fd,
+							NULL);
+			ndevices++;
+		}
+	}
+
+	return ndevices;
+}
+
+LIBINPUT_EXPORT int
+libinput_device_open_complete(struct libinput_device *device, int fd)
+{
+	return evdev_device_open_complete(evdev_device(device), fd);
+}
+
+LIBINPUT_EXPORT int
+libinput_device_inject_events(struct libinput_device *device,
+			      const struct input_event *events,
+			      size_t nevents)
+{
+	return evdev_device_inject_events(evdev_device(device),
+					  events,
+					  nevents);
+}
+
+LIBINPUT_EXPORT int
+libinput_device_share_events(struct libinput *libinput,
+			     struct libinput_device *device)
+{
+	struct libinput_device_share *share;
+
+	if (libinput == NULL ||
+	    device == NULL ||
+	    device->seat->libinput == libinput)
+		return -1;
+
+	list_for_each(share, &device->shares, link) {
+		if (share->recipient == libinput)
+			return -1;
+	}
+
+	share = zalloc(sizeof *share);
+	share->recipient = libinput;
+	list_append(&device->shares, &share->link);
+
+	return 0;
+}
+
+LIBINPUT_EXPORT int
+libinput_device_unshare_events(struct libinput *libinput,
+			       struct libinput_device *device)
+{
+	struct libinput_device_share *share;
+
+	if (libinput == NULL || device == NULL)
+		return -1;
+
+	list_for_each(share, &device->shares, link) {
+		if (share->recipient == libinput) {
+			list_remove(&share->link);
+			free(share);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+LIBINPUT_EXPORT int
+libinput_device_touch_enable_frame_aggregation(struct libinput_device *device,
+					       int enable)
+{
+	if (!libinput_device_has_capability(device,
+					    LIBINPUT_DEVICE_CAP_TOUCH))
+		return enable ? -1 : 0;
+
+	device->touch_frame.enabled = !!enable;
+
+	if (!enable) {
+		free(device->touch_frame.changes);
+		device->touch_frame.changes = NULL;
+		device->touch_frame.nchanges = 0;
+		device->touch_frame.nallocated = 0;
+	}
+
+	return 0;
+}
+
+LIBINPUT_EXPORT int
+libinput_device_set_event_mask(struct libinput_device *device,
+			       const enum libinput_event_type *types,
+			       size_t ntypes)
+{
+	unsigned long suppressed[ARRAY_LENGTH(device->suppressed_events)] = {0};
+	size_t i;
+
+	for (i = 0; i < ntypes; i++) {
+		switch (types[i]) {
+		case LIBINPUT_EVENT_NONE:
+		case LIBINPUT_EVENT_DEVICE_ADDED:
+		case LIBINPUT_EVENT_DEVICE_REMOVED:
+			return -1;
+		default:
+			if (!event_type_to_str(types[i]))
+				return -1;
+			break;
+		}
+		long_set_bit(suppressed, types[i]);
+	}
+
+	memcpy(device->suppressed_events,
+	       suppressed,
+	       sizeof(device->suppressed_events));
+
+	return 0;
+}
+
+LIBINPUT_EXPORT void
+libinput_device_set_priority(struct libinput_device *device, int priority)
+{
+	device->priority = !!priority;
+}
+
+LIBINPUT_EXPORT void
+libinput_device_scroll_set_fling_enabled(struct libinput_device *device,
+					 int enabled)
+{
+	evdev_device_scroll_set_fling_enabled((struct evdev_device *) device,
+					      !!enabled);
+}
+
+LIBINPUT_EXPORT int
+libinput_device_scroll_get_fling_enabled(struct libinput_device *device)
+{
+	return ((struct evdev_device *) device)->scroll.fling.enabled;
+}
+
+LIBINPUT_EXPORT enum libinput_gesture_hint
+libinput_device_get_active_gesture_hint(struct libinput_device *device)
+{
+	return device->gesture_hint;
+}
+
 LIBINPUT_EXPORT void
 libinput_device_set_user_data(struct libinput_device *device, void *user_data)
 {
@@ -3262,6 +6142,64 @@ libinput_device_get_sysname(struct libinput_device *device)
 	return evdev_device_get_sysname((struct evdev_device *) device);
 }
 
+LIBINPUT_EXPORT int
+libinput_device_get_latency_stats(struct libinput_device *device,
+				  struct libinput_latency_stats *stats)
+{
+	if (!device->seat->libinput->latency_stats)
+		return -1;
+
+	*stats = device->latency;
+
+	return 0;
+}
+
+LIBINPUT_EXPORT uint64_t
+libinput_device_get_syn_dropped_count(struct libinput_device *device)
+{
+	return ((struct evdev_device *) device)->syn_dropped_count;
+}
+
+LIBINPUT_EXPORT void
+libinput_device_get_event_stats(struct libinput_device *device,
+				struct libinput_event_stats *stats)
+{
+	struct evdev_device *evdev = (struct evdev_device *) device;
+
+	stats->nevents = evdev->stats.nevents;
+	stats->nframes = evdev->stats.nframes;
+	stats->ndropped = evdev->syn_dropped_count;
+}
+
+LIBINPUT_EXPORT void
+libinput_device_get_scroll_accumulated(struct libinput_device *device,
+				       double *x,
+				       double *y)
+{
+	struct evdev_device *evdev = (struct evdev_device *) device;
+
+	if (x)
+		*x = evdev->scroll.buildup.x;
+	if (y)
+		*y = evdev->scroll.buildup.y;
+}
+
+LIBINPUT_EXPORT void
+libinput_device_sample_scroll(struct libinput_device *device,
+			      double *x,
+			      double *y)
+{
+	struct evdev_device *evdev = (struct evdev_device *) device;
+
+	if (x)
+		*x = evdev->scroll.sampled.x;
+	if (y)
+		*y = evdev->scroll.sampled.y;
+
+	evdev->scroll.sampled.x = 0.0;
+	evdev->scroll.sampled.y = 0.0;
+}
+
 LIBINPUT_EXPORT const char *
 libinput_device_get_name(struct libinput_device *device)
 {
@@ -3280,6 +6218,12 @@ libinput_device_get_id_vendor(struct libinput_device *device)
 	return evdev_device_get_id_vendor((struct evdev_device *) device);
 }
 
+LIBINPUT_EXPORT unsigned int
+libinput_device_get_report_rate(struct libinput_device *device)
+{
+	return evdev_device_get_report_rate((struct evdev_device *) device);
+}
+
 LIBINPUT_EXPORT const char *
 libinput_device_get_output_name(struct libinput_device *device)
 {
@@ -3326,6 +6270,12 @@ libinput_device_has_capability(struct libinput_device *device,
 					   capability);
 }
 
+LIBINPUT_EXPORT uint32_t
+libinput_device_get_capability_mask(struct libinput_device *device)
+{
+	return device->capability_mask;
+}
+
 LIBINPUT_EXPORT int
 libinput_device_get_size(struct libinput_device *device,
 			 double *width,
@@ -3752,6 +6702,20 @@ libinput_event_tablet_pad_get_time_usec(struct libinput_event_tablet_pad *event)
 	return event->time;
 }
 
+LIBINPUT_EXPORT uint64_t
+libinput_event_tablet_pad_get_hw_time_usec(struct libinput_event_tablet_pad *event)
+{
+	require_event_type(libinput_event_get_context(&event->base),
+			   event->base.type,
+			   0,
+			   LIBINPUT_EVENT_TABLET_PAD_RING,
+			   LIBINPUT_EVENT_TABLET_PAD_STRIP,
+			   LIBINPUT_EVENT_TABLET_PAD_BUTTON,
+			   LIBINPUT_EVENT_TABLET_PAD_KEY);
+
+	return event->base.hw_time;
+}
+
 LIBINPUT_EXPORT struct libinput_event *
 libinput_event_tablet_pad_get_base_event(struct libinput_event_tablet_pad *event)
 {
@@ -3781,7 +6745,7 @@ libinput_device_group_create(struct libinput *libinput,
 
 	group = zalloc(sizeof *group);
 	group->refcount = 1;
-	group->identifier = safe_strdup(identifier);
+	group->identifier = libinput_intern_string(libinput, identifier);
 
 	list_init(&group->link);
 	list_insert(&libinput->device_group_list, &group->link);
@@ -3817,7 +6781,6 @@ static void
 libinput_device_group_destroy(struct libinput_device_group *group)
 {
 	list_remove(&group->link);
-	free(group->identifier);
 	free(group);
 }
 
@@ -3867,6 +6830,79 @@ libinput_config_status_to_str(enum libinput_config_status status)
 	return str;
 }
 
+LIBINPUT_EXPORT void
+libinput_device_config_transaction_begin(struct libinput_device *device)
+{
+	device->config_txn++;
+}
+
+LIBINPUT_EXPORT void
+libinput_device_config_transaction_commit(struct libinput_device *device)
+{
+	uint32_t pending;
+
+	if (device->config_txn == 0 || --device->config_txn > 0)
+		return;
+
+	/* Re-running the setters outside the transaction performs the
+	 * deferred rebuilds, once each, with the last recorded value */
+	pending = device->config_txn_pending;
+	device->config_txn_pending = 0;
+
+	if (pending & CONFIG_TXN_ACCEL_PROFILE)
+		device->config.accel->set_profile(device,
+						  device->config_txn_profile);
+	if (pending & CONFIG_TXN_TAP_ENABLED)
+		device->config.tap->set_enabled(device,
+						device->config_txn_tap);
+}
+
+bool
+libinput_config_txn_defer_accel_profile(struct libinput_device *device,
+					enum libinput_config_accel_profile profile)
+{
+	if (device->config_txn == 0)
+		return false;
+
+	device->config_txn_profile = profile;
+	device->config_txn_pending |= CONFIG_TXN_ACCEL_PROFILE;
+	return true;
+}
+
+bool
+libinput_config_txn_defer_tap_enabled(struct libinput_device *device,
+				      enum libinput_config_tap_state enabled)
+{
+	if (device->config_txn == 0)
+		return false;
+
+	device->config_txn_tap = enabled;
+	device->config_txn_pending |= CONFIG_TXN_TAP_ENABLED;
+	return true;
+}
+
+/* Wraps the dispatch-interface set calls below: a successfully applied
+ * setting bumps the generation and posts @ref
+ * LIBINPUT_EVENT_DEVICE_CONFIG_CHANGED so clients don't need to poll
+ * the getters */
+static enum libinput_config_status
+notify_config_status(struct libinput_device *device,
+		     enum libinput_config_status status)
+{
+	if (status == LIBINPUT_CONFIG_STATUS_SUCCESS) {
+		device->config_generation++;
+		notify_config_changed(device);
+	}
+
+	return status;
+}
+
+LIBINPUT_EXPORT uint32_t
+libinput_device_get_config_generation(struct libinput_device *device)
+{
+	return device->config_generation;
+}
+
 LIBINPUT_EXPORT int
 libinput_device_config_tap_get_finger_count(struct libinput_device *device)
 {
@@ -3885,7 +6921,8 @@ libinput_device_config_tap_set_enabled(struct libinput_device *device,
 		return enable ? LIBINPUT_CONFIG_STATUS_UNSUPPORTED :
 				LIBINPUT_CONFIG_STATUS_SUCCESS;
 
-	return device->config.tap->set_enabled(device, enable);
+	return notify_config_status(device,
+				    device->config.tap->set_enabled(device, enable));
 
 }
 
@@ -3922,7 +6959,8 @@ libinput_device_config_tap_set_button_map(struct libinput_device *device,
 	if (libinput_device_config_tap_get_finger_count(device) == 0)
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
 
-	return device->config.tap->set_map(device, map);
+	return notify_config_status(device,
+				    device->config.tap->set_map(device, map));
 }
 
 LIBINPUT_EXPORT enum libinput_config_tap_button_map
@@ -3955,7 +6993,8 @@ libinput_device_config_tap_set_drag_enabled(struct libinput_device *device,
 		return enable ? LIBINPUT_CONFIG_STATUS_UNSUPPORTED :
 				LIBINPUT_CONFIG_STATUS_SUCCESS;
 
-	return device->config.tap->set_drag_enabled(device, enable);
+	return notify_config_status(device,
+				    device->config.tap->set_drag_enabled(device, enable));
 }
 
 LIBINPUT_EXPORT enum libinput_config_drag_state
@@ -3988,7 +7027,8 @@ libinput_device_config_tap_set_drag_lock_enabled(struct libinput_device *device,
 		return enable ? LIBINPUT_CONFIG_STATUS_UNSUPPORTED :
 				LIBINPUT_CONFIG_STATUS_SUCCESS;
 
-	return device->config.tap->set_draglock_enabled(device, enable);
+	return notify_config_status(device,
+				    device->config.tap->set_draglock_enabled(device, enable));
 }
 
 LIBINPUT_EXPORT enum libinput_config_drag_lock_state
@@ -4023,7 +7063,8 @@ libinput_device_config_calibration_set_matrix(struct libinput_device *device,
 	if (!libinput_device_config_calibration_has_matrix(device))
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
 
-	return device->config.calibration->set_matrix(device, matrix);
+	return notify_config_status(device,
+				    device->config.calibration->set_matrix(device, matrix));
 }
 
 LIBINPUT_EXPORT int
@@ -4046,6 +7087,18 @@ libinput_device_config_calibration_get_default_matrix(struct libinput_device *de
 	return device->config.calibration->get_default_matrix(device, matrix);
 }
 
+LIBINPUT_EXPORT enum libinput_config_status
+libinput_device_config_set_active_region(struct libinput_device *device,
+					 const struct libinput_region *regions,
+					 size_t nregions)
+{
+	return notify_config_status(device,
+				    evdev_device_set_active_region(
+						(struct evdev_device *) device,
+						regions,
+						nregions));
+}
+
 LIBINPUT_EXPORT uint32_t
 libinput_device_config_send_events_get_modes(struct libinput_device *device)
 {
@@ -4065,7 +7118,8 @@ libinput_device_config_send_events_set_mode(struct libinput_device *device,
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
 
 	if (device->config.sendevents)
-		return device->config.sendevents->set_mode(device, mode);
+		return notify_config_status(device,
+					    device->config.sendevents->set_mode(device, mode));
 
 	/* mode must be _ENABLED to get here */
 	return LIBINPUT_CONFIG_STATUS_SUCCESS;
@@ -4104,7 +7158,8 @@ libinput_device_config_accel_set_speed(struct libinput_device *device,
 	if (!libinput_device_config_accel_is_available(device))
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
 
-	return device->config.accel->set_speed(device, speed);
+	return notify_config_status(device,
+				    device->config.accel->set_speed(device, speed));
 }
 LIBINPUT_EXPORT double
 libinput_device_config_accel_get_speed(struct libinput_device *device)
@@ -4167,7 +7222,8 @@ libinput_device_config_accel_set_profile(struct libinput_device *device,
 	    (libinput_device_config_accel_get_profiles(device) & profile) == 0)
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
 
-	return device->config.accel->set_profile(device, profile);
+	return notify_config_status(device,
+				    device->config.accel->set_profile(device, profile));
 }
 
 LIBINPUT_EXPORT int
@@ -4186,7 +7242,8 @@ libinput_device_config_scroll_set_natural_scroll_enabled(struct libinput_device
 	if (!libinput_device_config_scroll_has_natural_scroll(device))
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
 
-	return device->config.natural_scroll->set_enabled(device, enabled);
+	return notify_config_status(device,
+				    device->config.natural_scroll->set_enabled(device, enabled));
 }
 
 LIBINPUT_EXPORT int
@@ -4223,7 +7280,8 @@ libinput_device_config_left_handed_set(struct libinput_device *device,
 	if (!libinput_device_config_left_handed_is_available(device))
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
 
-	return device->config.left_handed->set(device, left_handed);
+	return notify_config_status(device,
+				    device->config.left_handed->set(device, left_handed));
 }
 
 LIBINPUT_EXPORT int
@@ -4271,7 +7329,8 @@ libinput_device_config_click_set_method(struct libinput_device *device,
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
 
 	if (device->config.click_method)
-		return device->config.click_method->set_method(device, method);
+		return notify_config_status(device,
+					    device->config.click_method->set_method(device, method));
 
 	/* method must be _NONE to get here */
 	return LIBINPUT_CONFIG_STATUS_SUCCESS;
@@ -4326,7 +7385,8 @@ libinput_device_config_middle_emulation_set_enabled(
 		return LIBINPUT_CONFIG_STATUS_INVALID;
 	}
 
-	return device->config.middle_emulation->set(device, enable);
+	return notify_config_status(device,
+				    device->config.middle_emulation->set(device, enable));
 }
 
 LIBINPUT_EXPORT enum libinput_config_middle_emulation_state
@@ -4377,7 +7437,8 @@ libinput_device_config_scroll_set_method(struct libinput_device *device,
 		return LIBINPUT_CONFIG_STATUS_UNSUPPORTED;
 
 	if (device->config.scroll_method)
-		return device->config.scroll_method->set_method(device, method);
+		return notify_config_status(device,
+					    device->config.scroll_method->set_method(device, method));
 
 	/* method must be _NO_SCROLL to get here */
 	return LIBINPUT_CONFIG_STATUS_SUCCESS;
@@ -4412,7 +7473,8 @@ libinput_device_config_scroll_set_button(struct libinput_device *device,
 	if (button && !libinput_device_pointer_has_button(device, button))
 		return LIBINPUT_CONFIG_STATUS_INVALID;
 
-	return device->config.scroll_method->set_button(device, button);
+	return notify_config_status(device,
+				    device->config.scroll_method->set_button(device, button));
 }
 
 LIBINPUT_EXPORT uint32_t
@@ -4451,7 +7513,8 @@ libinput_device_config_scroll_set_button_lock(struct libinput_device *device,
 		return LIBINPUT_CONFIG_STATUS_INVALID;
 	}
 
-	return device->config.scroll_method->set_button_lock(device, state);
+	return notify_config_status(device,
+				    device->config.scroll_method->set_button_lock(device, state));
 }
 
 LIBINPUT_EXPORT enum libinput_config_scroll_button_lock_state
@@ -4495,7 +7558,8 @@ libinput_device_config_dwt_set_enabled(struct libinput_device *device,
 		return enable ? LIBINPUT_CONFIG_STATUS_UNSUPPORTED :
 				LIBINPUT_CONFIG_STATUS_SUCCESS;
 
-	return device->config.dwt->set_enabled(device, enable);
+	return notify_config_status(device,
+				    device->config.dwt->set_enabled(device, enable));
 }
 
 LIBINPUT_EXPORT enum libinput_config_dwt_state
@@ -4536,7 +7600,8 @@ libinput_device_config_rotation_set_angle(struct libinput_device *device,
 	if (degrees_cw >= 360 || degrees_cw % 90)
 		return LIBINPUT_CONFIG_STATUS_INVALID;
 
-	return device->config.rotation->set_angle(device, degrees_cw);
+	return notify_config_status(device,
+				    device->config.rotation->set_angle(device, degrees_cw));
 }
 
 LIBINPUT_EXPORT unsigned int
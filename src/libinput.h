@@ -743,6 +743,17 @@ enum libinput_event_type {
 	 */
 	LIBINPUT_EVENT_DEVICE_REMOVED,
 
+	/**
+	 * Signals that a configuration setting was successfully applied
+	 * to the device via one of the libinput_device_config_* setters.
+	 * Clients that mirror the device configuration can re-read the
+	 * getters on this event instead of polling them, see
+	 * libinput_device_get_config_generation().
+	 *
+	 * @since 1.20
+	 */
+	LIBINPUT_EVENT_DEVICE_CONFIG_CHANGED,
+
 	LIBINPUT_EVENT_KEYBOARD_KEY = 300,
 
 	LIBINPUT_EVENT_POINTER_MOTION = 400,
@@ -1015,6 +1026,73 @@ libinput_event_destroy(struct libinput_event *event);
 enum libinput_event_type
 libinput_event_get_type(struct libinput_event *event);
 
+/**
+ * @ingroup event
+ *
+ * The version of the binary format produced by
+ * libinput_event_serialize(). This version is bumped whenever the format
+ * changes; libinput_event_deserialize() rejects blobs of a different
+ * version.
+ *
+ * @since 1.20
+ */
+#define LIBINPUT_EVENT_WIRE_VERSION 1
+
+/**
+ * @ingroup event
+ *
+ * Serialize the event into a compact fixed-layout binary blob that can
+ * be shipped to another host and turned back into an event with
+ * libinput_event_deserialize(). The format uses fixed-width fields in
+ * native byte order; both hosts must agree on endianness.
+ *
+ * If buffer is NULL, the required buffer size for this event is
+ * returned and nothing is written.
+ *
+ * Keyboard, pointer, touch, gesture and switch events can be
+ * serialized. Events whose payload references objects tied to the
+ * originating context (tablet tool and tablet pad events, device
+ * added/removed events) cannot.
+ *
+ * @param event The libinput event
+ * @param buffer Destination buffer, or NULL to query the required size
+ * @param size Size of the destination buffer in bytes
+ * @return The number of bytes written (or required if buffer is NULL),
+ * or -1 if the event cannot be serialized or the buffer is too small
+ *
+ * @since 1.20
+ */
+int
+libinput_event_serialize(struct libinput_event *event,
+			 void *buffer,
+			 size_t size);
+
+/**
+ * @ingroup event
+ *
+ * Create an event from a blob produced by libinput_event_serialize(),
+ * possibly on another host. The event is attached to the given device
+ * and behaves like an event retrieved by libinput_get_event(); the
+ * caller owns it and must free it with libinput_event_destroy(). It is
+ * not queued in the device's context.
+ *
+ * Accessors returning data derived from the originating device's state
+ * (e.g. the transformed coordinate accessors) operate on the state of
+ * the device given here instead.
+ *
+ * @param device The device to attach the event to
+ * @param buffer A blob produced by libinput_event_serialize()
+ * @param size Size of the blob in bytes
+ * @return A new event, or NULL if the blob is truncated, of an
+ * unsupported type or of a different #LIBINPUT_EVENT_WIRE_VERSION
+ *
+ * @since 1.20
+ */
+struct libinput_event *
+libinput_event_deserialize(struct libinput_device *device,
+			   const void *buffer,
+			   size_t size);
+
 /**
  * @ingroup event
  *
@@ -1195,6 +1273,26 @@ libinput_event_keyboard_get_time(struct libinput_event_keyboard *event);
 uint64_t
 libinput_event_keyboard_get_time_usec(struct libinput_event_keyboard *event);
 
+/**
+ * @ingroup event_keyboard
+ *
+ * Return the kernel timestamp of the hardware event frame that
+ * triggered this event. This is the timestamp the kernel attached
+ * to the evdev event, before any processing delay within libinput.
+ * For events generated by libinput itself (e.g. from an internal
+ * timer), this is the timestamp of the most recent hardware frame
+ * from this device.
+ *
+ * @note Timestamps may not always increase. See the libinput
+ * documentation for more details.
+ *
+ * @return The kernel event time for this event in microseconds
+ *
+ * @since 1.20
+ */
+uint64_t
+libinput_event_keyboard_get_hw_time_usec(struct libinput_event_keyboard *event);
+
 /**
  * @ingroup event_keyboard
  *
@@ -1264,6 +1362,30 @@ libinput_event_pointer_get_time(struct libinput_event_pointer *event);
 uint64_t
 libinput_event_pointer_get_time_usec(struct libinput_event_pointer *event);
 
+/**
+ * @ingroup event_pointer
+ *
+ * Return the hardware timestamp of the event frame that triggered
+ * this event. On devices that provide hardware timestamps
+ * (MSC_TIMESTAMP) this is the device's own frame time, anchored
+ * against the kernel clock - on bursty transports (e.g. USB) this
+ * preserves the true sampling intervals even when several frames are
+ * delivered at once. Otherwise it is the timestamp the kernel
+ * attached to the evdev event, before any processing delay within
+ * libinput. For events generated by libinput itself (e.g. from an
+ * internal timer), this is the timestamp of the most recent hardware
+ * frame from this device.
+ *
+ * @note Timestamps may not always increase. See the libinput
+ * documentation for more details.
+ *
+ * @return The hardware event time for this event in microseconds
+ *
+ * @since 1.20
+ */
+uint64_t
+libinput_event_pointer_get_hw_time_usec(struct libinput_event_pointer *event);
+
 /**
  * @ingroup event_pointer
  *
@@ -1436,6 +1558,102 @@ libinput_event_pointer_get_absolute_y_transformed(
 	struct libinput_event_pointer *event,
 	uint32_t height);
 
+/**
+ * @ingroup device
+ *
+ * A cached screen transform for a device with absolute axes. The scale
+ * factors for the given output dimensions are computed once at creation
+ * time, so the per-event transformed-coordinate accessors taking a
+ * transform avoid recomputing them on every call. Create one transform
+ * per output a device's events are mapped to.
+ *
+ * @since 1.20
+ */
+struct libinput_device_transform;
+
+/**
+ * @ingroup device
+ *
+ * Create a cached screen transform for this device, mapping the
+ * device's absolute axis ranges to the given output dimensions. The
+ * returned transform is only valid for events from this device.
+ *
+ * @param device The device to transform coordinates for
+ * @param width The output screen width
+ * @param height The output screen height
+ * @return A transform to be destroyed with
+ * libinput_device_transform_destroy(), or NULL if the device has no
+ * absolute axes
+ *
+ * @since 1.20
+ */
+struct libinput_device_transform *
+libinput_device_transform_create(struct libinput_device *device,
+				 uint32_t width,
+				 uint32_t height);
+
+/**
+ * @ingroup device
+ *
+ * Destroy a transform created by libinput_device_transform_create().
+ *
+ * @param transform The transform to destroy
+ *
+ * @since 1.20
+ */
+void
+libinput_device_transform_destroy(struct libinput_device_transform *transform);
+
+/**
+ * @ingroup event_pointer
+ *
+ * Return the current absolute x coordinate of the pointer event,
+ * transformed to screen coordinates through the given cached transform.
+ * Equivalent to libinput_event_pointer_get_absolute_x_transformed()
+ * with the dimensions the transform was created with, but without the
+ * per-call scale computation.
+ *
+ * @note It is an application bug to call this function for events other
+ * than @ref LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE, or with a transform
+ * created for a different device.
+ *
+ * @param event The libinput pointer event
+ * @param transform A transform created for this event's device
+ * @return The current absolute x coordinate transformed to a screen
+ * coordinate
+ *
+ * @since 1.20
+ */
+double
+libinput_event_pointer_get_absolute_x_transformed_by(
+	struct libinput_event_pointer *event,
+	const struct libinput_device_transform *transform);
+
+/**
+ * @ingroup event_pointer
+ *
+ * Return the current absolute y coordinate of the pointer event,
+ * transformed to screen coordinates through the given cached transform.
+ * Equivalent to libinput_event_pointer_get_absolute_y_transformed()
+ * with the dimensions the transform was created with, but without the
+ * per-call scale computation.
+ *
+ * @note It is an application bug to call this function for events other
+ * than @ref LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE, or with a transform
+ * created for a different device.
+ *
+ * @param event The libinput pointer event
+ * @param transform A transform created for this event's device
+ * @return The current absolute y coordinate transformed to a screen
+ * coordinate
+ *
+ * @since 1.20
+ */
+double
+libinput_event_pointer_get_absolute_y_transformed_by(
+	struct libinput_event_pointer *event,
+	const struct libinput_device_transform *transform);
+
 /**
  * @ingroup event_pointer
  *
@@ -1743,6 +1961,26 @@ libinput_event_touch_get_time(struct libinput_event_touch *event);
 uint64_t
 libinput_event_touch_get_time_usec(struct libinput_event_touch *event);
 
+/**
+ * @ingroup event_touch
+ *
+ * Return the kernel timestamp of the hardware event frame that
+ * triggered this event. This is the timestamp the kernel attached
+ * to the evdev event, before any processing delay within libinput.
+ * For events generated by libinput itself (e.g. from an internal
+ * timer), this is the timestamp of the most recent hardware frame
+ * from this device.
+ *
+ * @note Timestamps may not always increase. See the libinput
+ * documentation for more details.
+ *
+ * @return The kernel event time for this event in microseconds
+ *
+ * @since 1.20
+ */
+uint64_t
+libinput_event_touch_get_hw_time_usec(struct libinput_event_touch *event);
+
 /**
  * @ingroup event_touch
  *
@@ -1869,6 +2107,254 @@ double
 libinput_event_touch_get_y_transformed(struct libinput_event_touch *event,
 				       uint32_t height);
 
+/**
+ * @ingroup event_touch
+ *
+ * Return the current absolute x coordinate of the touch event,
+ * transformed to screen coordinates through the given cached transform.
+ * Equivalent to libinput_event_touch_get_x_transformed() with the
+ * dimensions the transform was created with, but without the per-call
+ * scale computation.
+ *
+ * @note It is an application bug to call this function for events of
+ * type other than @ref LIBINPUT_EVENT_TOUCH_DOWN or @ref
+ * LIBINPUT_EVENT_TOUCH_MOTION, or with a transform created for a
+ * different device.
+ *
+ * @param event The libinput touch event
+ * @param transform A transform created for this event's device
+ * @return The current absolute x coordinate transformed to a screen
+ * coordinate
+ *
+ * @since 1.20
+ */
+double
+libinput_event_touch_get_x_transformed_by(
+	struct libinput_event_touch *event,
+	const struct libinput_device_transform *transform);
+
+/**
+ * @ingroup event_touch
+ *
+ * Return the current absolute y coordinate of the touch event,
+ * transformed to screen coordinates through the given cached transform.
+ * Equivalent to libinput_event_touch_get_y_transformed() with the
+ * dimensions the transform was created with, but without the per-call
+ * scale computation.
+ *
+ * @note It is an application bug to call this function for events of
+ * type other than @ref LIBINPUT_EVENT_TOUCH_DOWN or @ref
+ * LIBINPUT_EVENT_TOUCH_MOTION, or with a transform created for a
+ * different device.
+ *
+ * @param event The libinput touch event
+ * @param transform A transform created for this event's device
+ * @return The current absolute y coordinate transformed to a screen
+ * coordinate
+ *
+ * @since 1.20
+ */
+double
+libinput_event_touch_get_y_transformed_by(
+	struct libinput_event_touch *event,
+	const struct libinput_device_transform *transform);
+
+/**
+ * @ingroup event_touch
+ *
+ * Return the number of per-slot changes carried by this touch frame
+ * event. This is zero unless frame aggregation has been enabled with
+ * libinput_device_touch_enable_frame_aggregation().
+ *
+ * For events not of type @ref LIBINPUT_EVENT_TOUCH_FRAME, this function
+ * returns 0.
+ *
+ * @note It is an application bug to call this function for events of type
+ * other than @ref LIBINPUT_EVENT_TOUCH_FRAME.
+ *
+ * @return The number of changes in this frame
+ *
+ * @since 1.20
+ */
+size_t
+libinput_event_touch_frame_get_num_changes(struct libinput_event_touch *event);
+
+/**
+ * @ingroup event_touch
+ *
+ * Return the type of the change at the given index in this touch frame
+ * event, one of @ref LIBINPUT_EVENT_TOUCH_DOWN, @ref
+ * LIBINPUT_EVENT_TOUCH_MOTION, @ref LIBINPUT_EVENT_TOUCH_UP or @ref
+ * LIBINPUT_EVENT_TOUCH_CANCEL.
+ *
+ * For an invalid index or events not of type @ref
+ * LIBINPUT_EVENT_TOUCH_FRAME, this function returns @ref
+ * LIBINPUT_EVENT_NONE.
+ *
+ * @note It is an application bug to call this function for events of type
+ * other than @ref LIBINPUT_EVENT_TOUCH_FRAME.
+ *
+ * @return The event type this change would have been delivered as
+ *
+ * @since 1.20
+ */
+enum libinput_event_type
+libinput_event_touch_frame_get_change_type(struct libinput_event_touch *event,
+					   size_t index);
+
+/**
+ * @ingroup event_touch
+ *
+ * Return the slot of the change at the given index in this touch frame
+ * event. See libinput_event_touch_get_slot() for the semantics of
+ * slots.
+ *
+ * @note It is an application bug to call this function for events of type
+ * other than @ref LIBINPUT_EVENT_TOUCH_FRAME.
+ *
+ * @return The slot of this change
+ *
+ * @since 1.20
+ */
+int32_t
+libinput_event_touch_frame_get_slot(struct libinput_event_touch *event,
+				    size_t index);
+
+/**
+ * @ingroup event_touch
+ *
+ * Return the seat slot of the change at the given index in this touch
+ * frame event. See libinput_event_touch_get_seat_slot() for the
+ * semantics of seat slots.
+ *
+ * @note It is an application bug to call this function for events of type
+ * other than @ref LIBINPUT_EVENT_TOUCH_FRAME.
+ *
+ * @return The seat slot of this change
+ *
+ * @since 1.20
+ */
+int32_t
+libinput_event_touch_frame_get_seat_slot(struct libinput_event_touch *event,
+					 size_t index);
+
+/**
+ * @ingroup event_touch
+ *
+ * Return the current absolute x coordinate, in mm from the top left
+ * corner of the device, of the change at the given index in this touch
+ * frame event. Only valid for changes of type @ref
+ * LIBINPUT_EVENT_TOUCH_DOWN and @ref LIBINPUT_EVENT_TOUCH_MOTION.
+ *
+ * @note It is an application bug to call this function for events of type
+ * other than @ref LIBINPUT_EVENT_TOUCH_FRAME.
+ *
+ * @return The current absolute x coordinate of this change
+ *
+ * @since 1.20
+ */
+double
+libinput_event_touch_frame_get_x(struct libinput_event_touch *event,
+				 size_t index);
+
+/**
+ * @ingroup event_touch
+ *
+ * Return the current absolute y coordinate, in mm from the top left
+ * corner of the device, of the change at the given index in this touch
+ * frame event. Only valid for changes of type @ref
+ * LIBINPUT_EVENT_TOUCH_DOWN and @ref LIBINPUT_EVENT_TOUCH_MOTION.
+ *
+ * @note It is an application bug to call this function for events of type
+ * other than @ref LIBINPUT_EVENT_TOUCH_FRAME.
+ *
+ * @return The current absolute y coordinate of this change
+ *
+ * @since 1.20
+ */
+double
+libinput_event_touch_frame_get_y(struct libinput_event_touch *event,
+				 size_t index);
+
+/**
+ * @ingroup event_touch
+ *
+ * Return the current absolute x coordinate of the change at the given
+ * index in this touch frame event, transformed to screen coordinates.
+ * Only valid for changes of type @ref LIBINPUT_EVENT_TOUCH_DOWN and
+ * @ref LIBINPUT_EVENT_TOUCH_MOTION.
+ *
+ * @note It is an application bug to call this function for events of type
+ * other than @ref LIBINPUT_EVENT_TOUCH_FRAME.
+ *
+ * @param event The touch frame event
+ * @param index The index of the change
+ * @param width The current output screen width
+ * @return The current absolute x coordinate of this change, transformed to
+ * a screen coordinate
+ *
+ * @since 1.20
+ */
+double
+libinput_event_touch_frame_get_x_transformed(struct libinput_event_touch *event,
+					     size_t index,
+					     uint32_t width);
+
+/**
+ * @ingroup event_touch
+ *
+ * Return the current absolute y coordinate of the change at the given
+ * index in this touch frame event, transformed to screen coordinates.
+ * Only valid for changes of type @ref LIBINPUT_EVENT_TOUCH_DOWN and
+ * @ref LIBINPUT_EVENT_TOUCH_MOTION.
+ *
+ * @note It is an application bug to call this function for events of type
+ * other than @ref LIBINPUT_EVENT_TOUCH_FRAME.
+ *
+ * @param event The touch frame event
+ * @param index The index of the change
+ * @param height The current output screen height
+ * @return The current absolute y coordinate of this change, transformed to
+ * a screen coordinate
+ *
+ * @since 1.20
+ */
+double
+libinput_event_touch_frame_get_y_transformed(struct libinput_event_touch *event,
+					     size_t index,
+					     uint32_t height);
+
+/**
+ * @ingroup event_touch
+ *
+ * Transform the coordinates of all changes in this touch frame event to
+ * screen coordinates through the given cached transform, in one call.
+ * The i-th entry of the output arrays corresponds to the change at
+ * index i; entries for changes of type other than @ref
+ * LIBINPUT_EVENT_TOUCH_DOWN and @ref LIBINPUT_EVENT_TOUCH_MOTION carry
+ * no meaningful coordinates.
+ *
+ * @note It is an application bug to call this function for events of type
+ * other than @ref LIBINPUT_EVENT_TOUCH_FRAME, or with a transform
+ * created for a different device.
+ *
+ * @param event The touch frame event
+ * @param transform A transform created for this event's device
+ * @param x Array to be filled with the transformed x coordinates
+ * @param y Array to be filled with the transformed y coordinates
+ * @param npoints The size of both arrays
+ * @return The number of entries written to each array
+ *
+ * @since 1.20
+ */
+size_t
+libinput_event_touch_frame_get_points_transformed_by(
+	struct libinput_event_touch *event,
+	const struct libinput_device_transform *transform,
+	double *x,
+	double *y,
+	size_t npoints);
+
 /**
  * @ingroup event_touch
  *
@@ -1913,6 +2399,26 @@ libinput_event_gesture_get_time(struct libinput_event_gesture *event);
 uint64_t
 libinput_event_gesture_get_time_usec(struct libinput_event_gesture *event);
 
+/**
+ * @ingroup event_gesture
+ *
+ * Return the kernel timestamp of the hardware event frame that
+ * triggered this event. This is the timestamp the kernel attached
+ * to the evdev event, before any processing delay within libinput.
+ * For events generated by libinput itself (e.g. from an internal
+ * timer), this is the timestamp of the most recent hardware frame
+ * from this device.
+ *
+ * @note Timestamps may not always increase. See the libinput
+ * documentation for more details.
+ *
+ * @return The kernel event time for this event in microseconds
+ *
+ * @since 1.20
+ */
+uint64_t
+libinput_event_gesture_get_hw_time_usec(struct libinput_event_gesture *event);
+
 /**
  * @ingroup event_gesture
  *
@@ -2814,6 +3320,26 @@ libinput_event_tablet_tool_get_time(struct libinput_event_tablet_tool *event);
 uint64_t
 libinput_event_tablet_tool_get_time_usec(struct libinput_event_tablet_tool *event);
 
+/**
+ * @ingroup event_tablet
+ *
+ * Return the kernel timestamp of the hardware event frame that
+ * triggered this event. This is the timestamp the kernel attached
+ * to the evdev event, before any processing delay within libinput.
+ * For events generated by libinput itself (e.g. from an internal
+ * timer), this is the timestamp of the most recent hardware frame
+ * from this device.
+ *
+ * @note Timestamps may not always increase. See the libinput
+ * documentation for more details.
+ *
+ * @return The kernel event time for this event in microseconds
+ *
+ * @since 1.20
+ */
+uint64_t
+libinput_event_tablet_tool_get_hw_time_usec(struct libinput_event_tablet_tool *event);
+
 /**
  * @ingroup event_tablet
  *
@@ -3403,6 +3929,26 @@ libinput_event_tablet_pad_get_time(struct libinput_event_tablet_pad *event);
 uint64_t
 libinput_event_tablet_pad_get_time_usec(struct libinput_event_tablet_pad *event);
 
+/**
+ * @ingroup event_tablet_pad
+ *
+ * Return the kernel timestamp of the hardware event frame that
+ * triggered this event. This is the timestamp the kernel attached
+ * to the evdev event, before any processing delay within libinput.
+ * For events generated by libinput itself (e.g. from an internal
+ * timer), this is the timestamp of the most recent hardware frame
+ * from this device.
+ *
+ * @note Timestamps may not always increase. See the libinput
+ * documentation for more details.
+ *
+ * @return The kernel event time for this event in microseconds
+ *
+ * @since 1.20
+ */
+uint64_t
+libinput_event_tablet_pad_get_hw_time_usec(struct libinput_event_tablet_pad *event);
+
 /**
  * @defgroup event_switch Switch events
  *
@@ -3484,12 +4030,32 @@ uint64_t
 libinput_event_switch_get_time_usec(struct libinput_event_switch *event);
 
 /**
- * @defgroup base Initialization and manipulation of libinput contexts
- */
-
-/**
- * @ingroup base
- * @struct libinput_interface
+ * @ingroup event_switch
+ *
+ * Return the kernel timestamp of the hardware event frame that
+ * triggered this event. This is the timestamp the kernel attached
+ * to the evdev event, before any processing delay within libinput.
+ * For events generated by libinput itself (e.g. from an internal
+ * timer), this is the timestamp of the most recent hardware frame
+ * from this device.
+ *
+ * @note Timestamps may not always increase. See the libinput
+ * documentation for more details.
+ *
+ * @return The kernel event time for this event in microseconds
+ *
+ * @since 1.20
+ */
+uint64_t
+libinput_event_switch_get_hw_time_usec(struct libinput_event_switch *event);
+
+/**
+ * @defgroup base Initialization and manipulation of libinput contexts
+ */
+
+/**
+ * @ingroup base
+ * @struct libinput_interface
  *
  * libinput does not open file descriptors to devices directly, instead
  * open_restricted() and close_restricted() are called for each path that
@@ -3508,7 +4074,17 @@ struct libinput_interface {
 	 * @param user_data The user_data provided in
 	 * libinput_udev_create_context()
 	 *
-	 * @return The file descriptor, or a negative errno on failure.
+	 * When re-opening an already known device, e.g. when it is
+	 * re-enabled with @ref
+	 * LIBINPUT_CONFIG_SEND_EVENTS_ENABLED, this callback may return
+	 * -EINPROGRESS to open the device asynchronously. The caller
+	 * must then complete the open with
+	 * libinput_device_open_complete(). -EINPROGRESS is treated as a
+	 * failure for devices libinput does not know about yet, i.e.
+	 * during initial enumeration or hotplug.
+	 *
+	 * @return The file descriptor, -EINPROGRESS for an asynchronous
+	 * open, or a negative errno on failure.
 	 */
 	int (*open_restricted)(const char *path, int flags, void *user_data);
 	/**
@@ -3611,6 +4187,42 @@ struct libinput_device *
 libinput_path_add_device(struct libinput *libinput,
 			 const char *path);
 
+/**
+ * @ingroup base
+ *
+ * Add a fixed set of devices to a libinput context initialized with
+ * libinput_path_create_context(). This is equivalent to calling
+ * libinput_path_add_device() for each path, except that all bookkeeping
+ * structures are allocated in a single block. Use this on setups where
+ * the full device set is known up front and memory and startup time
+ * matter.
+ *
+ * Adding the devices is all-or-nothing: if any device fails to
+ * initialize, devices already added by this call are removed again and
+ * the call fails. Individual devices can still be removed with
+ * libinput_path_remove_device(), but this function may only be called
+ * once per context.
+ *
+ * Use libinput_get_event() to retrieve the @ref
+ * LIBINPUT_EVENT_DEVICE_ADDED events for the new devices, or use
+ * libinput_device_ref() from within the @ref LIBINPUT_EVENT_DEVICE_ADDED
+ * event handler to keep a permanent reference.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param paths Array of paths to input devices
+ * @param npaths Number of elements in paths
+ * @return Zero on success, or -1 on failure
+ *
+ * @note It is an application bug to call this function on a libinput
+ * context initialized with libinput_udev_create_context().
+ *
+ * @since 1.20
+ */
+int
+libinput_path_add_devices(struct libinput *libinput,
+			  const char **paths,
+			  size_t npaths);
+
 /**
  * @ingroup base
  *
@@ -3663,6 +4275,37 @@ libinput_get_fd(struct libinput *libinput);
 int
 libinput_dispatch(struct libinput *libinput);
 
+/**
+ * @ingroup base
+ *
+ * Like libinput_dispatch(), but stop once the given time budget is
+ * used up and report whether ready input remains. This lets a caller
+ * with its own deadline - typically a compositor inside its frame
+ * window - interleave input processing with rendering instead of
+ * draining a worst-case burst in one go.
+ *
+ * The budget is checked between devices: each device's pending events
+ * are processed in full, so the call can overrun the budget by one
+ * device's queue. Devices left unprocessed keep the fd returned by
+ * libinput_get_fd() readable and are picked up first-come on the next
+ * call, with the starting device rotating so one busy device cannot
+ * starve the others. A return value of 1 means ready input remains and
+ * the function should be called again once the caller can afford it.
+ *
+ * A budget of 0 means no deadline; the call then behaves exactly like
+ * libinput_dispatch().
+ *
+ * @param libinput A previously initialized libinput context
+ * @param budget Time budget in microseconds, or 0 for no budget
+ *
+ * @return 0 when all pending input was processed, 1 when the budget
+ * expired with input still pending, or a negative errno on failure
+ *
+ * @since 1.20
+ */
+int
+libinput_dispatch_budget(struct libinput *libinput, uint64_t budget);
+
 /**
  * @ingroup base
  *
@@ -3677,6 +4320,416 @@ libinput_dispatch(struct libinput *libinput);
 struct libinput_event *
 libinput_get_event(struct libinput *libinput);
 
+/**
+ * @ingroup base
+ *
+ * Retrieve up to max events from libinput's internal event queue in one
+ * call. Events are written to the out array in queue order, oldest first.
+ * This is equivalent to calling libinput_get_event() up to max times but
+ * amortizes the per-call overhead for callers draining the queue after
+ * libinput_dispatch().
+ *
+ * After handling the retrieved events, the caller must destroy each of
+ * them using libinput_event_destroy().
+ *
+ * @param libinput A previously initialized libinput context
+ * @param out Caller-allocated array to store the events in
+ * @param max The maximum number of events to store in out
+ * @return The number of events stored in out, zero if no event is
+ * available.
+ *
+ * @since 1.20
+ */
+size_t
+libinput_get_events(struct libinput *libinput,
+		    struct libinput_event **out,
+		    size_t max);
+
+/**
+ * @ingroup base
+ *
+ * Accounting counters for libinput's internal event queue, see
+ * libinput_get_event_queue_stats(). All counters are zero on context
+ * creation and are never reset.
+ *
+ * @since 1.20
+ */
+struct libinput_event_queue_stats {
+	/** Number of events currently queued */
+	uint64_t current_depth;
+	/** Highest number of events queued at the same time */
+	uint64_t max_depth;
+	/** Number of times the internal queue had to grow */
+	uint64_t num_grows;
+	/** Number of motion events dropped by the queue limit, see
+	 * libinput_set_event_queue_limit() */
+	uint64_t num_dropped;
+};
+
+/**
+ * @ingroup base
+ *
+ * Get the accounting counters for libinput's internal event queue.
+ *
+ * The queue grows on demand when the caller does not drain it between
+ * calls to libinput_dispatch(). A steadily climbing maximum depth or grow
+ * count indicates the caller is stalling, each grow doubles the memory
+ * used by the queue.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param stats Set to the current counters
+ *
+ * @since 1.20
+ */
+void
+libinput_get_event_queue_stats(struct libinput *libinput,
+			       struct libinput_event_queue_stats *stats);
+
+/**
+ * @ingroup base
+ *
+ * Limit the size of libinput's internal event queue. By default the queue
+ * grows without bound while the caller does not drain it. With a limit in
+ * place, pointer, touch and gesture motion events posted to a full queue
+ * are dropped and counted in struct libinput_event_queue_stats instead of
+ * growing the queue further. Motion events coalesce naturally - the next
+ * motion supersedes the dropped one - so a stalled caller loses
+ * intermediate coordinates but no state transitions; all other event
+ * types ignore the limit.
+ *
+ * A limit smaller than the current queue size takes effect once the
+ * caller has drained the queue below the limit.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param limit The maximum number of queued events, or 0 to remove the
+ * limit
+ *
+ * @since 1.20
+ */
+void
+libinput_set_event_queue_limit(struct libinput *libinput, size_t limit);
+
+/**
+ * @ingroup base
+ *
+ * Write a compact binary snapshot of the input pipeline state to the
+ * given file descriptor: the event queue indices and accounting
+ * counters, plus one record per device with its dispatch type tag and
+ * frame/event counters.
+ *
+ * This function is async-signal-safe. The snapshot is mirrored into a
+ * flat buffer during normal dispatch, so calling it from a crash handler
+ * only write(2)s that buffer - no allocation, no locking and no
+ * traversal of possibly-corrupted heap structures.
+ *
+ * The snapshot starts with a 32-bit magic ("ildp") followed by a 32-bit
+ * layout version. The layout may change between libinput versions,
+ * consumers must check the version before interpreting the rest.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param fd The file descriptor to write the snapshot to
+ * @return 0 on success, or a negative errno on write failure
+ *
+ * @since 1.20
+ */
+int
+libinput_crash_dump(struct libinput *libinput, int fd);
+
+/**
+ * @ingroup base
+ *
+ * Per-subsystem heap usage of a libinput context, see
+ * libinput_get_memory_stats(). All sizes are in bytes and cover the
+ * allocations owned by the context, not the per-device dispatch state.
+ *
+ * @since 1.20
+ */
+struct libinput_memory_stats {
+	/** The internal event queue and its staging ring */
+	size_t queue_bytes;
+	/** Slabs backing events handed out to the caller */
+	size_t event_pool_bytes;
+	/** Known tablet tools, including recycled ones */
+	size_t tools_bytes;
+	/** The parsed device quirks database */
+	size_t quirks_bytes;
+	/** Sum of the above */
+	size_t total_bytes;
+};
+
+/**
+ * @ingroup base
+ *
+ * Get the current heap usage of this context, broken down by subsystem.
+ *
+ * The dominant variable cost is the event queue: it doubles whenever the
+ * caller does not drain it between calls to libinput_dispatch() and does
+ * not shrink on its own, see libinput_set_memory_budget().
+ *
+ * @param libinput A previously initialized libinput context
+ * @param stats Set to the current usage
+ *
+ * @since 1.20
+ */
+void
+libinput_get_memory_stats(struct libinput *libinput,
+			  struct libinput_memory_stats *stats);
+
+/**
+ * @ingroup base
+ *
+ * Allocation counters for one internal subsystem, filled in by
+ * libinput_get_allocation_stats(). All counters except bytes are
+ * cumulative over the lifetime of the process, derive rates by
+ * sampling twice and diffing.
+ *
+ * @since 1.20
+ */
+struct libinput_allocation_stats {
+	/** Static string naming the subsystem, e.g. "queue" */
+	const char *subsystem;
+	/** Number of allocations ever made */
+	uint64_t allocations;
+	/** Number of frees ever made */
+	uint64_t frees;
+	/** Bytes currently outstanding */
+	uint64_t bytes;
+	/** Bytes ever allocated */
+	uint64_t bytes_total;
+};
+
+/**
+ * @ingroup base
+ *
+ * Get per-subsystem allocation counters, one array entry per
+ * subsystem. The set of subsystems is an implementation detail and may
+ * change between versions, identify entries by their subsystem name.
+ *
+ * The counters are process-wide, not per-context, and are only
+ * recorded when libinput was built with -Dalloc-stats=true. Without
+ * that option this function fills nothing.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param stats An array of at least nstats entries to be filled in
+ * @param nstats The number of entries in the stats array
+ * @return The number of entries filled in, 0 if accounting is not
+ * compiled in
+ *
+ * @since 1.20
+ */
+size_t
+libinput_get_allocation_stats(struct libinput *libinput,
+			      struct libinput_allocation_stats *stats,
+			      size_t nstats);
+
+/**
+ * @ingroup base
+ *
+ * Set a soft memory budget for this context. While the total usage
+ * reported by libinput_get_memory_stats() exceeds the budget,
+ * libinput_dispatch() releases caches that are safe to drop when the
+ * context is idle: a grown event queue shrinks back to its initial size
+ * once drained, unused event slabs and recycled tablet tools are freed.
+ *
+ * This is a ceiling on cache retention, not a hard limit: memory in
+ * active use - queued events, events handed out to the caller - is never
+ * released, and usage may exceed the budget while the caller lags
+ * behind. Use libinput_set_event_queue_limit() to bound the queue
+ * itself.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param budget The budget in bytes, or 0 to remove the budget
+ *
+ * @since 1.20
+ */
+void
+libinput_set_memory_budget(struct libinput *libinput, size_t budget);
+
+/**
+ * @ingroup base
+ *
+ * Enable the idle governor for this context. Once no input has arrived
+ * for the given timeout, the context drops its grown caches - the same
+ * set released by the memory budget, see libinput_set_memory_budget() -
+ * and stops re-arming its internal timerfd, so a quiet context causes
+ * zero wakeups until the next input event. Full readiness is restored
+ * on the first dispatch that sees events; the caches regrow on demand.
+ *
+ * The governor itself wakes at most once per timeout period while input
+ * is flowing, to check whether the quiet period has been reached.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param timeout_ms The quiet period in milliseconds, or 0 to disable
+ * the governor (the default)
+ *
+ * @since 1.20
+ */
+void
+libinput_set_idle_timeout(struct libinput *libinput, uint32_t timeout_ms);
+
+/**
+ * @ingroup base
+ *
+ * Enable in-queue compression of pointer motion events. When enabled and
+ * a motion event is posted while the previous undelivered event in the
+ * queue is a motion event from the same device, the deltas are summed
+ * into the queued event instead of queueing a new one, with the
+ * timestamp advancing to the newest motion. This bounds queue growth and
+ * drain cost while the caller stalls.
+ *
+ * Intermediate coordinates are lost, so only enable this if motion
+ * deltas are accumulated anyway. The compressed event reports the summed
+ * accelerated and unaccelerated deltas; all other event types are
+ * unaffected and still interleave normally - motion is only merged when
+ * nothing else was queued in between.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param enabled Non-zero to enable, zero to disable
+ *
+ * @since 1.20
+ */
+void
+libinput_set_motion_compression(struct libinput *libinput, int enabled);
+
+/**
+ * @ingroup base
+ *
+ * Enable cross-device time ordering of events. When several devices
+ * have data ready in one libinput_dispatch() cycle, their events are
+ * normally queued in the order the file descriptors are processed, so
+ * two devices' events may be interleaved out of timestamp order by up
+ * to a full cycle. With ordering enabled, each cycle's batch is
+ * re-sorted by hardware timestamp before it is exposed via
+ * libinput_get_event().
+ *
+ * The sort is stable and never reorders events of the same device.
+ * Events that carry no hardware timestamp (e.g. @ref
+ * LIBINPUT_EVENT_DEVICE_ADDED) keep their position and no event is
+ * moved across them. Ordering is disabled by default.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param enabled Non-zero to enable, zero to disable
+ *
+ * @since 1.20
+ */
+void
+libinput_set_event_ordering(struct libinput *libinput, int enabled);
+
+/**
+ * @ingroup base
+ *
+ * Enable or disable the legacy @ref LIBINPUT_EVENT_POINTER_AXIS events
+ * for this context. For backwards compatibility every scroll event is
+ * posted twice, once as the source-specific event (@ref
+ * LIBINPUT_EVENT_POINTER_SCROLL_WHEEL, @ref
+ * LIBINPUT_EVENT_POINTER_SCROLL_FINGER, @ref
+ * LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS) and once as the deprecated
+ * @ref LIBINPUT_EVENT_POINTER_AXIS event. A caller that only handles
+ * the source-specific events should disable the legacy events and save
+ * the allocation, queueing and draining of an event it discards anyway -
+ * on a free-spinning wheel the legacy copies double the scroll traffic.
+ *
+ * This only affects events posted after this call. Legacy events are
+ * enabled by default.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param enabled Non-zero to post legacy axis events (the default),
+ * zero to post only the source-specific scroll events
+ *
+ * @since 1.20
+ */
+void
+libinput_set_legacy_scroll_events_enabled(struct libinput *libinput,
+					  int enabled);
+
+/**
+ * @ingroup base
+ *
+ * Re-parse the device quirks from disk and re-apply them to the devices
+ * of this context. Each device's resolved quirk set is compared between
+ * the old and the new data; only devices whose effective quirk values
+ * changed are re-probed, all other devices are left untouched. A
+ * re-probed device is removed and recreated, so the caller receives a
+ * @ref LIBINPUT_EVENT_DEVICE_REMOVED and a @ref
+ * LIBINPUT_EVENT_DEVICE_ADDED event for it on the next
+ * libinput_dispatch() and must drop its old device handle.
+ *
+ * Non-default device configuration applied by the caller is not carried
+ * over to the recreated device.
+ *
+ * If the new quirks fail to parse, the context keeps using the
+ * previously loaded quirks and no device is touched.
+ *
+ * @param libinput A previously initialized libinput context
+ * @return The number of devices re-probed on success, or a negative
+ * value if the quirks could not be loaded
+ *
+ * @since 1.20
+ */
+int
+libinput_quirks_reload(struct libinput *libinput);
+
+/**
+ * @ingroup base
+ *
+ * Allocation callback for hot event storage, see
+ * libinput_set_allocation_hooks(). Must return a pointer suitably
+ * aligned for any object of size @p size, or NULL on failure. The
+ * memory does not need to be zeroed. On failure libinput falls back to
+ * the C library allocator for that allocation.
+ *
+ * @since 1.20
+ */
+typedef void *(*libinput_alloc_func)(size_t size, void *user_data);
+
+/**
+ * @ingroup base
+ *
+ * Free callback for memory previously returned by the matching @ref
+ * libinput_alloc_func. @p size is the size originally requested.
+ *
+ * @since 1.20
+ */
+typedef void (*libinput_free_func)(void *ptr, size_t size, void *user_data);
+
+/**
+ * @ingroup base
+ *
+ * Provide caller-supplied allocators for libinput's hot event storage,
+ * i.e. the event memory pool and the internal event queue. This allows
+ * a caller with pinned threads to place input data on a specific NUMA
+ * node, e.g. by backing the callbacks with numa_alloc_onnode().
+ * Large per-device state - the touchpad touch-tracking arrays - is
+ * also placed through the hooks, so it can be backed by hugepages to
+ * reduce TLB pressure on devices with many touchpoints. These arrays
+ * require cache-line (64-byte) alignment; a hook returning memory with
+ * weaker alignment is only used for the event storage.
+ *
+ * The hooks can be installed at most once per context and cannot be
+ * changed or removed afterwards; install them immediately after context
+ * creation so all event storage is placed through them. Storage
+ * allocated at context creation time, in particular the staging ring
+ * used by libinput_device_inject_events(), is not affected.
+ *
+ * Events handed out to the caller may outlive the context, so @p
+ * free_func and @p user_data must remain valid until the last event has
+ * been destroyed, even if that is after libinput_unref() returned NULL.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param alloc_func The allocation callback, must not be NULL
+ * @param free_func The free callback, must not be NULL
+ * @param user_data Caller-specific data passed to both callbacks
+ * @return 0 on success, or -1 if either callback is NULL or hooks are
+ * already installed
+ *
+ * @since 1.20
+ */
+int
+libinput_set_allocation_hooks(struct libinput *libinput,
+			      libinput_alloc_func alloc_func,
+			      libinput_free_func free_func,
+			      void *user_data);
+
 /**
  * @ingroup base
  *
@@ -3691,6 +4744,146 @@ libinput_get_event(struct libinput *libinput);
 enum libinput_event_type
 libinput_next_event_type(struct libinput *libinput);
 
+/**
+ * @ingroup base
+ *
+ * Return the next event in the internal queue without removing it. The
+ * event remains owned by the libinput context: the caller must not call
+ * libinput_event_destroy() on it and the returned pointer is only valid
+ * until the event is removed from the queue, i.e. until the next call to
+ * libinput_get_event(), libinput_get_events() or
+ * libinput_consume_event().
+ *
+ * Use this together with libinput_consume_event() to inspect events
+ * without taking ownership, e.g. in a proxy that discards most events
+ * unmodified. To take ownership of the event, use libinput_get_event()
+ * which returns this same event.
+ *
+ * @param libinput A previously initialized libinput context
+ * @return The next event in the queue, or NULL if no event is available
+ *
+ * @since 1.20
+ */
+struct libinput_event *
+libinput_peek_event(struct libinput *libinput);
+
+/**
+ * @ingroup base
+ *
+ * Remove the next event from the internal queue and destroy it, without
+ * ever transferring ownership to the caller. This is equivalent to
+ * libinput_get_event() followed by libinput_event_destroy() and is the
+ * counterpart to libinput_peek_event() for events the caller does not
+ * want.
+ *
+ * If no event is queued, this function does nothing.
+ *
+ * @param libinput A previously initialized libinput context
+ *
+ * @since 1.20
+ */
+void
+libinput_consume_event(struct libinput *libinput);
+
+/**
+ * @ingroup base
+ * @struct libinput_gesture_frame
+ *
+ * A per-frame summary of the touch state on a gesture-capable device,
+ * passed to gesture matcher callbacks registered with
+ * libinput_register_gesture_matcher(). All coordinates and deltas are in
+ * mm, with the top-left corner of the device as origin.
+ *
+ * @since 1.20
+ */
+struct libinput_gesture_frame {
+	/** Timestamp of this frame in microseconds */
+	uint64_t time;
+	/** Number of fingers in the current gesture. May exceed the number
+	    of entries in @ref touches on devices that can only count extra
+	    fingers. */
+	uint32_t finger_count;
+	/** Number of valid entries in @ref touches */
+	uint32_t ntouches;
+	/** Position of each active touch in mm */
+	struct {
+		double x;
+		double y;
+	} touches[4];
+	/** Movement of the fingers since the last frame, in mm, averaged
+	    across the active touches */
+	double dx;
+	double dy;
+};
+
+/**
+ * @ingroup base
+ *
+ * Gesture matcher callback, invoked once per touch frame on
+ * gesture-capable devices before libinput's built-in gesture detection.
+ *
+ * A matcher that recognizes the frame as part of a custom gesture must
+ * return nonzero to claim the frame; libinput then skips its built-in
+ * gesture detection for that frame. Return zero to leave the frame to
+ * the remaining matchers and the built-in detection.
+ *
+ * The frame struct is owned by libinput and only valid for the duration
+ * of the call.
+ *
+ * @since 1.20
+ */
+typedef int (*libinput_gesture_matcher)(
+	struct libinput_device *device,
+	const struct libinput_gesture_frame *frame,
+	void *user_data);
+
+/**
+ * @ingroup base
+ *
+ * Register a gesture matcher with this context. Matchers are called in
+ * registration order for every touch frame on gesture-capable devices,
+ * see @ref libinput_gesture_matcher. A context with no registered
+ * matchers behaves as before, the per-frame cost is a single check.
+ *
+ * The same matcher function may be registered multiple times with
+ * different user_data pointers and is called once per registration.
+ *
+ * A matcher that wants to emit events of its own can do so through
+ * libinput_device_inject_events().
+ *
+ * @param libinput A previously initialized libinput context
+ * @param matcher The matcher callback to register
+ * @param user_data Caller-specific data passed to the matcher
+ * @return 0 on success, or -1 if matcher is NULL
+ *
+ * @since 1.20
+ */
+int
+libinput_register_gesture_matcher(struct libinput *libinput,
+				  libinput_gesture_matcher matcher,
+				  void *user_data);
+
+/**
+ * @ingroup base
+ *
+ * Remove a gesture matcher previously registered with
+ * libinput_register_gesture_matcher(). Both the matcher function and the
+ * user_data pointer must match the registration. If the matcher was
+ * registered multiple times, only the most recent registration is
+ * removed.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param matcher The matcher callback to remove
+ * @param user_data The user_data pointer used at registration time
+ * @return 0 on success, or -1 if no such matcher is registered
+ *
+ * @since 1.20
+ */
+int
+libinput_unregister_gesture_matcher(struct libinput *libinput,
+				    libinput_gesture_matcher matcher,
+				    void *user_data);
+
 /**
  * @ingroup base
  *
@@ -3745,6 +4938,36 @@ libinput_resume(struct libinput *libinput);
 void
 libinput_suspend(struct libinput *libinput);
 
+/**
+ * @ingroup base
+ *
+ * Hand the source context's devices over to this context without
+ * re-probing them. Every device in the source context is suspended and
+ * its open file descriptor transferred; when a seat is subsequently
+ * assigned to this context (e.g. via libinput_udev_assign_seat()), the
+ * transferred descriptors are picked up instead of opening the devices
+ * again through the libinput_interface. The parsed quirks database is
+ * shared with the source context.
+ *
+ * Call this on a freshly created context before assigning a seat or
+ * adding devices. Both contexts must use compatible
+ * libinput_interface implementations: a transferred descriptor is
+ * eventually closed through this context's close_restricted().
+ *
+ * The source context remains valid; its devices behave as if
+ * libinput_suspend() had been called and resume by reopening their
+ * devices.
+ *
+ * @param libinput A previously initialized libinput context without
+ * devices
+ * @param source The live context to take the devices from
+ * @return The number of transferred devices, or -1 on error
+ *
+ * @since 1.20
+ */
+int
+libinput_clone_context(struct libinput *libinput, struct libinput *source);
+
 /**
  * @ingroup base
  *
@@ -3865,6 +5088,49 @@ void
 libinput_log_set_handler(struct libinput *libinput,
 			 libinput_log_handler log_handler);
 
+/**
+ * @ingroup base
+ *
+ * Redirect log messages into an in-memory ring of nrecords fixed-size
+ * records instead of the log handler. Messages are formatted into
+ * preallocated storage at log time, so enabling debug-level logging does
+ * not cost a handler invocation per message on the event path. When the
+ * ring is full the oldest record is overwritten.
+ *
+ * Use libinput_log_ring_pop() to drain the ring. A size of 0 disables
+ * the ring and restores the log handler; any undrained records are
+ * discarded.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param nrecords The number of log records to hold, or 0 to disable
+ * @return 0 on success, or a negative errno on failure
+ *
+ * @since 1.20
+ */
+int
+libinput_log_set_ring_size(struct libinput *libinput, size_t nrecords);
+
+/**
+ * @ingroup base
+ *
+ * Remove the oldest message from the log ring and copy it into buf,
+ * always null-terminated and truncated to len if need be.
+ *
+ * @param libinput A previously initialized libinput context
+ * @param priority Set to the priority of the returned message, may be NULL
+ * @param buf Caller-allocated storage for the message
+ * @param len The size of buf in bytes
+ * @return The number of bytes copied including the terminating zero, or
+ * 0 if the ring is empty or disabled
+ *
+ * @since 1.20
+ */
+size_t
+libinput_log_ring_pop(struct libinput *libinput,
+		      enum libinput_log_priority *priority,
+		      char *buf,
+		      size_t len);
+
 /**
  * @defgroup seat Initialization and manipulation of seats
  *
@@ -4040,6 +5306,298 @@ libinput_device_get_user_data(struct libinput_device *device);
 struct libinput *
 libinput_device_get_context(struct libinput_device *device);
 
+/**
+ * @ingroup device
+ *
+ * Complete an asynchronous open of this device. Must be called exactly
+ * once after @ref libinput_interface::open_restricted returned
+ * -EINPROGRESS for a re-open of this device, with the opened file
+ * descriptor or a negative errno if the open failed.
+ *
+ * On success, the device resumes sending events. If the device was
+ * suspended or removed while the open was in flight, the file
+ * descriptor is closed through @ref
+ * libinput_interface::close_restricted and this function returns
+ * -ENODEV.
+ *
+ * @param device A previously obtained device
+ * @param fd The file descriptor, or a negative errno on failure
+ * @return 0 on success or a negative errno on failure
+ *
+ * @since 1.20
+ */
+int
+libinput_device_open_complete(struct libinput_device *device, int fd);
+
+struct input_event;
+
+/**
+ * @ingroup device
+ *
+ * Feed a caller-constructed evdev event stream into this device's
+ * processing pipeline, exactly as if the events had been read from the
+ * device node. This is a benchmarking and testing aid: it allows
+ * deterministic, in-process throughput measurements of the full event
+ * pipeline without uinput, root privileges or kernel round-trips.
+ *
+ * Events are batched into frames at each SYN_REPORT, like the normal
+ * read path. Event timestamps must be in CLOCK_MONOTONIC and must not
+ * go backwards relative to previously processed events. Resulting
+ * libinput events are queued on the context and must be drained with
+ * libinput_get_event() as usual.
+ *
+ * Injected events are not synchronized with the kernel's view of the
+ * device. Injecting events on a device that is simultaneously
+ * delivering real input yields undefined results.
+ *
+ * @param device A previously obtained device
+ * @param events Array of evdev events to process
+ * @param nevents Number of entries in @a events
+ * @return 0 on success, or a negative errno on failure
+ *
+ * @since 1.20
+ */
+int
+libinput_device_inject_events(struct libinput_device *device,
+			      const struct input_event *events,
+			      size_t nevents);
+
+/**
+ * @ingroup device
+ *
+ * Subscribe the given context to this device's event stream. The device
+ * keeps being owned, read and processed by its own context; every event
+ * queued there is additionally copied onto the subscribed context's
+ * queue, to be drained with libinput_get_event() as usual. This lets a
+ * second in-process consumer (e.g. a gesture engine beside the
+ * compositor) see a device's decoded events without opening the device
+ * node a second time and without a second kernel read stream.
+ *
+ * Mirrored events reference the original device: @ref
+ * libinput_event_get_device() returns the device of the owning context
+ * and @ref libinput_event_get_context() returns the owning context, not
+ * the subscribed one. Only event types with a serialized representation
+ * are mirrored; device notify events in particular are not. Both
+ * contexts must be dispatched from the same thread. Mirrored events do
+ * not make the subscribed context's file descriptor signal readable;
+ * dispatch it after dispatching the owning context.
+ *
+ * Events are only mirrored while the subscription is active. The caller
+ * must unsubscribe with libinput_device_unshare_events() before
+ * destroying the subscribed context.
+ *
+ * @param libinput The context to receive copies of the device's events
+ * @param device A device of a different context
+ * @return 0 on success, -1 if the device belongs to this context or the
+ * subscription already exists
+ *
+ * @since 1.20
+ */
+int
+libinput_device_share_events(struct libinput *libinput,
+			     struct libinput_device *device);
+
+/**
+ * @ingroup device
+ *
+ * Remove a subscription established with
+ * libinput_device_share_events(). Events already copied onto the
+ * subscribed context's queue remain there.
+ *
+ * @param libinput The context subscribed to the device's events
+ * @param device The device passed to libinput_device_share_events()
+ * @return 0 on success, -1 if no such subscription exists
+ *
+ * @since 1.20
+ */
+int
+libinput_device_unshare_events(struct libinput *libinput,
+			       struct libinput_device *device);
+
+/**
+ * @ingroup device
+ *
+ * Suppress events of the given types for this device. Suppressed event
+ * types are discarded before they are queued, saving the cost of
+ * allocating, queuing and draining events the caller will never read.
+ * A caller that ignores a whole event class (e.g. @ref
+ * LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE or the tablet axis events)
+ * should mask it out rather than drain and discard.
+ *
+ * The set of suppressed types is replaced on each call; passing a
+ * ntypes of zero re-enables all events. @ref LIBINPUT_EVENT_DEVICE_ADDED
+ * and @ref LIBINPUT_EVENT_DEVICE_REMOVED cannot be suppressed.
+ *
+ * Internal state handling is unaffected, a suppressed event type is
+ * still processed by libinput. Suppression only applies to events
+ * posted after this call; events already queued are still delivered.
+ *
+ * @param device A previously obtained device
+ * @param types Array of event types to suppress, or NULL if ntypes is 0
+ * @param ntypes Number of entries in @a types
+ * @return 0 on success, or a negative value if any entry in @a types is
+ * not a valid event type or may not be suppressed
+ *
+ * @since 1.20
+ */
+int
+libinput_device_set_event_mask(struct libinput_device *device,
+			       const enum libinput_event_type *types,
+			       size_t ntypes);
+
+/**
+ * @ingroup device
+ *
+ * Mark this device as latency-critical. Events from a latency-critical
+ * device are queued on a separate priority lane that
+ * libinput_get_event() drains ahead of the bulk queue, so e.g. scroll
+ * wheel input from a flagged device is delivered ahead of a touchscreen
+ * flood queued before it. Each lane preserves posting order, so the
+ * ordering within any single device's own event stream is unaffected;
+ * only delivery order across devices changes.
+ *
+ * Events on the priority lane are exempt from the queue limit set with
+ * libinput_set_event_queue_limit() and from motion compression, see
+ * libinput_set_motion_compression().
+ *
+ * The flag applies to events posted after this call. Set it while no
+ * events from the device are queued - typically when handling the
+ * device's @ref LIBINPUT_EVENT_DEVICE_ADDED event - as toggling with
+ * events pending delivers the device's newer events ahead of its older
+ * ones.
+ *
+ * The priority lane is off for all devices by default.
+ *
+ * @param device A previously obtained device
+ * @param priority Non-zero to deliver this device's events through the
+ * priority lane, zero for normal bulk delivery
+ *
+ * @since 1.20
+ */
+void
+libinput_device_set_priority(struct libinput_device *device, int priority);
+
+/**
+ * @ingroup device
+ *
+ * Enable or disable in-library kinetic ("fling") scrolling for this
+ * device. With flinging enabled, libinput keeps posting scroll events
+ * with @ref LIBINPUT_POINTER_AXIS_SOURCE_FINGER after the fingers are
+ * released, with deltas decaying from the release velocity until the
+ * scroll stop event terminates the sequence. The velocity is taken from
+ * the same estimator the pointer acceleration filters use, so callers
+ * implementing kinetic scrolling this way need no velocity pipeline of
+ * their own.
+ *
+ * A caller that enables flinging must not apply its own kinetic
+ * scrolling on top, otherwise the deltas decay twice.
+ *
+ * Flinging is off for all devices by default. Enabling it on a device
+ * without finger scrolling has no effect.
+ *
+ * @param device A previously obtained device
+ * @param enabled Non-zero to continue scrolling past finger release,
+ * zero to stop scrolling on release
+ *
+ * @see libinput_device_scroll_get_fling_enabled
+ *
+ * @since 1.20
+ */
+void
+libinput_device_scroll_set_fling_enabled(struct libinput_device *device,
+					 int enabled);
+
+/**
+ * @ingroup device
+ *
+ * Check if in-library kinetic scrolling is enabled on this device, see
+ * libinput_device_scroll_set_fling_enabled().
+ *
+ * @param device A previously obtained device
+ * @return Non-zero if flinging is enabled, zero otherwise
+ *
+ * @since 1.20
+ */
+int
+libinput_device_scroll_get_fling_enabled(struct libinput_device *device);
+
+/**
+ * @ingroup device
+ *
+ * The gesture a device is currently engaged in, see
+ * libinput_device_get_active_gesture_hint().
+ *
+ * @since 1.20
+ */
+enum libinput_gesture_hint {
+	/** No gesture in progress */
+	LIBINPUT_GESTURE_HINT_NONE = 0,
+	/** Fingers are down but the gesture is not yet classified */
+	LIBINPUT_GESTURE_HINT_UNKNOWN,
+	/** A hold gesture is in progress */
+	LIBINPUT_GESTURE_HINT_HOLD,
+	/** A two-finger scroll is in progress */
+	LIBINPUT_GESTURE_HINT_SCROLL,
+	/** A swipe gesture is in progress */
+	LIBINPUT_GESTURE_HINT_SWIPE,
+	/** A pinch gesture is in progress */
+	LIBINPUT_GESTURE_HINT_PINCH,
+};
+
+/**
+ * @ingroup device
+ *
+ * Return the gesture this device is currently engaged in. The hint
+ * tracks the internal gesture state machine and is updated as events
+ * are processed, without allocating or queueing anything, so it is
+ * cheap enough for a frame scheduler to poll every frame - e.g. to
+ * keep compositing speculatively while a scroll or swipe is in
+ * progress.
+ *
+ * The hint may run ahead of the event queue: it reflects the state as
+ * of the last libinput_dispatch() call, not as of the last event the
+ * caller read. It is no substitute for handling the gesture events -
+ * @ref LIBINPUT_GESTURE_HINT_UNKNOWN in particular may resolve to
+ * plain pointer motion without any gesture event being posted.
+ *
+ * For devices without the @ref LIBINPUT_DEVICE_CAP_GESTURE capability
+ * this function returns @ref LIBINPUT_GESTURE_HINT_NONE.
+ *
+ * @param device A previously obtained device
+ * @return The gesture currently in progress on this device
+ *
+ * @since 1.20
+ */
+enum libinput_gesture_hint
+libinput_device_get_active_gesture_hint(struct libinput_device *device);
+
+/**
+ * @ingroup device
+ *
+ * Enable or disable touch frame aggregation for this device. With
+ * aggregation enabled, the individual @ref LIBINPUT_EVENT_TOUCH_DOWN,
+ * @ref LIBINPUT_EVENT_TOUCH_MOTION, @ref LIBINPUT_EVENT_TOUCH_UP and
+ * @ref LIBINPUT_EVENT_TOUCH_CANCEL events are no longer queued;
+ * instead, the @ref LIBINPUT_EVENT_TOUCH_FRAME event carries all
+ * per-slot changes of its frame, accessible with
+ * libinput_event_touch_frame_get_num_changes() and the
+ * libinput_event_touch_frame_* accessors. A ten-finger frame is thus a
+ * single event instead of eleven.
+ *
+ * Aggregation is off by default. Toggling it takes effect from the
+ * next frame; events already queued are unaffected.
+ *
+ * @param device A previously obtained device
+ * @param enable Non-zero to enable, zero to disable
+ * @return 0 on success, or -1 if the device lacks the @ref
+ * LIBINPUT_DEVICE_CAP_TOUCH capability
+ *
+ * @since 1.20
+ */
+int
+libinput_device_touch_enable_frame_aggregation(struct libinput_device *device,
+					       int enable);
+
 /**
  * @ingroup device
  *
@@ -4117,6 +5675,170 @@ libinput_device_get_device_group(struct libinput_device *device);
 const char *
 libinput_device_get_sysname(struct libinput_device *device);
 
+/**
+ * @ingroup device
+ *
+ * The number of buckets in a struct libinput_latency_stats histogram.
+ *
+ * @since 1.20
+ */
+#define LIBINPUT_LATENCY_NBUCKETS 16
+
+/**
+ * @ingroup device
+ *
+ * Event latency histograms for one device, see
+ * libinput_device_get_latency_stats(). Each histogram counts events in
+ * power-of-two microsecond buckets, i.e. bucket 0 counts latencies below
+ * 1µs, bucket 1 latencies below 2µs, bucket n latencies below 2^n µs.
+ * The last bucket counts all remaining events.
+ *
+ * @since 1.20
+ */
+struct libinput_latency_stats {
+	/** Time between the kernel event timestamp and the event being
+	 * queued by libinput */
+	uint64_t kernel_to_post[LIBINPUT_LATENCY_NBUCKETS];
+	/** Time between the event being queued and the caller retrieving
+	 * it with libinput_get_event() */
+	uint64_t post_to_drain[LIBINPUT_LATENCY_NBUCKETS];
+	/** Total number of events counted */
+	uint64_t nevents;
+};
+
+/**
+ * @ingroup device
+ *
+ * Get the event latency histograms for this device.
+ *
+ * Latency collection is disabled by default, set the
+ * LIBINPUT_LATENCY_STATS environment variable before
+ * libinput_udev_create_context() or libinput_path_create_context() to
+ * enable it. Collection uses simple per-device counters and is cheap
+ * enough to leave enabled during normal operation.
+ *
+ * @param device A previously obtained device
+ * @param stats Set to the current histogram counters on success
+ * @return 0 on success, or -1 if latency collection is disabled
+ *
+ * @since 1.20
+ */
+int
+libinput_device_get_latency_stats(struct libinput_device *device,
+				  struct libinput_latency_stats *stats);
+
+/**
+ * @ingroup device
+ *
+ * Return the number of times the kernel reported SYN_DROPPED for this
+ * device, i.e. how often the kernel's event buffer overflowed and input
+ * events were lost. A steadily increasing count usually means the caller
+ * is stalling between libinput_dispatch() calls for too long for this
+ * device's event rate.
+ *
+ * @param device A previously obtained device
+ * @return The number of SYN_DROPPED events since device creation
+ *
+ * @since 1.20
+ */
+uint64_t
+libinput_device_get_syn_dropped_count(struct libinput_device *device);
+
+/**
+ * @ingroup device
+ *
+ * Per-device event counters, see libinput_device_get_event_stats().
+ *
+ * @since 1.20
+ */
+struct libinput_event_stats {
+	/** Input events dispatched since device creation */
+	uint64_t nevents;
+	/** Event frames (SYN_REPORT) dispatched since device creation */
+	uint64_t nframes;
+	/** SYN_DROPPED episodes since device creation, equals
+	    libinput_device_get_syn_dropped_count() */
+	uint64_t ndropped;
+};
+
+/**
+ * @ingroup device
+ *
+ * Fill in this device's event counters. The counters are always on and
+ * cost one addition per dispatched frame, so they are cheap enough to
+ * sample periodically for health monitoring - event and frame rates
+ * follow from sampling twice and dividing by the interval.
+ *
+ * For monitoring a context out-of-process without consuming its event
+ * stream, set the LIBINPUT_STATS_PAGE environment variable to a file
+ * path before creating the context: the same counters are then
+ * continuously mirrored into a memory-mapped table in that file, one
+ * slot per device. The table layout is not part of the stable API and
+ * may change between versions.
+ *
+ * @param device A previously obtained device
+ * @param stats Set to the current counter values
+ *
+ * @since 1.20
+ */
+void
+libinput_device_get_event_stats(struct libinput_device *device,
+				struct libinput_event_stats *stats);
+
+/**
+ * @ingroup device
+ *
+ * Return the raw scroll distance accumulated towards the scroll
+ * threshold during on-button scrolling, in the same normalized units as
+ * libinput_event_pointer_get_axis_value(). While the scroll button is
+ * down but the threshold has not been crossed yet, this is the motion
+ * swallowed by libinput so far. Accumulation stops on an axis once
+ * scrolling engages on it and the values reset to zero when the
+ * scroll button is released. Callers
+ * that want to apply their own, lower threshold can watch this value
+ * instead of waiting for axis events.
+ *
+ * For devices without the @ref LIBINPUT_CONFIG_SCROLL_ON_BUTTON_DOWN
+ * method both values are always zero.
+ *
+ * @param device A previously obtained device
+ * @param x Set to the accumulated horizontal scroll distance
+ * @param y Set to the accumulated vertical scroll distance
+ *
+ * @since 1.20
+ */
+void
+libinput_device_get_scroll_accumulated(struct libinput_device *device,
+				       double *x,
+				       double *y);
+
+/**
+ * @ingroup device
+ *
+ * Return the smooth scroll distance delivered for this device since the
+ * previous call to this function, summed over all scroll sources, and
+ * reset the accumulator to zero. The values are in the same normalized
+ * units as libinput_event_pointer_get_scroll_value() and include the
+ * natural-scrolling and inversion adjustments the per-event values
+ * carry; wheel scrolling is counted once, not again for the legacy
+ * POINTER_AXIS companion events.
+ *
+ * This is intended for callers that sample input at a fixed rate, e.g.
+ * once per rendered frame, and want one scroll vector per axis per frame
+ * without inspecting the individual scroll events. Event delivery is
+ * unaffected, a caller mixing both will count scroll twice.
+ *
+ * @param device A previously obtained device
+ * @param x Set to the accumulated horizontal scroll distance
+ * @param y Set to the accumulated vertical scroll distance
+ *
+ * @since 1.20
+ */
+void
+libinput_device_sample_scroll(struct libinput_device *device,
+			      double *x,
+			      double *y);
+
 /**
  * @ingroup device
  *
@@ -4155,6 +5877,26 @@ libinput_device_get_id_product(struct libinput_device *device);
 unsigned int
 libinput_device_get_id_vendor(struct libinput_device *device);
 
+/**
+ * @ingroup device
+ *
+ * Get the device's measured report rate in Hz.
+ *
+ * The rate is an exponentially-weighted average over the spacing of the
+ * device's recent event frames, so it reflects what the device actually
+ * delivers rather than what its hardware advertises. Pauses between
+ * interactions do not count towards the average. The rate is 0 until the
+ * device has delivered enough frames to measure, and converges over the
+ * first few dozen frames after a rate change.
+ *
+ * @param device A previously obtained device
+ * @return The current report rate in Hz, or 0 if not yet measured
+ *
+ * @since 1.20
+ */
+unsigned int
+libinput_device_get_report_rate(struct libinput_device *device);
+
 /**
  * @ingroup device
  *
@@ -4276,6 +6018,44 @@ int
 libinput_device_has_capability(struct libinput_device *device,
 			       enum libinput_device_capability capability);
 
+/**
+ * @ingroup device
+ *
+ * Return all capabilities of this device as a bitmask, with bit i set if
+ * the device has the capability with the @ref
+ * libinput_device_capability value i. The mask is equivalent to calling
+ * libinput_device_has_capability() for every capability but costs a
+ * single load, making it suitable for per-event routing. Capabilities
+ * remain static for the lifetime of the device, so the mask may be
+ * cached by the caller.
+ *
+ * @param device A previously obtained device
+ * @return A bitmask of the device's capabilities
+ *
+ * @since 1.20
+ */
+uint32_t
+libinput_device_get_capability_mask(struct libinput_device *device);
+
+/**
+ * @ingroup device
+ *
+ * Return the device's configuration generation. The generation starts
+ * at zero and increases by one for each configuration setting
+ * successfully applied to this device, including settings applied to
+ * their current value. A @ref LIBINPUT_EVENT_DEVICE_CONFIG_CHANGED
+ * event is posted for each increase, so a client caching the
+ * configuration state can compare generations - or simply wait for the
+ * event - instead of polling the libinput_device_config_* getters.
+ *
+ * @param device A previously obtained device
+ * @return The device's configuration generation
+ *
+ * @since 1.20
+ */
+uint32_t
+libinput_device_get_config_generation(struct libinput_device *device);
+
 /**
  * @ingroup device
  *
@@ -4553,6 +6333,45 @@ enum libinput_config_status {
 const char *
 libinput_config_status_to_str(enum libinput_config_status status);
 
+/**
+ * @ingroup config
+ *
+ * Begin a configuration transaction on this device. While a transaction
+ * is active, configuration calls whose derived state is expensive to
+ * rebuild (e.g. reconstructing the pointer acceleration filter on a
+ * profile change) record the new setting and defer the rebuild to
+ * libinput_device_config_transaction_commit(). Applying a full settings
+ * profile at session start then triggers at most one rebuild per device
+ * instead of one per call. Settings are otherwise applied as usual.
+ *
+ * Transactions nest; deferred rebuilds run when the outermost
+ * transaction commits. Values read back during a transaction may not
+ * reflect deferred changes yet.
+ *
+ * @param device The device to configure
+ *
+ * @see libinput_device_config_transaction_commit
+ * @since 1.20
+ */
+void
+libinput_device_config_transaction_begin(struct libinput_device *device);
+
+/**
+ * @ingroup config
+ *
+ * Commit a configuration transaction started with
+ * libinput_device_config_transaction_begin() and perform the deferred
+ * rebuilds, each once, with the last value set during the transaction.
+ * Calling this without a matching begin is a no-op.
+ *
+ * @param device The device to configure
+ *
+ * @see libinput_device_config_transaction_begin
+ * @since 1.20
+ */
+void
+libinput_device_config_transaction_commit(struct libinput_device *device);
+
 /**
  * @ingroup config
  */
@@ -5003,6 +6822,53 @@ int
 libinput_device_config_calibration_get_default_matrix(struct libinput_device *device,
 						      float matrix[6]);
 
+/**
+ * @ingroup config
+ *
+ * A rectangle in the device's coordinate space, normalized to [0, 1] of
+ * the axis ranges, before calibration. Used by
+ * libinput_device_config_set_active_region().
+ *
+ * @since 1.20
+ */
+struct libinput_region {
+	double x;      /**< Left edge */
+	double y;      /**< Top edge */
+	double width;
+	double height;
+};
+
+/**
+ * @ingroup config
+ *
+ * Restrict touch processing on this device to the given regions. A
+ * touch beginning outside all regions is rejected at the dispatch
+ * layer, before seat slot mapping and event allocation, and the
+ * touch sequence never reaches the caller - useful where large parts
+ * of a touch surface are covered or otherwise dead and would only be
+ * masked client-side anyway.
+ *
+ * The regions replace any previously set regions. Passing zero regions
+ * removes the filter and all touches are processed again. Touches
+ * already in progress are unaffected, the filter applies on touch
+ * down only.
+ *
+ * @param device A previously obtained device
+ * @param regions Array of regions in normalized device coordinates
+ * @param nregions Number of elements in regions, or zero to remove the
+ * filter
+ * @return A config status code. Devices without touch capability return
+ * @ref LIBINPUT_CONFIG_STATUS_UNSUPPORTED, degenerate rectangles or
+ * more regions than supported return @ref
+ * LIBINPUT_CONFIG_STATUS_INVALID.
+ *
+ * @since 1.20
+ */
+enum libinput_config_status
+libinput_device_config_set_active_region(struct libinput_device *device,
+					 const struct libinput_region *regions,
+					 size_t nregions);
+
 /**
  * @ingroup config
  *
@@ -33,11 +33,18 @@ struct path_input {
 	struct libinput base;
 	struct udev *udev;
 	struct list path_list;
+	/* Devices declared up-front via libinput_path_add_devices() live
+	 * in this single array instead of one allocation each. Entries
+	 * are still linked into path_list, but must not be freed
+	 * individually. */
+	struct path_device *static_devices;
+	size_t n_static_devices;
 };
 
 struct path_device {
 	struct list link;
 	struct udev_device *udev_device;
+	bool is_static; /* member of path_input.static_devices */
 };
 
 struct path_seat {
@@ -207,7 +214,7 @@ path_device_enable(struct path_input *input,
 
 	evdev_read_calibration_prop(device);
 	output_name = udev_device_get_property_value(udev_device, "WL_OUTPUT");
-	device->output_name = safe_strdup(output_name);
+	device->output_name = libinput_intern_string(&input->base, output_name);
 
 out:
 	return device ? &device->base : NULL;
@@ -234,7 +241,9 @@ path_device_destroy(struct path_device *dev)
 {
 	list_remove(&dev->link);
 	udev_device_unref(dev->udev_device);
-	free(dev);
+	dev->udev_device = NULL;
+	if (!dev->is_static)
+		free(dev);
 }
 
 static void
@@ -248,6 +257,30 @@ path_input_destroy(struct libinput *input)
 	list_for_each_safe(dev, &path_input->path_list, link)
 		path_device_destroy(dev);
 
+	free(path_input->static_devices);
+}
+
+static struct path_device *
+path_device_lookup(struct path_input *input,
+		   struct udev_device *udev_device)
+{
+	struct path_device *dev;
+	size_t i;
+
+	/* Check the static device array first, it's one contiguous
+	 * block and covers all devices on fixed-device setups */
+	for (i = 0; i < input->n_static_devices; i++) {
+		dev = &input->static_devices[i];
+		if (dev->udev_device == udev_device)
+			return dev;
+	}
+
+	list_for_each(dev, &input->path_list, link) {
+		if (dev->udev_device == udev_device)
+			return dev;
+	}
+
+	return NULL;
 }
 
 static struct libinput_device *
@@ -400,6 +433,84 @@ libinput_path_add_device(struct libinput *libinput,
 	return device;
 }
 
+LIBINPUT_EXPORT int
+libinput_path_add_devices(struct libinput *libinput,
+			  const char **paths,
+			  size_t npaths)
+{
+	struct path_input *input = (struct path_input *)libinput;
+	struct udev *udev = input->udev;
+	struct path_device *dev;
+	size_t i;
+
+	if (libinput->interface_backend != &interface_backend) {
+		log_bug_client(libinput, "Mismatching backends.\n");
+		return -1;
+	}
+
+	if (npaths == 0)
+		return -1;
+
+	if (input->static_devices) {
+		log_bug_client(libinput,
+			       "Devices can only be provisioned once per context.\n");
+		return -1;
+	}
+
+	for (i = 0; i < npaths; i++) {
+		if (strlen(paths[i]) > PATH_MAX) {
+			log_bug_client(libinput,
+				       "Unexpected path, limited to %d characters.\n",
+				       PATH_MAX);
+			return -1;
+		}
+	}
+
+	/* See libinput_path_add_device() for why the quirks are
+	 * initialized here */
+	libinput_init_quirks(libinput);
+
+	input->static_devices = zalloc(npaths * sizeof(*input->static_devices));
+
+	for (i = 0; i < npaths; i++) {
+		dev = &input->static_devices[i];
+		dev->is_static = true;
+		dev->udev_device = udev_device_from_devnode(libinput,
+							    udev,
+							    paths[i]);
+		if (!dev->udev_device) {
+			log_bug_client(libinput, "Invalid path %s\n", paths[i]);
+			goto error;
+		}
+
+		if (ignore_litest_test_suite_device(dev->udev_device)) {
+			udev_device_unref(dev->udev_device);
+			dev->udev_device = NULL;
+			goto error;
+		}
+
+		list_insert(&input->path_list, &dev->link);
+		input->n_static_devices++;
+
+		if (path_device_enable(input, dev->udev_device, NULL) == NULL)
+			goto error;
+	}
+
+	return 0;
+
+error:
+	/* All-or-nothing: a fixed device set that is only partially
+	 * present is a misconfiguration, not something to limp along
+	 * with */
+	path_input_disable(libinput);
+	for (i = input->n_static_devices; i > 0; i--)
+		path_device_destroy(&input->static_devices[i - 1]);
+	free(input->static_devices);
+	input->static_devices = NULL;
+	input->n_static_devices = 0;
+	return -1;
+}
+
 LIBINPUT_EXPORT void
 libinput_path_remove_device(struct libinput_device *device)
 {
@@ -414,12 +525,9 @@ libinput_path_remove_device(struct libinput_device *device)
 		return;
 	}
 
-	list_for_each_safe(dev, &input->path_list, link) {
-		if (dev->udev_device == evdev->udev_device) {
-			path_device_destroy(dev);
-			break;
-		}
-	}
+	dev = path_device_lookup(input, evdev->udev_device);
+	if (dev)
+		path_device_destroy(dev);
 
 	seat = device->seat;
 	libinput_seat_ref(seat);
@@ -33,8 +33,14 @@
 #include <stdlib.h>
 #include <libudev.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <fnmatch.h>
+#include <inttypes.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef __FreeBSD__
 #include <kenv.h>
 #endif
@@ -164,6 +170,29 @@ struct section {
 	struct list properties;
 };
 
+/* The quirk enum is two dense ID ranges (model and attr quirks), so a
+ * compact direct-index table works as a perfect hash: the slot is the
+ * offset into the range, with the attr quirks placed after the model
+ * quirks. */
+#define QUIRK_NMODEL \
+	(_QUIRK_LAST_MODEL_QUIRK_ - QUIRK_MODEL_ALPS_SERIAL_TOUCHPAD)
+#define QUIRK_NSLOTS \
+	(QUIRK_NMODEL + _QUIRK_LAST_ATTR_QUIRK_ - QUIRK_ATTR_SIZE_HINT)
+
+static inline ssize_t
+quirk_slot(enum quirk which)
+{
+	if (which >= QUIRK_MODEL_ALPS_SERIAL_TOUCHPAD &&
+	    which < _QUIRK_LAST_MODEL_QUIRK_)
+		return which - QUIRK_MODEL_ALPS_SERIAL_TOUCHPAD;
+
+	if (which >= QUIRK_ATTR_SIZE_HINT &&
+	    which < _QUIRK_LAST_ATTR_QUIRK_)
+		return QUIRK_NMODEL + (which - QUIRK_ATTR_SIZE_HINT);
+
+	return -1;
+}
+
 /**
  * The struct returned to the caller. It contains the
  * properties for a given device.
@@ -175,6 +204,11 @@ struct quirks {
 	/* These are not ref'd, just a collection of pointers */
 	struct property **properties;
 	size_t nproperties;
+
+	/* Direct-index table over quirk IDs holding the last-assigned
+	 * property per quirk, so lookups don't rescan the array. See
+	 * quirk_slot() */
+	struct property *by_id[QUIRK_NSLOTS];
 };
 
 /**
@@ -190,12 +224,127 @@ struct quirks_context {
 	char *dmi;
 	char *dt;
 
+	char *data_path; /* for re-stamping the data dir on shutdown */
+
+	/* Bump allocator backing the sections/properties and their
+	 * strings, see quirks_arena_alloc() */
+	struct list arena; /* struct arena_chunk */
+
 	struct list sections;
 
+	/* Compact per-section prefilter over the exact-match keys, in
+	 * section order, see quirks_build_index() */
+	struct section_idx *index;
+	size_t nindex;
+
+	/* Resolved match keys and their section lists, see
+	 * match_cache_lookup() */
+	struct list match_cache; /* struct match_cache_entry */
+
 	/* list of quirks handed to libinput, just for bookkeeping */
 	struct list quirks;
 };
 
+/**
+ * One prefilter entry per section. Keeps the cheap exact-match keys in a
+ * contiguous array so quirks_fetch_for_device() can reject most sections
+ * with integer compares instead of running the full match evaluation
+ * (including fnmatch) against every section. Must stay in section order,
+ * later sections override earlier ones when applied.
+ */
+struct section_idx {
+	uint32_t bits; /* the M_BUS|M_VID|M_PID|M_VERSION subset of match.bits */
+	enum bustype bus;
+	uint32_t vendor;
+	uint32_t product;
+	uint32_t version;
+	struct section *section;
+};
+
+/**
+ * One resolved match key and the sections it fully matched, in section
+ * order. Devices of the same device group - tablet pen/pad pairs,
+ * keyboard/mouse combos - arrive in quick succession with near-identical
+ * match keys, so the second and later devices with the same key get their
+ * section list from a hash lookup instead of re-running the full match
+ * evaluation. The dmi/dt strings are per-context globals and identical
+ * for every match, so they are not part of the key. Entries and their
+ * strings live in the context's arena.
+ */
+struct match_cache_entry {
+	struct list link; /* struct quirks_context.match_cache */
+	uint32_t hash;
+
+	/* the match key, verified on lookup to guard against collisions */
+	uint32_t bits;
+	char *name;
+	enum bustype bus;
+	uint32_t vendor;
+	uint32_t product;
+	uint32_t version;
+	uint32_t udev_type;
+
+	struct section **sections;
+	size_t nsections;
+};
+
+/**
+ * One chunk of the parse-time bump allocator. The sections, properties and
+ * strings built up during parsing all live exactly as long as the context,
+ * so instead of hundreds of small allocations freed one-by-one at unref
+ * time we hand out slices of a few large chunks and free those in one go.
+ */
+struct arena_chunk {
+	struct list link; /* struct quirks_context.arena */
+	size_t used;
+	size_t size;
+	char data[];
+};
+
+#define ARENA_CHUNK_SIZE (32 * 1024)
+
+static void *
+quirks_arena_alloc(struct quirks_context *ctx, size_t size)
+{
+	struct arena_chunk *chunk = NULL;
+	void *mem;
+
+	/* keep subsequent allocations suitably aligned */
+	size = (size + 15) & ~(size_t)15;
+
+	if (!list_empty(&ctx->arena))
+		chunk = list_first_entry(&ctx->arena, chunk, link);
+
+	if (!chunk || chunk->size - chunk->used < size) {
+		size_t chunk_size = max(ARENA_CHUNK_SIZE, size);
+
+		chunk = zalloc(sizeof(*chunk) + chunk_size);
+		chunk->size = chunk_size;
+		list_insert(&ctx->arena, &chunk->link);
+	}
+
+	mem = chunk->data + chunk->used;
+	chunk->used += size;
+
+	return mem; /* zeroed, chunks are zalloc'd and never recycled */
+}
+
+static char *
+quirks_arena_strdup(struct quirks_context *ctx, const char *s)
+{
+	size_t len;
+	char *copy;
+
+	if (!s)
+		return NULL;
+
+	len = strlen(s) + 1;
+	copy = quirks_arena_alloc(ctx, len);
+	memcpy(copy, s, len);
+
+	return copy;
+}
+
 LIBINPUT_ATTRIBUTE_PRINTF(3, 0)
 static inline void
 quirk_log_msg_va(struct quirks_context *ctx,
@@ -245,6 +394,7 @@ quirk_get_name(enum quirk q)
 	case QUIRK_MODEL_ALPS_SERIAL_TOUCHPAD:		return "ModelALPSSerialTouchpad";
 	case QUIRK_MODEL_APPLE_TOUCHPAD:		return "ModelAppleTouchpad";
 	case QUIRK_MODEL_APPLE_TOUCHPAD_ONEBUTTON:	return "ModelAppleTouchpadOneButton";
+	case QUIRK_MODEL_BOUNCING_BUTTONS:		return "ModelBouncingButtons";
 	case QUIRK_MODEL_BOUNCING_KEYS:			return "ModelBouncingKeys";
 	case QUIRK_MODEL_CHROMEBOOK:			return "ModelChromebook";
 	case QUIRK_MODEL_CLEVO_W740SU:			return "ModelClevoW740SU";
@@ -288,6 +438,8 @@ quirk_get_name(enum quirk q)
 	case QUIRK_ATTR_EVENT_CODE_ENABLE:		return "AttrEventCodeEnable";
 	case QUIRK_ATTR_INPUT_PROP_DISABLE:		return "AttrInputPropDisable";
 	case QUIRK_ATTR_INPUT_PROP_ENABLE:		return "AttrInputPropEnable";
+	case QUIRK_ATTR_FRAMES_PER_DISPATCH:		return "AttrFramesPerDispatch";
+	case QUIRK_ATTR_TABLET_SMOOTHING_SIZE:		return "AttrTabletSmoothingSize";
 	default:
 		abort();
 	}
@@ -310,12 +462,106 @@ matchflagname(enum match_flags f)
 	}
 }
 
+/* Lookup table for the quirk key names (MatchFoo, ModelBar, AttrBaz).
+ * Parsing a data file used to walk streq() chains over all known names
+ * for every line; with roughly 60 keys that's a lot of failed string
+ * compares per line. Instead we hash the names into a fixed
+ * open-addressing table once per process, so each line costs one hash
+ * plus (usually) a single string compare.
+ */
+enum key_kind {
+	KEY_MATCH,
+	KEY_MODEL,
+	KEY_ATTR,
+};
+
+struct key_entry {
+	const char *name;
+	uint32_t hash;
+	enum key_kind kind;
+	uint32_t value; /* enum match_flags or enum quirk */
+};
+
+/* Power of two, roughly double the number of keys so probe
+ * sequences stay short */
+#define KEY_TABLE_SIZE 128
+
+static struct key_entry key_table[KEY_TABLE_SIZE];
+static bool key_table_initialized;
+
+/* FNV-1a, good enough for a handful of short ASCII strings */
+static inline uint32_t
+key_hash(const char *str)
+{
+	uint32_t h = 2166136261u;
+
+	while (*str)
+		h = (h ^ (unsigned char)*str++) * 16777619u;
+
+	return h;
+}
+
+static void
+key_table_insert(const char *name, enum key_kind kind, uint32_t value)
+{
+	uint32_t h = key_hash(name);
+	size_t slot = h & (KEY_TABLE_SIZE - 1);
+
+	while (key_table[slot].name)
+		slot = (slot + 1) & (KEY_TABLE_SIZE - 1);
+
+	key_table[slot] = (struct key_entry) {
+		.name = name,
+		.hash = h,
+		.kind = kind,
+		.value = value,
+	};
+}
+
+static void
+key_table_init(void)
+{
+	if (key_table_initialized)
+		return;
+
+	for (uint32_t flag = 0x1; flag <= M_LAST; flag <<= 1)
+		key_table_insert(matchflagname(flag), KEY_MATCH, flag);
+
+	for (enum quirk q = QUIRK_MODEL_ALPS_SERIAL_TOUCHPAD;
+	     q < _QUIRK_LAST_MODEL_QUIRK_;
+	     q++)
+		key_table_insert(quirk_get_name(q), KEY_MODEL, q);
+
+	for (enum quirk q = QUIRK_ATTR_SIZE_HINT;
+	     q < _QUIRK_LAST_ATTR_QUIRK_;
+	     q++)
+		key_table_insert(quirk_get_name(q), KEY_ATTR, q);
+
+	key_table_initialized = true;
+}
+
+static const struct key_entry *
+key_table_lookup(const char *key)
+{
+	uint32_t h = key_hash(key);
+	size_t slot = h & (KEY_TABLE_SIZE - 1);
+
+	while (key_table[slot].name) {
+		if (key_table[slot].hash == h &&
+		    streq(key_table[slot].name, key))
+			return &key_table[slot];
+		slot = (slot + 1) & (KEY_TABLE_SIZE - 1);
+	}
+
+	return NULL;
+}
+
 static inline struct property *
-property_new(void)
+property_new(struct quirks_context *ctx)
 {
 	struct property *p;
 
-	p = zalloc(sizeof *p);
+	p = quirks_arena_alloc(ctx, sizeof *p);
 	p->refcount = 1;
 	list_init(&p->link);
 
@@ -351,10 +597,9 @@ property_cleanup(struct property *p)
 	property_unref(p);
 	assert(p->refcount == 0);
 
+	/* The property and its value string live in the context's arena,
+	 * they are freed with it */
 	list_remove(&p->link);
-	if (p->type == PT_STRING)
-		free(p->value.s);
-	free(p);
 }
 
 /**
@@ -489,13 +734,38 @@ init_dt(void)
 	return copy;
 }
 
-static inline struct section *
-section_new(const char *path, const char *name)
+/* The DMI modalias and DT compatible string cannot change while the
+ * process runs, but init_dmi() in particular costs a dozen syscalls
+ * through udev. Read both once per process and hand out copies, so
+ * repeated context creation (and hotplug-triggered re-init) doesn't
+ * re-read them - that cost doubles on syscall-auditing systems. */
+static struct {
+	bool initialized;
+	char *dmi;
+	char *dt;
+} system_ids;
+
+static void
+init_system_ids(void)
 {
-	struct section *s = zalloc(sizeof(*s));
+	if (system_ids.initialized)
+		return;
+
+	system_ids.dmi = init_dmi();
+	system_ids.dt = init_dt();
+	system_ids.initialized = true;
+}
 
+static inline struct section *
+section_new(struct quirks_context *ctx, const char *path, const char *name)
+{
+	struct section *s = quirks_arena_alloc(ctx, sizeof(*s));
 	char *path_dup = safe_strdup(path);
-	xasprintf(&s->name, "%s (%s)", name, basename(path_dup));
+	char *section_name;
+
+	xasprintf(&section_name, "%s (%s)", name, basename(path_dup));
+	s->name = quirks_arena_strdup(ctx, section_name);
+	free(section_name);
 	free(path_dup);
 	list_init(&s->link);
 	list_init(&s->properties);
@@ -508,18 +778,14 @@ section_destroy(struct section *s)
 {
 	struct property *p;
 
-	free(s->name);
-	free(s->match.name);
-	free(s->match.dmi);
-	free(s->match.dt);
-
 	list_for_each_safe(p, &s->properties, link)
 		property_cleanup(p);
 
 	assert(list_empty(&s->properties));
 
+	/* The section and its strings live in the context's arena, they
+	 * are freed with it */
 	list_remove(&s->link);
-	free(s);
 }
 
 static inline bool
@@ -535,7 +801,7 @@ parse_hex(const char *value, unsigned int *parsed)
  * Parse a MatchFooBar=banana line.
  *
  * @param section The section struct to be filled in
- * @param key The MatchFooBar part of the line
+ * @param flag The match flag the key hashed to
  * @param value The banana part of the line.
  *
  * @return true on success, false otherwise.
@@ -543,7 +809,7 @@ parse_hex(const char *value, unsigned int *parsed)
 static bool
 parse_match(struct quirks_context *ctx,
 	    struct section *s,
-	    const char *key,
+	    enum match_flags flag,
 	    const char *value)
 {
 	int rc = false;
@@ -555,10 +821,12 @@ parse_match(struct quirks_context *ctx,
 
 	assert(strlen(value) >= 1);
 
-	if (streq(key, "MatchName")) {
+	switch (flag) {
+	case M_NAME:
 		check_set_bit(s, M_NAME);
-		s->match.name = safe_strdup(value);
-	} else if (streq(key, "MatchBus")) {
+		s->match.name = quirks_arena_strdup(ctx, value);
+		break;
+	case M_BUS:
 		check_set_bit(s, M_BUS);
 		if (streq(value, "usb"))
 			s->match.bus = BT_USB;
@@ -574,7 +842,8 @@ parse_match(struct quirks_context *ctx,
 			s->match.bus = BT_SPI;
 		else
 			goto out;
-	} else if (streq(key, "MatchVendor")) {
+		break;
+	case M_VID: {
 		unsigned int vendor;
 
 		check_set_bit(s, M_VID);
@@ -582,7 +851,9 @@ parse_match(struct quirks_context *ctx,
 			goto out;
 
 		s->match.vendor = vendor;
-	} else if (streq(key, "MatchProduct")) {
+		break;
+	}
+	case M_PID: {
 		unsigned int product;
 
 		check_set_bit(s, M_PID);
@@ -590,7 +861,9 @@ parse_match(struct quirks_context *ctx,
 			goto out;
 
 		s->match.product = product;
-	} else if (streq(key, "MatchVersion")) {
+		break;
+	}
+	case M_VERSION: {
 		unsigned int version;
 
 		check_set_bit(s, M_VERSION);
@@ -598,7 +871,9 @@ parse_match(struct quirks_context *ctx,
 			goto out;
 
 		s->match.version = version;
-	} else if (streq(key, "MatchDMIModalias")) {
+		break;
+	}
+	case M_DMI:
 		check_set_bit(s, M_DMI);
 		if (!strneq(value, "dmi:", 4)) {
 			qlog_parser(ctx,
@@ -606,8 +881,9 @@ parse_match(struct quirks_context *ctx,
 				    s->name);
 			goto out;
 		}
-		s->match.dmi = safe_strdup(value);
-	} else if (streq(key, "MatchUdevType")) {
+		s->match.dmi = quirks_arena_strdup(ctx, value);
+		break;
+	case M_UDEV_TYPE:
 		check_set_bit(s, M_UDEV_TYPE);
 		if (streq(value, "touchpad"))
 			s->match.udev_type = UDEV_TOUCHPAD;
@@ -625,12 +901,11 @@ parse_match(struct quirks_context *ctx,
 			s->match.udev_type = UDEV_TABLET_PAD;
 		else
 			goto out;
-	} else if (streq(key, "MatchDeviceTree")) {
+		break;
+	case M_DT:
 		check_set_bit(s, M_DT);
-		s->match.dt = safe_strdup(value);
-	} else {
-		qlog_error(ctx, "Unknown match key '%s'\n", key);
-		goto out;
+		s->match.dt = quirks_arena_strdup(ctx, value);
+		break;
 	}
 
 #undef check_set_bit
@@ -644,7 +919,7 @@ out:
  * Parse a ModelFooBar=1 line.
  *
  * @param section The section struct to be filled in
- * @param key The ModelFooBar part of the line
+ * @param q The model quirk the key hashed to
  * @param value The value after the =, must be 1 or 0.
  *
  * @return true on success, false otherwise.
@@ -652,39 +927,30 @@ out:
 static bool
 parse_model(struct quirks_context *ctx,
 	    struct section *s,
-	    const char *key,
+	    enum quirk q,
 	    const char *value)
 {
+	struct property *p;
 	bool b;
-	enum quirk q = QUIRK_MODEL_ALPS_SERIAL_TOUCHPAD;
-
-	assert(strneq(key, "Model", 5));
 
 	if (!parse_boolean_property(value, &b))
 		return false;
 
-	do {
-		if (streq(key, quirk_get_name(q))) {
-			struct property *p = property_new();
-			p->id = q,
-			p->type = PT_BOOL;
-			p->value.b = b;
-			list_append(&s->properties, &p->link);
-			s->has_property = true;
-			return true;
-		}
-	} while (++q < _QUIRK_LAST_MODEL_QUIRK_);
-
-	qlog_error(ctx, "Unknown key %s in %s\n", key, s->name);
+	p = property_new(ctx);
+	p->id = q;
+	p->type = PT_BOOL;
+	p->value.b = b;
+	list_append(&s->properties, &p->link);
+	s->has_property = true;
 
-	return false;
+	return true;
 }
 
 /**
  * Parse a AttrFooBar=banana line.
  *
  * @param section The section struct to be filled in
- * @param key The AttrFooBar part of the line
+ * @param q The attribute quirk the key hashed to
  * @param value The banana part of the line.
  *
  * Value parsing depends on the attribute type.
@@ -694,10 +960,10 @@ parse_model(struct quirks_context *ctx,
 static inline bool
 parse_attr(struct quirks_context *ctx,
 	   struct section *s,
-	   const char *key,
+	   enum quirk q,
 	   const char *value)
 {
-	struct property *p = property_new();
+	struct property *p = property_new(ctx);
 	bool rc = false;
 	struct quirk_dimensions dim;
 	struct quirk_range range;
@@ -705,127 +971,158 @@ parse_attr(struct quirks_context *ctx,
 	bool b;
 	double d;
 
-	if (streq(key, quirk_get_name(QUIRK_ATTR_SIZE_HINT))) {
+	switch (q) {
+	case QUIRK_ATTR_SIZE_HINT:
 		p->id = QUIRK_ATTR_SIZE_HINT;
 		if (!parse_dimension_property(value, &dim.x, &dim.y))
 			goto out;
 		p->type = PT_DIMENSION;
 		p->value.dim = dim;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_TOUCH_SIZE_RANGE))) {
+		break;
+	case QUIRK_ATTR_TOUCH_SIZE_RANGE:
 		p->id = QUIRK_ATTR_TOUCH_SIZE_RANGE;
 		if (!parse_range_property(value, &range.upper, &range.lower))
 			goto out;
 		p->type = PT_RANGE;
 		p->value.range = range;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_PALM_SIZE_THRESHOLD))) {
+		break;
+	case QUIRK_ATTR_PALM_SIZE_THRESHOLD:
 		p->id = QUIRK_ATTR_PALM_SIZE_THRESHOLD;
 		if (!safe_atou(value, &v))
 			goto out;
 		p->type = PT_UINT;
 		p->value.u = v;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_LID_SWITCH_RELIABILITY))) {
+		break;
+	case QUIRK_ATTR_LID_SWITCH_RELIABILITY:
 		p->id = QUIRK_ATTR_LID_SWITCH_RELIABILITY;
 		if (!streq(value, "reliable") &&
 		    !streq(value, "write_open"))
 			goto out;
 		p->type = PT_STRING;
-		p->value.s = safe_strdup(value);
+		p->value.s = quirks_arena_strdup(ctx, value);
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_KEYBOARD_INTEGRATION))) {
+		break;
+	case QUIRK_ATTR_KEYBOARD_INTEGRATION:
 		p->id = QUIRK_ATTR_KEYBOARD_INTEGRATION;
 		if (!streq(value, "internal") && !streq(value, "external"))
 			goto out;
 		p->type = PT_STRING;
-		p->value.s = safe_strdup(value);
+		p->value.s = quirks_arena_strdup(ctx, value);
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_TRACKPOINT_INTEGRATION))) {
+		break;
+	case QUIRK_ATTR_TRACKPOINT_INTEGRATION:
 		p->id = QUIRK_ATTR_TRACKPOINT_INTEGRATION;
 		if (!streq(value, "internal") && !streq(value, "external"))
 			goto out;
 		p->type = PT_STRING;
-		p->value.s = safe_strdup(value);
+		p->value.s = quirks_arena_strdup(ctx, value);
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_TPKBCOMBO_LAYOUT))) {
+		break;
+	case QUIRK_ATTR_TPKBCOMBO_LAYOUT:
 		p->id = QUIRK_ATTR_TPKBCOMBO_LAYOUT;
 		if (!streq(value, "below"))
 			goto out;
 		p->type = PT_STRING;
-		p->value.s = safe_strdup(value);
+		p->value.s = quirks_arena_strdup(ctx, value);
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_PRESSURE_RANGE))) {
+		break;
+	case QUIRK_ATTR_PRESSURE_RANGE:
 		p->id = QUIRK_ATTR_PRESSURE_RANGE;
 		if (!parse_range_property(value, &range.upper, &range.lower))
 			goto out;
 		p->type = PT_RANGE;
 		p->value.range = range;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_PALM_PRESSURE_THRESHOLD))) {
+		break;
+	case QUIRK_ATTR_PALM_PRESSURE_THRESHOLD:
 		p->id = QUIRK_ATTR_PALM_PRESSURE_THRESHOLD;
 		if (!safe_atou(value, &v))
 			goto out;
 		p->type = PT_UINT;
 		p->value.u = v;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_RESOLUTION_HINT))) {
+		break;
+	case QUIRK_ATTR_RESOLUTION_HINT:
 		p->id = QUIRK_ATTR_RESOLUTION_HINT;
 		if (!parse_dimension_property(value, &dim.x, &dim.y))
 			goto out;
 		p->type = PT_DIMENSION;
 		p->value.dim = dim;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_TRACKPOINT_MULTIPLIER))) {
+		break;
+	case QUIRK_ATTR_TRACKPOINT_MULTIPLIER:
 		p->id = QUIRK_ATTR_TRACKPOINT_MULTIPLIER;
 		if (!safe_atod(value, &d))
 			goto out;
 		p->type = PT_DOUBLE;
 		p->value.d = d;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_USE_VELOCITY_AVERAGING))) {
+		break;
+	case QUIRK_ATTR_USE_VELOCITY_AVERAGING:
 		p->id = QUIRK_ATTR_USE_VELOCITY_AVERAGING;
 		if (!parse_boolean_property(value, &b))
 			goto out;
 		p->type = PT_BOOL;
 		p->value.b = b;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_TABLET_SMOOTHING))) {
+		break;
+	case QUIRK_ATTR_TABLET_SMOOTHING:
 		p->id = QUIRK_ATTR_TABLET_SMOOTHING;
 		if (!parse_boolean_property(value, &b))
 			goto out;
 		p->type = PT_BOOL;
 		p->value.b = b;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_THUMB_PRESSURE_THRESHOLD))) {
+		break;
+	case QUIRK_ATTR_THUMB_PRESSURE_THRESHOLD:
 		p->id = QUIRK_ATTR_THUMB_PRESSURE_THRESHOLD;
 		if (!safe_atou(value, &v))
 			goto out;
 		p->type = PT_UINT;
 		p->value.u = v;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_THUMB_SIZE_THRESHOLD))) {
+		break;
+	case QUIRK_ATTR_THUMB_SIZE_THRESHOLD:
 		p->id = QUIRK_ATTR_THUMB_SIZE_THRESHOLD;
 		if (!safe_atou(value, &v))
 			goto out;
 		p->type = PT_UINT;
 		p->value.u = v;
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_MSC_TIMESTAMP))) {
+		break;
+	case QUIRK_ATTR_FRAMES_PER_DISPATCH:
+		p->id = QUIRK_ATTR_FRAMES_PER_DISPATCH;
+		if (!safe_atou(value, &v) || v == 0)
+			goto out;
+		p->type = PT_UINT;
+		p->value.u = v;
+		rc = true;
+		break;
+	case QUIRK_ATTR_TABLET_SMOOTHING_SIZE:
+		p->id = QUIRK_ATTR_TABLET_SMOOTHING_SIZE;
+		if (!safe_atou(value, &v) || v == 0)
+			goto out;
+		p->type = PT_UINT;
+		p->value.u = v;
+		rc = true;
+		break;
+	case QUIRK_ATTR_MSC_TIMESTAMP:
 		p->id = QUIRK_ATTR_MSC_TIMESTAMP;
 		if (!streq(value, "watch"))
 			goto out;
 		p->type = PT_STRING;
-		p->value.s = safe_strdup(value);
+		p->value.s = quirks_arena_strdup(ctx, value);
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_EVENT_CODE_DISABLE)) ||
-		   streq(key, quirk_get_name(QUIRK_ATTR_EVENT_CODE_ENABLE))) {
+		break;
+	case QUIRK_ATTR_EVENT_CODE_DISABLE:
+	case QUIRK_ATTR_EVENT_CODE_ENABLE: {
 		struct input_event events[32];
 		size_t nevents = ARRAY_LENGTH(events);
-		if (streq(key, quirk_get_name(QUIRK_ATTR_EVENT_CODE_DISABLE)))
-		    p->id = QUIRK_ATTR_EVENT_CODE_DISABLE;
-		else
-		    p->id = QUIRK_ATTR_EVENT_CODE_ENABLE;
+
+		p->id = q;
 
 		if (!parse_evcode_property(value, events, &nevents) ||
 		    nevents == 0)
@@ -839,14 +1136,14 @@ parse_attr(struct quirks_context *ctx,
 		p->type = PT_TUPLES;
 
 		rc = true;
-	} else if (streq(key, quirk_get_name(QUIRK_ATTR_INPUT_PROP_DISABLE)) ||
-		   streq(key, quirk_get_name(QUIRK_ATTR_INPUT_PROP_ENABLE))) {
+		break;
+	}
+	case QUIRK_ATTR_INPUT_PROP_DISABLE:
+	case QUIRK_ATTR_INPUT_PROP_ENABLE: {
 		unsigned int props[INPUT_PROP_CNT];
 		size_t nprops = ARRAY_LENGTH(props);
-		if (streq(key, quirk_get_name(QUIRK_ATTR_INPUT_PROP_DISABLE)))
-			p->id = QUIRK_ATTR_INPUT_PROP_DISABLE;
-		else
-			p->id = QUIRK_ATTR_INPUT_PROP_ENABLE;
+
+		p->id = q;
 
 		if (!parse_input_prop_property(value, props, &nprops) ||
 		    nprops == 0)
@@ -857,8 +1154,10 @@ parse_attr(struct quirks_context *ctx,
 		p->type = PT_UINT_ARRAY;
 
 		rc = true;
-	} else {
-		qlog_error(ctx, "Unknown key %s in %s\n", key, s->name);
+		break;
+	}
+	default:
+		abort();
 	}
 out:
 	if (rc) {
@@ -874,41 +1173,50 @@ out:
  * Parse a single line, expected to be in the format Key=value. Anything
  * else will be rejected with a failure.
  *
- * Our data files can only have Match, Model and Attr, so let's check for
- * those too.
+ * The key must be one of the known Match, Model or Attr keys, anything
+ * else is rejected.
  */
 static bool
 parse_value_line(struct quirks_context *ctx, struct section *s, const char *line)
 {
-	char **strv;
+	/* stack scratch, one split per data file line adds up */
+	char buf[512];
+	char *strv[4];
 	const char *key, *value;
 	bool rc = false;
 
-	strv = strv_from_string(line, "=");
-	if (strv[0] == NULL || strv[1] == NULL || strv[2] != NULL) {
-		goto out;
-	}
-
+	if (strv_from_string_buf(line, "=",
+				 strv, ARRAY_LENGTH(strv),
+				 buf, sizeof(buf)) != 2)
+		return false;
 
 	key = strv[0];
 	value = strv[1];
 	if (strlen(key) == 0 || strlen(value) == 0)
-		goto out;
+		return false;
 
 	/* Whatever the value is, it's not supposed to be in quotes */
 	if (value[0] == '"' || value[0] == '\'')
-		goto out;
+		return false;
+
+	const struct key_entry *entry = key_table_lookup(key);
+	if (!entry) {
+		qlog_error(ctx, "Unknown key %s in %s\n", key, s->name);
+		return false;
+	}
+
+	switch (entry->kind) {
+	case KEY_MATCH:
+		rc = parse_match(ctx, s, (enum match_flags)entry->value, value);
+		break;
+	case KEY_MODEL:
+		rc = parse_model(ctx, s, (enum quirk)entry->value, value);
+		break;
+	case KEY_ATTR:
+		rc = parse_attr(ctx, s, (enum quirk)entry->value, value);
+		break;
+	}
 
-	if (strneq(key, "Match", 5))
-		rc = parse_match(ctx, s, key, value);
-	else if (strneq(key, "Model", 5))
-		rc = parse_model(ctx, s, key, value);
-	else if (strneq(key, "Attr", 4))
-		rc = parse_attr(ctx, s, key, value);
-	else
-		qlog_error(ctx, "Unknown value prefix %s\n", line);
-out:
-	strv_free(strv);
 	return rc;
 }
 
@@ -1015,7 +1323,7 @@ parse_file(struct quirks_context *ctx, const char *path)
 			}
 
 			state = STATE_MATCH;
-			section = section_new(path, line);
+			section = section_new(ctx, path, line);
 			list_append(&ctx->sections, &section->link);
 			break;
 		default:
@@ -1121,85 +1429,766 @@ parse_files(struct quirks_context *ctx, const char *data_path)
 	return idx == ndev;
 }
 
-struct quirks_context *
-quirks_init_subsystem(const char *data_path,
-		      const char *override_file,
-		      libinput_log_handler log_handler,
-		      struct libinput *libinput,
-		      enum quirks_log_type log_type)
-{
-	struct quirks_context *ctx = zalloc(sizeof *ctx);
-
-	assert(data_path);
+/*
+ * Standalone validation of a data dir, the engine behind
+ * "libinput quirks validate". Validation is embarrassingly parallel -
+ * every data file is a self-contained unit, sections never reference
+ * across files - so the files are fanned out over a small thread pool,
+ * each worker parsing into a private throwaway context. The log handler
+ * is shared between the workers and must cope with concurrent calls
+ * (stdio-based handlers do).
+ *
+ * The optional state file makes re-validation incremental: it records
+ * a hash of the content of every file that validated cleanly, and a
+ * file whose content hash is already on record is skipped. Hashing
+ * content rather than stamping mtimes keeps the state robust against
+ * fresh checkouts and copies, which scramble timestamps but not bytes.
+ */
 
-	ctx->refcount = 1;
-	ctx->log_handler = log_handler;
-	ctx->log_type = log_type;
-	ctx->libinput = libinput;
-	list_init(&ctx->quirks);
-	list_init(&ctx->sections);
+struct validate_job {
+	char path[PATH_MAX];
+	uint64_t hash; /* of the file content, 0 while unhashed */
+	bool skipped; /* content hash was on record in the state file */
+	bool ok;
+};
 
-	qlog_debug(ctx, "%s is data root\n", data_path);
+struct validate_pool {
+	struct validate_job *jobs;
+	size_t njobs;
+	size_t next; /* next unclaimed job, atomically incremented */
 
-	ctx->dmi = init_dmi();
-	ctx->dt = init_dt();
-	if (!ctx->dmi && !ctx->dt)
-		goto error;
+	/* loaded before the workers start, read-only after */
+	uint64_t *known_hashes;
+	size_t nknown_hashes;
 
-	if (!parse_files(ctx, data_path))
-		goto error;
+	libinput_log_handler log_handler;
+	struct libinput *libinput;
+	enum quirks_log_type log_type;
+};
 
-	if (override_file && !parse_file(ctx, override_file))
-		goto error;
+static bool
+validate_hash_file(const char *path, uint64_t *hash_out)
+{
+	uint64_t hash = 0xcbf29ce484222325; /* FNV-1a, 64 bit */
+	char buf[4096];
+	size_t n;
+	FILE *fp;
 
-	return ctx;
+	fp = fopen(path, "re");
+	if (!fp)
+		return false;
 
-error:
-	quirks_context_unref(ctx);
-	return NULL;
-}
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		for (size_t i = 0; i < n; i++)
+			hash = (hash ^ (uint8_t)buf[i]) * 0x100000001b3;
+	}
 
-struct quirks_context *
-quirks_context_ref(struct quirks_context *ctx)
-{
-	assert(ctx->refcount > 0);
-	ctx->refcount++;
+	if (ferror(fp)) {
+		fclose(fp);
+		return false;
+	}
 
-	return ctx;
+	fclose(fp);
+	*hash_out = hash;
+	return true;
 }
 
-struct quirks_context *
-quirks_context_unref(struct quirks_context *ctx)
+static void *
+validate_worker(void *data)
 {
-	struct section *s;
+	struct validate_pool *pool = data;
 
-	if (!ctx)
-		return NULL;
+	while (true) {
+		size_t idx = __atomic_fetch_add(&pool->next, 1,
+						__ATOMIC_RELAXED);
+		struct validate_job *job;
+		struct quirks_context *ctx;
 
-	assert(ctx->refcount >= 1);
-	ctx->refcount--;
+		if (idx >= pool->njobs)
+			break;
 
-	if (ctx->refcount > 0)
-		return NULL;
+		job = &pool->jobs[idx];
 
-	/* Caller needs to clean up before calling this */
-	assert(list_empty(&ctx->quirks));
+		if (validate_hash_file(job->path, &job->hash)) {
+			for (size_t i = 0; i < pool->nknown_hashes; i++) {
+				if (pool->known_hashes[i] == job->hash) {
+					job->skipped = true;
+					job->ok = true;
+					break;
+				}
+			}
+			if (job->skipped)
+				continue;
+		}
 
-	list_for_each_safe(s, &ctx->sections, link) {
-		section_destroy(s);
+		/* A private context per file: parse_file() appends to the
+		 * context's section list and arena, so workers must not
+		 * share one. The context never matches a device, it needs
+		 * neither system ids nor an index. */
+		ctx = zalloc(sizeof *ctx);
+		ctx->refcount = 1;
+		ctx->log_handler = pool->log_handler;
+		ctx->log_type = pool->log_type;
+		ctx->libinput = pool->libinput;
+		list_init(&ctx->quirks);
+		list_init(&ctx->arena);
+		list_init(&ctx->sections);
+		list_init(&ctx->match_cache);
+
+		job->ok = parse_file(ctx, job->path);
+
+		quirks_context_unref(ctx);
 	}
 
-	free(ctx->dmi);
-	free(ctx->dt);
-	free(ctx);
-
 	return NULL;
 }
 
-static struct quirks *
-quirks_new(void)
+static void
+validate_state_load(const char *path, struct validate_pool *pool)
 {
-	struct quirks *q;
+	char line[PATH_MAX + 64];
+	FILE *fp;
+
+	fp = fopen(path, "re");
+	if (!fp)
+		return; /* first run, nothing on record */
+
+	while (fgets(line, sizeof(line), fp)) {
+		uint64_t hash;
+		char *endptr;
+
+		hash = strtoull(line, &endptr, 16);
+		if (endptr == line || *endptr != ' ')
+			continue; /* not ours, skip the line */
+
+		pool->known_hashes = realloc(pool->known_hashes,
+					     (pool->nknown_hashes + 1) *
+						sizeof(*pool->known_hashes));
+		assert(pool->known_hashes);
+		pool->known_hashes[pool->nknown_hashes++] = hash;
+	}
+
+	fclose(fp);
+}
+
+static void
+validate_state_save(const char *path, const struct validate_pool *pool)
+{
+	FILE *fp;
+
+	fp = fopen(path, "we");
+	if (!fp)
+		return;
+
+	/* The file name next to the hash is for humans only, the lookup
+	 * goes by content */
+	for (size_t i = 0; i < pool->njobs; i++) {
+		const struct validate_job *job = &pool->jobs[i];
+
+		if (job->ok && job->hash)
+			fprintf(fp, "%016" PRIx64 " %s\n",
+				job->hash, job->path);
+	}
+
+	fclose(fp);
+}
+
+bool
+quirks_validate_files(const char *data_path,
+		      const char *override_file,
+		      const char *state_path,
+		      unsigned int njobs,
+		      libinput_log_handler log_handler,
+		      struct libinput *libinput,
+		      enum quirks_log_type log_type)
+{
+	/* stack context for the coordinator's own messages, the logging
+	 * helpers only look at these three fields */
+	struct quirks_context logctx = {
+		.log_handler = log_handler,
+		.log_type = log_type,
+		.libinput = libinput,
+	};
+	struct validate_pool pool = {
+		.log_handler = log_handler,
+		.libinput = libinput,
+		.log_type = log_type,
+	};
+	struct dirent **namelist;
+	pthread_t *threads;
+	size_t nvalidated = 0, nskipped = 0;
+	bool success = true;
+	int ndev;
+
+	assert(data_path);
+
+	/* the table is process-global and its init is not thread-safe,
+	 * fill it before the workers start */
+	key_table_init();
+
+	ndev = scandir(data_path, &namelist, is_data_file, versionsort);
+	if (ndev <= 0) {
+		qlog_error(&logctx,
+			   "%s: failed to find data files\n",
+			   data_path);
+		return false;
+	}
+
+	pool.jobs = zalloc((ndev + 1) * sizeof(*pool.jobs));
+	for (int i = 0; i < ndev; i++) {
+		snprintf(pool.jobs[i].path,
+			 sizeof(pool.jobs[i].path),
+			 "%s/%s",
+			 data_path,
+			 namelist[i]->d_name);
+		free(namelist[i]);
+	}
+	free(namelist);
+	pool.njobs = ndev;
+
+	if (override_file) {
+		snprintf(pool.jobs[pool.njobs].path,
+			 sizeof(pool.jobs[pool.njobs].path),
+			 "%s",
+			 override_file);
+		pool.njobs++;
+	}
+
+	if (state_path)
+		validate_state_load(state_path, &pool);
+
+	if (njobs == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+		njobs = n > 0 ? (unsigned int)n : 1;
+	}
+	njobs = min(njobs, pool.njobs);
+
+	/* the coordinator doubles as worker, spawn one thread less */
+	threads = zalloc(njobs * sizeof(*threads));
+	for (unsigned int i = 1; i < njobs; i++) {
+		if (pthread_create(&threads[i], NULL,
+				   validate_worker, &pool) != 0) {
+			/* the shared job index makes fewer workers merely
+			 * slower, not wrong */
+			njobs = i;
+			break;
+		}
+	}
+
+	validate_worker(&pool);
+
+	for (unsigned int i = 1; i < njobs; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	for (size_t i = 0; i < pool.njobs; i++) {
+		if (!pool.jobs[i].ok)
+			success = false;
+		else if (pool.jobs[i].skipped)
+			nskipped++;
+		else
+			nvalidated++;
+	}
+
+	/* files that passed stay on record even if a sibling failed, so
+	 * the re-run after a fix only looks at what changed */
+	if (state_path)
+		validate_state_save(state_path, &pool);
+
+	qlog_debug(&logctx,
+		   "%s: %zu files validated, %zu unchanged\n",
+		   data_path, nvalidated, nskipped);
+
+	free(pool.known_hashes);
+	free(pool.jobs);
+
+	return success;
+}
+
+/*
+ * Binary quirks cache, the hwdb.bin equivalent for our data files.
+ * Generated with "libinput quirks compile" from a parsed context and
+ * mmap'd read-only at init time instead of line-parsing the data dir.
+ * The header carries a summary (file count, total size, max mtime) of
+ * the data dir at compile time; if the dir no longer matches we silently
+ * fall back to the text parser.
+ *
+ * The format is host-specific (native endianness, raw property value
+ * dump), it is a cache, not an interchange format.
+ */
+
+#define QUIRKS_CACHE_MAGIC 0x4c495143 /* "LIQC" */
+#define QUIRKS_CACHE_VERSION 1
+#define QUIRKS_CACHE_FILE "quirks.cache"
+
+struct quirks_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t value_size;	/* sizeof the property value union */
+	uint32_t nsections;
+	/* data dir summary for staleness detection */
+	uint32_t nfiles;
+	uint64_t total_size;
+	uint64_t max_mtime;
+};
+
+static bool
+quirks_cache_stamp(const char *data_path,
+		   uint32_t *nfiles,
+		   uint64_t *total_size,
+		   uint64_t *max_mtime)
+{
+	struct dirent **namelist;
+	int ndev;
+
+	*nfiles = 0;
+	*total_size = 0;
+	*max_mtime = 0;
+
+	ndev = scandir(data_path, &namelist, is_data_file, versionsort);
+	if (ndev <= 0)
+		return false;
+
+	for (int i = 0; i < ndev; i++) {
+		char path[PATH_MAX];
+		struct stat st;
+
+		snprintf(path, sizeof(path), "%s/%s",
+			 data_path, namelist[i]->d_name);
+		if (stat(path, &st) == 0) {
+			(*nfiles)++;
+			*total_size += st.st_size;
+			*max_mtime = max(*max_mtime,
+					 (uint64_t)st.st_mtime);
+		}
+		free(namelist[i]);
+	}
+	free(namelist);
+
+	return *nfiles > 0;
+}
+
+static void
+cache_write_string(FILE *fp, const char *s)
+{
+	uint32_t len = s ? strlen(s) + 1 : 0;
+
+	fwrite(&len, sizeof(len), 1, fp);
+	if (len)
+		fwrite(s, 1, len, fp);
+}
+
+bool
+quirks_cache_compile(struct quirks_context *ctx,
+		     const char *data_path,
+		     const char *cache_path)
+{
+	struct quirks_cache_header header = {
+		.magic = QUIRKS_CACHE_MAGIC,
+		.version = QUIRKS_CACHE_VERSION,
+		.value_size = sizeof(((struct property *)NULL)->value),
+	};
+	struct section *s;
+	FILE *fp;
+
+	if (!quirks_cache_stamp(data_path,
+				&header.nfiles,
+				&header.total_size,
+				&header.max_mtime))
+		return false;
+
+	list_for_each(s, &ctx->sections, link)
+		header.nsections++;
+
+	fp = fopen(cache_path, "we");
+	if (!fp) {
+		qlog_error(ctx, "%s: failed to open for writing (%s)\n",
+			   cache_path, strerror(errno));
+		return false;
+	}
+
+	fwrite(&header, sizeof(header), 1, fp);
+
+	list_for_each(s, &ctx->sections, link) {
+		struct property *p;
+		uint32_t fields[6] = {
+			s->match.bits,
+			s->match.bus,
+			s->match.vendor,
+			s->match.product,
+			s->match.version,
+			s->match.udev_type,
+		};
+		uint32_t nprops = 0;
+
+		cache_write_string(fp, s->name);
+		fwrite(fields, sizeof(fields), 1, fp);
+		cache_write_string(fp, s->match.name);
+		cache_write_string(fp, s->match.dmi);
+		cache_write_string(fp, s->match.dt);
+
+		list_for_each(p, &s->properties, link)
+			nprops++;
+		fwrite(&nprops, sizeof(nprops), 1, fp);
+
+		list_for_each(p, &s->properties, link) {
+			uint32_t id = p->id,
+				 type = p->type;
+
+			fwrite(&id, sizeof(id), 1, fp);
+			fwrite(&type, sizeof(type), 1, fp);
+			if (p->type == PT_STRING) {
+				char zero[sizeof(p->value)] = {0};
+
+				fwrite(zero, sizeof(p->value), 1, fp);
+				cache_write_string(fp, p->value.s);
+			} else {
+				fwrite(&p->value, sizeof(p->value), 1, fp);
+			}
+		}
+	}
+
+	if (fflush(fp) != 0 || ferror(fp)) {
+		fclose(fp);
+		unlink(cache_path);
+		return false;
+	}
+
+	fclose(fp);
+
+	return true;
+}
+
+struct cache_cursor {
+	const char *p;
+	const char *end;
+};
+
+static bool
+cache_read_blob(struct cache_cursor *c, void *out, size_t sz)
+{
+	if ((size_t)(c->end - c->p) < sz)
+		return false;
+	memcpy(out, c->p, sz);
+	c->p += sz;
+	return true;
+}
+
+static bool
+cache_read_string(struct quirks_context *ctx,
+		  struct cache_cursor *c,
+		  char **out)
+{
+	uint32_t len;
+
+	*out = NULL;
+	if (!cache_read_blob(c, &len, sizeof(len)))
+		return false;
+	if (len == 0)
+		return true;
+	if ((size_t)(c->end - c->p) < len || c->p[len - 1] != '\0')
+		return false;
+	*out = quirks_arena_strdup(ctx, c->p);
+	c->p += len;
+	return true;
+}
+
+static bool
+quirks_cache_load_sections(struct quirks_context *ctx,
+			   struct cache_cursor *c,
+			   uint32_t nsections)
+{
+	for (uint32_t i = 0; i < nsections; i++) {
+		struct section *s = quirks_arena_alloc(ctx, sizeof(*s));
+		uint32_t fields[6], nprops;
+
+		list_init(&s->properties);
+		list_append(&ctx->sections, &s->link);
+
+		if (!cache_read_string(ctx, c, &s->name) ||
+		    !cache_read_blob(c, fields, sizeof(fields)) ||
+		    !cache_read_string(ctx, c, &s->match.name) ||
+		    !cache_read_string(ctx, c, &s->match.dmi) ||
+		    !cache_read_string(ctx, c, &s->match.dt) ||
+		    !cache_read_blob(c, &nprops, sizeof(nprops)))
+			return false;
+
+		s->match.bits = fields[0];
+		s->match.bus = fields[1];
+		s->match.vendor = fields[2];
+		s->match.product = fields[3];
+		s->match.version = fields[4];
+		s->match.udev_type = fields[5];
+		s->has_match = s->match.bits != 0;
+		s->has_property = nprops > 0;
+
+		for (uint32_t j = 0; j < nprops; j++) {
+			struct property *p = property_new(ctx);
+			uint32_t id, type;
+
+			list_append(&s->properties, &p->link);
+
+			if (!cache_read_blob(c, &id, sizeof(id)) ||
+			    !cache_read_blob(c, &type, sizeof(type)) ||
+			    !cache_read_blob(c, &p->value, sizeof(p->value)))
+				return false;
+
+			p->id = id;
+			p->type = type;
+			if (p->type == PT_STRING &&
+			    !cache_read_string(ctx, c, &p->value.s))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static bool
+quirks_cache_load(struct quirks_context *ctx,
+		  const char *data_path,
+		  const char *cache_path)
+{
+	struct quirks_cache_header header;
+	struct cache_cursor cursor;
+	uint32_t nfiles;
+	uint64_t total_size, max_mtime;
+	struct stat st;
+	void *map;
+	bool rc = false;
+	int fd;
+
+	fd = open(cache_path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(header)) {
+		close(fd);
+		return false;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return false;
+
+	cursor.p = map;
+	cursor.end = (const char *)map + st.st_size;
+
+	if (!cache_read_blob(&cursor, &header, sizeof(header)))
+		goto out;
+
+	if (header.magic != QUIRKS_CACHE_MAGIC ||
+	    header.version != QUIRKS_CACHE_VERSION ||
+	    header.value_size != sizeof(((struct property *)NULL)->value))
+		goto out;
+
+	if (!quirks_cache_stamp(data_path, &nfiles, &total_size, &max_mtime) ||
+	    nfiles != header.nfiles ||
+	    total_size != header.total_size ||
+	    max_mtime != header.max_mtime) {
+		qlog_debug(ctx, "%s: cache is stale, ignoring\n", cache_path);
+		goto out;
+	}
+
+	rc = quirks_cache_load_sections(ctx, &cursor, header.nsections);
+	if (!rc) {
+		struct section *s;
+
+		qlog_error(ctx, "%s: malformed cache, ignoring\n", cache_path);
+		list_for_each_safe(s, &ctx->sections, link)
+			section_destroy(s);
+	}
+out:
+	munmap(map, st.st_size);
+	return rc;
+}
+
+static void
+quirks_build_index(struct quirks_context *ctx)
+{
+	struct section *s;
+	struct section_idx *idx;
+	size_t nsections = 0;
+
+	list_for_each(s, &ctx->sections, link)
+		nsections++;
+
+	ctx->index = zalloc(nsections * sizeof(*ctx->index));
+	ctx->nindex = nsections;
+
+	idx = ctx->index;
+	list_for_each(s, &ctx->sections, link) {
+		idx->bits = s->match.bits &
+			    (M_BUS|M_VID|M_PID|M_VERSION);
+		idx->bus = s->match.bus;
+		idx->vendor = s->match.vendor;
+		idx->product = s->match.product;
+		idx->version = s->match.version;
+		idx->section = s;
+		idx++;
+	}
+}
+
+/* Cheap rejection on the exact-match keys. A section wanting a key the
+ * device doesn't provide can never fully match either, so that is
+ * rejected here too. */
+static inline bool
+section_idx_may_match(const struct section_idx *idx, const struct match *m)
+{
+	uint32_t wanted = idx->bits;
+
+	if (wanted & ~m->bits)
+		return false;
+
+	if ((wanted & M_BUS) && idx->bus != m->bus)
+		return false;
+	if ((wanted & M_VID) && idx->vendor != m->vendor)
+		return false;
+	if ((wanted & M_PID) && idx->product != m->product)
+		return false;
+	if ((wanted & M_VERSION) && idx->version != m->version)
+		return false;
+
+	return true;
+}
+
+/* Warm-start inventory for the match cache, see the definitions below
+ * match_cache_add() */
+static void
+quirks_warm_start_save(struct quirks_context *ctx);
+static void
+quirks_warm_start_load(struct quirks_context *ctx);
+
+struct quirks_context *
+quirks_init_subsystem(const char *data_path,
+		      const char *override_file,
+		      libinput_log_handler log_handler,
+		      struct libinput *libinput,
+		      enum quirks_log_type log_type)
+{
+	struct quirks_context *ctx = zalloc(sizeof *ctx);
+
+	assert(data_path);
+
+	ctx->refcount = 1;
+	ctx->log_handler = log_handler;
+	ctx->log_type = log_type;
+	ctx->libinput = libinput;
+	list_init(&ctx->quirks);
+	list_init(&ctx->arena);
+	list_init(&ctx->sections);
+	list_init(&ctx->match_cache);
+
+	qlog_debug(ctx, "%s is data root\n", data_path);
+
+	ctx->data_path = safe_strdup(data_path);
+	key_table_init();
+	init_system_ids();
+	ctx->dmi = safe_strdup(system_ids.dmi);
+	ctx->dt = safe_strdup(system_ids.dt);
+	if (!ctx->dmi && !ctx->dt)
+		goto error;
+
+	{
+		const char *cache_path = getenv("LIBINPUT_QUIRKS_CACHE");
+		char cache_buf[PATH_MAX];
+
+		if (!cache_path) {
+			snprintf(cache_buf, sizeof(cache_buf), "%s/%s",
+				 data_path, QUIRKS_CACHE_FILE);
+			cache_path = cache_buf;
+		}
+
+		if (quirks_cache_load(ctx, data_path, cache_path))
+			qlog_debug(ctx, "%s: loaded from cache\n", data_path);
+		else if (!parse_files(ctx, data_path))
+			goto error;
+	}
+
+	if (override_file && !parse_file(ctx, override_file))
+		goto error;
+
+	quirks_build_index(ctx);
+	quirks_warm_start_load(ctx);
+
+	return ctx;
+
+error:
+	quirks_context_unref(ctx);
+	return NULL;
+}
+
+struct quirks_context *
+quirks_context_ref(struct quirks_context *ctx)
+{
+	assert(ctx->refcount > 0);
+	ctx->refcount++;
+
+	return ctx;
+}
+
+size_t
+quirks_context_memory_size(struct quirks_context *ctx)
+{
+	struct arena_chunk *chunk;
+	size_t size;
+
+	if (!ctx)
+		return 0;
+
+	/* Everything the parser produced lives in the arena, the index is
+	 * the only sizeable allocation next to it */
+	size = sizeof(*ctx) + ctx->nindex * sizeof(*ctx->index);
+	list_for_each(chunk, &ctx->arena, link)
+		size += sizeof(*chunk) + chunk->size;
+
+	return size;
+}
+
+struct quirks_context *
+quirks_context_unref(struct quirks_context *ctx)
+{
+	struct arena_chunk *chunk;
+	struct section *s;
+
+	if (!ctx)
+		return NULL;
+
+	assert(ctx->refcount >= 1);
+	ctx->refcount--;
+
+	if (ctx->refcount > 0)
+		return NULL;
+
+	/* Caller needs to clean up before calling this */
+	assert(list_empty(&ctx->quirks));
+
+	quirks_warm_start_save(ctx);
+
+	list_for_each_safe(s, &ctx->sections, link) {
+		section_destroy(s);
+	}
+
+	list_for_each_safe(chunk, &ctx->arena, link) {
+		list_remove(&chunk->link);
+		free(chunk);
+	}
+
+	free(ctx->index);
+	free(ctx->dmi);
+	free(ctx->dt);
+	free(ctx->data_path);
+	free(ctx);
+
+	return NULL;
+}
+
+static struct quirks *
+quirks_new(void)
+{
+	struct quirks *q;
 
 	q = zalloc(sizeof *q);
 	q->refcount = 1;
@@ -1383,6 +2372,314 @@ match_free(struct match *m)
 	free(m);
 }
 
+static uint32_t
+match_key_hash(const struct match *m)
+{
+	const char *name = m->name ? m->name : "";
+	uint32_t vals[] = {
+		m->bits,
+		m->bus,
+		m->vendor,
+		m->product,
+		m->version,
+		m->udev_type,
+	};
+	uint32_t hash = 2166136261u; /* FNV-1a */
+
+	for (const char *c = name; *c; c++)
+		hash = (hash ^ (uint8_t)*c) * 16777619u;
+
+	for (size_t i = 0; i < ARRAY_LENGTH(vals); i++) {
+		for (size_t b = 0; b < sizeof(uint32_t); b++)
+			hash = (hash ^ ((vals[i] >> (b * 8)) & 0xff)) *
+				16777619u;
+	}
+
+	return hash;
+}
+
+static struct match_cache_entry *
+match_cache_lookup(struct quirks_context *ctx,
+		   const struct match *m,
+		   uint32_t hash)
+{
+	struct match_cache_entry *e;
+
+	list_for_each(e, &ctx->match_cache, link) {
+		if (e->hash != hash)
+			continue;
+
+		if (e->bits == m->bits &&
+		    e->bus == m->bus &&
+		    e->vendor == m->vendor &&
+		    e->product == m->product &&
+		    e->version == m->version &&
+		    e->udev_type == m->udev_type &&
+		    streq(e->name ? e->name : "", m->name ? m->name : ""))
+			return e;
+	}
+
+	return NULL;
+}
+
+static void
+match_cache_add(struct quirks_context *ctx,
+		const struct match *m,
+		uint32_t hash,
+		struct section **sections,
+		size_t nsections)
+{
+	struct match_cache_entry *e;
+
+	e = quirks_arena_alloc(ctx, sizeof(*e));
+	e->hash = hash;
+	e->bits = m->bits;
+	e->name = quirks_arena_strdup(ctx, m->name);
+	e->bus = m->bus;
+	e->vendor = m->vendor;
+	e->product = m->product;
+	e->version = m->version;
+	e->udev_type = m->udev_type;
+
+	/* no-match keys are worth caching too, nsections stays 0 */
+	if (nsections) {
+		e->sections = quirks_arena_alloc(ctx,
+						 nsections * sizeof(*sections));
+		memcpy(e->sections, sections, nsections * sizeof(*sections));
+		e->nsections = nsections;
+	}
+
+	list_insert(&ctx->match_cache, &e->link);
+}
+
+/*
+ * Warm-start inventory: the per-device resolved match results, written
+ * on shutdown and preloaded into the match cache on the next init,
+ * opt-in via LIBINPUT_WARM_START_FILE=<path>. A crash-recovery restart
+ * probes the same devices again; with the inventory preloaded each
+ * device's quirk resolution is a hash lookup instead of a full match
+ * evaluation across all sections. The file is verified on load: the
+ * data dir stamp and the dmi/dt modaliases must match and every
+ * referenced section must still resolve by name. A device that changed
+ * since the save simply misses the cache and is evaluated in full.
+ *
+ * Like the binary cache this is host-specific, not an interchange
+ * format.
+ */
+
+#define WARM_START_MAGIC 0x4c495753 /* "LIWS" */
+#define WARM_START_VERSION 1
+
+struct warm_start_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nentries;
+	/* data dir summary, see quirks_cache_stamp() */
+	uint32_t nfiles;
+	uint64_t total_size;
+	uint64_t max_mtime;
+};
+
+static void
+quirks_warm_start_save(struct quirks_context *ctx)
+{
+	const char *path = getenv("LIBINPUT_WARM_START_FILE");
+	struct warm_start_header header = {
+		.magic = WARM_START_MAGIC,
+		.version = WARM_START_VERSION,
+	};
+	struct match_cache_entry *e;
+	FILE *fp;
+
+	/* throwaway validation contexts have no data path to stamp */
+	if (!path || !*path || !ctx->data_path)
+		return;
+
+	if (!quirks_cache_stamp(ctx->data_path,
+				&header.nfiles,
+				&header.total_size,
+				&header.max_mtime))
+		return;
+
+	list_for_each(e, &ctx->match_cache, link)
+		header.nentries++;
+
+	if (header.nentries == 0)
+		return;
+
+	fp = fopen(path, "we");
+	if (!fp)
+		return;
+
+	fwrite(&header, sizeof(header), 1, fp);
+	cache_write_string(fp, ctx->dmi);
+	cache_write_string(fp, ctx->dt);
+
+	list_for_each(e, &ctx->match_cache, link) {
+		uint32_t fields[6] = {
+			e->bits,
+			e->bus,
+			e->vendor,
+			e->product,
+			e->version,
+			e->udev_type,
+		};
+		uint32_t nsections = e->nsections;
+
+		fwrite(fields, sizeof(fields), 1, fp);
+		cache_write_string(fp, e->name);
+		fwrite(&nsections, sizeof(nsections), 1, fp);
+		for (size_t i = 0; i < e->nsections; i++)
+			cache_write_string(fp, e->sections[i]->name);
+	}
+
+	if (fflush(fp) != 0 || ferror(fp)) {
+		fclose(fp);
+		unlink(path);
+		return;
+	}
+
+	fclose(fp);
+}
+
+static struct section *
+section_find_by_name(struct quirks_context *ctx, const char *name)
+{
+	struct section *s;
+
+	list_for_each(s, &ctx->sections, link) {
+		if (streq(s->name, name))
+			return s;
+	}
+
+	return NULL;
+}
+
+static void
+quirks_warm_start_load(struct quirks_context *ctx)
+{
+	const char *path = getenv("LIBINPUT_WARM_START_FILE");
+	struct warm_start_header header;
+	struct cache_cursor cursor;
+	uint32_t nfiles;
+	uint64_t total_size, max_mtime;
+	char *dmi, *dt;
+	size_t nloaded = 0;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (!path || !*path)
+		return;
+
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(header)) {
+		close(fd);
+		return;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return;
+
+	cursor.p = map;
+	cursor.end = (const char *)map + st.st_size;
+
+	if (!cache_read_blob(&cursor, &header, sizeof(header)) ||
+	    header.magic != WARM_START_MAGIC ||
+	    header.version != WARM_START_VERSION)
+		goto out;
+
+	if (!quirks_cache_stamp(ctx->data_path,
+				&nfiles,
+				&total_size,
+				&max_mtime) ||
+	    nfiles != header.nfiles ||
+	    total_size != header.total_size ||
+	    max_mtime != header.max_mtime) {
+		qlog_debug(ctx,
+			   "%s: warm-start inventory is stale, ignoring\n",
+			   path);
+		goto out;
+	}
+
+	if (!cache_read_string(ctx, &cursor, &dmi) ||
+	    !cache_read_string(ctx, &cursor, &dt) ||
+	    !streq(dmi ? dmi : "", ctx->dmi ? ctx->dmi : "") ||
+	    !streq(dt ? dt : "", ctx->dt ? ctx->dt : ""))
+		goto out;
+
+	for (uint32_t i = 0; i < header.nentries; i++) {
+		struct match_cache_entry *e;
+		struct match m;
+		uint32_t fields[6], nsections;
+		char *name;
+		bool valid = true;
+
+		if (!cache_read_blob(&cursor, fields, sizeof(fields)) ||
+		    !cache_read_string(ctx, &cursor, &name) ||
+		    !cache_read_blob(&cursor, &nsections, sizeof(nsections)) ||
+		    nsections > ctx->nindex)
+			goto out;
+
+		e = quirks_arena_alloc(ctx, sizeof(*e));
+		e->bits = fields[0];
+		e->bus = fields[1];
+		e->vendor = fields[2];
+		e->product = fields[3];
+		e->version = fields[4];
+		e->udev_type = fields[5];
+		e->name = name;
+		if (nsections)
+			e->sections = quirks_arena_alloc(ctx,
+							 nsections *
+							 sizeof(*e->sections));
+
+		for (uint32_t j = 0; j < nsections; j++) {
+			struct section *s;
+			char *sname;
+
+			if (!cache_read_string(ctx, &cursor, &sname) || !sname)
+				goto out;
+
+			s = section_find_by_name(ctx, sname);
+			if (!s) {
+				/* e.g. an override file went away; drop
+				 * the entry, the device re-evaluates */
+				valid = false;
+			} else if (valid) {
+				e->sections[e->nsections++] = s;
+			}
+		}
+
+		if (!valid)
+			continue;
+
+		m = (struct match) {
+			.bits = e->bits,
+			.name = e->name,
+			.bus = e->bus,
+			.vendor = e->vendor,
+			.product = e->product,
+			.version = e->version,
+			.udev_type = e->udev_type,
+		};
+		e->hash = match_key_hash(&m);
+		list_insert(&ctx->match_cache, &e->link);
+		nloaded++;
+	}
+
+	qlog_debug(ctx,
+		   "%s: warm start with %zu resolved matches\n",
+		   path, nloaded);
+out:
+	munmap(map, st.st_size);
+}
+
 static void
 quirk_apply_section(struct quirks_context *ctx,
 		    struct quirks *q,
@@ -1403,10 +2700,15 @@ quirk_apply_section(struct quirks_context *ctx,
 
 	q->properties = tmp;
 	list_for_each(p, &s->properties, link) {
+		ssize_t slot = quirk_slot(p->id);
+
 		qlog_debug(ctx, "property added: %s from %s\n",
 			   quirk_get_name(p->id), s->name);
 
 		q->properties[q->nproperties++] = property_ref(p);
+		/* sections apply in order, so this is last-one-wins */
+		if (slot >= 0)
+			q->by_id[slot] = p;
 	}
 }
 
@@ -1480,10 +2782,11 @@ quirk_match_section(struct quirks_context *ctx,
 		}
 	}
 
-	if (s->match.bits == matched_flags) {
-		qlog_debug(ctx, "%s is full match\n", s->name);
-		quirk_apply_section(ctx, q, s);
-	}
+	if (s->match.bits != matched_flags)
+		return false;
+
+	qlog_debug(ctx, "%s is full match\n", s->name);
+	quirk_apply_section(ctx, q, s);
 
 	return true;
 }
@@ -1493,8 +2796,9 @@ quirks_fetch_for_device(struct quirks_context *ctx,
 			struct udev_device *udev_device)
 {
 	struct quirks *q = NULL;
-	struct section *s;
 	struct match *m;
+	struct match_cache_entry *entry;
+	uint32_t hash;
 
 	if (!ctx)
 		return NULL;
@@ -1505,9 +2809,41 @@ quirks_fetch_for_device(struct quirks_context *ctx,
 	q = quirks_new();
 
 	m = match_new(udev_device, ctx->dmi, ctx->dt);
+	hash = match_key_hash(m);
 
-	list_for_each(s, &ctx->sections, link) {
-		quirk_match_section(ctx, q, s, m, udev_device);
+	entry = match_cache_lookup(ctx, m, hash);
+	if (entry) {
+		qlog_debug(ctx, "%s: match cache hit\n",
+			   udev_device_get_devnode(udev_device));
+
+		for (size_t i = 0; i < entry->nsections; i++)
+			quirk_apply_section(ctx, q, entry->sections[i]);
+	} else {
+		struct section **matched = NULL;
+		size_t nmatched = 0;
+		void *tmp;
+
+		for (size_t i = 0; i < ctx->nindex; i++) {
+			const struct section_idx *idx = &ctx->index[i];
+
+			if (!section_idx_may_match(idx, m))
+				continue;
+
+			if (!quirk_match_section(ctx, q, idx->section, m,
+						 udev_device))
+				continue;
+
+			tmp = realloc(matched,
+				      (nmatched + 1) * sizeof(*matched));
+			if (!tmp)
+				continue;
+
+			matched = tmp;
+			matched[nmatched++] = idx->section;
+		}
+
+		match_cache_add(ctx, m, hash, matched, nmatched);
+		free(matched);
 	}
 
 	match_free(m);
@@ -1526,14 +2862,9 @@ quirks_fetch_for_device(struct quirks_context *ctx,
 static inline struct property *
 quirk_find_prop(struct quirks *q, enum quirk which)
 {
-	/* Run backwards to only handle the last one assigned */
-	for (ssize_t i = q->nproperties - 1; i >= 0; i--) {
-		struct property *p = q->properties[i];
-		if (p->id == which)
-			return p;
-	}
+	ssize_t slot = quirk_slot(which);
 
-	return NULL;
+	return slot >= 0 ? q->by_id[slot] : NULL;
 }
 
 bool
@@ -1542,6 +2873,69 @@ quirks_has_quirk(struct quirks *q, enum quirk which)
 	return quirk_find_prop(q, which) != NULL;
 }
 
+static bool
+property_values_equal(const struct property *a, const struct property *b)
+{
+	if (a->id != b->id || a->type != b->type)
+		return false;
+
+	switch (a->type) {
+	case PT_UINT:
+		return a->value.u == b->value.u;
+	case PT_INT:
+		return a->value.i == b->value.i;
+	case PT_STRING:
+		return streq(a->value.s, b->value.s);
+	case PT_BOOL:
+		return a->value.b == b->value.b;
+	case PT_DIMENSION:
+		return a->value.dim.x == b->value.dim.x &&
+		       a->value.dim.y == b->value.dim.y;
+	case PT_RANGE:
+		return a->value.range.lower == b->value.range.lower &&
+		       a->value.range.upper == b->value.range.upper;
+	case PT_DOUBLE:
+		return a->value.d == b->value.d;
+	case PT_TUPLES:
+		return a->value.tuples.ntuples == b->value.tuples.ntuples &&
+		       memcmp(a->value.tuples.tuples,
+			      b->value.tuples.tuples,
+			      a->value.tuples.ntuples *
+				      sizeof(a->value.tuples.tuples[0])) == 0;
+	case PT_UINT_ARRAY:
+		return a->value.array.nelements == b->value.array.nelements &&
+		       memcmp(a->value.array.data.u,
+			      b->value.array.data.u,
+			      a->value.array.nelements *
+				      sizeof(a->value.array.data.u[0])) == 0;
+	}
+
+	return false;
+}
+
+bool
+quirks_sets_equal(struct quirks *a, struct quirks *b)
+{
+	/* NULL means "no quirks matched", only equal to itself */
+	if (!a || !b)
+		return a == b;
+
+	/* by_id holds the effective (last-assigned) property per quirk,
+	 * so comparing slot by slot compares what the getters would
+	 * return, regardless of how many sections assigned each quirk */
+	for (size_t i = 0; i < QUIRK_NSLOTS; i++) {
+		const struct property *pa = a->by_id[i],
+				      *pb = b->by_id[i];
+
+		if (!pa != !pb)
+			return false;
+		if (pa && !property_values_equal(pa, pb))
+			return false;
+	}
+
+	return true;
+}
+
 bool
 quirks_get_int32(struct quirks *q, enum quirk which, int32_t *val)
 {
@@ -1692,6 +3086,61 @@ quirks_get_tuples(struct quirks *q,
 	return true;
 }
 
+size_t
+quirks_get_many(struct quirks *q,
+		struct quirks_request *requests,
+		size_t nrequests)
+{
+	size_t nset = 0;
+
+	for (size_t i = 0; i < nrequests; i++) {
+		struct quirks_request *r = &requests[i];
+		struct property *p;
+
+		r->set = false;
+
+		p = q ? quirk_find_prop(q, r->which) : NULL;
+		if (!p)
+			continue;
+
+		switch (p->type) {
+		case PT_BOOL:
+			r->value.b = p->value.b;
+			break;
+		case PT_UINT:
+			r->value.u = p->value.u;
+			break;
+		case PT_INT:
+			r->value.i = p->value.i;
+			break;
+		case PT_STRING:
+			r->value.s = p->value.s;
+			break;
+		case PT_DOUBLE:
+			r->value.d = p->value.d;
+			break;
+		case PT_DIMENSION:
+			r->value.dim = p->value.dim;
+			break;
+		case PT_RANGE:
+			r->value.range = p->value.range;
+			break;
+		case PT_TUPLES:
+			r->value.tuples = &p->value.tuples;
+			break;
+		case PT_UINT_ARRAY:
+			r->value.uint_array.data = p->value.array.data.u;
+			r->value.uint_array.nelements = p->value.array.nelements;
+			break;
+		}
+
+		r->set = true;
+		nset++;
+	}
+
+	return nset;
+}
+
 bool
 quirks_get_uint32_array(struct quirks *q,
 			enum quirk which,
@@ -65,6 +65,7 @@ enum quirk {
 	QUIRK_MODEL_ALPS_SERIAL_TOUCHPAD = 100,
 	QUIRK_MODEL_APPLE_TOUCHPAD,
 	QUIRK_MODEL_APPLE_TOUCHPAD_ONEBUTTON,
+	QUIRK_MODEL_BOUNCING_BUTTONS,
 	QUIRK_MODEL_BOUNCING_KEYS,
 	QUIRK_MODEL_CHROMEBOOK,
 	QUIRK_MODEL_CLEVO_W740SU,
@@ -111,6 +112,8 @@ enum quirk {
 	QUIRK_ATTR_EVENT_CODE_ENABLE,
 	QUIRK_ATTR_INPUT_PROP_DISABLE,
 	QUIRK_ATTR_INPUT_PROP_ENABLE,
+	QUIRK_ATTR_FRAMES_PER_DISPATCH,
+	QUIRK_ATTR_TABLET_SMOOTHING_SIZE,
 
 	_QUIRK_LAST_ATTR_QUIRK_, /* Guard: do not modify */
 };
@@ -183,6 +186,51 @@ quirks_context_unref(struct quirks_context *ctx);
 struct quirks_context *
 quirks_context_ref(struct quirks_context *ctx);
 
+/**
+ * The number of bytes of heap backing this context, see
+ * libinput_get_memory_stats().
+ */
+size_t
+quirks_context_memory_size(struct quirks_context *ctx);
+
+/**
+ * Write the parsed quirks of this context out as a binary cache file.
+ * A cache named "quirks.cache" in the data dir is picked up by
+ * quirks_init_subsystem() instead of text-parsing the data files,
+ * provided the data dir is unchanged since the cache was compiled.
+ *
+ * The cache must be compiled from a context initialized without an
+ * override file, otherwise the override properties get baked in.
+ *
+ * @return true on success
+ */
+bool
+quirks_cache_compile(struct quirks_context *ctx,
+		     const char *data_path,
+		     const char *cache_path);
+
+/**
+ * Validate every data file in the given directory (and, where non-NULL,
+ * the override file) without building a matching context, parsing the
+ * files in parallel across njobs threads. njobs of 0 means one thread
+ * per online CPU. The log handler may be called from multiple threads
+ * at once.
+ *
+ * Where state_path is non-NULL, a content hash of each file that
+ * validated cleanly is kept there between runs and unchanged files are
+ * skipped on the next invocation.
+ *
+ * @return true if all files validated
+ */
+bool
+quirks_validate_files(const char *data_path,
+		      const char *override_file,
+		      const char *state_path,
+		      unsigned int njobs,
+		      libinput_log_handler log_handler,
+		      struct libinput *libinput,
+		      enum quirks_log_type log_type);
+
 /**
  * Fetch the quirks for a given device. If no quirks are defined, this
  * function returns NULL.
@@ -208,6 +256,14 @@ quirks_unref(struct quirks *q);
 bool
 quirks_has_quirk(struct quirks *q, enum quirk which);
 
+/**
+ * Compare the effective quirk values of two resolved sets, e.g. the same
+ * device's quirks fetched from two different contexts. Either argument
+ * may be NULL ("no quirks matched"); NULL only compares equal to NULL.
+ */
+bool
+quirks_sets_equal(struct quirks *a, struct quirks *b);
+
 /**
  * Get the value of the given quirk, as unsigned integer.
  * This function will assert if the quirk type does not match the
@@ -328,3 +384,42 @@ quirks_get_uint32_array(struct quirks *q,
 			enum quirk which,
 			const uint32_t **array,
 			size_t *nelements);
+
+/**
+ * One entry in a quirks_get_many() request. The caller fills in which,
+ * on return set is true iff the quirk exists for this device and the
+ * union member matching the quirk's property type holds the value.
+ * Pointer members (strings, tuples, arrays) point into the quirks
+ * storage and are only valid as long as the struct quirks is.
+ */
+struct quirks_request {
+	enum quirk which;
+	bool set;
+	union {
+		bool b;
+		uint32_t u;
+		int32_t i;
+		char *s;
+		double d;
+		struct quirk_dimensions dim;
+		struct quirk_range range;
+		const struct quirk_tuples *tuples;
+		struct {
+			const uint32_t *data;
+			size_t nelements;
+		} uint_array;
+	} value;
+};
+
+/**
+ * Fill in a batch of quirk values in one call, the bulk equivalent of
+ * the individual quirks_get_*() getters. Requests whose quirk is not
+ * set for this device have their set flag cleared and their value left
+ * undefined.
+ *
+ * @return the number of requests that were filled in
+ */
+size_t
+quirks_get_many(struct quirks *q,
+		struct quirks_request *requests,
+		size_t nrequests);
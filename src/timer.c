@@ -48,8 +48,7 @@ libinput_timer_init(struct libinput_timer *timer,
 void
 libinput_timer_destroy(struct libinput_timer *timer)
 {
-	if (timer->link.prev != NULL && timer->link.next != NULL &&
-	    !list_empty(&timer->link)) {
+	if (timer->expire != 0) {
 		log_bug_libinput(timer->libinput,
 				 "timer: %s has not been cancelled\n",
 				 timer->timer_name);
@@ -58,19 +57,127 @@ libinput_timer_destroy(struct libinput_timer *timer)
 	free(timer->timer_name);
 }
 
+/* The armed timers live in a binary min-heap on the expire time, so
+ * arming the timerfd is a peek at the root and set/cancel are O(log n)
+ * instead of the previous full-list scans. Each timer tracks its heap
+ * slot in heap_index for O(log n) removal from the middle. */
+
+static inline bool
+timer_heap_sift_up(struct libinput *libinput, size_t index)
+{
+	struct libinput_timer **heap = libinput->timer.heap;
+	struct libinput_timer *timer = heap[index];
+	bool moved = false;
+
+	while (index > 0) {
+		size_t parent = (index - 1) / 2;
+
+		if (heap[parent]->expire <= timer->expire)
+			break;
+
+		heap[index] = heap[parent];
+		heap[index]->heap_index = index;
+		index = parent;
+		moved = true;
+	}
+
+	heap[index] = timer;
+	timer->heap_index = index;
+
+	return moved;
+}
+
+static void
+timer_heap_sift_down(struct libinput *libinput, size_t index)
+{
+	struct libinput_timer **heap = libinput->timer.heap;
+	size_t count = libinput->timer.heap_count;
+	struct libinput_timer *timer = heap[index];
+
+	while (true) {
+		size_t child = 2 * index + 1;
+
+		if (child >= count)
+			break;
+		if (child + 1 < count &&
+		    heap[child + 1]->expire < heap[child]->expire)
+			child++;
+		if (timer->expire <= heap[child]->expire)
+			break;
+
+		heap[index] = heap[child];
+		heap[index]->heap_index = index;
+		index = child;
+	}
+
+	heap[index] = timer;
+	timer->heap_index = index;
+}
+
+static void
+timer_heap_insert(struct libinput *libinput, struct libinput_timer *timer)
+{
+	if (libinput->timer.heap_count == libinput->timer.heap_len) {
+		size_t new_len = libinput->timer.heap_len * 2;
+		struct libinput_timer **heap;
+
+		heap = realloc(libinput->timer.heap,
+			       new_len * sizeof(*heap));
+		if (!heap)
+			abort();
+		libinput->timer.heap = heap;
+		libinput->timer.heap_len = new_len;
+	}
+
+	libinput->timer.heap[libinput->timer.heap_count] = timer;
+	timer->heap_index = libinput->timer.heap_count++;
+	timer_heap_sift_up(libinput, timer->heap_index);
+}
+
+static void
+timer_heap_remove(struct libinput *libinput, struct libinput_timer *timer)
+{
+	size_t index = timer->heap_index;
+	struct libinput_timer *last;
+
+	assert(index < libinput->timer.heap_count);
+	assert(libinput->timer.heap[index] == timer);
+
+	last = libinput->timer.heap[--libinput->timer.heap_count];
+	if (last == timer)
+		return;
+
+	libinput->timer.heap[index] = last;
+	last->heap_index = index;
+	if (!timer_heap_sift_up(libinput, index))
+		timer_heap_sift_down(libinput, index);
+}
+
 static void
 libinput_timer_arm_timer_fd(struct libinput *libinput)
 {
 	int r;
-	struct libinput_timer *timer;
 	struct itimerspec its = { { 0, 0 }, { 0, 0 } };
 	uint64_t earliest_expire = UINT64_MAX;
 
-	list_for_each(timer, &libinput->timer.list, link) {
-		if (timer->expire < earliest_expire)
-			earliest_expire = timer->expire;
+	/* Inside dispatch, fold all set/cancel calls into one rearm at
+	 * dispatch exit. A fast drag re-arms the tap timers on every
+	 * motion frame; only the final state matters to the fd. */
+	if (libinput->in_dispatch) {
+		libinput->timer.rearm_pending = true;
+		return;
 	}
 
+	if (libinput->timer.heap_count > 0)
+		earliest_expire = libinput->timer.heap[0]->expire;
+
+	/* The fd is armed with an absolute time, so re-arming with the
+	 * same expiry is a no-op; skip the µs-to-timespec conversion and
+	 * the syscall. Common when a timer set/cancel doesn't change the
+	 * heap root. */
+	if (earliest_expire == libinput->timer.next_expiry)
+		return;
+
 	if (earliest_expire != UINT64_MAX) {
 		its.it_value.tv_sec = earliest_expire / ms2us(1000);
 		its.it_value.tv_nsec = (earliest_expire % ms2us(1000)) * 1000;
@@ -96,7 +203,8 @@ libinput_timer_set_flags(struct libinput_timer *timer,
 				       "timer %s: scheduled expiry is in the past (-%dms), your system is too slow\n",
 				       timer->timer_name,
 				       us2ms(now - expire));
-	} else if ((expire - now) > ms2us(5000)) {
+	} else if ((expire - now) > ms2us(5000) &&
+		   (flags & TIMER_FLAG_ALLOW_LONG) == 0) {
 		log_bug_libinput(timer->libinput,
 			 "timer %s: offset more than 5s, now %d expire %d\n",
 			 timer->timer_name,
@@ -106,10 +214,16 @@ libinput_timer_set_flags(struct libinput_timer *timer,
 
 	assert(expire);
 
-	if (!timer->expire)
-		list_insert(&timer->libinput->timer.list, &timer->link);
+	if (!timer->expire) {
+		timer->expire = expire;
+		timer_heap_insert(timer->libinput, timer);
+	} else {
+		timer->expire = expire;
+		if (!timer_heap_sift_up(timer->libinput, timer->heap_index))
+			timer_heap_sift_down(timer->libinput,
+					     timer->heap_index);
+	}
 
-	timer->expire = expire;
 	libinput_timer_arm_timer_fd(timer->libinput);
 }
 
@@ -125,37 +239,25 @@ libinput_timer_cancel(struct libinput_timer *timer)
 	if (!timer->expire)
 		return;
 
+	timer_heap_remove(timer->libinput, timer);
 	timer->expire = 0;
-	list_remove(&timer->link);
 	libinput_timer_arm_timer_fd(timer->libinput);
 }
 
 static void
 libinput_timer_handler(struct libinput *libinput , uint64_t now)
 {
-	struct libinput_timer *timer;
-
-restart:
-	list_for_each_safe(timer, &libinput->timer.list, link) {
-		if (timer->expire == 0)
-			continue;
-
-		if (timer->expire <= now) {
-			/* Clear the timer before calling timer_func,
-			   as timer_func may re-arm it */
-			libinput_timer_cancel(timer);
-			timer->timer_func(now, timer->timer_func_data);
-
-			/*
-			 * Restart the loop. We can't use
-			 * list_for_each_safe() here because that only
-			 * allows removing one (our) timer per timer_func.
-			 * But the timer func may trigger another unrelated
-			 * timer to be cancelled and removed, causing a
-			 * segfault.
-			 */
-			goto restart;
-		}
+	/* Re-peek the root on every iteration: the timer func may re-arm
+	   its own timer or cancel unrelated ones, the heap stays
+	   consistent either way. */
+	while (libinput->timer.heap_count > 0 &&
+	       libinput->timer.heap[0]->expire <= now) {
+		struct libinput_timer *timer = libinput->timer.heap[0];
+
+		/* Clear the timer before calling timer_func,
+		   as timer_func may re-arm it */
+		libinput_timer_cancel(timer);
+		timer->timer_func(now, timer->timer_func_data);
 	}
 }
 
@@ -189,13 +291,18 @@ libinput_timer_subsys_init(struct libinput *libinput)
 	if (libinput->timer.fd < 0)
 		return -1;
 
-	list_init(&libinput->timer.list);
+	libinput->timer.heap_len = 8;
+	libinput->timer.heap = zalloc(libinput->timer.heap_len *
+				      sizeof(*libinput->timer.heap));
+	libinput->timer.heap_count = 0;
 
 	libinput->timer.source = libinput_add_fd(libinput,
 						 libinput->timer.fd,
 						 libinput_timer_dispatch,
 						 libinput);
 	if (!libinput->timer.source) {
+		free(libinput->timer.heap);
+		libinput->timer.heap = NULL;
 		close(libinput->timer.fd);
 		return -1;
 	}
@@ -207,21 +314,19 @@ void
 libinput_timer_subsys_destroy(struct libinput *libinput)
 {
 #ifndef NDEBUG
-	if (!list_empty(&libinput->timer.list)) {
-		struct libinput_timer *t;
-
-		list_for_each(t, &libinput->timer.list, link) {
-			log_bug_libinput(libinput,
-					 "timer: %s still present on shutdown\n",
-					 t->timer_name);
-		}
+	for (size_t i = 0; i < libinput->timer.heap_count; i++) {
+		log_bug_libinput(libinput,
+				 "timer: %s still present on shutdown\n",
+				 libinput->timer.heap[i]->timer_name);
 	}
 #endif
 
 	/* All timer users should have destroyed their timers now */
-	assert(list_empty(&libinput->timer.list));
+	assert(libinput->timer.heap_count == 0);
 
 	libinput_remove_source(libinput, libinput->timer.source);
+	free(libinput->timer.heap);
+	libinput->timer.heap = NULL;
 	close(libinput->timer.fd);
 }
 
@@ -243,3 +348,18 @@ libinput_timer_flush(struct libinput *libinput, uint64_t now)
 
 	libinput_timer_handler(libinput, now);
 }
+
+/**
+ * Perform the timerfd rearm deferred by set/cancel calls made during
+ * dispatch. Must be called after every libinput_dispatch() cycle, once
+ * in_dispatch has been cleared.
+ */
+void
+libinput_timer_flush_deferred(struct libinput *libinput)
+{
+	if (!libinput->timer.rearm_pending)
+		return;
+
+	libinput->timer.rearm_pending = false;
+	libinput_timer_arm_timer_fd(libinput);
+}
@@ -33,7 +33,8 @@ struct libinput;
 struct libinput_timer {
 	struct libinput *libinput;
 	char *timer_name;
-	struct list link;
+	size_t heap_index; /* position in the context's timer min-heap,
+			      only valid while expire is nonzero */
 	uint64_t expire; /* in absolute us CLOCK_MONOTONIC */
 	void (*timer_func)(uint64_t now, void *timer_func_data);
 	void *timer_func_data;
@@ -55,6 +56,9 @@ libinput_timer_set(struct libinput_timer *timer, uint64_t expire);
 enum timer_flags {
 	TIMER_FLAG_NONE = 0,
 	TIMER_FLAG_ALLOW_NEGATIVE = (1 << 0),
+	/* offsets beyond 5s are a bug in the input paths, but e.g. the
+	   idle governor legitimately sleeps for minutes */
+	TIMER_FLAG_ALLOW_LONG = (1 << 1),
 };
 
 void
@@ -74,4 +78,7 @@ libinput_timer_subsys_destroy(struct libinput *libinput);
 void
 libinput_timer_flush(struct libinput *libinput, uint64_t now);
 
+void
+libinput_timer_flush_deferred(struct libinput *libinput);
+
 #endif
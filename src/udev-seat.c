@@ -24,6 +24,8 @@
 
 #include "config.h"
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -46,17 +48,22 @@ static inline bool
 filter_duplicates(struct udev_seat *udev_seat,
 		  struct udev_device *udev_device)
 {
-	struct libinput_device *device;
+	struct libinput_seat *seat;
 	const char *new_syspath = udev_device_get_syspath(udev_device);
 	bool ignore_device = false;
 
 	if (!udev_seat)
 		return false;
 
-	list_for_each(device, &udev_seat->base.devices_list, link) {
+	seat = &udev_seat->base;
+	for (size_t i = 0; i < seat->devices_len; i++) {
+		struct libinput_device *device = seat->devices[i];
 		const char *syspath;
 		struct udev_device *ud;
 
+		if (!device)
+			continue;
+
 		ud = libinput_device_get_udev_device(device);
 		if (!ud)
 			continue;
@@ -141,7 +148,7 @@ device_added(struct udev_device *udev_device,
 	evdev_read_calibration_prop(device);
 
 	output_name = udev_device_get_property_value(udev_device, "WL_OUTPUT");
-	device->output_name = safe_strdup(output_name);
+	device->output_name = libinput_intern_string(&input->base, output_name);
 
 	return 0;
 }
@@ -166,13 +173,129 @@ device_removed(struct udev_device *udev_device, struct udev_input *input)
 	}
 }
 
+/*
+ * Parallel enumeration: the expensive, per-device-independent part of
+ * device creation (open_restricted plus the libevdev init ioctls) is run
+ * in a small worker pool ahead of the serial device_added() loop, which
+ * then picks up the preopened fd and libevdev context from the stash.
+ *
+ * Opt-in via LIBINPUT_PARALLEL_ENUMERATION=<nthreads> because it calls
+ * open_restricted() from the worker threads: the caller's interface
+ * implementation must be thread-safe for this to be enabled.
+ */
+struct enum_probe_context {
+	struct libinput *libinput;
+	struct udev_device **devices;
+	size_t ndevices;
+	size_t next;		/* next device to probe, under lock */
+	pthread_mutex_t lock;	/* also guards the preopened stash */
+};
+
+static void *
+enum_probe_worker(void *data)
+{
+	struct enum_probe_context *ctx = data;
+
+	while (true) {
+		struct udev_device *udev_device;
+		struct libevdev *evdev;
+		const char *devnode;
+		size_t i;
+		int fd;
+
+		pthread_mutex_lock(&ctx->lock);
+		i = ctx->next++;
+		pthread_mutex_unlock(&ctx->lock);
+		if (i >= ctx->ndevices)
+			break;
+
+		udev_device = ctx->devices[i];
+		devnode = udev_device_get_devnode(udev_device);
+		if (!devnode || udev_device_should_be_ignored(udev_device))
+			continue;
+
+		fd = open_restricted(ctx->libinput, devnode,
+				     O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		if (!evdev_device_have_same_syspath(udev_device, fd)) {
+			close_restricted(ctx->libinput, fd);
+			continue;
+		}
+
+		evdev_drain_fd(fd);
+		if (libevdev_new_from_fd(fd, &evdev) != 0) {
+			close_restricted(ctx->libinput, fd);
+			continue;
+		}
+
+		pthread_mutex_lock(&ctx->lock);
+		libinput_stash_preopened_device(ctx->libinput,
+						devnode, fd, evdev);
+		pthread_mutex_unlock(&ctx->lock);
+	}
+
+	return NULL;
+}
+
+static void
+udev_input_probe_devices_parallel(struct udev_input *input,
+				  struct udev_device **devices,
+				  size_t ndevices,
+				  size_t nthreads)
+{
+	struct enum_probe_context ctx = {
+		.libinput = &input->base,
+		.devices = devices,
+		.ndevices = ndevices,
+		.next = 0,
+	};
+	pthread_t *threads;
+	size_t started = 0;
+
+	nthreads = min(nthreads, ndevices);
+
+	pthread_mutex_init(&ctx.lock, NULL);
+	threads = zalloc(nthreads * sizeof(*threads));
+	for (size_t i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL,
+				   enum_probe_worker, &ctx) != 0)
+			break;
+		started++;
+	}
+	for (size_t i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	pthread_mutex_destroy(&ctx.lock);
+}
+
+static size_t
+udev_parallel_enumeration_nthreads(void)
+{
+	const char *env = getenv("LIBINPUT_PARALLEL_ENUMERATION");
+	unsigned int nthreads;
+
+	if (!env || !safe_atou(env, &nthreads))
+		return 0;
+
+	return min(nthreads, 16U);
+}
+
 static int
 udev_input_add_devices(struct udev_input *input, struct udev *udev)
 {
 	struct udev_enumerate *e;
 	struct udev_list_entry *entry;
 	struct udev_device *device;
+	struct udev_device **devices = NULL;
+	size_t ndevices = 0, nalloc = 0;
 	const char *path, *sysname;
+	size_t nthreads;
+	struct libinput_phase_timing timing;
+	int rc = 0;
+
+	libinput_timing_start(&input->base, &timing);
 
 	e = udev_enumerate_new(udev);
 	udev_enumerate_add_match_subsystem(e, "input");
@@ -200,44 +323,165 @@ udev_input_add_devices(struct udev_input *input, struct udev *udev)
 			continue;
 		}
 
-		if (device_added(device, input, NULL) < 0) {
-			udev_device_unref(device);
-			udev_enumerate_unref(e);
-			return -1;
+		if (ndevices == nalloc) {
+			nalloc = max(nalloc * 2, 8U);
+			devices = realloc(devices,
+					  nalloc * sizeof(*devices));
+			if (!devices)
+				abort();
 		}
-
-		udev_device_unref(device);
+		devices[ndevices++] = device;
 	}
 	udev_enumerate_unref(e);
 
-	return 0;
+	nthreads = udev_parallel_enumeration_nthreads();
+	if (nthreads > 1 && ndevices > 1)
+		udev_input_probe_devices_parallel(input,
+						  devices,
+						  ndevices,
+						  nthreads);
+
+	for (size_t i = 0; i < ndevices; i++) {
+		if (rc == 0 && device_added(devices[i], input, NULL) < 0)
+			rc = -1;
+		udev_device_unref(devices[i]);
+	}
+	free(devices);
+
+	/* Anything device_added() didn't consume, e.g. because it failed
+	 * halfway through */
+	libinput_drop_preopened_devices(&input->base);
+
+	libinput_timing_log(&input->base, &timing, "udev-enumeration", NULL);
+
+	return rc;
 }
 
+/* Docking stations generate a dozen or more add/remove uevents in a
+ * burst, each of which would trigger full device probing interleaved
+ * with input dispatch. Queue the uevents for this long and process the
+ * batch from a timer instead, so already-open devices' input doesn't
+ * hitch behind repeated probing and a device that comes and goes within
+ * the window is never probed at all. */
+#define HOTPLUG_COALESCE_TIMEOUT ms2us(10)
+
+struct udev_hotplug_event {
+	struct list link; /* struct udev_input.hotplug_queue */
+	struct udev_device *udev_device;
+	bool is_add;
+};
+
 static void
-evdev_udev_handler(void *data)
+udev_input_drop_hotplug_events(struct udev_input *input)
+{
+	struct udev_hotplug_event *ev;
+
+	libinput_timer_cancel(&input->hotplug_timer);
+	input->hotplug_pending = false;
+
+	list_for_each_safe(ev, &input->hotplug_queue, link) {
+		list_remove(&ev->link);
+		udev_device_unref(ev->udev_device);
+		free(ev);
+	}
+}
+
+static void
+udev_input_hotplug_timer_func(uint64_t now, void *data)
 {
 	struct udev_input *input = data;
-	struct udev_device *udev_device;
-	const char *action;
+	struct udev_hotplug_event *ev;
 
-	udev_device = udev_monitor_receive_device(input->udev_monitor);
-	if (!udev_device)
-		return;
+	input->hotplug_pending = false;
 
-	action = udev_device_get_action(udev_device);
-	if (!action)
-		goto out;
+	/* Removals first: they free up already-open devices and never
+	 * block on probing */
+	list_for_each_safe(ev, &input->hotplug_queue, link) {
+		if (ev->is_add)
+			continue;
 
-	if (!strneq("event", udev_device_get_sysname(udev_device), 5))
-		goto out;
+		device_removed(ev->udev_device, input);
+		list_remove(&ev->link);
+		udev_device_unref(ev->udev_device);
+		free(ev);
+	}
 
-	if (streq(action, "add"))
-		device_added(udev_device, input, NULL);
-	else if (streq(action, "remove"))
-		device_removed(udev_device, input);
+	list_for_each_safe(ev, &input->hotplug_queue, link) {
+		device_added(ev->udev_device, input, NULL);
+		list_remove(&ev->link);
+		udev_device_unref(ev->udev_device);
+		free(ev);
+	}
+}
 
-out:
-	udev_device_unref(udev_device);
+static void
+udev_input_queue_hotplug_event(struct udev_input *input,
+			       struct udev_device *udev_device,
+			       bool is_add)
+{
+	struct udev_hotplug_event *ev;
+
+	if (!is_add) {
+		const char *syspath = udev_device_get_syspath(udev_device);
+
+		/* A remove cancelling out a queued add means the device
+		 * came and went within the window, drop both */
+		list_for_each(ev, &input->hotplug_queue, link) {
+			if (ev->is_add &&
+			    streq(syspath,
+				  udev_device_get_syspath(ev->udev_device))) {
+				list_remove(&ev->link);
+				udev_device_unref(ev->udev_device);
+				free(ev);
+				return;
+			}
+		}
+	}
+
+	ev = zalloc(sizeof(*ev));
+	ev->udev_device = udev_device_ref(udev_device);
+	ev->is_add = is_add;
+	list_append(&input->hotplug_queue, &ev->link);
+
+	/* Don't re-arm on subsequent events, that would push out
+	 * processing indefinitely during a long burst */
+	if (!input->hotplug_pending) {
+		libinput_timer_set(&input->hotplug_timer,
+				   libinput_now(&input->base) +
+					HOTPLUG_COALESCE_TIMEOUT);
+		input->hotplug_pending = true;
+	}
+}
+
+static void
+evdev_udev_handler(void *data)
+{
+	struct udev_input *input = data;
+	struct udev_device *udev_device;
+	const char *action;
+
+	/* drain the whole burst in one wakeup */
+	while ((udev_device =
+			udev_monitor_receive_device(input->udev_monitor))) {
+		action = udev_device_get_action(udev_device);
+		if (!action)
+			goto next;
+
+		if (!strneq("event",
+			    udev_device_get_sysname(udev_device), 5))
+			goto next;
+
+		if (streq(action, "add"))
+			udev_input_queue_hotplug_event(input,
+						       udev_device,
+						       true);
+		else if (streq(action, "remove"))
+			udev_input_queue_hotplug_event(input,
+						       udev_device,
+						       false);
+next:
+		udev_device_unref(udev_device);
+	}
 }
 
 static void
@@ -269,6 +513,7 @@ udev_input_disable(struct libinput *libinput)
 	libinput_remove_source(&input->base, input->udev_monitor_source);
 	input->udev_monitor_source = NULL;
 
+	udev_input_drop_hotplug_events(input);
 	udev_input_remove_devices(input);
 }
 
@@ -329,6 +574,8 @@ udev_input_destroy(struct libinput *input)
 	if (input == NULL)
 		return;
 
+	udev_input_drop_hotplug_events(udev_input);
+	libinput_timer_destroy(&udev_input->hotplug_timer);
 	udev_unref(udev_input->udev);
 	free(udev_input->seat_id);
 }
@@ -415,6 +662,13 @@ libinput_udev_create_context(const struct libinput_interface *interface,
 
 	input->udev = udev_ref(udev);
 
+	list_init(&input->hotplug_queue);
+	libinput_timer_init(&input->hotplug_timer,
+			    &input->base,
+			    "hotplug coalesce",
+			    udev_input_hotplug_timer_func,
+			    input);
+
 	return &input->base;
 }
 
@@ -28,6 +28,7 @@
 
 #include <libudev.h>
 #include "libinput-private.h"
+#include "timer.h"
 
 struct udev_seat {
 	struct libinput_seat base;
@@ -39,6 +40,11 @@ struct udev_input {
 	struct udev_monitor *udev_monitor;
 	struct libinput_source *udev_monitor_source;
 	char *seat_id;
+
+	/* Hotplug burst coalescing, see evdev_udev_handler() */
+	struct list hotplug_queue; /* struct udev_hotplug_event */
+	struct libinput_timer hotplug_timer;
+	bool hotplug_pending;
 };
 
 #endif
@@ -0,0 +1,359 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#if HAVE_URING
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+
+#include "libinput-private.h"
+#include "uring.h"
+
+/* Multishot poll needs 5.13, IORING_FEAT_SINGLE_MMAP is 5.4, so any
+ * kernel new enough for the former has the latter. */
+#ifndef IORING_POLL_ADD_MULTI
+#define IORING_POLL_ADD_MULTI (1U << 0)
+#endif
+#ifndef IORING_CQE_F_MORE
+#define IORING_CQE_F_MORE (1U << 1)
+#endif
+
+#define URING_NENTRIES 64
+
+/* One registration per fd source. CQEs carry a pointer to this record
+ * rather than to the source itself so that a stale completion arriving
+ * after libinput_remove_source() never dereferences a freed source.
+ */
+struct uring_poll {
+	struct list link;
+	struct libinput_source *source; /* NULL once the source was removed */
+};
+
+struct libinput_uring {
+	struct libinput *libinput;
+	int ring_fd;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned int *sq_head, *sq_tail, *sq_array;
+	unsigned int sq_mask, sq_entries;
+
+	void *cq_ring;
+	unsigned int *cq_head, *cq_tail;
+	struct io_uring_cqe *cqes;
+	unsigned int cq_mask;
+
+	struct list poll_list;
+};
+
+static int
+io_uring_setup(unsigned int entries, struct io_uring_params *params)
+{
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int
+io_uring_enter(int fd,
+	       unsigned int to_submit,
+	       unsigned int min_complete,
+	       unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter,
+		       fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+bool
+libinput_uring_requested(void)
+{
+	const char *env = getenv("LIBINPUT_USE_IO_URING");
+
+	return env && !streq(env, "0");
+}
+
+static struct io_uring_sqe *
+uring_next_sqe(struct libinput_uring *uring)
+{
+	unsigned int head, tail;
+	struct io_uring_sqe *sqe;
+
+	head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+	tail = *uring->sq_tail;
+	if (tail - head >= uring->sq_entries)
+		return NULL; /* SQ full, caller falls back/logs */
+
+	sqe = &uring->sqes[tail & uring->sq_mask];
+	memset(sqe, 0, sizeof *sqe);
+
+	return sqe;
+}
+
+static int
+uring_submit(struct libinput_uring *uring)
+{
+	unsigned int tail = *uring->sq_tail;
+
+	uring->sq_array[tail & uring->sq_mask] = tail & uring->sq_mask;
+	__atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	if (io_uring_enter(uring->ring_fd, 1, 0, 0) < 0)
+		return -errno;
+
+	return 0;
+}
+
+static int
+uring_submit_poll(struct libinput_uring *uring, struct uring_poll *poll)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_next_sqe(uring);
+	if (!sqe)
+		return -EBUSY;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = poll->source->fd;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->poll32_events = POLLIN;
+	sqe->user_data = (uintptr_t)poll;
+
+	return uring_submit(uring);
+}
+
+static void
+uring_cancel_poll(struct libinput_uring *uring, struct uring_poll *poll)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_next_sqe(uring);
+	if (!sqe)
+		return; /* the terminating CQE cleans up instead */
+
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = (uintptr_t)poll;
+	sqe->user_data = 0; /* completion for the cancel itself is ignored */
+
+	uring_submit(uring);
+}
+
+int
+libinput_uring_init(struct libinput *libinput)
+{
+	struct libinput_uring *uring;
+	struct io_uring_params params = {0};
+	int fd;
+
+	fd = io_uring_setup(URING_NENTRIES, &params);
+	if (fd < 0)
+		return -errno;
+
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+		close(fd);
+		return -ENOTSUP;
+	}
+
+	uring = zalloc(sizeof *uring);
+	uring->libinput = libinput;
+	uring->ring_fd = fd;
+	list_init(&uring->poll_list);
+
+	uring->sq_ring_size = max(params.sq_off.array +
+				  params.sq_entries * sizeof(unsigned int),
+				  params.cq_off.cqes +
+				  params.cq_entries * sizeof(struct io_uring_cqe));
+	uring->sq_ring = mmap(NULL, uring->sq_ring_size,
+			      PROT_READ|PROT_WRITE,
+			      MAP_SHARED|MAP_POPULATE,
+			      fd, IORING_OFF_SQ_RING);
+	if (uring->sq_ring == MAP_FAILED)
+		goto err;
+	uring->cq_ring = uring->sq_ring;
+
+	uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring->sqes = mmap(NULL, uring->sqes_size,
+			   PROT_READ|PROT_WRITE,
+			   MAP_SHARED|MAP_POPULATE,
+			   fd, IORING_OFF_SQES);
+	if (uring->sqes == MAP_FAILED)
+		goto err_sqes;
+
+	uring->sq_head = (unsigned int *)((char *)uring->sq_ring + params.sq_off.head);
+	uring->sq_tail = (unsigned int *)((char *)uring->sq_ring + params.sq_off.tail);
+	uring->sq_array = (unsigned int *)((char *)uring->sq_ring + params.sq_off.array);
+	uring->sq_mask = *(unsigned int *)((char *)uring->sq_ring + params.sq_off.ring_mask);
+	uring->sq_entries = params.sq_entries;
+
+	uring->cq_head = (unsigned int *)((char *)uring->cq_ring + params.cq_off.head);
+	uring->cq_tail = (unsigned int *)((char *)uring->cq_ring + params.cq_off.tail);
+	uring->cqes = (struct io_uring_cqe *)((char *)uring->cq_ring + params.cq_off.cqes);
+	uring->cq_mask = *(unsigned int *)((char *)uring->cq_ring + params.cq_off.ring_mask);
+
+	libinput->uring = uring;
+
+	return 0;
+
+err_sqes:
+	munmap(uring->sq_ring, uring->sq_ring_size);
+err:
+	close(fd);
+	free(uring);
+	return -ENOMEM;
+}
+
+void
+libinput_uring_destroy(struct libinput *libinput)
+{
+	struct libinput_uring *uring = libinput->uring;
+	struct uring_poll *poll;
+
+	if (!uring)
+		return;
+
+	list_for_each_safe(poll, &uring->poll_list, link)
+		free(poll);
+
+	munmap(uring->sqes, uring->sqes_size);
+	munmap(uring->sq_ring, uring->sq_ring_size);
+	close(uring->ring_fd);
+	free(uring);
+	libinput->uring = NULL;
+}
+
+int
+libinput_uring_get_fd(struct libinput *libinput)
+{
+	return libinput->uring->ring_fd;
+}
+
+int
+libinput_uring_add_source(struct libinput *libinput,
+			  struct libinput_source *source)
+{
+	struct libinput_uring *uring = libinput->uring;
+	struct uring_poll *poll;
+	int rc;
+
+	poll = zalloc(sizeof *poll);
+	poll->source = source;
+
+	rc = uring_submit_poll(uring, poll);
+	if (rc < 0) {
+		free(poll);
+		return rc;
+	}
+
+	list_insert(&uring->poll_list, &poll->link);
+
+	return 0;
+}
+
+void
+libinput_uring_remove_source(struct libinput *libinput,
+			     struct libinput_source *source)
+{
+	struct libinput_uring *uring = libinput->uring;
+	struct uring_poll *poll;
+
+	list_for_each(poll, &uring->poll_list, link) {
+		if (poll->source == source) {
+			/* The record is freed when its terminating CQE
+			 * arrives, see libinput_uring_dispatch() */
+			poll->source = NULL;
+			uring_cancel_poll(uring, poll);
+			return;
+		}
+	}
+}
+
+int
+libinput_uring_dispatch(struct libinput *libinput, uint64_t deadline)
+{
+	struct libinput_uring *uring = libinput->uring;
+	unsigned int head, tail;
+
+	head = *uring->cq_head;
+	tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+	while (head != tail) {
+		/* Unconsumed completions stay in the ring, the next
+		 * dispatch continues where this one left off */
+		if (deadline && libinput_clock_now(libinput) >= deadline)
+			return 1;
+
+		struct io_uring_cqe *cqe = &uring->cqes[head & uring->cq_mask];
+		struct uring_poll *poll = (struct uring_poll *)(uintptr_t)cqe->user_data;
+		bool more = cqe->flags & IORING_CQE_F_MORE;
+
+		head++;
+		/* publish consumption before dispatching, the handler may
+		 * recursively dispatch */
+		__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+		if (!poll) /* completion of a cancel request */
+			continue;
+
+		if (!more) {
+			list_remove(&poll->link);
+			if (poll->source && cqe->res >= 0) {
+				/* one-shot termination, e.g. pre-5.13
+				 * downgrade: re-arm */
+				if (libinput_uring_add_source(libinput,
+							      poll->source) < 0)
+					log_error(libinput,
+						  "io_uring: failed to re-arm poll\n");
+			}
+			if (poll->source && cqe->res >= 0 && cqe->res & POLLIN) {
+				struct libinput_source *source = poll->source;
+
+				free(poll);
+				if (source->fd != -1)
+					source->dispatch(source->user_data);
+			} else {
+				free(poll);
+			}
+			tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+			continue;
+		}
+
+		if (poll->source && poll->source->fd != -1 &&
+		    cqe->res >= 0 && cqe->res & POLLIN)
+			poll->source->dispatch(poll->source->user_data);
+
+		tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+	}
+
+	return 0;
+}
+
+#endif /* HAVE_URING */
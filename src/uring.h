@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include "config.h"
+
+#include <stdbool.h>
+
+struct libinput;
+struct libinput_source;
+
+/*
+ * Opt-in io_uring based dispatch backend. When enabled, all fd sources are
+ * registered as multishot polls on a single io_uring instance and
+ * libinput_dispatch() reaps completions from the mmap'd completion queue
+ * without a wait syscall. Enabled per-context via LIBINPUT_USE_IO_URING=1,
+ * falls back to the epoll path if the kernel lacks support.
+ */
+
+#if HAVE_URING
+
+bool
+libinput_uring_requested(void);
+
+int
+libinput_uring_init(struct libinput *libinput);
+
+void
+libinput_uring_destroy(struct libinput *libinput);
+
+int
+libinput_uring_get_fd(struct libinput *libinput);
+
+int
+libinput_uring_add_source(struct libinput *libinput,
+			  struct libinput_source *source);
+
+void
+libinput_uring_remove_source(struct libinput *libinput,
+			     struct libinput_source *source);
+
+int
+libinput_uring_dispatch(struct libinput *libinput, uint64_t deadline);
+
+#else /* HAVE_URING */
+
+static inline bool
+libinput_uring_requested(void)
+{
+	return false;
+}
+
+static inline int
+libinput_uring_init(struct libinput *libinput)
+{
+	return -1;
+}
+
+static inline void
+libinput_uring_destroy(struct libinput *libinput)
+{
+}
+
+static inline int
+libinput_uring_get_fd(struct libinput *libinput)
+{
+	return -1;
+}
+
+static inline int
+libinput_uring_add_source(struct libinput *libinput,
+			  struct libinput_source *source)
+{
+	return -1;
+}
+
+static inline void
+libinput_uring_remove_source(struct libinput *libinput,
+			     struct libinput_source *source)
+{
+}
+
+static inline int
+libinput_uring_dispatch(struct libinput *libinput, uint64_t deadline)
+{
+	return 0;
+}
+
+#endif /* HAVE_URING */
+
+#endif /* URING_H */
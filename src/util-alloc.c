@@ -0,0 +1,78 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "util-alloc.h"
+
+#if HAVE_ALLOC_STATS
+
+static struct alloc_tag_stats counters[_ALLOC_TAG_COUNT];
+static uint64_t nzallocs;
+
+/* Called from zalloc(), see util-strings.h */
+__attribute__((weak)) void
+alloc_note_zalloc(void)
+{
+	__atomic_add_fetch(&nzallocs, 1, __ATOMIC_RELAXED);
+}
+
+__attribute__((weak)) uint64_t
+alloc_zalloc_count(void)
+{
+	return __atomic_load_n(&nzallocs, __ATOMIC_RELAXED);
+}
+
+/* Weak so an LD_PRELOAD shim can interpose its own accounting */
+__attribute__((weak)) void
+alloc_account(enum alloc_tag tag, size_t size)
+{
+	struct alloc_tag_stats *c = &counters[tag];
+
+	__atomic_add_fetch(&c->nallocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&c->bytes, size, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&c->bytes_total, size, __ATOMIC_RELAXED);
+}
+
+__attribute__((weak)) void
+alloc_account_free(enum alloc_tag tag, size_t size)
+{
+	struct alloc_tag_stats *c = &counters[tag];
+
+	__atomic_add_fetch(&c->nfrees, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&c->bytes, size, __ATOMIC_RELAXED);
+}
+
+__attribute__((weak)) void
+alloc_get_stats(enum alloc_tag tag, struct alloc_tag_stats *stats)
+{
+	struct alloc_tag_stats *c = &counters[tag];
+
+	stats->nallocs = __atomic_load_n(&c->nallocs, __ATOMIC_RELAXED);
+	stats->nfrees = __atomic_load_n(&c->nfrees, __ATOMIC_RELAXED);
+	stats->bytes = __atomic_load_n(&c->bytes, __ATOMIC_RELAXED);
+	stats->bytes_total = __atomic_load_n(&c->bytes_total,
+					     __ATOMIC_RELAXED);
+}
+
+#endif /* HAVE_ALLOC_STATS */
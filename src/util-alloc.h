@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef UTIL_ALLOC_H
+#define UTIL_ALLOC_H
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util-strings.h"
+
+/*
+ * Opt-in allocation accounting (-Dalloc-stats=true), tagging the
+ * context-owned allocations by subsystem so allocator traffic seen in
+ * profiles can be attributed to a specific cache.
+ *
+ * Call sites pair alloc_account() with alloc_account_free() around
+ * their existing allocation calls; both compile to nothing in a
+ * default build. Counters are process-wide and cumulative, a consumer
+ * derives rates by sampling twice. When enabled, the accounting entry
+ * points are weak symbols so an LD_PRELOAD shim can interpose its own
+ * accounting without a rebuild.
+ */
+
+enum alloc_tag {
+	ALLOC_TAG_UNTAGGED = 0,
+	ALLOC_TAG_QUEUE,	/* event queue ring and priority lane */
+	ALLOC_TAG_EVENT_POOL,	/* slabs backing caller-visible events */
+	ALLOC_TAG_TOOL,		/* tablet tools, including recycled ones */
+	_ALLOC_TAG_COUNT,
+};
+
+struct alloc_tag_stats {
+	uint64_t nallocs;	/* cumulative */
+	uint64_t nfrees;	/* cumulative */
+	uint64_t bytes;		/* currently outstanding */
+	uint64_t bytes_total;	/* cumulative */
+};
+
+static inline const char *
+alloc_tag_name(enum alloc_tag tag)
+{
+	switch (tag) {
+	case ALLOC_TAG_UNTAGGED:
+		return "untagged";
+	case ALLOC_TAG_QUEUE:
+		return "queue";
+	case ALLOC_TAG_EVENT_POOL:
+		return "event-pool";
+	case ALLOC_TAG_TOOL:
+		return "tool";
+	case _ALLOC_TAG_COUNT:
+		break;
+	}
+	return "invalid";
+}
+
+#if HAVE_ALLOC_STATS
+
+void
+alloc_account(enum alloc_tag tag, size_t size);
+
+void
+alloc_account_free(enum alloc_tag tag, size_t size);
+
+void
+alloc_get_stats(enum alloc_tag tag, struct alloc_tag_stats *stats);
+
+/* Process-wide count of zalloc() calls, cumulative. Unlike the tagged
+ * counters above this covers every allocation routed through zalloc(),
+ * which is what makes it usable as a "nothing allocated in this
+ * window" probe, see the allocation watchdog in libinput.c */
+uint64_t
+alloc_zalloc_count(void);
+
+#else /* HAVE_ALLOC_STATS */
+
+static inline void
+alloc_account(enum alloc_tag tag, size_t size)
+{
+}
+
+static inline void
+alloc_account_free(enum alloc_tag tag, size_t size)
+{
+}
+
+static inline void
+alloc_get_stats(enum alloc_tag tag, struct alloc_tag_stats *stats)
+{
+	*stats = (struct alloc_tag_stats){0};
+}
+
+static inline uint64_t
+alloc_zalloc_count(void)
+{
+	return 0;
+}
+
+#endif /* HAVE_ALLOC_STATS */
+
+/* zalloc with the allocation attributed to the given tag */
+static inline void *
+zalloc_tagged(size_t size, enum alloc_tag tag)
+{
+	alloc_account(tag, size);
+
+	return zalloc(size);
+}
+
+#endif /* UTIL_ALLOC_H */
@@ -32,6 +32,7 @@
 #include <stddef.h>
 
 #define bit(x_) (1UL << (x_))
+#define bit64(x_) (1ULL << (x_))
 #define NBITS(b) (b * 8)
 #define LONG_BITS (sizeof(long) * 8)
 #define NLONGS(x) (((x) + LONG_BITS - 1) / LONG_BITS)
@@ -0,0 +1,154 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "util-time.h"
+
+/*
+ * Mutex wrapper with optional contention instrumentation, for validating
+ * the threaded paths before they go live. Build with -Dlock-stats=true
+ * to record, per lock, how many acquisitions found the lock already held
+ * and how long the waits took. The default build compiles every function
+ * here down to the bare pthread call, there is no way to enable the
+ * counters at runtime.
+ *
+ * Counters are only modified while the lock is held and must only be
+ * read via lock_get_stats(), which takes the lock.
+ */
+
+/* log2 microsecond buckets: bucket n counts waits of [2^n, 2^(n+1)) us,
+ * bucket 0 also covers sub-microsecond waits, the last bucket is
+ * open-ended (~32ms and up) */
+#define LOCK_STATS_NBUCKETS 16
+
+struct lock_stats {
+	uint64_t acquisitions;
+	uint64_t contentions;
+	uint64_t wait_hist[LOCK_STATS_NBUCKETS];
+};
+
+struct lock {
+	pthread_mutex_t mutex;
+#if HAVE_LOCK_STATS
+	struct lock_stats stats;
+#endif
+};
+
+static inline void
+lock_init(struct lock *lock)
+{
+	pthread_mutex_init(&lock->mutex, NULL);
+#if HAVE_LOCK_STATS
+	memset(&lock->stats, 0, sizeof(lock->stats));
+#endif
+}
+
+static inline void
+lock_destroy(struct lock *lock)
+{
+	pthread_mutex_destroy(&lock->mutex);
+}
+
+#if HAVE_LOCK_STATS
+static inline uint64_t
+lock_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return s2us(ts.tv_sec) + ns2us(ts.tv_nsec);
+}
+
+static inline void
+lock_acquire(struct lock *lock)
+{
+	uint64_t t0, waited;
+	unsigned int bucket;
+
+	if (pthread_mutex_trylock(&lock->mutex) == 0) {
+		lock->stats.acquisitions++;
+		return;
+	}
+
+	t0 = lock_now();
+	pthread_mutex_lock(&lock->mutex);
+	waited = lock_now() - t0;
+
+	lock->stats.acquisitions++;
+	lock->stats.contentions++;
+
+	bucket = 0;
+	while (waited >>= 1)
+		bucket++;
+	if (bucket >= LOCK_STATS_NBUCKETS)
+		bucket = LOCK_STATS_NBUCKETS - 1;
+	lock->stats.wait_hist[bucket]++;
+}
+#else
+static inline void
+lock_acquire(struct lock *lock)
+{
+	pthread_mutex_lock(&lock->mutex);
+}
+#endif
+
+static inline void
+lock_release(struct lock *lock)
+{
+	pthread_mutex_unlock(&lock->mutex);
+}
+
+/**
+ * pthread_cond_wait() with this lock as the mutex. The implicit
+ * re-acquisition on wakeup does not count as contention.
+ */
+static inline void
+lock_cond_wait(struct lock *lock, pthread_cond_t *cond)
+{
+	pthread_cond_wait(cond, &lock->mutex);
+}
+
+/**
+ * Copy out this lock's counters. In builds without lock-stats the
+ * counters are all zero.
+ */
+static inline void
+lock_get_stats(struct lock *lock, struct lock_stats *stats)
+{
+#if HAVE_LOCK_STATS
+	lock_acquire(lock);
+	*stats = lock->stats;
+	lock_release(lock);
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif
+}
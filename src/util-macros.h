@@ -59,3 +59,13 @@
 #define CASE_RETURN_STRING(a) case a: return #a
 
 #define _fallthrough_ __attribute__((fallthrough))
+
+/* Branch layout hints for the per-event hot paths. Only annotate
+ * branches with overwhelming skew, verified against the dispatch
+ * benchmark (test/benchmark-dispatch.c), not ordinary error checks. */
+#define likely(x_) __builtin_expect(!!(x_), 1)
+#define unlikely(x_) __builtin_expect(!!(x_), 0)
+
+/* Lays the function out in cold text so slow paths (logging, error
+ * handling) don't share cache lines with the event hot path */
+#define _cold_ __attribute__((cold))
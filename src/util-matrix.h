@@ -29,6 +29,7 @@
 
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <math.h>
 
 struct matrix {
@@ -107,6 +108,18 @@ matrix_is_identity(const struct matrix *m)
 		m->val[2][2] == 1);
 }
 
+static inline bool
+matrix_is_translate_only(const struct matrix *m)
+{
+	return (m->val[0][0] == 1 &&
+		m->val[0][1] == 0 &&
+		m->val[1][0] == 0 &&
+		m->val[1][1] == 1 &&
+		m->val[2][0] == 0 &&
+		m->val[2][1] == 0 &&
+		m->val[2][2] == 1);
+}
+
 static inline void
 matrix_mult(struct matrix *dest,
 	    const struct matrix *m1,
@@ -140,6 +153,39 @@ matrix_mult_vec(const struct matrix *m, int *x, int *y)
 	*y = ty;
 }
 
+/* 16.16 fixed-point mirror of the affine rows of a matrix, for
+ * applying a transform to integer coordinates without float math */
+struct matrix_fixed {
+	int32_t val[2][3]; /* [row][col], 16.16 */
+};
+
+static inline void
+matrix_to_fixed(struct matrix_fixed *dest, const struct matrix *src)
+{
+	int row, col;
+
+	for (row = 0; row < 2; row++)
+		for (col = 0; col < 3; col++)
+			dest->val[row][col] =
+				(int32_t)lroundf(src->val[row][col] * 65536.0f);
+}
+
+static inline void
+matrix_fixed_mult_vec(const struct matrix_fixed *m, int *x, int *y)
+{
+	int64_t tx, ty;
+
+	tx = (int64_t)*x * m->val[0][0] +
+	     (int64_t)*y * m->val[0][1] +
+	     m->val[0][2];
+	ty = (int64_t)*x * m->val[1][0] +
+	     (int64_t)*y * m->val[1][1] +
+	     m->val[1][2];
+
+	*x = (int)(tx >> 16);
+	*y = (int)(ty >> 16);
+}
+
 static inline void
 matrix_to_farray6(const struct matrix *m, float out[6])
 {
@@ -0,0 +1,136 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Bounded lock-free multi-producer single-consumer pointer ring, after
+ * Dmitry Vyukov's bounded MPMC queue. Any thread may push, exactly one
+ * thread may pop. The capacity must be a power of two.
+ *
+ * Each slot carries a sequence number: a slot is free for the producer
+ * claiming ticket t when its sequence equals t, and holds data for the
+ * consumer when it equals t + 1. Producers claim tickets with a CAS on
+ * head, fill the slot, then publish by bumping the slot sequence with a
+ * release store. The consumer never touches head.
+ */
+
+struct mpsc_ring_slot {
+	uint64_t sequence;
+	void *data;
+};
+
+struct mpsc_ring {
+	struct mpsc_ring_slot *slots;
+	uint64_t mask;
+	uint64_t head; /* producers only, atomic */
+	uint64_t tail; /* consumer only */
+};
+
+static inline void
+mpsc_ring_init(struct mpsc_ring *ring,
+	       struct mpsc_ring_slot *slots,
+	       uint64_t capacity)
+{
+	uint64_t i;
+
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+
+	ring->slots = slots;
+	ring->mask = capacity - 1;
+	ring->head = 0;
+	ring->tail = 0;
+
+	for (i = 0; i < capacity; i++)
+		ring->slots[i].sequence = i;
+}
+
+/**
+ * Push one pointer onto the ring. Safe to call from any thread.
+ *
+ * @return true on success, false if the ring is full
+ */
+static inline bool
+mpsc_ring_push(struct mpsc_ring *ring, void *data)
+{
+	struct mpsc_ring_slot *slot;
+	uint64_t pos, seq;
+
+	pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &ring->slots[pos & ring->mask];
+		seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+		if (seq == pos) {
+			if (__atomic_compare_exchange_n(&ring->head,
+							&pos, pos + 1,
+							true,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+			/* lost the race, pos was reloaded by the CAS */
+		} else if (seq < pos) {
+			/* slot not yet drained, ring is full */
+			return false;
+		} else {
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->data = data;
+	__atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/**
+ * Pop one pointer off the ring. Only ever call this from one thread.
+ *
+ * @return true with *data set on success, false if the ring is empty
+ */
+static inline bool
+mpsc_ring_pop(struct mpsc_ring *ring, void **data)
+{
+	struct mpsc_ring_slot *slot;
+	uint64_t seq;
+
+	slot = &ring->slots[ring->tail & ring->mask];
+	seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+	if (seq != ring->tail + 1)
+		return false;
+
+	*data = slot->data;
+	__atomic_store_n(&slot->sequence,
+			 ring->tail + ring->mask + 1,
+			 __ATOMIC_RELEASE);
+	ring->tail++;
+
+	return true;
+}
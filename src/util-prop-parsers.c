@@ -177,28 +177,26 @@ bool
 parse_calibration_property(const char *prop, float calibration_out[6])
 {
 	int idx;
-	char **strv;
+	char buf[256];
+	char *strv[8];
 	float calibration[6];
 
 	if (!prop)
 		return false;
 
-	strv = strv_from_string(prop, " ");
-	if (!strv)
+	if (strv_from_string_buf(prop, " ",
+				 strv, ARRAY_LENGTH(strv),
+				 buf, sizeof(buf)) < 6)
 		return false;
 
 	for (idx = 0; idx < 6; idx++) {
 		double v;
-		if (strv[idx] == NULL || !safe_atod(strv[idx], &v)) {
-			strv_free(strv);
+		if (!safe_atod(strv[idx], &v))
 			return false;
-		}
 
 		calibration[idx] = v;
 	}
 
-	strv_free(strv);
-
 	memcpy(calibration_out, calibration, sizeof(calibration));
 
 	return true;
@@ -366,23 +364,25 @@ parse_evcode_string(const char *s, int *type_out, int *code_out)
 bool
 parse_evcode_property(const char *prop, struct input_event *events, size_t *nevents)
 {
-	char **strv = NULL;
+	char buf[1024];
+	char *strv[34];
 	bool rc = false;
 	size_t ncodes = 0;
 	size_t idx;
+	int n;
 	/* A randomly chosen max so we avoid crazy quirks */
 	struct input_event evs[32];
 
 	memset(evs, 0, sizeof evs);
 
-	strv = strv_from_string(prop, ";");
-	if (!strv)
+	n = strv_from_string_buf(prop, ";",
+				 strv, ARRAY_LENGTH(strv),
+				 buf, sizeof(buf));
+	if (n <= 0)
 		goto out;
 
-	for (idx = 0; strv[idx]; idx++)
-		ncodes++;
-
-	if (ncodes == 0 || ncodes > ARRAY_LENGTH(evs))
+	ncodes = n;
+	if (ncodes > ARRAY_LENGTH(evs))
 		goto out;
 
 	ncodes = min(*nevents, ncodes);
@@ -414,7 +414,6 @@ parse_evcode_property(const char *prop, struct input_event *events, size_t *neve
 	rc = true;
 
 out:
-	strv_free(strv);
 	return rc;
 }
 
@@ -433,20 +432,22 @@ out:
 bool
 parse_input_prop_property(const char *prop, unsigned int *props_out, size_t *nprops)
 {
-	char **strv = NULL;
+	char buf[1024];
+	char *strv[INPUT_PROP_CNT + 2];
 	bool rc = false;
 	size_t count = 0;
 	size_t idx;
+	int n;
 	unsigned int props[INPUT_PROP_CNT]; /* doubling up on quirks is a bug */
 
-	strv = strv_from_string(prop, ";");
-	if (!strv)
+	n = strv_from_string_buf(prop, ";",
+				 strv, ARRAY_LENGTH(strv),
+				 buf, sizeof(buf));
+	if (n <= 0)
 		goto out;
 
-	for (idx = 0; strv[idx]; idx++)
-		count++;
-
-	if (count == 0 || count > ARRAY_LENGTH(props))
+	count = n;
+	if (count > ARRAY_LENGTH(props))
 		goto out;
 
 	count = min(*nprops, count);
@@ -471,7 +472,6 @@ parse_input_prop_property(const char *prop, unsigned int *props_out, size_t *npr
 	rc = true;
 
 out:
-	strv_free(strv);
 	return rc;
 }
 
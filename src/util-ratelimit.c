@@ -37,6 +37,9 @@ ratelimit_init(struct ratelimit *r, uint64_t ival_us, unsigned int burst)
 	r->begin = 0;
 	r->burst = burst;
 	r->num = 0;
+	r->num_suppressed = 0;
+	r->last_suppressed = 0;
+	r->total_suppressed = 0;
 }
 
 /*
@@ -64,10 +67,27 @@ ratelimit_test(struct ratelimit *r)
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	utime = s2us(ts.tv_sec) + ns2us(ts.tv_nsec);
 
-	if (r->begin <= 0 || r->begin + r->interval < utime) {
+	return ratelimit_test_time(r, utime);
+}
+
+/*
+ * Same as ratelimit_test() but uses a caller-provided CLOCK_MONOTONIC time
+ * in µs instead of reading the clock. Use this where the current time is
+ * already known (e.g. during event dispatching) to avoid the extra
+ * clock_gettime() on the hot path.
+ */
+enum ratelimit_state
+ratelimit_test_time(struct ratelimit *r, uint64_t now)
+{
+	if (r->interval <= 0 || r->burst <= 0)
+		return RATELIMIT_PASS;
+
+	if (r->begin <= 0 || r->begin + r->interval < now) {
 		/* reset counter */
-		r->begin = utime;
+		r->begin = now;
 		r->num = 1;
+		r->last_suppressed = r->num_suppressed;
+		r->num_suppressed = 0;
 		return RATELIMIT_PASS;
 	}
 
@@ -77,5 +97,8 @@ ratelimit_test(struct ratelimit *r)
 					      : RATELIMIT_PASS;
 	}
 
+	r->num_suppressed++;
+	r->total_suppressed++;
+
 	return RATELIMIT_EXCEEDED;
 }
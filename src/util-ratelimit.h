@@ -39,7 +39,11 @@ struct ratelimit {
 	uint64_t begin;
 	unsigned int burst;
 	unsigned int num;
+	uint64_t num_suppressed; /* suppressed in the current interval */
+	uint64_t last_suppressed; /* suppressed in the previous interval */
+	uint64_t total_suppressed; /* suppressed since ratelimit_init() */
 };
 
 void ratelimit_init(struct ratelimit *r, uint64_t ival_us, unsigned int burst);
 enum ratelimit_state ratelimit_test(struct ratelimit *r);
+enum ratelimit_state ratelimit_test_time(struct ratelimit *r, uint64_t now);
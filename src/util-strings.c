@@ -136,6 +136,50 @@ strv_from_string(const char *in, const char *separators)
 	return strv;
 }
 
+/**
+ * Split a string like strv_from_string(), but with all storage supplied
+ * by the caller: the tokens are copied into buf and the NULL-terminated
+ * pointer array into strv. Nothing to free afterwards, so hot parse
+ * paths can split into stack scratch instead of allocating.
+ *
+ * @param in Input string
+ * @param separators List of separator characters
+ * @param strv Caller-supplied pointer array, filled NULL-terminated
+ * @param strv_len Number of elements in strv, including the terminator
+ * @param buf Caller-supplied token storage
+ * @param buf_len Size of buf in bytes
+ *
+ * @return The number of tokens (possibly 0), or -1 if the tokens do not
+ * fit the supplied storage
+ */
+int
+strv_from_string_buf(const char *in, const char *separators,
+		     char **strv, size_t strv_len,
+		     char *buf, size_t buf_len)
+{
+	const char *s, *word;
+	size_t idx = 0, used = 0;
+	size_t l;
+
+	assert(in != NULL);
+	assert(strv_len > 0);
+
+	s = in;
+	while ((word = next_word(&s, &l, separators)) != NULL) {
+		if (idx + 1 >= strv_len || l + 1 > buf_len - used)
+			return -1;
+
+		memcpy(&buf[used], word, l);
+		buf[used + l] = '\0';
+		strv[idx++] = &buf[used];
+		used += l + 1;
+	}
+
+	strv[idx] = NULL;
+
+	return idx;
+}
+
 /**
  * Return a newly allocated string with all elements joined by the
  * joiner, same as Python's string.join() basically.
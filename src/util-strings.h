@@ -61,6 +61,12 @@ strneq(const char *str1, const char *str2, int n)
 	return str1 == str2;
 }
 
+#if HAVE_ALLOC_STATS
+/* Implemented in util-alloc.c, forward-declared here so this header
+ * need not pull in the accounting types */
+void alloc_note_zalloc(void);
+#endif
+
 static inline void *
 zalloc(size_t size)
 {
@@ -75,6 +81,10 @@ zalloc(size_t size)
 	if (!p)
 		abort();
 
+#if HAVE_ALLOC_STATS
+	alloc_note_zalloc();
+#endif
+
 	return p;
 }
 
@@ -254,6 +264,9 @@ safe_atod(const char *str, double *val)
 
 char **strv_from_argv(int argc, char **argv);
 char **strv_from_string(const char *in, const char *separator);
+int strv_from_string_buf(const char *in, const char *separators,
+			 char **strv, size_t strv_len,
+			 char *buf, size_t buf_len);
 char *strv_join(char **strv, const char *joiner);
 
 static inline void
@@ -33,6 +33,15 @@
 
 #include "util-macros.h"
 
+/* All time handling inside libinput uses a single timebase: 64-bit
+ * CLOCK_MONOTONIC microseconds. Conversions happen only at the
+ * boundaries - tv2us() when reading struct input_event from the kernel,
+ * us2tv()/timespec when talking to syscalls, us2ms() in the public
+ * *_get_time() API and in log messages. Do not store or pass around
+ * time in any other unit; ms2us() & friends exist so constants can be
+ * written in a readable unit and still resolve at compile time.
+ */
+
 static inline void
 msleep(unsigned int ms)
 {
@@ -0,0 +1,260 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Main-loop integration benchmark: feeds a 1kHz motion stream through a
+ * litest uinput mouse while calling libinput_dispatch() at compositor-like
+ * cadences - a steady 60Hz frame callback, a jittered one, and one with
+ * periodic stalls. For each cadence we report the queue depth at drain
+ * time, the age of the events when the caller finally sees them and the
+ * SYN_DROPPED count, as JSON like the hot-path benchmarks.
+ *
+ * Unlike those, this runs in wall-clock time against a real uinput
+ * device, so it needs root and takes a few seconds per scenario. The
+ * numbers are for comparing queueing behavior across revisions, not
+ * absolute latency guarantees.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "litest.h"
+#include "litest-int.h"
+
+/* 1kHz event stream, the rate of a common gaming mouse */
+#define EVENT_INTERVAL_US ms2us(1)
+#define FRAMES_PER_SCENARIO 240
+
+struct scenario {
+	const char *name;
+	uint64_t frame_interval;	/* dispatch cadence in µs */
+	uint64_t jitter;		/* max extra delay per frame in µs */
+	unsigned int stall_every;	/* stall every Nth frame, 0 for never */
+	uint64_t stall_length;		/* length of that stall in µs */
+};
+
+struct result {
+	uint64_t nevents;
+	uint64_t nframes;
+	size_t max_queue_depth;
+	uint64_t age_sum;		/* event age at drain, summed, in µs */
+	uint64_t max_age;
+	uint64_t syn_dropped;
+};
+
+/* devices are registered via the test_section, normally collected by the
+ * litest runner's main(). We build with LITEST_NO_MAIN, so walk the
+ * section ourselves. */
+extern struct list devices;
+extern const struct test_device __start_test_section, __stop_test_section;
+
+static void
+init_test_devices(void)
+{
+	const struct test_device *t;
+
+	list_init(&devices);
+
+	for (t = &__start_test_section; t < &__stop_test_section; t++)
+		list_append(&devices, &t->device->node);
+}
+
+static inline uint64_t
+benchmark_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return s2us(ts.tv_sec) + ns2us(ts.tv_nsec);
+}
+
+static void
+emit_motion_events(struct litest_device *dev, uint64_t duration)
+{
+	uint64_t remaining = duration;
+
+	while (remaining >= EVENT_INTERVAL_US) {
+		litest_event(dev, EV_REL, REL_X, 1);
+		litest_event(dev, EV_REL, REL_Y, -1);
+		litest_event(dev, EV_SYN, SYN_REPORT, 0);
+		usleep(EVENT_INTERVAL_US);
+		remaining -= EVENT_INTERVAL_US;
+	}
+
+	if (remaining)
+		usleep(remaining);
+}
+
+static void
+drain_and_measure(struct libinput *li, struct result *result)
+{
+	struct libinput_event *event;
+	size_t depth = 0;
+	uint64_t now;
+
+	libinput_dispatch(li);
+	now = benchmark_now();
+
+	while ((event = libinput_get_event(li)) != NULL) {
+		if (libinput_event_get_type(event) ==
+		    LIBINPUT_EVENT_POINTER_MOTION) {
+			struct libinput_event_pointer *ptrev;
+			uint64_t age, evtime;
+
+			ptrev = libinput_event_get_pointer_event(event);
+			evtime = libinput_event_pointer_get_time_usec(ptrev);
+			age = (now > evtime) ? now - evtime : 0;
+			result->age_sum += age;
+			result->max_age = max(result->max_age, age);
+		}
+		depth++;
+		libinput_event_destroy(event);
+	}
+
+	result->nevents += depth;
+	result->max_queue_depth = max(result->max_queue_depth, depth);
+}
+
+static void
+run_scenario(struct litest_device *dev,
+	     const struct scenario *scenario,
+	     struct result *result)
+{
+	struct libinput *li = dev->libinput;
+	uint64_t syn_dropped_before;
+
+	syn_dropped_before =
+		libinput_device_get_syn_dropped_count(dev->libinput_device);
+
+	for (unsigned int frame = 0; frame < FRAMES_PER_SCENARIO; frame++) {
+		uint64_t delay = scenario->frame_interval;
+
+		if (scenario->jitter)
+			delay += rand() % scenario->jitter;
+		if (scenario->stall_every &&
+		    (frame + 1) % scenario->stall_every == 0)
+			delay += scenario->stall_length;
+
+		emit_motion_events(dev, delay);
+		drain_and_measure(li, result);
+		result->nframes++;
+	}
+
+	result->syn_dropped =
+		libinput_device_get_syn_dropped_count(dev->libinput_device) -
+		syn_dropped_before;
+}
+
+static void
+print_result(const struct scenario *scenario,
+	     const struct result *result,
+	     bool last)
+{
+	printf("    {\n"
+	       "      \"name\": \"%s\",\n"
+	       "      \"frames\": %" PRIu64 ",\n"
+	       "      \"events\": %" PRIu64 ",\n"
+	       "      \"max_queue_depth\": %zu,\n"
+	       "      \"avg_age_us\": %.1f,\n"
+	       "      \"max_age_us\": %" PRIu64 ",\n"
+	       "      \"syn_dropped\": %" PRIu64 "\n"
+	       "    }%s\n",
+	       scenario->name,
+	       result->nframes,
+	       result->nevents,
+	       result->max_queue_depth,
+	       result->nevents ? (double)result->age_sum / result->nevents : 0.0,
+	       result->max_age,
+	       result->syn_dropped,
+	       last ? "" : ",");
+}
+
+int
+main(int argc, char **argv)
+{
+	const struct scenario scenarios[] = {
+		{
+			.name = "per-frame-60hz",
+			.frame_interval = ms2us(16) + 667,
+		},
+		{
+			.name = "jittered-60hz",
+			.frame_interval = ms2us(16) + 667,
+			.jitter = ms2us(8),
+		},
+		{
+			.name = "stalled-60hz",
+			.frame_interval = ms2us(16) + 667,
+			.stall_every = 30,
+			.stall_length = ms2us(150),
+		},
+	};
+	struct litest_device *dev;
+
+	if (getuid() != 0) {
+		fprintf(stderr,
+			"%s must be run as root.\n",
+			program_invocation_short_name);
+		return 77;
+	}
+
+	if (access("/dev/uinput", F_OK) == -1 &&
+	    access("/dev/input/uinput", F_OK) == -1) {
+		fprintf(stderr, "uinput device is missing, skipping.\n");
+		return 77;
+	}
+
+	setenv("LIBINPUT_RUNNING_TEST_SUITE", "1", 1);
+	setenv("LIBINPUT_QUIRKS_DIR", LIBINPUT_QUIRKS_SRCDIR, 0);
+	/* fixed seed, the jitter pattern must be reproducible */
+	srand(42);
+
+	init_test_devices();
+	dev = litest_create_device(LITEST_MOUSE);
+
+	printf("{\n"
+	       "  \"version\": 1,\n"
+	       "  \"benchmarks\": [\n");
+
+	for (size_t i = 0; i < ARRAY_LENGTH(scenarios); i++) {
+		struct result result = {0};
+
+		run_scenario(dev, &scenarios[i], &result);
+		print_result(&scenarios[i],
+			     &result,
+			     i == ARRAY_LENGTH(scenarios) - 1);
+	}
+
+	printf("  ]\n"
+	       "}\n");
+
+	litest_delete_device(dev);
+
+	return 0;
+}
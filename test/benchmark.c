@@ -0,0 +1,353 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Microbenchmarks for the per-event hot paths: the pointer acceleration
+ * filters, the lock-free post ring and the ratelimit checks. Run via
+ * "meson test --benchmark" (or "ninja benchmark"); the results are
+ * printed as JSON so CI can archive and compare them across revisions.
+ *
+ * These are throughput numbers for synthetic event streams, not
+ * end-to-end latency. They exist to catch relative regressions, absolute
+ * values depend on the machine they ran on.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "filter.h"
+#include "util-mpsc-ring.h"
+#include "util-ratelimit.h"
+#include "util-time.h"
+
+/* Sink for benchmark results so the compiler cannot discard the loops */
+static volatile double sink;
+
+static inline uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Feed a synthetic 1000Hz motion stream through one accel filter.
+ * The deltas sweep through a range of speeds so the different curve
+ * segments all get exercised. */
+static uint64_t
+bench_filter(struct motion_filter *filter, double speed, uint64_t iterations)
+{
+	uint64_t time = s2us(1);
+	uint64_t start, stop;
+
+	filter_set_speed(filter, speed);
+
+	start = now_ns();
+	for (uint64_t i = 0; i < iterations; i++) {
+		struct device_float_coords delta = {
+			.x = (double)(i % 27) - 13.0,
+			.y = (double)(i % 11) - 5.0,
+		};
+		struct normalized_coords accel;
+
+		accel = filter_dispatch(filter, &delta, NULL, time);
+		sink += accel.x + accel.y;
+		time += ms2us(1);
+	}
+	stop = now_ns();
+
+	filter_destroy(filter);
+
+	return stop - start;
+}
+
+static uint64_t
+bench_mpsc_ring(uint64_t iterations)
+{
+	struct mpsc_ring_slot slots[1024];
+	struct mpsc_ring ring;
+	uint64_t start, stop;
+	void *data;
+
+	mpsc_ring_init(&ring, slots, ARRAY_LENGTH(slots));
+
+	/* one push/pop pair per iteration, the ring never fills */
+	start = now_ns();
+	for (uint64_t i = 0; i < iterations; i++) {
+		mpsc_ring_push(&ring, &ring);
+		mpsc_ring_pop(&ring, &data);
+		sink += (data == &ring);
+	}
+	stop = now_ns();
+
+	return stop - start;
+}
+
+/* Mirrors the tablet history ring, i.e. tablet_history_push() +
+ * tablet_smoothen_axes() in evdev-tablet.c, kept in sync by hand. It
+ * exists to put a number on the per-event smoothing cost, which is
+ * constant in the window depth thanks to the running sums. */
+static uint64_t
+bench_tablet_smoothing(uint64_t iterations)
+{
+	struct sample {
+		int x, y;
+		double tx, ty;
+	} ring[16] = { 0 };
+	const size_t depth = ARRAY_LENGTH(ring);
+	int64_t sum_x = 0, sum_y = 0;
+	double sum_tx = 0, sum_ty = 0;
+	size_t index = 0;
+	uint64_t start, stop;
+
+	start = now_ns();
+	for (uint64_t i = 0; i < iterations; i++) {
+		struct sample s = {
+			.x = (int)(i % 1920),
+			.y = (int)(i % 1080),
+			.tx = (double)(i % 128) - 64.0,
+			.ty = (double)(i % 64) - 32.0,
+		};
+
+		index = (index + 1) % depth;
+		sum_x += s.x - ring[index].x;
+		sum_y += s.y - ring[index].y;
+		sum_tx += s.tx - ring[index].tx;
+		sum_ty += s.ty - ring[index].ty;
+		ring[index] = s;
+
+		sink += (double)(sum_x/(int64_t)depth) +
+			(double)(sum_y/(int64_t)depth) +
+			sum_tx/depth +
+			sum_ty/depth;
+	}
+	stop = now_ns();
+
+	return stop - start;
+}
+
+/* Mirrors tp_thumb_compile_jail_table()/tp_thumb_needs_jail() in
+ * evdev-mt-touchpad-thumb.c, kept in sync by hand. Replays a
+ * pseudo-random touch stream through the chained heuristics and the
+ * compiled table for every device configuration, asserting both agree,
+ * then times the table path. */
+static bool
+thumb_jail_reference(bool edge,
+		     bool have_hw,
+		     unsigned int bits,
+		     unsigned int speed_exceeded)
+{
+	bool below_upper = bits & 0x1;
+	bool below_lower = bits & 0x2;
+	bool pressure_size = bits & 0x4;
+
+	if (!below_upper || edge)
+		return false;
+
+	if (!(below_lower && !edge) && have_hw && !pressure_size)
+		return false;
+
+	if (speed_exceeded >= 10)
+		return false;
+
+	return true;
+}
+
+static uint8_t
+thumb_jail_compile(bool edge, bool have_hw)
+{
+	uint8_t table = 0;
+
+	for (unsigned int bits = 0; bits < 8; bits++) {
+		bool below_upper = bits & 0x1;
+		bool below_lower = bits & 0x2;
+		bool pressure_size = bits & 0x4;
+		bool excluded = below_lower && !edge;
+
+		if (below_upper && !edge &&
+		    (excluded || !have_hw || pressure_size))
+			table |= 1 << bits;
+	}
+
+	return table;
+}
+
+static inline uint32_t
+xorshift32(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+}
+
+static uint64_t
+bench_thumb_jail(uint64_t iterations)
+{
+	uint32_t rng = 0x12345678;
+	uint8_t table;
+	uint64_t start, stop;
+
+	/* Accuracy: table and chained heuristics must agree on every
+	   sample of the replay stream, in every configuration */
+	for (unsigned int config = 0; config < 4; config++) {
+		bool edge = config & 0x1;
+		bool have_hw = config & 0x2;
+
+		table = thumb_jail_compile(edge, have_hw);
+		for (unsigned int i = 0; i < 4096; i++) {
+			uint32_t r = xorshift32(&rng);
+			unsigned int bits = r & 0x7;
+			unsigned int speed_exceeded = (r >> 3) % 12;
+			bool jailed = speed_exceeded < 10 &&
+				      ((table >> bits) & 0x1);
+
+			assert(jailed == thumb_jail_reference(edge,
+							      have_hw,
+							      bits,
+							      speed_exceeded));
+		}
+	}
+
+	table = thumb_jail_compile(false, true);
+
+	start = now_ns();
+	for (uint64_t i = 0; i < iterations; i++) {
+		uint32_t r = xorshift32(&rng);
+		unsigned int speed_exceeded = (r >> 3) % 12;
+
+		sink += speed_exceeded < 10 && ((table >> (r & 0x7)) & 0x1);
+	}
+	stop = now_ns();
+
+	return stop - start;
+}
+
+static uint64_t
+bench_ratelimit(uint64_t iterations)
+{
+	struct ratelimit rl;
+	uint64_t time = s2us(1);
+	uint64_t start, stop;
+
+	ratelimit_init(&rl, s2us(2), 5);
+
+	start = now_ns();
+	for (uint64_t i = 0; i < iterations; i++) {
+		sink += ratelimit_test_time(&rl, time);
+		time += ms2us(1);
+	}
+	stop = now_ns();
+
+	return stop - start;
+}
+
+static void
+print_result(const char *name,
+	     uint64_t iterations,
+	     uint64_t total_ns,
+	     bool last)
+{
+	printf("    {\n"
+	       "      \"name\": \"%s\",\n"
+	       "      \"iterations\": %" PRIu64 ",\n"
+	       "      \"total_ns\": %" PRIu64 ",\n"
+	       "      \"ns_per_op\": %.2f\n"
+	       "    }%s\n",
+	       name,
+	       iterations,
+	       total_ns,
+	       (double)total_ns / iterations,
+	       last ? "" : ",");
+}
+
+int
+main(int argc, char **argv)
+{
+	const uint64_t iterations = 1000000;
+	struct {
+		const char *name;
+		struct motion_filter *filter;
+		double speed;
+	} filters[] = {
+		{ "filter-flat",
+		  create_pointer_accelerator_filter_flat(1000), 0.0 },
+		{ "filter-linear",
+		  create_pointer_accelerator_filter_linear(1000, false), 0.0 },
+		{ "filter-touchpad",
+		  create_pointer_accelerator_filter_touchpad(1000, 0, 0, false),
+		  0.0 },
+		/* the trackpoint profile folds its speed setting into
+		 * constants, so cover both ends of the range */
+		{ "filter-trackpoint-slow",
+		  create_pointer_accelerator_filter_trackpoint(1.0, false),
+		  -0.75 },
+		{ "filter-trackpoint",
+		  create_pointer_accelerator_filter_trackpoint(1.0, false),
+		  0.0 },
+		{ "filter-trackpoint-fast",
+		  create_pointer_accelerator_filter_trackpoint(1.0, false),
+		  0.75 },
+	};
+
+	printf("{\n"
+	       "  \"version\": 1,\n"
+	       "  \"benchmarks\": [\n");
+
+	for (size_t i = 0; i < ARRAY_LENGTH(filters); i++) {
+		uint64_t ns = bench_filter(filters[i].filter,
+					   filters[i].speed,
+					   iterations);
+		print_result(filters[i].name, iterations, ns, false);
+	}
+
+	print_result("mpsc-ring",
+		     iterations,
+		     bench_mpsc_ring(iterations),
+		     false);
+	print_result("tablet-smoothing",
+		     iterations,
+		     bench_tablet_smoothing(iterations),
+		     false);
+	print_result("thumb-jail",
+		     iterations,
+		     bench_thumb_jail(iterations),
+		     false);
+	print_result("ratelimit",
+		     iterations,
+		     bench_ratelimit(iterations),
+		     true);
+
+	printf("  ]\n"
+	       "}\n");
+
+	return 0;
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Latency regression gate: replays a deterministic 1kHz motion stream
+ * through a full context and compares the per-stage latency histograms
+ * (libinput_device_get_latency_stats()) against the checked-in
+ * baselines in latency-baselines.conf.
+ *
+ * Thresholds are histogram bucket indices, i.e. power-of-two
+ * microsecond bounds. That keeps the gate robust against machine
+ * differences - a regression has to roughly double a stage's p95
+ * latency to trip it - while still catching the order-of-magnitude
+ * stalls that matter. Slow CI machines can widen the gate via the
+ * slack_buckets baseline value or the LIBINPUT_LATENCY_SLACK
+ * environment variable.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "litest.h"
+#include "litest-int.h"
+
+/* 1kHz event stream, dispatched and drained every other event so the
+ * post-to-drain stage measures libinput, not the test's cadence */
+#define EVENT_INTERVAL_US ms2us(1)
+#define NEVENTS 2000
+
+struct baselines {
+	int kernel_to_post_p95;	/* max allowed p95 bucket per stage */
+	int post_to_drain_p95;
+	int slack_buckets;	/* extra buckets allowed on top */
+};
+
+/* devices are registered via the test_section, normally collected by the
+ * litest runner's main(). We build with LITEST_NO_MAIN, so walk the
+ * section ourselves. */
+extern struct list devices;
+extern const struct test_device __start_test_section, __stop_test_section;
+
+static void
+init_test_devices(void)
+{
+	const struct test_device *t;
+
+	list_init(&devices);
+
+	for (t = &__start_test_section; t < &__stop_test_section; t++)
+		list_append(&devices, &t->device->node);
+}
+
+static bool
+parse_baselines(const char *path, struct baselines *b)
+{
+	FILE *fp;
+	char line[256];
+	bool rc = true;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "Failed to open baselines %s: %s\n",
+			path, strerror(errno));
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		char key[64];
+		int value;
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if (sscanf(line, " %63[a-z_0-9] = %d", key, &value) != 2) {
+			fprintf(stderr, "Invalid baseline line: %s", line);
+			rc = false;
+			break;
+		}
+
+		if (streq(key, "kernel_to_post_p95_bucket"))
+			b->kernel_to_post_p95 = value;
+		else if (streq(key, "post_to_drain_p95_bucket"))
+			b->post_to_drain_p95 = value;
+		else if (streq(key, "slack_buckets"))
+			b->slack_buckets = value;
+		else {
+			fprintf(stderr, "Unknown baseline key: %s\n", key);
+			rc = false;
+			break;
+		}
+	}
+
+	fclose(fp);
+
+	return rc;
+}
+
+/* Smallest bucket index covering 95% of the events. Buckets count
+ * latencies below 2^n µs, so the index doubles as an upper bound. */
+static int
+p95_bucket(const uint64_t *buckets)
+{
+	uint64_t total = 0, cumulative = 0;
+
+	for (int i = 0; i < LIBINPUT_LATENCY_NBUCKETS; i++)
+		total += buckets[i];
+
+	if (total == 0)
+		return 0;
+
+	for (int i = 0; i < LIBINPUT_LATENCY_NBUCKETS; i++) {
+		cumulative += buckets[i];
+		if (cumulative * 100 >= total * 95)
+			return i;
+	}
+
+	return LIBINPUT_LATENCY_NBUCKETS - 1;
+}
+
+static bool
+check_stage(const char *stage, int measured, int allowed, int slack)
+{
+	bool ok = measured <= allowed + slack;
+
+	fprintf(stderr,
+		"%-14s: p95 bucket %2d (<%" PRIu64 "us), allowed %d+%d -- %s\n",
+		stage,
+		measured,
+		(uint64_t)1 << measured,
+		allowed,
+		slack,
+		ok ? "ok" : "REGRESSION");
+
+	return ok;
+}
+
+static void
+replay_stream(struct litest_device *dev)
+{
+	struct libinput *li = dev->libinput;
+	struct libinput_event *event;
+
+	for (unsigned int i = 0; i < NEVENTS; i++) {
+		litest_event(dev, EV_REL, REL_X, 1);
+		litest_event(dev, EV_REL, REL_Y, -1);
+		litest_event(dev, EV_SYN, SYN_REPORT, 0);
+		usleep(EVENT_INTERVAL_US);
+
+		if (i % 2 == 0)
+			continue;
+
+		libinput_dispatch(li);
+		while ((event = libinput_get_event(li)) != NULL)
+			libinput_event_destroy(event);
+	}
+
+	libinput_dispatch(li);
+	while ((event = libinput_get_event(li)) != NULL)
+		libinput_event_destroy(event);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct baselines baselines = {
+		.kernel_to_post_p95 = LIBINPUT_LATENCY_NBUCKETS - 1,
+		.post_to_drain_p95 = LIBINPUT_LATENCY_NBUCKETS - 1,
+		.slack_buckets = 0,
+	};
+	struct libinput_latency_stats stats;
+	struct litest_device *dev;
+	const char *slack_env;
+	bool ok = true;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <latency-baselines.conf>\n",
+			program_invocation_short_name);
+		return 1;
+	}
+
+	if (getuid() != 0) {
+		fprintf(stderr,
+			"%s must be run as root.\n",
+			program_invocation_short_name);
+		return 77;
+	}
+
+	if (access("/dev/uinput", F_OK) == -1 &&
+	    access("/dev/input/uinput", F_OK) == -1) {
+		fprintf(stderr, "uinput device is missing, skipping.\n");
+		return 77;
+	}
+
+	if (!parse_baselines(argv[1], &baselines))
+		return 1;
+
+	slack_env = getenv("LIBINPUT_LATENCY_SLACK");
+	if (slack_env)
+		baselines.slack_buckets = atoi(slack_env);
+
+	setenv("LIBINPUT_RUNNING_TEST_SUITE", "1", 1);
+	setenv("LIBINPUT_QUIRKS_DIR", LIBINPUT_QUIRKS_SRCDIR, 0);
+	/* must be set before the context is created */
+	setenv("LIBINPUT_LATENCY_STATS", "1", 1);
+
+	init_test_devices();
+	dev = litest_create_device(LITEST_MOUSE);
+
+	replay_stream(dev);
+
+	if (libinput_device_get_latency_stats(dev->libinput_device,
+					      &stats) != 0) {
+		fprintf(stderr, "Latency stats are not enabled\n");
+		litest_delete_device(dev);
+		return 1;
+	}
+
+	fprintf(stderr, "%" PRIu64 " events measured\n", stats.nevents);
+
+	ok &= check_stage("kernel-to-post",
+			  p95_bucket(stats.kernel_to_post),
+			  baselines.kernel_to_post_p95,
+			  baselines.slack_buckets);
+	ok &= check_stage("post-to-drain",
+			  p95_bucket(stats.post_to_drain),
+			  baselines.post_to_drain_p95,
+			  baselines.slack_buckets);
+
+	litest_delete_device(dev);
+
+	return ok ? 0 : 1;
+}
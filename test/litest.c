@@ -31,6 +31,7 @@
 #include <fcntl.h>
 #include <fnmatch.h>
 #include <getopt.h>
+#include <limits.h>
 #include <poll.h>
 #include <signal.h>
 #include <stdint.h>
@@ -43,6 +44,7 @@
 #include <sys/ptrace.h>
 #include <sys/resource.h>
 #include <sys/timerfd.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -260,6 +262,9 @@ struct suite {
 
 static struct litest_device *current_device;
 
+static void
+litest_device_pool_drain(void);
+
 struct litest_device *litest_current_device(void)
 {
 	return current_device;
@@ -1123,6 +1128,7 @@ out:
 		free(n);
 	}
 
+	litest_device_pool_drain();
 	quirks_context_unref(quirks_context);
 
 	return failed;
@@ -1611,6 +1617,112 @@ litest_remove_udev_rules(struct list *created_files_list)
 		litest_reload_udev_rules();
 }
 
+/* Pool of idle uinput devices, keyed by device type. uinput creation and
+ * the udev add/remove round-trips dominate suite wallclock, so with
+ * LITEST_REUSE_DEVICES set, devices created without overrides go back to
+ * this pool on delete instead of being destroyed. Requires CK_FORK=no
+ * (set up in main()) so the runner process survives across cases; the
+ * per-shard forks in litest_fork_subtests() still isolate crashes.
+ * Tests are expected to release the buttons/touches they press; pending
+ * events are drained before a device is handed out again. */
+struct pooled_device {
+	struct list node;
+	struct litest_device *device;
+};
+
+static struct list device_pool;
+static bool device_pool_active;
+
+static bool
+litest_device_pool_enabled(void)
+{
+	static int enabled = -1;
+
+	if (enabled == -1) {
+		enabled = getenv("LITEST_REUSE_DEVICES") != NULL;
+		if (enabled) {
+			list_init(&device_pool);
+			device_pool_active = true;
+		}
+	}
+
+	return enabled;
+}
+
+static struct litest_device *
+litest_device_pool_get(enum litest_device_type which)
+{
+	struct pooled_device *p;
+
+	if (!litest_device_pool_enabled())
+		return NULL;
+
+	list_for_each(p, &device_pool, node) {
+		if (p->device->which == which) {
+			struct litest_device *d = p->device;
+
+			list_remove(&p->node);
+			free(p);
+			return d;
+		}
+	}
+
+	return NULL;
+}
+
+static bool
+litest_device_pool_put(struct litest_device *d)
+{
+	struct pooled_device *p;
+	struct input_event ev;
+
+	if (!litest_device_pool_enabled() || !d->pool_eligible)
+		return false;
+
+	/* discard whatever the test left unread so the next case starts
+	 * from silence */
+	while (read(libevdev_get_fd(d->evdev), &ev, sizeof(ev)) ==
+	       (int)sizeof(ev))
+		;
+
+	/* keep the kernel-side device, reset the per-test state */
+	*d = (struct litest_device) {
+		.which = d->which,
+		.evdev = d->evdev,
+		.uinput = d->uinput,
+		.interface = d->interface,
+		.semi_mt.is_semi_mt = d->semi_mt.is_semi_mt,
+		.pool_eligible = true,
+	};
+
+	p = zalloc(sizeof(*p));
+	p->device = d;
+	list_insert(&device_pool, &p->node);
+
+	return true;
+}
+
+static void
+litest_device_pool_drain(void)
+{
+	struct pooled_device *p;
+
+	if (!device_pool_active)
+		return;
+
+	/* Process teardown, no need to wait for the udev remove events */
+	list_for_each_safe(p, &device_pool, node) {
+		struct litest_device *d = p->device;
+
+		close(libevdev_get_fd(d->evdev));
+		libevdev_free(d->evdev);
+		libevdev_uinput_destroy(d->uinput);
+		free(d);
+		free(p);
+	}
+	device_pool_active = false;
+}
+
 /**
  * Creates a uinput device but does not add it to a libinput context
  */
@@ -1642,8 +1754,18 @@ litest_create(enum litest_device_type which,
 	if (!found)
 		ck_abort_msg("Invalid device type %d\n", which);
 
+	if (!name_override && !id_override &&
+	    !abs_override && !events_override) {
+		d = litest_device_pool_get(which);
+		if (d)
+			return d;
+	}
+
 	d = zalloc(sizeof(*d));
 	d->which = which;
+	d->pool_eligible = !dev->create &&
+			   !name_override && !id_override &&
+			   !abs_override && !events_override;
 
 	/* device has custom create method */
 	if (dev->create) {
@@ -1918,11 +2040,6 @@ litest_delete_device(struct litest_device *d)
 	if (!d)
 		return;
 
-	udev_monitor = udev_setup_monitor();
-	snprintf(path, sizeof(path),
-		 "%s/event",
-		 libevdev_uinput_get_syspath(d->uinput));
-
 	litest_assert_int_eq(d->skip_ev_syn, 0);
 
 	quirks_unref(d->quirks);
@@ -1935,6 +2052,16 @@ litest_delete_device(struct litest_device *d)
 		libinput_dispatch(d->libinput);
 		litest_destroy_context(d->libinput);
 	}
+
+	/* the kernel device may live on for the next case */
+	if (litest_device_pool_put(d))
+		return;
+
+	udev_monitor = udev_setup_monitor();
+	snprintf(path, sizeof(path),
+		 "%s/event",
+		 libevdev_uinput_get_syspath(d->uinput));
+
 	close(libevdev_get_fd(d->evdev));
 	libevdev_free(d->evdev);
 	libevdev_uinput_destroy(d->uinput);
@@ -1965,6 +2092,103 @@ litest_event(struct litest_device *d, unsigned int type,
 	litest_assert_int_eq(ret, 0);
 }
 
+void
+litest_event_batch(struct litest_device *d,
+		   const struct input_event *events,
+		   size_t nevents)
+{
+	struct input_event *accepted;
+	struct iovec *iov;
+	size_t naccepted = 0,
+	       iovcnt = 0,
+	       frame_start = 0,
+	       i;
+	int fd = libevdev_uinput_get_fd(d->uinput);
+
+	accepted = zalloc(nevents * sizeof(*accepted));
+	/* worst case: every event is its own frame */
+	iov = zalloc(nevents * sizeof(*iov));
+
+	for (i = 0; i < nevents; i++) {
+		const struct input_event *ev = &events[i];
+
+		if (!libevdev_has_event_code(d->evdev, ev->type, ev->code))
+			continue;
+
+		if (d->skip_ev_syn &&
+		    ev->type == EV_SYN &&
+		    ev->code == SYN_REPORT)
+			continue;
+
+		accepted[naccepted++] = *ev;
+
+		if (ev->type == EV_SYN && ev->code == SYN_REPORT) {
+			iov[iovcnt].iov_base = &accepted[frame_start];
+			iov[iovcnt].iov_len = (naccepted - frame_start) *
+					      sizeof(*accepted);
+			iovcnt++;
+			frame_start = naccepted;
+		}
+	}
+
+	/* any trailing partial frame goes out as-is */
+	if (naccepted > frame_start) {
+		iov[iovcnt].iov_base = &accepted[frame_start];
+		iov[iovcnt].iov_len = (naccepted - frame_start) *
+				      sizeof(*accepted);
+		iovcnt++;
+	}
+
+	for (i = 0; i < iovcnt; i += IOV_MAX) {
+		size_t cnt = iovcnt - i;
+		size_t expected = 0,
+		       j;
+		ssize_t rc;
+
+		if (cnt > IOV_MAX)
+			cnt = IOV_MAX;
+
+		for (j = i; j < i + cnt; j++)
+			expected += iov[j].iov_len;
+
+		rc = writev(fd, &iov[i], cnt);
+		litest_assert_int_eq(rc, (ssize_t)expected);
+	}
+
+	free(iov);
+	free(accepted);
+}
+
+void
+litest_rel_motion_stream(struct litest_device *d,
+			 int dx, int dy,
+			 int nframes)
+{
+	struct input_event *events;
+	size_t nevents = 0;
+	int i;
+
+	events = zalloc(3 * nframes * sizeof(*events));
+
+	for (i = 0; i < nframes; i++) {
+		events[nevents].type = EV_REL;
+		events[nevents].code = REL_X;
+		events[nevents].value = dx;
+		nevents++;
+		events[nevents].type = EV_REL;
+		events[nevents].code = REL_Y;
+		events[nevents].value = dy;
+		nevents++;
+		events[nevents].type = EV_SYN;
+		events[nevents].code = SYN_REPORT;
+		events[nevents].value = 0;
+		nevents++;
+	}
+
+	litest_event_batch(d, events, nevents);
+	free(events);
+}
+
 static bool
 axis_replacement_value(struct litest_device *d,
 		       struct axis_replacement *axes,
@@ -3083,6 +3307,9 @@ litest_event_type_str(enum libinput_event_type type)
 	case LIBINPUT_EVENT_DEVICE_REMOVED:
 		str = "REMOVED";
 		break;
+	case LIBINPUT_EVENT_DEVICE_CONFIG_CHANGED:
+		str = "CONFIG CHANGED";
+		break;
 	case LIBINPUT_EVENT_KEYBOARD_KEY:
 		str = "KEY";
 		break;
@@ -4831,6 +5058,11 @@ main(int argc, char **argv)
 	if (in_debugger || RUNNING_ON_VALGRIND)
 		setenv("CK_FORK", "no", 0);
 
+	/* Device reuse needs the runner process to survive across cases;
+	 * crash isolation comes from the per-shard forks instead */
+	if (getenv("LITEST_REUSE_DEVICES"))
+		setenv("CK_FORK", "no", 0);
+
 	if ((meson_testthreads = getenv("MESON_TESTTHREADS")) == NULL ||
 	     !safe_atoi(meson_testthreads, &jobs)) {
 		jobs = get_nprocs();
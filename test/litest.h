@@ -390,6 +390,10 @@ struct litest_device {
 	int skip_ev_syn;
 	struct litest_semi_mt semi_mt; /** only used for semi-mt device */
 
+	/* created without overrides or a custom create method, may be
+	 * recycled via the device pool, see LITEST_REUSE_DEVICES */
+	bool pool_eligible;
+
 	void *private; /* device-specific data */
 };
 
@@ -543,6 +547,26 @@ litest_event(struct litest_device *t,
 	     unsigned int type,
 	     unsigned int code,
 	     int value);
+
+/**
+ * Write a pre-built event stream to the device, one writev per IOV_MAX
+ * frames. Events with codes the device does not have are dropped, frames
+ * are delimited by SYN_REPORT. Orders of magnitude faster than calling
+ * litest_event() in a loop, use this for overload and SYN_DROPPED tests.
+ */
+void
+litest_event_batch(struct litest_device *d,
+		   const struct input_event *events,
+		   size_t nevents);
+
+/**
+ * Batch-write nframes frames of EV_REL dx/dy motion.
+ */
+void
+litest_rel_motion_stream(struct litest_device *d,
+			 int dx, int dy,
+			 int nframes);
+
 int
 litest_auto_assign_value(struct litest_device *d,
 			 const struct input_event *ev,
@@ -122,6 +122,51 @@ START_TEST(log_handler_NULL)
 }
 END_TEST
 
+START_TEST(log_ring)
+{
+	struct libinput *li;
+	enum libinput_log_priority pri;
+	char buf[512];
+	size_t sz;
+	int nrecords = 0;
+
+	log_handler_context = NULL;
+	log_handler_called = 0;
+
+	li = litest_create_context();
+
+	libinput_log_set_priority(li, LIBINPUT_LOG_PRIORITY_DEBUG);
+	libinput_log_set_handler(li, simple_log_handler);
+	log_handler_context = li;
+
+	ck_assert_int_eq(libinput_log_set_ring_size(li, 32), 0);
+
+	/* empty ring */
+	ck_assert_int_eq(libinput_log_ring_pop(li, &pri, buf, sizeof(buf)), 0U);
+
+	libinput_path_add_device(li, "/tmp");
+
+	/* while the ring is enabled the handler must not be called */
+	ck_assert_int_eq(log_handler_called, 0);
+
+	while ((sz = libinput_log_ring_pop(li, &pri, buf, sizeof(buf))) > 0) {
+		ck_assert_int_eq(sz, strlen(buf) + 1);
+		nrecords++;
+	}
+	ck_assert_int_gt(nrecords, 0);
+
+	/* disabling restores the handler */
+	ck_assert_int_eq(libinput_log_set_ring_size(li, 0), 0);
+	libinput_path_add_device(li, "/tmp");
+	ck_assert_int_gt(log_handler_called, 0);
+
+	litest_destroy_context(li);
+
+	log_handler_context = NULL;
+	log_handler_called = 0;
+}
+END_TEST
+
 START_TEST(log_priority)
 {
 	struct libinput *li;
@@ -208,6 +253,7 @@ TEST_COLLECTION(log)
 	litest_add_deviceless(log_default_priority);
 	litest_add_deviceless(log_handler_invoked);
 	litest_add_deviceless(log_handler_NULL);
+	litest_add_deviceless(log_ring);
 	litest_add_no_device(log_priority);
 
 	/* mtdev clips to axis ranges */
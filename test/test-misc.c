@@ -152,6 +152,55 @@ START_TEST(event_conversion_device_notify)
 }
 END_TEST
 
+START_TEST(batch_event_retrieval)
+{
+	struct litest_device *dev = litest_current_device();
+	struct libinput *li = dev->libinput;
+	struct libinput_event *events[32];
+	size_t nevents;
+
+	litest_drain_events(li);
+
+	/* Queue at least two relative motion events as the first one may
+	 * be absorbed by the pointer acceleration filter. */
+	litest_event(dev, EV_REL, REL_X, -1);
+	litest_event(dev, EV_REL, REL_Y, -1);
+	litest_event(dev, EV_SYN, SYN_REPORT, 0);
+	litest_event(dev, EV_REL, REL_X, -1);
+	litest_event(dev, EV_REL, REL_Y, -1);
+	litest_event(dev, EV_SYN, SYN_REPORT, 0);
+	litest_event(dev, EV_KEY, BTN_LEFT, 1);
+	litest_event(dev, EV_SYN, SYN_REPORT, 0);
+	litest_event(dev, EV_KEY, BTN_LEFT, 0);
+	litest_event(dev, EV_SYN, SYN_REPORT, 0);
+
+	libinput_dispatch(li);
+
+	/* a max smaller than the queue length must only pop that many */
+	nevents = libinput_get_events(li, events, 1);
+	ck_assert_int_eq(nevents, 1);
+	ck_assert_int_eq(libinput_event_get_type(events[0]),
+			 LIBINPUT_EVENT_POINTER_MOTION);
+	libinput_event_destroy(events[0]);
+
+	nevents = libinput_get_events(li, events, ARRAY_LENGTH(events));
+	ck_assert_int_ge(nevents, 2);
+	/* the button events are always last, preceded by up to one more
+	 * motion event */
+	ck_assert_int_eq(libinput_event_get_type(events[nevents - 2]),
+			 LIBINPUT_EVENT_POINTER_BUTTON);
+	ck_assert_int_eq(libinput_event_get_type(events[nevents - 1]),
+			 LIBINPUT_EVENT_POINTER_BUTTON);
+	for (size_t i = 0; i < nevents; i++)
+		libinput_event_destroy(events[i]);
+
+	/* empty queue */
+	nevents = libinput_get_events(li, events, ARRAY_LENGTH(events));
+	ck_assert_int_eq(nevents, 0);
+	ck_assert(libinput_get_event(li) == NULL);
+}
+END_TEST
+
 START_TEST(event_conversion_pointer)
 {
 	struct litest_device *dev = litest_current_device();
@@ -884,6 +933,7 @@ END_TEST
 TEST_COLLECTION(misc)
 {
 	litest_add_no_device(event_conversion_device_notify);
+	litest_add_for_device(batch_event_retrieval, LITEST_MOUSE);
 	litest_add_for_device(event_conversion_pointer, LITEST_MOUSE);
 	litest_add_for_device(event_conversion_pointer_abs, LITEST_XEN_VIRTUAL_POINTER);
 	litest_add_for_device(event_conversion_key, LITEST_KEYBOARD);
@@ -229,6 +229,7 @@ test_absolute_event(struct litest_device *dev, double x, double y)
 	struct libinput *li = dev->libinput;
 	struct libinput_event *event;
 	struct libinput_event_pointer *ptrev;
+	struct libinput_device_transform *transform;
 	double ex, ey;
 	enum libinput_event_type type = LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE;
 
@@ -247,6 +248,19 @@ test_absolute_event(struct litest_device *dev, double x, double y)
 	litest_assert_int_eq((int)(ex + 0.5), (int)x);
 	litest_assert_int_eq((int)(ey + 0.5), (int)y);
 
+	/* The cached transform must agree with the per-call variant */
+	transform = libinput_device_transform_create(
+					libinput_event_get_device(event),
+					100, 100);
+	litest_assert_ptr_notnull(transform);
+	ex = libinput_event_pointer_get_absolute_x_transformed_by(ptrev,
+								  transform);
+	ey = libinput_event_pointer_get_absolute_y_transformed_by(ptrev,
+								  transform);
+	litest_assert_int_eq((int)(ex + 0.5), (int)x);
+	litest_assert_int_eq((int)(ey + 0.5), (int)y);
+	libinput_device_transform_destroy(transform);
+
 	libinput_event_destroy(event);
 }
 
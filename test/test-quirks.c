@@ -25,6 +25,8 @@
 
 #include <check.h>
 #include <libinput.h>
+#include <sys/stat.h>
+#include <utime.h>
 
 #include "libinput-util.h"
 #include "litest.h"
@@ -86,6 +88,102 @@ cleanup_data_dir(struct data_dir dd)
 	}
 }
 
+START_TEST(quirks_cache_roundtrip)
+{
+	struct quirks_context *ctx;
+	const char quirks_file[] =
+		"[Section name]\n"
+		"MatchUdevType=mouse\n"
+		"AttrSizeHint=10x10\n";
+	/* same length as quirks_file so the cache stays "fresh" */
+	const char garbage_file[] =
+		"%%ction name]\n"
+		"MatchUdevType=mouse\n"
+		"AttrSizeHint=10x10\n";
+	struct data_dir dd = make_data_dir(quirks_file);
+	char *cache_path;
+	struct stat st;
+	struct utimbuf times;
+	FILE *fp;
+
+	ctx = quirks_init_subsystem(dd.dirname,
+				    NULL,
+				    log_handler,
+				    NULL,
+				    QLOG_CUSTOM_LOG_PRIORITIES);
+	ck_assert_notnull(ctx);
+
+	xasprintf(&cache_path, "%s/quirks.cache", dd.dirname);
+	ck_assert(quirks_cache_compile(ctx, dd.dirname, cache_path));
+	quirks_context_unref(ctx);
+
+	/* Replace the data file with unparseable garbage of the same size
+	 * and mtime. Init only succeeds if the cache is used. */
+	ck_assert_int_eq(stat(dd.filename, &st), 0);
+	fp = fopen(dd.filename, "w");
+	ck_assert_notnull(fp);
+	fputs(garbage_file, fp);
+	fclose(fp);
+	times.actime = st.st_atime;
+	times.modtime = st.st_mtime;
+	ck_assert_int_eq(utime(dd.filename, &times), 0);
+
+	ctx = quirks_init_subsystem(dd.dirname,
+				    NULL,
+				    log_handler,
+				    NULL,
+				    QLOG_CUSTOM_LOG_PRIORITIES);
+	ck_assert_notnull(ctx);
+	quirks_context_unref(ctx);
+
+	unlink(cache_path);
+	free(cache_path);
+	cleanup_data_dir(dd);
+}
+END_TEST
+
+START_TEST(quirks_cache_stale)
+{
+	struct quirks_context *ctx;
+	const char quirks_file[] =
+		"[Section name]\n"
+		"MatchUdevType=mouse\n"
+		"AttrSizeHint=10x10\n";
+	struct data_dir dd = make_data_dir(quirks_file);
+	char *cache_path;
+	FILE *fp;
+
+	ctx = quirks_init_subsystem(dd.dirname,
+				    NULL,
+				    log_handler,
+				    NULL,
+				    QLOG_CUSTOM_LOG_PRIORITIES);
+	ck_assert_notnull(ctx);
+
+	xasprintf(&cache_path, "%s/quirks.cache", dd.dirname);
+	ck_assert(quirks_cache_compile(ctx, dd.dirname, cache_path));
+	quirks_context_unref(ctx);
+
+	/* Replace the data file with garbage of a different size: the
+	 * cache is stale now, the parser must run and fail. */
+	fp = fopen(dd.filename, "w");
+	ck_assert_notnull(fp);
+	fputs("%%garbage\n", fp);
+	fclose(fp);
+
+	ctx = quirks_init_subsystem(dd.dirname,
+				    NULL,
+				    log_handler,
+				    NULL,
+				    QLOG_CUSTOM_LOG_PRIORITIES);
+	ck_assert(ctx == NULL);
+
+	unlink(cache_path);
+	free(cache_path);
+	cleanup_data_dir(dd);
+}
+END_TEST
+
 START_TEST(quirks_invalid_dir)
 {
 	struct quirks_context *ctx;
@@ -1519,6 +1617,8 @@ TEST_COLLECTION(quirks)
 
 	litest_add_deviceless(quirks_invalid_dir);
 	litest_add_deviceless(quirks_empty_dir);
+	litest_add_deviceless(quirks_cache_roundtrip);
+	litest_add_deviceless(quirks_cache_stale);
 
 	litest_add_deviceless(quirks_section_empty);
 	litest_add_deviceless(quirks_section_double);
@@ -195,6 +195,42 @@ START_TEST(ratelimit_helpers)
 }
 END_TEST
 
+START_TEST(ratelimit_time_helpers)
+{
+	struct ratelimit rl;
+	uint64_t now = s2us(100);
+	unsigned int i;
+
+	/* 10 attempts every 1000ms */
+	ratelimit_init(&rl, ms2us(1000), 10);
+
+	/* a burst of 9 attempts must succeed */
+	for (i = 0; i < 9; ++i) {
+		ck_assert_int_eq(ratelimit_test_time(&rl, now),
+				 RATELIMIT_PASS);
+	}
+
+	/* the 10th attempt reaches the threshold */
+	ck_assert_int_eq(ratelimit_test_time(&rl, now), RATELIMIT_THRESHOLD);
+
+	/* further attempts fail and are counted as suppressed */
+	for (i = 0; i < 100; ++i) {
+		ck_assert_int_eq(ratelimit_test_time(&rl, now + ms2us(i)),
+				 RATELIMIT_EXCEEDED);
+	}
+	ck_assert_int_eq(rl.num_suppressed, 100);
+	ck_assert_int_eq(rl.total_suppressed, 100);
+
+	/* after the interval the counter resets and the suppressed count
+	 * moves to last_suppressed */
+	now += ms2us(1001);
+	ck_assert_int_eq(ratelimit_test_time(&rl, now), RATELIMIT_PASS);
+	ck_assert_int_eq(rl.num_suppressed, 0);
+	ck_assert_int_eq(rl.last_suppressed, 100);
+	ck_assert_int_eq(rl.total_suppressed, 100);
+}
+END_TEST
+
 struct parser_test {
 	char *tag;
 	int expected_value;
@@ -1055,6 +1091,35 @@ START_TEST(strsplit_test)
 }
 END_TEST
 
+START_TEST(strsplit_buf_test)
+{
+	char buf[64];
+	char *strv[4];
+
+	ck_assert_int_eq(strv_from_string_buf("one two three", " ",
+					      strv, ARRAY_LENGTH(strv),
+					      buf, sizeof(buf)), 3);
+	ck_assert_str_eq(strv[0], "one");
+	ck_assert_str_eq(strv[1], "two");
+	ck_assert_str_eq(strv[2], "three");
+	ck_assert_ptr_eq(strv[3], NULL);
+
+	ck_assert_int_eq(strv_from_string_buf("", " ",
+					      strv, ARRAY_LENGTH(strv),
+					      buf, sizeof(buf)), 0);
+	ck_assert_ptr_eq(strv[0], NULL);
+
+	/* too many tokens for the pointer array */
+	ck_assert_int_eq(strv_from_string_buf("a b c d", " ",
+					      strv, ARRAY_LENGTH(strv),
+					      buf, sizeof(buf)), -1);
+	/* tokens don't fit the scratch buffer */
+	ck_assert_int_eq(strv_from_string_buf("one two three", " ",
+					      strv, ARRAY_LENGTH(strv),
+					      buf, 8), -1);
+}
+END_TEST
+
 START_TEST(strargv_test)
 {
 	struct argv_test {
@@ -1464,6 +1529,7 @@ litest_utils_suite(void)
 	tcase_add_test(tc, bitfield_helpers);
 	tcase_add_test(tc, matrix_helpers);
 	tcase_add_test(tc, ratelimit_helpers);
+	tcase_add_test(tc, ratelimit_time_helpers);
 	tcase_add_test(tc, dpi_parser);
 	tcase_add_test(tc, wheel_click_parser);
 	tcase_add_test(tc, wheel_click_count_parser);
@@ -1483,6 +1549,7 @@ litest_utils_suite(void)
 	tcase_add_test(tc, safe_atou_base_8_test);
 	tcase_add_test(tc, safe_atod_test);
 	tcase_add_test(tc, strsplit_test);
+	tcase_add_test(tc, strsplit_buf_test);
 	tcase_add_test(tc, strargv_test);
 	tcase_add_test(tc, kvsplit_double_test);
 	tcase_add_test(tc, strjoin_test);
@@ -0,0 +1,561 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Native single-pass statistics over libinput-record recordings. The
+ * recording is mmapped (or slurped from stdin) and scanned once,
+ * accumulating per-device frame rates, inter-frame jitter, per-slot
+ * motion deltas and SYN_DROPPED counts with streaming algorithms, so
+ * a day's worth of recordings summarizes in seconds where the
+ * line-at-a-time python tools take hours.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <linux/input.h>
+
+#include "util-macros.h"
+#include "util-strings.h"
+#include "util-time.h"
+
+#define SUPPORTED_FILE_VERSION 1
+#define MAX_DEVICES 32
+#define MAX_SLOTS 64
+
+/* Welford's streaming mean/variance, one pass, O(1) memory */
+struct running_stats {
+	uint64_t n;
+	double mean;
+	double m2;
+	double min, max;
+};
+
+static void
+running_stats_init(struct running_stats *s)
+{
+	s->n = 0;
+	s->mean = 0.0;
+	s->m2 = 0.0;
+	s->min = INFINITY;
+	s->max = -INFINITY;
+}
+
+static void
+running_stats_push(struct running_stats *s, double value)
+{
+	double delta, delta2;
+
+	s->n++;
+	delta = value - s->mean;
+	s->mean += delta / s->n;
+	delta2 = value - s->mean;
+	s->m2 += delta * delta2;
+	s->min = min(s->min, value);
+	s->max = max(s->max, value);
+}
+
+static double
+running_stats_stddev(const struct running_stats *s)
+{
+	if (s->n < 2)
+		return 0.0;
+
+	return sqrt(s->m2 / (s->n - 1));
+}
+
+struct slot_state {
+	bool active;
+	bool have_prev;
+	int x, y;
+	int prev_x, prev_y;
+	bool moved;
+};
+
+struct device_stats {
+	char name[256];
+	uint64_t nevents;
+	uint64_t nframes;
+	uint64_t ndropped; /* SYN_DROPPED */
+	uint64_t first_time, last_time; /* µs */
+
+	struct running_stats frame_interval; /* ms */
+	struct running_stats slot_delta; /* device units per frame */
+
+	/* current-frame scratch */
+	struct slot_state slots[MAX_SLOTS];
+	int slot;
+	int resolution_x; /* units/mm of ABS_MT_POSITION_X, 0 if unset */
+	uint64_t prev_frame_time;
+};
+
+struct stats_context {
+	struct device_stats devices[MAX_DEVICES];
+	size_t ndevices;
+};
+
+static inline void
+usage(void)
+{
+	printf("Usage: %s [--help] <recording> [<recording> ...]\n"
+	       "\n"
+	       "Summarize frame rates, inter-frame jitter, per-slot motion\n"
+	       "deltas and SYN_DROPPED counts of libinput-record recordings\n"
+	       "in a single pass. Use - to read a recording from stdin.\n",
+	       program_invocation_short_name);
+}
+
+/* Copies the next line of the buffer into buf with leading whitespace
+ * stripped and a terminating \0, returns NULL at end of buffer. */
+static const char *
+next_line(const char *data, size_t size, size_t *pos, char *buf, size_t bufsz)
+{
+	const char *line, *end;
+	size_t n;
+
+	if (*pos >= size)
+		return NULL;
+
+	line = data + *pos;
+	end = memchr(line, '\n', size - *pos);
+	n = end ? (size_t)(end - line) : size - *pos;
+	*pos += n + 1;
+
+	while (n > 0 && (*line == ' ' || *line == '\t')) {
+		line++;
+		n--;
+	}
+
+	n = min(n, bufsz - 1);
+	memcpy(buf, line, n);
+	buf[n] = '\0';
+
+	return buf;
+}
+
+static inline bool
+line_begins(const char *line, const char *prefix)
+{
+	return strneq(line, prefix, (int)strlen(prefix));
+}
+
+static void
+device_frame_end(struct device_stats *d, uint64_t time)
+{
+	size_t i;
+
+	d->nframes++;
+
+	if (d->prev_frame_time)
+		running_stats_push(&d->frame_interval,
+				   (time - d->prev_frame_time) / 1000.0);
+	d->prev_frame_time = time;
+
+	for (i = 0; i < MAX_SLOTS; i++) {
+		struct slot_state *s = &d->slots[i];
+
+		if (!s->active || !s->moved)
+			continue;
+
+		if (s->have_prev) {
+			double dx = s->x - s->prev_x;
+			double dy = s->y - s->prev_y;
+
+			running_stats_push(&d->slot_delta,
+					   hypot(dx, dy));
+		}
+
+		s->prev_x = s->x;
+		s->prev_y = s->y;
+		s->have_prev = true;
+		s->moved = false;
+	}
+}
+
+static void
+device_handle_event(struct device_stats *d,
+		    unsigned int type,
+		    unsigned int code,
+		    int value,
+		    uint64_t time)
+{
+	struct slot_state *s;
+
+	d->nevents++;
+	if (d->first_time == 0)
+		d->first_time = time;
+	d->last_time = time;
+
+	switch (type) {
+	case EV_SYN:
+		if (code == SYN_REPORT)
+			device_frame_end(d, time);
+		else if (code == SYN_DROPPED)
+			d->ndropped++;
+		return;
+	case EV_ABS:
+		break;
+	default:
+		return;
+	}
+
+	if (code == ABS_MT_SLOT) {
+		d->slot = value;
+		return;
+	}
+
+	if (d->slot < 0 || d->slot >= MAX_SLOTS)
+		return;
+
+	s = &d->slots[d->slot];
+	switch (code) {
+	case ABS_MT_TRACKING_ID:
+		if (value == -1) {
+			s->active = false;
+			s->have_prev = false;
+		} else {
+			s->active = true;
+			s->have_prev = false;
+		}
+		break;
+	case ABS_MT_POSITION_X:
+		s->x = value;
+		s->moved = true;
+		break;
+	case ABS_MT_POSITION_Y:
+		s->y = value;
+		s->moved = true;
+		break;
+	}
+}
+
+/* Minimal scanner for the fixed YAML layout that libinput-record
+ * produces, same approach as libinput-replay-fast. Anything we do not
+ * recognize is skipped. */
+static int
+parse_recording(struct stats_context *ctx, const char *data, size_t size)
+{
+	enum {
+		SEC_NONE,
+		SEC_EVDEV,
+		SEC_EVDEV_ABSINFO,
+		SEC_OTHER,
+		SEC_EVENTS,
+	} section = SEC_NONE;
+	struct device_stats *d = NULL;
+	bool in_evdev_frame = false;
+	char buf[16384];
+	const char *line;
+	size_t pos = 0;
+	int version = -1;
+
+	while ((line = next_line(data, size, &pos, buf, sizeof(buf)))) {
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+
+		if (version == -1 && line_begins(line, "version:")) {
+			version = atoi(line + 8);
+			if (version != SUPPORTED_FILE_VERSION) {
+				fprintf(stderr,
+					"Unsupported recording version %d\n",
+					version);
+				return -EINVAL;
+			}
+			continue;
+		}
+
+		if (line_begins(line, "- node:")) {
+			if (ctx->ndevices == MAX_DEVICES) {
+				fprintf(stderr, "Too many devices\n");
+				return -EINVAL;
+			}
+			d = &ctx->devices[ctx->ndevices++];
+			running_stats_init(&d->frame_interval);
+			running_stats_init(&d->slot_delta);
+			d->slot = 0;
+			section = SEC_NONE;
+			in_evdev_frame = false;
+			continue;
+		}
+
+		if (!d)
+			continue;
+
+		if (section == SEC_EVENTS) {
+			if (line_begins(line, "- evdev:")) {
+				in_evdev_frame = true;
+			} else if (line_begins(line, "- hid:")) {
+				in_evdev_frame = false;
+			} else if (in_evdev_frame &&
+				   line_begins(line, "- [")) {
+				unsigned long sec, usec;
+				unsigned int type, code;
+				int value;
+
+				if (sscanf(line,
+					   "- [%lu, %lu, %u, %u, %d]",
+					   &sec, &usec,
+					   &type, &code, &value) != 5)
+					continue;
+
+				device_handle_event(d,
+						    type,
+						    code,
+						    value,
+						    s2us(sec) + usec);
+			}
+			continue;
+		}
+
+		if (streq(line, "evdev:")) {
+			section = SEC_EVDEV;
+			continue;
+		}
+		if (streq(line, "events:")) {
+			section = SEC_EVENTS;
+			in_evdev_frame = false;
+			continue;
+		}
+		if (line_begins(line, "udev:") ||
+		    line_begins(line, "libinput:") ||
+		    line_begins(line, "quirks:") ||
+		    line_begins(line, "hid:")) {
+			section = SEC_OTHER;
+			continue;
+		}
+
+		if (section == SEC_OTHER || section == SEC_NONE)
+			continue;
+
+		if (line_begins(line, "name: \"")) {
+			size_t n = min(strlen(line + 7), sizeof(d->name) - 1);
+
+			memcpy(d->name, line + 7, n);
+			if (n > 0 && d->name[n - 1] == '"')
+				n--;
+			d->name[n] = '\0';
+		} else if (streq(line, "absinfo:")) {
+			section = SEC_EVDEV_ABSINFO;
+		} else if (section == SEC_EVDEV_ABSINFO &&
+			   strchr(line, ':')) {
+			unsigned int code = atoi(line);
+			const char *s = strchr(line, '[');
+			int mi, ma, fuzz, flat, res;
+
+			if (code != ABS_MT_POSITION_X || !s)
+				continue;
+
+			if (sscanf(s, "[%d, %d, %d, %d, %d]",
+				   &mi, &ma, &fuzz, &flat, &res) == 5)
+				d->resolution_x = res;
+		}
+	}
+
+	return ctx->ndevices > 0 ? 0 : -EINVAL;
+}
+
+static void
+print_stats(const struct stats_context *ctx, const char *path)
+{
+	size_t i;
+
+	printf("# %s\n", path);
+	for (i = 0; i < ctx->ndevices; i++) {
+		const struct device_stats *d = &ctx->devices[i];
+		const struct running_stats *fi = &d->frame_interval;
+		const struct running_stats *sd = &d->slot_delta;
+		double duration = (d->last_time - d->first_time) / 1.0e6;
+
+		printf("device %zd: %s\n", i, d->name);
+		printf("  events: %" PRIu64 ", frames: %" PRIu64
+		       ", duration: %.2fs, syn_dropped: %" PRIu64 "\n",
+		       d->nevents,
+		       d->nframes,
+		       duration,
+		       d->ndropped);
+
+		if (fi->n > 0)
+			printf("  frame interval: mean %.3fms (%.1fHz), "
+			       "min %.3fms, max %.3fms, stddev %.3fms\n",
+			       fi->mean,
+			       fi->mean > 0.0 ? 1000.0 / fi->mean : 0.0,
+			       fi->min,
+			       fi->max,
+			       running_stats_stddev(fi));
+
+		if (sd->n > 0) {
+			printf("  per-slot delta: mean %.2f units/frame, "
+			       "max %.2f, stddev %.2f, samples %" PRIu64 "\n",
+			       sd->mean,
+			       sd->max,
+			       running_stats_stddev(sd),
+			       sd->n);
+			if (d->resolution_x > 0)
+				printf("  per-slot delta: mean %.3fmm/frame "
+				       "at %d units/mm\n",
+				       sd->mean / d->resolution_x,
+				       d->resolution_x);
+		}
+	}
+}
+
+/* stdin can't be mmapped, slurp it instead */
+static char *
+read_stdin(size_t *size_out)
+{
+	size_t sz = 1024 * 1024, used = 0;
+	char *data = malloc(sz);
+
+	if (!data)
+		return NULL;
+
+	for (;;) {
+		ssize_t n;
+
+		if (used == sz) {
+			char *tmp;
+
+			sz *= 2;
+			tmp = realloc(data, sz);
+			if (!tmp) {
+				free(data);
+				return NULL;
+			}
+			data = tmp;
+		}
+
+		n = read(STDIN_FILENO, data + used, sz - used);
+		if (n < 0) {
+			free(data);
+			return NULL;
+		}
+		if (n == 0)
+			break;
+		used += n;
+	}
+
+	*size_out = used;
+
+	return data;
+}
+
+static int
+analyze_one(const char *path)
+{
+	struct stats_context *ctx;
+	struct stat st;
+	char *data;
+	size_t size;
+	bool mapped = false;
+	int fd, rc;
+
+	if (streq(path, "-")) {
+		data = read_stdin(&size);
+		if (!data) {
+			fprintf(stderr, "Failed to read stdin\n");
+			return -errno;
+		}
+	} else {
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0 || fstat(fd, &st) < 0) {
+			fprintf(stderr, "Failed to open %s (%s)\n",
+				path, strerror(errno));
+			return -errno;
+		}
+
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED) {
+			fprintf(stderr, "Failed to map %s (%s)\n",
+				path, strerror(errno));
+			return -errno;
+		}
+		size = st.st_size;
+		mapped = true;
+	}
+
+	ctx = zalloc(sizeof *ctx);
+	rc = parse_recording(ctx, data, size);
+	if (rc < 0)
+		fprintf(stderr, "%s is not a valid recording\n", path);
+	else
+		print_stats(ctx, path);
+
+	free(ctx);
+	if (mapped)
+		munmap(data, size);
+	else
+		free(data);
+
+	return rc;
+}
+
+int
+main(int argc, char **argv)
+{
+	int rc = 0;
+
+	while (1) {
+		static struct option opts[] = {
+			{ "help", no_argument, 0, 'h' },
+			{ 0, 0, 0, 0 },
+		};
+		int c = getopt_long(argc, argv, "h", opts, NULL);
+
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind >= argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	for (; optind < argc; optind++) {
+		if (analyze_one(argv[optind]) < 0)
+			rc = 1;
+	}
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
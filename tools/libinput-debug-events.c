@@ -50,6 +50,7 @@ static struct tools_options options;
 static bool show_keycodes;
 static volatile sig_atomic_t stop = 0;
 static bool be_quiet = false;
+static bool stats_only = false;
 
 #define printq(...) ({ if (!be_quiet)  printf(__VA_ARGS__); })
 
@@ -71,6 +72,9 @@ print_event_header(struct libinput_event *ev)
 	case LIBINPUT_EVENT_DEVICE_REMOVED:
 		type = "DEVICE_REMOVED";
 		break;
+	case LIBINPUT_EVENT_DEVICE_CONFIG_CHANGED:
+		type = "DEVICE_CONFIG_CHANGED";
+		break;
 	case LIBINPUT_EVENT_KEYBOARD_KEY:
 		type = "KEYBOARD_KEY";
 		break;
@@ -837,6 +841,179 @@ print_switch_event(struct libinput_event *ev)
 	printq("switch %s state %d\n", which, state);
 }
 
+/* --stats-only: formatting and printing each event cannot keep up with
+ * high-rate devices and the tool itself starts to skew what it is supposed
+ * to observe. In stats mode events are merely counted per device and type,
+ * through a lookup table resolved once at startup, and a rate summary is
+ * printed once per interval.
+ */
+#define STATS_INTERVAL_MS 1000
+
+static const struct {
+	enum libinput_event_type type;
+	const char *name;
+} stats_types[] = {
+#define TYPE(t_) { LIBINPUT_EVENT_##t_, #t_ }
+	TYPE(DEVICE_ADDED),
+	TYPE(DEVICE_REMOVED),
+	TYPE(KEYBOARD_KEY),
+	TYPE(POINTER_MOTION),
+	TYPE(POINTER_MOTION_ABSOLUTE),
+	TYPE(POINTER_BUTTON),
+	TYPE(POINTER_AXIS),
+	TYPE(POINTER_SCROLL_WHEEL),
+	TYPE(POINTER_SCROLL_FINGER),
+	TYPE(POINTER_SCROLL_CONTINUOUS),
+	TYPE(TOUCH_DOWN),
+	TYPE(TOUCH_UP),
+	TYPE(TOUCH_MOTION),
+	TYPE(TOUCH_CANCEL),
+	TYPE(TOUCH_FRAME),
+	TYPE(TABLET_TOOL_AXIS),
+	TYPE(TABLET_TOOL_PROXIMITY),
+	TYPE(TABLET_TOOL_TIP),
+	TYPE(TABLET_TOOL_BUTTON),
+	TYPE(TABLET_PAD_BUTTON),
+	TYPE(TABLET_PAD_RING),
+	TYPE(TABLET_PAD_STRIP),
+	TYPE(TABLET_PAD_KEY),
+	TYPE(GESTURE_SWIPE_BEGIN),
+	TYPE(GESTURE_SWIPE_UPDATE),
+	TYPE(GESTURE_SWIPE_END),
+	TYPE(GESTURE_PINCH_BEGIN),
+	TYPE(GESTURE_PINCH_UPDATE),
+	TYPE(GESTURE_PINCH_END),
+	TYPE(GESTURE_HOLD_BEGIN),
+	TYPE(GESTURE_HOLD_END),
+	TYPE(SWITCH_TOGGLE),
+#undef TYPE
+};
+
+struct stats_device {
+	/* use for pointer comparison only, NULL once removed */
+	struct libinput_device *device;
+	char sysname[32];
+	uint64_t count[ARRAY_LENGTH(stats_types)];
+};
+
+static struct stats_device stats_devices[60];
+static size_t stats_ndevices;
+
+/* event type value -> index into stats_types, so counting an event is two
+ * array lookups instead of a switch */
+static uint8_t stats_index[LIBINPUT_EVENT_SWITCH_TOGGLE + 1];
+
+static void
+stats_init(void)
+{
+	memset(stats_index, 0xff, sizeof(stats_index));
+	for (size_t i = 0; i < ARRAY_LENGTH(stats_types); i++)
+		stats_index[stats_types[i].type] = i;
+}
+
+static void
+stats_count(struct libinput_device *device, enum libinput_event_type type)
+{
+	struct stats_device *d = NULL;
+
+	if ((size_t)type >= ARRAY_LENGTH(stats_index) ||
+	    stats_index[type] == 0xff)
+		return;
+
+	for (size_t i = 0; i < stats_ndevices; i++) {
+		if (stats_devices[i].device == device) {
+			d = &stats_devices[i];
+			break;
+		}
+	}
+
+	if (!d) {
+		/* reuse the slot of a removed device first; that drops at
+		 * most one interval's worth of its counts */
+		for (size_t i = 0; i < stats_ndevices; i++) {
+			if (stats_devices[i].device == NULL) {
+				d = &stats_devices[i];
+				break;
+			}
+		}
+		if (!d) {
+			if (stats_ndevices == ARRAY_LENGTH(stats_devices))
+				return;
+			d = &stats_devices[stats_ndevices++];
+		}
+		memset(d, 0, sizeof(*d));
+		d->device = device;
+		snprintf(d->sysname,
+			 sizeof(d->sysname),
+			 "%s",
+			 libinput_device_get_sysname(device));
+	}
+
+	d->count[stats_index[type]]++;
+}
+
+static void
+stats_forget(struct libinput_device *device)
+{
+	for (size_t i = 0; i < stats_ndevices; i++) {
+		if (stats_devices[i].device == device) {
+			stats_devices[i].device = NULL;
+			break;
+		}
+	}
+}
+
+static void
+stats_print(uint64_t elapsed_ms)
+{
+	bool any = false;
+
+	for (size_t i = 0; i < stats_ndevices; i++) {
+		struct stats_device *d = &stats_devices[i];
+
+		for (size_t t = 0; t < ARRAY_LENGTH(stats_types); t++) {
+			if (d->count[t] == 0)
+				continue;
+
+			printf("%-7s  %-25s %8" PRIu64 " %8" PRIu64 "/s\n",
+			       d->sysname,
+			       stats_types[t].name,
+			       d->count[t],
+			       d->count[t] * 1000 / elapsed_ms);
+			d->count[t] = 0;
+			any = true;
+		}
+	}
+
+	if (any)
+		printf("\n");
+	fflush(stdout);
+}
+
+static int
+handle_and_count_events(struct libinput *li)
+{
+	int rc = -1;
+	struct libinput_event *ev;
+
+	tools_dispatch(li);
+	while ((ev = libinput_get_event(li))) {
+		enum libinput_event_type type = libinput_event_get_type(ev);
+		struct libinput_device *device = libinput_event_get_device(ev);
+
+		if (type == LIBINPUT_EVENT_DEVICE_ADDED)
+			tools_device_apply_config(device, &options);
+
+		stats_count(device, type);
+		if (type == LIBINPUT_EVENT_DEVICE_REMOVED)
+			stats_forget(device);
+
+		libinput_event_destroy(ev);
+		rc = 0;
+	}
+	return rc;
+}
+
 static int
 handle_and_print_events(struct libinput *li)
 {
@@ -861,6 +1038,11 @@ handle_and_print_events(struct libinput *li)
 		case LIBINPUT_EVENT_DEVICE_REMOVED:
 			print_device_notify(ev);
 			break;
+		case LIBINPUT_EVENT_DEVICE_CONFIG_CHANGED:
+			printq("config generation %u\n",
+			       libinput_device_get_config_generation(
+					libinput_event_get_device(ev)));
+			break;
 		case LIBINPUT_EVENT_KEYBOARD_KEY:
 			print_key_event(ev);
 			break;
@@ -981,6 +1163,44 @@ mainloop(struct libinput *li)
 	printf("\n");
 }
 
+static void
+mainloop_stats(struct libinput *li)
+{
+	struct pollfd fds;
+	struct timespec tp;
+	uint64_t now, last_print;
+
+	fds.fd = libinput_get_fd(li);
+	fds.events = POLLIN;
+	fds.revents = 0;
+
+	stats_init();
+
+	/* Handle already-pending device added events */
+	if (handle_and_count_events(li))
+		fprintf(stderr, "Expected device added events on startup but got none. "
+				"Maybe you don't have the right permissions?\n");
+
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	now = tp.tv_sec * 1000ULL + tp.tv_nsec / 1000000;
+	last_print = now;
+
+	while (!stop) {
+		int64_t timeout = (int64_t)(last_print + STATS_INTERVAL_MS) -
+				  (int64_t)now;
+
+		if (poll(&fds, 1, timeout > 0 ? (int)timeout : 0) > 0)
+			handle_and_count_events(li);
+
+		clock_gettime(CLOCK_MONOTONIC, &tp);
+		now = tp.tv_sec * 1000ULL + tp.tv_nsec / 1000000;
+		if (now - last_print >= STATS_INTERVAL_MS) {
+			stats_print(now - last_print);
+			last_print = now;
+		}
+	}
+}
+
 static void
 usage(void) {
 	printf("Usage: libinput debug-events [options] [--udev <seat>|--device /dev/input/event0 ...]\n");
@@ -1009,6 +1229,7 @@ main(int argc, char **argv)
 			OPT_VERBOSE,
 			OPT_SHOW_KEYCODES,
 			OPT_QUIET,
+			OPT_STATS,
 		};
 		static struct option opts[] = {
 			CONFIGURATION_OPTIONS,
@@ -1019,6 +1240,7 @@ main(int argc, char **argv)
 			{ "grab",                      no_argument,       0, OPT_GRAB },
 			{ "verbose",                   no_argument,       0, OPT_VERBOSE },
 			{ "quiet",                     no_argument,       0, OPT_QUIET },
+			{ "stats-only",                no_argument,       0, OPT_STATS },
 			{ 0, 0, 0, 0}
 		};
 
@@ -1040,6 +1262,9 @@ main(int argc, char **argv)
 		case OPT_QUIET:
 			be_quiet = true;
 			break;
+		case OPT_STATS:
+			stats_only = true;
+			break;
 		case OPT_DEVICE:
 			if (backend == BACKEND_UDEV ||
 			    ndevices >= ARRAY_LENGTH(seat_or_devices)) {
@@ -1112,7 +1337,10 @@ main(int argc, char **argv)
 	if (!li)
 		return EXIT_FAILURE;
 
-	mainloop(li);
+	if (stats_only)
+		mainloop_stats(li);
+	else
+		mainloop(li);
 
 	libinput_unref(li);
 
@@ -204,6 +204,15 @@ struct window {
 		uintptr_t device, last_device;
 	} evdev;
 
+	/* damage accumulated since the last frame, flushed into one
+	 * redraw per vsync, see window_flush_damage() */
+	struct {
+		bool pending;
+		bool full;
+		GdkRectangle rect;
+		guint tick_id;
+	} damage;
+
 	struct libinput_device *devices[50];
 };
 
@@ -1004,6 +1013,112 @@ draw_gtk4(GtkDrawingArea *widget,
 }
 #endif
 
+/* Flush the damage accumulated since the last frame into a single
+ * redraw. This runs from the frame clock, i.e. at most once per vsync -
+ * the event handlers only mark damage, so an 8kHz event stream decimates
+ * into the 60-odd redraws the screen can show anyway. */
+static gboolean
+window_flush_damage(GtkWidget *widget, GdkFrameClock *clock, gpointer data)
+{
+	struct window *w = data;
+
+#if HAVE_GTK4
+	/* GTK4 dropped partial invalidation */
+	gtk_widget_queue_draw(w->area);
+#else
+	if (w->damage.full)
+		gtk_widget_queue_draw(w->area);
+	else
+		gtk_widget_queue_draw_area(w->area,
+					   w->damage.rect.x,
+					   w->damage.rect.y,
+					   w->damage.rect.width,
+					   w->damage.rect.height);
+#endif
+
+	w->damage.pending = false;
+	w->damage.full = false;
+	w->damage.tick_id = 0;
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+window_damage_rect(struct window *w, const GdkRectangle *rect)
+{
+	if (!w->damage.pending) {
+		w->damage.rect = *rect;
+		w->damage.pending = true;
+		w->damage.tick_id = gtk_widget_add_tick_callback(w->area,
+								 window_flush_damage,
+								 w,
+								 NULL);
+	} else if (!w->damage.full) {
+		gdk_rectangle_union(&w->damage.rect,
+				    rect,
+				    &w->damage.rect);
+	}
+}
+
+/* Mark the area of size pad around x/y as needing a redraw */
+static void
+window_damage(struct window *w, double x, double y, double pad)
+{
+	GdkRectangle rect = {
+		.x = (int)(x - pad),
+		.y = (int)(y - pad),
+		.width = (int)(2 * pad) + 1,
+		.height = (int)(2 * pad) + 1,
+	};
+
+	window_damage_rect(w, &rect);
+}
+
+static void
+window_damage_all(struct window *w)
+{
+	const GdkRectangle all = {
+		.x = 0,
+		.y = 0,
+		.width = w->width,
+		.height = w->height,
+	};
+
+	window_damage_rect(w, &all);
+	w->damage.full = true;
+}
+
+/* Current extent of the raw relative-motion panel in draw_evdev_rel() */
+static void
+window_damage_evdev_rel(struct window *w)
+{
+	int pad_x = 20 * (abs(w->evdev.rel_x) + 2);
+	int pad_y = 20 * (abs(w->evdev.rel_y) + 2);
+	GdkRectangle rect = {
+		.x = w->width/2 - 400 - pad_x,
+		.y = w->height/2 - pad_y,
+		.width = 2 * pad_x,
+		.height = 2 * pad_y,
+	};
+
+	window_damage_rect(w, &rect);
+}
+
+/* The raw abs panel in draw_evdev_abs(); the outline is 200px wide and
+ * proportional in height, the pad covers devices up to 1:2.5 */
+static void
+window_damage_evdev_abs(struct window *w)
+{
+	GdkRectangle rect = {
+		.x = w->width/2 + 400 - 120,
+		.y = w->height/2 - 260,
+		.width = 240,
+		.height = 520,
+	};
+
+	window_damage_rect(w, &rect);
+}
+
 static void
 window_place_ui_elements(GtkWidget *widget, struct window *w)
 {
@@ -1219,6 +1334,11 @@ handle_event_evdev(GIOChannel *source, GIOCondition condition, gpointer data)
 		return FALSE;
 	}
 
+	/* cover the panels at their extent before the update, the
+	 * matching post-update damage is below */
+	window_damage_evdev_rel(w);
+	window_damage_evdev_abs(w);
+
 	do {
 		rc = libevdev_next_event(device->evdev,
 					 LIBEVDEV_READ_FLAG_NORMAL,
@@ -1269,7 +1389,8 @@ handle_event_evdev(GIOChannel *source, GIOCondition condition, gpointer data)
 		}
 	} while (rc == LIBEVDEV_READ_STATUS_SUCCESS);
 
-	gtk_widget_queue_draw(w->area);
+	window_damage_evdev_rel(w);
+	window_damage_evdev_abs(w);
 out:
 	return TRUE;
 }
@@ -1380,6 +1501,8 @@ handle_event_device_notify(struct libinput_event *ev)
 			}
 		}
 	}
+
+	window_damage_all(w);
 }
 
 static void
@@ -1394,6 +1517,10 @@ handle_event_motion(struct libinput_event *ev, struct window *w)
 	const int mask = ARRAY_LENGTH(w->deltas);
 	size_t idx;
 
+	/* old and new sprite positions plus the new trail segment */
+	window_damage(w, w->pointer.x, w->pointer.y, 25);
+	window_damage(w, w->unaccelerated.x, w->unaccelerated.y, 15);
+
 	w->pointer.x = clip(w->pointer.x + dx, 0.0, w->width);
 	w->pointer.y = clip(w->pointer.y + dy, 0.0, w->height);
 	w->unaccelerated.x = clip(w->unaccelerated.x + dx_unaccel, 0.0, w->width);
@@ -1401,11 +1528,16 @@ handle_event_motion(struct libinput_event *ev, struct window *w)
 
 	idx = w->ndeltas % mask;
 	point = w->deltas[idx];
+	window_damage(w, point.x, point.y, 10);
 	idx = (w->ndeltas + 1) % mask;
 	point.x += dx_unaccel;
 	point.y += dy_unaccel;
 	w->deltas[idx] = point;
 	w->ndeltas++;
+
+	window_damage(w, w->pointer.x, w->pointer.y, 25);
+	window_damage(w, w->unaccelerated.x, w->unaccelerated.y, 15);
+	window_damage(w, point.x, point.y, 10);
 }
 
 static void
@@ -1415,8 +1547,10 @@ handle_event_absmotion(struct libinput_event *ev, struct window *w)
 	double x = libinput_event_pointer_get_absolute_x_transformed(p, w->width),
 	       y = libinput_event_pointer_get_absolute_y_transformed(p, w->height);
 
+	window_damage(w, w->abs.x, w->abs.y, 15);
 	w->abs.x = x;
 	w->abs.y = y;
+	window_damage(w, w->abs.x, w->abs.y, 15);
 }
 
 static void
@@ -1431,6 +1565,7 @@ handle_event_touch(struct libinput_event *ev, struct window *w)
 		return;
 
 	touch = &w->touches[slot];
+	window_damage(w, touch->x, touch->y, 15);
 
 	switch (libinput_event_get_type(ev)) {
 	case LIBINPUT_EVENT_TOUCH_UP:
@@ -1449,6 +1584,7 @@ handle_event_touch(struct libinput_event *ev, struct window *w)
 	touch->state = TOUCH_ACTIVE;
 	touch->x = (int)x;
 	touch->y = (int)y;
+	window_damage(w, touch->x, touch->y, 15);
 }
 
 static void
@@ -1484,6 +1620,8 @@ handle_event_axis(struct libinput_event *ev, struct window *w)
 			w->scroll.hx_discrete = clip(w->scroll.hx_discrete, 0, w->width);
 		}
 	}
+
+	window_damage_all(w);
 }
 
 static int
@@ -1509,6 +1647,8 @@ handle_event_keyboard(struct libinput_event *ev, struct window *w)
 		break;
 	}
 
+	window_damage_all(w);
+
 	return 0;
 }
 
@@ -1537,6 +1677,7 @@ handle_event_button(struct libinput_event *ev, struct window *w)
 								     button);
 	}
 
+	window_damage_all(w);
 }
 
 static void
@@ -1568,6 +1709,8 @@ handle_event_swipe(struct libinput_event *ev, struct window *w)
 	default:
 		abort();
 	}
+
+	window_damage_all(w);
 }
 
 static void
@@ -1603,6 +1746,8 @@ handle_event_pinch(struct libinput_event *ev, struct window *w)
 	default:
 		abort();
 	}
+
+	window_damage_all(w);
 }
 
 static void
@@ -1625,6 +1770,8 @@ handle_event_hold(struct libinput_event *ev, struct window *w)
 	default:
 		abort();
 	}
+
+	window_damage_all(w);
 }
 
 static void
@@ -1708,6 +1855,8 @@ handle_event_tablet(struct libinput_event *ev, struct window *w)
 	default:
 		abort();
 	}
+
+	window_damage_all(w);
 }
 
 static void
@@ -1745,6 +1894,8 @@ handle_event_tablet_pad(struct libinput_event *ev, struct window *w)
 	default:
 		abort();
 	}
+
+	window_damage_all(w);
 }
 
 static gboolean
@@ -1829,7 +1980,6 @@ handle_event_libinput(GIOChannel *source, GIOCondition condition, gpointer data)
 
 		libinput_event_destroy(ev);
 	}
-	gtk_widget_queue_draw(w->area);
 
 	return TRUE;
 }
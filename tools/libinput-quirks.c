@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <getopt.h>
+#include <limits.h>
 #include <sys/stat.h>
 
 #include "quirks.h"
@@ -81,8 +82,15 @@ usage(void)
 	       "  libinput quirks list [--data-dir /path/to/quirks/dir] /dev/input/event0\n"
 	       "	Print the quirks for the given device\n"
 	       "\n"
-	       "  libinput quirks validate [--data-dir /path/to/quirks/dir]\n"
-	       "	Validate the database\n");
+	       "  libinput quirks validate [--data-dir /path/to/quirks/dir] [--jobs N] [--state-file /path/to/state]\n"
+	       "	Validate the database, parsing files across N threads\n"
+	       "	(default: one per CPU). With a state file, files\n"
+	       "	unchanged since the last successful validation are\n"
+	       "	skipped.\n"
+	       "\n"
+	       "  libinput quirks compile [--data-dir /path/to/quirks/dir] [output-file]\n"
+	       "	Compile the database into a binary cache\n"
+	       "	(default: quirks.cache in the data dir)\n");
 }
 
 static void
@@ -102,6 +110,10 @@ main(int argc, char **argv)
 	int rc = 1;
 	struct quirks_context *quirks;
 	bool validate = false;
+	const char *compile_path = NULL;
+	bool compile = false;
+	const char *state_file = NULL;
+	unsigned int jobs = 0;
 
 	while (1) {
 		int c;
@@ -109,11 +121,15 @@ main(int argc, char **argv)
 		enum {
 			OPT_VERBOSE,
 			OPT_DATADIR,
+			OPT_JOBS,
+			OPT_STATEFILE,
 		};
 		static struct option opts[] = {
-			{ "help",     no_argument,       0, 'h' },
-			{ "verbose",  no_argument,       0, OPT_VERBOSE },
-			{ "data-dir", required_argument, 0, OPT_DATADIR },
+			{ "help",       no_argument,       0, 'h' },
+			{ "verbose",    no_argument,       0, OPT_VERBOSE },
+			{ "data-dir",   required_argument, 0, OPT_DATADIR },
+			{ "jobs",       required_argument, 0, OPT_JOBS },
+			{ "state-file", required_argument, 0, OPT_STATEFILE },
 			{ 0, 0, 0, 0}
 		};
 
@@ -135,6 +151,15 @@ main(int argc, char **argv)
 		case OPT_DATADIR:
 			data_path = optarg;
 			break;
+		case OPT_JOBS:
+			if (!safe_atou(optarg, &jobs) || jobs == 0) {
+				usage();
+				return 1;
+			}
+			break;
+		case OPT_STATEFILE:
+			state_file = optarg;
+			break;
 		default:
 			usage();
 			return 1;
@@ -159,6 +184,11 @@ main(int argc, char **argv)
 			return 1;
 		}
 		validate = true;
+	} else if (streq(argv[optind], "compile")) {
+		optind++;
+		if (optind < argc)
+			compile_path = argv[optind];
+		compile = true;
 	} else {
 		fprintf(stderr, "Unnkown action '%s'\n", argv[optind]);
 		return 1;
@@ -166,14 +196,32 @@ main(int argc, char **argv)
 
 	/* Overriding the data dir means no custom override file */
 	if (!data_path) {
-		char *builddir = builddir_lookup();
-		if (builddir) {
-			data_path = LIBINPUT_QUIRKS_SRCDIR;
-			free(builddir);
-		} else {
-			data_path = LIBINPUT_QUIRKS_DIR;
-			override_file = LIBINPUT_QUIRKS_OVERRIDE_FILE;
-		}
+		const struct data_paths *paths = data_paths_get();
+
+		data_path = paths->quirks_dir;
+		override_file = paths->quirks_override_file;
+	}
+
+	/* The cache must not have the override properties baked in */
+	if (compile)
+		override_file = NULL;
+
+	/* Validation doesn't need a matching context, it parses the
+	 * files in parallel instead */
+	if (validate) {
+		if (quirks_validate_files(data_path,
+					  override_file,
+					  state_file,
+					  jobs,
+					  log_handler,
+					  NULL,
+					  QLOG_CUSTOM_LOG_PRIORITIES))
+			return 0;
+
+		fprintf(stderr,
+			"Validation failed. Please see the above errors "
+			"and/or re-run with --verbose for more details\n");
+		return 1;
 	}
 
 	quirks = quirks_init_subsystem(data_path,
@@ -189,8 +237,22 @@ main(int argc, char **argv)
 		return 1;
 	}
 
-	if (validate) {
-		rc = 0;
+	if (compile) {
+		char default_path[PATH_MAX];
+
+		if (!compile_path) {
+			snprintf(default_path, sizeof(default_path),
+				 "%s/quirks.cache", data_path);
+			compile_path = default_path;
+		}
+		if (quirks_cache_compile(quirks, data_path, compile_path)) {
+			rc = 0;
+		} else {
+			fprintf(stderr,
+				"Failed to compile the quirks cache to %s\n",
+				compile_path);
+			rc = 1;
+		}
 		goto out;
 	}
 
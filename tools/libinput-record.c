@@ -38,11 +38,16 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <poll.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <time.h>
 
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "libinput-versionsort.h"
 #include "libinput-version.h"
 #include "libinput-git-version.h"
@@ -181,6 +186,435 @@ obfuscate_keycode(struct input_event *ev)
 	return false;
 }
 
+/* Flight recorder. Continuously writing to disk is too expensive for an
+ * always-on recording on production machines, but a bug report is useless
+ * without the events leading up to the bug. In flight mode the formatted
+ * records are kept in a preallocated in-memory ring holding the trailing
+ * few seconds instead of being written out; SIGUSR1 dumps a self-contained
+ * recording - header, device descriptions, buffered events - to a fresh
+ * output file and the window starts over.
+ */
+
+/* Upper bound on formatted records per second per recording; a 1kHz mouse
+ * produces 4 records per frame */
+#define FLIGHT_RECORDS_PER_SEC 8192
+
+struct flight_record {
+	FILE *sink;
+	uint64_t time;
+	uint16_t len;
+	char data[238]; /* keeps the struct at 256 bytes */
+};
+
+struct flight_recorder {
+	bool enabled;
+	bool dumping;	/* write records through instead of buffering */
+	uint64_t window; /* trailing time to keep, in µs */
+	struct flight_record *records;
+	size_t nrecords;
+	size_t head;	/* next record to fill */
+	size_t count;
+};
+
+static struct flight_recorder flight;
+
+static uint64_t
+flight_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return s2us(ts.tv_sec) + ns2us(ts.tv_nsec);
+}
+
+static bool
+flight_start(void)
+{
+	struct flight_recorder *f = &flight;
+
+	f->nrecords = f->window / s2us(1) * FLIGHT_RECORDS_PER_SEC;
+	f->records = calloc(f->nrecords, sizeof(*f->records));
+	if (!f->records)
+		return false;
+
+	f->head = f->count = 0;
+
+	return true;
+}
+
+static void
+flight_stop(void)
+{
+	struct flight_recorder *f = &flight;
+
+	free(f->records);
+	f->records = NULL;
+}
+
+static void
+flight_append(FILE *sink, const char *buf, size_t len)
+{
+	struct flight_recorder *f = &flight;
+	struct flight_record *r = &f->records[f->head];
+
+	r->sink = sink;
+	r->time = flight_now();
+
+	/* Overlong lines (rare, comment-only) are cut rather than spilled
+	 * across records; keep the newline so the YAML stays intact */
+	if (len > sizeof(r->data)) {
+		len = sizeof(r->data);
+		memcpy(r->data, buf, len);
+		r->data[len - 1] = '\n';
+	} else {
+		memcpy(r->data, buf, len);
+	}
+	r->len = len;
+
+	f->head = (f->head + 1) % f->nrecords;
+	if (f->count < f->nrecords)
+		f->count++;
+}
+
+static bool
+flight_divert(FILE *sink, const char *buf, size_t len)
+{
+	if (!flight.enabled || flight.dumping)
+		return false;
+
+	flight_append(sink, buf, len);
+
+	return true;
+}
+
+/**
+ * Write out all buffered records for the given sink that are younger than
+ * the cutoff, oldest first.
+ */
+static void
+flight_replay(FILE *sink, uint64_t cutoff, FILE *out)
+{
+	struct flight_recorder *f = &flight;
+	size_t tail = (f->head + f->nrecords - f->count) % f->nrecords;
+
+	for (size_t i = 0; i < f->count; i++) {
+		struct flight_record *r = &f->records[(tail + i) % f->nrecords];
+
+		if (r->sink == sink && r->time >= cutoff)
+			fwrite(r->data, 1, r->len, out);
+	}
+}
+
+/* Background output writer. Formatting an event costs a few hundred
+ * nanoseconds, but synchronously pushing the result through stdio to disk
+ * can stall the recording loop long enough to perturb the very timings we
+ * are trying to capture. The event loop formats into fixed-size records
+ * that are memcpy'd into a preallocated ring; a writer thread drains the
+ * ring into the target files.
+ */
+struct writer_record {
+	FILE *sink;
+	uint16_t len;
+	char data[1278];
+};
+
+struct record_writer {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct writer_record *records;
+	size_t nrecords;
+	size_t head;  /* next record to fill */
+	size_t tail;  /* next record to write out */
+	size_t count;
+	bool stop;
+	bool running;
+};
+
+static struct record_writer writer = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void *
+record_writer_thread(void *data)
+{
+	struct record_writer *w = data;
+
+	pthread_mutex_lock(&w->lock);
+	while (true) {
+		FILE *last_sink = NULL;
+
+		while (w->count == 0 && !w->stop)
+			pthread_cond_wait(&w->cond, &w->lock);
+
+		if (w->count == 0 && w->stop)
+			break;
+
+		while (w->count > 0) {
+			struct writer_record *r = &w->records[w->tail];
+
+			/* The main thread only ever touches records
+			 * counted as free, we can write without the lock */
+			pthread_mutex_unlock(&w->lock);
+			fwrite(r->data, 1, r->len, r->sink);
+			last_sink = r->sink;
+			pthread_mutex_lock(&w->lock);
+
+			w->tail = (w->tail + 1) % w->nrecords;
+			w->count--;
+			pthread_cond_broadcast(&w->cond);
+		}
+
+		/* Ring drained, push the data out so live consumers
+		 * (stdout pipes) see it */
+		if (last_sink) {
+			pthread_mutex_unlock(&w->lock);
+			fflush(last_sink);
+			pthread_mutex_lock(&w->lock);
+		}
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+/**
+ * Wait until all queued records have been written out.
+ */
+static void
+record_writer_flush(void)
+{
+	struct record_writer *w = &writer;
+
+	if (!w->running)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	while (w->count > 0)
+		pthread_cond_wait(&w->cond, &w->lock);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void
+record_writer_append(FILE *sink, const char *buf, size_t len)
+{
+	struct record_writer *w = &writer;
+	struct writer_record *r;
+
+	if (flight_divert(sink, buf, len))
+		return;
+
+	if (!w->running) {
+		fwrite(buf, 1, len, sink);
+		return;
+	}
+
+	/* Oversized records are rare (long comment lines), take the
+	 * slow path rather than complicating the ring */
+	if (len > sizeof(r->data)) {
+		record_writer_flush();
+		fwrite(buf, 1, len, sink);
+		return;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	while (w->count == w->nrecords)
+		pthread_cond_wait(&w->cond, &w->lock);
+
+	r = &w->records[w->head];
+	r->sink = sink;
+	r->len = len;
+	memcpy(r->data, buf, len);
+
+	w->head = (w->head + 1) % w->nrecords;
+	w->count++;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void
+record_writer_start(void)
+{
+	struct record_writer *w = &writer;
+
+	w->nrecords = 2048;
+	w->records = calloc(w->nrecords, sizeof(*w->records));
+	if (!w->records)
+		return; /* fall back to synchronous writes */
+
+	w->head = w->tail = w->count = 0;
+	w->stop = false;
+	if (pthread_create(&w->thread, NULL, record_writer_thread, w) != 0) {
+		free(w->records);
+		w->records = NULL;
+		return;
+	}
+
+	w->running = true;
+}
+
+static void
+record_writer_stop(void)
+{
+	struct record_writer *w = &writer;
+
+	if (!w->running)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	w->stop = true;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+
+	free(w->records);
+	w->records = NULL;
+	w->running = false;
+}
+
+#if HAVE_ZSTD
+/* Compressed output. A recording named *.zst is compressed inline
+ * instead of gzipped after the fact, which reads and rewrites the whole
+ * file. Implemented as a fopencookie() shim wrapping the output file so
+ * the rest of the tool keeps writing plain stdio; with the writer thread
+ * running the compression happens off the event loop, too. The frame is
+ * flushed through to disk periodically so a crash loses at most the
+ * trailing second.
+ */
+
+#define ZSTD_FLUSH_INTERVAL s2us(1)
+
+struct zstd_sink {
+	FILE *fp;		/* the real output file */
+	ZSTD_CStream *stream;
+	void *buf;
+	size_t bufsize;
+	uint64_t last_flush;
+};
+
+static ssize_t
+zstd_sink_write(void *cookie, const char *data, size_t len)
+{
+	struct zstd_sink *sink = cookie;
+	ZSTD_inBuffer in = { data, len, 0 };
+	ZSTD_EndDirective mode = ZSTD_e_continue;
+	uint64_t now = flight_now();
+	size_t remaining;
+
+	if (now - sink->last_flush >= ZSTD_FLUSH_INTERVAL) {
+		mode = ZSTD_e_flush;
+		sink->last_flush = now;
+	}
+
+	do {
+		ZSTD_outBuffer out = { sink->buf, sink->bufsize, 0 };
+
+		remaining = ZSTD_compressStream2(sink->stream, &out, &in, mode);
+		if (ZSTD_isError(remaining))
+			return -1;
+		if (out.pos > 0 &&
+		    fwrite(sink->buf, 1, out.pos, sink->fp) != out.pos)
+			return -1;
+	} while (in.pos < in.size ||
+		 (mode == ZSTD_e_flush && remaining > 0));
+
+	return len;
+}
+
+static int
+zstd_sink_close(void *cookie)
+{
+	struct zstd_sink *sink = cookie;
+	ZSTD_inBuffer in = { NULL, 0, 0 };
+	size_t remaining;
+	int rc = 0;
+
+	/* Finish the frame */
+	do {
+		ZSTD_outBuffer out = { sink->buf, sink->bufsize, 0 };
+
+		remaining = ZSTD_compressStream2(sink->stream,
+						 &out,
+						 &in,
+						 ZSTD_e_end);
+		if (ZSTD_isError(remaining)) {
+			rc = -1;
+			break;
+		}
+		if (out.pos > 0 &&
+		    fwrite(sink->buf, 1, out.pos, sink->fp) != out.pos) {
+			rc = -1;
+			break;
+		}
+	} while (remaining > 0);
+
+	if (fclose(sink->fp) != 0)
+		rc = -1;
+	ZSTD_freeCStream(sink->stream);
+	free(sink->buf);
+	free(sink);
+
+	return rc;
+}
+
+/**
+ * Wrap the given output file in a compressing stream. On success the
+ * caller must only use the returned FILE, closing it finishes the
+ * frame and closes fp too.
+ */
+static FILE *
+zstd_sink_open(FILE *fp)
+{
+	struct zstd_sink *sink;
+	cookie_io_functions_t funcs = {
+		.write = zstd_sink_write,
+		.close = zstd_sink_close,
+	};
+	FILE *zfp;
+
+	sink = zalloc(sizeof *sink);
+	sink->fp = fp;
+	sink->stream = ZSTD_createCStream();
+	sink->bufsize = ZSTD_CStreamOutSize();
+	sink->buf = zalloc(sink->bufsize);
+	sink->last_flush = flight_now();
+
+	zfp = fopencookie(sink, "w", funcs);
+	if (!zfp) {
+		ZSTD_freeCStream(sink->stream);
+		free(sink->buf);
+		free(sink);
+		return NULL;
+	}
+
+	return zfp;
+}
+#endif /* HAVE_ZSTD */
+
+static FILE *
+open_compressed_or_plain(const char *fname)
+{
+	FILE *fp = fopen(fname, "w");
+
+	if (!fp)
+		return NULL;
+
+#if HAVE_ZSTD
+	if (strendswith(fname, ".zst")) {
+		FILE *zfp = zstd_sink_open(fp);
+
+		if (!zfp) {
+			fclose(fp);
+			return NULL;
+		}
+		fp = zfp;
+	}
+#endif
+
+	return fp;
+}
+
 /**
  * Indented dprintf, indentation is in the context
  */
@@ -192,6 +626,7 @@ iprintf(FILE *fp,
 {
 	va_list args;
 	char fmt[1024];
+	char buf[2048];
 	static const char space[] = "                                     ";
 	static const size_t len = sizeof(space);
 	int rc;
@@ -212,11 +647,13 @@ iprintf(FILE *fp,
 	va_start(args, format);
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
-	rc = vfprintf(fp, fmt, args);
+	rc = vsnprintf(buf, sizeof(buf), fmt, args);
 #pragma GCC diagnostic pop
 	va_end(args);
 
 	assert(rc != -1 && (unsigned int)rc > indent);
+
+	record_writer_append(fp, buf, min((size_t)rc, sizeof(buf) - 1));
 }
 
 static uint64_t
@@ -225,6 +662,35 @@ time_offset(struct record_context *ctx, uint64_t time)
 	return ctx->offset ? time - ctx->offset : 0;
 }
 
+/* Write value as right-aligned decimal of at least width chars, the
+ * field widths match the printf formats previously used for the event
+ * lines so existing recordings diff cleanly. Returns the write position
+ * after the number. */
+static char *
+fmt_decimal(char *p, int64_t value, int width)
+{
+	char digits[20];
+	int ndigits = 0;
+	uint64_t v;
+	bool negative = value < 0;
+
+	v = negative ? 0 - (uint64_t)value : (uint64_t)value;
+	do {
+		digits[ndigits++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+
+	if (negative)
+		digits[ndigits++] = '-';
+
+	for (int pad = width - ndigits; pad > 0; pad--)
+		*p++ = ' ';
+	while (ndigits)
+		*p++ = digits[--ndigits];
+
+	return p;
+}
+
 static void
 print_evdev_event(struct record_device *dev,
 		  struct input_event *ev)
@@ -353,15 +819,42 @@ print_evdev_event(struct record_device *dev,
 			 was_modified ? " (obfuscated)" : "");
 	}
 
-	iprintf(dev->fp,
-		I_EVENT,
-		"- [%3lu, %6u, %3d, %3d, %7d] # %s\n",
-		ev->input_event_sec,
-		(unsigned int)ev->input_event_usec,
-		ev->type,
-		ev->code,
-		ev->value,
-		desc);
+	/* The event line is the hot path of a recording - at high event
+	 * rates the printf machinery in iprintf() (format assembly plus
+	 * vsnprintf) dominates the cost, so the fixed
+	 * "- [sec, usec, type, code, value] # desc" shape is assembled
+	 * with plain decimal conversions instead */
+	char line[sizeof(desc) + 64];
+	char *p = line;
+	size_t dlen = min(strlen(desc), sizeof(desc) - 1);
+
+	memset(p, ' ', I_EVENT - 2); /* the '- ' takes one indent level */
+	p += I_EVENT - 2;
+	*p++ = '-';
+	*p++ = ' ';
+	*p++ = '[';
+	p = fmt_decimal(p, (int64_t)ev->input_event_sec, 3);
+	*p++ = ',';
+	*p++ = ' ';
+	p = fmt_decimal(p, (unsigned int)ev->input_event_usec, 6);
+	*p++ = ',';
+	*p++ = ' ';
+	p = fmt_decimal(p, ev->type, 3);
+	*p++ = ',';
+	*p++ = ' ';
+	p = fmt_decimal(p, ev->code, 3);
+	*p++ = ',';
+	*p++ = ' ';
+	p = fmt_decimal(p, ev->value, 7);
+	*p++ = ']';
+	*p++ = ' ';
+	*p++ = '#';
+	*p++ = ' ';
+	memcpy(p, desc, dlen);
+	p += dlen;
+	*p++ = '\n';
+
+	record_writer_append(dev->fp, line, p - line);
 }
 
 static bool
@@ -1327,8 +1820,6 @@ handle_events(struct record_context *ctx, struct record_device *d)
 							     d,
 							     !has_events);
 	}
-
-	fflush(d->fp);
 }
 
 static void
@@ -1758,20 +2249,15 @@ print_device_quirks(struct record_device *dev)
 	struct udev_device *udev_device = NULL;
 	struct stat st;
 	struct quirks_context *quirks;
-	const char *data_path = LIBINPUT_QUIRKS_DIR;
-	const char *override_file = LIBINPUT_QUIRKS_OVERRIDE_FILE;
-	char *builddir = NULL;
+	const struct data_paths *paths = data_paths_get();
+	const char *data_path = paths->quirks_dir;
+	const char *override_file = paths->quirks_override_file;
 
 	if (stat(dev->devnode, &st) < 0)
 		return;
 
-	if ((builddir = builddir_lookup())) {
-		setenv("LIBINPUT_QUIRKS_DIR", LIBINPUT_QUIRKS_SRCDIR, 0);
-		data_path = LIBINPUT_QUIRKS_SRCDIR;
-		override_file = NULL;
-	}
-
-	free(builddir);
+	if (paths->builddir)
+		setenv("LIBINPUT_QUIRKS_DIR", paths->quirks_dir, 0);
 
 	quirks = quirks_init_subsystem(data_path,
 				       override_file,
@@ -1976,15 +2462,26 @@ init_output_file(const char *file, bool is_prefix)
 		struct tm *tm;
 		time_t t;
 		char suffix[64];
+		char stem[PATH_MAX];
+		const char *ext = "";
+
+		/* Splice the timestamp in before a .zst extension so the
+		 * dumps are both compressed and recognizable as such */
+		snprintf(stem, sizeof(stem), "%s", file);
+		if (strendswith(stem, ".zst")) {
+			stem[strlen(stem) - 4] = '\0';
+			ext = ".zst";
+		}
 
 		t = time(NULL);
 		tm = localtime(&t);
 		strftime(suffix, sizeof(suffix), "%F-%T", tm);
 		snprintf(name,
 			 sizeof(name),
-			 "%s.%s",
-			 file,
-			 suffix);
+			 "%s.%s%s",
+			 stem,
+			 suffix,
+			 ext);
 	} else {
 		snprintf(name, sizeof(name), "%s", file);
 	}
@@ -1998,10 +2495,19 @@ open_output_files(struct record_context *ctx, bool is_prefix)
 	FILE *out_file;
 	struct record_device *d;
 
+	if (flight.enabled) {
+		/* Each dump opens its own file. The fps are only used as
+		 * per-device sink tags in the flight ring, nothing is ever
+		 * written to them */
+		list_for_each(d, &ctx->devices, link)
+			d->fp = tmpfile();
+		return true;
+	}
+
 	if (ctx->output_file.name) {
 		char *fname = init_output_file(ctx->output_file.name, is_prefix);
 		ctx->output_file.name_with_suffix = fname;
-		out_file = fopen(fname, "w");
+		out_file = open_compressed_or_plain(fname);
 		if (!out_file)
 			return false;
 	} else {
@@ -2104,13 +2610,76 @@ destroy_source(struct record_context *ctx, struct source *source)
 	free(source);
 }
 
+/**
+ * Dump the flight ring as a self-contained recording: a fresh header,
+ * then per device its description followed by that device's trailing
+ * events. Recording continues afterwards with an empty ring, a later
+ * dump does not repeat what is already on disk.
+ */
+static void
+flight_dump(struct record_context *ctx)
+{
+	struct flight_recorder *f = &flight;
+	struct record_device *d;
+	uint64_t now = flight_now();
+	uint64_t cutoff = now > f->window ? now - f->window : 0;
+	char *fname;
+	FILE *fp;
+
+	fname = init_output_file(ctx->output_file.name, true);
+	fp = open_compressed_or_plain(fname);
+	if (!fp) {
+		fprintf(stderr, "Failed to open '%s' (%m)\n", fname);
+		free(fname);
+		return;
+	}
+
+	/* iprintf must write through to the dump file, not back into the
+	 * ring */
+	f->dumping = true;
+
+	print_header(fp, ctx);
+	iprintf(fp,
+		I_NONE,
+		"# Flight recorder dump, trailing %lus\n",
+		(unsigned long)(f->window / s2us(1)));
+	iprintf(fp, I_TOPLEVEL, "devices:\n");
+
+	list_for_each(d, &ctx->devices, link) {
+		FILE *sink = d->fp;
+
+		d->fp = fp;
+		print_device_description(d);
+		iprintf(fp, I_DEVICE, "events:\n");
+		flight_replay(sink, cutoff, fp);
+		d->fp = sink;
+	}
+
+	fflush(fp);
+	fclose(fp);
+
+	f->dumping = false;
+	f->head = f->count = 0;
+
+	fprintf(stderr,
+		"%sFlight recorder dumped to '%s'\n",
+		isatty(STDERR_FILENO) ? "" : "# ",
+		fname);
+	free(fname);
+}
+
 static void
 signalfd_dispatch(struct record_context *ctx, int fd, void *data)
 {
-	struct signalfd_siginfo fdsi;
+	struct signalfd_siginfo fdsi = {0};
 
 	(void)read(fd, &fdsi, sizeof(fdsi));
 
+	if (flight.enabled && fdsi.ssi_signo == SIGUSR1) {
+		flight_dump(ctx);
+		return;
+	}
+
 	ctx->stop = true;
 }
 
@@ -2202,9 +2771,16 @@ mainloop(struct record_context *ctx)
 	ctx->epoll_fd = epoll_create1(0);
 	assert(ctx->epoll_fd >= 0);
 
+	/* In flight mode nothing is written until a dump and the dump is
+	 * synchronous anyway, the writer thread has nothing to do */
+	if (!flight.enabled)
+		record_writer_start();
+
 	sigemptyset(&mask);
 	sigaddset(&mask, SIGINT);
 	sigaddset(&mask, SIGQUIT);
+	if (flight.enabled)
+		sigaddset(&mask, SIGUSR1);
 	sigprocmask(SIG_BLOCK, &mask, NULL);
 
 	sigfd = signalfd(-1, &mask, SFD_NONBLOCK);
@@ -2251,26 +2827,37 @@ mainloop(struct record_context *ctx)
 				ctx->output_file.name_with_suffix);
 			break;
 		}
-		fprintf(stderr, "%sRecording to '%s'.\n",
-			isatty(STDERR_FILENO) ? "" : "# ",
-			ctx->output_file.name_with_suffix);
+		if (flight.enabled)
+			fprintf(stderr,
+				"%sFlight recorder armed, "
+				"send SIGUSR1 to dump the last %lus.\n",
+				isatty(STDERR_FILENO) ? "" : "# ",
+				(unsigned long)(flight.window / s2us(1)));
+		else
+			fprintf(stderr, "%sRecording to '%s'.\n",
+				isatty(STDERR_FILENO) ? "" : "# ",
+				ctx->output_file.name_with_suffix);
 
 		ctx->had_events = false;
 
-		print_header(ctx->first_device->fp, ctx);
-		if (autorestart)
-			iprintf(ctx->first_device->fp,
-				I_NONE,
-				"# Autorestart timeout: %d\n",
-				ctx->timeout);
+		/* In flight mode the header and descriptions are printed
+		 * fresh on every dump, only events go into the ring */
+		if (!flight.enabled) {
+			print_header(ctx->first_device->fp, ctx);
+			if (autorestart)
+				iprintf(ctx->first_device->fp,
+					I_NONE,
+					"# Autorestart timeout: %d\n",
+					ctx->timeout);
 
-		iprintf(ctx->first_device->fp, I_TOPLEVEL, "devices:\n");
+			iprintf(ctx->first_device->fp, I_TOPLEVEL, "devices:\n");
 
-		/* we only print the first device's description, the
-		 * rest is assembled after CTRL+C */
-		list_for_each(d, &ctx->devices, link) {
-			print_device_description(d);
-			iprintf(d->fp, I_DEVICE, "events:\n");
+			/* we only print the first device's description, the
+			 * rest is assembled after CTRL+C */
+			list_for_each(d, &ctx->devices, link) {
+				print_device_description(d);
+				iprintf(d->fp, I_DEVICE, "events:\n");
+			}
 		}
 		print_wall_time(ctx);
 
@@ -2313,6 +2900,10 @@ mainloop(struct record_context *ctx)
 			}
 		}
 
+		/* All queued records must be on disk before we read the
+		 * per-device tmpfiles back or close anything */
+		record_writer_flush();
+
 		/* First device is printed, now append all the data from the
 		 * other devices, if any */
 		list_for_each(d, &ctx->devices, link) {
@@ -2356,6 +2947,9 @@ mainloop(struct record_context *ctx)
 		ctx->output_file.name_with_suffix = NULL;
 	} while (autorestart && !ctx->stop);
 
+	record_writer_stop();
+	flight_stop();
+
 	sigprocmask(SIG_UNBLOCK, &mask, NULL);
 
 	list_for_each_safe(source, &ctx->sources, link) {
@@ -2539,11 +3133,16 @@ usage(void)
 	       " sudo %s -o recording.yml /dev/input/event3 /dev/input/event4\n"
 	       "    Records the two devices into the same recordings file.\n"
 	       "\n"
+	       " sudo %s -o recording.yml --flight-recorder 30 /dev/input/event3\n"
+	       "    Keeps the last 30s of events in memory only; sending\n"
+	       "    SIGUSR1 dumps them into a timestamped file.\n"
+	       "\n"
 	       "For more information, see the %s(1) man page\n",
 	       program_invocation_short_name,
 	       program_invocation_short_name,
 	       program_invocation_short_name,
 	       program_invocation_short_name,
+	       program_invocation_short_name,
 	       program_invocation_short_name);
 }
 
@@ -2641,6 +3240,7 @@ enum options {
 	OPT_LIBINPUT,
 	OPT_HIDRAW,
 	OPT_GRAB,
+	OPT_FLIGHT,
 };
 
 int
@@ -2660,6 +3260,7 @@ main(int argc, char **argv)
 		{ "with-libinput", no_argument, 0, OPT_LIBINPUT },
 		{ "with-hidraw", no_argument, 0, OPT_HIDRAW },
 		{ "grab", no_argument, 0, OPT_GRAB },
+		{ "flight-recorder", required_argument, 0, OPT_FLIGHT },
 		{ 0, 0, 0, 0 },
 	};
 	struct record_device *d;
@@ -2720,6 +3321,18 @@ main(int argc, char **argv)
 		case OPT_GRAB:
 			grab = true;
 			break;
+		case OPT_FLIGHT: {
+			int seconds;
+
+			if (!safe_atoi(optarg, &seconds) || seconds <= 0) {
+				usage();
+				rc = EXIT_INVALID_USAGE;
+				goto out;
+			}
+			flight.enabled = true;
+			flight.window = s2us(seconds);
+			break;
+		}
 		default:
 			usage();
 			rc = EXIT_INVALID_USAGE;
@@ -2759,6 +3372,31 @@ main(int argc, char **argv)
 		goto out;
 	}
 
+	if (flight.enabled && output_arg == NULL) {
+		fprintf(stderr,
+			"Option --flight-recorder requires --output-file\n");
+		rc = EXIT_INVALID_USAGE;
+		goto out;
+	}
+
+#if !HAVE_ZSTD
+	if (output_arg && strendswith(output_arg, ".zst")) {
+		fprintf(stderr,
+			"This build was compiled without zstd support, "
+			"cannot write compressed recordings\n");
+		rc = EXIT_INVALID_USAGE;
+		goto out;
+	}
+#endif
+
+	if (flight.enabled && ctx.timeout > 0) {
+		fprintf(stderr,
+			"Option --flight-recorder cannot be combined "
+			"with --autorestart\n");
+		rc = EXIT_INVALID_USAGE;
+		goto out;
+	}
+
 	ctx.output_file.name = safe_strdup(output_arg);
 
 	if (output_arg == NULL && (all || ndevices > 1)) {
@@ -2795,6 +3433,12 @@ main(int argc, char **argv)
 	if (with_hidraw && !init_hidraw(&ctx))
 		goto out;
 
+	if (flight.enabled && !flight_start()) {
+		fprintf(stderr,
+			"Failed to preallocate the flight recorder ring\n");
+		goto out;
+	}
+
 	rc = mainloop(&ctx);
 out:
 	strv_free(paths);
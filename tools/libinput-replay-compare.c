@@ -0,0 +1,483 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Differential replay harness: two builds of libinput.so are loaded
+ * side by side with dlopen(RTLD_LOCAL) and the same recording is
+ * replayed through both via uinput. Each build gets its own path
+ * context on the replayed device nodes; after every batch of kernel
+ * events both contexts are dispatched and their wall time and emitted
+ * events recorded. The report shows the timing delta per stage
+ * (dispatch vs event retrieval) and any divergence in the event
+ * streams.
+ *
+ * This tool deliberately does not link against libinput; all entry
+ * points are resolved with dlsym() so the two builds under test are
+ * the only copies of the library in the process.
+ */
+
+#include "config.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libinput.h>
+#include <libevdev/libevdev-uinput.h>
+
+#include "util-macros.h"
+#include "util-time.h"
+
+#include "replay-recording.h"
+
+/* largest event type value plus headroom, see enum libinput_event_type */
+#define MAX_EVENT_TYPE 1024
+
+/* dispatch passes after the replay so pending timers (tap, debounce,
+ * scroll timeouts, ...) resolve in both builds before the diff */
+#define SETTLE_PASSES 5
+#define SETTLE_INTERVAL_MS 100
+
+struct libinput_api {
+	void *handle;
+	const char *path;
+
+	struct libinput *(*path_create_context)(
+			const struct libinput_interface *interface,
+			void *user_data);
+	struct libinput_device *(*path_add_device)(struct libinput *libinput,
+						   const char *path);
+	int (*dispatch)(struct libinput *libinput);
+	struct libinput_event *(*get_event)(struct libinput *libinput);
+	enum libinput_event_type (*event_get_type)(
+			struct libinput_event *event);
+	void (*event_destroy)(struct libinput_event *event);
+	struct libinput *(*unref)(struct libinput *libinput);
+};
+
+struct run {
+	char label; /* 'A' or 'B' */
+	struct libinput_api api;
+	struct libinput *li;
+
+	uint64_t ncycles;
+	uint64_t dispatch_ns;
+	uint64_t dispatch_max_ns;
+	uint64_t retrieve_ns;
+
+	/* emitted event types in order, for the divergence check */
+	uint32_t *types;
+	size_t ntypes;
+	size_t types_sz;
+	uint64_t counts[MAX_EVENT_TYPE];
+};
+
+struct compare_context {
+	struct run runs[2];
+};
+
+static int
+libinput_api_load(struct libinput_api *api, const char *path)
+{
+	api->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!api->handle) {
+		fprintf(stderr, "Failed to load %s (%s)\n", path, dlerror());
+		return -EINVAL;
+	}
+	api->path = path;
+
+#define SYM(field_, name_) do { \
+	api->field_ = dlsym(api->handle, name_); \
+	if (!api->field_) { \
+		fprintf(stderr, "%s: missing symbol %s\n", path, name_); \
+		return -EINVAL; \
+	} \
+} while (0)
+	SYM(path_create_context, "libinput_path_create_context");
+	SYM(path_add_device, "libinput_path_add_device");
+	SYM(dispatch, "libinput_dispatch");
+	SYM(get_event, "libinput_get_event");
+	SYM(event_get_type, "libinput_event_get_type");
+	SYM(event_destroy, "libinput_event_destroy");
+	SYM(unref, "libinput_unref");
+#undef SYM
+
+	return 0;
+}
+
+static int
+open_restricted(const char *path, int flags, void *user_data)
+{
+	int fd = open(path, flags);
+
+	return fd < 0 ? -errno : fd;
+}
+
+static void
+close_restricted(int fd, void *user_data)
+{
+	close(fd);
+}
+
+static const struct libinput_interface interface = {
+	.open_restricted = open_restricted,
+	.close_restricted = close_restricted,
+};
+
+static inline uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static const char *
+event_type_name(uint32_t type)
+{
+#define CASE(type_) case LIBINPUT_EVENT_##type_: return #type_
+	switch ((enum libinput_event_type)type) {
+	CASE(NONE);
+	CASE(DEVICE_ADDED);
+	CASE(DEVICE_REMOVED);
+	CASE(DEVICE_CONFIG_CHANGED);
+	CASE(KEYBOARD_KEY);
+	CASE(POINTER_MOTION);
+	CASE(POINTER_MOTION_ABSOLUTE);
+	CASE(POINTER_BUTTON);
+	CASE(POINTER_AXIS);
+	CASE(POINTER_SCROLL_WHEEL);
+	CASE(POINTER_SCROLL_FINGER);
+	CASE(POINTER_SCROLL_CONTINUOUS);
+	CASE(TOUCH_DOWN);
+	CASE(TOUCH_UP);
+	CASE(TOUCH_MOTION);
+	CASE(TOUCH_CANCEL);
+	CASE(TOUCH_FRAME);
+	CASE(TABLET_TOOL_AXIS);
+	CASE(TABLET_TOOL_PROXIMITY);
+	CASE(TABLET_TOOL_TIP);
+	CASE(TABLET_TOOL_BUTTON);
+	CASE(TABLET_PAD_BUTTON);
+	CASE(TABLET_PAD_RING);
+	CASE(TABLET_PAD_STRIP);
+	CASE(TABLET_PAD_KEY);
+	CASE(GESTURE_SWIPE_BEGIN);
+	CASE(GESTURE_SWIPE_UPDATE);
+	CASE(GESTURE_SWIPE_END);
+	CASE(GESTURE_PINCH_BEGIN);
+	CASE(GESTURE_PINCH_UPDATE);
+	CASE(GESTURE_PINCH_END);
+	CASE(GESTURE_HOLD_BEGIN);
+	CASE(GESTURE_HOLD_END);
+	CASE(SWITCH_TOGGLE);
+	}
+#undef CASE
+	return "UNKNOWN";
+}
+
+static void
+run_record_event(struct run *run, uint32_t type)
+{
+	if (run->ntypes == run->types_sz) {
+		run->types_sz = run->types_sz ? run->types_sz * 2 : 4096;
+		run->types = realloc(run->types,
+				     run->types_sz * sizeof(*run->types));
+		if (!run->types) {
+			fprintf(stderr, "Failed to allocate event log\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	run->types[run->ntypes++] = type;
+	if (type < MAX_EVENT_TYPE)
+		run->counts[type]++;
+}
+
+/* One dispatch cycle: dispatch, then drain the queue. Both stages are
+ * timed separately when timed is set; the setup drains (device-added
+ * events, udev settling) are untimed so they do not pollute the
+ * steady-state numbers */
+static void
+run_dispatch(struct run *run, bool timed)
+{
+	struct libinput_event *event;
+	uint64_t t0, t1, t2;
+
+	t0 = now_ns();
+	run->api.dispatch(run->li);
+	t1 = now_ns();
+
+	while ((event = run->api.get_event(run->li))) {
+		run_record_event(run, run->api.event_get_type(event));
+		run->api.event_destroy(event);
+	}
+	t2 = now_ns();
+
+	if (timed) {
+		uint64_t cycle = t1 - t0;
+
+		run->ncycles++;
+		run->dispatch_ns += cycle;
+		run->dispatch_max_ns = max(run->dispatch_max_ns, cycle);
+		run->retrieve_ns += t2 - t1;
+	}
+}
+
+static void
+dispatch_batch(struct replay_context *ctx,
+	       struct replay_device *d,
+	       size_t first,
+	       size_t ndue,
+	       void *userdata)
+{
+	struct compare_context *compare = userdata;
+
+	run_dispatch(&compare->runs[0], true);
+	run_dispatch(&compare->runs[1], true);
+}
+
+static void
+print_timing_row(const char *name, uint64_t a_ns, uint64_t b_ns)
+{
+	double delta = 0.0;
+
+	if (a_ns > 0)
+		delta = 100.0 * ((double)b_ns - (double)a_ns) / (double)a_ns;
+
+	printf("  %-18s %12.3fms %12.3fms   %+6.1f%%\n",
+	       name,
+	       a_ns / 1e6,
+	       b_ns / 1e6,
+	       delta);
+}
+
+static void
+print_report(struct compare_context *compare)
+{
+	struct run *a = &compare->runs[0],
+		   *b = &compare->runs[1];
+	size_t ncommon = min(a->ntypes, b->ntypes);
+	size_t divergence;
+	uint32_t t;
+
+	printf("timing (%" PRIu64 " dispatch cycles):\n", a->ncycles);
+	printf("  %-18s %14s %14s\n", "", "A", "B");
+	print_timing_row("dispatch", a->dispatch_ns, b->dispatch_ns);
+	print_timing_row("worst cycle", a->dispatch_max_ns, b->dispatch_max_ns);
+	print_timing_row("event retrieval", a->retrieve_ns, b->retrieve_ns);
+
+	printf("events by type:\n");
+	for (t = 0; t < MAX_EVENT_TYPE; t++) {
+		if (a->counts[t] == 0 && b->counts[t] == 0)
+			continue;
+		printf("  %-28s %10" PRIu64 " %10" PRIu64 "%s\n",
+		       event_type_name(t),
+		       a->counts[t],
+		       b->counts[t],
+		       a->counts[t] != b->counts[t] ? "   <-- differs" : "");
+	}
+	printf("  %-28s %10zu %10zu%s\n",
+	       "total",
+	       a->ntypes,
+	       b->ntypes,
+	       a->ntypes != b->ntypes ? "   <-- differs" : "");
+
+	for (divergence = 0; divergence < ncommon; divergence++) {
+		if (a->types[divergence] != b->types[divergence])
+			break;
+	}
+
+	if (divergence < ncommon) {
+		printf("first divergence: event #%zu: %s (A) vs %s (B)\n",
+		       divergence,
+		       event_type_name(a->types[divergence]),
+		       event_type_name(b->types[divergence]));
+	} else if (a->ntypes != b->ntypes) {
+		struct run *longer = a->ntypes > b->ntypes ? a : b;
+
+		printf("first divergence: event #%zu: "
+		       "only %c continues with %s\n",
+		       ncommon,
+		       longer->label,
+		       event_type_name(longer->types[ncommon]));
+	} else {
+		printf("event streams are identical\n");
+	}
+}
+
+static inline void
+usage(void)
+{
+	printf("Usage: %s [--help] libinput-a.so libinput-b.so recording\n"
+	       "\n"
+	       "Replay a libinput-record recording through two builds of\n"
+	       "libinput side by side and report timing and event stream\n"
+	       "differences. This tool needs to run as root.\n",
+	       program_invocation_short_name);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct replay_context ctx = {0};
+	struct compare_context compare = {0};
+	const char *recording;
+	size_t i, r;
+	int rc;
+
+	while (1) {
+		enum {
+			OPT_HELP,
+		};
+		static struct option opts[] = {
+			{ "help", no_argument, 0, OPT_HELP },
+			{ 0, 0, 0, 0 },
+		};
+		int c = getopt_long(argc, argv, "h", opts, NULL);
+
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+		case OPT_HELP:
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - optind != 3) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	compare.runs[0].label = 'A';
+	compare.runs[1].label = 'B';
+	recording = argv[optind + 2];
+
+	for (r = 0; r < 2; r++) {
+		rc = libinput_api_load(&compare.runs[r].api,
+				       argv[optind + r]);
+		if (rc < 0)
+			return EXIT_FAILURE;
+	}
+
+	rc = replay_context_parse(&ctx, recording);
+	if (rc < 0) {
+		fprintf(stderr, "%s is not a valid recording (%s)\n",
+			recording, strerror(-rc));
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < ctx.ndevices; i++) {
+		rc = replay_device_create_uinput(&ctx.devices[i]);
+		if (rc < 0) {
+			fprintf(stderr,
+				"Failed to create %s (%s)%s\n",
+				ctx.devices[i].name,
+				strerror(-rc),
+				rc == -EACCES ? ", are you running as root?" : "");
+			replay_context_destroy(&ctx);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* give udev a moment to pick the devices up, the path backend
+	 * reads their udev properties on add */
+	msleep(500);
+
+	for (r = 0; r < 2; r++) {
+		struct run *run = &compare.runs[r];
+
+		run->li = run->api.path_create_context(&interface, NULL);
+		if (!run->li) {
+			fprintf(stderr, "%s: failed to create context\n",
+				run->api.path);
+			replay_context_destroy(&ctx);
+			return EXIT_FAILURE;
+		}
+
+		for (i = 0; i < ctx.ndevices; i++) {
+			const char *node = libevdev_uinput_get_devnode(
+						ctx.devices[i].uinput);
+
+			if (!run->api.path_add_device(run->li, node)) {
+				fprintf(stderr,
+					"%s: failed to add %s\n",
+					run->api.path, node);
+				replay_context_destroy(&ctx);
+				return EXIT_FAILURE;
+			}
+		}
+
+		/* consume the device-added events untimed */
+		run_dispatch(run, false);
+	}
+
+	printf("A: %s\nB: %s\n%s: %zu device(s)\n",
+	       compare.runs[0].api.path,
+	       compare.runs[1].api.path,
+	       recording,
+	       ctx.ndevices);
+
+	rc = replay_run(&ctx, dispatch_batch, &compare);
+	if (rc < 0) {
+		fprintf(stderr, "Replay failed (%s)\n", strerror(-rc));
+		replay_context_destroy(&ctx);
+		return EXIT_FAILURE;
+	}
+
+	/* let pending timers resolve so tap/debounce/scroll decisions
+	 * show up in both event streams */
+	for (i = 0; i < SETTLE_PASSES; i++) {
+		msleep(SETTLE_INTERVAL_MS);
+		run_dispatch(&compare.runs[0], true);
+		run_dispatch(&compare.runs[1], true);
+	}
+
+	print_report(&compare);
+
+	for (r = 0; r < 2; r++) {
+		struct run *run = &compare.runs[r];
+
+		run->api.unref(run->li);
+		dlclose(run->api.handle);
+		free(run->types);
+	}
+	replay_context_destroy(&ctx);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Native replacement for libinput-replay for high-rate recordings, so
+ * an 8kHz trace replays faithfully where the line-at-a-time python
+ * tool falls behind. The parsing and pacing live in
+ * replay-recording.c, shared with libinput-replay-compare.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libevdev/libevdev.h>
+#include <libevdev/libevdev-uinput.h>
+
+#include "util-macros.h"
+#include "util-time.h"
+
+#include "replay-recording.h"
+
+static inline void
+usage(void)
+{
+	printf("Usage: %s [--help] [--verbose] recording\n"
+	       "\n"
+	       "Replay the evdev events from a libinput-record recording\n"
+	       "through uinput. This tool needs to run as root.\n",
+	       program_invocation_short_name);
+}
+
+static void
+print_batch(struct replay_context *ctx,
+	    struct replay_device *d,
+	    size_t first,
+	    size_t ndue,
+	    void *userdata)
+{
+	size_t i;
+
+	for (i = first; i < first + ndue; i++) {
+		const struct input_event *e = &d->events[i];
+		uint64_t time = d->times[i] - ctx->time_offset;
+
+		printf("%s: %" PRIu64 ".%06" PRIu64 " %s / %s %d\n",
+		       libevdev_uinput_get_devnode(d->uinput),
+		       time / 1000000,
+		       time % 1000000,
+		       libevdev_event_type_get_name(e->type),
+		       libevdev_event_code_get_name(e->type, e->code),
+		       e->value);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	struct replay_context ctx = {0};
+	const char *path;
+	bool verbose = false;
+	size_t i;
+	int rc;
+
+	while (1) {
+		enum {
+			OPT_HELP,
+			OPT_VERBOSE,
+		};
+		static struct option opts[] = {
+			{ "help", no_argument, 0, OPT_HELP },
+			{ "verbose", no_argument, 0, OPT_VERBOSE },
+			{ 0, 0, 0, 0 },
+		};
+		int c = getopt_long(argc, argv, "hv", opts, NULL);
+
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+		case OPT_HELP:
+			usage();
+			return EXIT_SUCCESS;
+		case 'v':
+		case OPT_VERBOSE:
+			verbose = true;
+			break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind >= argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	path = argv[optind];
+	rc = replay_context_parse(&ctx, path);
+	if (rc < 0) {
+		fprintf(stderr, "%s is not a valid recording (%s)\n",
+			path, strerror(-rc));
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < ctx.ndevices; i++) {
+		struct replay_device *d = &ctx.devices[i];
+
+		rc = replay_device_create_uinput(d);
+		if (rc < 0) {
+			fprintf(stderr,
+				"Failed to create %s (%s)%s\n",
+				d->name,
+				strerror(-rc),
+				rc == -EACCES ? ", are you running as root?" : "");
+			replay_context_destroy(&ctx);
+			return EXIT_FAILURE;
+		}
+		printf("%s: %s\n",
+		       libevdev_uinput_get_devnode(d->uinput),
+		       d->name);
+	}
+
+	/* give the compositor/udev a moment to pick the devices up */
+	msleep(500);
+
+	rc = replay_run(&ctx, verbose ? print_batch : NULL, NULL);
+	if (rc < 0)
+		fprintf(stderr, "Replay failed (%s)\n", strerror(-rc));
+
+	replay_context_destroy(&ctx);
+
+	return rc < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -51,6 +51,28 @@ def error(msg, **kwargs):
     print(msg, **kwargs, file=sys.stderr)
 
 
+def open_recording(path):
+    """Open a recording for reading, decompressing zstd-compressed
+    recordings (as written by libinput record with a .zst output file)
+    transparently."""
+    if not path.endswith(".zst"):
+        return open(path)
+
+    try:
+        import io
+        import zstandard
+    except ModuleNotFoundError as e:
+        error("Error: {}".format(e))
+        error(
+            "The zstandard module is required to read compressed "
+            "recordings. Please install it and re-run this tool."
+        )
+        sys.exit(1)
+
+    dctx = zstandard.ZstdDecompressor()
+    return io.TextIOWrapper(dctx.stream_reader(open(path, "rb")))
+
+
 class YamlException(Exception):
     pass
 
@@ -369,7 +391,7 @@ def main():
     quirks_file = None
 
     try:
-        with open(args.recording) as f:
+        with open_recording(args.recording) as f:
             y = yaml.safe_load(f)
             check_file(y)
             quirks_file = setup_quirks(y)
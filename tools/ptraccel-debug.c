@@ -28,8 +28,12 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <getopt.h>
+#if HAVE_MALLINFO2
+#include <malloc.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "filter.h"
@@ -141,6 +145,88 @@ print_ptraccel_sequence(struct motion_filter *filter,
 	}
 }
 
+static void
+print_bench(int nevents, int dpi, double speed)
+{
+	struct bench_filter {
+		const char *name;
+		struct motion_filter *filter;
+	} benches[] = {
+		{ "flat",
+		  create_pointer_accelerator_filter_flat(dpi) },
+		{ "linear",
+		  create_pointer_accelerator_filter_linear(dpi, false) },
+		{ "low-dpi",
+		  create_pointer_accelerator_filter_linear_low_dpi(dpi, false) },
+		{ "touchpad",
+		  create_pointer_accelerator_filter_touchpad(dpi, 0, 0, false) },
+		{ "touchpad-flat",
+		  create_pointer_accelerator_filter_touchpad_flat(dpi) },
+		{ "x230",
+		  create_pointer_accelerator_filter_lenovo_x230(dpi, false) },
+		{ "trackpoint",
+		  create_pointer_accelerator_filter_trackpoint(1.0, false) },
+	};
+	struct bench_filter *b;
+
+	printf("# per-event cost of filter_dispatch(), %d events per filter\n",
+	       nevents);
+	printf("# deltas sweep 0..10 device units, 1000Hz event rate\n");
+	printf("# data: filter ns/event allocated(bytes)\n");
+
+	ARRAY_FOR_EACH(benches, b) {
+		struct device_float_coords motion;
+		uint64_t time = 0;
+		struct timespec start, end;
+#if HAVE_MALLINFO2
+		struct mallinfo2 before, after;
+#endif
+		uint64_t ns;
+		int i;
+
+		assert(b->filter != NULL);
+		filter_set_speed(b->filter, speed);
+
+		/* warm up the velocity trackers so we don't just
+		   measure the first-event special cases */
+		for (i = 0; i < 64; i++) {
+			motion.x = (i % 20) * 0.5;
+			motion.y = 0;
+			time += us(1000);
+			filter_dispatch(b->filter, &motion, NULL, time);
+		}
+
+#if HAVE_MALLINFO2
+		before = mallinfo2();
+#endif
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < nevents; i++) {
+			motion.x = (i % 20) * 0.5;
+			motion.y = 0;
+			time += us(1000);
+			filter_dispatch(b->filter, &motion, NULL, time);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		ns = (end.tv_sec - start.tv_sec) * 1000000000ULL +
+		     end.tv_nsec - start.tv_nsec;
+#if HAVE_MALLINFO2
+		after = mallinfo2();
+		printf("%-14s	%.1f	%zd\n",
+		       b->name,
+		       (double)ns/nevents,
+		       (ssize_t)after.uordblks - (ssize_t)before.uordblks);
+#else
+		/* no mallinfo2() (glibc < 2.33, musl), skip the column */
+		printf("%-14s	%.1f	-\n",
+		       b->name,
+		       (double)ns/nevents);
+#endif
+
+		filter_destroy(b->filter);
+	}
+}
+
 /* mm/s → units/µs */
 static inline double
 mmps_to_upus(double mmps, int dpi)
@@ -176,11 +262,13 @@ usage(void)
 	printf("Usage: %s [options] [dx1] [dx2] [...] > gnuplot.data\n", program_invocation_short_name);
 	printf("\n"
 	       "Options:\n"
-	       "--mode=<accel|motion|delta|sequence> \n"
+	       "--mode=<accel|motion|delta|sequence|bench> \n"
 	       "	accel    ... print accel factor (default)\n"
 	       "	motion   ... print motion to accelerated motion\n"
 	       "	delta    ... print delta to accelerated delta\n"
 	       "	sequence ... print motion for custom delta sequence\n"
+	       "	bench    ... print per-event dispatch cost for all filters\n"
+	       "--nevents=<int>   ... in bench mode only. Events per filter (default: 100000)\n"
 	       "--maxdx=<double>  ... in motion mode only. Stop increasing dx at maxdx\n"
 	       "--steps=<double>  ... in motion and delta modes only. Increase dx by step each round\n"
 	       "--speed=<double>  ... accel speed [-1, 1], default 0\n"
@@ -209,6 +297,7 @@ enum mode {
 	MOTION,
 	DELTA,
 	SEQUENCE,
+	BENCH,
 };
 
 int
@@ -272,6 +361,8 @@ main(int argc, char **argv)
 				mode = DELTA;
 			else if (streq(optarg, "sequence"))
 				mode = SEQUENCE;
+			else if (streq(optarg, "bench"))
+				mode = BENCH;
 			else {
 				usage();
 				return 1;
@@ -314,6 +405,14 @@ main(int argc, char **argv)
 		}
 	}
 
+	if (mode == BENCH) {
+		/* bench constructs one filter of each type itself */
+		if (nevents == 0)
+			nevents = 100000;
+		print_bench(nevents, dpi, speed);
+		return 0;
+	}
+
 	if (streq(filter_type, "linear")) {
 		filter = create_pointer_accelerator_filter_linear(dpi,
 								  use_averaging);
@@ -376,6 +475,9 @@ main(int argc, char **argv)
 	case SEQUENCE:
 		print_ptraccel_sequence(filter, nevents, custom_deltas);
 		break;
+	case BENCH:
+		abort(); /* handled above */
+		break;
 	}
 
 	filter_destroy(filter);
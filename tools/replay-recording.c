@@ -0,0 +1,450 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <libevdev/libevdev.h>
+
+#include "util-macros.h"
+#include "util-strings.h"
+#include "util-time.h"
+
+#include "replay-recording.h"
+
+#define SUPPORTED_FILE_VERSION 1
+
+/* Copies the next line of the buffer into buf with leading whitespace
+ * stripped and a terminating \0, returns NULL at end of buffer.
+ * Overlong lines are truncated; the only ones that get close to the
+ * buffer size are the codes: lists of keyboards. */
+static const char *
+next_line(const char *data, size_t size, size_t *pos, char *buf, size_t bufsz)
+{
+	const char *line, *end;
+	size_t n;
+
+	if (*pos >= size)
+		return NULL;
+
+	line = data + *pos;
+	end = memchr(line, '\n', size - *pos);
+	n = end ? (size_t)(end - line) : size - *pos;
+	*pos += n + 1;
+
+	while (n > 0 && (*line == ' ' || *line == '\t')) {
+		line++;
+		n--;
+	}
+
+	n = min(n, bufsz - 1);
+	memcpy(buf, line, n);
+	buf[n] = '\0';
+
+	return buf;
+}
+
+static inline bool
+line_begins(const char *line, const char *prefix)
+{
+	return strneq(line, prefix, (int)strlen(prefix));
+}
+
+static void
+replay_device_append_event(struct replay_device *d,
+			   const struct input_event *ev,
+			   uint64_t time)
+{
+	if (d->nevents == d->events_sz) {
+		d->events_sz = d->events_sz ? d->events_sz * 2 : 4096;
+		d->events = realloc(d->events,
+				    d->events_sz * sizeof(*d->events));
+		d->times = realloc(d->times,
+				   d->events_sz * sizeof(*d->times));
+		if (!d->events || !d->times) {
+			fprintf(stderr, "Failed to allocate event arrays\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	d->events[d->nevents] = *ev;
+	d->times[d->nevents] = time;
+	d->nevents++;
+}
+
+int
+replay_device_create_uinput(struct replay_device *d)
+{
+	struct libevdev *dev;
+	size_t i;
+	int rc;
+
+	dev = libevdev_new();
+	if (!dev)
+		return -ENOMEM;
+
+	libevdev_set_name(dev, d->name);
+	libevdev_set_id_bustype(dev, d->ids[0]);
+	libevdev_set_id_vendor(dev, d->ids[1]);
+	libevdev_set_id_product(dev, d->ids[2]);
+	libevdev_set_id_version(dev, d->ids[3]);
+
+	for (i = 0; i < d->ncodes; i++) {
+		unsigned int type = d->codes[i].type;
+		unsigned int code = d->codes[i].code;
+		const void *data = NULL;
+		int delay = 500, period = 20;
+
+		if (type == EV_ABS && code < ABS_CNT &&
+		    d->has_absinfo[code])
+			data = &d->absinfo[code];
+		else if (type == EV_REP && code == REP_DELAY)
+			data = &delay;
+		else if (type == EV_REP && code == REP_PERIOD)
+			data = &period;
+
+		libevdev_enable_event_code(dev, type, code, data);
+	}
+
+	for (i = 0; i < d->nprops; i++)
+		libevdev_enable_property(dev, d->props[i]);
+
+	rc = libevdev_uinput_create_from_device(dev,
+						LIBEVDEV_UINPUT_OPEN_MANAGED,
+						&d->uinput);
+	libevdev_free(dev);
+
+	return rc;
+}
+
+/* Minimal scanner for the fixed YAML layout that libinput-record
+ * produces. Anything we do not recognize is skipped. */
+static int
+parse_recording(struct replay_context *ctx, const char *data, size_t size)
+{
+	enum {
+		SEC_NONE,
+		SEC_EVDEV,
+		SEC_EVDEV_CODES,
+		SEC_EVDEV_ABSINFO,
+		SEC_OTHER,
+		SEC_EVENTS,
+	} section = SEC_NONE;
+	struct replay_device *d = NULL;
+	bool in_evdev_frame = false;
+	char buf[16384];
+	const char *line;
+	size_t pos = 0;
+	int version = -1;
+
+	while ((line = next_line(data, size, &pos, buf, sizeof(buf)))) {
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+
+		if (version == -1 && line_begins(line, "version:")) {
+			version = atoi(line + 8);
+			if (version != SUPPORTED_FILE_VERSION) {
+				fprintf(stderr,
+					"Unsupported recording version %d\n",
+					version);
+				return -EINVAL;
+			}
+			continue;
+		}
+
+		if (line_begins(line, "- node:")) {
+			if (ctx->ndevices == REPLAY_MAX_DEVICES) {
+				fprintf(stderr, "Too many devices\n");
+				return -EINVAL;
+			}
+			d = &ctx->devices[ctx->ndevices++];
+			section = SEC_NONE;
+			in_evdev_frame = false;
+			continue;
+		}
+
+		if (!d)
+			continue;
+
+		if (section == SEC_EVENTS) {
+			if (line_begins(line, "- evdev:")) {
+				in_evdev_frame = true;
+			} else if (line_begins(line, "- hid:")) {
+				in_evdev_frame = false;
+			} else if (in_evdev_frame &&
+				   line_begins(line, "- [")) {
+				struct input_event ev;
+				unsigned long sec, usec;
+				unsigned int type, code;
+				int value;
+
+				if (sscanf(line,
+					   "- [%lu, %lu, %u, %u, %d]",
+					   &sec, &usec,
+					   &type, &code, &value) != 5)
+					continue;
+
+				/* kernel key repeats are regenerated by
+				 * the kernel, not replayed */
+				if (type == EV_KEY && value == 2)
+					continue;
+
+				ev.input_event_sec = sec;
+				ev.input_event_usec = usec;
+				ev.type = type;
+				ev.code = code;
+				ev.value = value;
+				replay_device_append_event(d,
+							   &ev,
+							   s2us(sec) + usec);
+			}
+			continue;
+		}
+
+		if (streq(line, "evdev:")) {
+			section = SEC_EVDEV;
+			continue;
+		}
+		if (streq(line, "events:")) {
+			section = SEC_EVENTS;
+			in_evdev_frame = false;
+			continue;
+		}
+		if (line_begins(line, "udev:") ||
+		    line_begins(line, "libinput:") ||
+		    line_begins(line, "quirks:") ||
+		    line_begins(line, "hid:")) {
+			section = SEC_OTHER;
+			continue;
+		}
+
+		if (section == SEC_OTHER || section == SEC_NONE)
+			continue;
+
+		/* keys inside the evdev: description */
+		if (line_begins(line, "name: \"")) {
+			size_t n = min(strlen(line + 7), sizeof(d->name) - 1);
+
+			memcpy(d->name, line + 7, n);
+			/* strip the closing quote */
+			if (n > 0 && d->name[n - 1] == '"')
+				n--;
+			d->name[n] = '\0';
+		} else if (line_begins(line, "id: [")) {
+			sscanf(line, "id: [%d, %d, %d, %d]",
+			       &d->ids[0], &d->ids[1],
+			       &d->ids[2], &d->ids[3]);
+		} else if (streq(line, "codes:")) {
+			section = SEC_EVDEV_CODES;
+		} else if (streq(line, "absinfo:")) {
+			section = SEC_EVDEV_ABSINFO;
+		} else if (line_begins(line, "properties: [")) {
+			const char *s = line + 13;
+			int prop;
+
+			while (sscanf(s, "%d", &prop) == 1 &&
+			       d->nprops < ARRAY_LENGTH(d->props)) {
+				d->props[d->nprops++] = prop;
+				s = strchr(s, ',');
+				if (!s)
+					break;
+				s++;
+			}
+		} else if (section == SEC_EVDEV_CODES &&
+			   strchr(line, ':')) {
+			unsigned int type = atoi(line);
+			const char *s = strchr(line, '[');
+			int code;
+
+			while (s && sscanf(s + 1, "%d", &code) == 1 &&
+			       d->ncodes < REPLAY_MAX_CODES) {
+				d->codes[d->ncodes].type = type;
+				d->codes[d->ncodes].code = code;
+				d->ncodes++;
+				s = strchr(s + 1, ',');
+			}
+		} else if (section == SEC_EVDEV_ABSINFO &&
+			   strchr(line, ':')) {
+			unsigned int code = atoi(line);
+			const char *s = strchr(line, '[');
+			struct input_absinfo *abs;
+
+			if (code >= ABS_CNT || !s)
+				continue;
+
+			abs = &d->absinfo[code];
+			if (sscanf(s, "[%d, %d, %d, %d, %d]",
+				   &abs->minimum, &abs->maximum,
+				   &abs->fuzz, &abs->flat,
+				   &abs->resolution) == 5)
+				d->has_absinfo[code] = true;
+		}
+	}
+
+	return ctx->ndevices > 0 ? 0 : -EINVAL;
+}
+
+int
+replay_context_parse(struct replay_context *ctx, const char *path)
+{
+	struct stat st;
+	char *data;
+	int fd, rc;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) < 0) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return -errno;
+
+	rc = parse_recording(ctx, data, st.st_size);
+	munmap(data, st.st_size);
+
+	return rc;
+}
+
+void
+replay_context_destroy(struct replay_context *ctx)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->ndevices; i++) {
+		if (ctx->devices[i].uinput)
+			libevdev_uinput_destroy(ctx->devices[i].uinput);
+		free(ctx->devices[i].events);
+		free(ctx->devices[i].times);
+	}
+}
+
+static inline uint64_t
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return s2us(ts.tv_sec) + ns2us(ts.tv_nsec);
+}
+
+/* Find the device with the earliest unreplayed event */
+static struct replay_device *
+next_due_device(struct replay_context *ctx)
+{
+	struct replay_device *due = NULL;
+	size_t i;
+
+	for (i = 0; i < ctx->ndevices; i++) {
+		struct replay_device *d = &ctx->devices[i];
+
+		if (d->next >= d->nevents)
+			continue;
+		if (!due || d->times[d->next] < due->times[due->next])
+			due = d;
+	}
+
+	return due;
+}
+
+int
+replay_run(struct replay_context *ctx, replay_batch_func func, void *userdata)
+{
+	struct replay_device *d;
+	uint64_t start, offset = UINT64_MAX;
+	size_t i;
+	int tfd;
+
+	for (i = 0; i < ctx->ndevices; i++) {
+		d = &ctx->devices[i];
+		if (d->nevents > 0)
+			offset = min(offset, d->times[0]);
+	}
+	ctx->time_offset = offset;
+
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (tfd < 0)
+		return -errno;
+
+	start = now_us();
+
+	while ((d = next_due_device(ctx))) {
+		uint64_t target = start + d->times[d->next] - offset;
+		uint64_t elapsed;
+		struct itimerspec its = {
+			.it_value.tv_sec = target / 1000000,
+			.it_value.tv_nsec = (target % 1000000) * 1000,
+		};
+		uint64_t expirations;
+		size_t first, ndue;
+		int fd;
+
+		if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0 ||
+		    read(tfd, &expirations, sizeof(expirations)) !=
+			    sizeof(expirations)) {
+			close(tfd);
+			return -errno;
+		}
+
+		/* Write every event due by now in one batch per device,
+		 * so a backlog drains with few syscalls instead of one
+		 * write per event */
+		elapsed = now_us() - start;
+		first = d->next;
+		ndue = 0;
+		while (d->next < d->nevents &&
+		       d->times[d->next] - offset <= elapsed) {
+			d->next++;
+			ndue++;
+		}
+
+		fd = libevdev_uinput_get_fd(d->uinput);
+		if (write(fd,
+			  &d->events[first],
+			  ndue * sizeof(struct input_event)) < 0) {
+			close(tfd);
+			return -errno;
+		}
+
+		if (func)
+			func(ctx, d, first, ndue, userdata);
+	}
+
+	close(tfd);
+
+	return 0;
+}
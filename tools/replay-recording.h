@@ -0,0 +1,105 @@
+/*
+ * Copyright © 2021 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef REPLAY_RECORDING_H
+#define REPLAY_RECORDING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <linux/input.h>
+
+#include <libevdev/libevdev-uinput.h>
+
+/*
+ * Native libinput-record recording parser and uinput replayer, shared
+ * between libinput-replay-fast and libinput-replay-compare. The
+ * recording is mmapped and parsed once into pre-converted event
+ * arrays, then replayed against uinput with timerfd pacing.
+ *
+ * Only the evdev parts of a recording are replayed; hid frames and the
+ * udev/libinput sections are skipped. Like libinput-replay, kernel key
+ * repeat events (EV_KEY with value 2) are not replayed.
+ */
+
+#define REPLAY_MAX_DEVICES 32
+#define REPLAY_MAX_CODES 2048
+
+struct replay_device {
+	char name[256];
+	int ids[4]; /* bustype, vendor, product, version */
+	struct {
+		unsigned int type;
+		unsigned int code;
+	} codes[REPLAY_MAX_CODES];
+	size_t ncodes;
+	struct input_absinfo absinfo[ABS_CNT];
+	bool has_absinfo[ABS_CNT];
+	unsigned int props[INPUT_PROP_CNT];
+	size_t nprops;
+
+	struct libevdev_uinput *uinput;
+
+	struct input_event *events;
+	uint64_t *times; /* µs, offset from recording start */
+	size_t nevents;
+	size_t events_sz;
+	size_t next;
+};
+
+struct replay_context {
+	struct replay_device devices[REPLAY_MAX_DEVICES];
+	size_t ndevices;
+	/* timestamp of the first recorded event, set by replay_run();
+	 * subtract from replay_device.times for recording-relative
+	 * times */
+	uint64_t time_offset;
+};
+
+/* mmap and parse the recording at path, 0 on success or a negative
+ * errno */
+int
+replay_context_parse(struct replay_context *ctx, const char *path);
+
+int
+replay_device_create_uinput(struct replay_device *d);
+
+void
+replay_context_destroy(struct replay_context *ctx);
+
+/* Invoked after each batch of events was written to d's uinput fd;
+ * the batch is d->events[first] up to d->events[first + ndue - 1] */
+typedef void (*replay_batch_func)(struct replay_context *ctx,
+				  struct replay_device *d,
+				  size_t first,
+				  size_t ndue,
+				  void *userdata);
+
+/* Replay all devices in timestamp order with timerfd pacing, writing
+ * every event due by the wakeup in one batch per device. Returns 0 on
+ * completion or a negative errno */
+int
+replay_run(struct replay_context *ctx, replay_batch_func func, void *userdata);
+
+#endif /* REPLAY_RECORDING_H */
@@ -366,11 +366,10 @@ tools_open_device(const char **paths, bool verbose, bool *grab)
 static void
 tools_setenv_quirks_dir(void)
 {
-	char *builddir = builddir_lookup();
-	if (builddir) {
-		setenv("LIBINPUT_QUIRKS_DIR", LIBINPUT_QUIRKS_SRCDIR, 0);
-		free(builddir);
-	}
+	const struct data_paths *paths = data_paths_get();
+
+	if (paths->builddir)
+		setenv("LIBINPUT_QUIRKS_DIR", paths->quirks_dir, 0);
 }
 
 struct libinput *
@@ -552,7 +551,7 @@ setup_path(void)
 	const char *path = getenv("PATH");
 	char new_path[PATH_MAX];
 	const char *extra_path = LIBINPUT_TOOL_PATH;
-	char *builddir = builddir_lookup();
+	const char *builddir = data_paths_get()->builddir;
 
 	snprintf(new_path,
 		 sizeof(new_path),
@@ -560,7 +559,6 @@ setup_path(void)
 		 builddir ? builddir : extra_path,
 		 path ? path : "");
 	setenv("PATH", new_path, 1);
-	free(builddir);
 }
 
 int